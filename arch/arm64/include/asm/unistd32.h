@@ -903,6 +903,12 @@ __SYSCALL(__NR_landlock_add_rule, sys_landlock_add_rule)
 __SYSCALL(__NR_landlock_restrict_self, sys_landlock_restrict_self)
 #define __NR_process_mrelease 448
 __SYSCALL(__NR_process_mrelease, sys_process_mrelease)
+#define __NR_futex_waitv 449
+__SYSCALL(__NR_futex_waitv, sys_futex_waitv)
+#define __NR_statx_many 450
+__SYSCALL(__NR_statx_many, sys_statx_many)
+#define __NR_openat_many 451
+__SYSCALL(__NR_openat_many, sys_openat_many)
 
 /*
  * Please add new compat syscalls above this comment and update
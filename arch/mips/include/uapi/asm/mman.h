@@ -101,6 +101,19 @@
 #define MADV_POPULATE_READ	22	/* populate (prefault) page tables readable */
 #define MADV_POPULATE_WRITE	23	/* populate (prefault) page tables writable */
 
+#define MADV_COLLAPSE	25		/* Synchronous hugepage collapse */
+
+#define MADV_FAULTAROUND	26	/* map neighbouring pages on fault */
+#define MADV_NOFAULTAROUND	27	/* only map the faulting page */
+
+/*
+ * MADV_FAULTAROUND can carry the log2 of the window size in bytes above
+ * MADV_FAULTAROUND_SHIFT, 0 selects the system default.
+ */
+#define MADV_FAULTAROUND_SHIFT	8
+#define MADV_FAULTAROUND_16KB	(MADV_FAULTAROUND | (14 << MADV_FAULTAROUND_SHIFT))
+#define MADV_FAULTAROUND_64KB	(MADV_FAULTAROUND | (16 << MADV_FAULTAROUND_SHIFT))
+
 /* compatibility flags */
 #define MAP_FILE	0
 
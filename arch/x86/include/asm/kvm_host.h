@@ -1241,6 +1241,8 @@ struct kvm_vm_stat {
 		atomic64_t pages[KVM_NR_PAGE_SIZES];
 	};
 	u64 nx_lpage_splits;
+	atomic64_t eager_lpage_splits;
+	atomic64_t fault_lpage_splits;
 	u64 max_mmu_page_hash_collisions;
 	u64 max_mmu_rmap_size;
 };
@@ -1580,6 +1582,9 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm,
 				      int start_level);
 void kvm_mmu_zap_collapsible_sptes(struct kvm *kvm,
 				   const struct kvm_memory_slot *memslot);
+void kvm_mmu_slot_try_split_huge_pages(struct kvm *kvm,
+				       const struct kvm_memory_slot *memslot,
+				       int target_level);
 void kvm_mmu_slot_leaf_clear_dirty(struct kvm *kvm,
 				   const struct kvm_memory_slot *memslot);
 void kvm_mmu_zap_all(struct kvm *kvm);
@@ -183,6 +183,28 @@ int make_spte(struct kvm_vcpu *vcpu, unsigned int pte_access, int level,
 	return ret;
 }
 
+/*
+ * Construct the SPTE at @index of a page table replacing the huge page
+ * @huge_spte at @huge_level.  The child keeps all the attributes of the huge
+ * SPTE, including the writable and dirty bits, and maps the corresponding
+ * part of the same huge page.
+ */
+u64 make_huge_page_split_spte(u64 huge_spte, int huge_level, int index)
+{
+	int child_level = huge_level - 1;
+	u64 child_spte = huge_spte;
+
+	if (WARN_ON_ONCE(!is_shadow_present_pte(huge_spte) ||
+			 !is_large_pte(huge_spte)))
+		return 0;
+
+	child_spte |= (index * KVM_PAGES_PER_HPAGE(child_level)) << PAGE_SHIFT;
+	if (child_level == PG_LEVEL_4K)
+		child_spte &= ~PT_PAGE_SIZE_MASK;
+
+	return child_spte;
+}
+
 u64 make_nonleaf_spte(u64 *child_pt, bool ad_disabled)
 {
 	u64 spte = SPTE_MMU_PRESENT_MASK;
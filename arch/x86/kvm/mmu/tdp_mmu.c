@@ -1046,6 +1046,7 @@ int kvm_tdp_mmu_map(struct kvm_vcpu *vcpu, gpa_t gpa, u32 error_code,
 		    is_large_pte(iter.old_spte)) {
 			if (!tdp_mmu_zap_spte_atomic(vcpu->kvm, &iter))
 				break;
+			atomic64_inc(&vcpu->kvm->stat.fault_lpage_splits);
 
 			/*
 			 * The iter must explicitly re-read the spte here
@@ -1095,6 +1096,168 @@ int kvm_tdp_mmu_map(struct kvm_vcpu *vcpu, gpa_t gpa, u32 error_code,
 	return ret;
 }
 
+static struct kvm_mmu_page *__tdp_mmu_alloc_sp_for_split(gfp_t gfp)
+{
+	struct kvm_mmu_page *sp;
+
+	sp = kmem_cache_zalloc(mmu_page_header_cache, gfp);
+	if (!sp)
+		return NULL;
+
+	sp->spt = (void *)get_zeroed_page(gfp);
+	if (!sp->spt) {
+		kmem_cache_free(mmu_page_header_cache, sp);
+		return NULL;
+	}
+
+	return sp;
+}
+
+/*
+ * Allocate a page table for splitting a huge page.  mmu_lock is held, so try
+ * without blocking first: direct reclaim could end up in the MMU notifiers.
+ * If that fails, drop mmu_lock (the caller must restart the iteration from
+ * the root, as with tdp_mmu_iter_cond_resched()) and allow reclaim.
+ */
+static struct kvm_mmu_page *tdp_mmu_alloc_sp_for_split(struct kvm *kvm,
+						       struct tdp_iter *iter)
+{
+	struct kvm_mmu_page *sp;
+
+	sp = __tdp_mmu_alloc_sp_for_split(GFP_NOWAIT | __GFP_ACCOUNT);
+	if (sp)
+		return sp;
+
+	rcu_read_unlock();
+	read_unlock(&kvm->mmu_lock);
+
+	iter->yielded = true;
+	sp = __tdp_mmu_alloc_sp_for_split(GFP_KERNEL_ACCOUNT);
+
+	read_lock(&kvm->mmu_lock);
+	rcu_read_lock();
+
+	return sp;
+}
+
+/*
+ * Replace the huge SPTE at @iter with a page table of SPTEs mapping the same
+ * memory at the next lower level.  No TLB flush is needed: until the huge
+ * translation is flushed vCPUs may use either, but both map the same pages
+ * with the same permissions.
+ */
+static bool tdp_mmu_split_huge_page(struct kvm *kvm, struct tdp_iter *iter,
+				    struct kvm_mmu_page *sp)
+{
+	struct kvm_mmu_page *parent_sp = sptep_to_sp(rcu_dereference(iter->sptep));
+	const u64 huge_spte = iter->old_spte;
+	const int level = iter->level;
+	int i;
+
+	set_page_private(virt_to_page(sp->spt), (unsigned long)sp);
+	sp->role = parent_sp->role;
+	sp->role.level = level - 1;
+	sp->gfn = iter->gfn;
+	sp->tdp_mmu_page = true;
+
+	/* Not reachable by any other CPU until linked, no atomics needed */
+	for (i = 0; i < PT64_ENT_PER_PAGE; i++)
+		sp->spt[i] = make_huge_page_split_spte(huge_spte, level, i);
+
+	if (!tdp_mmu_set_spte_atomic_no_dirty_log(kvm, iter,
+			make_nonleaf_spte(sp->spt, !shadow_accessed_mask)))
+		return false;
+
+	tdp_mmu_link_page(kvm, sp, false);
+	trace_kvm_mmu_get_page(sp, true);
+
+	/*
+	 * Changing the huge SPTE into a non-leaf one took it out of the page
+	 * stats, account for the children by hand.
+	 */
+	kvm_update_page_stats(kvm, level - 1, PT64_ENT_PER_PAGE);
+	atomic64_inc(&kvm->stat.eager_lpage_splits);
+	return true;
+}
+
+static int tdp_mmu_split_huge_pages_root(struct kvm *kvm,
+					 struct kvm_mmu_page *root,
+					 gfn_t start, gfn_t end,
+					 int target_level)
+{
+	struct kvm_mmu_page *sp = NULL;
+	struct tdp_iter iter;
+	int ret = 0;
+
+	rcu_read_lock();
+
+	/*
+	 * The walk is pre-order, so a page split into the level below is
+	 * visited again right away and split further if it is still above
+	 * the target level, e.g. 1G into 2M and then each 2M into 4K.
+	 */
+	for_each_tdp_pte_min_level(iter, root->spt, root->role.level,
+				   target_level + 1, start, end) {
+retry:
+		if (tdp_mmu_iter_cond_resched(kvm, &iter, false, true))
+			continue;
+
+		if (!is_shadow_present_pte(iter.old_spte) ||
+		    !is_large_pte(iter.old_spte))
+			continue;
+
+		if (!sp) {
+			sp = tdp_mmu_alloc_sp_for_split(kvm, &iter);
+			if (!sp) {
+				ret = -ENOMEM;
+				break;
+			}
+
+			if (iter.yielded)
+				continue;
+		}
+
+		if (!tdp_mmu_split_huge_page(kvm, &iter, sp)) {
+			iter.old_spte = READ_ONCE(*rcu_dereference(iter.sptep));
+			goto retry;
+		}
+
+		sp = NULL;
+	}
+
+	rcu_read_unlock();
+
+	/* A racing fault may have dealt with the last huge page first */
+	if (sp)
+		tdp_mmu_free_sp(sp);
+
+	return ret;
+}
+
+/*
+ * Split all huge pages mapping [start, end) of @slot down to @target_level,
+ * so that enabling dirty logging does not leave it to the write faults.
+ * Runs with mmu_lock held for read, concurrently with vCPU faults.  Stops
+ * early, leaving the rest to the faults, if memory runs out.
+ */
+void kvm_tdp_mmu_try_split_huge_pages(struct kvm *kvm,
+				      const struct kvm_memory_slot *slot,
+				      gfn_t start, gfn_t end,
+				      int target_level)
+{
+	struct kvm_mmu_page *root;
+
+	lockdep_assert_held_read(&kvm->mmu_lock);
+
+	for_each_valid_tdp_mmu_root_yield_safe(kvm, root, slot->as_id, true) {
+		if (tdp_mmu_split_huge_pages_root(kvm, root, start, end,
+						  target_level)) {
+			kvm_tdp_mmu_put_root(kvm, root, true);
+			break;
+		}
+	}
+}
+
 bool kvm_tdp_mmu_unmap_gfn_range(struct kvm *kvm, struct kvm_gfn_range *range,
 				 bool flush)
 {
@@ -237,6 +237,8 @@ const struct _kvm_stats_desc kvm_vm_stats_desc[] = {
 	STATS_DESC_ICOUNTER(VM, pages_2m),
 	STATS_DESC_ICOUNTER(VM, pages_1g),
 	STATS_DESC_ICOUNTER(VM, nx_lpage_splits),
+	STATS_DESC_COUNTER(VM, eager_lpage_splits),
+	STATS_DESC_COUNTER(VM, fault_lpage_splits),
 	STATS_DESC_PCOUNTER(VM, max_mmu_rmap_size),
 	STATS_DESC_PCOUNTER(VM, max_mmu_page_hash_collisions)
 };
@@ -9599,6 +9601,7 @@ static int vcpu_enter_guest(struct kvm_vcpu *vcpu)
 	if (unlikely(vcpu->kvm->dirty_ring_size &&
 		     kvm_dirty_ring_soft_full(&vcpu->dirty_ring))) {
 		vcpu->run->exit_reason = KVM_EXIT_DIRTY_RING_FULL;
+		++vcpu->stat.generic.dirty_ring_full_exits;
 		trace_kvm_dirty_ring_exit(vcpu);
 		r = 0;
 		goto out;
@@ -11829,6 +11832,9 @@ static void kvm_mmu_slot_apply_flags(struct kvm *kvm,
 		if (kvm_dirty_log_manual_protect_and_init_set(kvm))
 			return;
 
+		if (READ_ONCE(eager_page_split))
+			kvm_mmu_slot_try_split_huge_pages(kvm, new, PG_LEVEL_4K);
+
 		if (kvm_x86_ops.cpu_dirty_log_size) {
 			kvm_mmu_slot_leaf_clear_dirty(kvm, new);
 			kvm_mmu_slot_remove_write_access(kvm, new, PG_LEVEL_2M);
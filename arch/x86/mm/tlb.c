@@ -854,9 +854,54 @@ static void flush_tlb_func(void *info)
 			nr_invalidate);
 }
 
-static bool tlb_is_not_lazy(int cpu, void *data)
+/*
+ * Has @cpu already caught up to info->new_tlb_gen, for example while
+ * handling a concurrent flush of the same mm? Its state is read remotely,
+ * so the loaded mm and the context id are rechecked after the generation
+ * to notice a context switch that reused the ASID slot in between.
+ */
+static bool tlb_is_uptodate(int cpu, const struct flush_tlb_info *info)
+{
+	struct mm_struct *mm = info->mm;
+	u64 ctx_id, tlb_gen;
+	u16 asid;
+
+	if (!mm || per_cpu(cpu_tlbstate.loaded_mm, cpu) != mm)
+		return false;
+
+	asid = per_cpu(cpu_tlbstate.loaded_mm_asid, cpu);
+	if (asid >= TLB_NR_DYN_ASIDS)
+		return false;
+
+	ctx_id = per_cpu(cpu_tlbstate.ctxs[asid].ctx_id, cpu);
+	smp_rmb();
+	tlb_gen = per_cpu(cpu_tlbstate.ctxs[asid].tlb_gen, cpu);
+	smp_rmb();
+
+	if (ctx_id != mm->context.ctx_id ||
+	    per_cpu(cpu_tlbstate.ctxs[asid].ctx_id, cpu) != ctx_id ||
+	    per_cpu(cpu_tlbstate.loaded_mm, cpu) != mm)
+		return false;
+
+	return tlb_gen >= info->new_tlb_gen;
+}
+
+static bool tlb_needs_flush(int cpu, void *data)
 {
-	return !per_cpu(cpu_tlbstate_shared.is_lazy, cpu);
+	const struct flush_tlb_info *info = data;
+
+	/* Lazy CPUs flush themselves at the next context switch */
+	if (per_cpu(cpu_tlbstate_shared.is_lazy, cpu)) {
+		count_vm_tlb_event(NR_TLB_REMOTE_FLUSH_LAZY);
+		return false;
+	}
+
+	if (tlb_is_uptodate(cpu, info)) {
+		count_vm_tlb_event(NR_TLB_REMOTE_FLUSH_UPTODATE);
+		return false;
+	}
+
+	return true;
 }
 
 DEFINE_PER_CPU_SHARED_ALIGNED(struct tlb_state_shared, cpu_tlbstate_shared);
@@ -880,7 +925,8 @@ STATIC_NOPV void native_flush_tlb_multi(const struct cpumask *cpumask,
 	/*
 	 * If no page tables were freed, we can skip sending IPIs to
 	 * CPUs in lazy TLB mode. They will flush the CPU themselves
-	 * at the next context switch.
+	 * at the next context switch. The same goes for CPUs that
+	 * already flushed up to our generation.
 	 *
 	 * However, if page tables are getting freed, we need to send the
 	 * IPI everywhere, to prevent CPUs in lazy TLB mode from tripping
@@ -890,7 +936,7 @@ STATIC_NOPV void native_flush_tlb_multi(const struct cpumask *cpumask,
 	if (info->freed_tables)
 		on_each_cpu_mask(cpumask, flush_tlb_func, (void *)info, true);
 	else
-		on_each_cpu_cond_mask(tlb_is_not_lazy, flush_tlb_func,
+		on_each_cpu_cond_mask(tlb_needs_flush, flush_tlb_func,
 				(void *)info, 1, cpumask);
 }
 
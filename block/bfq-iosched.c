@@ -4446,15 +4446,16 @@ static bool bfq_better_to_idle(struct bfq_queue *bfqq)
 		return true;
 
 	/*
-	 * Idling is performed only if slice_idle > 0. In addition, we
+	 * Idling is performed only if slice_idle > 0 and fast_dispatch
+	 * is off. In addition, we
 	 * do not idle if
 	 * (a) bfqq is async
 	 * (b) bfqq is in the idle io prio class: in this case we do
 	 * not idle because we want to minimize the bandwidth that
 	 * queues in this class can steal to higher-priority queues
 	 */
-	if (bfqd->bfq_slice_idle == 0 || !bfq_bfqq_sync(bfqq) ||
-	   bfq_class_idle(bfqq))
+	if (bfqd->bfq_slice_idle == 0 || bfqd->fast_dispatch ||
+	    !bfq_bfqq_sync(bfqq) || bfq_class_idle(bfqq))
 		return false;
 
 	idling_boosts_thr_with_no_issue =
@@ -4937,6 +4938,7 @@ static bool bfq_has_work(struct blk_mq_hw_ctx *hctx)
 	 * most a call to dispatch for nothing
 	 */
 	return !list_empty_careful(&bfqd->dispatch) ||
+		!list_empty_careful(&bfqd->prefetched) ||
 		bfq_tot_busy_queues(bfqd) > 0;
 }
 
@@ -5029,14 +5031,30 @@ static struct request *__bfq_dispatch_request(struct blk_mq_hw_ctx *hctx)
 }
 
 #ifdef CONFIG_BFQ_CGROUP_DEBUG
+static void bfq_update_rq_dispatch_stats(struct request *rq)
+{
+	struct bfq_queue *bfqq = RQ_BFQQ(rq);
+	struct bfq_group *bfqg;
+
+	if (!bfqq)
+		return;
+
+	bfqg = bfqq_group(bfqq);
+	bfqg_stats_update_avg_queue_size(bfqg);
+	bfqg_stats_set_start_empty_time(bfqg);
+	bfqg_stats_update_io_remove(bfqg, rq->cmd_flags);
+}
+
 static void bfq_update_dispatch_stats(struct request_queue *q,
 				      struct request *rq,
+				      struct list_head *batch,
 				      struct bfq_queue *in_serv_queue,
 				      bool idle_timer_disabled)
 {
 	struct bfq_queue *bfqq = rq ? RQ_BFQQ(rq) : NULL;
+	struct request *next;
 
-	if (!idle_timer_disabled && !bfqq)
+	if (!idle_timer_disabled && !bfqq && list_empty(batch))
 		return;
 
 	/*
@@ -5049,8 +5067,10 @@ static void bfq_update_dispatch_stats(struct request_queue *q,
 	 * before this function ends, and, since rq has a reference to
 	 * bfqq, the same guarantee holds for bfqq too.
 	 *
-	 * In addition, the following queue lock guarantees that
-	 * bfqq_group(bfqq) exists as well.
+	 * The same holds for the requests of @batch, which are
+	 * only made visible to other dispatchers after this
+	 * function. In addition, the following queue lock guarantees
+	 * that bfqq_group(bfqq) exists as well.
 	 */
 	spin_lock_irq(&q->queue_lock);
 	if (idle_timer_disabled)
@@ -5064,28 +5084,53 @@ static void bfq_update_dispatch_stats(struct request_queue *q,
 		 * arguments.
 		 */
 		bfqg_stats_update_idle_time(bfqq_group(in_serv_queue));
-	if (bfqq) {
-		struct bfq_group *bfqg = bfqq_group(bfqq);
-
-		bfqg_stats_update_avg_queue_size(bfqg);
-		bfqg_stats_set_start_empty_time(bfqg);
-		bfqg_stats_update_io_remove(bfqg, rq->cmd_flags);
-	}
+	if (bfqq)
+		bfq_update_rq_dispatch_stats(rq);
+	list_for_each_entry(next, batch, queuelist)
+		bfq_update_rq_dispatch_stats(next);
 	spin_unlock_irq(&q->queue_lock);
 }
 #else
 static inline void bfq_update_dispatch_stats(struct request_queue *q,
 					     struct request *rq,
+					     struct list_head *batch,
 					     struct bfq_queue *in_serv_queue,
 					     bool idle_timer_disabled) {}
 #endif /* CONFIG_BFQ_CGROUP_DEBUG */
 
+/* Number of requests picked per bfqd->lock hold with fast_dispatch */
+#define BFQ_FAST_DISPATCH_BATCH	8
+
+static struct request *bfq_dispatch_prefetched(struct bfq_data *bfqd)
+{
+	struct request *rq = NULL;
+
+	if (list_empty_careful(&bfqd->prefetched))
+		return NULL;
+
+	spin_lock(&bfqd->prefetch_lock);
+	if (!list_empty(&bfqd->prefetched)) {
+		rq = list_first_entry(&bfqd->prefetched, struct request,
+				      queuelist);
+		list_del_init(&rq->queuelist);
+	}
+	spin_unlock(&bfqd->prefetch_lock);
+
+	return rq;
+}
+
 static struct request *bfq_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct bfq_data *bfqd = hctx->queue->elevator->elevator_data;
 	struct request *rq;
 	struct bfq_queue *in_serv_queue;
 	bool waiting_rq, idle_timer_disabled = false;
+	LIST_HEAD(batch);
+
+	/* Left over from the last batch, no need for bfqd->lock */
+	rq = bfq_dispatch_prefetched(bfqd);
+	if (rq)
+		return rq;
 
 	spin_lock_irq(&bfqd->lock);
 
@@ -5098,11 +5143,29 @@ static struct request *bfq_dispatch_request(struct blk_mq_hw_ctx *hctx)
 			waiting_rq && !bfq_bfqq_wait_request(in_serv_queue);
 	}
 
+	if (rq && bfqd->fast_dispatch) {
+		struct request *next;
+		int i;
+
+		for (i = 1; i < BFQ_FAST_DISPATCH_BATCH; i++) {
+			next = __bfq_dispatch_request(hctx);
+			if (!next)
+				break;
+			list_add_tail(&next->queuelist, &batch);
+		}
+	}
+
 	spin_unlock_irq(&bfqd->lock);
-	bfq_update_dispatch_stats(hctx->queue, rq,
+	bfq_update_dispatch_stats(hctx->queue, rq, &batch,
 			idle_timer_disabled ? in_serv_queue : NULL,
 				idle_timer_disabled);
 
+	if (!list_empty(&batch)) {
+		spin_lock(&bfqd->prefetch_lock);
+		list_splice_tail(&batch, &bfqd->prefetched);
+		spin_unlock(&bfqd->prefetch_lock);
+	}
+
 	return rq;
 }
 
@@ -6874,6 +6937,7 @@ static void bfq_exit_queue(struct elevator_queue *e)
 	struct bfq_data *bfqd = e->elevator_data;
 	struct bfq_queue *bfqq, *n;
 
+	WARN_ON_ONCE(!list_empty(&bfqd->prefetched));
 	hrtimer_cancel(&bfqd->idle_slice_timer);
 
 	spin_lock_irq(&bfqd->lock);
@@ -6961,6 +7025,8 @@ static int bfq_init_queue(struct request_queue *q, struct elevator_type *e)
 	bfqd->queue = q;
 
 	INIT_LIST_HEAD(&bfqd->dispatch);
+	INIT_LIST_HEAD(&bfqd->prefetched);
+	spin_lock_init(&bfqd->prefetch_lock);
 
 	hrtimer_init(&bfqd->idle_slice_timer, CLOCK_MONOTONIC,
 		     HRTIMER_MODE_REL);
@@ -7095,6 +7161,7 @@ SHOW_FUNCTION(bfq_max_budget_show, bfqd->bfq_user_max_budget, 0);
 SHOW_FUNCTION(bfq_timeout_sync_show, bfqd->bfq_timeout, 1);
 SHOW_FUNCTION(bfq_strict_guarantees_show, bfqd->strict_guarantees, 0);
 SHOW_FUNCTION(bfq_low_latency_show, bfqd->low_latency, 0);
+SHOW_FUNCTION(bfq_fast_dispatch_show, bfqd->fast_dispatch, 0);
 #undef SHOW_FUNCTION
 
 #define USEC_SHOW_FUNCTION(__FUNC, __VAR)				\
@@ -7255,6 +7322,22 @@ static ssize_t bfq_low_latency_store(struct elevator_queue *e,
 	return count;
 }
 
+static ssize_t bfq_fast_dispatch_store(struct elevator_queue *e,
+				       const char *page, size_t count)
+{
+	struct bfq_data *bfqd = e->elevator_data;
+	unsigned long __data;
+	int ret;
+
+	ret = bfq_var_store(&__data, (page));
+	if (ret)
+		return ret;
+
+	bfqd->fast_dispatch = !!__data;
+
+	return count;
+}
+
 #define BFQ_ATTR(name) \
 	__ATTR(name, 0644, bfq_##name##_show, bfq_##name##_store)
 
@@ -7269,6 +7352,7 @@ static struct elv_fs_entry bfq_attrs[] = {
 	BFQ_ATTR(timeout_sync),
 	BFQ_ATTR(strict_guarantees),
 	BFQ_ATTR(low_latency),
+	BFQ_ATTR(fast_dispatch),
 	__ATTR_NULL
 };
 
@@ -479,6 +479,13 @@ struct bfq_data {
 	struct request_queue *queue;
 	/* dispatch queue */
 	struct list_head dispatch;
+	/*
+	 * Requests already picked by a batched dispatch, see
+	 * bfq_dispatch_request(). Protected by @prefetch_lock, not by
+	 * @lock.
+	 */
+	struct list_head prefetched;
+	spinlock_t prefetch_lock;
 
 	/* root bfq_group for the device */
 	struct bfq_group *root_group;
@@ -684,6 +691,17 @@ struct bfq_data {
 	 */
 	bool strict_guarantees;
 
+	/*
+	 * For devices fast enough that @lock, rather than the device,
+	 * is the bottleneck: never idle the device, and pick up to
+	 * BFQ_FAST_DISPATCH_BATCH requests each time @lock is taken
+	 * for a dispatch. Queues are still served in B-WF2Q+ order,
+	 * so weights are honored, but without idling the service
+	 * guarantees only hold while the queues have requests
+	 * pending.
+	 */
+	bool fast_dispatch;
+
 	/*
 	 * Last time at which a queue entered the current burst of
 	 * queues being activated shortly after each other; for more
@@ -1470,6 +1470,7 @@ void bio_endio(struct bio *bio)
 	}
 
 	blk_throtl_bio_endio(bio);
+	blkcg_lat_hist_add(bio);
 	/* release cgroup info */
 	bio_uninit(bio);
 	if (bio->bi_end_io)
@@ -32,6 +32,7 @@
 #include <linux/psi.h>
 #include "blk.h"
 #include "blk-ioprio.h"
+#include "blk-stat.h"
 
 /*
  * blkcg_pol_mutex protects blkcg_policy[] and policy [de]activation.
@@ -81,6 +82,7 @@ static void blkg_free(struct blkcg_gq *blkg)
 		if (blkg->pd[i])
 			blkcg_policy[i]->pd_free_fn(blkg->pd[i]);
 
+	free_percpu(blkg->lat_hist);
 	free_percpu(blkg->iostat_cpu);
 	percpu_ref_exit(&blkg->refcnt);
 	kfree(blkg);
@@ -140,6 +142,12 @@ static void blkg_async_bio_workfn(struct work_struct *work)
 		blk_finish_plug(&plug);
 }
 
+static struct blk_lat_hist __percpu *blkg_alloc_lat_hist(gfp_t gfp)
+{
+	return __alloc_percpu_gfp(BLK_STAT_NR_OPS * sizeof(struct blk_lat_hist),
+				  __alignof__(struct blk_lat_hist), gfp);
+}
+
 /**
  * blkg_alloc - allocate a blkg
  * @blkcg: block cgroup the new blkg is associated with
@@ -166,6 +174,10 @@ static struct blkcg_gq *blkg_alloc(struct blkcg *blkcg, struct request_queue *q,
 	if (!blkg->iostat_cpu)
 		goto err_free;
 
+	/* not worth failing the blkg for, it'll just go without */
+	if (blk_stat_lat_hist_enabled(q))
+		blkg->lat_hist = blkg_alloc_lat_hist(gfp_mask);
+
 	blkg->q = q;
 	INIT_LIST_HEAD(&blkg->q_node);
 	spin_lock_init(&blkg->async_bio_lock);
@@ -883,6 +895,42 @@ static void blkcg_fill_root_iostats(void)
 	}
 }
 
+/* Latency percentiles of the bios the group itself issued, in usecs */
+static bool blkcg_print_lat_hist(struct blkcg_gq *blkg, struct seq_file *s)
+{
+	static const char op_prefix[BLK_STAT_NR_OPS] = {
+		[BLK_STAT_OP_READ]	= 'r',
+		[BLK_STAT_OP_WRITE]	= 'w',
+		[BLK_STAT_OP_DISCARD]	= 'd',
+		[BLK_STAT_OP_FLUSH]	= 'f',
+	};
+	u64 usecs[ARRAY_SIZE(blk_lat_hist_ppm)];
+	struct blk_lat_hist *sum;
+	bool printed = false;
+	int op;
+
+	/* called under the queue_lock */
+	sum = kmalloc(sizeof(*sum), GFP_NOWAIT);
+	if (!sum)
+		return false;
+
+	for (op = 0; op < BLK_STAT_NR_OPS; op++) {
+		memset(sum, 0, sizeof(*sum));
+		blk_lat_hist_fold(sum, blkg->lat_hist, op);
+		if (!blk_lat_hist_percentiles(sum, blk_lat_hist_ppm, usecs,
+					      ARRAY_SIZE(blk_lat_hist_ppm)))
+			continue;
+
+		seq_printf(s, " %clat_p50=%llu %clat_p90=%llu %clat_p99=%llu %clat_p999=%llu",
+			   op_prefix[op], usecs[0], op_prefix[op], usecs[1],
+			   op_prefix[op], usecs[2], op_prefix[op], usecs[3]);
+		printed = true;
+	}
+	kfree(sum);
+
+	return printed;
+}
+
 static void blkcg_print_one_stat(struct blkcg_gq *blkg, struct seq_file *s)
 {
 	struct blkg_iostat_set *bis = &blkg->iostat;
@@ -919,6 +967,10 @@ static void blkcg_print_one_stat(struct blkcg_gq *blkg, struct seq_file *s)
 			dbytes, dios);
 	}
 
+	if (blkg->lat_hist && blk_stat_lat_hist_enabled(blkg->q) &&
+	    blkcg_print_lat_hist(blkg, s))
+		has_stats = true;
+
 	if (blkcg_debug_stats && atomic_read(&blkg->use_delay)) {
 		has_stats = true;
 		seq_printf(s, " use_delay=%d delay_nsec=%llu",
@@ -1926,6 +1978,49 @@ void blk_cgroup_bio_start(struct bio *bio)
 	put_cpu();
 }
 
+/**
+ * blkcg_enable_lat_hist - give the blkgs of @q latency histograms
+ * @q: request queue which just had its "lat_hist" attribute enabled
+ *
+ * blkgs created from now on get theirs from blkg_alloc().  The histograms are
+ * freed with the blkg, so disabling and enabling again keeps counting on.
+ */
+void blkcg_enable_lat_hist(struct request_queue *q)
+{
+	struct blkcg_gq *blkg;
+
+	spin_lock_irq(&q->queue_lock);
+	list_for_each_entry(blkg, &q->blkg_list, q_node) {
+		struct blk_lat_hist __percpu *hist;
+
+		if (blkg->lat_hist)
+			continue;
+
+		hist = blkg_alloc_lat_hist(GFP_NOWAIT | __GFP_NOWARN);
+		if (!hist)
+			break;
+		WRITE_ONCE(blkg->lat_hist, hist);
+	}
+	spin_unlock_irq(&q->queue_lock);
+}
+
+void __blkcg_lat_hist_add(struct bio *bio)
+{
+	struct blkcg_gq *blkg = bio->bi_blkg;
+	u64 start = bio_issue_time(&bio->bi_issue);
+	u64 now = __bio_issue_time(ktime_get_ns());
+	int op = blk_stat_op(bio->bi_opf);
+	struct blk_lat_hist *hist;
+
+	if (op < 0 || !start || now <= start ||
+	    !blk_stat_lat_hist_enabled(blkg->q))
+		return;
+
+	hist = get_cpu_ptr(blkg->lat_hist);
+	hist[op].nr[blk_lat_hist_bucket(now - start)]++;
+	put_cpu_ptr(hist);
+}
+
 static int __init blkcg_init(void)
 {
 	blkcg_punt_bio_wq = alloc_workqueue("blkcg_punt_bio",
@@ -1641,29 +1641,18 @@ int kblockd_mod_delayed_work_on(int cpu, struct delayed_work *dwork,
 EXPORT_SYMBOL(kblockd_mod_delayed_work_on);
 
 /**
- * blk_start_plug - initialize blk_plug and track it inside the task_struct
+ * blk_start_plug_nr_ios - start a plug expecting a number of requests
  * @plug:	The &struct blk_plug that needs to be initialized
+ * @nr_ios:	How many requests the caller is about to submit
  *
  * Description:
- *   blk_start_plug() indicates to the block layer an intent by the caller
- *   to submit multiple I/O requests in a batch.  The block layer may use
- *   this hint to defer submitting I/Os from the caller until blk_finish_plug()
- *   is called.  However, the block layer may choose to submit requests
- *   before a call to blk_finish_plug() if the number of queued I/Os
- *   exceeds %BLK_MAX_REQUEST_COUNT, or if the size of the I/O is larger than
- *   %BLK_PLUG_FLUSH_SIZE.  The queued I/Os may also be submitted early if
- *   the task schedules (see below).
- *
- *   Tracking blk_plug inside the task_struct will help with auto-flushing the
- *   pending I/O should the task end up blocking between blk_start_plug() and
- *   blk_finish_plug(). This is important from a performance perspective, but
- *   also ensures that we don't deadlock. For instance, if the task is blocking
- *   for a memory allocation, memory reclaim could end up wanting to free a
- *   page belonging to that request that is currently residing in our private
- *   plug. By flushing the pending I/O when the process goes to sleep, we avoid
- *   this kind of deadlock.
+ *   Like blk_start_plug(), but on blk-mq queues without an I/O scheduler the
+ *   first request allocated under the plug takes tags for up to @nr_ios
+ *   requests at once, and the spare requests are kept on the plug for the
+ *   following submissions.  Unused requests are freed when the plug is
+ *   flushed.
  */
-void blk_start_plug(struct blk_plug *plug)
+void blk_start_plug_nr_ios(struct blk_plug *plug, unsigned int nr_ios)
 {
 	struct task_struct *tsk = current;
 
@@ -1675,7 +1664,9 @@ void blk_start_plug(struct blk_plug *plug)
 
 	INIT_LIST_HEAD(&plug->mq_list);
 	INIT_LIST_HEAD(&plug->cb_list);
+	INIT_LIST_HEAD(&plug->cached_rqs);
 	plug->rq_count = 0;
+	plug->nr_ios = min_t(unsigned int, nr_ios, BLK_MAX_REQUEST_COUNT);
 	plug->multiple_queues = false;
 	plug->nowait = false;
 
@@ -1685,6 +1676,34 @@ void blk_start_plug(struct blk_plug *plug)
 	 */
 	tsk->plug = plug;
 }
+
+/**
+ * blk_start_plug - initialize blk_plug and track it inside the task_struct
+ * @plug:	The &struct blk_plug that needs to be initialized
+ *
+ * Description:
+ *   blk_start_plug() indicates to the block layer an intent by the caller
+ *   to submit multiple I/O requests in a batch.  The block layer may use
+ *   this hint to defer submitting I/Os from the caller until blk_finish_plug()
+ *   is called.  However, the block layer may choose to submit requests
+ *   before a call to blk_finish_plug() if the number of queued I/Os
+ *   exceeds %BLK_MAX_REQUEST_COUNT, or if the size of the I/O is larger than
+ *   %BLK_PLUG_FLUSH_SIZE.  The queued I/Os may also be submitted early if
+ *   the task schedules (see below).
+ *
+ *   Tracking blk_plug inside the task_struct will help with auto-flushing the
+ *   pending I/O should the task end up blocking between blk_start_plug() and
+ *   blk_finish_plug(). This is important from a performance perspective, but
+ *   also ensures that we don't deadlock. For instance, if the task is blocking
+ *   for a memory allocation, memory reclaim could end up wanting to free a
+ *   page belonging to that request that is currently residing in our private
+ *   plug. By flushing the pending I/O when the process goes to sleep, we avoid
+ *   this kind of deadlock.
+ */
+void blk_start_plug(struct blk_plug *plug)
+{
+	blk_start_plug_nr_ios(plug, 1);
+}
 EXPORT_SYMBOL(blk_start_plug);
 
 static void flush_plug_callbacks(struct blk_plug *plug, bool from_schedule)
@@ -1735,6 +1754,9 @@ void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 
 	if (!list_empty(&plug->mq_list))
 		blk_mq_flush_plug_list(plug, from_schedule);
+	/* Do not hold on to tags and queue references while sleeping */
+	if (unlikely(!list_empty(&plug->cached_rqs)))
+		blk_mq_free_plug_rqs(plug);
 }
 
 /**
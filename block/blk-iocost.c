@@ -44,7 +44,11 @@
  * /sys/fs/cgroup/io.cost.model.
  *
  * If needed, tools/cgroup/iocost_coef_gen.py can be used to generate
- * device-specific coefficients.
+ * device-specific coefficients.  Alternatively, with "ctrl=fit", the
+ * coefficients are fitted online: completed IOs are fed to a least squares
+ * regression of their on-device time against their size and class, and
+ * the fitted relative costs replace the model every period.  The absolute
+ * scale is left to the vrate control below.
  *
  * 2. Control Strategy
  *
@@ -308,6 +312,17 @@ enum {
 
 	/* if apart further than 16M, consider randio for linear model */
 	LCOEF_RANDIO_PAGES	= 4096,
+
+	/*
+	 * Online model fitting.  Samples decay by 1/16 each period, the fit
+	 * needs enough of them and on-device times are capped to keep the
+	 * sums of squares in range.  Coefficients are computed in usecs with
+	 * 10 bits of fraction.
+	 */
+	IOC_FIT_DECAY_SHIFT	= 4,
+	IOC_FIT_MIN_SAMPLES	= 256,
+	IOC_FIT_MAX_LAT_US	= 100 * USEC_PER_MSEC,
+	IOC_FIT_SHIFT		= 10,
 };
 
 enum ioc_running {
@@ -331,6 +346,7 @@ enum {
 	QOS_WLAT,
 	QOS_MIN,
 	QOS_MAX,
+	QOS_HORIZON,
 	NR_QOS_PARAMS,
 };
 
@@ -391,11 +407,39 @@ struct ioc_missed {
 	u32				last_missed;
 };
 
+/*
+ * Sums over the completed IOs of one direction for fitting the linear model.
+ * [0] is for sequential and [1] for random IOs, pages and on-device times in
+ * usecs are the regressors and the response.
+ */
+struct ioc_fit_sums {
+	u64				nr[2];
+	u64				pages[2];
+	u64				lat_us[2];
+	u64				pages_sq;
+	u64				pages_lat;
+	u64				lat_sq;
+};
+
+/* per-cpu version of ioc_fit_sums, updated from completions */
+struct ioc_pcpu_fit {
+	local64_t			nr[2];
+	local64_t			pages[2];
+	local64_t			lat_us[2];
+	local64_t			pages_sq;
+	local64_t			pages_lat;
+	local64_t			lat_sq;
+};
+
 struct ioc_pcpu_stat {
 	struct ioc_missed		missed[2];
 
 	local64_t			rq_wait_ns;
 	u64				last_rq_wait_ns;
+
+	struct ioc_pcpu_fit		fit[2];
+	struct ioc_fit_sums		last_fit[2];
+	sector_t			fit_cursor;
 };
 
 /* per device */
@@ -441,6 +485,11 @@ struct ioc {
 	int				autop_idx;
 	bool				user_qos_params:1;
 	bool				user_cost_model:1;
+
+	/* online model fitting, see ioc_fit_model() */
+	bool				fit_cost_model;
+	struct ioc_fit_sums		fit[2];
+	u32				fit_res_us[2];
 };
 
 struct iocg_pcpu_stat {
@@ -920,7 +969,7 @@ static bool ioc_refresh_params(struct ioc *ioc, bool force)
 
 	if (!ioc->user_qos_params)
 		memcpy(ioc->params.qos, p->qos, sizeof(p->qos));
-	if (!ioc->user_cost_model)
+	if (!ioc->user_cost_model && !ioc->fit_cost_model)
 		memcpy(ioc->params.i_lcoefs, p->i_lcoefs, sizeof(p->i_lcoefs));
 
 	ioc_refresh_period_us(ioc);
@@ -971,6 +1020,52 @@ static void ioc_refresh_vrate(struct ioc *ioc, struct ioc_now *now)
 	ioc->vtime_err = clamp(ioc->vtime_err, -vperiod, vperiod);
 }
 
+/*
+ * Receding horizon vrate control, enabled by a non-zero "horizon" in
+ * io.cost.qos.  Instead of stepping vrate by the busy_level history, plan a
+ * path to the vrate which the last period's latencies call for, reaching it
+ * in @horizon periods.  Only the first step is taken and the plan is redone
+ * from the new measurements in the next period.
+ */
+static u64 ioc_horizon_vrate(struct ioc *ioc, u32 rq_wait_pct,
+			     int nr_lagging, int nr_shortages, u32 *missed_ppm)
+{
+	u32 ppm_thr[2] = { MILLION - ioc->params.qos[QOS_RPPM],
+			   MILLION - ioc->params.qos[QOS_WPPM] };
+	u32 horizon = ioc->params.qos[QOS_HORIZON];
+	u64 vrate = ioc->vtime_base_rate, target = vrate;
+	u32 pressure_pct;
+	int rw;
+
+	/* how far over the QoS targets the last period was, 100 is on target */
+	pressure_pct = rq_wait_pct * 100 / RQ_WAIT_BUSY_PCT;
+	for (rw = READ; rw <= WRITE; rw++) {
+		if (!missed_ppm[rw])
+			continue;
+		if (!ppm_thr[rw])
+			pressure_pct = max(pressure_pct, 200U);
+		else
+			pressure_pct = max_t(u32, pressure_pct,
+				div_u64((u64)missed_ppm[rw] * 100, ppm_thr[rw]));
+	}
+
+	if (pressure_pct > 100) {
+		/* at most halve the target per period */
+		target = div64_u64(vrate * 100, min(pressure_pct, 200U));
+	} else if (pressure_pct <= UNBUSY_THR_PCT && nr_shortages &&
+		   !nr_lagging) {
+		/* throttling with spare capacity, aim up to twice as fast */
+		target = div64_u64(vrate * 100, max(pressure_pct, 50U));
+	}
+
+	if (target > vrate)
+		vrate += div64_u64(target - vrate, horizon);
+	else
+		vrate -= div64_u64(vrate - target, horizon);
+
+	return clamp(vrate, ioc->vrate_min, ioc->vrate_max);
+}
+
 static void ioc_adjust_base_vrate(struct ioc *ioc, u32 rq_wait_pct,
 				  int nr_lagging, int nr_shortages,
 				  int prev_busy_level, u32 *missed_ppm)
@@ -978,6 +1073,12 @@ static void ioc_adjust_base_vrate(struct ioc *ioc, u32 rq_wait_pct,
 	u64 vrate = ioc->vtime_base_rate;
 	u64 vrate_min = ioc->vrate_min, vrate_max = ioc->vrate_max;
 
+	if (ioc->params.qos[QOS_HORIZON]) {
+		vrate = ioc_horizon_vrate(ioc, rq_wait_pct, nr_lagging,
+					  nr_shortages, missed_ppm);
+		goto out;
+	}
+
 	if (!ioc->busy_level || (ioc->busy_level < 0 && nr_lagging)) {
 		if (ioc->busy_level != prev_busy_level || nr_lagging)
 			trace_iocost_ioc_vrate_adj(ioc, atomic64_read(&ioc->vtime_rate),
@@ -1011,7 +1112,7 @@ static void ioc_adjust_base_vrate(struct ioc *ioc, u32 rq_wait_pct,
 		vrate = clamp(DIV64_U64_ROUND_UP(vrate * adj_pct, 100),
 			      vrate_min, vrate_max);
 	}
-
+out:
 	trace_iocost_ioc_vrate_adj(ioc, vrate, missed_ppm, rq_wait_pct,
 				   nr_lagging, nr_shortages);
 
@@ -1597,6 +1698,159 @@ static void ioc_lat_stat(struct ioc *ioc, u32 *missed_ppm_ar, u32 *rq_wait_pct_p
 				   ioc->period_us * NSEC_PER_USEC);
 }
 
+/* collect the model fitting samples completed during the period */
+static void ioc_fit_harvest(struct ioc *ioc, struct ioc_fit_sums *sums)
+{
+	int cpu, rw;
+
+	memset(sums, 0, 2 * sizeof(*sums));
+
+	for_each_online_cpu(cpu) {
+		struct ioc_pcpu_stat *stat = per_cpu_ptr(ioc->pcpu_stat, cpu);
+
+		for (rw = READ; rw <= WRITE; rw++) {
+			struct ioc_pcpu_fit *pf = &stat->fit[rw];
+			struct ioc_fit_sums *last = &stat->last_fit[rw];
+			struct ioc_fit_sums *sum = &sums[rw];
+			u64 v;
+
+#define IOC_FIT_HARVEST(field) do {					\
+	v = local64_read(&pf->field);					\
+	sum->field += v - last->field;					\
+	last->field = v;						\
+} while (0)
+			IOC_FIT_HARVEST(nr[0]);
+			IOC_FIT_HARVEST(nr[1]);
+			IOC_FIT_HARVEST(pages[0]);
+			IOC_FIT_HARVEST(pages[1]);
+			IOC_FIT_HARVEST(lat_us[0]);
+			IOC_FIT_HARVEST(lat_us[1]);
+			IOC_FIT_HARVEST(pages_sq);
+			IOC_FIT_HARVEST(pages_lat);
+			IOC_FIT_HARVEST(lat_sq);
+#undef IOC_FIT_HARVEST
+		}
+	}
+}
+
+static void ioc_fit_decay_add(struct ioc_fit_sums *s,
+			      const struct ioc_fit_sums *d)
+{
+	u64 *v = (u64 *)s;
+	const u64 *dv = (const u64 *)d;
+	int i;
+
+	for (i = 0; i < sizeof(*s) / sizeof(u64); i++)
+		v[i] += dv[i] - (v[i] >> IOC_FIT_DECAY_SHIFT);
+}
+
+/*
+ * Least squares fit of on-device time = page * pages + seqio or randio.  As
+ * an IO is either sequential or random, the per-page cost is the pooled
+ * slope within the two classes and the per-IO costs follow from the class
+ * means.  @raw receives page, seqio and randio costs in usecs <<
+ * IOC_FIT_SHIFT.  Returns false if there isn't enough data, most notably if
+ * all IOs are of about the same size.
+ */
+static bool ioc_fit_dir(const struct ioc_fit_sums *s, u64 *raw, u32 *res_us)
+{
+	u64 nr = s->nr[0] + s->nr[1];
+	s64 var = s->pages_sq, cov = s->pages_lat, sse = s->lat_sq;
+	u64 a;
+	int i;
+
+	if (nr < IOC_FIT_MIN_SAMPLES)
+		return false;
+
+	for (i = 0; i < 2; i++) {
+		if (!s->nr[i])
+			continue;
+		var -= mul_u64_u64_div_u64(s->pages[i], s->pages[i], s->nr[i]);
+		cov -= mul_u64_u64_div_u64(s->pages[i], s->lat_us[i], s->nr[i]);
+	}
+
+	if (var < (s64)nr)
+		return false;
+
+	a = cov > 0 ? div64_u64((u64)cov << IOC_FIT_SHIFT, var) : 0;
+	raw[0] = a;
+	sse -= mul_u64_u64_div_u64(a, s->pages_lat, 1 << IOC_FIT_SHIFT);
+
+	for (i = 0; i < 2; i++) {
+		s64 v = 0;
+
+		if (s->nr[i])
+			v = div64_s64((s64)(s->lat_us[i] << IOC_FIT_SHIFT) -
+				      (s64)(a * s->pages[i]), s->nr[i]);
+		raw[1 + i] = max_t(s64, v, 0);
+		sse -= mul_u64_u64_div_u64(raw[1 + i], s->lat_us[i],
+					   1 << IOC_FIT_SHIFT);
+	}
+
+	*res_us = int_sqrt64(div64_u64(max_t(s64, sse, 0), nr));
+	return true;
+}
+
+/*
+ * Refit the linear model from the samples of the last periods.  Only the
+ * relative costs are taken from the fit.  The result is scaled so that the
+ * recent IOs cost the same in total as with the current model, which keeps
+ * vrate continuous; on-device times with many IOs in flight overstate the
+ * absolute costs anyway.  Coefficients without samples, e.g. randio while
+ * only sequential IOs are issued, are kept.
+ */
+static void ioc_fit_model(struct ioc *ioc, const struct ioc_fit_sums *delta)
+{
+	u64 *c = ioc->params.lcoefs, *u = ioc->params.i_lcoefs;
+	u64 raw[NR_LCOEFS], weight[NR_LCOEFS] = { }, lc[NR_LCOEFS];
+	u64 old_total = 0, new_total = 0;
+	int rw, i;
+
+	lockdep_assert_held(&ioc->lock);
+
+	for (rw = READ; rw <= WRITE; rw++) {
+		struct ioc_fit_sums *s = &ioc->fit[rw];
+		int base = rw == READ ? LCOEF_RPAGE : LCOEF_WPAGE;
+
+		ioc_fit_decay_add(s, &delta[rw]);
+		if (!ioc_fit_dir(s, &raw[base], &ioc->fit_res_us[rw]))
+			continue;
+
+		weight[base] = s->pages[0] + s->pages[1];
+		weight[base + 1] = s->nr[0];
+		weight[base + 2] = s->nr[1];
+	}
+
+	for (i = 0; i < NR_LCOEFS; i++) {
+		if (!weight[i])
+			continue;
+		old_total += c[i] * weight[i];
+		new_total += raw[i] * weight[i];
+	}
+	if (!old_total || !new_total)
+		return;
+
+	for (i = 0; i < NR_LCOEFS; i++)
+		lc[i] = weight[i] ? mul_u64_u64_div_u64(raw[i], old_total,
+							new_total) : c[i];
+
+	/* and back to the bps and iops form of io.cost.model */
+	for (rw = READ; rw <= WRITE; rw++) {
+		int base = rw == READ ? LCOEF_RPAGE : LCOEF_WPAGE;
+		int ibase = rw == READ ? I_LCOEF_RBPS : I_LCOEF_WBPS;
+		u64 page = lc[base];
+
+		u[ibase] = page ? div64_u64(VTIME_PER_SEC * IOC_PAGE_SIZE,
+					    page) : 0;
+		for (i = 1; i <= 2; i++)
+			u[ibase + i] = page + lc[base + i] ?
+				div64_u64(VTIME_PER_SEC, page + lc[base + i]) :
+				0;
+	}
+
+	ioc_refresh_lcoefs(ioc);
+}
+
 /* was iocg idle this period? */
 static bool iocg_is_idle(struct ioc_gq *iocg)
 {
@@ -2217,11 +2471,15 @@ static void ioc_timer_fn(struct timer_list *timer)
 	u32 ppm_rthr = MILLION - ioc->params.qos[QOS_RPPM];
 	u32 ppm_wthr = MILLION - ioc->params.qos[QOS_WPPM];
 	u32 missed_ppm[2], rq_wait_pct;
+	struct ioc_fit_sums fit[2];
+	bool fitting = READ_ONCE(ioc->fit_cost_model);
 	u64 period_vtime;
 	int prev_busy_level;
 
 	/* how were the latencies during the period? */
 	ioc_lat_stat(ioc, missed_ppm, &rq_wait_pct);
+	if (fitting)
+		ioc_fit_harvest(ioc, fit);
 
 	/* take care of active iocgs */
 	spin_lock_irq(&ioc->lock);
@@ -2405,6 +2663,9 @@ static void ioc_timer_fn(struct timer_list *timer)
 	ioc_adjust_base_vrate(ioc, rq_wait_pct, nr_lagging, nr_shortages,
 			      prev_busy_level, missed_ppm);
 
+	if (fitting && ioc->fit_cost_model)
+		ioc_fit_model(ioc, fit);
+
 	ioc_refresh_params(ioc, false);
 
 	ioc_forgive_debts(ioc, usage_us_sum, nr_debtors, &now);
@@ -2766,11 +3027,44 @@ static void ioc_rqos_done_bio(struct rq_qos *rqos, struct bio *bio)
 		atomic64_add(bio->bi_iocost_cost, &iocg->done_vtime);
 }
 
+/* feed a completed IO to the model fitting, see ioc_fit_model() */
+static void ioc_fit_sample(struct ioc_pcpu_stat *ccs, struct request *rq,
+			   int rw, u64 now)
+{
+	struct ioc_pcpu_fit *pf = &ccs->fit[rw];
+	u64 pages, lat_us, seek_pages;
+	sector_t pos = blk_rq_pos(rq);
+	int rand;
+
+	if (!rq->io_start_time_ns || now <= rq->io_start_time_ns)
+		return;
+
+	pages = max_t(u64, blk_rq_stats_sectors(rq) >> IOC_SECT_TO_PAGE_SHIFT,
+		      1);
+	lat_us = min_t(u64, div_u64(now - rq->io_start_time_ns, NSEC_PER_USEC),
+		       IOC_FIT_MAX_LAT_US);
+
+	/*
+	 * Classify against the previous completion on this CPU. Not exactly
+	 * what the issue path sees but close enough for the fit.
+	 */
+	seek_pages = abs((s64)(pos - ccs->fit_cursor)) >> IOC_SECT_TO_PAGE_SHIFT;
+	rand = seek_pages > LCOEF_RANDIO_PAGES;
+	ccs->fit_cursor = pos + blk_rq_stats_sectors(rq);
+
+	local64_inc(&pf->nr[rand]);
+	local64_add(pages, &pf->pages[rand]);
+	local64_add(lat_us, &pf->lat_us[rand]);
+	local64_add(pages * pages, &pf->pages_sq);
+	local64_add(pages * lat_us, &pf->pages_lat);
+	local64_add(lat_us * lat_us, &pf->lat_sq);
+}
+
 static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
 {
 	struct ioc *ioc = rqos_to_ioc(rqos);
 	struct ioc_pcpu_stat *ccs;
-	u64 on_q_ns, rq_wait_ns, size_nsec;
+	u64 now, on_q_ns, rq_wait_ns, size_nsec;
 	int pidx, rw;
 
 	if (!ioc->enabled || !rq->alloc_time_ns || !rq->start_time_ns)
@@ -2789,7 +3083,8 @@ static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
 		return;
 	}
 
-	on_q_ns = ktime_get_ns() - rq->alloc_time_ns;
+	now = ktime_get_ns();
+	on_q_ns = now - rq->alloc_time_ns;
 	rq_wait_ns = rq->start_time_ns - rq->alloc_time_ns;
 	size_nsec = div64_u64(calc_size_vtime_cost(rq, ioc), VTIME_PER_NSEC);
 
@@ -2803,6 +3098,9 @@ static void ioc_rqos_done(struct rq_qos *rqos, struct request *rq)
 
 	local64_add(rq_wait_ns, &ccs->rq_wait_ns);
 
+	if (READ_ONCE(ioc->fit_cost_model))
+		ioc_fit_sample(ccs, rq, rw, now);
+
 	put_cpu_ptr(ccs);
 }
 
@@ -3024,6 +3322,10 @@ static bool ioc_pd_stat(struct blkg_policy_data *pd, struct seq_file *s)
 			ioc->vtime_base_rate * 10000,
 			VTIME_PER_USEC);
 		seq_printf(s, " cost.vrate=%u.%02u", vp10k / 100, vp10k % 100);
+		if (ioc->fit_cost_model)
+			seq_printf(s, " cost.fit_rres_us=%u cost.fit_wres_us=%u",
+				   ioc->fit_res_us[READ],
+				   ioc->fit_res_us[WRITE]);
 	}
 
 	seq_printf(s, " cost.usage=%llu", iocg->last_stat.usage_us);
@@ -3134,7 +3436,7 @@ static u64 ioc_qos_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
 	if (!dname)
 		return 0;
 
-	seq_printf(sf, "%s enable=%d ctrl=%s rpct=%u.%02u rlat=%u wpct=%u.%02u wlat=%u min=%u.%02u max=%u.%02u\n",
+	seq_printf(sf, "%s enable=%d ctrl=%s rpct=%u.%02u rlat=%u wpct=%u.%02u wlat=%u min=%u.%02u max=%u.%02u horizon=%u\n",
 		   dname, ioc->enabled, ioc->user_qos_params ? "user" : "auto",
 		   ioc->params.qos[QOS_RPPM] / 10000,
 		   ioc->params.qos[QOS_RPPM] % 10000 / 100,
@@ -3145,7 +3447,8 @@ static u64 ioc_qos_prfill(struct seq_file *sf, struct blkg_policy_data *pd,
 		   ioc->params.qos[QOS_MIN] / 10000,
 		   ioc->params.qos[QOS_MIN] % 10000 / 100,
 		   ioc->params.qos[QOS_MAX] / 10000,
-		   ioc->params.qos[QOS_MAX] % 10000 / 100);
+		   ioc->params.qos[QOS_MAX] % 10000 / 100,
+		   ioc->params.qos[QOS_HORIZON]);
 	return 0;
 }
 
@@ -3171,6 +3474,7 @@ static const match_table_t qos_tokens = {
 	{ QOS_WLAT,		"wlat=%u"	},
 	{ QOS_MIN,		"min=%s"	},
 	{ QOS_MAX,		"max=%s"	},
+	{ QOS_HORIZON,		"horizon=%u"	},
 	{ NR_QOS_PARAMS,	NULL		},
 };
 
@@ -3258,6 +3562,11 @@ static ssize_t ioc_qos_write(struct kernfs_open_file *of, char *input,
 			qos[tok] = clamp_t(s64, v * 100,
 					   VRATE_MIN_PPM, VRATE_MAX_PPM);
 			break;
+		case QOS_HORIZON:
+			if (match_u64(&args[0], &v) || v > 1000)
+				goto einval;
+			qos[tok] = v;
+			break;
 		default:
 			goto einval;
 		}
@@ -3310,7 +3619,8 @@ static u64 ioc_cost_model_prfill(struct seq_file *sf,
 	seq_printf(sf, "%s ctrl=%s model=linear "
 		   "rbps=%llu rseqiops=%llu rrandiops=%llu "
 		   "wbps=%llu wseqiops=%llu wrandiops=%llu\n",
-		   dname, ioc->user_cost_model ? "user" : "auto",
+		   dname, ioc->fit_cost_model ? "fit" :
+		   ioc->user_cost_model ? "user" : "auto",
 		   u[I_LCOEF_RBPS], u[I_LCOEF_RSEQIOPS], u[I_LCOEF_RRANDIOPS],
 		   u[I_LCOEF_WBPS], u[I_LCOEF_WSEQIOPS], u[I_LCOEF_WRANDIOPS]);
 	return 0;
@@ -3347,7 +3657,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	struct block_device *bdev;
 	struct ioc *ioc;
 	u64 u[NR_I_LCOEFS];
-	bool user;
+	bool user, fit;
 	char *p;
 	int ret;
 
@@ -3366,6 +3676,7 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	spin_lock_irq(&ioc->lock);
 	memcpy(u, ioc->params.i_lcoefs, sizeof(u));
 	user = ioc->user_cost_model;
+	fit = ioc->fit_cost_model;
 	spin_unlock_irq(&ioc->lock);
 
 	while ((p = strsep(&input, " \t\n"))) {
@@ -3381,9 +3692,11 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 		case COST_CTRL:
 			match_strlcpy(buf, &args[0], sizeof(buf));
 			if (!strcmp(buf, "auto"))
-				user = false;
+				user = fit = false;
 			else if (!strcmp(buf, "user"))
-				user = true;
+				user = true, fit = false;
+			else if (!strcmp(buf, "fit"))
+				fit = true;
 			else
 				goto einval;
 			continue;
@@ -3404,12 +3717,15 @@ static ssize_t ioc_cost_model_write(struct kernfs_open_file *of, char *input,
 	}
 
 	spin_lock_irq(&ioc->lock);
-	if (user) {
+	/* explicit coefficients are the starting point for fitting */
+	if (user)
 		memcpy(ioc->params.i_lcoefs, u, sizeof(u));
-		ioc->user_cost_model = true;
-	} else {
-		ioc->user_cost_model = false;
+	ioc->user_cost_model = user && !fit;
+	if (fit && !ioc->fit_cost_model) {
+		memset(ioc->fit, 0, sizeof(ioc->fit));
+		memset(ioc->fit_res_us, 0, sizeof(ioc->fit_res_us));
 	}
+	WRITE_ONCE(ioc->fit_cost_model, fit);
 	ioc_refresh_params(ioc, true);
 	spin_unlock_irq(&ioc->lock);
 
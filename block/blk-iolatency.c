@@ -62,6 +62,12 @@
  * root cg issued io's, wethere that's some metadata intensive operation or the
  * group is using so much memory that it is pushing us into swap.
  *
+ * Buffered writeback is additionally limited per group on behalf of wbt, see
+ * blk_iolatency_wbt_throttle().  Every group gets its own share of the wbt
+ * depth, and when the reads of a group with a target miss it more than 10% of
+ * the time, the writeback share of its siblings with a looser (or no) target
+ * is halved.  The shares recover once the reads have been fine for a second.
+ *
  * Copyright (C) 2018 Josef Bacik
  */
 #include <linux/kernel.h>
@@ -79,6 +85,7 @@
 #include "blk.h"
 
 #define DEFAULT_SCALE_COOKIE 1000000U
+#define WB_SCALE_MAX 1024U
 
 static struct blkcg_policy blkcg_policy_iolatency;
 struct iolatency_grp;
@@ -121,6 +128,15 @@ struct child_latency_info {
 
 	/* Cookie to tell if we need to scale up or down. */
 	atomic_t scale_cookie;
+
+	/* Writeback share of the children, out of WB_SCALE_MAX. */
+	atomic_t wb_scale;
+
+	/* The tightest target whose reads scaled the writeback down. */
+	u64 wb_scale_lat;
+
+	/* Last time the reads of a child missed their target. */
+	u64 wb_last_event;
 };
 
 struct percentile_stats {
@@ -133,6 +149,9 @@ struct latency_stat {
 		struct percentile_stats ps;
 		struct blk_rq_stat rqs;
 	};
+	/* reads alone, for the writeback feedback */
+	u64 rd_total;
+	u64 rd_missed;
 };
 
 struct iolatency_grp {
@@ -142,6 +161,9 @@ struct iolatency_grp {
 	struct blk_iolatency *blkiolat;
 	struct rq_depth rq_depth;
 	struct rq_wait rq_wait;
+	/* writeback in flight and time spent waiting for it, for wbt */
+	struct rq_wait wb_rq_wait;
+	atomic64_t wb_throttle_ns;
 	atomic64_t window_start;
 	atomic_t scale_cookie;
 	u64 min_lat_nsec;
@@ -202,6 +224,8 @@ static inline void latency_stat_init(struct iolatency_grp *iolat,
 		stat->ps.missed = 0;
 	} else
 		blk_rq_stat_init(&stat->rqs);
+	stat->rd_total = 0;
+	stat->rd_missed = 0;
 }
 
 static inline void latency_stat_sum(struct iolatency_grp *iolat,
@@ -213,12 +237,19 @@ static inline void latency_stat_sum(struct iolatency_grp *iolat,
 		sum->ps.missed += stat->ps.missed;
 	} else
 		blk_rq_stat_sum(&sum->rqs, &stat->rqs);
+	sum->rd_total += stat->rd_total;
+	sum->rd_missed += stat->rd_missed;
 }
 
 static inline void latency_stat_record_time(struct iolatency_grp *iolat,
-					    u64 req_time)
+					    u64 req_time, bool read)
 {
 	struct latency_stat *stat = get_cpu_ptr(iolat->stats);
+	if (read) {
+		if (req_time >= iolat->min_lat_nsec)
+			stat->rd_missed++;
+		stat->rd_total++;
+	}
 	if (iolat->ssd) {
 		if (req_time >= iolat->min_lat_nsec)
 			stat->ps.missed++;
@@ -489,7 +520,7 @@ static void blkcg_iolatency_throttle(struct rq_qos *rqos, struct bio *bio)
 
 static void iolatency_record_time(struct iolatency_grp *iolat,
 				  struct bio_issue *issue, u64 now,
-				  bool issue_as_root)
+				  bool issue_as_root, bool read)
 {
 	u64 start = bio_issue_time(issue);
 	u64 req_time;
@@ -516,12 +547,44 @@ static void iolatency_record_time(struct iolatency_grp *iolat,
 		return;
 	}
 
-	latency_stat_record_time(iolat, req_time);
+	latency_stat_record_time(iolat, req_time, read);
 }
 
 #define BLKIOLATENCY_MIN_ADJUST_TIME (500 * NSEC_PER_MSEC)
 #define BLKIOLATENCY_MIN_GOOD_SAMPLES 5
 
+/*
+ * If our reads missed the target, halve the writeback share of our siblings.
+ * Scaling back up is left to the timer.
+ */
+static void iolatency_check_wb_scale(struct iolatency_grp *iolat,
+				     struct child_latency_info *lat_info,
+				     struct latency_stat *stat, u64 now)
+{
+	unsigned long flags;
+	unsigned int scale;
+	u64 thresh;
+
+	if (stat->rd_total < BLKIOLATENCY_MIN_GOOD_SAMPLES)
+		return;
+
+	thresh = max(div64_u64(stat->rd_total, 10), 1ULL);
+	if (stat->rd_missed < thresh)
+		return;
+
+	spin_lock_irqsave(&lat_info->lock, flags);
+	if (lat_info->wb_last_event < now &&
+	    now - lat_info->wb_last_event >= BLKIOLATENCY_MIN_ADJUST_TIME) {
+		scale = atomic_read(&lat_info->wb_scale);
+		atomic_set(&lat_info->wb_scale, max(scale >> 1, 1U));
+		if (!lat_info->wb_scale_lat ||
+		    lat_info->wb_scale_lat > iolat->min_lat_nsec)
+			WRITE_ONCE(lat_info->wb_scale_lat, iolat->min_lat_nsec);
+		lat_info->wb_last_event = now;
+	}
+	spin_unlock_irqrestore(&lat_info->lock, flags);
+}
+
 static void iolatency_check_latencies(struct iolatency_grp *iolat, u64 now)
 {
 	struct blkcg_gq *blkg = lat_to_blkg(iolat);
@@ -548,6 +611,7 @@ static void iolatency_check_latencies(struct iolatency_grp *iolat, u64 now)
 	lat_info = &parent->child_lat;
 
 	iolat_update_total_lat_avg(iolat, &stat);
+	iolatency_check_wb_scale(iolat, lat_info, &stat, now);
 
 	/* Everything is ok and we don't need to adjust the scale. */
 	if (latency_sum_ok(iolat, &stat) &&
@@ -628,7 +692,8 @@ static void blkcg_iolatency_done_bio(struct rq_qos *rqos, struct bio *bio)
 		 */
 		if (iolat->min_lat_nsec && bio->bi_status != BLK_STS_AGAIN) {
 			iolatency_record_time(iolat, &bio->bi_issue, now,
-					      issue_as_root);
+					      issue_as_root,
+					      bio_op(bio) == REQ_OP_READ);
 			window_start = atomic64_read(&iolat->window_start);
 			if (now > window_start &&
 			    (now - window_start) >= iolat->cur_win_nsec) {
@@ -658,6 +723,27 @@ static struct rq_qos_ops blkcg_iolatency_ops = {
 	.exit = blkcg_iolatency_exit,
 };
 
+/* Give the children back a quarter of their writeback share every second. */
+static void iolatency_wb_scale_up(struct child_latency_info *lat_info, u64 now)
+{
+	unsigned long flags;
+	unsigned int scale;
+
+	if (atomic_read(&lat_info->wb_scale) >= WB_SCALE_MAX)
+		return;
+
+	spin_lock_irqsave(&lat_info->lock, flags);
+	if (lat_info->wb_last_event < now &&
+	    now - lat_info->wb_last_event >= NSEC_PER_SEC) {
+		scale = atomic_read(&lat_info->wb_scale);
+		scale = min(scale + max(scale >> 2, 1U), WB_SCALE_MAX);
+		atomic_set(&lat_info->wb_scale, scale);
+		if (scale == WB_SCALE_MAX)
+			WRITE_ONCE(lat_info->wb_scale_lat, 0);
+	}
+	spin_unlock_irqrestore(&lat_info->lock, flags);
+}
+
 static void blkiolatency_timer_fn(struct timer_list *t)
 {
 	struct blk_iolatency *blkiolat = from_timer(blkiolat, t, timer);
@@ -685,6 +771,7 @@ static void blkiolatency_timer_fn(struct timer_list *t)
 			goto next;
 
 		lat_info = &iolat->child_lat;
+		iolatency_wb_scale_up(lat_info, now);
 		cookie = atomic_read(&lat_info->scale_cookie);
 
 		if (cookie >= DEFAULT_SCALE_COOKIE)
@@ -757,6 +844,114 @@ static void blkiolatency_enable_work_fn(struct work_struct *work)
 	}
 }
 
+/* Scale the wbt @limit by the writeback share @iolat got from its parent. */
+static unsigned int iolatency_wb_limit(struct iolatency_grp *iolat,
+				       unsigned int limit)
+{
+	struct blkcg_gq *blkg = lat_to_blkg(iolat);
+	struct iolatency_grp *parent = blkg_to_lat(blkg->parent);
+	struct child_latency_info *lat_info;
+	unsigned int scale;
+
+	if (!parent || limit == UINT_MAX)
+		return limit;
+
+	lat_info = &parent->child_lat;
+	scale = atomic_read(&lat_info->wb_scale);
+	if (scale >= WB_SCALE_MAX)
+		return limit;
+
+	/* Don't take it out on the groups which asked for the scale down. */
+	if (iolat->min_lat_nsec &&
+	    iolat->min_lat_nsec <= READ_ONCE(lat_info->wb_scale_lat))
+		return limit;
+
+	return max_t(unsigned int, div_u64((u64)limit * scale, WB_SCALE_MAX),
+		     1);
+}
+
+struct iolatency_wb_data {
+	struct blkcg_gq *blkg;
+	unsigned int limit;
+};
+
+static bool iolatency_wb_acquire_inflight(struct rq_wait *rqw,
+					  void *private_data)
+{
+	struct iolatency_wb_data *data = private_data;
+	struct blkcg_gq *blkg = data->blkg;
+	unsigned int limit = data->limit;
+
+	/* the tightest share on the way up to the root applies */
+	for (; blkg && blkg->parent; blkg = blkg->parent) {
+		struct iolatency_grp *iolat = blkg_to_lat(blkg);
+
+		if (iolat)
+			limit = min(limit,
+				    iolatency_wb_limit(iolat, data->limit));
+	}
+
+	return rq_wait_inc_below(rqw, limit);
+}
+
+/**
+ * blk_iolatency_wbt_throttle - throttle writeback per cgroup
+ * @bio: the tracked write wbt is about to throttle
+ * @limit: the queue wide wbt limit for @bio
+ *
+ * Called by wbt before it takes a queue wide slot.  Once any group has a
+ * latency target on the device, the writeback of every group is limited to
+ * its share of @limit.  The slot is released by blk_iolatency_wbt_done().
+ */
+void blk_iolatency_wbt_throttle(struct bio *bio, unsigned int limit)
+{
+	struct request_queue *q = bdev_get_queue(bio->bi_bdev);
+	struct rq_qos *rqos = blkcg_rq_qos(q);
+	struct iolatency_grp *iolat;
+	struct iolatency_wb_data data;
+	u64 start;
+
+	if (!rqos || !BLKIOLATENCY(rqos)->enabled)
+		return;
+	if (!bio->bi_blkg || !bio->bi_blkg->parent ||
+	    bio_issue_as_root_blkg(bio))
+		return;
+
+	iolat = blkg_to_lat(bio->bi_blkg);
+	if (!iolat)
+		return;
+
+	bio_set_flag(bio, BIO_WBT_CGROUP);
+	data.blkg = bio->bi_blkg;
+	data.limit = limit;
+	if (iolatency_wb_acquire_inflight(&iolat->wb_rq_wait, &data))
+		return;
+
+	start = ktime_get_ns();
+	rq_qos_wait(&iolat->wb_rq_wait, &data, iolatency_wb_acquire_inflight,
+		    iolat_cleanup_cb);
+	atomic64_add(ktime_get_ns() - start, &iolat->wb_throttle_ns);
+}
+
+/**
+ * blk_iolatency_wbt_done - release the writeback slot of a bio
+ * @bio: bio which may have been throttled by blk_iolatency_wbt_throttle()
+ */
+void blk_iolatency_wbt_done(struct bio *bio)
+{
+	struct iolatency_grp *iolat;
+
+	if (!bio_flagged(bio, BIO_WBT_CGROUP))
+		return;
+	bio_clear_flag(bio, BIO_WBT_CGROUP);
+
+	iolat = blkg_to_lat(bio->bi_blkg);
+	if (WARN_ON_ONCE(!iolat))
+		return;
+
+	iolat_cleanup_cb(&iolat->wb_rq_wait, NULL);
+}
+
 int blk_iolatency_init(struct request_queue *q)
 {
 	struct blk_iolatency *blkiolat;
@@ -827,6 +1022,9 @@ static void iolatency_clear_scaling(struct blkcg_gq *blkg)
 		lat_info->last_scale_event = 0;
 		lat_info->scale_grp = NULL;
 		lat_info->scale_lat = 0;
+		atomic_set(&lat_info->wb_scale, WB_SCALE_MAX);
+		lat_info->wb_scale_lat = 0;
+		lat_info->wb_last_event = 0;
 		spin_unlock(&lat_info->lock);
 	}
 }
@@ -935,11 +1133,17 @@ static bool iolatency_ssd_stat(struct iolatency_grp *iolat, struct seq_file *s)
 static bool iolatency_pd_stat(struct blkg_policy_data *pd, struct seq_file *s)
 {
 	struct iolatency_grp *iolat = pd_to_lat(pd);
+	u64 wb_throttle_ns = atomic64_read(&iolat->wb_throttle_ns);
 	unsigned long long avg_lat;
 	unsigned long long cur_win;
 
+	if (wb_throttle_ns)
+		seq_printf(s, " wbt_inflight=%d wbt_throttle_usec=%llu",
+			   atomic_read(&iolat->wb_rq_wait.inflight),
+			   div64_u64(wb_throttle_ns, NSEC_PER_USEC));
+
 	if (!blkcg_debug_stats)
-		return false;
+		return wb_throttle_ns != 0;
 
 	if (iolat->ssd)
 		return iolatency_ssd_stat(iolat, s);
@@ -995,6 +1199,7 @@ static void iolatency_pd_init(struct blkg_policy_data *pd)
 
 	latency_stat_init(iolat, &iolat->cur_stat);
 	rq_wait_init(&iolat->rq_wait);
+	rq_wait_init(&iolat->wb_rq_wait);
 	spin_lock_init(&iolat->child_lat.lock);
 	iolat->rq_depth.queue_depth = blkg->q->nr_requests;
 	iolat->rq_depth.max_depth = UINT_MAX;
@@ -1016,6 +1221,7 @@ static void iolatency_pd_init(struct blkg_policy_data *pd)
 	}
 
 	atomic_set(&iolat->child_lat.scale_cookie, DEFAULT_SCALE_COOKIE);
+	atomic_set(&iolat->child_lat.wb_scale, WB_SCALE_MAX);
 }
 
 static void iolatency_pd_offline(struct blkg_policy_data *pd)
@@ -536,6 +536,12 @@ static int hctx_io_poll_show(void *data, struct seq_file *m)
 	seq_printf(m, "considered=%lu\n", hctx->poll_considered);
 	seq_printf(m, "invoked=%lu\n", hctx->poll_invoked);
 	seq_printf(m, "success=%lu\n", hctx->poll_success);
+	seq_printf(m, "time_ns=%llu\n", hctx->poll_time_ns);
+	if (hctx->queue->poll_nsec == BLK_MQ_POLL_ADAPTIVE)
+		seq_printf(m, "mode=%s\n",
+			   hctx->poll_mode == BLK_MQ_POLL_MODE_SPIN ? "spin" :
+			   hctx->poll_mode == BLK_MQ_POLL_MODE_HYBRID ?
+			   "hybrid" : "irq");
 	return 0;
 }
 
@@ -545,6 +551,8 @@ static ssize_t hctx_io_poll_write(void *data, const char __user *buf,
 	struct blk_mq_hw_ctx *hctx = data;
 
 	hctx->poll_considered = hctx->poll_invoked = hctx->poll_success = 0;
+	hctx->poll_time_ns = hctx->poll_last_time_ns = 0;
+	hctx->poll_last_success = 0;
 	return count;
 }
 
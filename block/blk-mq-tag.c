@@ -179,6 +179,39 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 	return tag + tag_offset;
 }
 
+/*
+ * Grab up to @nr_tags regular tags in one go, without waiting. Returns a mask
+ * of the tags taken relative to @offset, or 0 if the caller has to fall back
+ * to blk_mq_get_tag().
+ */
+unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
+			      unsigned int *offset)
+{
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	unsigned long ret;
+
+	if (data->shallow_depth || data->flags & BLK_MQ_REQ_RESERVED ||
+	    data->hctx->flags & BLK_MQ_F_TAG_QUEUE_SHARED)
+		return 0;
+
+	ret = __sbitmap_queue_get_batch(tags->bitmap_tags, nr_tags, offset);
+	if (!ret)
+		return 0;
+
+	*offset += tags->nr_reserved_tags;
+	/* Same as in blk_mq_get_tag(), let the caller retry elsewhere */
+	if (unlikely(test_bit(BLK_MQ_S_INACTIVE, &data->hctx->state))) {
+		int tag_array[BITS_PER_LONG], nr = 0, i;
+
+		for (i = 0; i < BITS_PER_LONG; i++)
+			if (ret & (1UL << i))
+				tag_array[nr++] = *offset + i;
+		blk_mq_put_tags(tags, tag_array, nr);
+		return 0;
+	}
+	return ret;
+}
+
 void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 		    unsigned int tag)
 {
@@ -193,6 +226,13 @@ void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 	}
 }
 
+/* All of @tag_array must be regular (not reserved) tags */
+void blk_mq_put_tags(struct blk_mq_tags *tags, int *tag_array, int nr_tags)
+{
+	sbitmap_queue_clear_batch(tags->bitmap_tags, tags->nr_reserved_tags,
+				  tag_array, nr_tags);
+}
+
 struct bt_iter_data {
 	struct blk_mq_hw_ctx *hctx;
 	busy_iter_fn *fn;
@@ -521,6 +561,13 @@ int blk_mq_init_shared_sbitmap(struct blk_mq_tag_set *set)
 	if (ret)
 		return ret;
 
+	/* Shared by hctxs on every node, keep each node on its own words */
+	ret = sbitmap_queue_enable_numa(&set->__bitmap_tags, GFP_KERNEL);
+	if (ret) {
+		blk_mq_exit_shared_sbitmap(set);
+		return ret;
+	}
+
 	for (i = 0; i < set->nr_hw_queues; i++) {
 		struct blk_mq_tags *tags = set->tags[i];
 
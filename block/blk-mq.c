@@ -45,6 +45,7 @@ static DEFINE_PER_CPU(struct llist_head, blk_cpu_done);
 
 static void blk_mq_poll_stats_start(struct request_queue *q);
 static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb);
+static void blk_mq_poll_submit(struct request_queue *q, struct bio *bio);
 
 static int blk_mq_poll_stats_bkt(const struct request *rq)
 {
@@ -352,11 +353,53 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	return rq;
 }
 
+/*
+ * Allocate up to data->nr_tags - 1 more requests from the hctx just used and
+ * put them on data->cached_rqs, stopping at the first tag that is not free
+ * right away. Each of them holds its own queue usage reference.
+ */
+static void blk_mq_alloc_cached_requests(struct blk_mq_alloc_data *data,
+		u64 alloc_time_ns)
+{
+	blk_mq_req_flags_t flags = data->flags;
+	unsigned long tag_mask;
+	unsigned int tag_offset, nr = 0;
+	struct request *rq;
+	unsigned int tag;
+	int i;
+
+	/* Take as many as possible from one sbitmap word at once */
+	tag_mask = blk_mq_get_tags(data, data->nr_tags - 1, &tag_offset);
+	for (i = 0; tag_mask; i++) {
+		if (!(tag_mask & (1UL << i)))
+			continue;
+		tag_mask &= ~(1UL << i);
+		rq = blk_mq_rq_ctx_init(data, tag_offset + i, alloc_time_ns);
+		list_add_tail(&rq->queuelist, data->cached_rqs);
+		nr++;
+	}
+
+	data->flags |= BLK_MQ_REQ_NOWAIT;
+	while (nr < data->nr_tags - 1) {
+		tag = blk_mq_get_tag(data);
+		if (tag == BLK_MQ_NO_TAG)
+			break;
+		rq = blk_mq_rq_ctx_init(data, tag, alloc_time_ns);
+		list_add_tail(&rq->queuelist, data->cached_rqs);
+		nr++;
+	}
+	data->flags = flags;
+
+	if (nr)
+		percpu_ref_get_many(&data->q->q_usage_counter, nr);
+}
+
 static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 {
 	struct request_queue *q = data->q;
 	struct elevator_queue *e = q->elevator;
 	u64 alloc_time_ns = 0;
+	struct request *rq;
 	unsigned int tag;
 
 	/* alloc_time includes depth and tag waits */
@@ -403,7 +446,12 @@ static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 		msleep(3);
 		goto retry;
 	}
-	return blk_mq_rq_ctx_init(data, tag, alloc_time_ns);
+	rq = blk_mq_rq_ctx_init(data, tag, alloc_time_ns);
+
+	/* Requests for the rest of the plug, see blk_start_plug_nr_ios() */
+	if (data->nr_tags > 1 && !e && !(data->flags & BLK_MQ_REQ_RESERVED))
+		blk_mq_alloc_cached_requests(data, alloc_time_ns);
+	return rq;
 }
 
 struct request *blk_mq_alloc_request(struct request_queue *q, unsigned int op,
@@ -544,6 +592,17 @@ void blk_mq_free_request(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(blk_mq_free_request);
 
+/* Free the requests allocated ahead for a plug that were not used */
+void blk_mq_free_plug_rqs(struct blk_plug *plug)
+{
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, &plug->cached_rqs, queuelist) {
+		list_del_init(&rq->queuelist);
+		blk_mq_free_request(rq);
+	}
+}
+
 inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 {
 	u64 now = 0;
@@ -577,6 +636,85 @@ void blk_mq_end_request(struct request *rq, blk_status_t error)
 }
 EXPORT_SYMBOL(blk_mq_end_request);
 
+#define TAG_COMP_BATCH		32
+
+static inline void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx,
+					  int *tag_array, int nr_tags)
+{
+	blk_mq_put_tags(hctx->tags, tag_array, nr_tags);
+	blk_mq_sched_restart(hctx);
+	percpu_ref_put_many(&hctx->queue->q_usage_counter, nr_tags);
+}
+
+/**
+ * blk_mq_end_request_batch - end a batch of successfully completed requests
+ * @iob: batch filled by blk_mq_add_to_batch()
+ *
+ * Like blk_mq_end_request() on each request, but reads the clock once for
+ * the whole batch and gives the tags and queue references back in bulk.
+ */
+void blk_mq_end_request_batch(struct io_comp_batch *iob)
+{
+	int tags[TAG_COMP_BATCH], nr_tags = 0;
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	struct request *rq, *next;
+	u64 now = 0;
+
+	if (iob->need_ts)
+		now = ktime_get_ns();
+
+	list_for_each_entry_safe(rq, next, &iob->req_list, queuelist) {
+		struct request_queue *q = rq->q;
+		struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+
+		list_del_init(&rq->queuelist);
+		if (blk_update_request(rq, BLK_STS_OK, blk_rq_bytes(rq)))
+			BUG();
+
+		if (iob->need_ts) {
+			if (rq->rq_flags & RQF_STATS) {
+				blk_mq_poll_stats_start(q);
+				blk_stat_add(rq, now);
+			}
+			blk_account_io_done(rq, now);
+		}
+
+		rq->mq_ctx->rq_completed[rq_is_sync(rq)]++;
+		if (rq->rq_flags & RQF_MQ_INFLIGHT)
+			__blk_mq_dec_active_requests(hctx);
+		if (unlikely(laptop_mode && !blk_rq_is_passthrough(rq)))
+			laptop_io_completion(q->disk->bdi);
+		rq_qos_done(q, rq);
+
+		WRITE_ONCE(rq->state, MQ_RQ_IDLE);
+		if (!refcount_dec_and_test(&rq->ref))
+			continue;
+
+		blk_crypto_free_request(rq);
+		blk_pm_mark_last_busy(rq);
+		rq->mq_hctx = NULL;
+
+		if (blk_mq_tag_is_reserved(hctx->tags, rq->tag)) {
+			blk_mq_put_tag(hctx->tags, rq->mq_ctx, rq->tag);
+			blk_mq_sched_restart(hctx);
+			blk_queue_exit(q);
+			continue;
+		}
+
+		if (nr_tags == TAG_COMP_BATCH || cur_hctx != hctx) {
+			if (cur_hctx)
+				blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+			nr_tags = 0;
+			cur_hctx = hctx;
+		}
+		tags[nr_tags++] = rq->tag;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+}
+EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
+
 static void blk_complete_reqs(struct llist_head *list)
 {
 	struct llist_node *entry = llist_reverse_order(llist_del_all(list));
@@ -2160,6 +2298,64 @@ static inline unsigned short blk_plug_max_rq_count(struct blk_plug *plug)
 	return BLK_MAX_REQUEST_COUNT;
 }
 
+/*
+ * Take a request that an earlier submission under @plug allocated ahead. It
+ * carries its own queue usage reference, drop the one taken for @bio.
+ */
+static struct request *blk_mq_get_cached_request(struct request_queue *q,
+		struct blk_plug *plug, struct bio *bio)
+{
+	struct request *rq;
+
+	if (!plug || list_empty(&plug->cached_rqs))
+		return NULL;
+
+	rq = list_first_entry(&plug->cached_rqs, struct request, queuelist);
+	if (rq->q != q)
+		return NULL;
+	/* Reads, writes and polled I/O may be mapped to different hctxs */
+	if (blk_mq_map_queue(q, bio->bi_opf, rq->mq_ctx) != rq->mq_hctx)
+		return NULL;
+
+	list_del_init(&rq->queuelist);
+	rq->cmd_flags = bio->bi_opf;
+	if (blk_mq_need_time_stamp(rq))
+		rq->start_time_ns = ktime_get_ns();
+	blk_queue_exit(q);
+	return rq;
+}
+
+/*
+ * Direct I/O to a raw block device mostly comes as a single aligned segment
+ * which already fits the queue limits, see __blkdev_direct_IO().  Without a
+ * scheduler, bounce buffers, integrity or inline encryption there is nothing
+ * for splitting and the ctx merge attempt to do for those.
+ */
+static bool blk_mq_bio_is_simple(struct request_queue *q, struct bio *bio)
+{
+	const struct bio_vec *bv = bio->bi_io_vec;
+	unsigned long mask = queue_segment_boundary(q);
+	phys_addr_t start;
+
+	if (bio_op(bio) != REQ_OP_READ && bio_op(bio) != REQ_OP_WRITE)
+		return false;
+	if (q->elevator || q->limits.chunk_sectors || blk_queue_may_bounce(q))
+		return false;
+	if (blk_get_integrity(bio->bi_bdev->bd_disk) || bio_has_crypt_ctx(bio))
+		return false;
+
+	/* clones share the bvec table and may start or end inside of it */
+	if (bio->bi_vcnt != 1 || bio->bi_iter.bi_bvec_done ||
+	    bio->bi_iter.bi_size != bv->bv_len)
+		return false;
+	if (bv->bv_len > queue_max_segment_size(q) ||
+	    bio_sectors(bio) > queue_max_sectors(q))
+		return false;
+
+	start = page_to_phys(bv->bv_page) + bv->bv_offset;
+	return (start & mask) + bv->bv_len - 1 <= mask;
+}
+
 /**
  * blk_mq_submit_bio - Create and send a request to block device.
  * @bio: Bio pointer.
@@ -2189,32 +2385,50 @@ blk_qc_t blk_mq_submit_bio(struct bio *bio)
 	unsigned int nr_segs;
 	blk_qc_t cookie;
 	blk_status_t ret;
-	bool hipri;
+	bool hipri, simple;
 
-	blk_queue_bounce(q, &bio);
-	__blk_queue_split(&bio, &nr_segs);
+	simple = blk_mq_bio_is_simple(q, bio);
+	if (simple) {
+		nr_segs = 1;
+	} else {
+		blk_queue_bounce(q, &bio);
+		__blk_queue_split(&bio, &nr_segs);
 
-	if (!bio_integrity_prep(bio))
-		goto queue_exit;
+		if (!bio_integrity_prep(bio))
+			goto queue_exit;
+	}
 
+	/* Still needed for limited plugging to find same_queue_rq */
 	if (!is_flush_fua && !blk_queue_nomerges(q) &&
 	    blk_attempt_plug_merge(q, bio, nr_segs, &same_queue_rq))
 		goto queue_exit;
 
-	if (blk_mq_sched_bio_merge(q, bio, nr_segs))
+	if (!simple && blk_mq_sched_bio_merge(q, bio, nr_segs))
 		goto queue_exit;
 
 	rq_qos_throttle(q, bio);
 
+	blk_mq_poll_submit(q, bio);
 	hipri = bio->bi_opf & REQ_HIPRI;
 
-	data.cmd_flags = bio->bi_opf;
-	rq = __blk_mq_alloc_request(&data);
-	if (unlikely(!rq)) {
-		rq_qos_cleanup(q, bio);
-		if (bio->bi_opf & REQ_NOWAIT)
-			bio_wouldblock_error(bio);
-		goto queue_exit;
+	plug = blk_mq_plug(q, bio);
+	rq = blk_mq_get_cached_request(q, plug, bio);
+	if (rq) {
+		data.hctx = rq->mq_hctx;
+	} else {
+		data.cmd_flags = bio->bi_opf;
+		if (plug && plug->nr_ios > 1) {
+			data.nr_tags = plug->nr_ios;
+			data.cached_rqs = &plug->cached_rqs;
+			plug->nr_ios = 1;
+		}
+		rq = __blk_mq_alloc_request(&data);
+		if (unlikely(!rq)) {
+			rq_qos_cleanup(q, bio);
+			if (bio->bi_opf & REQ_NOWAIT)
+				bio_wouldblock_error(bio);
+			goto queue_exit;
+		}
 	}
 
 	trace_block_getrq(bio);
@@ -2233,7 +2447,6 @@ blk_qc_t blk_mq_submit_bio(struct bio *bio)
 		return BLK_QC_T_NONE;
 	}
 
-	plug = blk_mq_plug(q, bio);
 	if (unlikely(is_flush_fua)) {
 		/* Bypass scheduler for flush requests */
 		blk_insert_flush(rq);
@@ -2775,6 +2988,7 @@ blk_mq_alloc_hctx(struct request_queue *q, struct blk_mq_tag_set *set,
 	if (node == NUMA_NO_NODE)
 		node = set->numa_node;
 	hctx->numa_node = node;
+	hctx->poll_next_adapt = jiffies;
 
 	INIT_DELAYED_WORK(&hctx->run_work, blk_mq_run_work_fn);
 	spin_lock_init(&hctx->lock);
@@ -3863,12 +4077,110 @@ static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 	if (bucket < 0)
 		return ret;
 
-	if (q->poll_stat[bucket].nr_samples)
-		ret = (q->poll_stat[bucket].mean + 1) / 2;
+	if (q->poll_stat[bucket].nr_samples) {
+		u64 mean = q->poll_stat[bucket].mean;
+		u64 dev = blk_rq_stat_stddev(&q->poll_stat[bucket]);
+
+		/*
+		 * Adaptive polling only sleeps while completion times are
+		 * tight, sleep through all but their tail then.
+		 */
+		if (q->poll_nsec == BLK_MQ_POLL_ADAPTIVE && mean > 4 * dev)
+			ret = mean - 2 * dev;
+		else
+			ret = (mean + 1) / 2;
+	}
 
 	return ret;
 }
 
+/*
+ * Adaptive polling, io_poll_delay set to -2.  Every poll hctx reconsiders
+ * how to wait for its completions every 100ms, from the completion times of
+ * the queue and what polling cost on this hctx in the last period:
+ *
+ * - spin while that costs little more than taking an interrupt and
+ *   switching back to the task would,
+ * - hybrid sleep if completion times are tight enough to sleep through most
+ *   of them, so the spinning after the sleep is a small part of the wait,
+ * - otherwise hand the completions back to interrupts: HIPRI bios are then
+ *   submitted as regular ones, see blk_mq_poll_submit().
+ */
+#define BLK_MQ_POLL_SWITCH_NS		(5 * NSEC_PER_USEC)
+#define BLK_MQ_POLL_ADAPT_INTERVAL	(HZ / 10)
+
+static void blk_mq_poll_adapt(struct request_queue *q,
+			      struct blk_mq_hw_ctx *hctx)
+{
+	unsigned long next = READ_ONCE(hctx->poll_next_adapt);
+	u64 mean = 0, dev = 0, nr = 0, spent, found, cost;
+	unsigned int mode;
+	int bucket;
+
+	if (time_before(jiffies, next) ||
+	    cmpxchg(&hctx->poll_next_adapt, next,
+		    jiffies + BLK_MQ_POLL_ADAPT_INTERVAL) != next)
+		return;
+
+	spent = hctx->poll_time_ns - hctx->poll_last_time_ns;
+	found = hctx->poll_success - hctx->poll_last_success;
+	hctx->poll_last_time_ns = hctx->poll_time_ns;
+	hctx->poll_last_success = hctx->poll_success;
+
+	/* Without completion times to go by, poll as asked */
+	if (!blk_poll_stats_enable(q)) {
+		WRITE_ONCE(hctx->poll_mode, BLK_MQ_POLL_MODE_SPIN);
+		return;
+	}
+
+	for (bucket = 0; bucket < BLK_MQ_POLL_STATS_BKTS; bucket++) {
+		struct blk_rq_stat *stat = &q->poll_stat[bucket];
+
+		if (!stat->nr_samples)
+			continue;
+		mean += stat->mean * stat->nr_samples;
+		dev += blk_rq_stat_stddev(stat) * stat->nr_samples;
+		nr += stat->nr_samples;
+	}
+	if (!nr) {
+		WRITE_ONCE(hctx->poll_mode, BLK_MQ_POLL_MODE_SPIN);
+		return;
+	}
+	mean = div64_u64(mean, nr);
+	dev = div64_u64(dev, nr);
+
+	/* Spinning costs the whole wait, measured if that's what we did */
+	cost = mean;
+	if (hctx->poll_mode == BLK_MQ_POLL_MODE_SPIN && found)
+		cost = div64_u64(spent, found);
+
+	if (cost <= 2 * BLK_MQ_POLL_SWITCH_NS)
+		mode = BLK_MQ_POLL_MODE_SPIN;
+	else if (2 * dev + BLK_MQ_POLL_SWITCH_NS <= mean / 4)
+		mode = BLK_MQ_POLL_MODE_HYBRID;
+	else
+		mode = BLK_MQ_POLL_MODE_IRQ;
+
+	WRITE_ONCE(hctx->poll_mode, mode);
+}
+
+/*
+ * With adaptive polling, submit HIPRI bios as regular ones while the poll
+ * hctx they map to leaves completions to interrupts.
+ */
+static void blk_mq_poll_submit(struct request_queue *q, struct bio *bio)
+{
+	struct blk_mq_hw_ctx *hctx;
+
+	if (!(bio->bi_opf & REQ_HIPRI) || q->poll_nsec != BLK_MQ_POLL_ADAPTIVE)
+		return;
+
+	hctx = blk_mq_map_queue(q, bio->bi_opf, blk_mq_get_ctx(q));
+	blk_mq_poll_adapt(q, hctx);
+	if (READ_ONCE(hctx->poll_mode) == BLK_MQ_POLL_MODE_IRQ)
+		bio->bi_opf &= ~REQ_HIPRI;
+}
+
 static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
 				     struct request *rq)
 {
@@ -3884,6 +4196,7 @@ static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
 	 * If we get here, hybrid polling is enabled. Hence poll_nsec can be:
 	 *
 	 *  0:	use half of prev avg
+	 * -2:	adaptive, see blk_mq_poll_nsecs()
 	 * >0:	use this specific value
 	 */
 	if (q->poll_nsec > 0)
@@ -3930,6 +4243,16 @@ static bool blk_mq_poll_hybrid(struct request_queue *q,
 	if (q->poll_nsec == BLK_MQ_POLL_CLASSIC)
 		return false;
 
+	/*
+	 * Requests still polled on a hctx that went to interrupts were
+	 * submitted before the switch, sleep for them as hybrid would.
+	 */
+	if (q->poll_nsec == BLK_MQ_POLL_ADAPTIVE) {
+		blk_mq_poll_adapt(q, hctx);
+		if (READ_ONCE(hctx->poll_mode) == BLK_MQ_POLL_MODE_SPIN)
+			return false;
+	}
+
 	if (!blk_qc_t_is_internal(cookie))
 		rq = blk_mq_tag_to_rq(hctx->tags, blk_qc_t_to_tag(cookie));
 	else {
@@ -3963,6 +4286,8 @@ int blk_poll(struct request_queue *q, blk_qc_t cookie, bool spin)
 {
 	struct blk_mq_hw_ctx *hctx;
 	unsigned int state;
+	u64 start;
+	int ret;
 
 	if (!blk_qc_t_valid(cookie) ||
 	    !test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
@@ -3987,30 +4312,34 @@ int blk_poll(struct request_queue *q, blk_qc_t cookie, bool spin)
 	hctx->poll_considered++;
 
 	state = get_current_state();
+	start = ktime_get_ns();
 	do {
-		int ret;
-
 		hctx->poll_invoked++;
 
 		ret = q->mq_ops->poll(hctx);
 		if (ret > 0) {
 			hctx->poll_success++;
 			__set_current_state(TASK_RUNNING);
-			return ret;
+			goto out;
 		}
 
 		if (signal_pending_state(state, current))
 			__set_current_state(TASK_RUNNING);
 
-		if (task_is_running(current))
-			return 1;
+		if (task_is_running(current)) {
+			ret = 1;
+			goto out;
+		}
 		if (ret < 0 || !spin)
 			break;
 		cpu_relax();
 	} while (!need_resched());
 
 	__set_current_state(TASK_RUNNING);
-	return 0;
+	ret = 0;
+out:
+	hctx->poll_time_ns += ktime_get_ns() - start;
+	return ret;
 }
 EXPORT_SYMBOL_GPL(blk_poll);
 
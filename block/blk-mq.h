@@ -7,6 +7,13 @@
 
 struct blk_mq_tag_set;
 
+/* hctx->poll_mode, how adaptive polling waits for completions */
+enum {
+	BLK_MQ_POLL_MODE_SPIN,
+	BLK_MQ_POLL_MODE_HYBRID,
+	BLK_MQ_POLL_MODE_IRQ,
+};
+
 struct blk_mq_ctxs {
 	struct kobject kobj;
 	struct blk_mq_ctx __percpu	*queue_ctx;
@@ -156,6 +163,9 @@ struct blk_mq_alloc_data {
 	blk_mq_req_flags_t flags;
 	unsigned int shallow_depth;
 	unsigned int cmd_flags;
+	/* allocate nr_tags - 1 more requests onto cached_rqs, if possible */
+	unsigned int nr_tags;
+	struct list_head *cached_rqs;
 
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
@@ -7,6 +7,7 @@
 #include <linux/kernel.h>
 #include <linux/rculist.h>
 #include <linux/blk-mq.h>
+#include <linux/blk-cgroup.h>
 
 #include "blk-stat.h"
 #include "blk-mq.h"
@@ -16,13 +17,16 @@ struct blk_queue_stats {
 	struct list_head callbacks;
 	spinlock_t lock;
 	bool enable_accounting;
+
+	/* [op][size] latency histograms, NULL unless enabled */
+	struct blk_lat_hist __percpu *lat_hist;
 };
 
 void blk_rq_stat_init(struct blk_rq_stat *stat)
 {
 	stat->min = -1ULL;
 	stat->max = stat->nr_samples = stat->mean = 0;
-	stat->batch = 0;
+	stat->batch = stat->batch_sq = 0;
 }
 
 /* src is a per-cpu stat, mean isn't initialized */
@@ -38,6 +42,7 @@ void blk_rq_stat_sum(struct blk_rq_stat *dst, struct blk_rq_stat *src)
 				dst->nr_samples + src->nr_samples);
 
 	dst->nr_samples += src->nr_samples;
+	dst->batch_sq += src->batch_sq;
 }
 
 void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
@@ -45,6 +50,7 @@ void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->min = min(stat->min, value);
 	stat->max = max(stat->max, value);
 	stat->batch += value;
+	stat->batch_sq += (value >> 10) * (value >> 10);
 	stat->nr_samples++;
 }
 
@@ -52,8 +58,9 @@ void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
 	struct blk_stat_callback *cb;
+	struct blk_lat_hist *hist;
 	struct blk_rq_stat *stat;
-	int bucket, cpu;
+	int bucket, cpu, op;
 	u64 value;
 
 	value = (now >= rq->io_start_time_ns) ? now - rq->io_start_time_ns : 0;
@@ -62,6 +69,15 @@ void blk_stat_add(struct request *rq, u64 now)
 
 	rcu_read_lock();
 	cpu = get_cpu();
+	hist = READ_ONCE(q->stats->lat_hist);
+	op = blk_stat_op(rq->cmd_flags);
+	if (hist && op >= 0) {
+		hist = per_cpu_ptr(hist, cpu);
+		hist[op * BLK_STAT_NR_SIZES +
+		     blk_stat_size(blk_rq_stats_sectors(rq))]
+			.nr[blk_lat_hist_bucket(value)]++;
+	}
+
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
 		if (!blk_stat_is_active(cb))
 			continue;
@@ -161,7 +177,8 @@ void blk_stat_remove_callback(struct request_queue *q,
 
 	spin_lock_irqsave(&q->stats->lock, flags);
 	list_del_rcu(&cb->list);
-	if (list_empty(&q->stats->callbacks) && !q->stats->enable_accounting)
+	if (list_empty(&q->stats->callbacks) && !q->stats->enable_accounting &&
+	    !q->stats->lat_hist)
 		blk_queue_flag_clear(QUEUE_FLAG_STATS, q);
 	spin_unlock_irqrestore(&q->stats->lock, flags);
 
@@ -206,6 +223,7 @@ struct blk_queue_stats *blk_alloc_queue_stats(void)
 	INIT_LIST_HEAD(&stats->callbacks);
 	spin_lock_init(&stats->lock);
 	stats->enable_accounting = false;
+	stats->lat_hist = NULL;
 
 	return stats;
 }
@@ -217,5 +235,166 @@ void blk_free_queue_stats(struct blk_queue_stats *stats)
 
 	WARN_ON(!list_empty(&stats->callbacks));
 
+	free_percpu(stats->lat_hist);
 	kfree(stats);
 }
+
+const unsigned int blk_lat_hist_ppm[4] = { 500000, 900000, 990000, 999000 };
+
+/* usecs at and above which @idx starts, the inverse of blk_lat_hist_bucket() */
+static u64 blk_lat_hist_bucket_start(unsigned int idx)
+{
+	if (idx < 4)
+		return idx;
+	return (u64)(4 + idx % 4) << (idx / 4 - 1);
+}
+
+/* Add up the per-cpu copies of the @idx'th histogram of @hist into @sum */
+void blk_lat_hist_fold(struct blk_lat_hist *sum,
+		       struct blk_lat_hist __percpu *hist, unsigned int idx)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_lat_hist *h = &per_cpu_ptr(hist, cpu)[idx];
+
+		for (i = 0; i < BLK_LAT_HIST_BUCKETS; i++)
+			sum->nr[i] += READ_ONCE(h->nr[i]);
+	}
+}
+
+/**
+ * blk_lat_hist_percentiles - read percentiles off a latency histogram
+ * @hist: the histogram
+ * @ppm: the percentiles to look up, in parts per million and ascending
+ * @usecs: output, the upper bound of the bucket each percentile falls into
+ * @nr: number of entries in @ppm and @usecs
+ *
+ * Return: the number of samples in @hist, @usecs is left alone if it is 0.
+ */
+u64 blk_lat_hist_percentiles(const struct blk_lat_hist *hist,
+			     const unsigned int *ppm, u64 *usecs,
+			     unsigned int nr)
+{
+	u64 total = 0, seen = 0;
+	unsigned int i, p = 0;
+
+	for (i = 0; i < BLK_LAT_HIST_BUCKETS; i++)
+		total += hist->nr[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < BLK_LAT_HIST_BUCKETS && p < nr; i++) {
+		seen += hist->nr[i];
+		while (p < nr && seen * 1000000 >= total * ppm[p]) {
+			if (i == BLK_LAT_HIST_BUCKETS - 1)
+				usecs[p++] = blk_lat_hist_bucket_start(i);
+			else
+				usecs[p++] = blk_lat_hist_bucket_start(i + 1);
+		}
+	}
+
+	return total;
+}
+
+/*
+ * Latency histograms are enabled and disabled through the "lat_hist" queue
+ * attribute, with q->sysfs_lock held.
+ */
+int blk_stat_enable_lat_hist(struct request_queue *q)
+{
+	struct blk_lat_hist __percpu *hist;
+	unsigned long flags;
+
+	if (q->stats->lat_hist)
+		return 0;
+
+	hist = __alloc_percpu(BLK_STAT_NR_OPS * BLK_STAT_NR_SIZES *
+			      sizeof(struct blk_lat_hist),
+			      __alignof__(struct blk_lat_hist));
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&q->stats->lock, flags);
+	WRITE_ONCE(q->stats->lat_hist, hist);
+	blk_queue_flag_set(QUEUE_FLAG_STATS, q);
+	spin_unlock_irqrestore(&q->stats->lock, flags);
+
+	blkcg_enable_lat_hist(q);
+	return 0;
+}
+
+void blk_stat_disable_lat_hist(struct request_queue *q)
+{
+	struct blk_lat_hist __percpu *hist = q->stats->lat_hist;
+	unsigned long flags;
+
+	if (!hist)
+		return;
+
+	spin_lock_irqsave(&q->stats->lock, flags);
+	WRITE_ONCE(q->stats->lat_hist, NULL);
+	if (list_empty(&q->stats->callbacks) && !q->stats->enable_accounting)
+		blk_queue_flag_clear(QUEUE_FLAG_STATS, q);
+	spin_unlock_irqrestore(&q->stats->lock, flags);
+
+	/* blk_stat_add() looks at the histograms under rcu_read_lock() */
+	synchronize_rcu();
+	free_percpu(hist);
+}
+
+bool blk_stat_lat_hist_enabled(struct request_queue *q)
+{
+	return READ_ONCE(q->stats->lat_hist);
+}
+
+static const char *const blk_stat_op_name[BLK_STAT_NR_OPS] = {
+	[BLK_STAT_OP_READ]	= "read",
+	[BLK_STAT_OP_WRITE]	= "write",
+	[BLK_STAT_OP_DISCARD]	= "discard",
+	[BLK_STAT_OP_FLUSH]	= "flush",
+};
+
+static const char *const blk_stat_size_name[BLK_STAT_NR_SIZES] = {
+	[BLK_STAT_SIZE_4K]	= "4k",
+	[BLK_STAT_SIZE_64K]	= "64k",
+	[BLK_STAT_SIZE_1M]	= "1m",
+	[BLK_STAT_SIZE_LARGE]	= "large",
+};
+
+/* One line per operation and size class with samples, in usecs */
+ssize_t blk_stat_lat_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_lat_hist __percpu *hist = q->stats->lat_hist;
+	struct blk_lat_hist *sum;
+	u64 usecs[ARRAY_SIZE(blk_lat_hist_ppm)];
+	ssize_t ret = 0;
+	int op, size;
+	u64 nr;
+
+	if (!hist)
+		return 0;
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	for (op = 0; op < BLK_STAT_NR_OPS; op++) {
+		for (size = 0; size < BLK_STAT_NR_SIZES; size++) {
+			memset(sum, 0, sizeof(*sum));
+			blk_lat_hist_fold(sum, hist,
+					  op * BLK_STAT_NR_SIZES + size);
+			nr = blk_lat_hist_percentiles(sum, blk_lat_hist_ppm,
+					usecs, ARRAY_SIZE(blk_lat_hist_ppm));
+			if (!nr)
+				continue;
+			ret += sysfs_emit_at(page, ret,
+				"%s %s ios=%llu p50=%llu p90=%llu p99=%llu p999=%llu\n",
+				blk_stat_op_name[op], blk_stat_size_name[size],
+				nr, usecs[0], usecs[1], usecs[2], usecs[3]);
+		}
+	}
+	kfree(sum);
+
+	return ret;
+}
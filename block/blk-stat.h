@@ -7,6 +7,7 @@
 #include <linux/ktime.h>
 #include <linux/rcupdate.h>
 #include <linux/timer.h>
+#include <linux/sizes.h>
 
 /**
  * struct blk_stat_callback - Block statistics callback.
@@ -168,4 +169,106 @@ void blk_rq_stat_add(struct blk_rq_stat *, u64);
 void blk_rq_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
 void blk_rq_stat_init(struct blk_rq_stat *);
 
+/* Standard deviation of a summed up @stat in nsecs, to about a usec */
+static inline u64 blk_rq_stat_stddev(const struct blk_rq_stat *stat)
+{
+	u64 mean = stat->mean >> 10, sq;
+
+	if (!stat->nr_samples)
+		return 0;
+
+	sq = div_u64(stat->batch_sq, stat->nr_samples);
+	if (sq <= mean * mean)
+		return 0;
+	return (u64)int_sqrt64(sq - mean * mean) << 10;
+}
+
+/*
+ * Latency histograms, kept per queue by operation and size class while
+ * enabled through the "lat_hist" queue attribute, and per blkg by operation.
+ */
+enum {
+	BLK_STAT_OP_READ,
+	BLK_STAT_OP_WRITE,
+	BLK_STAT_OP_DISCARD,
+	BLK_STAT_OP_FLUSH,		/* flushes and FUA writes */
+	BLK_STAT_NR_OPS,
+};
+
+enum {
+	BLK_STAT_SIZE_4K,
+	BLK_STAT_SIZE_64K,
+	BLK_STAT_SIZE_1M,
+	BLK_STAT_SIZE_LARGE,
+	BLK_STAT_NR_SIZES,
+};
+
+/* up to 2^26 usecs, about a minute, see blk_lat_hist_bucket() */
+#define BLK_LAT_HIST_BUCKETS	100
+
+struct blk_lat_hist {
+	u64 nr[BLK_LAT_HIST_BUCKETS];
+};
+
+static inline int blk_stat_op(unsigned int opf)
+{
+	switch (opf & REQ_OP_MASK) {
+	case REQ_OP_READ:
+		return BLK_STAT_OP_READ;
+	case REQ_OP_WRITE:
+		if (opf & (REQ_PREFLUSH | REQ_FUA))
+			return BLK_STAT_OP_FLUSH;
+		return BLK_STAT_OP_WRITE;
+	case REQ_OP_DISCARD:
+	case REQ_OP_SECURE_ERASE:
+		return BLK_STAT_OP_DISCARD;
+	case REQ_OP_FLUSH:
+		return BLK_STAT_OP_FLUSH;
+	default:
+		return -1;
+	}
+}
+
+static inline int blk_stat_size(unsigned int sectors)
+{
+	if (sectors <= (SZ_4K >> SECTOR_SHIFT))
+		return BLK_STAT_SIZE_4K;
+	if (sectors <= (SZ_64K >> SECTOR_SHIFT))
+		return BLK_STAT_SIZE_64K;
+	if (sectors <= (SZ_1M >> SECTOR_SHIFT))
+		return BLK_STAT_SIZE_1M;
+	return BLK_STAT_SIZE_LARGE;
+}
+
+/*
+ * Buckets are log-linear in usecs: exact below 4us, then four buckets per
+ * power of two, which bounds the error of a percentile to 25%.
+ */
+static inline unsigned int blk_lat_hist_bucket(u64 nsecs)
+{
+	u64 usecs = div_u64(nsecs, NSEC_PER_USEC);
+	unsigned int order;
+
+	if (usecs < 4)
+		return usecs;
+
+	order = fls64(usecs) - 1;
+	return min_t(unsigned int,
+		     (order - 1) * 4 + ((usecs >> (order - 2)) & 3),
+		     BLK_LAT_HIST_BUCKETS - 1);
+}
+
+void blk_lat_hist_fold(struct blk_lat_hist *sum,
+		       struct blk_lat_hist __percpu *hist, unsigned int idx);
+u64 blk_lat_hist_percentiles(const struct blk_lat_hist *hist,
+			     const unsigned int *ppm, u64 *usecs,
+			     unsigned int nr);
+
+extern const unsigned int blk_lat_hist_ppm[4];
+
+int blk_stat_enable_lat_hist(struct request_queue *q);
+void blk_stat_disable_lat_hist(struct request_queue *q);
+bool blk_stat_lat_hist_enabled(struct request_queue *q);
+ssize_t blk_stat_lat_hist_show(struct request_queue *q, char *page);
+
 #endif
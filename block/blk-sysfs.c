@@ -394,8 +394,9 @@ static ssize_t queue_poll_delay_show(struct request_queue *q, char *page)
 {
 	int val;
 
-	if (q->poll_nsec == BLK_MQ_POLL_CLASSIC)
-		val = BLK_MQ_POLL_CLASSIC;
+	if (q->poll_nsec == BLK_MQ_POLL_CLASSIC ||
+	    q->poll_nsec == BLK_MQ_POLL_ADAPTIVE)
+		val = q->poll_nsec;
 	else
 		val = q->poll_nsec / 1000;
 
@@ -414,8 +415,8 @@ static ssize_t queue_poll_delay_store(struct request_queue *q, const char *page,
 	if (err < 0)
 		return err;
 
-	if (val == BLK_MQ_POLL_CLASSIC)
-		q->poll_nsec = BLK_MQ_POLL_CLASSIC;
+	if (val == BLK_MQ_POLL_CLASSIC || val == BLK_MQ_POLL_ADAPTIVE)
+		q->poll_nsec = val;
 	else if (val >= 0)
 		q->poll_nsec = val * 1000;
 	else
@@ -424,6 +425,22 @@ static ssize_t queue_poll_delay_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+/* CPU time spent polling across the hctxs, hybrid sleeps excluded */
+static ssize_t queue_poll_time_show(struct request_queue *q, char *page)
+{
+	struct blk_mq_hw_ctx *hctx;
+	u64 nsecs = 0;
+	int i;
+
+	if (!queue_is_mq(q))
+		return -EINVAL;
+
+	queue_for_each_hw_ctx(q, hctx, i)
+		nsecs += READ_ONCE(hctx->poll_time_ns);
+
+	return sprintf(page, "%llu\n", div_u64(nsecs, NSEC_PER_USEC));
+}
+
 static ssize_t queue_poll_show(struct request_queue *q, char *page)
 {
 	return queue_var_show(test_bit(QUEUE_FLAG_POLL, &q->queue_flags), page);
@@ -566,6 +583,33 @@ static ssize_t queue_dax_show(struct request_queue *q, char *page)
 	return queue_var_show(blk_queue_dax(q), page);
 }
 
+static ssize_t queue_lat_hist_show(struct request_queue *q, char *page)
+{
+	return blk_stat_lat_hist_show(q, page);
+}
+
+static ssize_t queue_lat_hist_store(struct request_queue *q, const char *page,
+				    size_t count)
+{
+	unsigned long enable;
+	ssize_t ret;
+
+	ret = queue_var_store(&enable, page, count);
+	if (ret < 0)
+		return ret;
+
+	if (enable) {
+		int err = blk_stat_enable_lat_hist(q);
+
+		if (err)
+			return err;
+	} else {
+		blk_stat_disable_lat_hist(q);
+	}
+
+	return ret;
+}
+
 #define QUEUE_RO_ENTRY(_prefix, _name)			\
 static struct queue_sysfs_entry _prefix##_entry = {	\
 	.attr	= { .name = _name, .mode = 0444 },	\
@@ -614,11 +658,13 @@ QUEUE_RW_ENTRY(queue_nomerges, "nomerges");
 QUEUE_RW_ENTRY(queue_rq_affinity, "rq_affinity");
 QUEUE_RW_ENTRY(queue_poll, "io_poll");
 QUEUE_RW_ENTRY(queue_poll_delay, "io_poll_delay");
+QUEUE_RO_ENTRY(queue_poll_time, "io_poll_time_us");
 QUEUE_RW_ENTRY(queue_wc, "write_cache");
 QUEUE_RO_ENTRY(queue_fua, "fua");
 QUEUE_RO_ENTRY(queue_dax, "dax");
 QUEUE_RW_ENTRY(queue_io_timeout, "io_timeout");
 QUEUE_RW_ENTRY(queue_wb_lat, "wbt_lat_usec");
+QUEUE_RW_ENTRY(queue_lat_hist, "lat_hist");
 QUEUE_RO_ENTRY(queue_virt_boundary_mask, "virt_boundary_mask");
 
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
@@ -675,7 +721,9 @@ static struct attribute *queue_attrs[] = {
 	&queue_fua_entry.attr,
 	&queue_dax_entry.attr,
 	&queue_wb_lat_entry.attr,
+	&queue_lat_hist_entry.attr,
 	&queue_poll_delay_entry.attr,
+	&queue_poll_time_entry.attr,
 	&queue_io_timeout_entry.attr,
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 	&blk_throtl_sample_time_entry.attr,
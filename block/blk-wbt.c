@@ -27,6 +27,7 @@
 
 #include "blk-wbt.h"
 #include "blk-rq-qos.h"
+#include "blk.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/wbt.h>
@@ -564,6 +565,12 @@ static void wbt_cleanup(struct rq_qos *rqos, struct bio *bio)
 	struct rq_wb *rwb = RQWB(rqos);
 	enum wbt_flags flags = bio_to_wbt_flags(rwb, bio);
 	__wbt_done(rqos, flags);
+	blk_iolatency_wbt_done(bio);
+}
+
+static void wbt_done_bio(struct rq_qos *rqos, struct bio *bio)
+{
+	blk_iolatency_wbt_done(bio);
 }
 
 /*
@@ -583,6 +590,14 @@ static void wbt_wait(struct rq_qos *rqos, struct bio *bio)
 		return;
 	}
 
+	/*
+	 * Take the cgroup's share first, a queue wide slot held while waiting
+	 * on our own cgroup would only hold back everybody else. Don't make
+	 * kswapd wait on the cgroup it happens to be cleaning.
+	 */
+	if (!(flags & WBT_KSWAPD))
+		blk_iolatency_wbt_throttle(bio, get_limit(rwb, bio->bi_opf));
+
 	__wbt_wait(rwb, flags, bio->bi_opf);
 
 	if (!blk_stat_is_active(rwb->cb))
@@ -808,6 +823,7 @@ static struct rq_qos_ops wbt_rqos_ops = {
 	.track = wbt_track,
 	.requeue = wbt_requeue,
 	.done = wbt_done,
+	.done_bio = wbt_done_bio,
 	.cleanup = wbt_cleanup,
 	.queue_depth_changed = wbt_queue_depth_changed,
 	.exit = wbt_exit,
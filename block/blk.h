@@ -335,8 +335,13 @@ static inline void blk_queue_bounce(struct request_queue *q, struct bio **bio)
 
 #ifdef CONFIG_BLK_CGROUP_IOLATENCY
 extern int blk_iolatency_init(struct request_queue *q);
+void blk_iolatency_wbt_throttle(struct bio *bio, unsigned int limit);
+void blk_iolatency_wbt_done(struct bio *bio);
 #else
 static inline int blk_iolatency_init(struct request_queue *q) { return 0; }
+static inline void blk_iolatency_wbt_throttle(struct bio *bio,
+					      unsigned int limit) { }
+static inline void blk_iolatency_wbt_done(struct bio *bio) { }
 #endif
 
 struct bio *blk_next_bio(struct bio *bio, unsigned int nr_pages, gfp_t gfp);
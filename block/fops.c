@@ -227,7 +227,8 @@ static ssize_t __blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter,
 	 * to issue
 	 */
 	if (!is_poll)
-		blk_start_plug(&plug);
+		blk_start_plug_nr_ios(&plug, DIV_ROUND_UP(iov_iter_count(iter),
+				      (unsigned long)nr_pages << PAGE_SHIFT));
 
 	for (;;) {
 		bio_set_dev(bio, bdev);
@@ -17,6 +17,8 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/cpumask.h>
+#include <asm/local64.h>
 
 #include <trace/events/block.h>
 
@@ -34,6 +36,11 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+/*
+ * Time after which a request of a lower priority class is dispatched ahead of
+ * the requests of higher priority classes.
+ */
+static const int prio_aging_expire = 10 * HZ;
 
 enum dd_data_dir {
 	DD_READ		= READ,
@@ -57,6 +64,10 @@ struct io_stats_per_prio {
 	local_t merged;
 	local_t dispatched;
 	local_t completed;
+	/* Dispatched ahead of higher priorities by prio_aging_expire */
+	local_t aged;
+	/* Sum of the allocation to completion times, in nanoseconds */
+	local64_t latency_ns;
 };
 
 /* I/O statistics for all I/O priorities (enum dd_prio). */
@@ -76,6 +87,15 @@ struct dd_per_prio {
 	struct request *next_rq[DD_DIR_COUNT];
 };
 
+/*
+ * Requests inserted on one CPU, waiting for the next dispatch to move them to
+ * the sort and FIFO lists under dd->lock.
+ */
+struct dd_staging {
+	spinlock_t lock;
+	struct list_head list;
+} ____cacheline_aligned_in_smp;
+
 struct deadline_data {
 	/*
 	 * run time data
@@ -83,6 +103,10 @@ struct deadline_data {
 
 	struct dd_per_prio per_prio[DD_PRIO_COUNT];
 
+	struct dd_staging __percpu *staging;
+	/* CPUs that may have requests on their staging list */
+	cpumask_var_t staged_cpus;
+
 	/* Data direction of latest dispatched request. */
 	enum dd_data_dir last_dir;
 	unsigned int batching;		/* number of sequential requests made */
@@ -98,6 +122,7 @@ struct deadline_data {
 	int writes_starved;
 	int front_merges;
 	u32 async_depth;
+	int prio_aging_expire;
 
 	spinlock_t lock;
 	spinlock_t zone_lock;
@@ -355,12 +380,27 @@ deadline_next_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 	return rq;
 }
 
+/*
+ * Returns true if and only if @rq was inserted after @latest_start where
+ * @latest_start is in jiffies.
+ */
+static bool started_after(struct deadline_data *dd, struct request *rq,
+			  unsigned long latest_start)
+{
+	unsigned long start_time = (unsigned long)rq->fifo_time;
+
+	start_time -= dd->fifo_expire[rq_data_dir(rq)];
+
+	return time_after(start_time, latest_start);
+}
+
 /*
  * deadline_dispatch_requests selects the best request according to
- * read/write expire, fifo_batch, etc
+ * read/write expire, fifo_batch, etc and with a start time <= @latest_start.
  */
 static struct request *__dd_dispatch_request(struct deadline_data *dd,
-					     struct dd_per_prio *per_prio)
+					     struct dd_per_prio *per_prio,
+					     unsigned long latest_start)
 {
 	struct request *rq, *next_rq;
 	enum dd_data_dir data_dir;
@@ -372,6 +412,8 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	if (!list_empty(&per_prio->dispatch)) {
 		rq = list_first_entry(&per_prio->dispatch, struct request,
 				      queuelist);
+		if (started_after(dd, rq, latest_start))
+			return NULL;
 		list_del_init(&rq->queuelist);
 		goto done;
 	}
@@ -380,9 +422,12 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	 * batches are currently reads XOR writes
 	 */
 	rq = deadline_next_request(dd, per_prio, dd->last_dir);
-	if (rq && dd->batching < dd->fifo_batch)
+	if (rq && dd->batching < dd->fifo_batch) {
 		/* we have a next request are still entitled to batch */
+		if (started_after(dd, rq, latest_start))
+			return NULL;
 		goto dispatch_request;
+	}
 
 	/*
 	 * at this point we are not running a batch. select the appropriate
@@ -445,6 +490,9 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	if (!rq)
 		return NULL;
 
+	if (started_after(dd, rq, latest_start))
+		return NULL;
+
 	dd->last_dir = data_dir;
 	dd->batching = 0;
 
@@ -466,6 +514,76 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	return rq;
 }
 
+/* Number of requests queued for a given priority level. */
+static u32 dd_queued(struct deadline_data *dd, enum dd_prio prio)
+{
+	return dd_sum(dd, inserted, prio) - dd_sum(dd, completed, prio);
+}
+
+/*
+ * Check whether there are any requests with priority other than DD_RT_PRIO
+ * that were inserted more than prio_aging_expire jiffies ago.
+ */
+static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
+						      unsigned long now)
+{
+	struct request *rq;
+	enum dd_prio prio;
+	int prio_cnt;
+
+	lockdep_assert_held(&dd->lock);
+
+	prio_cnt = !!dd_queued(dd, DD_RT_PRIO) + !!dd_queued(dd, DD_BE_PRIO) +
+		   !!dd_queued(dd, DD_IDLE_PRIO);
+	if (prio_cnt < 2)
+		return NULL;
+
+	for (prio = DD_BE_PRIO; prio <= DD_PRIO_MAX; prio++) {
+		rq = __dd_dispatch_request(dd, &dd->per_prio[prio],
+					   now - dd->prio_aging_expire);
+		if (rq) {
+			dd_count(dd, aged, prio);
+			return rq;
+		}
+	}
+
+	return NULL;
+}
+
+static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
+			      bool at_head);
+
+/*
+ * Move the requests staged by dd_insert_requests() to the sort and FIFO
+ * lists. Must be done before looking at those lists for dispatching or
+ * merging.
+ */
+static void dd_insert_staged(struct deadline_data *dd)
+{
+	LIST_HEAD(list);
+	int cpu;
+
+	lockdep_assert_held(&dd->lock);
+
+	for_each_cpu(cpu, dd->staged_cpus) {
+		struct dd_staging *ds = per_cpu_ptr(dd->staging, cpu);
+
+		/* Pairs with the set after adding to the list */
+		cpumask_clear_cpu(cpu, dd->staged_cpus);
+		spin_lock(&ds->lock);
+		list_splice_tail_init(&ds->list, &list);
+		spin_unlock(&ds->lock);
+	}
+
+	while (!list_empty(&list)) {
+		struct request *rq;
+
+		rq = list_first_entry(&list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		dd_insert_request(rq->mq_hctx, rq, false);
+	}
+}
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -477,15 +595,27 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	const unsigned long now = jiffies;
 	struct request *rq;
 	enum dd_prio prio;
 
 	spin_lock(&dd->lock);
+	dd_insert_staged(dd);
+	rq = dd_dispatch_prio_aged_requests(dd, now);
+	if (rq)
+		goto unlock;
+
+	/*
+	 * Next, dispatch requests in priority order. Ignore lower priority
+	 * requests if any higher priority requests are pending.
+	 */
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
-		rq = __dd_dispatch_request(dd, &dd->per_prio[prio]);
-		if (rq)
+		rq = __dd_dispatch_request(dd, &dd->per_prio[prio], now);
+		if (rq || dd_queued(dd, prio))
 			break;
 	}
+
+unlock:
 	spin_unlock(&dd->lock);
 
 	return rq;
@@ -540,7 +670,10 @@ static void dd_exit_sched(struct elevator_queue *e)
 		WARN_ON_ONCE(!list_empty(&per_prio->fifo_list[DD_READ]));
 		WARN_ON_ONCE(!list_empty(&per_prio->fifo_list[DD_WRITE]));
 	}
+	WARN_ON_ONCE(!cpumask_empty(dd->staged_cpus));
 
+	free_cpumask_var(dd->staged_cpus);
+	free_percpu(dd->staging);
 	free_percpu(dd->stats);
 
 	kfree(dd);
@@ -555,6 +688,7 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	struct elevator_queue *eq;
 	enum dd_prio prio;
 	int ret = -ENOMEM;
+	int cpu;
 
 	eq = elevator_alloc(q, e);
 	if (!eq)
@@ -571,6 +705,18 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	if (!dd->stats)
 		goto free_dd;
 
+	dd->staging = alloc_percpu(struct dd_staging);
+	if (!dd->staging)
+		goto free_stats;
+	if (!zalloc_cpumask_var(&dd->staged_cpus, GFP_KERNEL))
+		goto free_staging;
+	for_each_possible_cpu(cpu) {
+		struct dd_staging *ds = per_cpu_ptr(dd->staging, cpu);
+
+		spin_lock_init(&ds->lock);
+		INIT_LIST_HEAD(&ds->list);
+	}
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
 		struct dd_per_prio *per_prio = &dd->per_prio[prio];
 
@@ -586,12 +732,19 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	dd->front_merges = 1;
 	dd->last_dir = DD_WRITE;
 	dd->fifo_batch = fifo_batch;
+	dd->prio_aging_expire = prio_aging_expire;
 	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
 
 	q->elevator = eq;
 	return 0;
 
+free_staging:
+	free_percpu(dd->staging);
+
+free_stats:
+	free_percpu(dd->stats);
+
 free_dd:
 	kfree(dd);
 
@@ -644,6 +797,7 @@ static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 	bool ret;
 
 	spin_lock(&dd->lock);
+	dd_insert_staged(dd);
 	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
 	spin_unlock(&dd->lock);
 
@@ -689,6 +843,8 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 
 	per_prio = &dd->per_prio[prio];
 	if (at_head) {
+		/* For the aging in dd_dispatch_prio_aged_requests() */
+		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
 		list_add(&rq->queuelist, &per_prio->dispatch);
 	} else {
 		deadline_add_rq_rb(per_prio, rq);
@@ -707,6 +863,25 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	}
 }
 
+/*
+ * Put @list on the staging list of the local CPU instead of taking dd->lock.
+ * The requests are sorted in by the next dispatch or bio merge.
+ */
+static void dd_stage_requests(struct deadline_data *dd, struct list_head *list)
+{
+	struct dd_staging *ds;
+	int cpu;
+
+	cpu = get_cpu();
+	ds = per_cpu_ptr(dd->staging, cpu);
+	spin_lock(&ds->lock);
+	list_splice_tail_init(list, &ds->list);
+	spin_unlock(&ds->lock);
+	if (!cpumask_test_cpu(cpu, dd->staged_cpus))
+		cpumask_set_cpu(cpu, dd->staged_cpus);
+	put_cpu();
+}
+
 /*
  * Called from blk_mq_sched_insert_request() or blk_mq_sched_insert_requests().
  */
@@ -716,6 +891,16 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
 
+	/*
+	 * Zoned writes have to be on the FIFO lists for dd_finish_request()
+	 * to restart the queue, and head insertions have to go ahead of
+	 * everything.
+	 */
+	if (!at_head && !blk_queue_is_zoned(q)) {
+		dd_stage_requests(dd, list);
+		return;
+	}
+
 	spin_lock(&dd->lock);
 	while (!list_empty(list)) {
 		struct request *rq;
@@ -733,6 +918,21 @@ static void dd_prepare_request(struct request *rq)
 	rq->elv.priv[0] = NULL;
 }
 
+/* Callback from inside __blk_mq_end_request(), @now is its timestamp. */
+static void dd_completed_request(struct request *rq, u64 now)
+{
+	struct deadline_data *dd = rq->q->elevator->elevator_data;
+	const enum dd_prio prio = ioprio_class_to_prio[dd_rq_ioclass(rq)];
+	struct io_stats *io_stats;
+
+	if (!rq->elv.priv[0] || now <= rq->start_time_ns)
+		return;
+
+	io_stats = get_cpu_ptr(dd->stats);
+	local64_add(now - rq->start_time_ns, &io_stats->stats[prio].latency_ns);
+	put_cpu_ptr(io_stats);
+}
+
 /*
  * Callback from inside blk_mq_free_request().
  *
@@ -789,6 +989,9 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
 	enum dd_prio prio;
 
+	if (!cpumask_empty(dd->staged_cpus))
+		return true;
+
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
 		if (dd_has_work_for_prio(&dd->per_prio[prio]))
 			return true;
@@ -813,6 +1016,7 @@ SHOW_INT(deadline_writes_starved_show, dd->writes_starved);
 SHOW_INT(deadline_front_merges_show, dd->front_merges);
 SHOW_INT(deadline_async_depth_show, dd->async_depth);
 SHOW_INT(deadline_fifo_batch_show, dd->fifo_batch);
+SHOW_JIFFIES(deadline_prio_aging_expire_show, dd->prio_aging_expire);
 #undef SHOW_INT
 #undef SHOW_JIFFIES
 
@@ -842,6 +1046,8 @@ STORE_INT(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX);
 STORE_INT(deadline_front_merges_store, &dd->front_merges, 0, 1);
 STORE_INT(deadline_async_depth_store, &dd->async_depth, 1, INT_MAX);
 STORE_INT(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX);
+STORE_JIFFIES(deadline_prio_aging_expire_store, &dd->prio_aging_expire, 0,
+	      INT_MAX);
 #undef STORE_FUNCTION
 #undef STORE_INT
 #undef STORE_JIFFIES
@@ -856,6 +1062,7 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(front_merges),
 	DD_ATTR(async_depth),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(prio_aging_expire),
 	__ATTR_NULL
 };
 
@@ -947,12 +1154,6 @@ static int dd_async_depth_show(void *data, struct seq_file *m)
 	return 0;
 }
 
-/* Number of requests queued for a given priority level. */
-static u32 dd_queued(struct deadline_data *dd, enum dd_prio prio)
-{
-	return dd_sum(dd, inserted, prio) - dd_sum(dd, completed, prio);
-}
-
 static int dd_queued_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
@@ -982,6 +1183,45 @@ static int dd_owned_by_driver_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int dd_aged_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	seq_printf(m, "%u %u %u\n", dd_sum(dd, aged, DD_RT_PRIO),
+		   dd_sum(dd, aged, DD_BE_PRIO),
+		   dd_sum(dd, aged, DD_IDLE_PRIO));
+	return 0;
+}
+
+/* Average allocation to completion time for a given priority, in usecs. */
+static u64 dd_avg_latency_us(struct deadline_data *dd, enum dd_prio prio)
+{
+	u32 completed = dd_sum(dd, completed, prio);
+	unsigned int cpu;
+	u64 sum = 0;
+
+	if (!completed)
+		return 0;
+
+	for_each_present_cpu(cpu)
+		sum += local64_read(&per_cpu_ptr(dd->stats, cpu)->
+				    stats[prio].latency_ns);
+
+	return div_u64(sum, completed) / NSEC_PER_USEC;
+}
+
+static int dd_latency_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	seq_printf(m, "%llu %llu %llu\n", dd_avg_latency_us(dd, DD_RT_PRIO),
+		   dd_avg_latency_us(dd, DD_BE_PRIO),
+		   dd_avg_latency_us(dd, DD_IDLE_PRIO));
+	return 0;
+}
+
 #define DEADLINE_DISPATCH_ATTR(prio)					\
 static void *deadline_dispatch##prio##_start(struct seq_file *m,	\
 					     loff_t *pos)		\
@@ -1052,6 +1292,8 @@ static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
 	{"dispatch2", 0400, .seq_ops = &deadline_dispatch2_seq_ops},
 	{"owned_by_driver", 0400, dd_owned_by_driver_show},
 	{"queued", 0400, dd_queued_show},
+	{"aged", 0400, dd_aged_show},
+	{"latency_us", 0400, dd_latency_show},
 	{},
 };
 #undef DEADLINE_QUEUE_DDIR_ATTRS
@@ -1064,6 +1306,7 @@ static struct elevator_type mq_deadline = {
 		.insert_requests	= dd_insert_requests,
 		.dispatch_request	= dd_dispatch_request,
 		.prepare_request	= dd_prepare_request,
+		.completed_request	= dd_completed_request,
 		.finish_request		= dd_finish_request,
 		.next_request		= elv_rb_latter_request,
 		.former_request		= elv_rb_former_request,
@@ -21,6 +21,7 @@
 
 struct crypto_instance;
 struct crypto_template;
+struct shash_desc;
 
 struct crypto_larval {
 	struct crypto_alg alg;
@@ -150,6 +151,10 @@ static inline void crypto_notify(unsigned long val, void *v)
 	blocking_notifier_call_chain(&crypto_chain, val, v);
 }
 
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void crypto_yield(u32 flags)
 {
 	if (flags & CRYPTO_TFM_REQ_MAY_SLEEP)
@@ -194,6 +194,39 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+/*
+ * Finish @num_msgs messages of @len bytes each that share the state in @desc,
+ * e.g. the blocks of a file hashed with a common salt.  @desc itself is left
+ * untouched so the caller can go on with the next batch.
+ *
+ * Implementations that interleave several messages in SIMD registers only pay
+ * off for equally sized messages, which is why all of them have the same
+ * length.  Until an algorithm provides such an implementation the messages
+ * are finished one after the other from a copy of @desc.
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	unsigned int descsize = crypto_shash_descsize(tfm);
+	SHASH_DESC_ON_STACK(tmp, tfm);
+	unsigned int i;
+	int err = 0;
+
+	tmp->tfm = tfm;
+	for (i = 0; i < num_msgs; i++) {
+		memcpy(shash_desc_ctx(tmp), shash_desc_ctx(desc), descsize);
+		err = crypto_shash_finup(tmp, data[i], len, outs[i]);
+		if (err)
+			break;
+	}
+
+	shash_desc_zero(tmp);
+	return err;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
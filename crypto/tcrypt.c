@@ -33,6 +33,7 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include "internal.h"
 #include "tcrypt.h"
 
 /*
@@ -928,6 +929,156 @@ static void test_mb_ahash_speed(const char *algo, unsigned int secs,
 	kfree(data);
 }
 
+static inline int do_mult_shash_op(struct shash_desc *desc, const u8 **data,
+				   unsigned int blen, u8 **outs, u32 num_mb)
+{
+	return crypto_shash_init(desc) ?:
+	       crypto_shash_finup_mb(desc, data, blen, outs, num_mb);
+}
+
+static int test_mb_shash_jiffies(struct shash_desc *desc, const u8 **data,
+				 unsigned int blen, u8 **outs, int secs,
+				 u32 num_mb)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + secs * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = do_mult_shash_op(desc, data, blen, outs, num_mb);
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%d operations in %d seconds (%llu bytes)\n",
+		bcount * num_mb, secs, (u64)bcount * blen * num_mb);
+	return 0;
+}
+
+static int test_mb_shash_cycles(struct shash_desc *desc, const u8 **data,
+				unsigned int blen, u8 **outs, u32 num_mb)
+{
+	unsigned long cycles = 0;
+	int ret;
+	int i;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = do_mult_shash_op(desc, data, blen, outs, num_mb);
+		if (ret)
+			return ret;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = do_mult_shash_op(desc, data, blen, outs, num_mb);
+		end = get_cycles();
+
+		if (ret)
+			return ret;
+
+		cycles += end - start;
+	}
+
+	pr_cont("1 operation in %lu cycles (%u bytes)\n",
+		(cycles + 4) / (8 * num_mb), blen);
+	return 0;
+}
+
+/*
+ * Same as test_mb_ahash_speed(), but all num_mb messages are handed to the
+ * algorithm in one crypto_shash_finup_mb() call instead of as separate
+ * requests.
+ */
+static void test_mb_shash_speed(const char *algo, unsigned int secs,
+				struct hash_speed *speed, u32 num_mb)
+{
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+	const u8 **data;
+	u8 **outs;
+	unsigned int i, k;
+	int ret;
+
+	data = kcalloc(num_mb, sizeof(*data), GFP_KERNEL);
+	outs = kcalloc(num_mb, sizeof(*outs), GFP_KERNEL);
+	if (!data || !outs)
+		goto free_arrays;
+
+	tfm = crypto_alloc_shash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+			algo, PTR_ERR(tfm));
+		goto free_arrays;
+	}
+
+	desc = kzalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	if (!desc)
+		goto free_tfm;
+	desc->tfm = tfm;
+
+	for (k = 0; k < num_mb; k++) {
+		data[k] = kmalloc(XBUFSIZE * PAGE_SIZE, GFP_KERNEL);
+		outs[k] = kmalloc(MAX_DIGEST_SIZE, GFP_KERNEL);
+		if (!data[k] || !outs[k])
+			goto out;
+		memset((u8 *)data[k], 0xff, XBUFSIZE * PAGE_SIZE);
+	}
+
+	pr_info("\ntesting speed of multibuffer %s (%s)\n", algo,
+		crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)));
+
+	for (i = 0; speed[i].blen != 0; i++) {
+		/* Only whole messages are batched. */
+		if (speed[i].blen != speed[i].plen)
+			continue;
+
+		if (speed[i].blen > XBUFSIZE * PAGE_SIZE) {
+			pr_err("template (%u) too big for buffer (%lu)\n",
+			       speed[i].blen, XBUFSIZE * PAGE_SIZE);
+			goto out;
+		}
+
+		if (klen)
+			crypto_shash_setkey(tfm, tvmem[0], klen);
+
+		pr_info("test%3u "
+			"(%5u byte blocks,%5u bytes per update,%4u updates): ",
+			i, speed[i].blen, speed[i].plen,
+			speed[i].blen / speed[i].plen);
+
+		if (secs) {
+			ret = test_mb_shash_jiffies(desc, data, speed[i].blen,
+						    outs, secs, num_mb);
+			cond_resched();
+		} else {
+			ret = test_mb_shash_cycles(desc, data, speed[i].blen,
+						   outs, num_mb);
+		}
+
+		if (ret) {
+			pr_err("hashing failed ret=%d\n", ret);
+			break;
+		}
+	}
+
+out:
+	for (k = 0; k < num_mb; k++) {
+		kfree(data[k]);
+		kfree(outs[k]);
+	}
+	kfree_sensitive(desc);
+free_tfm:
+	crypto_free_shash(tfm);
+free_arrays:
+	kfree(outs);
+	kfree(data);
+}
+
 static int test_ahash_jiffies_digest(struct ahash_request *req, int blen,
 				     char *out, int secs)
 {
@@ -2608,6 +2759,16 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 				    generic_hash_speed_template, num_mb);
 		if (mode > 400 && mode < 500) break;
 		fallthrough;
+	case 428:
+		test_mb_shash_speed("sha256", sec, generic_hash_speed_template,
+				    num_mb);
+		if (mode > 400 && mode < 500) break;
+		fallthrough;
+	case 429:
+		test_mb_shash_speed("xxhash64", sec,
+				    generic_hash_speed_template, num_mb);
+		if (mode > 400 && mode < 500) break;
+		fallthrough;
 	case 499:
 		break;
 
@@ -133,6 +133,7 @@ static void loop_global_unlock(struct loop_device *lo, bool global)
 
 static int max_part;
 static int part_shift;
+static bool auto_dio;
 
 static int transfer_xor(struct loop_device *lo, int cmd,
 			struct page *raw_page, unsigned raw_off,
@@ -670,7 +671,7 @@ static int do_req_filebacked(struct loop_device *lo, struct request *rq)
 static inline void loop_update_dio(struct loop_device *lo)
 {
 	__loop_update_dio(lo, (lo->lo_backing_file->f_flags & O_DIRECT) |
-				lo->use_dio);
+				lo->use_dio | lo->dio_auto);
 }
 
 static void loop_reread_partitions(struct loop_device *lo)
@@ -991,6 +992,8 @@ static inline int queue_on_root_worker(struct cgroup_subsys_state *css)
 
 static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 {
+	struct blk_mq_hw_ctx *hctx;
+	struct loop_hw_queue *lq;
 	struct rb_node **node = &(lo->worker_tree.rb_node), *parent = NULL;
 	struct loop_worker *cur_worker, *worker = NULL;
 	struct work_struct *work;
@@ -1051,8 +1054,11 @@ static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 		work = &worker->work;
 		cmd_list = &worker->cmd_list;
 	} else {
-		work = &lo->rootcg_work;
-		cmd_list = &lo->rootcg_cmd_list;
+		/* One worker per hw queue, so that they can run in parallel */
+		hctx = blk_mq_rq_from_pdu(cmd)->mq_hctx;
+		lq = &lo->rootcg_queues[hctx->queue_num];
+		work = &lq->work;
+		cmd_list = &lq->cmd_list;
 	}
 	list_add_tail(&cmd->list_entry, cmd_list);
 	queue_work(lo->workqueue, work);
@@ -1195,6 +1201,7 @@ static int loop_configure(struct loop_device *lo, fmode_t mode,
 	bool partscan;
 	unsigned short bsize;
 	bool is_loop;
+	unsigned int i;
 
 	if (!file)
 		return -EBADF;
@@ -1259,13 +1266,17 @@ static int loop_configure(struct loop_device *lo, fmode_t mode,
 	disk_force_media_change(lo->lo_disk, DISK_EVENT_MEDIA_CHANGE);
 	set_disk_ro(lo->lo_disk, (lo->lo_flags & LO_FLAGS_READ_ONLY) != 0);
 
-	INIT_WORK(&lo->rootcg_work, loop_rootcg_workfn);
-	INIT_LIST_HEAD(&lo->rootcg_cmd_list);
+	for (i = 0; i < lo->tag_set.nr_hw_queues; i++) {
+		INIT_WORK(&lo->rootcg_queues[i].work, loop_rootcg_workfn);
+		INIT_LIST_HEAD(&lo->rootcg_queues[i].cmd_list);
+		lo->rootcg_queues[i].lo = lo;
+	}
 	INIT_LIST_HEAD(&lo->idle_worker_list);
 	lo->worker_tree = RB_ROOT;
 	timer_setup(&lo->timer, loop_free_idle_workers,
 		TIMER_DEFERRABLE);
 	lo->use_dio = lo->lo_flags & LO_FLAGS_DIRECT_IO;
+	lo->dio_auto = auto_dio;
 	lo->lo_device = bdev;
 	lo->lo_backing_file = file;
 	lo->old_gfp_mask = mapping_gfp_mask(mapping);
@@ -1556,7 +1567,7 @@ loop_set_status(struct loop_device *lo, const struct loop_info64 *info)
 	loop_config_discard(lo);
 
 	/* update dio if lo_offset or transfer is changed */
-	__loop_update_dio(lo, lo->use_dio);
+	__loop_update_dio(lo, lo->use_dio || lo->dio_auto);
 
 out_unfreeze:
 	blk_mq_unfreeze_queue(lo->lo_queue);
@@ -1742,6 +1753,8 @@ static int loop_set_dio(struct loop_device *lo, unsigned long arg)
 	if (lo->lo_state != Lo_bound)
 		goto out;
 
+	/* An explicit choice overrides auto_dio */
+	lo->dio_auto = false;
 	__loop_update_dio(lo, !!arg);
 	if (lo->use_dio == !!arg)
 		return 0;
@@ -2096,6 +2109,14 @@ module_param(max_loop, int, 0444);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+static unsigned int hw_queues = 1;
+module_param(hw_queues, uint, 0444);
+MODULE_PARM_DESC(hw_queues, "Number of hardware queues per loop device (default 1)");
+static unsigned int hw_queue_depth = 128;
+module_param(hw_queue_depth, uint, 0444);
+MODULE_PARM_DESC(hw_queue_depth, "Queue depth of each hardware queue (default 128)");
+module_param(auto_dio, bool, 0644);
+MODULE_PARM_DESC(auto_dio, "Use direct I/O whenever the backing file allows it");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
@@ -2265,9 +2286,9 @@ static void loop_workfn(struct work_struct *work)
 
 static void loop_rootcg_workfn(struct work_struct *work)
 {
-	struct loop_device *lo =
-		container_of(work, struct loop_device, rootcg_work);
-	loop_process_work(NULL, &lo->rootcg_cmd_list, lo);
+	struct loop_hw_queue *lq =
+		container_of(work, struct loop_hw_queue, work);
+	loop_process_work(NULL, &lq->cmd_list, lq->lo);
 }
 
 static void loop_free_idle_workers(struct timer_list *timer)
@@ -2327,14 +2348,19 @@ static int loop_add(int i)
 
 	err = -ENOMEM;
 	lo->tag_set.ops = &loop_mq_ops;
-	lo->tag_set.nr_hw_queues = 1;
-	lo->tag_set.queue_depth = 128;
+	lo->tag_set.nr_hw_queues = clamp_val(hw_queues, 1, nr_cpu_ids);
+	lo->tag_set.queue_depth = clamp_val(hw_queue_depth, 1, BLK_MQ_MAX_DEPTH);
 	lo->tag_set.numa_node = NUMA_NO_NODE;
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
 	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_STACKING |
 		BLK_MQ_F_NO_SCHED_BY_DEFAULT;
 	lo->tag_set.driver_data = lo;
 
+	lo->rootcg_queues = kcalloc(lo->tag_set.nr_hw_queues,
+				    sizeof(*lo->rootcg_queues), GFP_KERNEL);
+	if (!lo->rootcg_queues)
+		goto out_free_idr;
+
 	err = blk_mq_alloc_tag_set(&lo->tag_set);
 	if (err)
 		goto out_free_idr;
@@ -2406,6 +2432,7 @@ static int loop_add(int i)
 	idr_remove(&loop_index_idr, i);
 	mutex_unlock(&loop_ctl_mutex);
 out_free_dev:
+	kfree(lo->rootcg_queues);
 	kfree(lo);
 out:
 	return err;
@@ -2422,6 +2449,7 @@ static void loop_remove(struct loop_device *lo)
 	mutex_unlock(&loop_ctl_mutex);
 	/* There is no route which can find this loop device. */
 	mutex_destroy(&lo->lo_mutex);
+	kfree(lo->rootcg_queues);
 	kfree(lo);
 }
 
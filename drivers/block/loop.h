@@ -26,6 +26,13 @@ enum {
 
 struct loop_func_table;
 
+/* Commands of the root cgroup queued on one hw queue */
+struct loop_hw_queue {
+	struct work_struct	work;
+	struct list_head	cmd_list;
+	struct loop_device	*lo;
+};
+
 struct loop_device {
 	int		lo_number;
 	atomic_t	lo_refcnt;
@@ -56,12 +63,12 @@ struct loop_device {
 	int			lo_state;
 	spinlock_t              lo_work_lock;
 	struct workqueue_struct *workqueue;
-	struct work_struct      rootcg_work;
-	struct list_head        rootcg_cmd_list;
+	struct loop_hw_queue	*rootcg_queues;
 	struct list_head        idle_worker_list;
 	struct rb_root          worker_tree;
 	struct timer_list       timer;
 	bool			use_dio;
+	bool			dio_auto;	/* use dio whenever possible */
 	bool			sysfs_inited;
 
 	struct request_queue	*lo_queue;
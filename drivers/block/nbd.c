@@ -156,6 +156,8 @@ static struct dentry *nbd_dbg_dir;
 static unsigned int nbds_max = 16;
 static int max_part = 16;
 static int part_shift;
+static bool recv_affinity;
+static bool zerocopy_send;
 
 static int nbd_dev_dbg_init(struct nbd_device *nbd);
 static void nbd_dev_dbg_close(struct nbd_device *nbd);
@@ -532,6 +534,46 @@ static int sock_xmit(struct nbd_device *nbd, int index, int send,
 	return result;
 }
 
+/*
+ * Send one page of write data without copying it into the socket buffers.
+ */
+static int sock_send_page(struct nbd_device *nbd, int index,
+			  struct bio_vec *bvec, int msg_flags, int *sent)
+{
+	struct nbd_config *config = nbd->config;
+	struct socket *sock = config->socks[index]->sock;
+	unsigned int offset = bvec->bv_offset;
+	unsigned int len = bvec->bv_len;
+	unsigned int noreclaim_flag;
+	int result;
+
+	if (unlikely(!sock)) {
+		dev_err_ratelimited(disk_to_dev(nbd->disk),
+			"Attempted send on closed socket in sock_send_page\n");
+		return -EINVAL;
+	}
+
+	noreclaim_flag = memalloc_noreclaim_save();
+	do {
+		sock->sk->sk_allocation = GFP_NOIO | __GFP_MEMALLOC;
+		result = kernel_sendpage(sock, bvec->bv_page, offset, len,
+					 msg_flags | MSG_NOSIGNAL);
+		if (result <= 0) {
+			if (result == 0)
+				result = -EPIPE;
+			break;
+		}
+		if (sent)
+			*sent += result;
+		offset += result;
+		len -= result;
+	} while (len);
+
+	memalloc_noreclaim_restore(noreclaim_flag);
+
+	return result;
+}
+
 /*
  * Different settings for sk->sk_sndtimeo can result in different return values
  * if there is a signal pending when we enter sendmsg, because reasons?
@@ -644,16 +686,24 @@ static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd, int index)
 
 			dev_dbg(nbd_to_dev(nbd), "request %p: sending %d bytes data\n",
 				req, bvec.bv_len);
-			iov_iter_bvec(&from, WRITE, &bvec, 1, bvec.bv_len);
 			if (skip) {
-				if (skip >= iov_iter_count(&from)) {
-					skip -= iov_iter_count(&from);
+				if (skip >= bvec.bv_len) {
+					skip -= bvec.bv_len;
 					continue;
 				}
-				iov_iter_advance(&from, skip);
+				bvec.bv_offset += skip;
+				bvec.bv_len -= skip;
 				skip = 0;
 			}
-			result = sock_xmit(nbd, index, 1, &from, flags, &sent);
+			if (zerocopy_send && sendpage_ok(bvec.bv_page)) {
+				result = sock_send_page(nbd, index, &bvec,
+							flags, &sent);
+			} else {
+				iov_iter_bvec(&from, WRITE, &bvec, 1,
+					      bvec.bv_len);
+				result = sock_xmit(nbd, index, 1, &from, flags,
+						   &sent);
+			}
 			if (result <= 0) {
 				if (was_interrupted(result)) {
 					/* We've already sent the header, we
@@ -1106,6 +1156,28 @@ static int nbd_add_socket(struct nbd_device *nbd, unsigned long arg,
 	return err;
 }
 
+/*
+ * With recv_affinity, the receive worker of connection i runs on a CPU that
+ * submits to hw queue i, so replies are completed close to the submitter.
+ */
+static void nbd_queue_recv_work(struct nbd_device *nbd,
+				struct recv_thread_args *args)
+{
+	struct blk_mq_hw_ctx *hctx;
+	int cpu;
+
+	if (recv_affinity && args->index < nbd->tag_set.nr_hw_queues) {
+		hctx = nbd->disk->queue->queue_hw_ctx[args->index];
+		cpu = cpumask_first_and(hctx->cpumask, cpu_online_mask);
+		if (cpu < nr_cpu_ids) {
+			queue_work_on(cpu, nbd->recv_workq, &args->work);
+			return;
+		}
+	}
+
+	queue_work(nbd->recv_workq, &args->work);
+}
+
 static int nbd_reconnect_socket(struct nbd_device *nbd, unsigned long arg)
 {
 	struct nbd_config *config = nbd->config;
@@ -1156,7 +1228,7 @@ static int nbd_reconnect_socket(struct nbd_device *nbd, unsigned long arg)
 		/* We take the tx_mutex in an error path in the recv_work, so we
 		 * need to queue_work outside of the tx_mutex.
 		 */
-		queue_work(nbd->recv_workq, &args->work);
+		nbd_queue_recv_work(nbd, args);
 
 		atomic_inc(&config->live_connections);
 		wake_up(&config->conn_wait);
@@ -1332,7 +1404,7 @@ static int nbd_start_device(struct nbd_device *nbd)
 		INIT_WORK(&args->work, recv_work);
 		args->nbd = nbd;
 		args->index = i;
-		queue_work(nbd->recv_workq, &args->work);
+		nbd_queue_recv_work(nbd, args);
 	}
 	return nbd_set_size(nbd, config->bytesize, nbd_blksize(config));
 }
@@ -1723,9 +1795,11 @@ static struct nbd_device *nbd_dev_add(int index, unsigned int refs)
 	}
 	nbd->disk = disk;
 
+	/* The receive workers are long running, keep them out of the way */
 	nbd->recv_workq = alloc_workqueue("nbd%d-recv",
 					  WQ_MEM_RECLAIM | WQ_HIGHPRI |
-					  WQ_UNBOUND, 0, nbd->index);
+					  (recv_affinity ? WQ_CPU_INTENSIVE :
+					   WQ_UNBOUND), 0, nbd->index);
 	if (!nbd->recv_workq) {
 		dev_err(disk_to_dev(nbd->disk), "Could not allocate knbd recv work queue.\n");
 		err = -ENOMEM;
@@ -2525,3 +2599,7 @@ module_param(nbds_max, int, 0444);
 MODULE_PARM_DESC(nbds_max, "number of network block devices to initialize (default: 16)");
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "number of partitions per device (default: 16)");
+module_param(recv_affinity, bool, 0444);
+MODULE_PARM_DESC(recv_affinity, "run the receive worker of each connection on a CPU of its hw queue (default: false)");
+module_param(zerocopy_send, bool, 0644);
+MODULE_PARM_DESC(zerocopy_send, "send write data with sendpage instead of copying it (default: false)");
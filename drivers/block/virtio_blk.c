@@ -258,9 +258,21 @@ static inline void virtblk_request_done(struct request *req)
 	blk_mq_end_request(req, virtblk_result(vbr));
 }
 
+static void virtblk_complete_batch(struct io_comp_batch *iob)
+{
+	struct request *req;
+
+	list_for_each_entry(req, &iob->req_list, queuelist) {
+		virtblk_unmap_data(req, blk_mq_rq_to_pdu(req));
+		virtblk_cleanup_cmd(req);
+	}
+	blk_mq_end_request_batch(iob);
+}
+
 static void virtblk_done(struct virtqueue *vq)
 {
 	struct virtio_blk *vblk = vq->vdev->priv;
+	DEFINE_IO_COMP_BATCH(iob);
 	bool req_done = false;
 	int qid = vq->index;
 	struct virtblk_req *vbr;
@@ -273,8 +285,12 @@ static void virtblk_done(struct virtqueue *vq)
 		while ((vbr = virtqueue_get_buf(vblk->vqs[qid].vq, &len)) != NULL) {
 			struct request *req = blk_mq_rq_from_pdu(vbr);
 
-			if (likely(!blk_should_fake_timeout(req->q)))
-				blk_mq_complete_request(req);
+			if (likely(!blk_should_fake_timeout(req->q)) &&
+			    !blk_mq_complete_request_remote(req) &&
+			    !blk_mq_add_to_batch(req, &iob,
+						 virtblk_result(vbr) != BLK_STS_OK,
+						 virtblk_complete_batch))
+				virtblk_request_done(req);
 			req_done = true;
 		}
 		if (unlikely(virtqueue_is_broken(vq)))
@@ -285,6 +301,10 @@ static void virtblk_done(struct virtqueue *vq)
 	if (req_done)
 		blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
 	spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
+
+	/* End the batch outside the vq lock */
+	if (!list_empty(&iob.req_list))
+		iob.complete(&iob);
 }
 
 static void virtio_commit_rqs(struct blk_mq_hw_ctx *hctx)
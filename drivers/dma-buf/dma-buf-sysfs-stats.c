@@ -40,6 +40,11 @@
  *
  * * ``/sys/kernel/dmabuf/buffers/<inode_number>/exporter_name``
  * * ``/sys/kernel/dmabuf/buffers/<inode_number>/size``
+ * * ``/sys/kernel/dmabuf/buffers/<inode_number>/cpu_access_waits``
+ * * ``/sys/kernel/dmabuf/buffers/<inode_number>/cpu_access_wait_us``
+ *
+ * The last two count the times CPU access to the buffer had to wait for
+ * its implicit fences and the total time spent waiting.
  *
  * The information in the interface can also be used to derive per-exporter
  * statistics. The data from the interface can be gathered on error conditions
@@ -93,13 +98,36 @@ static ssize_t size_show(struct dma_buf *dmabuf,
 	return sysfs_emit(buf, "%zu\n", dmabuf->size);
 }
 
+static ssize_t cpu_access_waits_show(struct dma_buf *dmabuf,
+				     struct dma_buf_stats_attribute *attr,
+				     char *buf)
+{
+	return sysfs_emit(buf, "%lld\n",
+		atomic64_read(&dmabuf->sysfs_entry->cpu_access_waits));
+}
+
+static ssize_t cpu_access_wait_us_show(struct dma_buf *dmabuf,
+				       struct dma_buf_stats_attribute *attr,
+				       char *buf)
+{
+	return sysfs_emit(buf, "%lld\n",
+		div_u64(atomic64_read(&dmabuf->sysfs_entry->cpu_access_wait_ns),
+			NSEC_PER_USEC));
+}
+
 static struct dma_buf_stats_attribute exporter_name_attribute =
 	__ATTR_RO(exporter_name);
 static struct dma_buf_stats_attribute size_attribute = __ATTR_RO(size);
+static struct dma_buf_stats_attribute cpu_access_waits_attribute =
+	__ATTR_RO(cpu_access_waits);
+static struct dma_buf_stats_attribute cpu_access_wait_us_attribute =
+	__ATTR_RO(cpu_access_wait_us);
 
 static struct attribute *dma_buf_stats_default_attrs[] = {
 	&exporter_name_attribute.attr,
 	&size_attribute.attr,
+	&cpu_access_waits_attribute.attr,
+	&cpu_access_wait_us_attribute.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(dma_buf_stats_default);
@@ -130,6 +158,17 @@ void dma_buf_stats_teardown(struct dma_buf *dmabuf)
 	kobject_put(&sysfs_entry->kobj);
 }
 
+void dma_buf_stats_account_wait(struct dma_buf *dmabuf, u64 wait_ns)
+{
+	struct dma_buf_sysfs_entry *sysfs_entry = dmabuf->sysfs_entry;
+
+	if (!sysfs_entry)
+		return;
+
+	atomic64_inc(&sysfs_entry->cpu_access_waits);
+	atomic64_add(wait_ns, &sysfs_entry->cpu_access_wait_ns);
+}
+
 
 /* Statistics files do not need to send uevents. */
 static int dmabuf_sysfs_uevent_filter(struct kset *kset, struct kobject *kobj)
@@ -16,6 +16,8 @@ void dma_buf_uninit_sysfs_statistics(void);
 int dma_buf_stats_setup(struct dma_buf *dmabuf);
 
 void dma_buf_stats_teardown(struct dma_buf *dmabuf);
+
+void dma_buf_stats_account_wait(struct dma_buf *dmabuf, u64 wait_ns);
 #else
 
 static inline int dma_buf_init_sysfs_statistics(void)
@@ -31,5 +33,8 @@ static inline int dma_buf_stats_setup(struct dma_buf *dmabuf)
 }
 
 static inline void dma_buf_stats_teardown(struct dma_buf *dmabuf) {}
+
+static inline void dma_buf_stats_account_wait(struct dma_buf *dmabuf,
+					      u64 wait_ns) {}
 #endif
 #endif // _DMA_BUF_SYSFS_STATS_H
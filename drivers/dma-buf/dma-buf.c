@@ -1197,10 +1197,17 @@ static int __dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
 	bool write = (direction == DMA_BIDIRECTIONAL ||
 		      direction == DMA_TO_DEVICE);
 	struct dma_resv *resv = dmabuf->resv;
+	ktime_t start;
 	long ret;
 
+	if (dma_resv_test_signaled(resv, write))
+		return 0;
+
 	/* Wait on any implicit rendering fences */
+	start = ktime_get();
 	ret = dma_resv_wait_timeout(resv, write, true, MAX_SCHEDULE_TIMEOUT);
+	dma_buf_stats_account_wait(dmabuf,
+				   ktime_to_ns(ktime_sub(ktime_get(), start)));
 	if (ret < 0)
 		return ret;
 
@@ -196,6 +196,20 @@ static void ib_cq_completion_workqueue(struct ib_cq *cq, void *private)
 	queue_work(cq->comp_wq, &cq->work);
 }
 
+/* NUMA node serving the interrupts of @comp_vector, if the driver tells */
+static int ib_comp_vector_node(struct ib_device *dev, int comp_vector)
+{
+	const struct cpumask *mask = ib_get_vector_affinity(dev, comp_vector);
+	unsigned int cpu;
+
+	if (!mask)
+		return NUMA_NO_NODE;
+	cpu = cpumask_first(mask);
+	if (cpu >= nr_cpu_ids)
+		return NUMA_NO_NODE;
+	return cpu_to_node(cpu);
+}
+
 /**
  * __ib_alloc_cq - allocate a completion queue
  * @dev:		device to allocate the CQ for
@@ -231,7 +245,9 @@ struct ib_cq *__ib_alloc_cq(struct ib_device *dev, void *private, int nr_cqe,
 	atomic_set(&cq->usecnt, 0);
 	cq->comp_vector = comp_vector;
 
-	cq->wc = kmalloc_array(IB_POLL_BATCH, sizeof(*cq->wc), GFP_KERNEL);
+	/* Polled wherever the vector interrupts, keep the WC batch there */
+	cq->wc = kmalloc_array_node(IB_POLL_BATCH, sizeof(*cq->wc), GFP_KERNEL,
+				    ib_comp_vector_node(dev, comp_vector));
 	if (!cq->wc)
 		goto out_free_cq;
 
@@ -410,6 +426,33 @@ static int ib_alloc_cqs(struct ib_device *dev, unsigned int nr_cqes,
 	return ret;
 }
 
+/*
+ * Round robin over the completion vectors for users without a preference,
+ * skipping the vectors whose interrupts are served on another NUMA node
+ * than the caller's. Falls back to plain round robin if the driver does
+ * not report vector affinity or no vector is local.
+ */
+static unsigned int ib_cq_pool_default_vector(struct ib_device *dev,
+					      unsigned int num_comp_vectors)
+{
+	static unsigned int default_comp_vector;
+	const struct cpumask *node_mask = cpumask_of_node(numa_node_id());
+	unsigned int start = READ_ONCE(default_comp_vector);
+	const struct cpumask *mask;
+	unsigned int i, vector;
+
+	for (i = 1; i <= num_comp_vectors; i++) {
+		vector = (start + i) % num_comp_vectors;
+		mask = ib_get_vector_affinity(dev, vector);
+		if (!mask || cpumask_intersects(mask, node_mask))
+			goto out;
+	}
+	vector = (start + 1) % num_comp_vectors;
+out:
+	WRITE_ONCE(default_comp_vector, vector);
+	return vector;
+}
+
 /**
  * ib_cq_pool_get() - Find the least used completion queue that matches
  *   a given cpu hint (or least used for wild card affinity) and fits
@@ -417,7 +460,8 @@ static int ib_alloc_cqs(struct ib_device *dev, unsigned int nr_cqes,
  * @dev: rdma device
  * @nr_cqe: number of needed cqe entries
  * @comp_vector_hint: completion vector hint (-1) for the driver to assign
- *   a comp vector based on internal counter
+ *   a comp vector based on internal counter, preferring vectors local to
+ *   the caller's NUMA node
  * @poll_ctx: cq polling context
  *
  * Finds a cq that satisfies @comp_vector_hint and @nr_cqe requirements and
@@ -430,7 +474,6 @@ struct ib_cq *ib_cq_pool_get(struct ib_device *dev, unsigned int nr_cqe,
 			     int comp_vector_hint,
 			     enum ib_poll_context poll_ctx)
 {
-	static unsigned int default_comp_vector;
 	unsigned int vector, num_comp_vectors;
 	struct ib_cq *cq, *found = NULL;
 	int ret;
@@ -443,12 +486,10 @@ struct ib_cq *ib_cq_pool_get(struct ib_device *dev, unsigned int nr_cqe,
 	num_comp_vectors =
 		min_t(unsigned int, dev->num_comp_vectors, num_online_cpus());
 	/* Project the affinty to the device completion vector range */
-	if (comp_vector_hint < 0) {
-		comp_vector_hint =
-			(READ_ONCE(default_comp_vector) + 1) % num_comp_vectors;
-		WRITE_ONCE(default_comp_vector, comp_vector_hint);
-	}
-	vector = comp_vector_hint % num_comp_vectors;
+	if (comp_vector_hint < 0)
+		vector = ib_cq_pool_default_vector(dev, num_comp_vectors);
+	else
+		vector = comp_vector_hint % num_comp_vectors;
 
 	/*
 	 * Find the least used CQ with correct affinity and
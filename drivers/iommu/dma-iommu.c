@@ -9,6 +9,7 @@
  */
 
 #include <linux/acpi_iort.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/dma-map-ops.h>
 #include <linux/dma-iommu.h>
@@ -54,6 +55,10 @@ struct iommu_dma_cookie {
 static DEFINE_STATIC_KEY_FALSE(iommu_deferred_attach_enabled);
 bool iommu_dma_forcedac __read_mostly;
 
+/* Reported in debugfs, summed over all DMA domains */
+static atomic64_t iommu_dma_alloc_fails;
+static atomic64_t iommu_dma_fq_flushes;
+
 static int __init iommu_dma_forcedac_setup(char *str)
 {
 	int ret = kstrtobool(str, &iommu_dma_forcedac);
@@ -310,6 +315,7 @@ static void iommu_dma_flush_iotlb_all(struct iova_domain *iovad)
 	domain = cookie->fq_domain;
 
 	domain->ops->flush_iotlb_all(domain);
+	atomic64_inc(&iommu_dma_fq_flushes);
 }
 
 static bool dev_is_untrusted(struct device *dev)
@@ -455,7 +461,7 @@ static dma_addr_t iommu_dma_alloc_iova(struct iommu_domain *domain,
 	 * rounding up anything cacheable to make sure that can't happen. The
 	 * order of the unadjusted size will still match upon freeing.
 	 */
-	if (iova_len < (1 << (IOVA_RANGE_CACHE_MAX_SIZE - 1)))
+	if (iova_len < iova_rcache_range())
 		iova_len = roundup_pow_of_two(iova_len);
 
 	dma_limit = min_not_zero(dma_limit, dev->bus_dma_limit);
@@ -472,6 +478,9 @@ static dma_addr_t iommu_dma_alloc_iova(struct iommu_domain *domain,
 		iova = alloc_iova_fast(iovad, iova_len, dma_limit >> shift,
 				       true);
 
+	if (!iova)
+		atomic64_inc(&iommu_dma_alloc_fails);
+
 	return (dma_addr_t)iova << shift;
 }
 
@@ -1423,11 +1432,35 @@ void iommu_dma_compose_msi_msg(struct msi_desc *desc,
 	msg->address_lo += lower_32_bits(msi_page->iova);
 }
 
+#ifdef CONFIG_IOMMU_DEBUGFS
+static int iommu_dma_stats_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "iova_alloc_fails %lld\n",
+		   atomic64_read(&iommu_dma_alloc_fails));
+	seq_printf(m, "fq_flushes %lld\n",
+		   atomic64_read(&iommu_dma_fq_flushes));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(iommu_dma_stats);
+
+static void iommu_dma_init_debugfs(void)
+{
+	debugfs_create_file("dma_stats", 0444, iommu_debugfs_dir, NULL,
+			    &iommu_dma_stats_fops);
+}
+#else
+static inline void iommu_dma_init_debugfs(void)
+{
+}
+#endif
+
 static int iommu_dma_init(void)
 {
 	if (is_kdump_kernel())
 		static_branch_enable(&iommu_deferred_attach_enabled);
 
+	iommu_dma_init_debugfs();
+
 	return iova_cache_get();
 }
 arch_initcall(iommu_dma_init);
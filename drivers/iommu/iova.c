@@ -15,6 +15,39 @@
 /* The anchor node sits above the top of the usable address space */
 #define IOVA_ANCHOR	~0UL
 
+/*
+ * Number of range sizes, from one page up, kept in the per-CPU caches.
+ * Only read when a domain is set up and torn down, hence not writable.
+ */
+static unsigned int rcache_orders = IOVA_RANGE_CACHE_DEFAULT;
+module_param(rcache_orders, uint, 0444);
+MODULE_PARM_DESC(rcache_orders,
+		 "Number of IOVA range size orders cached per CPU (1-"
+		 __stringify(IOVA_RANGE_CACHE_MAX_SIZE) ")");
+
+static unsigned int fq_timeout_ms = IOVA_FQ_TIMEOUT;
+module_param(fq_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(fq_timeout_ms,
+		 "Maximum time in ms unmapped IOVAs wait in a flush queue");
+
+static inline unsigned int iova_rcache_orders(void)
+{
+	return clamp_t(unsigned int, rcache_orders, 1,
+		       IOVA_RANGE_CACHE_MAX_SIZE);
+}
+
+/**
+ * iova_rcache_range - largest IOVA range size served by the rcaches
+ *
+ * Callers of alloc_iova_fast() should round smaller sizes up to a
+ * power of two so they can be served by the rcaches.
+ */
+unsigned long iova_rcache_range(void)
+{
+	return 1UL << (iova_rcache_orders() - 1);
+}
+EXPORT_SYMBOL_GPL(iova_rcache_range);
+
 static bool iova_rcache_insert(struct iova_domain *iovad,
 			       unsigned long pfn,
 			       unsigned long size);
@@ -674,7 +707,7 @@ void queue_iova(struct iova_domain *iovad,
 	if (!atomic_read(&iovad->fq_timer_on) &&
 	    !atomic_xchg(&iovad->fq_timer_on, 1))
 		mod_timer(&iovad->fq_timer,
-			  jiffies + msecs_to_jiffies(IOVA_FQ_TIMEOUT));
+			  jiffies + msecs_to_jiffies(max(READ_ONCE(fq_timeout_ms), 1U)));
 }
 
 /**
@@ -891,7 +924,7 @@ static void init_iova_rcaches(struct iova_domain *iovad)
 	unsigned int cpu;
 	int i;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_orders(); ++i) {
 		rcache = &iovad->rcaches[i];
 		spin_lock_init(&rcache->lock);
 		rcache->depot_size = 0;
@@ -966,7 +999,7 @@ static bool iova_rcache_insert(struct iova_domain *iovad, unsigned long pfn,
 {
 	unsigned int log_size = order_base_2(size);
 
-	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
+	if (log_size >= iova_rcache_orders())
 		return false;
 
 	return __iova_rcache_insert(iovad, &iovad->rcaches[log_size], pfn);
@@ -1022,7 +1055,7 @@ static unsigned long iova_rcache_get(struct iova_domain *iovad,
 {
 	unsigned int log_size = order_base_2(size);
 
-	if (log_size >= IOVA_RANGE_CACHE_MAX_SIZE)
+	if (log_size >= iova_rcache_orders())
 		return 0;
 
 	return __iova_rcache_get(&iovad->rcaches[log_size], limit_pfn - size);
@@ -1038,7 +1071,7 @@ static void free_iova_rcaches(struct iova_domain *iovad)
 	unsigned int cpu;
 	int i, j;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_orders(); ++i) {
 		rcache = &iovad->rcaches[i];
 		for_each_possible_cpu(cpu) {
 			cpu_rcache = per_cpu_ptr(rcache->cpu_rcaches, cpu);
@@ -1061,7 +1094,7 @@ static void free_cpu_cached_iovas(unsigned int cpu, struct iova_domain *iovad)
 	unsigned long flags;
 	int i;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_orders(); ++i) {
 		rcache = &iovad->rcaches[i];
 		cpu_rcache = per_cpu_ptr(rcache->cpu_rcaches, cpu);
 		spin_lock_irqsave(&cpu_rcache->lock, flags);
@@ -1080,7 +1113,7 @@ static void free_global_cached_iovas(struct iova_domain *iovad)
 	unsigned long flags;
 	int i, j;
 
-	for (i = 0; i < IOVA_RANGE_CACHE_MAX_SIZE; ++i) {
+	for (i = 0; i < iova_rcache_orders(); ++i) {
 		rcache = &iovad->rcaches[i];
 		spin_lock_irqsave(&rcache->lock, flags);
 		for (j = 0; j < rcache->depot_size; ++j) {
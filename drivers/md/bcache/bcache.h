@@ -375,6 +375,8 @@ struct cached_dev {
 	unsigned int		writeback_consider_fragment:1;
 	unsigned char		writeback_percent;
 	unsigned int		writeback_delay;
+	/* non-contiguous runs of dirty keys written back per pass */
+	unsigned int		writeback_streams;
 
 	uint64_t		writeback_rate_target;
 	int64_t			writeback_rate_proportional;
@@ -116,6 +116,7 @@ rw_attribute(writeback_metadata);
 rw_attribute(writeback_running);
 rw_attribute(writeback_percent);
 rw_attribute(writeback_delay);
+rw_attribute(writeback_streams);
 rw_attribute(writeback_rate);
 rw_attribute(writeback_consider_fragment);
 
@@ -200,6 +201,7 @@ SHOW(__bch_cached_dev)
 	var_printf(writeback_running,	"%i");
 	var_printf(writeback_consider_fragment,	"%i");
 	var_print(writeback_delay);
+	var_print(writeback_streams);
 	var_print(writeback_percent);
 	sysfs_hprint(writeback_rate,
 		     wb ? atomic_long_read(&dc->writeback_rate.rate) << 9 : 0);
@@ -311,6 +313,8 @@ STORE(__cached_dev)
 	sysfs_strtoul_bool(writeback_running, dc->writeback_running);
 	sysfs_strtoul_bool(writeback_consider_fragment, dc->writeback_consider_fragment);
 	sysfs_strtoul_clamp(writeback_delay, dc->writeback_delay, 0, UINT_MAX);
+	sysfs_strtoul_clamp(writeback_streams, dc->writeback_streams,
+			    1, MAX_WRITEBACK_STREAMS);
 
 	sysfs_strtoul_clamp(writeback_percent, dc->writeback_percent,
 			    0, bch_cutoff_writeback);
@@ -513,6 +517,7 @@ static struct attribute *bch_cached_dev_files[] = {
 	&sysfs_writeback_metadata,
 	&sysfs_writeback_running,
 	&sysfs_writeback_delay,
+	&sysfs_writeback_streams,
 	&sysfs_writeback_percent,
 	&sysfs_writeback_rate,
 	&sysfs_writeback_consider_fragment,
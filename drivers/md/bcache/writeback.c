@@ -435,9 +435,10 @@ static void read_dirty_submit(struct closure *cl)
 static void read_dirty(struct cached_dev *dc)
 {
 	unsigned int delay = 0;
-	struct keybuf_key *next, *keys[MAX_WRITEBACKS_IN_PASS], *w;
+	struct keybuf_key *next, *w;
+	struct keybuf_key *keys[MAX_WRITEBACKS_IN_PASS * MAX_WRITEBACK_STREAMS];
 	size_t size;
-	int nk, i;
+	int nk, i, streams, runs;
 	struct dirty_io *io;
 	struct closure cl;
 	uint16_t sequence = 0;
@@ -458,6 +459,8 @@ static void read_dirty(struct cached_dev *dc)
 	       next) {
 		size = 0;
 		nk = 0;
+		runs = 1;
+		streams = READ_ONCE(dc->writeback_streams);
 
 		do {
 			BUG_ON(ptr_stale(dc->disk.c, &next->key, 0));
@@ -466,34 +469,36 @@ static void read_dirty(struct cached_dev *dc)
 			 * Don't combine too many operations, even if they
 			 * are all small.
 			 */
-			if (nk >= MAX_WRITEBACKS_IN_PASS)
+			if (nk >= MAX_WRITEBACKS_IN_PASS * streams)
 				break;
 
 			/*
 			 * If the current operation is very large, don't
 			 * further combine operations.
 			 */
-			if (size >= MAX_WRITESIZE_IN_PASS)
+			if (size >= MAX_WRITESIZE_IN_PASS * streams)
 				break;
 
 			/*
 			 * Operations are only eligible to be combined
-			 * if they are contiguous.
-			 *
-			 * TODO: add a heuristic willing to fire a
-			 * certain amount of non-contiguous IO per pass,
-			 * so that we can benefit from backing device
-			 * command queueing.
+			 * if they are contiguous, unless writeback_streams
+			 * allows firing a few non-contiguous runs per pass
+			 * so that the backing device can queue them.  The
+			 * keys come in LBA order and the writes are issued
+			 * in that order too, see write_dirty().
 			 */
 			if ((nk != 0) && bkey_cmp(&keys[nk-1]->key,
-						&START_KEY(&next->key)))
-				break;
+						&START_KEY(&next->key))) {
+				if (runs >= streams)
+					break;
+				runs++;
+			}
 
 			size += KEY_SIZE(&next->key);
 			keys[nk++] = next;
 		} while ((next = bch_keybuf_next(&dc->writeback_keys)));
 
-		/* Now we have gathered a set of 1..5 keys to write back. */
+		/* Now we have gathered a set of keys to write back. */
 		for (i = 0; i < nk; i++) {
 			w = keys[i];
 
@@ -993,6 +998,7 @@ void bch_cached_dev_writeback_init(struct cached_dev *dc)
 	dc->writeback_consider_fragment = true;
 	dc->writeback_percent		= 10;
 	dc->writeback_delay		= 30;
+	dc->writeback_streams		= 1;
 	atomic_long_set(&dc->writeback_rate.rate, 1024);
 	dc->writeback_rate_minimum	= 8;
 
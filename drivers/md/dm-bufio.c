@@ -18,6 +18,7 @@
 #include <linux/module.h>
 #include <linux/rbtree.h>
 #include <linux/stacktrace.h>
+#include <linux/jump_label.h>
 
 #define DM_MSG_PREFIX "bufio"
 
@@ -81,6 +82,8 @@
  */
 struct dm_bufio_client {
 	struct mutex lock;
+	spinlock_t spinlock;
+	bool no_sleep;
 
 	struct list_head lru[LIST_SIZE];
 	unsigned long n_buffers[LIST_SIZE];
@@ -165,19 +168,44 @@ struct dm_buffer {
 
 #define dm_bufio_in_request()	(!!current->bio_list)
 
+/*
+ * Clients created with DM_BUFIO_CLIENT_NO_SLEEP may call dm_bufio_get from
+ * softirq context, so they are protected by a spinlock instead of the mutex
+ * and must never sleep while holding it.
+ */
+static DEFINE_STATIC_KEY_FALSE(no_sleep_enabled);
+
+#define dm_bufio_no_sleep(c)	\
+	(static_branch_unlikely(&no_sleep_enabled) && (c)->no_sleep)
+
 static void dm_bufio_lock(struct dm_bufio_client *c)
 {
-	mutex_lock_nested(&c->lock, dm_bufio_in_request());
+	if (dm_bufio_no_sleep(c))
+		spin_lock_bh(&c->spinlock);
+	else
+		mutex_lock_nested(&c->lock, dm_bufio_in_request());
 }
 
 static int dm_bufio_trylock(struct dm_bufio_client *c)
 {
-	return mutex_trylock(&c->lock);
+	if (dm_bufio_no_sleep(c))
+		return spin_trylock_bh(&c->spinlock);
+	else
+		return mutex_trylock(&c->lock);
 }
 
 static void dm_bufio_unlock(struct dm_bufio_client *c)
 {
-	mutex_unlock(&c->lock);
+	if (dm_bufio_no_sleep(c))
+		spin_unlock_bh(&c->spinlock);
+	else
+		mutex_unlock(&c->lock);
+}
+
+static void dm_bufio_cond_resched(struct dm_bufio_client *c)
+{
+	if (!dm_bufio_no_sleep(c))
+		cond_resched();
 }
 
 /*----------------------------------------------------------------*/
@@ -803,12 +831,17 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 		BUG_ON(test_bit(B_WRITING, &b->state));
 		BUG_ON(test_bit(B_DIRTY, &b->state));
 
+		/* Waiting for the read would sleep under the spinlock */
+		if (dm_bufio_no_sleep(c) &&
+		    unlikely(test_bit(B_READING, &b->state)))
+			continue;
+
 		if (!b->hold_count) {
 			__make_buffer_clean(b);
 			__unlink_buffer(b);
 			return b;
 		}
-		cond_resched();
+		dm_bufio_cond_resched(c);
 	}
 
 	list_for_each_entry_reverse(b, &c->lru[LIST_DIRTY], lru_list) {
@@ -819,7 +852,7 @@ static struct dm_buffer *__get_unclaimed_buffer(struct dm_bufio_client *c)
 			__unlink_buffer(b);
 			return b;
 		}
-		cond_resched();
+		dm_bufio_cond_resched(c);
 	}
 
 	return NULL;
@@ -962,7 +995,7 @@ static void __write_dirty_buffers_async(struct dm_bufio_client *c, int no_wait,
 			return;
 
 		__write_dirty_buffer(b, write_list);
-		cond_resched();
+		dm_bufio_cond_resched(c);
 	}
 }
 
@@ -1305,7 +1338,7 @@ int dm_bufio_write_dirty_buffers(struct dm_bufio_client *c)
 		    !test_bit(B_WRITING, &b->state))
 			__relink_lru(b, LIST_CLEAN);
 
-		cond_resched();
+		dm_bufio_cond_resched(c);
 
 		/*
 		 * If we dropped the lock, the list is no longer consistent,
@@ -1662,11 +1695,12 @@ static void __scan(struct dm_bufio_client *c)
 				atomic_long_set(&c->need_shrink, 0);
 			if (!atomic_long_read(&c->need_shrink))
 				return;
-			if (__try_evict_buffer(b, GFP_KERNEL)) {
+			if (__try_evict_buffer(b, dm_bufio_no_sleep(c) ?
+					       GFP_NOWAIT : GFP_KERNEL)) {
 				atomic_long_dec(&c->need_shrink);
 				freed++;
 			}
-			cond_resched();
+			dm_bufio_cond_resched(c);
 		}
 	}
 }
@@ -1718,7 +1752,8 @@ static unsigned long dm_bufio_shrink_count(struct shrinker *shrink, struct shrin
 struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsigned block_size,
 					       unsigned reserved_buffers, unsigned aux_size,
 					       void (*alloc_callback)(struct dm_buffer *),
-					       void (*write_callback)(struct dm_buffer *))
+					       void (*write_callback)(struct dm_buffer *),
+					       unsigned int flags)
 {
 	int r;
 	struct dm_bufio_client *c;
@@ -1754,6 +1789,11 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	}
 
 	mutex_init(&c->lock);
+	spin_lock_init(&c->spinlock);
+	if (flags & DM_BUFIO_CLIENT_NO_SLEEP) {
+		c->no_sleep = true;
+		static_branch_inc(&no_sleep_enabled);
+	}
 	INIT_LIST_HEAD(&c->reserved_buffers);
 	c->need_reserved_buffers = reserved_buffers;
 
@@ -1831,6 +1871,8 @@ struct dm_bufio_client *dm_bufio_client_create(struct block_device *bdev, unsign
 	dm_io_client_destroy(c->dm_io);
 bad_dm_io:
 	mutex_destroy(&c->lock);
+	if (c->no_sleep)
+		static_branch_dec(&no_sleep_enabled);
 	kfree(c);
 bad_client:
 	return ERR_PTR(r);
@@ -1844,7 +1886,13 @@ EXPORT_SYMBOL_GPL(dm_bufio_client_create);
 void dm_bufio_client_destroy(struct dm_bufio_client *c)
 {
 	unsigned i;
+	bool no_sleep = c->no_sleep;
 
+	/*
+	 * Nobody else uses the client any more, switch it back to the mutex
+	 * so that drop_buffers can wait for reads that are still in flight.
+	 */
+	c->no_sleep = false;
 	drop_buffers(c);
 
 	unregister_shrinker(&c->shrinker);
@@ -1879,6 +1927,8 @@ void dm_bufio_client_destroy(struct dm_bufio_client *c)
 	kmem_cache_destroy(c->slab_buffer);
 	dm_io_client_destroy(c->dm_io);
 	mutex_destroy(&c->lock);
+	if (no_sleep)
+		static_branch_dec(&no_sleep_enabled);
 	kfree(c);
 }
 EXPORT_SYMBOL_GPL(dm_bufio_client_destroy);
@@ -15,6 +15,8 @@
 #include <linux/mutex.h>
 #include <linux/vmalloc.h>
 #include <linux/math64.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
 
 #define DM_MSG_PREFIX "cache-policy-smq"
 
@@ -548,6 +550,27 @@ static void stats_miss(struct stats *s)
 	s->misses++;
 }
 
+/*
+ * Accesses seen by the lockless hit path, per cpu and folded into the
+ * cache stats on the next tick.
+ */
+struct lazy_stats {
+	unsigned hits;
+	unsigned misses;
+};
+
+static void stats_fold(struct stats *s, struct lazy_stats __percpu *ls)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lazy_stats *l = per_cpu_ptr(ls, cpu);
+
+		s->hits += xchg(&l->hits, 0);
+		s->misses += xchg(&l->misses, 0);
+	}
+}
+
 /*
  * There are times when we don't have any confidence in the hotspot queue.
  * Such as when a fresh cache is created and the blocks have been spread
@@ -574,6 +597,7 @@ struct smq_hash_table {
 	struct entry_space *es;
 	unsigned long long hash_bits;
 	unsigned *buckets;
+	seqcount_t seq;		/* bumped by chain updates, see h_lookup_lockless() */
 };
 
 /*
@@ -587,6 +611,7 @@ static int h_init(struct smq_hash_table *ht, struct entry_space *es, unsigned nr
 	ht->es = es;
 	nr_buckets = roundup_pow_of_two(max(nr_entries / 4u, 16u));
 	ht->hash_bits = __ffs(nr_buckets);
+	seqcount_init(&ht->seq);
 
 	ht->buckets = vmalloc(array_size(nr_buckets, sizeof(*ht->buckets)));
 	if (!ht->buckets)
@@ -615,8 +640,10 @@ static struct entry *h_next(struct smq_hash_table *ht, struct entry *e)
 
 static void __h_insert(struct smq_hash_table *ht, unsigned bucket, struct entry *e)
 {
+	write_seqcount_begin(&ht->seq);
 	e->hash_next = ht->buckets[bucket];
 	ht->buckets[bucket] = to_index(ht->es, e);
+	write_seqcount_end(&ht->seq);
 }
 
 static void h_insert(struct smq_hash_table *ht, struct entry *e)
@@ -644,10 +671,12 @@ static struct entry *__h_lookup(struct smq_hash_table *ht, unsigned h, dm_oblock
 static void __h_unlink(struct smq_hash_table *ht, unsigned h,
 		       struct entry *e, struct entry *prev)
 {
+	write_seqcount_begin(&ht->seq);
 	if (prev)
 		prev->hash_next = e->hash_next;
 	else
 		ht->buckets[h] = e->hash_next;
+	write_seqcount_end(&ht->seq);
 }
 
 /*
@@ -671,6 +700,34 @@ static struct entry *h_lookup(struct smq_hash_table *ht, dm_oblock_t oblock)
 	return e;
 }
 
+/*
+ * Lookup without the policy lock.  Only a hit is reliable: that the chains
+ * didn't change during the walk guarantees the entry was in the table, but
+ * a miss may just have raced with an entry being moved to the front of its
+ * bucket.  Returns the level of the entry through @level.
+ */
+static struct entry *h_lookup_lockless(struct smq_hash_table *ht, dm_oblock_t oblock,
+				       unsigned *level)
+{
+	unsigned h = hash_64(from_oblock(oblock), ht->hash_bits);
+	unsigned seq, n;
+	struct entry *e;
+
+	seq = read_seqcount_begin(&ht->seq);
+	for (e = to_entry(ht->es, READ_ONCE(ht->buckets[h])), n = 0;
+	     e && n < ht->es->end - ht->es->begin; e = h_next(ht, e), n++) {
+		if (read_seqcount_retry(&ht->seq, seq))
+			return NULL;
+
+		if (e->oblock == oblock) {
+			*level = e->level;
+			return read_seqcount_retry(&ht->seq, seq) ? NULL : e;
+		}
+	}
+
+	return NULL;
+}
+
 static void h_remove(struct smq_hash_table *ht, struct entry *e)
 {
 	unsigned h = hash_64(from_oblock(e->oblock), ht->hash_bits);
@@ -826,6 +883,7 @@ struct smq_policy {
 
 	struct stats hotspot_stats;
 	struct stats cache_stats;
+	struct lazy_stats __percpu *lazy_cache_stats;
 
 	/*
 	 * Keeps track of time, incremented by the core.  We use this to
@@ -1354,6 +1412,7 @@ static void smq_destroy(struct dm_cache_policy *p)
 	btracker_destroy(mq->bg_work);
 	h_exit(&mq->hotspot_table);
 	h_exit(&mq->table);
+	free_percpu(mq->lazy_cache_stats);
 	free_bitset(mq->hotspot_hit_bits);
 	free_bitset(mq->cache_hit_bits);
 	space_exit(&mq->es);
@@ -1397,6 +1456,36 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 	}
 }
 
+/*
+ * Hits on an entry that has already been requeued in this cache period
+ * don't change any policy state apart from the stats, so they can be
+ * served without taking the lock.
+ */
+static bool __lookup_lockless(struct smq_policy *mq, dm_oblock_t oblock,
+			      dm_cblock_t *cblock)
+{
+	struct lazy_stats *ls;
+	struct entry *e;
+	unsigned level;
+
+	e = h_lookup_lockless(&mq->table, oblock, &level);
+	if (!e)
+		return false;
+
+	*cblock = infer_cblock(mq, e);
+	if (!test_bit(from_cblock(*cblock), mq->cache_hit_bits))
+		return false;
+
+	ls = get_cpu_ptr(mq->lazy_cache_stats);
+	if (level >= mq->cache_stats.hit_threshold)
+		ls->hits++;
+	else
+		ls->misses++;
+	put_cpu_ptr(mq->lazy_cache_stats);
+
+	return true;
+}
+
 static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t *cblock,
 		      int data_dir, bool fast_copy,
 		      bool *background_work)
@@ -1405,6 +1494,11 @@ static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (__lookup_lockless(mq, oblock, cblock)) {
+		*background_work = false;
+		return 0;
+	}
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock,
 		     data_dir, fast_copy,
@@ -1424,6 +1518,9 @@ static int smq_lookup_with_work(struct dm_cache_policy *p,
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (__lookup_lockless(mq, oblock, cblock))
+		return 0;
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock, data_dir, fast_copy, work, &background_queued);
 	spin_unlock_irqrestore(&mq->lock, flags);
@@ -1620,6 +1717,7 @@ static void smq_tick(struct dm_cache_policy *p, bool can_block)
 
 	spin_lock_irqsave(&mq->lock, flags);
 	mq->tick++;
+	stats_fold(&mq->cache_stats, mq->lazy_cache_stats);
 	update_sentinels(mq);
 	end_hotspot_period(mq);
 	end_cache_period(mq);
@@ -1790,6 +1888,10 @@ static struct dm_cache_policy *__smq_create(dm_cblock_t cache_size,
 	stats_init(&mq->hotspot_stats, NR_HOTSPOT_LEVELS);
 	stats_init(&mq->cache_stats, NR_CACHE_LEVELS);
 
+	mq->lazy_cache_stats = alloc_percpu(struct lazy_stats);
+	if (!mq->lazy_cache_stats)
+		goto bad_lazy_stats;
+
 	if (h_init(&mq->table, &mq->es, from_cblock(cache_size)))
 		goto bad_alloc_table;
 
@@ -1815,6 +1917,8 @@ static struct dm_cache_policy *__smq_create(dm_cblock_t cache_size,
 bad_alloc_hotspot_table:
 	h_exit(&mq->table);
 bad_alloc_table:
+	free_percpu(mq->lazy_cache_stats);
+bad_lazy_stats:
 	free_bitset(mq->cache_hit_bits);
 bad_cache_hit_bits:
 	free_bitset(mq->hotspot_hit_bits);
@@ -131,12 +131,13 @@ struct iv_elephant_private {
 enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
 	     DM_CRYPT_SAME_CPU, DM_CRYPT_NO_OFFLOAD,
 	     DM_CRYPT_NO_READ_WORKQUEUE, DM_CRYPT_NO_WRITE_WORKQUEUE,
-	     DM_CRYPT_WRITE_INLINE };
+	     DM_CRYPT_WRITE_INLINE, DM_CRYPT_INLINE_SYNC };
 
 enum cipher_flags {
 	CRYPT_MODE_INTEGRITY_AEAD,	/* Use authenticated mode for cipher */
 	CRYPT_IV_LARGE_SECTORS,		/* Calculate IV from sector_size, not 512B sectors */
 	CRYPT_ENCRYPT_PREPROCESS,	/* Must preprocess data for encryption (elephant) */
+	CRYPT_CIPHER_INLINE,		/* Convert in the submitting / completing context */
 };
 
 /*
@@ -1940,6 +1941,22 @@ static int dmcrypt_write(void *data)
 	return 0;
 }
 
+/*
+ * Whether to convert the bio in the context it was submitted (writes) or
+ * completed (reads) in rather than from kcryptd, and to submit writes right
+ * away rather than from dmcrypt_write.
+ */
+static bool kcryptd_crypt_no_workqueue(struct crypt_config *cc, struct bio *bio)
+{
+	if (test_bit(CRYPT_CIPHER_INLINE, &cc->cipher_flags))
+		return true;
+
+	if (bio_data_dir(bio) == READ)
+		return test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
+	else
+		return test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+}
+
 static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 {
 	struct bio *clone = io->ctx.bio_out;
@@ -1961,7 +1978,7 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io, int async)
 	clone->bi_iter.bi_sector = cc->start + io->sector;
 
 	if ((likely(!async) && test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags)) ||
-	    test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags)) {
+	    kcryptd_crypt_no_workqueue(cc, io->base_bio)) {
 		submit_bio_noacct(clone);
 		return;
 	}
@@ -2064,8 +2081,8 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	sector += bio_sectors(clone);
 
 	crypt_inc_pending(io);
-	r = crypt_convert(cc, ctx,
-			  test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags), true);
+	r = crypt_convert(cc, ctx, kcryptd_crypt_no_workqueue(cc, io->base_bio),
+			  true);
 	/*
 	 * Crypto API backlogged the request, because its queue was full
 	 * and we're in softirq context, so continue from a workqueue
@@ -2130,7 +2147,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 			   io->sector);
 
 	r = crypt_convert(cc, &io->ctx,
-			  test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags), true);
+			  kcryptd_crypt_no_workqueue(cc, io->base_bio), true);
 	/*
 	 * Crypto API backlogged the request, because its queue was full
 	 * and we're in softirq context, so continue from a workqueue
@@ -2219,8 +2236,7 @@ static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->cc;
 
-	if ((bio_data_dir(io->base_bio) == READ && test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags)) ||
-	    (bio_data_dir(io->base_bio) == WRITE && test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))) {
+	if (kcryptd_crypt_no_workqueue(cc, io->base_bio)) {
 		/*
 		 * in_hardirq(): Crypto API's skcipher_walk_first() refuses to work in hard IRQ context.
 		 * irqs_disabled(): the kernel may run some IO completion from the idle thread, but
@@ -3069,7 +3085,7 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 	struct crypt_config *cc = ti->private;
 	struct dm_arg_set as;
 	static const struct dm_arg _args[] = {
-		{0, 8, "Invalid number of feature args"},
+		{0, 9, "Invalid number of feature args"},
 	};
 	unsigned int opt_params, val;
 	const char *opt_string, *sval;
@@ -3103,6 +3119,8 @@ static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc, char **ar
 			set_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		else if (!strcasecmp(opt_string, "no_write_workqueue"))
 			set_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		else if (!strcasecmp(opt_string, "inline_sync_crypt"))
+			set_bit(DM_CRYPT_INLINE_SYNC, &cc->flags);
 		else if (sscanf(opt_string, "integrity:%u:", &val) == 1) {
 			if (val == 0 || val > MAX_TAG_SIZE) {
 				ti->error = "Invalid integrity arguments";
@@ -3167,6 +3185,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	const char *devname = dm_table_device_name(ti->table);
 	int key_size;
 	unsigned int align_mask;
+	u32 cra_flags;
 	unsigned long long tmpll;
 	int ret;
 	size_t iv_size_padding, additional_req_size;
@@ -3218,10 +3237,27 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		cc->dmreq_start = sizeof(struct aead_request);
 		cc->dmreq_start += crypto_aead_reqsize(any_tfm_aead(cc));
 		align_mask = crypto_aead_alignmask(any_tfm_aead(cc));
+		cra_flags = crypto_aead_alg(any_tfm_aead(cc))->base.cra_flags;
 	} else {
 		cc->dmreq_start = sizeof(struct skcipher_request);
 		cc->dmreq_start += crypto_skcipher_reqsize(any_tfm(cc));
 		align_mask = crypto_skcipher_alignmask(any_tfm(cc));
+		cra_flags = crypto_skcipher_alg(any_tfm(cc))->base.cra_flags;
+	}
+
+	/*
+	 * inline_sync_crypt: CPU implementations complete synchronously
+	 * nearly always, so convert in the submitting / completing context
+	 * using the request embedded in the per-bio data for every sector.
+	 * Hardware offload drivers complete asynchronously anyway, keep
+	 * feeding them from the workqueues.
+	 */
+	if (test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags)) {
+		if (!(cra_flags & CRYPTO_ALG_KERN_DRIVER_ONLY))
+			set_bit(CRYPT_CIPHER_INLINE, &cc->cipher_flags);
+		else
+			DMINFO("%s: inline_sync_crypt ignored for offloaded cipher",
+			       devname);
 	}
 	cc->dmreq_start = ALIGN(cc->dmreq_start, __alignof__(struct dm_crypt_request));
 
@@ -3480,6 +3516,7 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		num_feature_args += test_bit(DM_CRYPT_NO_OFFLOAD, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_READ_WORKQUEUE, &cc->flags);
 		num_feature_args += test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags);
+		num_feature_args += test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags);
 		num_feature_args += cc->sector_size != (1 << SECTOR_SHIFT);
 		num_feature_args += test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags);
 		if (cc->on_disk_tag_size)
@@ -3496,6 +3533,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 				DMEMIT(" no_read_workqueue");
 			if (test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags))
 				DMEMIT(" no_write_workqueue");
+			if (test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags))
+				DMEMIT(" inline_sync_crypt");
 			if (cc->on_disk_tag_size)
 				DMEMIT(" integrity:%u:%s", cc->on_disk_tag_size, cc->cipher_auth);
 			if (cc->sector_size != (1 << SECTOR_SHIFT))
@@ -3515,6 +3554,8 @@ static void crypt_status(struct dm_target *ti, status_type_t type,
 		       'y' : 'n');
 		DMEMIT(",no_write_workqueue=%c", test_bit(DM_CRYPT_NO_WRITE_WORKQUEUE, &cc->flags) ?
 		       'y' : 'n');
+		DMEMIT(",inline_sync_crypt=%c", test_bit(DM_CRYPT_INLINE_SYNC, &cc->flags) ?
+		       'y' : 'n');
 		DMEMIT(",iv_large_sectors=%c", test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags) ?
 		       'y' : 'n');
 
@@ -3635,7 +3676,7 @@ static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 23, 0},
+	.version = {1, 24, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
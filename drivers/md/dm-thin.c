@@ -21,6 +21,8 @@
 #include <linux/vmalloc.h>
 #include <linux/sort.h>
 #include <linux/rbtree.h>
+#include <linux/hash.h>
+#include <linux/seqlock.h>
 
 #define	DM_MSG_PREFIX	"thin"
 
@@ -332,6 +334,21 @@ struct pool_c {
 	struct pool_features adjusted_pf;  /* Features used after adjusting for constituent devices */
 };
 
+/*
+ * Cache of the unshared mappings of a thin found by thin_bio_map(), so that
+ * I/O to provisioned blocks doesn't have to go through the btree and the
+ * metadata lock again.  Entries are only valid for the current generation,
+ * which is bumped whenever an unshared mapping can go away: discards, new
+ * snapshots of the device and metadata transaction aborts.
+ */
+#define THIN_MAP_CACHE_BITS 10
+
+struct thin_map_entry {
+	dm_block_t virt;
+	dm_block_t data;
+	u64 gen;
+};
+
 /*
  * Target context for a thin.
  */
@@ -359,6 +376,10 @@ struct thin_c {
 	 */
 	refcount_t refcount;
 	struct completion can_destroy;
+
+	seqlock_t map_cache_lock;
+	u64 map_cache_gen;
+	struct thin_map_entry *map_cache;
 };
 
 /*----------------------------------------------------------------*/
@@ -377,6 +398,69 @@ static sector_t block_to_sectors(struct pool *pool, dm_block_t b)
 
 /*----------------------------------------------------------------*/
 
+/*
+ * On a miss, *gen is the generation the lookup was made in; pass it to
+ * thin_map_cache_insert() along with what the btree returned for @virt.
+ */
+static bool thin_map_cache_lookup(struct thin_c *tc, dm_block_t virt,
+				  dm_block_t *data, u64 *gen)
+{
+	struct thin_map_entry *e;
+	unsigned int seq;
+	bool hit;
+
+	e = tc->map_cache + hash_64(virt, THIN_MAP_CACHE_BITS);
+	do {
+		seq = read_seqbegin(&tc->map_cache_lock);
+		*gen = tc->map_cache_gen;
+		hit = e->gen == *gen && e->virt == virt;
+		*data = e->data;
+	} while (read_seqretry(&tc->map_cache_lock, seq));
+
+	return hit;
+}
+
+/*
+ * The mapping may have gone away while the btree was searched; if the
+ * cache was invalidated since @gen was sampled, don't insert it.
+ */
+static void thin_map_cache_insert(struct thin_c *tc, dm_block_t virt,
+				  dm_block_t data, u64 gen)
+{
+	struct thin_map_entry *e;
+	unsigned long flags;
+
+	e = tc->map_cache + hash_64(virt, THIN_MAP_CACHE_BITS);
+	write_seqlock_irqsave(&tc->map_cache_lock, flags);
+	if (gen == tc->map_cache_gen) {
+		e->virt = virt;
+		e->data = data;
+		e->gen = gen;
+	}
+	write_sequnlock_irqrestore(&tc->map_cache_lock, flags);
+}
+
+static void thin_map_cache_invalidate(struct thin_c *tc)
+{
+	unsigned long flags;
+
+	write_seqlock_irqsave(&tc->map_cache_lock, flags);
+	tc->map_cache_gen++;
+	write_sequnlock_irqrestore(&tc->map_cache_lock, flags);
+}
+
+static void pool_map_cache_invalidate(struct pool *pool)
+{
+	struct thin_c *tc;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(tc, &pool->active_thins, list)
+		thin_map_cache_invalidate(tc);
+	rcu_read_unlock();
+}
+
+/*----------------------------------------------------------------*/
+
 struct discard_op {
 	struct thin_c *tc;
 	struct blk_plug plug;
@@ -1061,6 +1145,8 @@ static void process_prepared_discard_no_passdown(struct dm_thin_new_mapping *m)
 	int r;
 	struct thin_c *tc = m->tc;
 
+	/* Still holding the virtual cell, so no lookup can refill the cache */
+	thin_map_cache_invalidate(tc);
 	r = dm_thin_remove_range(tc->td, m->cell->key.block_begin, m->cell->key.block_end);
 	if (r) {
 		metadata_operation_failed(tc->pool, "dm_thin_remove_range", r);
@@ -1157,6 +1243,7 @@ static void process_prepared_discard_passdown_pt1(struct dm_thin_new_mapping *m)
 	 * newly unmapped blocks will not be allocated before the end of
 	 * the function.
 	 */
+	thin_map_cache_invalidate(tc);
 	r = dm_thin_remove_range(tc->td, m->virt_begin, m->virt_end);
 	if (r) {
 		metadata_operation_failed(pool, "dm_thin_remove_range", r);
@@ -2631,6 +2718,12 @@ static void abort_transaction(struct pool *pool)
 		DMERR("%s: failed to abort metadata transaction", dev_name);
 		set_pool_mode(pool, PM_FAIL);
 	}
+	/*
+	 * Mappings provisioned since the last commit are gone. Invalidate
+	 * once the abort is done, so that no lookup racing with it can
+	 * cache one of them again.
+	 */
+	pool_map_cache_invalidate(pool);
 
 	if (dm_pool_metadata_set_needs_check(pool->pmd)) {
 		DMERR("%s: failed to set 'needs_check' flag in metadata", dev_name);
@@ -2712,6 +2805,7 @@ static int thin_bio_map(struct dm_target *ti, struct bio *bio)
 	struct dm_thin_lookup_result result;
 	struct dm_bio_prison_cell *virt_cell, *data_cell;
 	struct dm_cell_key key;
+	u64 gen;
 
 	thin_hook_bio(tc, bio);
 
@@ -2739,7 +2833,14 @@ static int thin_bio_map(struct dm_target *ti, struct bio *bio)
 	if (bio_detain(tc->pool, &key, bio, &virt_cell))
 		return DM_MAPIO_SUBMITTED;
 
-	r = dm_thin_find_block(td, block, 0, &result);
+	if (thin_map_cache_lookup(tc, block, &result.block, &gen)) {
+		result.shared = false;
+		r = 0;
+	} else {
+		r = dm_thin_find_block(td, block, 0, &result);
+		if (!r && !result.shared)
+			thin_map_cache_insert(tc, block, result.block, gen);
+	}
 
 	/*
 	 * Note that we defer readahead too.
@@ -3731,6 +3832,8 @@ static int process_create_snap_mesg(unsigned argc, char **argv, struct pool *poo
 		       argv[1], argv[2]);
 		return r;
 	}
+	/* The mappings of the origin are shared now */
+	pool_map_cache_invalidate(pool);
 
 	return 0;
 }
@@ -4146,6 +4249,7 @@ static void thin_dtr(struct dm_target *ti)
 	dm_put_device(ti, tc->pool_dev);
 	if (tc->origin_dev)
 		dm_put_device(ti, tc->origin_dev);
+	kvfree(tc->map_cache);
 	kfree(tc);
 
 	mutex_unlock(&dm_thin_pool_table.mutex);
@@ -4190,6 +4294,15 @@ static int thin_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	bio_list_init(&tc->deferred_bio_list);
 	bio_list_init(&tc->retry_on_resume_list);
 	tc->sort_bio_list = RB_ROOT;
+	seqlock_init(&tc->map_cache_lock);
+	tc->map_cache_gen = 1;
+	tc->map_cache = kvcalloc(1 << THIN_MAP_CACHE_BITS,
+				 sizeof(struct thin_map_entry), GFP_KERNEL);
+	if (!tc->map_cache) {
+		ti->error = "Out of memory";
+		r = -ENOMEM;
+		goto bad_map_cache;
+	}
 
 	if (argc == 3) {
 		if (!strcmp(argv[0], argv[2])) {
@@ -4298,6 +4411,8 @@ static int thin_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	if (tc->origin_dev)
 		dm_put_device(ti, tc->origin_dev);
 bad_origin_dev:
+	kvfree(tc->map_cache);
+bad_map_cache:
 	kfree(tc);
 out_unlock:
 	mutex_unlock(&dm_thin_pool_table.mutex);
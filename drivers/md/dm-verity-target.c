@@ -28,13 +28,17 @@
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
+/* Larger reads are always verified from the workqueue */
+#define DM_VERITY_TASKLET_MAX_BYTES	65536
+
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
 #define DM_VERITY_OPT_PANIC		"panic_on_corruption"
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
 #define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
+#define DM_VERITY_OPT_TASKLET		"try_verify_in_tasklet"
 
-#define DM_VERITY_OPTS_MAX		(3 + DM_VERITY_OPTS_FEC + \
+#define DM_VERITY_OPTS_MAX		(4 + DM_VERITY_OPTS_FEC + \
 					 DM_VERITY_ROOT_HASH_VERIFICATION_OPTS)
 
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
@@ -126,14 +130,14 @@ static int verity_hash_update(struct dm_verity *v, struct ahash_request *req,
  * Wrapper for crypto_ahash_init, which handles verity salting.
  */
 static int verity_hash_init(struct dm_verity *v, struct ahash_request *req,
-				struct crypto_wait *wait)
+				struct crypto_wait *wait, bool may_sleep)
 {
 	int r;
 
 	ahash_request_set_tfm(req, v->tfm);
-	ahash_request_set_callback(req, CRYPTO_TFM_REQ_MAY_SLEEP |
-					CRYPTO_TFM_REQ_MAY_BACKLOG,
-					crypto_req_done, (void *)wait);
+	ahash_request_set_callback(req,
+		may_sleep ? CRYPTO_TFM_REQ_MAY_SLEEP | CRYPTO_TFM_REQ_MAY_BACKLOG : 0,
+		crypto_req_done, (void *)wait);
 	crypto_init_wait(wait);
 
 	r = crypto_wait_req(crypto_ahash_init(req), wait);
@@ -170,12 +174,12 @@ static int verity_hash_final(struct dm_verity *v, struct ahash_request *req,
 }
 
 int verity_hash(struct dm_verity *v, struct ahash_request *req,
-		const u8 *data, size_t len, u8 *digest)
+		const u8 *data, size_t len, u8 *digest, bool may_sleep)
 {
 	int r;
 	struct crypto_wait wait;
 
-	r = verity_hash_init(v, req, &wait);
+	r = verity_hash_init(v, req, &wait, may_sleep);
 	if (unlikely(r < 0))
 		goto out;
 
@@ -285,7 +289,17 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 	verity_hash_at_level(v, block, level, &hash_block, &offset);
 
-	data = dm_bufio_read(v->bufio, hash_block, &buf);
+	if (io->in_tasklet) {
+		/*
+		 * Only cached hash blocks can be used without sleeping, the
+		 * rest is read and verified from the workqueue.
+		 */
+		data = dm_bufio_get(v->bufio, hash_block, &buf);
+		if (!data)
+			return -EAGAIN;
+	} else {
+		data = dm_bufio_read(v->bufio, hash_block, &buf);
+	}
 	if (IS_ERR(data))
 		return PTR_ERR(data);
 
@@ -299,14 +313,18 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 
 		r = verity_hash(v, verity_io_hash_req(v, io),
 				data, 1 << v->hash_dev_block_bits,
-				verity_io_real_digest(v, io));
+				verity_io_real_digest(v, io), !io->in_tasklet);
 		if (unlikely(r < 0))
 			goto release_ret_r;
 
 		if (likely(memcmp(verity_io_real_digest(v, io), want_digest,
 				  v->digest_size) == 0))
 			aux->hash_verified = 1;
-		else if (verity_fec_decode(v, io,
+		else if (io->in_tasklet) {
+			/* Error correction and reporting may sleep */
+			r = -EAGAIN;
+			goto release_ret_r;
+		} else if (verity_fec_decode(v, io,
 					   DM_VERITY_BLOCK_TYPE_METADATA,
 					   hash_block, data, NULL) == 0)
 			aux->hash_verified = 1;
@@ -365,6 +383,61 @@ int verity_hash_for_block(struct dm_verity *v, struct dm_verity_io *io,
 	return r;
 }
 
+/*
+ * Like verity_hash_for_block, but keeps the verified lowest level hash block
+ * held in *bufp.  The data blocks of a bio are consecutive and usually share
+ * that hash block, so the following ones get their digest from it without a
+ * dm-bufio lookup.
+ */
+static int verity_hash_for_io_block(struct dm_verity *v,
+				    struct dm_verity_io *io, sector_t block,
+				    bool *is_zero, struct dm_buffer **bufp)
+{
+	u8 *digest = verity_io_want_digest(v, io);
+	struct buffer_aux *aux;
+	sector_t hash_block;
+	unsigned offset;
+	u8 *data;
+	int r;
+
+	if (unlikely(!v->levels))
+		return verity_hash_for_block(v, io, block, digest, is_zero);
+
+	verity_hash_at_level(v, block, 0, &hash_block, &offset);
+
+	if (*bufp && dm_bufio_get_block_number(*bufp) != hash_block) {
+		dm_bufio_release(*bufp);
+		*bufp = NULL;
+	}
+
+	if (*bufp) {
+		data = dm_bufio_get_block_data(*bufp);
+		memcpy(digest, data + offset, v->digest_size);
+		*is_zero = v->zero_digest &&
+			   !memcmp(v->zero_digest, digest, v->digest_size);
+		return 0;
+	}
+
+	r = verity_hash_for_block(v, io, block, digest, is_zero);
+	if (unlikely(r))
+		return r;
+
+	/* Verified just now, so still cached unless it failed verification */
+	data = dm_bufio_get(v->bufio, hash_block, bufp);
+	if (IS_ERR_OR_NULL(data)) {
+		*bufp = NULL;
+		return 0;
+	}
+
+	aux = dm_bufio_get_aux_data(*bufp);
+	if (!aux->hash_verified) {
+		dm_bufio_release(*bufp);
+		*bufp = NULL;
+	}
+
+	return 0;
+}
+
 /*
  * Calculates the digest for the given bio
  */
@@ -473,53 +546,65 @@ static int verity_verify_io(struct dm_verity_io *io)
 	bool is_zero;
 	struct dm_verity *v = io->v;
 	struct bvec_iter start;
+	/*
+	 * The tasklet may give up half way through, and the workqueue has to
+	 * start over from the beginning of the bio.
+	 */
+	struct bvec_iter iter_copy;
+	struct bvec_iter *iter;
+	struct dm_buffer *hash_buf = NULL;
 	unsigned b;
 	struct crypto_wait wait;
 	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
+	int r = 0;
+
+	if (io->in_tasklet) {
+		iter_copy = io->iter;
+		iter = &iter_copy;
+	} else {
+		iter = &io->iter;
+	}
 
 	for (b = 0; b < io->n_blocks; b++) {
-		int r;
 		sector_t cur_block = io->block + b;
 		struct ahash_request *req = verity_io_hash_req(v, io);
 
 		if (v->validated_blocks &&
 		    likely(test_bit(cur_block, v->validated_blocks))) {
-			verity_bv_skip_block(v, io, &io->iter);
+			verity_bv_skip_block(v, io, iter);
 			continue;
 		}
 
-		r = verity_hash_for_block(v, io, cur_block,
-					  verity_io_want_digest(v, io),
-					  &is_zero);
+		r = verity_hash_for_io_block(v, io, cur_block, &is_zero,
+					     &hash_buf);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		if (is_zero) {
 			/*
 			 * If we expect a zero block, don't validate, just
 			 * return zeros.
 			 */
-			r = verity_for_bv_block(v, io, &io->iter,
-						verity_bv_zero);
+			r = verity_for_bv_block(v, io, iter, verity_bv_zero);
 			if (unlikely(r < 0))
-				return r;
+				goto out;
 
 			continue;
 		}
 
-		r = verity_hash_init(v, req, &wait);
+		r = verity_hash_init(v, req, &wait, !io->in_tasklet);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
-		start = io->iter;
-		r = verity_for_io_block(v, io, &io->iter, &wait);
+		start = *iter;
+		r = verity_for_io_block(v, io, iter, &wait);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		r = verity_hash_final(v, req, verity_io_real_digest(v, io),
 					&wait);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
@@ -527,7 +612,17 @@ static int verity_verify_io(struct dm_verity_io *io)
 				set_bit(cur_block, v->validated_blocks);
 			continue;
 		}
-		else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
+
+		if (hash_buf) {
+			/* Error correction reads hash blocks of its own */
+			dm_bufio_release(hash_buf);
+			hash_buf = NULL;
+		}
+
+		if (io->in_tasklet) {
+			r = -EAGAIN;
+			goto out;
+		} else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
 					   cur_block, NULL, &start) == 0)
 			continue;
 		else {
@@ -535,15 +630,23 @@ static int verity_verify_io(struct dm_verity_io *io)
 				/*
 				 * Error correction failed; Just return error
 				 */
-				return -EIO;
+				r = -EIO;
+				goto out;
 			}
 			if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
-					      cur_block))
-				return -EIO;
+					      cur_block)) {
+				r = -EIO;
+				goto out;
+			}
 		}
 	}
+	r = 0;
 
-	return 0;
+out:
+	if (hash_buf)
+		dm_bufio_release(hash_buf);
+
+	return r;
 }
 
 /*
@@ -575,21 +678,49 @@ static void verity_work(struct work_struct *w)
 {
 	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
 
+	io->in_tasklet = false;
+
 	verity_finish_io(io, errno_to_blk_status(verity_verify_io(io)));
 }
 
+static void verity_tasklet(unsigned long data)
+{
+	struct dm_verity_io *io = (struct dm_verity_io *)data;
+	int err;
+
+	io->in_tasklet = true;
+	err = verity_verify_io(io);
+	if (err == -EAGAIN) {
+		/* A hash block was not cached or verification failed */
+		INIT_WORK(&io->work, verity_work);
+		queue_work(io->v->verify_wq, &io->work);
+		return;
+	}
+
+	verity_finish_io(io, errno_to_blk_status(err));
+}
+
 static void verity_end_io(struct bio *bio)
 {
 	struct dm_verity_io *io = bio->bi_private;
+	struct dm_verity *v = io->v;
 
 	if (bio->bi_status &&
-	    (!verity_fec_is_enabled(io->v) || verity_is_system_shutting_down())) {
+	    (!verity_fec_is_enabled(v) || verity_is_system_shutting_down())) {
 		verity_finish_io(io, bio->bi_status);
 		return;
 	}
 
+	if (v->use_tasklet && !bio->bi_status &&
+	    (io->n_blocks << v->data_dev_block_bits) <=
+	    DM_VERITY_TASKLET_MAX_BYTES) {
+		tasklet_init(&io->tasklet, verity_tasklet, (unsigned long)io);
+		tasklet_schedule(&io->tasklet);
+		return;
+	}
+
 	INIT_WORK(&io->work, verity_work);
-	queue_work(io->v->verify_wq, &io->work);
+	queue_work(v->verify_wq, &io->work);
 }
 
 /*
@@ -695,6 +826,7 @@ static int verity_map(struct dm_target *ti, struct bio *bio)
 	io->orig_bi_end_io = bio->bi_end_io;
 	io->block = bio->bi_iter.bi_sector >> (v->data_dev_block_bits - SECTOR_SHIFT);
 	io->n_blocks = bio->bi_iter.bi_size >> v->data_dev_block_bits;
+	io->in_tasklet = false;
 
 	bio->bi_end_io = verity_end_io;
 	bio->bi_private = io;
@@ -751,6 +883,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 			args++;
 		if (v->validated_blocks)
 			args++;
+		if (v->use_tasklet)
+			args++;
 		if (v->signature_key_desc)
 			args += DM_VERITY_ROOT_HASH_VERIFICATION_OPTS;
 		if (!args)
@@ -776,6 +910,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 			DMEMIT(" " DM_VERITY_OPT_IGN_ZEROES);
 		if (v->validated_blocks)
 			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
+		if (v->use_tasklet)
+			DMEMIT(" " DM_VERITY_OPT_TASKLET);
 		sz = verity_fec_status_table(v, sz, result, maxlen);
 		if (v->signature_key_desc)
 			DMEMIT(" " DM_VERITY_ROOT_HASH_VERIFICATION_OPT_SIG_KEY
@@ -803,6 +939,7 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 
 		DMEMIT(",ignore_zero_blocks=%c", v->zero_digest ? 'y' : 'n');
 		DMEMIT(",check_at_most_once=%c", v->validated_blocks ? 'y' : 'n');
+		DMEMIT(",try_verify_in_tasklet=%c", v->use_tasklet ? 'y' : 'n');
 		if (v->signature_key_desc)
 			DMEMIT(",root_hash_sig_key_desc=%s", v->signature_key_desc);
 
@@ -936,7 +1073,7 @@ static int verity_alloc_zero_digest(struct dm_verity *v)
 		goto out;
 
 	r = verity_hash(v, req, zero_data, 1 << v->data_dev_block_bits,
-			v->zero_digest);
+			v->zero_digest, true);
 
 out:
 	kfree(req);
@@ -967,8 +1104,14 @@ static int verity_parse_verity_mode(struct dm_verity *v, const char *arg_name)
 	return 0;
 }
 
+/*
+ * With only_modifier_opts, only the options that change how the target is
+ * set up are looked at, all others are skipped.  This is done before the
+ * hash algorithm is allocated.
+ */
 static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v,
-				 struct dm_verity_sig_opts *verify_args)
+				 struct dm_verity_sig_opts *verify_args,
+				 bool only_modifier_opts)
 {
 	int r;
 	unsigned argc;
@@ -990,7 +1133,15 @@ static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v,
 		arg_name = dm_shift_arg(as);
 		argc--;
 
-		if (verity_is_verity_mode(arg_name)) {
+		if (!strcasecmp(arg_name, DM_VERITY_OPT_TASKLET)) {
+			v->use_tasklet = true;
+			continue;
+
+		} else if (only_modifier_opts) {
+			/* Arguments of other options are skipped as well */
+			continue;
+
+		} else if (verity_is_verity_mode(arg_name)) {
 			r = verity_parse_verity_mode(v, arg_name);
 			if (r) {
 				ti->error = "Conflicting error handling parameters";
@@ -1156,7 +1307,22 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	v->tfm = crypto_alloc_ahash(v->alg_name, 0, 0);
+	argv += 10;
+	argc -= 10;
+
+	/* Optional parameters that affect the allocations below */
+	if (argc) {
+		as.argc = argc;
+		as.argv = argv;
+
+		r = verity_parse_opt_args(&as, v, &verify_args, true);
+		if (r < 0)
+			goto bad;
+	}
+
+	/* The tasklet needs an implementation that does not sleep */
+	v->tfm = crypto_alloc_ahash(v->alg_name, 0,
+				    v->use_tasklet ? CRYPTO_ALG_ASYNC : 0);
 	if (IS_ERR(v->tfm)) {
 		ti->error = "Cannot initialize hash function";
 		r = PTR_ERR(v->tfm);
@@ -1211,15 +1377,12 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
-	argv += 10;
-	argc -= 10;
-
 	/* Optional parameters */
 	if (argc) {
 		as.argc = argc;
 		as.argv = argv;
 
-		r = verity_parse_opt_args(&as, v, &verify_args);
+		r = verity_parse_opt_args(&as, v, &verify_args, false);
 		if (r < 0)
 			goto bad;
 	}
@@ -1266,7 +1429,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 
 	v->bufio = dm_bufio_client_create(v->hash_dev->bdev,
 		1 << v->hash_dev_block_bits, 1, sizeof(struct buffer_aux),
-		dm_bufio_alloc_callback, NULL);
+		dm_bufio_alloc_callback, NULL,
+		v->use_tasklet ? DM_BUFIO_CLIENT_NO_SLEEP : 0);
 	if (IS_ERR(v->bufio)) {
 		ti->error = "Cannot initialize dm-bufio";
 		r = PTR_ERR(v->bufio);
@@ -1313,7 +1477,7 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 static struct target_type verity_target = {
 	.name		= "verity",
 	.features	= DM_TARGET_IMMUTABLE,
-	.version	= {1, 8, 0},
+	.version	= {1, 9, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
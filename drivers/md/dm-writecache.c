@@ -16,6 +16,7 @@
 #include <linux/pfn_t.h>
 #include <linux/libnvdimm.h>
 #include <linux/delay.h>
+#include <linux/list_sort.h>
 #include "dm-io-tracker.h"
 
 #define DM_MSG_PREFIX "writecache"
@@ -1923,6 +1924,21 @@ static void __writecache_writeback_ssd(struct dm_writecache *wc, struct writebac
 	}
 }
 
+/*
+ * The writeback list is consumed from its tail, sort it so that the origin
+ * sees ascending writes.  Runs of contiguous blocks stay together, each
+ * sector is written back at most once per pass.
+ */
+static int writecache_wbl_cmp(void *priv, const struct list_head *a,
+			      const struct list_head *b)
+{
+	struct dm_writecache *wc = priv;
+	struct wc_entry *ea = container_of(a, struct wc_entry, lru);
+	struct wc_entry *eb = container_of(b, struct wc_entry, lru);
+
+	return read_original_sector(wc, ea) < read_original_sector(wc, eb);
+}
+
 static void writecache_writeback(struct work_struct *work)
 {
 	struct dm_writecache *wc = container_of(work, struct dm_writecache, writeback_work);
@@ -2077,6 +2093,10 @@ static void writecache_writeback(struct work_struct *work)
 
 	wc_unlock(wc);
 
+	/* With writeback_all the blocks were picked in sector order already */
+	if (likely(!wc->writeback_all))
+		list_sort(wc, &wbl.list, writecache_wbl_cmp);
+
 	blk_start_plug(&plug);
 
 	if (WC_MODE_PMEM(wc))
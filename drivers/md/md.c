@@ -5480,6 +5480,50 @@ static struct md_sysfs_entry md_serialize_policy =
 __ATTR(serialize_policy, S_IRUGO | S_IWUSR, serialize_policy_show,
        serialize_policy_store);
 
+static ssize_t read_balance_show(struct mddev *mddev, char *page)
+{
+	if (mddev->pers == NULL ||
+	    (mddev->pers->level != 1 && mddev->pers->level != 10))
+		return sprintf(page, "n/a\n");
+	else
+		return sprintf(page, "%s\n", mddev->read_balance_latency ?
+			       "latency" : "position");
+}
+
+/*
+ * raid1/raid10 read balancing: "position" prefers the closest or least busy
+ * member as it always has, "latency" the one expected to complete first.
+ */
+static ssize_t
+read_balance_store(struct mddev *mddev, const char *buf, size_t len)
+{
+	bool latency;
+	int err;
+
+	if (cmd_match(buf, "latency"))
+		latency = true;
+	else if (cmd_match(buf, "position"))
+		latency = false;
+	else
+		return -EINVAL;
+
+	err = mddev_lock(mddev);
+	if (err)
+		return err;
+	if (mddev->pers == NULL ||
+	    (mddev->pers->level != 1 && mddev->pers->level != 10)) {
+		pr_err("md: read_balance is only effective for raid1 and raid10\n");
+		err = -EINVAL;
+	} else
+		mddev->read_balance_latency = latency;
+	mddev_unlock(mddev);
+	return err ?: len;
+}
+
+static struct md_sysfs_entry md_read_balance =
+__ATTR(read_balance, S_IRUGO | S_IWUSR, read_balance_show,
+       read_balance_store);
+
 
 static struct attribute *md_default_attrs[] = {
 	&md_level.attr,
@@ -5500,6 +5544,7 @@ static struct attribute *md_default_attrs[] = {
 	&md_consistency_policy.attr,
 	&md_fail_last_dev.attr,
 	&md_serialize_policy.attr,
+	&md_read_balance.attr,
 	NULL,
 };
 
@@ -112,6 +112,9 @@ struct md_rdev {
 	atomic_t	read_errors;	/* number of consecutive read errors that
 					 * we have tried to ignore.
 					 */
+	u64		read_lat_ns;	/* moving average of read completion
+					 * time, for read_balance=latency
+					 */
 	time64_t	last_read_error;	/* monotonic time since our
 						 * last read error
 						 */
@@ -509,6 +512,7 @@ struct mddev {
 	bool	has_superblocks:1;
 	bool	fail_last_dev:1;
 	bool	serialize_policy:1;
+	bool	read_balance_latency:1;	/* raid1/10: pick mirrors by read latency */
 };
 
 enum recovery_flags {
@@ -775,6 +779,25 @@ static inline bool is_mddev_broken(struct md_rdev *rdev, const char *md_type)
 	return false;
 }
 
+/*
+ * read_balance=latency: every member keeps a moving average (weight 1/8) of
+ * its read completion times, a read goes to the member for which that times
+ * the number of requests already in flight, including this one, is lowest.
+ */
+static inline void rdev_account_read(struct md_rdev *rdev, u64 start_ns)
+{
+	u64 lat = ktime_get_ns() - start_ns;
+	u64 avg = READ_ONCE(rdev->read_lat_ns);
+
+	WRITE_ONCE(rdev->read_lat_ns, avg ? avg - (avg >> 3) + (lat >> 3) : lat);
+}
+
+static inline u64 rdev_read_cost(struct md_rdev *rdev)
+{
+	return (atomic_read(&rdev->nr_pending) + 1) *
+		max_t(u64, READ_ONCE(rdev->read_lat_ns), 1);
+}
+
 static inline void rdev_dec_pending(struct md_rdev *rdev, struct mddev *mddev)
 {
 	int faulty = test_bit(Faulty, &rdev->flags);
@@ -370,6 +370,9 @@ static void raid1_end_read_request(struct bio *bio)
 	 */
 	update_head_pos(r1_bio->read_disk, r1_bio);
 
+	if (uptodate && r1_bio->read_start_ns)
+		rdev_account_read(rdev, r1_bio->read_start_ns);
+
 	if (uptodate)
 		set_bit(R1BIO_Uptodate, &r1_bio->state);
 	else if (test_bit(FailFast, &rdev->flags) &&
@@ -603,6 +606,7 @@ static int read_balance(struct r1conf *conf, struct r1bio *r1_bio, int *max_sect
 	int disk;
 	sector_t best_dist;
 	unsigned int min_pending;
+	u64 best_cost;
 	struct md_rdev *rdev;
 	int choose_first;
 	int choose_next_idle;
@@ -620,6 +624,7 @@ static int read_balance(struct r1conf *conf, struct r1bio *r1_bio, int *max_sect
 	best_dist = MaxSector;
 	best_pending_disk = -1;
 	min_pending = UINT_MAX;
+	best_cost = U64_MAX;
 	best_good_sectors = 0;
 	has_nonrot_disk = 0;
 	choose_next_idle = 0;
@@ -712,6 +717,15 @@ static int read_balance(struct r1conf *conf, struct r1bio *r1_bio, int *max_sect
 			best_disk = disk;
 			break;
 		}
+		if (conf->mddev->read_balance_latency) {
+			u64 cost = rdev_read_cost(rdev);
+
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_pending_disk = disk;
+			}
+			continue;
+		}
 		/* Don't change to another disk for sequential reads */
 		if (conf->mirrors[disk].next_seq_sect == this_sector
 		    || dist == 0) {
@@ -764,7 +778,8 @@ static int read_balance(struct r1conf *conf, struct r1bio *r1_bio, int *max_sect
 	 * mixed ratation/non-rotational disks depending on workload.
 	 */
 	if (best_disk == -1) {
-		if (has_nonrot_disk || min_pending == 0)
+		if (conf->mddev->read_balance_latency || has_nonrot_disk ||
+		    min_pending == 0)
 			best_disk = best_pending_disk;
 		else
 			best_disk = best_dist_disk;
@@ -1313,6 +1328,7 @@ static void raid1_read_request(struct mddev *mddev, struct bio *bio,
 	        trace_block_bio_remap(read_bio, disk_devt(mddev->gendisk),
 				      r1_bio->sector);
 
+	r1_bio->read_start_ns = mddev->read_balance_latency ? ktime_get_ns() : 0;
 	submit_bio_noacct(read_bio);
 }
 
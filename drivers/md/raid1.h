@@ -168,6 +168,7 @@ struct r1bio {
 	 * if the IO is in READ direction, then this is where we read
 	 */
 	int			read_disk;
+	u64			read_start_ns;	/* 0 unless read_balance=latency */
 
 	struct list_head	retry_list;
 
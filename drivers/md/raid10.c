@@ -362,6 +362,9 @@ static void raid10_end_read_request(struct bio *bio)
 	 */
 	update_head_pos(slot, r10_bio);
 
+	if (uptodate && r10_bio->read_start_ns)
+		rdev_account_read(rdev, r10_bio->read_start_ns);
+
 	if (uptodate) {
 		/*
 		 * Set R10BIO_Uptodate in our master bio, so that
@@ -715,6 +718,7 @@ static struct md_rdev *read_balance(struct r10conf *conf,
 	int best_dist_slot, best_pending_slot;
 	bool has_nonrot_disk = false;
 	unsigned int min_pending;
+	u64 best_cost = U64_MAX;
 	struct geom *geo = &conf->geo;
 
 	raid10_find_phys(conf, r10_bio);
@@ -799,7 +803,15 @@ static struct md_rdev *read_balance(struct r10conf *conf,
 		nonrot = blk_queue_nonrot(bdev_get_queue(rdev->bdev));
 		has_nonrot_disk |= nonrot;
 		pending = atomic_read(&rdev->nr_pending);
-		if (min_pending > pending && nonrot) {
+		if (conf->mddev->read_balance_latency) {
+			u64 cost = rdev_read_cost(rdev);
+
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_pending_slot = slot;
+				best_pending_rdev = rdev;
+			}
+		} else if (min_pending > pending && nonrot) {
 			min_pending = pending;
 			best_pending_slot = slot;
 			best_pending_rdev = rdev;
@@ -829,7 +841,7 @@ static struct md_rdev *read_balance(struct r10conf *conf,
 		}
 	}
 	if (slot >= conf->copies) {
-		if (has_nonrot_disk) {
+		if (conf->mddev->read_balance_latency || has_nonrot_disk) {
 			slot = best_pending_slot;
 			rdev = best_pending_rdev;
 		} else {
@@ -1206,6 +1218,7 @@ static void raid10_read_request(struct mddev *mddev, struct bio *bio,
 	if (mddev->gendisk)
 	        trace_block_bio_remap(read_bio, disk_devt(mddev->gendisk),
 	                              r10_bio->sector);
+	r10_bio->read_start_ns = mddev->read_balance_latency ? ktime_get_ns() : 0;
 	submit_bio_noacct(read_bio);
 	return;
 }
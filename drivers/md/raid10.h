@@ -134,6 +134,7 @@ struct r10bio {
 	 * if the IO is in READ direction, then this is where we read
 	 */
 	int			read_slot;
+	u64			read_start_ns;	/* 0 unless read_balance=latency */
 
 	struct list_head	retry_list;
 	/*
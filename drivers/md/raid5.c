@@ -6442,11 +6442,14 @@ static void raid5_do_work(struct work_struct *work)
 		if (!batch_size && !released)
 			break;
 		handled += batch_size;
+		worker->batches++;
 		wait_event_lock_irq(mddev->sb_wait,
 			!test_bit(MD_SB_CHANGE_PENDING, &mddev->sb_flags),
 			conf->device_lock);
 	}
 	pr_debug("%d stripes handled\n", handled);
+	worker->runs++;
+	worker->stripes_handled += handled;
 
 	spin_unlock_irq(&conf->device_lock);
 
@@ -6883,6 +6886,8 @@ raid5_show_group_thread_cnt(struct mddev *mddev, char *page)
 static int alloc_thread_groups(struct r5conf *conf, int cnt,
 			       int *group_cnt,
 			       struct r5worker_group **worker_groups);
+static void __free_thread_groups(struct r5worker_group *worker_groups,
+				 int group_cnt);
 static ssize_t
 raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 {
@@ -6890,7 +6895,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 	unsigned int new;
 	int err;
 	struct r5worker_group *new_groups, *old_groups;
-	int group_cnt;
+	int group_cnt, old_group_cnt;
 
 	if (len >= PAGE_SIZE)
 		return -EINVAL;
@@ -6910,6 +6915,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 		mddev_suspend(mddev);
 
 		old_groups = conf->worker_groups;
+		old_group_cnt = conf->group_cnt;
 		if (old_groups)
 			flush_workqueue(raid5_wq);
 
@@ -6921,9 +6927,7 @@ raid5_store_group_thread_cnt(struct mddev *mddev, const char *page, size_t len)
 			conf->worker_groups = new_groups;
 			spin_unlock_irq(&conf->device_lock);
 
-			if (old_groups)
-				kfree(old_groups[0].workers);
-			kfree(old_groups);
+			__free_thread_groups(old_groups, old_group_cnt);
 		}
 		mddev_resume(mddev);
 	}
@@ -6937,11 +6941,51 @@ raid5_group_thread_cnt = __ATTR(group_thread_cnt, S_IRUGO | S_IWUSR,
 				raid5_show_group_thread_cnt,
 				raid5_store_group_thread_cnt);
 
+/*
+ * One line per worker: group (NUMA node), worker index, work item runs,
+ * device_lock round trips (batches of up to MAX_STRIPE_BATCH stripes) and
+ * stripes handled.
+ */
+static ssize_t
+raid5_show_group_thread_stats(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf;
+	ssize_t ret = 0;
+	int i, j, err;
+
+	err = mddev_lock(mddev);
+	if (err)
+		return err;
+	conf = mddev->private;
+	if (conf) {
+		for (i = 0; i < conf->group_cnt; i++) {
+			struct r5worker_group *group = &conf->worker_groups[i];
+
+			for (j = 0; j < conf->worker_cnt_per_group; j++) {
+				struct r5worker *worker = &group->workers[j];
+
+				ret += scnprintf(page + ret, PAGE_SIZE - ret,
+						 "%d %d %lu %lu %lu\n", i, j,
+						 READ_ONCE(worker->runs),
+						 READ_ONCE(worker->batches),
+						 READ_ONCE(worker->stripes_handled));
+			}
+		}
+	}
+	mddev_unlock(mddev);
+	return ret;
+}
+
+static struct md_sysfs_entry
+raid5_group_thread_stats = __ATTR(group_thread_stats, S_IRUGO,
+				  raid5_show_group_thread_stats, NULL);
+
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
 	&raid5_preread_bypass_threshold.attr,
 	&raid5_group_thread_cnt.attr,
+	&raid5_group_thread_stats.attr,
 	&raid5_skip_copy.attr,
 	&raid5_rmw_level.attr,
 	&raid5_stripe_size.attr,
@@ -6958,8 +7002,6 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 			       struct r5worker_group **worker_groups)
 {
 	int i, j, k;
-	ssize_t size;
-	struct r5worker *workers;
 
 	if (cnt == 0) {
 		*group_cnt = 0;
@@ -6967,15 +7009,10 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 		return 0;
 	}
 	*group_cnt = num_possible_nodes();
-	size = sizeof(struct r5worker) * cnt;
-	workers = kcalloc(size, *group_cnt, GFP_NOIO);
 	*worker_groups = kcalloc(*group_cnt, sizeof(struct r5worker_group),
 				 GFP_NOIO);
-	if (!*worker_groups || !workers) {
-		kfree(workers);
-		kfree(*worker_groups);
+	if (!*worker_groups)
 		return -ENOMEM;
-	}
 
 	for (i = 0; i < *group_cnt; i++) {
 		struct r5worker_group *group;
@@ -6984,7 +7021,16 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 		INIT_LIST_HEAD(&group->handle_list);
 		INIT_LIST_HEAD(&group->loprio_list);
 		group->conf = conf;
-		group->workers = workers + i * cnt;
+		/*
+		 * Groups are per node (see cpu_to_group()), keep the workers
+		 * and their temp_inactive_list heads on the node running them.
+		 */
+		group->workers = kcalloc_node(cnt, sizeof(struct r5worker),
+					      GFP_NOIO, i);
+		if (!group->workers) {
+			__free_thread_groups(*worker_groups, i);
+			return -ENOMEM;
+		}
 
 		for (j = 0; j < cnt; j++) {
 			struct r5worker *worker = group->workers + j;
@@ -6999,11 +7045,21 @@ static int alloc_thread_groups(struct r5conf *conf, int cnt, int *group_cnt,
 	return 0;
 }
 
+static void __free_thread_groups(struct r5worker_group *worker_groups,
+				 int group_cnt)
+{
+	int i;
+
+	if (!worker_groups)
+		return;
+	for (i = 0; i < group_cnt; i++)
+		kfree(worker_groups[i].workers);
+	kfree(worker_groups);
+}
+
 static void free_thread_groups(struct r5conf *conf)
 {
-	if (conf->worker_groups)
-		kfree(conf->worker_groups[0].workers);
-	kfree(conf->worker_groups);
+	__free_thread_groups(conf->worker_groups, conf->group_cnt);
 	conf->worker_groups = NULL;
 }
 
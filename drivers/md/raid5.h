@@ -507,8 +507,17 @@ struct r5worker {
 	struct r5worker_group *group;
 	struct list_head temp_inactive_list[NR_STRIPE_HASH_LOCKS];
 	bool working;
+	/* only updated by raid5_do_work(), which doesn't run concurrently */
+	unsigned long runs;
+	unsigned long stripes_handled;
+	unsigned long batches;
 };
 
+/*
+ * One group per NUMA node. Only the handle lists and the workers are per
+ * group: all groups still share the stripe cache (conf->stripe_hashtbl and
+ * the inactive lists) and take conf->device_lock for every batch.
+ */
 struct r5worker_group {
 	struct list_head handle_list;
 	struct list_head loprio_list;
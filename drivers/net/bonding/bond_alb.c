@@ -1358,13 +1358,9 @@ struct slave *bond_xmit_tlb_slave_get(struct bonding *bond,
 							      skb->len);
 			} else {
 				struct bond_up_slave *slaves;
-				unsigned int count;
 
 				slaves = rcu_dereference(bond->usable_slaves);
-				count = slaves ? READ_ONCE(slaves->count) : 0;
-				if (likely(count))
-					tx_slave = slaves->arr[hash_index %
-							       count];
+				tx_slave = bond_slave_arr_get(slaves, hash_index);
 			}
 			break;
 		}
@@ -1472,13 +1468,10 @@ struct slave *bond_xmit_alb_slave_get(struct bonding *bond,
 			 */
 
 			struct bond_up_slave *slaves;
-			unsigned int count;
 
 			slaves = rcu_dereference(bond->usable_slaves);
-			count = slaves ? READ_ONCE(slaves->count) : 0;
-			if (likely(count))
-				tx_slave = slaves->arr[bond_xmit_hash(bond, skb) %
-						       count];
+			tx_slave = bond_slave_arr_get(slaves,
+						      bond_xmit_hash(bond, skb));
 		}
 	}
 	return tx_slave;
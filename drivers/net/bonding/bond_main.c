@@ -117,6 +117,7 @@ static struct bond_params bonding_defaults;
 static int resend_igmp = BOND_DEFAULT_RESEND_IGMP;
 static int packets_per_slave = 1;
 static int lp_interval = BOND_ALB_DEFAULT_LP_INTERVAL;
+static int xmit_hash_stable;
 
 module_param(max_bonds, int, 0);
 MODULE_PARM_DESC(max_bonds, "Max number of bonded devices");
@@ -197,6 +198,12 @@ module_param(lp_interval, uint, 0);
 MODULE_PARM_DESC(lp_interval, "The number of seconds between instances where "
 			      "the bonding driver sends learning packets to "
 			      "each slaves peer switch. The default is 1.");
+module_param(xmit_hash_stable, int, 0);
+MODULE_PARM_DESC(xmit_hash_stable, "Map xmit hashes to slaves through a bucket "
+				   "table so that only the flows of a slave "
+				   "that comes or goes are moved; "
+				   "0 for hash modulo slave count (default), "
+				   "1 for the stable bucket table.");
 
 /*----------------------------- Global variables ----------------------------*/
 
@@ -1415,6 +1422,7 @@ static void bond_compute_features(struct bonding *bond)
 	struct list_head *iter;
 	struct slave *slave;
 	unsigned short max_hard_header_len = ETH_HLEN;
+	unsigned int tso_max_size = GSO_MAX_SIZE;
 	unsigned int gso_max_size = GSO_MAX_SIZE;
 	u16 gso_max_segs = GSO_MAX_SEGS;
 
@@ -1445,6 +1453,7 @@ static void bond_compute_features(struct bonding *bond)
 		if (slave->dev->hard_header_len > max_hard_header_len)
 			max_hard_header_len = slave->dev->hard_header_len;
 
+		tso_max_size = min(tso_max_size, slave->dev->tso_max_size);
 		gso_max_size = min(gso_max_size, slave->dev->gso_max_size);
 		gso_max_segs = min(gso_max_segs, slave->dev->gso_max_segs);
 	}
@@ -1460,6 +1469,7 @@ static void bond_compute_features(struct bonding *bond)
 #endif /* CONFIG_XFRM_OFFLOAD */
 	bond_dev->mpls_features = mpls_features;
 	bond_dev->gso_max_segs = gso_max_segs;
+	netif_set_tso_max_size(bond_dev, tso_max_size);
 	netif_set_gso_max_size(bond_dev, gso_max_size);
 
 	bond_dev->priv_flags &= ~IFF_XMIT_DST_RELEASE;
@@ -4678,6 +4688,25 @@ static void bond_slave_arr_handler(struct work_struct *work)
 	bond_slave_arr_work_rearm(bond, 1);
 }
 
+/* Point the buckets of the slave at @idx to the remaining slaves and the
+ * buckets of the last slave to @idx, where bond_skip_slave() moves it.
+ */
+static void bond_skip_slave_map(struct bond_up_slave *slaves, int idx)
+{
+	unsigned int last = slaves->count - 1;
+	int i;
+
+	if (!slaves->map)
+		return;
+
+	for (i = 0; i < BOND_HASH_BUCKETS; i++) {
+		if (slaves->map[i] == idx)
+			WRITE_ONCE(slaves->map[i], last ? i % last : 0);
+		if (slaves->map[i] == last)
+			WRITE_ONCE(slaves->map[i], idx);
+	}
+}
+
 static void bond_skip_slave(struct bond_up_slave *slaves,
 			    struct slave *skipslave)
 {
@@ -4693,6 +4722,7 @@ static void bond_skip_slave(struct bond_up_slave *slaves,
 	 */
 	for (idx = 0; slaves && idx < slaves->count; idx++) {
 		if (skipslave == slaves->arr[idx]) {
+			bond_skip_slave_map(slaves, idx);
 			slaves->arr[idx] =
 				slaves->arr[slaves->count - 1];
 			slaves->count--;
@@ -4701,6 +4731,66 @@ static void bond_skip_slave(struct bond_up_slave *slaves,
 	}
 }
 
+/* Fill the hash bucket map of @new. Buckets keep the slave they had in @old
+ * as long as it is still usable and not above its fair share, the rest go to
+ * the least loaded slaves. This way a slave coming or going only moves its
+ * own share of the flows instead of rehashing all of them.
+ */
+static void bond_build_slave_map(struct bond_up_slave *old,
+				 struct bond_up_slave *new)
+{
+	unsigned int max, idx, *load;
+	struct slave *slave;
+	int i, j;
+
+	if (!new->count || new->count >= U16_MAX)
+		goto no_map;
+
+	load = kcalloc(new->count, sizeof(*load), GFP_KERNEL);
+	if (!load)
+		goto no_map;
+
+	max = DIV_ROUND_UP(BOND_HASH_BUCKETS, new->count);
+	for (i = 0; i < BOND_HASH_BUCKETS; i++) {
+		new->map[i] = U16_MAX;
+		if (!old || !old->map)
+			continue;
+
+		idx = old->map[i];
+		if (idx >= old->count)
+			continue;
+
+		slave = old->arr[idx];
+		for (j = 0; j < new->count; j++) {
+			if (new->arr[j] == slave)
+				break;
+		}
+		if (j < new->count && load[j] < max) {
+			new->map[i] = j;
+			load[j]++;
+		}
+	}
+
+	for (i = 0; i < BOND_HASH_BUCKETS; i++) {
+		if (new->map[i] != U16_MAX)
+			continue;
+
+		idx = 0;
+		for (j = 1; j < new->count; j++) {
+			if (load[j] < load[idx])
+				idx = j;
+		}
+		new->map[i] = idx;
+		load[idx]++;
+	}
+
+	kfree(load);
+	return;
+
+no_map:
+	new->map = NULL;
+}
+
 static void bond_set_slave_arr(struct bonding *bond,
 			       struct bond_up_slave *usable_slaves,
 			       struct bond_up_slave *all_slaves)
@@ -4739,6 +4829,9 @@ static void bond_reset_slave_arr(struct bonding *bond)
  * (b) BOND_MODE_XOR
  * (c) (BOND_MODE_TLB || BOND_MODE_ALB) && tlb_dynamic_lb == 0
  *
+ * With xmit_hash_stable the array also carries the hash bucket map, otherwise
+ * the slave is picked by hash modulo slave count.
+ *
  * The caller is expected to hold RTNL only and NO other lock!
  */
 int bond_update_slave_arr(struct bonding *bond, struct slave *skipslave)
@@ -4752,7 +4845,8 @@ int bond_update_slave_arr(struct bonding *bond, struct slave *skipslave)
 	might_sleep();
 
 	usable_slaves = kzalloc(struct_size(usable_slaves, arr,
-					    bond->slave_cnt), GFP_KERNEL);
+					    bond->slave_cnt) +
+				BOND_HASH_BUCKETS * sizeof(u16), GFP_KERNEL);
 	all_slaves = kzalloc(struct_size(all_slaves, arr,
 					 bond->slave_cnt), GFP_KERNEL);
 	if (!usable_slaves || !all_slaves) {
@@ -4796,6 +4890,11 @@ int bond_update_slave_arr(struct bonding *bond, struct slave *skipslave)
 		usable_slaves->arr[usable_slaves->count++] = slave;
 	}
 
+	if (bond->params.xmit_hash_stable) {
+		usable_slaves->map = (u16 *)&usable_slaves->arr[bond->slave_cnt];
+		bond_build_slave_map(rtnl_dereference(bond->usable_slaves),
+				     usable_slaves);
+	}
 	bond_set_slave_arr(bond, usable_slaves, all_slaves);
 	return ret;
 out:
@@ -4815,33 +4914,16 @@ static struct slave *bond_xmit_3ad_xor_slave_get(struct bonding *bond,
 						 struct sk_buff *skb,
 						 struct bond_up_slave *slaves)
 {
-	struct slave *slave;
-	unsigned int count;
-	u32 hash;
-
-	hash = bond_xmit_hash(bond, skb);
-	count = slaves ? READ_ONCE(slaves->count) : 0;
-	if (unlikely(!count))
-		return NULL;
-
-	slave = slaves->arr[hash % count];
-	return slave;
+	return bond_slave_arr_get(slaves, bond_xmit_hash(bond, skb));
 }
 
 static struct slave *bond_xdp_xmit_3ad_xor_slave_get(struct bonding *bond,
 						     struct xdp_buff *xdp)
 {
 	struct bond_up_slave *slaves;
-	unsigned int count;
-	u32 hash;
 
-	hash = bond_xmit_hash_xdp(bond, xdp);
 	slaves = rcu_dereference(bond->usable_slaves);
-	count = slaves ? READ_ONCE(slaves->count) : 0;
-	if (unlikely(!count))
-		return NULL;
-
-	return slaves->arr[hash % count];
+	return bond_slave_arr_get(slaves, bond_xmit_hash_xdp(bond, xdp));
 }
 
 /* Use this Xmit function for 3AD as well as XOR modes. The current
@@ -5048,17 +5130,12 @@ static struct net_device *__bond_sk_get_lower_dev(struct bonding *bond,
 {
 	struct bond_up_slave *slaves;
 	struct slave *slave;
-	unsigned int count;
-	u32 hash;
 
 	slaves = rcu_dereference(bond->usable_slaves);
-	count = slaves ? READ_ONCE(slaves->count) : 0;
-	if (unlikely(!count))
+	slave = bond_slave_arr_get(slaves, bond_sk_hash_l34(sk));
+	if (unlikely(!slave))
 		return NULL;
 
-	hash = bond_sk_hash_l34(sk);
-	slave = slaves->arr[hash % count];
-
 	return slave->dev;
 }
 
@@ -5650,6 +5727,12 @@ static int bond_check_params(struct bond_params *params)
 		all_slaves_active = 0;
 	}
 
+	if ((xmit_hash_stable != 0) && (xmit_hash_stable != 1)) {
+		pr_warn("Warning: xmit_hash_stable module parameter (%d), not of valid value (0/1), so it was set to 0\n",
+			xmit_hash_stable);
+		xmit_hash_stable = 0;
+	}
+
 	if (resend_igmp < 0 || resend_igmp > 255) {
 		pr_warn("Warning: resend_igmp (%d) should be between 0 and 255, resetting to %d\n",
 			resend_igmp, BOND_DEFAULT_RESEND_IGMP);
@@ -5879,6 +5962,7 @@ static int bond_check_params(struct bond_params *params)
 	params->lp_interval = lp_interval;
 	params->packets_per_slave = packets_per_slave;
 	params->tlb_dynamic_lb = tlb_dynamic_lb;
+	params->xmit_hash_stable = xmit_hash_stable;
 	params->ad_actor_sys_prio = ad_actor_sys_prio;
 	eth_zero_addr(params->ad_actor_system);
 	params->ad_user_port_key = ad_user_port_key;
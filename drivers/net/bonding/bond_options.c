@@ -72,6 +72,8 @@ static int bond_option_slaves_set(struct bonding *bond,
 				  const struct bond_opt_value *newval);
 static int bond_option_tlb_dynamic_lb_set(struct bonding *bond,
 				  const struct bond_opt_value *newval);
+static int bond_option_xmit_hash_stable_set(struct bonding *bond,
+					    const struct bond_opt_value *newval);
 static int bond_option_ad_actor_sys_prio_set(struct bonding *bond,
 					     const struct bond_opt_value *newval);
 static int bond_option_ad_actor_system_set(struct bonding *bond,
@@ -201,6 +203,12 @@ static const struct bond_opt_value bond_tlb_dynamic_lb_tbl[] = {
 	{ NULL,  -1, 0}
 };
 
+static const struct bond_opt_value bond_xmit_hash_stable_tbl[] = {
+	{ "off", 0,  BOND_VALFLAG_DEFAULT},
+	{ "on",  1,  0},
+	{ NULL,  -1, 0}
+};
+
 static const struct bond_opt_value bond_ad_actor_sys_prio_tbl[] = {
 	{ "minval",  1,     BOND_VALFLAG_MIN},
 	{ "maxval",  65535, BOND_VALFLAG_MAX | BOND_VALFLAG_DEFAULT},
@@ -416,6 +424,18 @@ static const struct bond_option bond_opts[BOND_OPT_LAST] = {
 		.flags = BOND_OPTFLAG_IFDOWN,
 		.set = bond_option_tlb_dynamic_lb_set,
 	},
+	[BOND_OPT_XMIT_HASH_STABLE] = {
+		.id = BOND_OPT_XMIT_HASH_STABLE,
+		.name = "xmit_hash_stable",
+		.desc = "Keep flows on their slave when another slave comes or goes",
+		.unsuppmodes = BOND_MODE_ALL_EX(BIT(BOND_MODE_XOR) |
+						BIT(BOND_MODE_8023AD) |
+						BIT(BOND_MODE_TLB) |
+						BIT(BOND_MODE_ALB)),
+		.values = bond_xmit_hash_stable_tbl,
+		.flags = BOND_OPTFLAG_IFDOWN,
+		.set = bond_option_xmit_hash_stable_set,
+	},
 	[BOND_OPT_AD_ACTOR_SYS_PRIO] = {
 		.id = BOND_OPT_AD_ACTOR_SYS_PRIO,
 		.name = "ad_actor_sys_prio",
@@ -1500,6 +1520,16 @@ static int bond_option_tlb_dynamic_lb_set(struct bonding *bond,
 	return 0;
 }
 
+static int bond_option_xmit_hash_stable_set(struct bonding *bond,
+					    const struct bond_opt_value *newval)
+{
+	netdev_dbg(bond->dev, "Setting xmit_hash_stable to %s (%llu)\n",
+		   newval->string, newval->value);
+	bond->params.xmit_hash_stable = newval->value;
+
+	return 0;
+}
+
 static int bond_option_ad_actor_sys_prio_set(struct bonding *bond,
 					     const struct bond_opt_value *newval)
 {
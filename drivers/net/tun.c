@@ -145,6 +145,10 @@ struct tun_file {
 	struct tun_struct *detached;
 	struct ptr_ring tx_ring;
 	struct xdp_rxq_info xdp_rxq;
+	/* TUNSETWRITEBATCH: one packet per iovec of a write */
+	bool write_batch;
+	atomic_long_t batch_writes;
+	atomic_long_t batch_pkts;
 };
 
 struct tun_page {
@@ -1544,14 +1548,16 @@ static void tun_rx_batched(struct tun_struct *tun, struct tun_file *tfile,
 
 	if (rcv) {
 		struct sk_buff *nskb;
+		LIST_HEAD(list);
 
-		local_bh_disable();
+		__skb_queue_tail(&process_queue, skb);
 		while ((nskb = __skb_dequeue(&process_queue))) {
 			skb_record_rx_queue(nskb, tfile->queue_index);
-			netif_receive_skb(nskb);
+			list_add_tail(&nskb->list, &list);
 		}
-		skb_record_rx_queue(skb, tfile->queue_index);
-		netif_receive_skb(skb);
+
+		local_bh_disable();
+		netif_receive_skb_list(&list);
 		local_bh_enable();
 	}
 }
@@ -1714,10 +1720,13 @@ static struct sk_buff *tun_build_skb(struct tun_struct *tun,
 	return NULL;
 }
 
-/* Get packet from user space buffer */
+/* Get packet from user space buffer. Packets that would be received
+ * right away are added to @rx_list instead if it is given, the caller
+ * passes them to the stack together.
+ */
 static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 			    void *msg_control, struct iov_iter *from,
-			    int noblock, bool more)
+			    int noblock, bool more, struct list_head *rx_list)
 {
 	struct tun_pi pi = { 0, cpu_to_be16(ETH_P_IP) };
 	struct sk_buff *skb;
@@ -1973,6 +1982,8 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 			napi_schedule(&tfile->napi);
 
 		local_bh_enable();
+	} else if (rx_list) {
+		list_add_tail(&skb->list, rx_list);
 	} else if (!IS_ENABLED(CONFIG_4KSTACKS)) {
 		tun_rx_batched(tun, tfile, skb, more);
 	} else {
@@ -1990,6 +2001,59 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 	return total_len;
 }
 
+/*
+ * With TUNSETWRITEBATCH, every iovec of a write carries one complete packet,
+ * framed as for a plain write (tun_pi and virtio_net_hdr as configured).
+ * The packets are passed to the stack as one list. If a packet is bad,
+ * the ones before it are still received and their length is returned,
+ * like a short write.
+ */
+static ssize_t tun_get_user_batch(struct tun_struct *tun,
+				  struct tun_file *tfile,
+				  struct iov_iter *from, int noblock)
+{
+	size_t len, left = iov_iter_count(from);
+	struct list_head *rx_list = NULL;
+	unsigned long i, pkts = 0;
+	ssize_t ret = 0, total = 0;
+	LIST_HEAD(list);
+
+	/* Keep the stack depth of netif_rx_ni() on small stacks. */
+	if (!IS_ENABLED(CONFIG_4KSTACKS))
+		rx_list = &list;
+
+	for (i = 0; i < from->nr_segs && left; i++) {
+		struct iov_iter seg;
+
+		len = min(from->iov[i].iov_len, left);
+		if (!len)
+			continue;
+		left -= len;
+
+		iov_iter_init(&seg, WRITE, &from->iov[i], 1, len);
+		ret = tun_get_user(tun, tfile, NULL, &seg, noblock, left,
+				   rx_list);
+		if (ret < 0)
+			break;
+		total += ret;
+		pkts++;
+	}
+
+	if (!list_empty(&list)) {
+		local_bh_disable();
+		netif_receive_skb_list(&list);
+		local_bh_enable();
+	}
+
+	if (pkts) {
+		atomic_long_inc(&tfile->batch_writes);
+		atomic_long_add(pkts, &tfile->batch_pkts);
+	}
+	iov_iter_advance(from, total);
+
+	return total ?: ret;
+}
+
 static ssize_t tun_chr_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct file *file = iocb->ki_filp;
@@ -2004,7 +2068,12 @@ static ssize_t tun_chr_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	if ((file->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT))
 		noblock = 1;
 
-	result = tun_get_user(tun, tfile, NULL, from, noblock, false);
+	if (READ_ONCE(tfile->write_batch) && iter_is_iovec(from) &&
+	    !from->iov_offset)
+		result = tun_get_user_batch(tun, tfile, from, noblock);
+	else
+		result = tun_get_user(tun, tfile, NULL, from, noblock, false,
+				      NULL);
 
 	tun_put(tun);
 	return result;
@@ -2533,7 +2602,7 @@ static int tun_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len)
 
 	ret = tun_get_user(tun, tfile, ctl ? ctl->ptr : NULL, &m->msg_iter,
 			   m->msg_flags & MSG_DONTWAIT,
-			   m->msg_flags & MSG_MORE);
+			   m->msg_flags & MSG_MORE, NULL);
 out:
 	tun_put(tun);
 	return ret;
@@ -3025,6 +3094,13 @@ static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 				(unsigned int __user*)argp);
 	} else if (cmd == TUNSETQUEUE) {
 		return tun_set_queue(file, &ifr);
+	} else if (cmd == TUNSETWRITEBATCH) {
+		int on;
+
+		if (copy_from_user(&on, argp, sizeof(on)))
+			return -EFAULT;
+		WRITE_ONCE(tfile->write_batch, !!on);
+		return 0;
 	} else if (cmd == SIOCGSKNS) {
 		if (!ns_capable(net->user_ns, CAP_NET_ADMIN))
 			return -EPERM;
@@ -3441,6 +3517,10 @@ static void tun_chr_show_fdinfo(struct seq_file *m, struct file *file)
 		tun_put(tun);
 
 	seq_printf(m, "iff:\t%s\n", ifr.ifr_name);
+	seq_printf(m, "batch_writes:\t%ld\n",
+		   atomic_long_read(&tfile->batch_writes));
+	seq_printf(m, "batch_pkts:\t%ld\n",
+		   atomic_long_read(&tfile->batch_pkts));
 }
 #endif
 
@@ -33,6 +33,10 @@
 #define VETH_XDP_FLAG		BIT(0)
 #define VETH_RING_SIZE		256
 #define VETH_XDP_HEADROOM	(XDP_PACKET_HEADROOM + NET_IP_ALIGN)
+/* Frames that do not fit in a page are copied into a compound page, up
+ * to this order, so that jumbo frames can go through XDP.
+ */
+#define VETH_XDP_MAX_ORDER	2
 
 #define VETH_XDP_TX_BULK_SIZE	16
 #define VETH_XDP_BATCH		16
@@ -732,13 +736,15 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq,
 		int size, head_off;
 		void *head, *start;
 		struct page *page;
+		unsigned int order;
 
 		size = SKB_DATA_ALIGN(VETH_XDP_HEADROOM + pktlen) +
 		       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
-		if (size > PAGE_SIZE)
+		if (size > (PAGE_SIZE << VETH_XDP_MAX_ORDER))
 			goto drop;
 
-		page = alloc_page(GFP_ATOMIC | __GFP_NOWARN);
+		order = get_order(size);
+		page = alloc_pages(GFP_ATOMIC | __GFP_NOWARN | __GFP_COMP, order);
 		if (!page)
 			goto drop;
 
@@ -750,7 +756,7 @@ static struct sk_buff *veth_xdp_rcv_skb(struct veth_rq *rq,
 		}
 
 		nskb = veth_build_skb(head, VETH_XDP_HEADROOM + mac_len,
-				      skb->len, PAGE_SIZE);
+				      skb->len, PAGE_SIZE << order);
 		if (!nskb) {
 			page_frag_free(head);
 			goto drop;
@@ -1470,8 +1476,8 @@ static int veth_xdp_set(struct net_device *dev, struct bpf_prog *prog,
 			goto err;
 		}
 
-		max_mtu = PAGE_SIZE - VETH_XDP_HEADROOM -
-			  peer->hard_header_len -
+		max_mtu = (PAGE_SIZE << VETH_XDP_MAX_ORDER) -
+			  VETH_XDP_HEADROOM - peer->hard_header_len -
 			  SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 		if (peer->mtu > max_mtu) {
 			NL_SET_ERR_MSG_MOD(extack, "Peer MTU is too large to set XDP");
@@ -1584,6 +1590,7 @@ static void veth_setup(struct net_device *dev)
 	dev->hw_features = VETH_FEATURES;
 	dev->hw_enc_features = VETH_FEATURES;
 	dev->mpls_features = NETIF_F_HW_CSUM | NETIF_F_GSO_SOFTWARE;
+	netif_set_tso_max_size(dev, GSO_MAX_SIZE);
 }
 
 /*
@@ -21,6 +21,7 @@
 #include <linux/kernel.h>
 #include <net/route.h>
 #include <net/xdp.h>
+#include <net/page_pool.h>
 #include <net/net_failover.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
@@ -155,6 +156,9 @@ struct receive_queue {
 	/* Page frag for packet buffer allocation. */
 	struct page_frag alloc_frag;
 
+	/* Recycles mergeable buffers, NULL if not in use */
+	struct page_pool *page_pool;
+
 	/* RX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
@@ -394,6 +398,29 @@ static unsigned int mergeable_ctx_to_truesize(void *mrg_ctx)
 	return (unsigned long)mrg_ctx & ((1 << MRG_CTX_HEADER_SHIFT) - 1);
 }
 
+/* Mergeable buffers come from rq->page_pool when there is one */
+static struct page *virtnet_alloc_page(struct receive_queue *rq, gfp_t gfp)
+{
+	struct page *page;
+
+	if (!rq->page_pool)
+		return alloc_page(gfp);
+
+	page = page_pool_alloc_pages(rq->page_pool, gfp);
+	if (page)
+		page_pool_set_frag_count(page, 1);
+	return page;
+}
+
+static void virtnet_put_page(struct receive_queue *rq, struct page *page,
+			     bool allow_direct)
+{
+	if (rq->page_pool)
+		page_pool_put_full_page(rq->page_pool, page, allow_direct);
+	else
+		put_page(page);
+}
+
 /* Called from bottom half context */
 static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 				   struct receive_queue *rq,
@@ -443,6 +470,8 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 
 		skb_reserve(skb, p - buf);
 		skb_put(skb, len);
+		if (rq->page_pool)
+			skb_mark_for_recycle(skb);
 
 		page = (struct page *)page->private;
 		if (page)
@@ -454,6 +483,8 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 	skb = napi_alloc_skb(&rq->napi, GOOD_COPY_LEN);
 	if (unlikely(!skb))
 		return NULL;
+	if (rq->page_pool)
+		skb_mark_for_recycle(skb);
 
 	/* Copy all frame if it fits skb->head, otherwise
 	 * we let virtio_net_hdr_to_skb() and GRO pull headers as needed.
@@ -506,7 +537,7 @@ static struct sk_buff *page_to_skb(struct virtnet_info *vi,
 		memcpy(hdr, hdr_p, hdr_len);
 	}
 	if (page_to_free)
-		put_page(page_to_free);
+		virtnet_put_page(rq, page_to_free, true);
 
 	if (metasize) {
 		__skb_pull(skb, metasize);
@@ -679,7 +710,7 @@ static struct page *xdp_linearize_page(struct receive_queue *rq,
 				       int page_off,
 				       unsigned int *len)
 {
-	struct page *page = alloc_page(GFP_ATOMIC);
+	struct page *page = virtnet_alloc_page(rq, GFP_ATOMIC);
 
 	if (!page)
 		return NULL;
@@ -704,21 +735,21 @@ static struct page *xdp_linearize_page(struct receive_queue *rq,
 		 * is sending packet larger than the MTU.
 		 */
 		if ((page_off + buflen + tailroom) > PAGE_SIZE) {
-			put_page(p);
+			virtnet_put_page(rq, p, true);
 			goto err_buf;
 		}
 
 		memcpy(page_address(page) + page_off,
 		       page_address(p) + off, buflen);
 		page_off += buflen;
-		put_page(p);
+		virtnet_put_page(rq, p, true);
 	}
 
 	/* Headroom does not contribute to packet length */
 	*len = page_off - VIRTIO_XDP_HEADROOM;
 	return page;
 err_buf:
-	__free_pages(page, 0);
+	virtnet_put_page(rq, page, true);
 	return NULL;
 }
 
@@ -1006,7 +1037,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			/* We can only create skb based on xdp_page. */
 			if (unlikely(xdp_page != page)) {
 				rcu_read_unlock();
-				put_page(page);
+				virtnet_put_page(rq, page, true);
 				head_skb = page_to_skb(vi, rq, xdp_page, offset,
 						       len, PAGE_SIZE, false,
 						       metasize,
@@ -1019,7 +1050,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			xdpf = xdp_convert_buff_to_frame(&xdp);
 			if (unlikely(!xdpf)) {
 				if (unlikely(xdp_page != page))
-					put_page(xdp_page);
+					virtnet_put_page(rq, xdp_page, true);
 				goto err_xdp;
 			}
 			err = virtnet_xdp_xmit(dev, 1, &xdpf, 0);
@@ -1028,12 +1059,12 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			} else if (unlikely(err < 0)) {
 				trace_xdp_exception(vi->dev, xdp_prog, act);
 				if (unlikely(xdp_page != page))
-					put_page(xdp_page);
+					virtnet_put_page(rq, xdp_page, true);
 				goto err_xdp;
 			}
 			*xdp_xmit |= VIRTIO_XDP_TX;
 			if (unlikely(xdp_page != page))
-				put_page(page);
+				virtnet_put_page(rq, page, true);
 			rcu_read_unlock();
 			goto xdp_xmit;
 		case XDP_REDIRECT:
@@ -1041,12 +1072,12 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			err = xdp_do_redirect(dev, &xdp, xdp_prog);
 			if (err) {
 				if (unlikely(xdp_page != page))
-					put_page(xdp_page);
+					virtnet_put_page(rq, xdp_page, true);
 				goto err_xdp;
 			}
 			*xdp_xmit |= VIRTIO_XDP_REDIR;
 			if (unlikely(xdp_page != page))
-				put_page(page);
+				virtnet_put_page(rq, page, true);
 			rcu_read_unlock();
 			goto xdp_xmit;
 		default:
@@ -1057,7 +1088,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 			fallthrough;
 		case XDP_DROP:
 			if (unlikely(xdp_page != page))
-				__free_pages(xdp_page, 0);
+				virtnet_put_page(rq, xdp_page, true);
 			goto err_xdp;
 		}
 	}
@@ -1099,6 +1130,8 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 
 			if (unlikely(!nskb))
 				goto err_skb;
+			if (rq->page_pool)
+				skb_mark_for_recycle(nskb);
 			if (curr_skb == head_skb)
 				skb_shinfo(curr_skb)->frag_list = nskb;
 			else
@@ -1114,7 +1147,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		}
 		offset = buf - page_address(page);
 		if (skb_can_coalesce(curr_skb, num_skb_frags, page, offset)) {
-			put_page(page);
+			virtnet_put_page(rq, page, true);
 			skb_coalesce_rx_frag(curr_skb, num_skb_frags - 1,
 					     len, truesize);
 		} else {
@@ -1130,7 +1163,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 	rcu_read_unlock();
 	stats->xdp_drops++;
 err_skb:
-	put_page(page);
+	virtnet_put_page(rq, page, true);
 	while (num_buf-- > 1) {
 		buf = virtqueue_get_buf(rq->vq, &len);
 		if (unlikely(!buf)) {
@@ -1141,7 +1174,7 @@ static struct sk_buff *receive_mergeable(struct net_device *dev,
 		}
 		stats->bytes += len;
 		page = virt_to_head_page(buf);
-		put_page(page);
+		virtnet_put_page(rq, page, true);
 	}
 err_buf:
 	stats->drops++;
@@ -1163,7 +1196,7 @@ static void receive_buf(struct virtnet_info *vi, struct receive_queue *rq,
 		pr_debug("%s: short packet %i\n", dev->name, len);
 		dev->stats.rx_length_errors++;
 		if (vi->mergeable_rx_bufs) {
-			put_page(virt_to_head_page(buf));
+			virtnet_put_page(rq, virt_to_head_page(buf), true);
 		} else if (vi->big_packets) {
 			give_pages(rq, buf);
 		} else {
@@ -1322,6 +1355,19 @@ static int add_recvbuf_mergeable(struct virtnet_info *vi,
 	 * disabled GSO for XDP, it won't be a big issue.
 	 */
 	len = get_mergeable_buf_len(rq, &rq->mrg_avg_pkt_len, room);
+	if (rq->page_pool) {
+		unsigned int offset;
+		struct page *page;
+
+		page = page_pool_alloc_frag(rq->page_pool, &offset,
+					    len + room, gfp);
+		if (unlikely(!page))
+			return -ENOMEM;
+
+		buf = (char *)page_address(page) + offset + headroom;
+		goto add;
+	}
+
 	if (unlikely(!skb_page_frag_refill(len + room, alloc_frag, gfp)))
 		return -ENOMEM;
 
@@ -1339,11 +1385,12 @@ static int add_recvbuf_mergeable(struct virtnet_info *vi,
 		alloc_frag->offset += hole;
 	}
 
+add:
 	sg_init_one(rq->sg, buf, len);
 	ctx = mergeable_len_to_ctx(len, headroom);
 	err = virtqueue_add_inbuf_ctx(rq->vq, rq->sg, 1, buf, ctx, gfp);
 	if (err < 0)
-		put_page(virt_to_head_page(buf));
+		virtnet_put_page(rq, virt_to_head_page(buf), false);
 
 	return err;
 }
@@ -1617,8 +1664,14 @@ static int virtnet_open(struct net_device *dev)
 		if (err < 0)
 			return err;
 
-		err = xdp_rxq_info_reg_mem_model(&vi->rq[i].xdp_rxq,
-						 MEM_TYPE_PAGE_SHARED, NULL);
+		if (vi->rq[i].page_pool)
+			err = xdp_rxq_info_reg_mem_model(&vi->rq[i].xdp_rxq,
+							 MEM_TYPE_PAGE_POOL,
+							 vi->rq[i].page_pool);
+		else
+			err = xdp_rxq_info_reg_mem_model(&vi->rq[i].xdp_rxq,
+							 MEM_TYPE_PAGE_SHARED,
+							 NULL);
 		if (err < 0) {
 			xdp_rxq_info_unreg(&vi->rq[i].xdp_rxq);
 			return err;
@@ -2765,6 +2818,7 @@ static void virtnet_free_queues(struct virtnet_info *vi)
 	for (i = 0; i < vi->max_queue_pairs; i++) {
 		__netif_napi_del(&vi->rq[i].napi);
 		__netif_napi_del(&vi->sq[i].napi);
+		page_pool_destroy(vi->rq[i].page_pool);
 	}
 
 	/* We called __netif_napi_del(),
@@ -2828,7 +2882,8 @@ static void free_unused_bufs(struct virtnet_info *vi)
 
 		while ((buf = virtqueue_detach_unused_buf(vq)) != NULL) {
 			if (vi->mergeable_rx_bufs) {
-				put_page(virt_to_head_page(buf));
+				virtnet_put_page(&vi->rq[i],
+						 virt_to_head_page(buf), false);
 			} else if (vi->big_packets) {
 				give_pages(&vi->rq[i], buf);
 			} else {
@@ -2993,6 +3048,30 @@ static int virtnet_alloc_queues(struct virtnet_info *vi)
 	return -ENOMEM;
 }
 
+/* Without a pool, mergeable buffers fall back to the per queue page frag */
+static void virtnet_create_page_pools(struct virtnet_info *vi)
+{
+	struct page_pool_params pp_params = {
+		.flags		= PP_FLAG_PAGE_FRAG,
+		.order		= 0,
+		.nid		= dev_to_node(&vi->vdev->dev),
+		.dev		= &vi->vdev->dev,
+	};
+	struct page_pool *pool;
+	int i;
+
+	if (!vi->mergeable_rx_bufs)
+		return;
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		pp_params.pool_size = virtqueue_get_vring_size(vi->rq[i].vq);
+		pool = page_pool_create(&pp_params);
+		if (IS_ERR(pool))
+			continue;
+		vi->rq[i].page_pool = pool;
+	}
+}
+
 static int init_vqs(struct virtnet_info *vi)
 {
 	int ret;
@@ -3006,6 +3085,8 @@ static int init_vqs(struct virtnet_info *vi)
 	if (ret)
 		goto err_free;
 
+	virtnet_create_page_pools(vi);
+
 	cpus_read_lock();
 	virtnet_set_affinity(vi);
 	cpus_read_unlock();
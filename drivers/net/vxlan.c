@@ -15,6 +15,7 @@
 #include <linux/igmp.h>
 #include <linux/if_ether.h>
 #include <linux/ethtool.h>
+#include <linux/rhashtable.h>
 #include <net/arp.h>
 #include <net/ndisc.h>
 #include <net/ipv6_stubs.h>
@@ -72,6 +73,7 @@ struct vxlan_net {
 /* Forwarding table entry */
 struct vxlan_fdb {
 	struct hlist_node hlist;	/* linked list of entries */
+	struct rhash_head rhnode;	/* lookup by mac and vni */
 	struct rcu_head	  rcu;
 	unsigned long	  updated;	/* jiffies */
 	unsigned long	  used;
@@ -515,25 +517,74 @@ static inline struct hlist_head *vxlan_fdb_head(struct vxlan_dev *vxlan,
 	return &vxlan->fdb_head[fdb_head_index(vxlan, mac, vni)];
 }
 
+/* The fdb_head chains are only used to walk the forwarding table, lookups go
+ * through an rhashtable that grows with the number of entries. The vni is
+ * only part of the key with VXLAN_F_COLLECT_METADATA.
+ */
+struct vxlan_fdb_key {
+	const u8	*mac;
+	__be32		vni;
+};
+
+static __be32 vxlan_fdb_key_vni(const struct vxlan_dev *vxlan, __be32 vni)
+{
+	return vxlan->cfg.flags & VXLAN_F_COLLECT_METADATA ? vni : 0;
+}
+
+static u32 vxlan_fdb_key_hash(const u8 *mac, __be32 vni, u32 seed)
+{
+	return jhash_3words(get_unaligned((u16 *)mac),
+			    get_unaligned((u32 *)(mac + 2)),
+			    (__force u32)vni, seed);
+}
+
+static u32 vxlan_fdb_hashfn(const void *data, u32 len, u32 seed)
+{
+	const struct vxlan_fdb_key *key = data;
+
+	return vxlan_fdb_key_hash(key->mac, key->vni, seed);
+}
+
+static u32 vxlan_fdb_obj_hashfn(const void *data, u32 len, u32 seed)
+{
+	const struct vxlan_fdb *f = data;
+	const struct vxlan_dev *vxlan = rcu_dereference_raw(f->vdev);
+
+	return vxlan_fdb_key_hash(f->eth_addr,
+				  vxlan_fdb_key_vni(vxlan, f->vni), seed);
+}
+
+static int vxlan_fdb_obj_cmpfn(struct rhashtable_compare_arg *arg,
+			       const void *obj)
+{
+	const struct vxlan_fdb_key *key = arg->key;
+	const struct vxlan_fdb *f = obj;
+	const struct vxlan_dev *vxlan = rcu_dereference_raw(f->vdev);
+
+	return !ether_addr_equal(key->mac, f->eth_addr) ||
+	       key->vni != vxlan_fdb_key_vni(vxlan, f->vni);
+}
+
+static const struct rhashtable_params vxlan_fdb_rht_params = {
+	.head_offset = offsetof(struct vxlan_fdb, rhnode),
+	.key_len = sizeof(struct vxlan_fdb_key),
+	.hashfn = vxlan_fdb_hashfn,
+	.obj_hashfn = vxlan_fdb_obj_hashfn,
+	.obj_cmpfn = vxlan_fdb_obj_cmpfn,
+	.automatic_shrinking = true,
+};
+
 /* Look up Ethernet address in forwarding table */
 static struct vxlan_fdb *__vxlan_find_mac(struct vxlan_dev *vxlan,
 					  const u8 *mac, __be32 vni)
 {
-	struct hlist_head *head = vxlan_fdb_head(vxlan, mac, vni);
-	struct vxlan_fdb *f;
-
-	hlist_for_each_entry_rcu(f, head, hlist) {
-		if (ether_addr_equal(mac, f->eth_addr)) {
-			if (vxlan->cfg.flags & VXLAN_F_COLLECT_METADATA) {
-				if (vni == f->vni)
-					return f;
-			} else {
-				return f;
-			}
-		}
-	}
+	struct vxlan_fdb_key key = {
+		.mac = mac,
+		.vni = vxlan_fdb_key_vni(vxlan, vni),
+	};
 
-	return NULL;
+	return rhashtable_lookup_fast(&vxlan->fdb_hash_tbl, &key,
+				      vxlan_fdb_rht_params);
 }
 
 static struct vxlan_fdb *vxlan_find_mac(struct vxlan_dev *vxlan,
@@ -847,12 +898,20 @@ static struct vxlan_fdb *vxlan_fdb_alloc(struct vxlan_dev *vxlan, const u8 *mac,
 	return f;
 }
 
-static void vxlan_fdb_insert(struct vxlan_dev *vxlan, const u8 *mac,
-			     __be32 src_vni, struct vxlan_fdb *f)
+static int vxlan_fdb_insert(struct vxlan_dev *vxlan, const u8 *mac,
+			    __be32 src_vni, struct vxlan_fdb *f)
 {
+	int err;
+
+	err = rhashtable_insert_fast(&vxlan->fdb_hash_tbl, &f->rhnode,
+				     vxlan_fdb_rht_params);
+	if (err)
+		return err;
+
 	++vxlan->addrcnt;
 	hlist_add_head_rcu(&f->hlist,
 			   vxlan_fdb_head(vxlan, mac, src_vni));
+	return 0;
 }
 
 static int vxlan_fdb_nh_update(struct vxlan_dev *vxlan, struct vxlan_fdb *fdb,
@@ -999,6 +1058,8 @@ static void vxlan_fdb_destroy(struct vxlan_dev *vxlan, struct vxlan_fdb *f,
 						 swdev_notify, NULL);
 	}
 
+	rhashtable_remove_fast(&vxlan->fdb_hash_tbl, &f->rhnode,
+			       vxlan_fdb_rht_params);
 	hlist_del_rcu(&f->hlist);
 	list_del_rcu(&f->nh_list);
 	call_rcu(&f->rcu, vxlan_fdb_free);
@@ -1135,7 +1196,16 @@ static int vxlan_fdb_update_create(struct vxlan_dev *vxlan,
 	if (rc < 0)
 		return rc;
 
-	vxlan_fdb_insert(vxlan, mac, src_vni, f);
+	rc = vxlan_fdb_insert(vxlan, mac, src_vni, f);
+	if (rc) {
+		/* Like vxlan_fdb_destroy(): the nexthop's fdb_list is walked
+		 * under RCU, so the entry may only go after a grace period.
+		 */
+		list_del_rcu(&f->nh_list);
+		call_rcu(&f->rcu, vxlan_fdb_free);
+		return rc;
+	}
+
 	rc = vxlan_fdb_notify(vxlan, f, first_remote_rtnl(f), RTM_NEWNEIGH,
 			      swdev_notify, extack);
 	if (rc)
@@ -1455,6 +1525,56 @@ static int vxlan_fdb_get(struct sk_buff *skb,
 	return err;
 }
 
+/* Learn a new entry from the datapath. The entry is allocated and set up
+ * before hash_lock is taken and announced after it is dropped, so the lock
+ * only covers the duplicate check and linking the entry in. A learning
+ * storm then mostly costs GFP_ATOMIC allocations and netlink notifications
+ * on the CPUs that take the packets, not bucket lock hold time.
+ */
+static void vxlan_fdb_learn(struct vxlan_dev *vxlan, const u8 *mac,
+			    union vxlan_addr *ip, __be32 vni, u32 ifindex)
+{
+	u32 hash_index = fdb_head_index(vxlan, mac, vni);
+	struct vxlan_fdb *f;
+	int rc;
+
+	rc = vxlan_fdb_create(vxlan, mac, ip, NUD_REACHABLE,
+			      vxlan->cfg.dst_port, vni,
+			      vxlan->default_dst.remote_vni, ifindex, NTF_SELF,
+			      0, &f, NULL);
+	if (rc < 0)
+		return;
+
+	spin_lock(&vxlan->hash_lock[hash_index]);
+	/* close off race between vxlan_flush and incoming packets, and
+	 * between concurrent learners of the same address
+	 */
+	if (!netif_running(vxlan->dev) || __vxlan_find_mac(vxlan, mac, vni))
+		rc = -EEXIST;
+	else
+		rc = vxlan_fdb_insert(vxlan, mac, vni, f);
+	spin_unlock(&vxlan->hash_lock[hash_index]);
+
+	if (rc) {
+		/* never published */
+		__vxlan_fdb_free(f);
+		return;
+	}
+
+	/* We are in the rx path under RCU, a racing delete can only free the
+	 * entry after this. If a switchdev driver refuses the entry, drop it
+	 * again as vxlan_fdb_update_create() does.
+	 */
+	rc = vxlan_fdb_notify(vxlan, f, first_remote_rcu(f), RTM_NEWNEIGH,
+			      true, NULL);
+	if (rc) {
+		spin_lock(&vxlan->hash_lock[hash_index]);
+		if (__vxlan_find_mac(vxlan, mac, vni) == f)
+			vxlan_fdb_destroy(vxlan, f, false, false);
+		spin_unlock(&vxlan->hash_lock[hash_index]);
+	}
+}
+
 /* Watch incoming packets to learn mapping between Ethernet address
  * and Tunnel endpoint.
  * Return true if packet is bogus and should be dropped.
@@ -1498,21 +1618,8 @@ static bool vxlan_snoop(struct net_device *dev,
 		f->updated = jiffies;
 		vxlan_fdb_notify(vxlan, f, rdst, RTM_NEWNEIGH, true, NULL);
 	} else {
-		u32 hash_index = fdb_head_index(vxlan, src_mac, vni);
-
 		/* learned new entry */
-		spin_lock(&vxlan->hash_lock[hash_index]);
-
-		/* close off race between vxlan_flush and incoming packets */
-		if (netif_running(dev))
-			vxlan_fdb_update(vxlan, src_mac, src_ip,
-					 NUD_REACHABLE,
-					 NLM_F_EXCL|NLM_F_CREATE,
-					 vxlan->cfg.dst_port,
-					 vni,
-					 vxlan->default_dst.remote_vni,
-					 ifindex, NTF_SELF, 0, true, NULL);
-		spin_unlock(&vxlan->hash_lock[hash_index]);
+		vxlan_fdb_learn(vxlan, src_mac, src_ip, vni, ifindex);
 	}
 
 	return false;
@@ -3047,13 +3154,21 @@ static int vxlan_init(struct net_device *dev)
 	if (!dev->tstats)
 		return -ENOMEM;
 
+	err = rhashtable_init(&vxlan->fdb_hash_tbl, &vxlan_fdb_rht_params);
+	if (err)
+		goto err_free_percpu;
+
 	err = gro_cells_init(&vxlan->gro_cells, dev);
-	if (err) {
-		free_percpu(dev->tstats);
-		return err;
-	}
+	if (err)
+		goto err_rhashtable_destroy;
 
 	return 0;
+
+err_rhashtable_destroy:
+	rhashtable_destroy(&vxlan->fdb_hash_tbl);
+err_free_percpu:
+	free_percpu(dev->tstats);
+	return err;
 }
 
 static void vxlan_fdb_delete_default(struct vxlan_dev *vxlan, __be32 vni)
@@ -3076,6 +3191,7 @@ static void vxlan_uninit(struct net_device *dev)
 
 	vxlan_fdb_delete_default(vxlan, vxlan->cfg.vni);
 
+	rhashtable_destroy(&vxlan->fdb_hash_tbl);
 	free_percpu(dev->tstats);
 }
 
@@ -3911,7 +4027,9 @@ static int __vxlan_dev_create(struct net *net, struct net_device *dev,
 		goto unlink;
 
 	if (f) {
-		vxlan_fdb_insert(vxlan, all_zeros_mac, dst->remote_vni, f);
+		err = vxlan_fdb_insert(vxlan, all_zeros_mac, dst->remote_vni, f);
+		if (err)
+			goto unlink;
 
 		/* notify default fdb entry */
 		err = vxlan_fdb_notify(vxlan, f, first_remote_rtnl(f),
@@ -22,6 +22,7 @@
  */
 
 #include <linux/compat.h>
+#include <linux/completion.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/highmem.h>
@@ -62,6 +63,14 @@ module_param_named(dma_entry_limit, dma_entry_limit, uint, 0644);
 MODULE_PARM_DESC(dma_entry_limit,
 		 "Maximum number of user DMA mappings per container (65535).");
 
+static unsigned int prefault_threads __read_mostly;
+module_param_named(prefault_threads, prefault_threads, uint, 0644);
+MODULE_PARM_DESC(prefault_threads,
+		 "Number of workers faulting in large DMA mappings ahead of pinning (0 = disabled).");
+
+/* Mappings smaller than this per worker are not worth splitting up */
+#define VFIO_PREFAULT_MIN_CHUNK		SZ_1G
+
 struct vfio_iommu {
 	struct list_head	domain_list;
 	struct list_head	iova_list;
@@ -1495,6 +1504,111 @@ static int vfio_iommu_map(struct vfio_iommu *iommu, dma_addr_t iova,
 	return ret;
 }
 
+struct vfio_prefault_work {
+	struct work_struct	work;
+	struct mm_struct	*mm;
+	unsigned long		start;
+	unsigned long		end;
+	unsigned int		gup_flags;
+	bool			*abort;
+	atomic_t		*pending;
+	struct completion	*done;
+};
+
+static void vfio_prefault_fn(struct work_struct *work)
+{
+	struct vfio_prefault_work *pw =
+		container_of(work, struct vfio_prefault_work, work);
+	unsigned long addr = pw->start;
+	long ret;
+	int locked;
+
+	/*
+	 * The faults are taken on behalf of the caller, but it is the
+	 * caller that gets a fatal signal, so check its flag per chunk.
+	 */
+	while (addr < pw->end && !READ_ONCE(*pw->abort)) {
+		locked = 1;
+		mmap_read_lock(pw->mm);
+		ret = get_user_pages_remote(pw->mm, addr,
+					    min_t(unsigned long,
+						  (pw->end - addr) >> PAGE_SHIFT,
+						  PTRS_PER_PMD),
+					    pw->gup_flags, NULL, NULL, &locked);
+		if (locked)
+			mmap_read_unlock(pw->mm);
+		/* Errors are left for the pinning pass to report */
+		if (ret <= 0)
+			break;
+		addr += ret << PAGE_SHIFT;
+		cond_resched();
+	}
+
+	if (atomic_dec_and_test(pw->pending))
+		complete(pw->done);
+}
+
+/*
+ * Populating the memory behind a large mapping, typically zeroing guest
+ * memory that was never touched, dominates the time it takes to pin it.
+ * Fault the range in from several workers first, the pinning and mapping
+ * pass below then mostly finds the pages present.  The workers are kept
+ * on the node of the caller so that first touch places the memory where
+ * the single threaded path would have put it.
+ *
+ * Returns -EINTR if the caller was killed while waiting, after stopping
+ * the workers, which fault through current->mm.
+ */
+static int vfio_prefault_dma(struct vfio_dma *dma, unsigned long vaddr,
+			     size_t size)
+{
+	unsigned int i, nr = READ_ONCE(prefault_threads);
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct vfio_prefault_work *works;
+	unsigned long chunk;
+	bool abort = false;
+	atomic_t pending;
+	int ret = 0;
+
+	nr = min_t(size_t, nr, size / VFIO_PREFAULT_MIN_CHUNK);
+	if (nr < 2)
+		return 0;
+
+	works = kcalloc(nr, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return 0;
+
+	/* Keep the chunks huge page aligned */
+	chunk = ALIGN(DIV_ROUND_UP(size, nr), PMD_SIZE);
+	atomic_set(&pending, 1);
+
+	for (i = 0; i < nr && i * chunk < size; i++) {
+		struct vfio_prefault_work *pw = &works[i];
+
+		INIT_WORK(&pw->work, vfio_prefault_fn);
+		pw->mm = current->mm;
+		pw->start = vaddr + i * chunk;
+		pw->end = vaddr + min_t(size_t, (i + 1) * chunk, size);
+		pw->gup_flags = dma->prot & IOMMU_WRITE ? FOLL_WRITE : 0;
+		pw->abort = &abort;
+		pw->pending = &pending;
+		pw->done = &done;
+
+		atomic_inc(&pending);
+		queue_work_node(numa_node_id(), system_unbound_wq, &pw->work);
+	}
+
+	if (!atomic_dec_and_test(&pending) &&
+	    wait_for_completion_killable(&done)) {
+		WRITE_ONCE(abort, true);
+		wait_for_completion(&done);
+		ret = -EINTR;
+	}
+
+	kfree(works);
+	return ret;
+}
+
 static int vfio_pin_map_dma(struct vfio_iommu *iommu, struct vfio_dma *dma,
 			    size_t map_size)
 {
@@ -1508,7 +1622,9 @@ static int vfio_pin_map_dma(struct vfio_iommu *iommu, struct vfio_dma *dma,
 
 	vfio_batch_init(&batch);
 
-	while (size) {
+	ret = vfio_prefault_dma(dma, vaddr + dma->size, size);
+
+	while (!ret && size) {
 		/* Pin a contiguous chunk of memory */
 		npage = vfio_pin_pages_remote(dma, vaddr + dma->size,
 					      size >> PAGE_SHIFT, &pfn, limit,
@@ -187,12 +187,14 @@ EXPORT_SYMBOL_GPL(vhost_work_init);
 
 /* Init poll structure */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -231,18 +233,44 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_work_dev_flush(struct vhost_dev *dev)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!worker->task)
+		return;
+
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
+	if (worker->task) {
 		init_completion(&flush.wait_event);
 		vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
+		vhost_worker_queue(worker, &flush.work);
 		wait_for_completion(&flush.wait_event);
 	}
 }
+
+void vhost_work_dev_flush(struct vhost_dev *dev)
+{
+	int i;
+
+	vhost_worker_flush(&dev->worker);
+	if (dev->vq_workers)
+		for (i = 0; i < dev->nvqs; ++i)
+			vhost_worker_flush(&dev->vq_workers[i]);
+}
 EXPORT_SYMBOL_GPL(vhost_work_dev_flush);
 
 /* Flush any work that has been scheduled. When calling this, don't hold any
@@ -255,30 +283,36 @@ EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
-	if (!dev->worker)
-		return;
-
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(&dev->worker, work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	vhost_worker_queue(vq->worker, work);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
-	return !llist_empty(&dev->work_list);
+	return !llist_empty(&dev->worker.work_list);
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+/* Same for the worker that runs @vq */
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	return !llist_empty(&vq->worker->work_list);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -343,7 +377,8 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
+	struct vhost_dev *dev = worker->dev;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
 
@@ -358,7 +393,7 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
+		node = llist_del_all(&worker->work_list);
 		if (!node)
 			schedule();
 
@@ -481,13 +516,16 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->umem = NULL;
 	dev->iotlb = NULL;
 	dev->mm = NULL;
-	dev->worker = NULL;
+	dev->worker.task = NULL;
+	dev->worker.dev = dev;
+	init_llist_head(&dev->worker.work_list);
+	dev->vq_workers = NULL;
+	dev->worker_per_vq = false;
 	dev->iov_limit = iov_limit;
 	dev->weight = weight;
 	dev->byte_weight = byte_weight;
 	dev->use_worker = use_worker;
 	dev->msg_handler = msg_handler;
-	init_llist_head(&dev->work_list);
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -500,11 +538,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		vq->worker = &dev->worker;
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -531,17 +570,95 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 	s->ret = cgroup_attach_task_all(s->owner, current);
 }
 
-static int vhost_attach_cgroups(struct vhost_dev *dev)
+static int vhost_attach_cgroups(struct vhost_worker *worker)
 {
 	struct vhost_attach_cgroups_struct attach;
 
 	attach.owner = current;
 	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_dev_flush(dev);
+	vhost_worker_queue(worker, &attach.work);
+	vhost_worker_flush(worker);
 	return attach.ret;
 }
 
+static int vhost_worker_create(struct vhost_worker *worker,
+			       struct vhost_dev *dev, int index)
+{
+	struct task_struct *task;
+	int err;
+
+	worker->dev = dev;
+	init_llist_head(&worker->work_list);
+
+	if (index < 0)
+		task = kthread_create(vhost_worker, worker,
+				      "vhost-%d", current->pid);
+	else
+		task = kthread_create(vhost_worker, worker,
+				      "vhost-%d-%d", current->pid, index);
+	if (IS_ERR(task))
+		return PTR_ERR(task);
+
+	worker->task = task;
+	wake_up_process(task); /* avoid contributing to loadavg */
+
+	err = vhost_attach_cgroups(worker);
+	if (err) {
+		kthread_stop(task);
+		worker->task = NULL;
+	}
+	return err;
+}
+
+static void vhost_workers_free(struct vhost_dev *dev)
+{
+	int i;
+
+	if (dev->vq_workers) {
+		for (i = 0; i < dev->nvqs; ++i) {
+			dev->vqs[i]->worker = &dev->worker;
+			if (dev->vq_workers[i].task)
+				kthread_stop(dev->vq_workers[i].task);
+		}
+		kfree(dev->vq_workers);
+		dev->vq_workers = NULL;
+	}
+
+	if (dev->worker.task) {
+		kthread_stop(dev->worker.task);
+		dev->worker.task = NULL;
+	}
+}
+
+/* The default worker runs device wide work, such as vhost_work_queue() */
+static int vhost_workers_create(struct vhost_dev *dev)
+{
+	int i, err;
+
+	err = vhost_worker_create(&dev->worker, dev, -1);
+	if (err || !dev->worker_per_vq)
+		return err;
+
+	dev->vq_workers = kcalloc(dev->nvqs, sizeof(*dev->vq_workers),
+				  GFP_KERNEL);
+	if (!dev->vq_workers) {
+		err = -ENOMEM;
+		goto err;
+	}
+
+	for (i = 0; i < dev->nvqs; ++i) {
+		err = vhost_worker_create(&dev->vq_workers[i], dev, i);
+		if (err)
+			goto err;
+		dev->vqs[i]->worker = &dev->vq_workers[i];
+	}
+
+	return 0;
+err:
+	vhost_workers_free(dev);
+	return err;
+}
+
 /* Caller should have device mutex */
 bool vhost_dev_has_owner(struct vhost_dev *dev)
 {
@@ -582,7 +699,6 @@ static void vhost_detach_mm(struct vhost_dev *dev)
 /* Caller should have device mutex */
 long vhost_dev_set_owner(struct vhost_dev *dev)
 {
-	struct task_struct *worker;
 	int err;
 
 	/* Is there an owner already? */
@@ -595,19 +711,9 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	dev->kcov_handle = kcov_common_handle();
 	if (dev->use_worker) {
-		worker = kthread_create(vhost_worker, dev,
-					"vhost-%d", current->pid);
-		if (IS_ERR(worker)) {
-			err = PTR_ERR(worker);
-			goto err_worker;
-		}
-
-		dev->worker = worker;
-		wake_up_process(worker); /* avoid contributing to loadavg */
-
-		err = vhost_attach_cgroups(dev);
+		err = vhost_workers_create(dev);
 		if (err)
-			goto err_cgroup;
+			goto err_worker;
 	}
 
 	err = vhost_dev_alloc_iovecs(dev);
@@ -616,10 +722,7 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	return 0;
 err_cgroup:
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+	vhost_workers_free(dev);
 err_worker:
 	vhost_detach_mm(dev);
 	dev->kcov_handle = 0;
@@ -712,10 +815,9 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
+	WARN_ON(!llist_empty(&dev->worker.work_list));
+	if (dev->worker.task) {
+		vhost_workers_free(dev);
 		dev->kcov_handle = 0;
 	}
 	vhost_detach_mm(dev);
@@ -986,6 +986,9 @@ static void btrfs_init_workspace_manager(int type)
 	atomic_set(&wsm->total_ws, 0);
 	init_waitqueue_head(&wsm->ws_wait);
 
+	/* Without the per-cpu cache everything goes through idle_ws */
+	wsm->cached_ws = alloc_percpu(struct list_head *);
+
 	/*
 	 * Preallocate one workspace for each compression type so we can
 	 * guarantee forward progress in the worst case
@@ -1001,12 +1004,38 @@ static void btrfs_init_workspace_manager(int type)
 	}
 }
 
+/*
+ * Move the workspaces cached on all CPUs back to the idle list. Called with
+ * ws_lock held.
+ */
+static void drain_cached_workspaces(struct workspace_manager *wsm)
+{
+	struct list_head *ws;
+	int cpu;
+
+	if (!wsm->cached_ws)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		ws = xchg(per_cpu_ptr(wsm->cached_ws, cpu), NULL);
+		if (!ws)
+			continue;
+		list_add(ws, &wsm->idle_ws);
+		wsm->free_ws++;
+	}
+}
+
 static void btrfs_cleanup_workspace_manager(int type)
 {
 	struct workspace_manager *wsman;
 	struct list_head *ws;
 
 	wsman = btrfs_compress_op[type]->workspace_manager;
+	spin_lock(&wsman->ws_lock);
+	drain_cached_workspaces(wsman);
+	spin_unlock(&wsman->ws_lock);
+	free_percpu(wsman->cached_ws);
+	wsman->cached_ws = NULL;
 	while (!list_empty(&wsman->idle_ws)) {
 		ws = wsman->idle_ws.next;
 		list_del(ws);
@@ -1040,6 +1069,12 @@ struct list_head *btrfs_get_workspace(int type, unsigned int level)
 	ws_wait	 = &wsm->ws_wait;
 	free_ws	 = &wsm->free_ws;
 
+	if (wsm->cached_ws) {
+		workspace = this_cpu_xchg(*wsm->cached_ws, NULL);
+		if (workspace)
+			return workspace;
+	}
+
 again:
 	spin_lock(ws_lock);
 	if (!list_empty(idle_ws)) {
@@ -1055,6 +1090,14 @@ struct list_head *btrfs_get_workspace(int type, unsigned int level)
 
 		spin_unlock(ws_lock);
 		prepare_to_wait(ws_wait, &wait, TASK_UNINTERRUPTIBLE);
+		/*
+		 * Workspaces idle in the per-cpu caches are only handed out on
+		 * their own CPU, move them where we can see them. This is done
+		 * after queueing ourselves, see btrfs_put_workspace().
+		 */
+		spin_lock(ws_lock);
+		drain_cached_workspaces(wsm);
+		spin_unlock(ws_lock);
 		if (atomic_read(total_ws) > cpus && !*free_ws)
 			schedule();
 		finish_wait(ws_wait, &wait);
@@ -1136,6 +1179,19 @@ void btrfs_put_workspace(int type, struct list_head *ws)
 	ws_wait	 = &wsm->ws_wait;
 	free_ws	 = &wsm->free_ws;
 
+	/*
+	 * Keep it cached on this CPU unless somebody is waiting for a
+	 * workspace. Waiters queue themselves before draining the caches, so
+	 * either they find it there or we see them here.
+	 */
+	if (wsm->cached_ws && !this_cpu_cmpxchg(*wsm->cached_ws, NULL, ws)) {
+		if (!wq_has_sleeper(ws_wait))
+			return;
+		ws = this_cpu_xchg(*wsm->cached_ws, NULL);
+		if (!ws)
+			return;
+	}
+
 	spin_lock(ws_lock);
 	if (*free_ws <= num_online_cpus()) {
 		list_add(ws, idle_ws);
@@ -1209,16 +1265,28 @@ int btrfs_compress_pages(unsigned int type_level, struct address_space *mapping,
 			 unsigned long *total_in,
 			 unsigned long *total_out)
 {
+	struct btrfs_fs_info *fs_info = btrfs_sb(mapping->host->i_sb);
 	int type = btrfs_compress_type(type_level);
 	int level = btrfs_compress_level(type_level);
+	struct btrfs_compress_stats *stats = &fs_info->compress_stats[type];
 	struct list_head *workspace;
+	u64 start_ns;
 	int ret;
 
 	level = btrfs_compress_set_level(type, level);
 	workspace = get_workspace(type, level);
+	start_ns = ktime_get_ns();
 	ret = compression_compress_pages(type, workspace, mapping, start, pages,
 					 out_pages, total_in, total_out);
+	atomic64_add(ktime_get_ns() - start_ns, &stats->nsecs);
 	put_workspace(type, workspace);
+
+	if (ret) {
+		atomic64_inc(&stats->nr_incompressible);
+	} else {
+		atomic64_add(*total_in, &stats->in_bytes);
+		atomic64_add(*total_out, &stats->out_bytes);
+	}
 	return ret;
 }
 
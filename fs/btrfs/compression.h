@@ -109,7 +109,23 @@ enum btrfs_compression_type {
 	BTRFS_NR_COMPRESS_TYPES = 4,
 };
 
+/* Per-fs statistics of each compression type, exported via sysfs */
+struct btrfs_compress_stats {
+	/* Bytes fed to the compressor and compressed bytes it produced */
+	atomic64_t in_bytes;
+	atomic64_t out_bytes;
+	/* Time spent compressing in ns */
+	atomic64_t nsecs;
+	/* Number of ranges that didn't compress */
+	atomic64_t nr_incompressible;
+};
+
 struct workspace_manager {
+	/*
+	 * One idle workspace cached per CPU, so back to back compressions on a
+	 * CPU don't need to take ws_lock. Not counted in free_ws.
+	 */
+	struct list_head * __percpu *cached_ws;
 	struct list_head idle_ws;
 	spinlock_t ws_lock;
 	/* Number of free workspaces */
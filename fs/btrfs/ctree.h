@@ -34,6 +34,7 @@
 #include "async-thread.h"
 #include "block-rsv.h"
 #include "locking.h"
+#include "compression.h"
 
 struct btrfs_trans_handle;
 struct btrfs_transaction;
@@ -609,6 +610,24 @@ enum btrfs_exclusive_operation {
 	BTRFS_EXCLOP_SWAP_ACTIVATE,
 };
 
+/* Store data about transaction commits, exported via sysfs. */
+struct btrfs_commit_stats {
+	/* Total number of commits */
+	u64 commit_count;
+	/* The maximum commit duration so far in ns */
+	u64 max_commit_dur;
+	/* The last commit duration in ns */
+	u64 last_commit_dur;
+	/* The total commit duration in ns */
+	u64 total_commit_dur;
+	/* Time the last commit spent running delayed refs in ns */
+	u64 last_delayed_refs_dur;
+	/* Total time commits spent running delayed refs in ns */
+	u64 total_delayed_refs_dur;
+	/* Total time spent running delayed refs in the background in ns */
+	u64 async_delayed_refs_dur;
+};
+
 struct btrfs_fs_info {
 	u8 chunk_tree_uuid[BTRFS_UUID_SIZE];
 	unsigned long flags;
@@ -975,6 +994,19 @@ struct btrfs_fs_info {
 	struct list_head reclaim_bgs;
 	int bg_reclaim_threshold;
 
+	/*
+	 * Run delayed refs in the background once the queued ones are
+	 * estimated to take longer than delayed_refs_async_ms to run, so the
+	 * commit is left with less to do.  0 disables it.
+	 */
+	struct work_struct async_delayed_refs_work;
+	int delayed_refs_async_ms;
+
+	/* Updated at the end of each commit, protected by trans_lock */
+	struct btrfs_commit_stats commit_stats;
+
+	struct btrfs_compress_stats compress_stats[BTRFS_NR_COMPRESS_TYPES];
+
 	spinlock_t unused_bgs_lock;
 	struct list_head unused_bgs;
 	struct mutex unused_bg_unpin_mutex;
@@ -2701,6 +2733,7 @@ static inline u64 btrfs_calc_metadata_size(struct btrfs_fs_info *fs_info,
 int btrfs_add_excluded_extent(struct btrfs_fs_info *fs_info,
 			      u64 start, u64 num_bytes);
 void btrfs_free_excluded_extents(struct btrfs_block_group *cache);
+void btrfs_async_run_delayed_refs(struct work_struct *work);
 int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 			   unsigned long count);
 void btrfs_cleanup_ref_head_accounting(struct btrfs_fs_info *fs_info,
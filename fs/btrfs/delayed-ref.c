@@ -51,6 +51,18 @@ bool btrfs_check_space_for_delayed_refs(struct btrfs_fs_info *fs_info)
 	return ret;
 }
 
+/*
+ * Estimate how long running all the delayed refs queued in @cur_trans would
+ * take, in ns, based on the average runtime of the refs run so far.
+ */
+u64 btrfs_delayed_refs_runtime(struct btrfs_transaction *cur_trans)
+{
+	struct btrfs_fs_info *fs_info = cur_trans->fs_info;
+	u64 num_entries = atomic_read(&cur_trans->delayed_refs.num_entries);
+
+	return num_entries * READ_ONCE(fs_info->avg_delayed_ref_runtime);
+}
+
 int btrfs_should_throttle_delayed_refs(struct btrfs_trans_handle *trans)
 {
 	u64 num_entries =
@@ -135,6 +135,9 @@ struct btrfs_delayed_data_ref {
 	u64 offset;
 };
 
+/* Default latency target for running delayed refs in the background */
+#define BTRFS_DEFAULT_DELAYED_REFS_ASYNC_MS	500
+
 enum btrfs_delayed_ref_flags {
 	/* Indicate that we are flushing delayed refs for the commit */
 	BTRFS_DELAYED_REFS_FLUSHING,
@@ -381,6 +384,7 @@ void btrfs_migrate_to_delayed_refs_rsv(struct btrfs_fs_info *fs_info,
 				       struct btrfs_block_rsv *src,
 				       u64 num_bytes);
 int btrfs_should_throttle_delayed_refs(struct btrfs_trans_handle *trans);
+u64 btrfs_delayed_refs_runtime(struct btrfs_transaction *cur_trans);
 bool btrfs_check_space_for_delayed_refs(struct btrfs_fs_info *fs_info);
 
 /*
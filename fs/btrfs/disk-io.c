@@ -2931,6 +2931,10 @@ void btrfs_init_fs_info(struct btrfs_fs_info *fs_info)
 
 	fs_info->bg_reclaim_threshold = BTRFS_DEFAULT_RECLAIM_THRESH;
 	INIT_WORK(&fs_info->reclaim_bgs_work, btrfs_reclaim_bgs_work);
+
+	fs_info->delayed_refs_async_ms = BTRFS_DEFAULT_DELAYED_REFS_ASYNC_MS;
+	INIT_WORK(&fs_info->async_delayed_refs_work,
+		  btrfs_async_run_delayed_refs);
 }
 
 static int init_mount_fs_info(struct btrfs_fs_info *fs_info, struct super_block *sb)
@@ -4318,6 +4322,7 @@ void __cold close_ctree(struct btrfs_fs_info *fs_info)
 	 * trying to stop the async reclaim task.
 	 */
 	cancel_work_sync(&fs_info->reclaim_bgs_work);
+	cancel_work_sync(&fs_info->async_delayed_refs_work);
 	/*
 	 * We don't want the cleaner to start new transactions, add more delayed
 	 * iputs, etc. while we're closing. We can't use kthread_stop() yet
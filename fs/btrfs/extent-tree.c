@@ -2126,6 +2126,7 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	struct rb_node *node;
 	struct btrfs_delayed_ref_root *delayed_refs;
 	struct btrfs_delayed_ref_head *head;
+	u64 start_ns;
 	int ret;
 	int run_all = count == (unsigned long)-1;
 
@@ -2140,6 +2141,7 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	if (count == 0)
 		count = delayed_refs->num_heads_ready;
 
+	start_ns = ktime_get_ns();
 again:
 #ifdef SCRAMBLE_DELAYED_REFS
 	delayed_refs->run_delayed_start = find_middle(&delayed_refs->root);
@@ -2147,7 +2149,7 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	ret = __btrfs_run_delayed_refs(trans, count);
 	if (ret < 0) {
 		btrfs_abort_transaction(trans, ret);
-		return ret;
+		goto out;
 	}
 
 	if (run_all) {
@@ -2173,7 +2175,70 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 		goto again;
 	}
 out:
-	return 0;
+	/*
+	 * Account the time spent by the commit separately, for the commit
+	 * stats.  That includes the first pass through the refs done by the
+	 * committer before the commit starts.
+	 */
+	if (trans->transaction->state >= TRANS_STATE_COMMIT_START ||
+	    test_bit(BTRFS_DELAYED_REFS_FLUSHING, &delayed_refs->flags))
+		atomic64_add(ktime_get_ns() - start_ns,
+			     &trans->transaction->delayed_refs_commit_dur);
+	return ret;
+}
+
+/*
+ * Delayed refs run in the background in batches of this many heads, so that
+ * a commit waiting on the handle the background run holds doesn't wait long.
+ */
+#define BTRFS_DELAYED_REFS_ASYNC_BATCH		64
+
+/*
+ * Run delayed refs of the running transaction in the background, until the
+ * remaining ones are estimated to take less than half the delayed_refs_async_ms
+ * latency target to run, the commit starts, or we have been at it for the
+ * length of the target.  Queued by btrfs_end_transaction().
+ */
+void btrfs_async_run_delayed_refs(struct work_struct *work)
+{
+	struct btrfs_fs_info *fs_info = container_of(work, struct btrfs_fs_info,
+						     async_delayed_refs_work);
+	struct btrfs_trans_handle *trans;
+	struct btrfs_transaction *cur_trans;
+	u64 target;
+	u64 start_ns;
+	int ret;
+
+	target = (u64)READ_ONCE(fs_info->delayed_refs_async_ms) * NSEC_PER_MSEC;
+	if (!target || btrfs_fs_closing(fs_info))
+		return;
+
+	/* Never start a new transaction just for this */
+	trans = btrfs_attach_transaction(fs_info->extent_root);
+	if (IS_ERR(trans))
+		return;
+
+	cur_trans = trans->transaction;
+	start_ns = ktime_get_ns();
+	do {
+		if (READ_ONCE(cur_trans->state) >= TRANS_STATE_COMMIT_START ||
+		    test_bit(BTRFS_DELAYED_REFS_FLUSHING,
+			     &cur_trans->delayed_refs.flags))
+			break;
+
+		ret = btrfs_run_delayed_refs(trans,
+					     BTRFS_DELAYED_REFS_ASYNC_BATCH);
+		if (ret)
+			break;
+		cond_resched();
+	} while (btrfs_delayed_refs_runtime(cur_trans) > target / 2 &&
+		 ktime_get_ns() - start_ns < target);
+
+	spin_lock(&fs_info->trans_lock);
+	fs_info->commit_stats.async_delayed_refs_dur += ktime_get_ns() - start_ns;
+	spin_unlock(&fs_info->trans_lock);
+
+	btrfs_end_transaction(trans);
 }
 
 int btrfs_set_disk_extent_flags(struct btrfs_trans_handle *trans,
@@ -610,6 +610,98 @@ int btrfs_lookup_csums_range(struct btrfs_root *root, u64 start, u64 end,
 	return ret;
 }
 
+/*
+ * Bios of at least BTRFS_CSUM_PARALLEL_BYTES have their checksums computed by
+ * up to one worker per online CPU, each grabbing BTRFS_CSUM_CHUNK_BYTES worth
+ * of sectors at a time.
+ */
+#define BTRFS_CSUM_CHUNK_BYTES		SZ_128K
+#define BTRFS_CSUM_PARALLEL_BYTES	(4 * BTRFS_CSUM_CHUNK_BYTES)
+
+struct btrfs_csum_sector {
+	struct page *page;
+	unsigned int offset;
+	u8 *csum;
+};
+
+struct btrfs_csum_job {
+	struct btrfs_fs_info *fs_info;
+	struct btrfs_csum_sector *sectors;
+	int nr_sectors;
+	int chunk_sectors;
+	atomic_t next;
+};
+
+struct btrfs_csum_worker {
+	struct work_struct work;
+	struct btrfs_csum_job *job;
+};
+
+static void csum_job_run(struct btrfs_csum_job *job)
+{
+	struct btrfs_fs_info *fs_info = job->fs_info;
+	SHASH_DESC_ON_STACK(shash, fs_info->csum_shash);
+	int start;
+	int i;
+
+	shash->tfm = fs_info->csum_shash;
+	while ((start = atomic_fetch_add(job->chunk_sectors, &job->next)) <
+	       job->nr_sectors) {
+		int end = min(start + job->chunk_sectors, job->nr_sectors);
+
+		for (i = start; i < end; i++) {
+			struct btrfs_csum_sector *sector = &job->sectors[i];
+			char *data;
+
+			data = kmap_atomic(sector->page);
+			crypto_shash_digest(shash, data + sector->offset,
+					    fs_info->sectorsize, sector->csum);
+			kunmap_atomic(data);
+		}
+	}
+}
+
+static void csum_worker_fn(struct work_struct *work)
+{
+	struct btrfs_csum_worker *worker;
+
+	worker = container_of(work, struct btrfs_csum_worker, work);
+	csum_job_run(worker->job);
+}
+
+/*
+ * Compute all the checksums of @job, with the help of workers on other CPUs.
+ *
+ * The caller works through the chunks itself as well, so the job completes
+ * even if none of the workers gets to run, e.g. under memory pressure. Once the
+ * caller runs out of chunks, workers that haven't started yet are cancelled and
+ * the ones still hashing their last chunk are waited for.
+ */
+static void csum_job_run_parallel(struct btrfs_csum_job *job)
+{
+	struct btrfs_csum_worker *workers = NULL;
+	int nr_chunks = DIV_ROUND_UP(job->nr_sectors, job->chunk_sectors);
+	int nr_workers = min_t(int, nr_chunks, num_online_cpus()) - 1;
+	int i;
+
+	if (nr_workers > 0)
+		workers = kmalloc_array(nr_workers, sizeof(*workers), GFP_NOFS);
+	if (!workers)
+		nr_workers = 0;
+
+	for (i = 0; i < nr_workers; i++) {
+		INIT_WORK(&workers[i].work, csum_worker_fn);
+		workers[i].job = job;
+		queue_work(system_unbound_wq, &workers[i].work);
+	}
+
+	csum_job_run(job);
+
+	for (i = 0; i < nr_workers; i++)
+		cancel_work_sync(&workers[i].work);
+	kfree(workers);
+}
+
 /*
  * btrfs_csum_one_bio - Calculates checksums of the data contained inside a bio
  * @inode:	 Owner of the data inside the bio
@@ -627,6 +719,7 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 	SHASH_DESC_ON_STACK(shash, fs_info->csum_shash);
 	struct btrfs_ordered_sum *sums;
 	struct btrfs_ordered_extent *ordered = NULL;
+	struct btrfs_csum_job job = { .fs_info = fs_info };
 	char *data;
 	struct bvec_iter iter;
 	struct bio_vec bvec;
@@ -659,6 +752,22 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 
 	shash->tfm = fs_info->csum_shash;
 
+	/*
+	 * For large bios only record where each checksum comes from and goes
+	 * to here, the hashing is then spread over several CPUs once the sums
+	 * are set up. Fall back to hashing inline if that can't be allocated.
+	 */
+	if (bio->bi_iter.bi_size >= BTRFS_CSUM_PARALLEL_BYTES) {
+		job.nr_sectors = bio->bi_iter.bi_size >> fs_info->sectorsize_bits;
+		job.chunk_sectors = BTRFS_CSUM_CHUNK_BYTES >>
+				    fs_info->sectorsize_bits;
+		nofs_flag = memalloc_nofs_save();
+		job.sectors = kvmalloc_array(job.nr_sectors,
+					     sizeof(*job.sectors), GFP_KERNEL);
+		memalloc_nofs_restore(nofs_flag);
+		job.nr_sectors = 0;
+	}
+
 	bio_for_each_segment(bvec, bio, iter) {
 		if (!contig)
 			offset = page_offset(bvec.bv_page) + bvec.bv_offset;
@@ -674,6 +783,7 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 			"no ordered extent for root %llu ino %llu offset %llu\n",
 				     inode->root->root_key.objectid,
 				     btrfs_ino(inode), offset);
+				kvfree(job.sectors);
 				kvfree(sums);
 				return BLK_STS_IOERR;
 			}
@@ -709,12 +819,22 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 				index = 0;
 			}
 
-			data = kmap_atomic(bvec.bv_page);
-			crypto_shash_digest(shash, data + bvec.bv_offset
-					    + (i * fs_info->sectorsize),
-					    fs_info->sectorsize,
-					    sums->sums + index);
-			kunmap_atomic(data);
+			if (job.sectors) {
+				struct btrfs_csum_sector *sector;
+
+				sector = &job.sectors[job.nr_sectors++];
+				sector->page = bvec.bv_page;
+				sector->offset = bvec.bv_offset +
+						 (i * fs_info->sectorsize);
+				sector->csum = sums->sums + index;
+			} else {
+				data = kmap_atomic(bvec.bv_page);
+				crypto_shash_digest(shash, data + bvec.bv_offset
+						    + (i * fs_info->sectorsize),
+						    fs_info->sectorsize,
+						    sums->sums + index);
+				kunmap_atomic(data);
+			}
 			index += fs_info->csum_size;
 			offset += fs_info->sectorsize;
 			this_sum_bytes += fs_info->sectorsize;
@@ -722,6 +842,16 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 		}
 
 	}
+
+	/*
+	 * The ordered extents can't complete before this bio has been written,
+	 * so the sums attached to them so far stay around until we're done.
+	 */
+	if (job.sectors) {
+		csum_job_run_parallel(&job);
+		kvfree(job.sectors);
+	}
+
 	this_sum_bytes = 0;
 	btrfs_add_ordered_sum(ordered, sums);
 	btrfs_put_ordered_extent(ordered);
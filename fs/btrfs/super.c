@@ -1980,6 +1980,7 @@ static int btrfs_remount(struct super_block *sb, int *flags, char *data)
 		 */
 		cancel_work_sync(&fs_info->async_reclaim_work);
 		cancel_work_sync(&fs_info->async_data_reclaim_work);
+		cancel_work_sync(&fs_info->async_delayed_refs_work);
 
 		btrfs_discard_cleanup(fs_info);
 
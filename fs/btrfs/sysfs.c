@@ -1056,6 +1056,128 @@ static ssize_t btrfs_bg_reclaim_threshold_store(struct kobject *kobj,
 BTRFS_ATTR_RW(, bg_reclaim_threshold, btrfs_bg_reclaim_threshold_show,
 	      btrfs_bg_reclaim_threshold_store);
 
+static ssize_t btrfs_delayed_refs_async_ms_show(struct kobject *kobj,
+						struct kobj_attribute *a,
+						char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n",
+			 READ_ONCE(fs_info->delayed_refs_async_ms));
+}
+
+static ssize_t btrfs_delayed_refs_async_ms_store(struct kobject *kobj,
+						 struct kobj_attribute *a,
+						 const char *buf, size_t len)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	int msecs;
+	int ret;
+
+	ret = kstrtoint(buf, 10, &msecs);
+	if (ret)
+		return ret;
+
+	if (msecs < 0)
+		return -EINVAL;
+
+	WRITE_ONCE(fs_info->delayed_refs_async_ms, msecs);
+
+	return len;
+}
+BTRFS_ATTR_RW(, delayed_refs_async_ms, btrfs_delayed_refs_async_ms_show,
+	      btrfs_delayed_refs_async_ms_store);
+
+static ssize_t btrfs_commit_stats_show(struct kobject *kobj,
+				       struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	struct btrfs_commit_stats stats;
+
+	spin_lock(&fs_info->trans_lock);
+	stats = fs_info->commit_stats;
+	spin_unlock(&fs_info->trans_lock);
+
+	return sysfs_emit(buf,
+		"commits %llu\n"
+		"last_commit_ms %llu\n"
+		"max_commit_ms %llu\n"
+		"total_commit_ms %llu\n"
+		"last_delayed_refs_ms %llu\n"
+		"total_delayed_refs_ms %llu\n"
+		"async_delayed_refs_ms %llu\n",
+		stats.commit_count,
+		div_u64(stats.last_commit_dur, NSEC_PER_MSEC),
+		div_u64(stats.max_commit_dur, NSEC_PER_MSEC),
+		div_u64(stats.total_commit_dur, NSEC_PER_MSEC),
+		div_u64(stats.last_delayed_refs_dur, NSEC_PER_MSEC),
+		div_u64(stats.total_delayed_refs_dur, NSEC_PER_MSEC),
+		div_u64(stats.async_delayed_refs_dur, NSEC_PER_MSEC));
+}
+
+/* Writing 0 resets the maximum commit duration */
+static ssize_t btrfs_commit_stats_store(struct kobject *kobj,
+					struct kobj_attribute *a,
+					const char *buf, size_t count)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	unsigned long val;
+	int ret;
+
+	if (!fs_info)
+		return -EPERM;
+
+	if (!capable(CAP_SYS_RESOURCE))
+		return -EPERM;
+
+	ret = kstrtoul(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val)
+		return -EINVAL;
+
+	spin_lock(&fs_info->trans_lock);
+	fs_info->commit_stats.max_commit_dur = 0;
+	spin_unlock(&fs_info->trans_lock);
+
+	return count;
+}
+BTRFS_ATTR_RW(, commit_stats, btrfs_commit_stats_show,
+	      btrfs_commit_stats_store);
+
+/*
+ * One line per compression algorithm: bytes in and out, the ratio of the two
+ * in percent, compression time and throughput, and the number of ranges that
+ * turned out to be incompressible.
+ */
+static ssize_t btrfs_compress_stats_show(struct kobject *kobj,
+					 struct kobj_attribute *a, char *buf)
+{
+	struct btrfs_fs_info *fs_info = to_fs_info(kobj);
+	ssize_t ret = 0;
+	int type;
+
+	for (type = BTRFS_COMPRESS_ZLIB; type < BTRFS_NR_COMPRESS_TYPES; type++) {
+		struct btrfs_compress_stats *stats;
+		u64 in, out, msecs;
+
+		stats = &fs_info->compress_stats[type];
+		in = atomic64_read(&stats->in_bytes);
+		out = atomic64_read(&stats->out_bytes);
+		msecs = div_u64(atomic64_read(&stats->nsecs), NSEC_PER_MSEC);
+
+		ret += sysfs_emit_at(buf, ret,
+			"%s in_bytes %llu out_bytes %llu ratio %llu time_ms %llu mb_per_sec %llu incompressible %llu\n",
+			btrfs_compress_type2str(type), in, out,
+			in ? div64_u64(out * 100, in) : 0, msecs,
+			msecs ? div64_u64(in, msecs * 1000) : 0,
+			(u64)atomic64_read(&stats->nr_incompressible));
+	}
+
+	return ret;
+}
+BTRFS_ATTR(, compress_stats, btrfs_compress_stats_show);
+
 /*
  * Per-filesystem information and stats.
  *
@@ -1073,6 +1195,9 @@ static const struct attribute *btrfs_attrs[] = {
 	BTRFS_ATTR_PTR(, generation),
 	BTRFS_ATTR_PTR(, read_policy),
 	BTRFS_ATTR_PTR(, bg_reclaim_threshold),
+	BTRFS_ATTR_PTR(, delayed_refs_async_ms),
+	BTRFS_ATTR_PTR(, commit_stats),
+	BTRFS_ATTR_PTR(, compress_stats),
 	NULL,
 };
 
@@ -362,6 +362,7 @@ static noinline int join_transaction(struct btrfs_fs_info *fs_info,
 	cur_trans->delayed_refs.href_root = RB_ROOT_CACHED;
 	cur_trans->delayed_refs.dirty_extent_root = RB_ROOT;
 	atomic_set(&cur_trans->delayed_refs.num_entries, 0);
+	atomic64_set(&cur_trans->delayed_refs_commit_dur, 0);
 
 	/*
 	 * although the tree mod log is per file system and not per transaction,
@@ -1012,6 +1013,21 @@ static int __btrfs_end_transaction(struct btrfs_trans_handle *trans,
 		sb_end_intwrite(info->sb);
 
 	WARN_ON(cur_trans != info->running_transaction);
+
+	/*
+	 * If the commit would take longer than our latency target to run the
+	 * delayed refs queued so far, start running them in the background.
+	 * The background run itself ends its handle through here, don't let
+	 * it requeue itself.
+	 */
+	if (READ_ONCE(info->delayed_refs_async_ms) &&
+	    cur_trans->state < TRANS_STATE_COMMIT_START &&
+	    !TRANS_ABORTED(trans) &&
+	    current_work() != &info->async_delayed_refs_work &&
+	    btrfs_delayed_refs_runtime(cur_trans) >=
+	    (u64)READ_ONCE(info->delayed_refs_async_ms) * NSEC_PER_MSEC)
+		queue_work(system_unbound_wq, &info->async_delayed_refs_work);
+
 	WARN_ON(atomic_read(&cur_trans->num_writers) < 1);
 	atomic_dec(&cur_trans->num_writers);
 	extwriter_counter_dec(cur_trans, trans->type);
@@ -2127,11 +2143,30 @@ static void add_pending_snapshot(struct btrfs_trans_handle *trans)
 	list_add(&trans->pending_snapshot->list, &cur_trans->pending_snapshots);
 }
 
+static void update_commit_stats(struct btrfs_fs_info *fs_info,
+				struct btrfs_transaction *cur_trans,
+				u64 start_time)
+{
+	struct btrfs_commit_stats *stats = &fs_info->commit_stats;
+	u64 dur = ktime_get_ns() - start_time;
+	u64 refs_dur = atomic64_read(&cur_trans->delayed_refs_commit_dur);
+
+	spin_lock(&fs_info->trans_lock);
+	stats->commit_count++;
+	stats->last_commit_dur = dur;
+	stats->max_commit_dur = max(stats->max_commit_dur, dur);
+	stats->total_commit_dur += dur;
+	stats->last_delayed_refs_dur = refs_dur;
+	stats->total_delayed_refs_dur += refs_dur;
+	spin_unlock(&fs_info->trans_lock);
+}
+
 int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 {
 	struct btrfs_fs_info *fs_info = trans->fs_info;
 	struct btrfs_transaction *cur_trans = trans->transaction;
 	struct btrfs_transaction *prev_trans = NULL;
+	u64 start_time = ktime_get_ns();
 	int ret;
 
 	ASSERT(refcount_read(&trans->use_count) == 1);
@@ -2485,6 +2520,8 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 	list_del_init(&cur_trans->list);
 	spin_unlock(&fs_info->trans_lock);
 
+	update_commit_stats(fs_info, cur_trans, start_time);
+
 	btrfs_put_transaction(cur_trans);
 	btrfs_put_transaction(cur_trans);
 
@@ -85,6 +85,8 @@ struct btrfs_transaction {
 	struct list_head deleted_bgs;
 	spinlock_t dropped_roots_lock;
 	struct btrfs_delayed_ref_root delayed_refs;
+	/* Time spent running delayed refs once the commit started, in ns */
+	atomic64_t delayed_refs_commit_dur;
 	struct btrfs_fs_info *fs_info;
 
 	/*
@@ -361,6 +361,8 @@ void cachefiles_put_object(struct fscache_object *_object,
 			object->lookup_data = NULL;
 		}
 
+		cachefiles_content_map_clear(object);
+
 		cache = object->fscache.cache;
 		fscache_object_destroy(&object->fscache);
 		kmem_cache_free(cachefiles_object_jar, object);
@@ -483,6 +485,9 @@ static int cachefiles_attr_changed(struct fscache_object *_object)
 	inode_unlock(d_inode(object->backer));
 	cachefiles_end_secure(cache, saved_cred);
 
+	/* the map is sized by the store limit, start over with the new one */
+	cachefiles_content_map_clear(object);
+
 	if (ret == -EIO) {
 		fscache_set_store_limit(&object->fscache, 0);
 		cachefiles_io_error_obj(object, "Size set failed");
@@ -527,6 +532,7 @@ static void cachefiles_invalidate_object(struct fscache_operation *op)
 		if (ret == 0)
 			ret = vfs_truncate(&path, ni_size);
 		cachefiles_end_secure(cache, saved_cred);
+		cachefiles_content_map_clear(object);
 
 		if (ret != 0) {
 			fscache_set_store_limit(&object->fscache, 0);
@@ -45,8 +45,19 @@ struct cachefiles_object {
 	uint8_t				new;		/* T if object new */
 	spinlock_t			work_lock;
 	struct rb_node			active_node;	/* link in active tree (dentry is key) */
+	spinlock_t			content_lock;	/* protects content_map */
+	unsigned long			*content_map;	/* granules known to hold data */
+	unsigned int			content_map_size; /* granules in content_map */
 };
 
+/*
+ * The content map records which granules of the backing file are known to
+ * hold data, so that reads of them can skip probing the backing file with
+ * SEEK_DATA and SEEK_HOLE.  A clear bit only means "don't know".
+ */
+#define CACHEFILES_CONTENT_GRANULE	(256 * 1024)
+#define CACHEFILES_CONTENT_MAP_MAX	65536		/* granules, ie. 16GiB */
+
 extern struct kmem_cache *cachefiles_object_jar;
 
 /*
@@ -200,6 +211,7 @@ extern void cachefiles_uncache_page(struct fscache_object *, struct page *);
  */
 extern int cachefiles_begin_read_operation(struct netfs_read_request *,
 					   struct fscache_retrieval *);
+extern void cachefiles_content_map_clear(struct cachefiles_object *object);
 
 /*
  * security.c
@@ -8,6 +8,7 @@
 #include <linux/mount.h>
 #include <linux/slab.h>
 #include <linux/file.h>
+#include <linux/bitmap.h>
 #include <linux/uio.h>
 #include <linux/sched/mm.h>
 #include <linux/netfs.h>
@@ -23,9 +24,93 @@ struct cachefiles_kiocb {
 	};
 	netfs_io_terminated_t	term_func;
 	void			*term_func_priv;
+	struct cachefiles_object *object;	/* for writes */
 	bool			was_async;
 };
 
+static struct cachefiles_object *cachefiles_cres_object(struct netfs_cache_resources *cres)
+{
+	struct fscache_retrieval *op = cres->cache_priv;
+
+	return container_of(op->op.object, struct cachefiles_object, fscache);
+}
+
+/*
+ * Forget everything the content map knows, the backing file is about to be
+ * truncated or the object is going away.
+ */
+void cachefiles_content_map_clear(struct cachefiles_object *object)
+{
+	unsigned long *map, flags;
+
+	spin_lock_irqsave(&object->content_lock, flags);
+	map = object->content_map;
+	object->content_map = NULL;
+	object->content_map_size = 0;
+	spin_unlock_irqrestore(&object->content_lock, flags);
+	bitmap_free(map);
+}
+
+/*
+ * Note that the granules lying entirely within [start, end) hold data.  This
+ * may be called from I/O completion, so the map is allocated atomically and
+ * simply not updated if that fails.
+ */
+static void cachefiles_content_map_mark(struct cachefiles_object *object,
+					loff_t start, loff_t end)
+{
+	unsigned long first, last, size, *map = NULL, flags;
+
+	first = DIV_ROUND_UP(start, CACHEFILES_CONTENT_GRANULE);
+	last = end / CACHEFILES_CONTENT_GRANULE;
+	if (start == end || first >= last)
+		return;
+
+	size = DIV_ROUND_UP(object->fscache.store_limit_l,
+			    CACHEFILES_CONTENT_GRANULE);
+	if (size > CACHEFILES_CONTENT_MAP_MAX)
+		return;
+
+	if (!READ_ONCE(object->content_map)) {
+		map = bitmap_zalloc(size, GFP_ATOMIC | __GFP_NOWARN);
+		if (!map)
+			return;
+	}
+
+	spin_lock_irqsave(&object->content_lock, flags);
+	if (!object->content_map && map) {
+		object->content_map = map;
+		object->content_map_size = size;
+		map = NULL;
+	}
+	if (object->content_map && first < object->content_map_size)
+		bitmap_set(object->content_map, first,
+			   min_t(unsigned long, last,
+				 object->content_map_size) - first);
+	spin_unlock_irqrestore(&object->content_lock, flags);
+	bitmap_free(map);
+}
+
+/*
+ * Check whether the whole of [start, end) is covered by granules known to
+ * hold data.
+ */
+static bool cachefiles_content_map_test(struct cachefiles_object *object,
+					loff_t start, loff_t end)
+{
+	unsigned long first, last, flags;
+	bool ret = false;
+
+	first = start / CACHEFILES_CONTENT_GRANULE;
+	last = DIV_ROUND_UP(end, CACHEFILES_CONTENT_GRANULE);
+
+	spin_lock_irqsave(&object->content_lock, flags);
+	if (object->content_map && last <= object->content_map_size)
+		ret = find_next_zero_bit(object->content_map, last, first) >= last;
+	spin_unlock_irqrestore(&object->content_lock, flags);
+	return ret;
+}
+
 static inline void cachefiles_put_kiocb(struct cachefiles_kiocb *ki)
 {
 	if (refcount_dec_and_test(&ki->ki_refcnt)) {
@@ -170,6 +255,10 @@ static void cachefiles_write_complete(struct kiocb *iocb, long ret, long ret2)
 	__sb_writers_acquired(inode->i_sb, SB_FREEZE_WRITE);
 	__sb_end_write(inode->i_sb, SB_FREEZE_WRITE);
 
+	if (ret > 0)
+		cachefiles_content_map_mark(ki->object, ki->start,
+					    ki->start + ret);
+
 	if (ki->term_func)
 		ki->term_func(ki->term_func_priv, ret, ki->was_async);
 
@@ -210,6 +299,7 @@ static int cachefiles_write(struct netfs_cache_resources *cres,
 	ki->len			= len;
 	ki->term_func		= term_func;
 	ki->term_func_priv	= term_func_priv;
+	ki->object		= cachefiles_cres_object(cres);
 	ki->was_async		= true;
 
 	if (ki->term_func)
@@ -288,6 +378,10 @@ static enum netfs_read_source cachefiles_prepare_read(struct netfs_read_subreque
 	if (subreq->start >= i_size)
 		return NETFS_FILL_WITH_ZEROES;
 
+	if (cachefiles_content_map_test(object, subreq->start,
+					subreq->start + subreq->len))
+		return NETFS_READ_FROM_CACHE;
+
 	cachefiles_begin_secure(cache, &saved_cred);
 
 	off = vfs_llseek(file, subreq->start, SEEK_DATA);
@@ -310,6 +404,9 @@ static enum netfs_read_source cachefiles_prepare_read(struct netfs_read_subreque
 	if (to < 0 && to >= (loff_t)-MAX_ERRNO)
 		goto cache_fail;
 
+	/* Remember what was found so that the next reads need not look */
+	cachefiles_content_map_mark(object, subreq->start, to);
+
 	if (to < subreq->start + subreq->len) {
 		if (subreq->start + subreq->len >= i_size)
 			to = round_up(to, cache->bsize);
@@ -43,6 +43,7 @@ static void cachefiles_object_init_once(void *_object)
 
 	memset(object, 0, sizeof(*object));
 	spin_lock_init(&object->work_lock);
+	spin_lock_init(&object->content_lock);
 }
 
 /*
@@ -124,6 +124,10 @@ struct dentry_stat_t dentry_stat = {
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
 static DEFINE_PER_CPU(long, nr_dentry_negative);
+static DEFINE_PER_CPU(long, nr_dentry_negative_hits);
+
+/* Unused negative dentries each superblock may keep, 0 for no limit */
+unsigned long sysctl_negative_dentry_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 
@@ -167,12 +171,23 @@ static long get_nr_dentry_negative(void)
 	return sum < 0 ? 0 : sum;
 }
 
+static long get_nr_dentry_negative_hits(void)
+{
+	int i;
+	long sum = 0;
+
+	for_each_possible_cpu(i)
+		sum += per_cpu(nr_dentry_negative_hits, i);
+	return sum < 0 ? 0 : sum;
+}
+
 int proc_nr_dentry(struct ctl_table *table, int write, void *buffer,
 		   size_t *lenp, loff_t *ppos)
 {
 	dentry_stat.nr_dentry = get_nr_dentry();
 	dentry_stat.nr_unused = get_nr_dentry_unused();
 	dentry_stat.nr_negative = get_nr_dentry_negative();
+	dentry_stat.nr_negative_hits = get_nr_dentry_negative_hits();
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 #endif
@@ -324,6 +339,22 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 	smp_store_release(&dentry->d_flags, flags);
 }
 
+/*
+ * Negative dentries on the LRU are counted globally and per superblock,
+ * the latter for negative-dentry-limit.
+ */
+static inline void d_negative_inc(struct dentry *dentry)
+{
+	this_cpu_inc(nr_dentry_negative);
+	percpu_counter_inc(&dentry->d_sb->s_nr_negative_dentry);
+}
+
+static inline void d_negative_dec(struct dentry *dentry)
+{
+	this_cpu_dec(nr_dentry_negative);
+	percpu_counter_dec(&dentry->d_sb->s_nr_negative_dentry);
+}
+
 static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
@@ -332,7 +363,7 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_inc(nr_dentry_negative);
+		d_negative_inc(dentry);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -401,8 +432,16 @@ static void d_lru_add(struct dentry *dentry)
 	D_FLAG_VERIFY(dentry, 0);
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
-	if (d_is_negative(dentry))
-		this_cpu_inc(nr_dentry_negative);
+	if (d_is_negative(dentry)) {
+		struct super_block *sb = dentry->d_sb;
+		unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+
+		d_negative_inc(dentry);
+		if (unlikely(limit) &&
+		    percpu_counter_read_positive(&sb->s_nr_negative_dentry) > limit)
+			queue_work(system_unbound_wq,
+				   &sb->s_negative_dentry_work);
+	}
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -412,7 +451,7 @@ static void d_lru_del(struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -444,7 +483,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -454,7 +493,7 @@ static void d_lru_shrink_move(struct list_lru_one *lru, struct dentry *dentry,
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags |= DCACHE_SHRINK_LIST;
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	list_lru_isolate_move(lru, &dentry->d_lru, list);
 }
 
@@ -1258,6 +1297,59 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+static enum lru_status dentry_negative_lru_isolate(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct dentry *dentry = container_of(item, struct dentry, d_lru);
+
+	/*
+	 * Move positive dentries out of the way so that the next batch
+	 * starts where this one stopped.  The check is racy, but
+	 * dentry_lru_isolate() is fine with any dentry on the LRU.
+	 */
+	if (!d_is_negative(dentry))
+		return LRU_ROTATE;
+
+	return dentry_lru_isolate(item, lru, lru_lock, arg);
+}
+
+/*
+ * Trim the unused negative dentries of a superblock to a bit below
+ * negative-dentry-limit, oldest first, without waiting for memory pressure.
+ */
+void prune_negative_dentries_work(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_negative_dentry_work);
+	unsigned long limit = READ_ONCE(sysctl_negative_dentry_limit);
+	long nr_to_free, freed;
+
+	/* The superblock is being set up or torn down, try another time */
+	if (!down_read_trylock(&sb->s_umount))
+		return;
+	if (!limit || !(sb->s_flags & SB_ACTIVE))
+		goto out;
+
+	/* Leave some slack, so new lookups don't requeue us right away */
+	nr_to_free = percpu_counter_sum_positive(&sb->s_nr_negative_dentry) -
+		     (limit - limit / 8);
+	while (nr_to_free > 0) {
+		unsigned long nr_to_walk = 1024;
+		LIST_HEAD(dispose);
+
+		freed = list_lru_walk(&sb->s_dentry_lru,
+				      dentry_negative_lru_isolate, &dispose,
+				      nr_to_walk);
+		shrink_dentry_list(&dispose);
+		if (!freed)
+			break;
+		nr_to_free -= freed;
+		cond_resched();
+	}
+out:
+	up_read(&sb->s_umount);
+}
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -1977,7 +2069,7 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 	 * Decrement negative dentry count if it was in the LRU list.
 	 */
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	hlist_add_head(&dentry->d_u.d_alias, &inode->i_dentry);
 	raw_write_seqcount_begin(&dentry->d_seq);
 	__d_set_inode_and_type(dentry, inode, add_flags);
@@ -2344,6 +2436,8 @@ struct dentry *__d_lookup_rcu(const struct dentry *parent,
 				continue;
 		}
 		*seqp = seq;
+		if (unlikely(d_is_negative(dentry)))
+			this_cpu_inc(nr_dentry_negative_hits);
 		return dentry;
 	}
 	return NULL;
@@ -2436,6 +2530,8 @@ struct dentry *__d_lookup(const struct dentry *parent, const struct qstr *name)
 
 		dentry->d_lockref.count++;
 		found = dentry;
+		if (unlikely(d_is_negative(dentry)))
+			this_cpu_inc(nr_dentry_negative_hits);
 		spin_unlock(&dentry->d_lock);
 		break;
 next:
@@ -30,6 +30,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/device.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <asm/io.h>
 #include <asm/mman.h>
 #include <linux/atomic.h>
@@ -37,6 +38,8 @@
 #include <linux/seq_file.h>
 #include <linux/compat.h>
 #include <linux/rculist.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
 #include <net/busy_poll.h>
 
 /*
@@ -45,14 +48,15 @@
  *
  * 1) epmutex (mutex)
  * 2) ep->mtx (mutex)
- * 3) ep->lock (rwlock)
+ * 3) ep->lock (spinlock)
  *
  * The acquire order is the one listed above, from 1 to 3.
- * We need a rwlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
+ * We need a spinlock (ep->lock) because the ready list is also
+ * fed from the poll callback, that might be triggered from
  * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * The poll callback itself does not take ep->lock, it queues
+ * items on lockless per-CPU pending lists that are merged into
+ * the ready list under ep->lock. During the event transfer loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -100,6 +104,12 @@
 
 #define EP_MAX_EVENTS (INT_MAX / sizeof(struct epoll_event))
 
+/* Maximum number of NAPI IDs busy polled by one epoll instance */
+#define EP_BUSY_POLL_MAX_NAPI 4
+
+/* Maximum number of entries in a user-mapped event ring */
+#define EP_RING_MAX_ENTRIES (1U << 16)
+
 #define EP_UNACTIVE_PTR ((void *) -1L)
 
 #define EP_ITEM_COST (sizeof(struct epitem) + sizeof(struct eppoll_entry))
@@ -145,10 +155,10 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links this item to a per-CPU pending list of "struct eventpoll",
+	 * ->next is EP_UNACTIVE_PTR while the item is not queued.
 	 */
-	struct epitem *next;
+	struct llist_node rdlnode;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -192,18 +202,20 @@ struct eventpoll {
 	/* List of ready file descriptors */
 	struct list_head rdllist;
 
-	/* Lock which protects rdllist and ovflist */
-	rwlock_t lock;
+	/* Lock which protects rdllist */
+	spinlock_t lock;
 
 	/* RB tree root used to store monitored fd structs */
 	struct rb_root_cached rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Items queued by ep_poll_callback(), per CPU so that wakeups
+	 * coming from different CPUs don't share a cacheline. They are
+	 * moved to ->rdllist by ep_merge_pending(); ->pending_cpus tells
+	 * which of the lists may be non-empty.
 	 */
-	struct epitem *ovflist;
+	struct llist_head __percpu *pcpu_pending;
+	cpumask_var_t pending_cpus;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
@@ -213,13 +225,28 @@ struct eventpoll {
 
 	struct file *file;
 
+	/*
+	 * Optional user-mapped event ring, set once under ->mtx. The kernel
+	 * keeps its own tail and mask as the ring itself is writable by
+	 * userspace.
+	 */
+	struct epoll_ring *ring;
+	unsigned int ring_mask;
+	unsigned int ring_tail;
+
 	/* used to optimize loop detection check */
 	u64 gen;
 	struct hlist_head refs;
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
-	/* used to track busy poll napi_id */
-	unsigned int napi_id;
+	/* used to track busy poll napi_ids, replaced round-robin */
+	unsigned int napi_id[EP_BUSY_POLL_MAX_NAPI];
+	unsigned int napi_next;
+
+	/* per-instance busy poll settings, see EPIOCSPARAMS */
+	u32 busy_poll_usecs;
+	u16 busy_poll_budget;
+	bool prefer_busy_poll;
 #endif
 
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
@@ -372,40 +399,96 @@ static inline struct epitem *ep_item_from_wait(wait_queue_entry_t *p)
 static inline int ep_events_available(struct eventpoll *ep)
 {
 	return !list_empty_careful(&ep->rdllist) ||
-		READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR;
+		!cpumask_empty(ep->pending_cpus);
 }
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
+/*
+ * Busy polling is on if the instance has its own timeout set with
+ * EPIOCSPARAMS, otherwise the global net.core.busy_poll applies.
+ */
+static bool ep_busy_loop_on(struct eventpoll *ep)
+{
+	return !!READ_ONCE(ep->busy_poll_usecs) || net_busy_loop_on();
+}
+
+static bool ep_busy_loop_timeout(struct eventpoll *ep, unsigned long start_time)
+{
+	unsigned long bp_usec = READ_ONCE(ep->busy_poll_usecs);
+
+	if (bp_usec) {
+		unsigned long end_time = start_time + bp_usec;
+		unsigned long now = busy_loop_current_time();
+
+		return time_after(now, end_time);
+	}
+	return busy_loop_timeout(start_time);
+}
+
 static bool ep_busy_loop_end(void *p, unsigned long start_time)
 {
 	struct eventpoll *ep = p;
 
-	return ep_events_available(ep) || busy_loop_timeout(start_time);
+	return ep_events_available(ep) || ep_busy_loop_timeout(ep, start_time);
 }
 
 /*
- * Busy poll if globally on and supporting sockets found && no events,
+ * Busy poll if on and supporting sockets found && no events,
  * busy loop will return if need_resched or ep_events_available.
  *
+ * With a single NAPI ID the whole loop is left to napi_busy_loop(). With
+ * sockets spread over several queues, each one is polled once per round
+ * so that a busy queue does not starve the others.
+ *
  * we must do our busy polling with irqs enabled
  */
 static bool ep_busy_loop(struct eventpoll *ep, int nonblock)
 {
-	unsigned int napi_id = READ_ONCE(ep->napi_id);
+	unsigned int napi_id[EP_BUSY_POLL_MAX_NAPI];
+	unsigned long start_time;
+	bool prefer_busy_poll;
+	int i, nr = 0;
+	u16 budget;
 
-	if ((napi_id >= MIN_NAPI_ID) && net_busy_loop_on()) {
-		napi_busy_loop(napi_id, nonblock ? NULL : ep_busy_loop_end, ep, false,
-			       BUSY_POLL_BUDGET);
-		if (ep_events_available(ep))
-			return true;
-		/*
-		 * Busy poll timed out.  Drop NAPI ID for now, we can add
-		 * it back in when we have moved a socket with a valid NAPI
-		 * ID onto the ready list.
-		 */
-		ep->napi_id = 0;
+	if (!ep_busy_loop_on(ep))
 		return false;
+
+	for (i = 0; i < EP_BUSY_POLL_MAX_NAPI; i++) {
+		unsigned int id = READ_ONCE(ep->napi_id[i]);
+
+		if (id >= MIN_NAPI_ID)
+			napi_id[nr++] = id;
+	}
+	if (!nr)
+		return false;
+
+	prefer_busy_poll = READ_ONCE(ep->prefer_busy_poll);
+	budget = READ_ONCE(ep->busy_poll_budget) ?: BUSY_POLL_BUDGET;
+
+	if (nr == 1) {
+		napi_busy_loop(napi_id[0], nonblock ? NULL : ep_busy_loop_end,
+			       ep, prefer_busy_poll, budget);
+	} else {
+		start_time = busy_loop_current_time();
+		for (;;) {
+			for (i = 0; i < nr; i++)
+				napi_busy_loop(napi_id[i], NULL, NULL,
+					       prefer_busy_poll, budget);
+			if (nonblock || ep_busy_loop_end(ep, start_time))
+				break;
+			cond_resched();
+		}
 	}
+
+	if (ep_events_available(ep))
+		return true;
+	/*
+	 * Busy poll timed out.  Drop NAPI IDs for now, we can add
+	 * them back in when we have moved a socket with a valid NAPI
+	 * ID onto the ready list.
+	 */
+	for (i = 0; i < EP_BUSY_POLL_MAX_NAPI; i++)
+		WRITE_ONCE(ep->napi_id[i], 0);
 	return false;
 }
 
@@ -414,12 +497,13 @@ static bool ep_busy_loop(struct eventpoll *ep, int nonblock)
  */
 static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
 {
-	struct eventpoll *ep;
-	unsigned int napi_id;
+	struct eventpoll *ep = epi->ep;
+	unsigned int napi_id, next;
 	struct socket *sock;
 	struct sock *sk;
+	int i;
 
-	if (!net_busy_loop_on())
+	if (!ep_busy_loop_on(ep))
 		return;
 
 	sock = sock_from_file(epi->ffd.file);
@@ -431,17 +515,55 @@ static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
 		return;
 
 	napi_id = READ_ONCE(sk->sk_napi_id);
-	ep = epi->ep;
 
-	/* Non-NAPI IDs can be rejected
-	 *	or
-	 * Nothing to do if we already have this ID
-	 */
-	if (napi_id < MIN_NAPI_ID || napi_id == ep->napi_id)
+	/* Non-NAPI IDs can be rejected */
+	if (napi_id < MIN_NAPI_ID)
 		return;
 
-	/* record NAPI ID for use in next busy poll */
-	ep->napi_id = napi_id;
+	/* Nothing to do if we already have this ID */
+	for (i = 0; i < EP_BUSY_POLL_MAX_NAPI; i++)
+		if (READ_ONCE(ep->napi_id[i]) == napi_id)
+			return;
+
+	/*
+	 * record NAPI ID for use in next busy poll, racing callbacks may
+	 * overwrite each other's slot, which only costs a missed busy poll.
+	 */
+	next = READ_ONCE(ep->napi_next);
+	WRITE_ONCE(ep->napi_id[next], napi_id);
+	WRITE_ONCE(ep->napi_next, (next + 1) % EP_BUSY_POLL_MAX_NAPI);
+}
+
+static long ep_busy_poll_ioctl(struct eventpoll *ep, unsigned int cmd,
+			       struct epoll_params __user *uparams)
+{
+	struct epoll_params p;
+
+	switch (cmd) {
+	case EPIOCSPARAMS:
+		if (copy_from_user(&p, uparams, sizeof(p)))
+			return -EFAULT;
+		if (p.__pad || p.busy_poll_usecs > S32_MAX ||
+		    p.prefer_busy_poll > 1)
+			return -EINVAL;
+		if (p.busy_poll_budget > NAPI_POLL_WEIGHT &&
+		    !capable(CAP_NET_ADMIN))
+			return -EPERM;
+
+		WRITE_ONCE(ep->busy_poll_usecs, p.busy_poll_usecs);
+		WRITE_ONCE(ep->busy_poll_budget, p.busy_poll_budget);
+		WRITE_ONCE(ep->prefer_busy_poll, p.prefer_busy_poll);
+		return 0;
+	case EPIOCGPARAMS:
+		memset(&p, 0, sizeof(p));
+		p.busy_poll_usecs = READ_ONCE(ep->busy_poll_usecs);
+		p.busy_poll_budget = READ_ONCE(ep->busy_poll_budget);
+		p.prefer_busy_poll = READ_ONCE(ep->prefer_busy_poll);
+		if (copy_to_user(uparams, &p, sizeof(p)))
+			return -EFAULT;
+		return 0;
+	}
+	return -ENOIOCTLCMD;
 }
 
 #else
@@ -455,6 +577,12 @@ static inline void ep_set_busy_poll_napi_id(struct epitem *epi)
 {
 }
 
+static long ep_busy_poll_ioctl(struct eventpoll *ep, unsigned int cmd,
+			       struct epoll_params __user *uparams)
+{
+	return -EOPNOTSUPP;
+}
+
 #endif /* CONFIG_NET_RX_BUSY_POLL */
 
 /*
@@ -596,6 +724,46 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 }
 
 
+/*
+ * Moves the items queued by ep_poll_callback() on the per-CPU pending lists
+ * to ep->rdllist. Items that are already linked, either on ep->rdllist or on
+ * the "txlist" of a scan in progress, are left where they are.
+ * Must be called with "ep->lock" held.
+ *
+ * Return: %true if any item has been added to ep->rdllist.
+ */
+static bool ep_merge_pending(struct eventpoll *ep)
+{
+	struct llist_node *node;
+	struct epitem *epi, *tmp;
+	bool added = false;
+	int cpu;
+
+	lockdep_assert_held(&ep->lock);
+
+	for_each_cpu(cpu, ep->pending_cpus) {
+		cpumask_clear_cpu(cpu, ep->pending_cpus);
+		/* pairs with the cmpxchg() in ep_queue_pending() */
+		smp_mb__after_atomic();
+		node = llist_del_all(per_cpu_ptr(ep->pcpu_pending, cpu));
+		/* The pending lists are LIFO, reverse to keep in FIFO. */
+		node = llist_reverse_order(node);
+		llist_for_each_entry_safe(epi, tmp, node, rdlnode) {
+			/*
+			 * ->next has been read already, after this store the
+			 * item can be queued again by ep_poll_callback().
+			 */
+			smp_store_release(&epi->rdlnode.next, EP_UNACTIVE_PTR);
+			if (!ep_is_linked(epi)) {
+				list_add_tail(&epi->rdllink, &ep->rdllist);
+				ep_pm_stay_awake(epi);
+				added = true;
+			}
+		}
+	}
+	return added;
+}
+
 /*
  * ep->mutex needs to be held because we could be hit by
  * eventpoll_release_file() and epoll_ctl().
@@ -604,53 +772,30 @@ static void ep_start_scan(struct eventpoll *ep, struct list_head *txlist)
 {
 	/*
 	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * empty list. Events happening while looping w/out locks keep
+	 * being queued on the per-CPU pending lists by the poll callback,
+	 * so they are not lost and the "sproc" callback can walk the
+	 * stolen list in a lockless way.
 	 */
 	lockdep_assert_irqs_enabled();
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
+	ep_merge_pending(ep);
 	list_splice_init(&ep->rdllist, txlist);
-	WRITE_ONCE(ep->ovflist, NULL);
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 }
 
 static void ep_done_scan(struct eventpoll *ep,
 			 struct list_head *txlist)
 {
-	struct epitem *epi, *nepi;
-
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
 	/*
 	 * During the time we spent inside the "sproc" callback, some
 	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
+	 * We re-insert them inside the main ready-list here. Items
+	 * still on "txlist" are skipped, the list_splice() below takes
+	 * care of them.
 	 */
-	for (nepi = READ_ONCE(ep->ovflist); (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(epi)) {
-			/*
-			 * ->ovflist is LIFO, so we have to reverse it in order
-			 * to keep in FIFO.
-			 */
-			list_add(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	WRITE_ONCE(ep->ovflist, EP_UNACTIVE_PTR);
+	ep_merge_pending(ep);
 
 	/*
 	 * Quickly re-inject items left on "txlist".
@@ -659,11 +804,11 @@ static void ep_done_scan(struct eventpoll *ep,
 	__pm_relax(ep->ws);
 
 	if (!list_empty(&ep->rdllist)) {
-		if (waitqueue_active(&ep->wq))
+		if (wq_has_sleeper(&ep->wq))
 			wake_up(&ep->wq);
 	}
 
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 }
 
 static void epi_rcu_free(struct rcu_head *head)
@@ -708,10 +853,19 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase_cached(&epi->rbn, &ep->rbr);
 
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
+	/*
+	 * The poll hooks are gone, so no callback can queue the item
+	 * anymore, but an earlier one may have left it pending. Other
+	 * items merged along the way may have raced with a waiter's final
+	 * check, so let it know.
+	 */
+	if (READ_ONCE(epi->rdlnode.next) != EP_UNACTIVE_PTR &&
+	    ep_merge_pending(ep) && wq_has_sleeper(&ep->wq))
+		wake_up(&ep->wq);
 	if (ep_is_linked(epi))
 		list_del_init(&epi->rdllink);
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 	/*
@@ -777,6 +931,9 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	vfree(ep->ring);
+	free_cpumask_var(ep->pending_cpus);
+	free_percpu(ep->pcpu_pending);
 	kfree(ep);
 }
 
@@ -878,6 +1035,72 @@ static void ep_show_fdinfo(struct seq_file *m, struct file *f)
 }
 #endif
 
+static int ep_ring_setup(struct eventpoll *ep,
+			 struct epoll_ring_params __user *uparams)
+{
+	struct epoll_ring_params p;
+	struct epoll_ring *ring;
+	unsigned int entries;
+	size_t size;
+
+	if (copy_from_user(&p, uparams, sizeof(p)))
+		return -EFAULT;
+	if (p.flags || memchr_inv(p.resv, 0, sizeof(p.resv)))
+		return -EINVAL;
+	if (!p.entries || p.entries > EP_RING_MAX_ENTRIES)
+		return -EINVAL;
+
+	entries = roundup_pow_of_two(p.entries);
+	size = PAGE_ALIGN(struct_size(ring, events, entries));
+	ring = vmalloc_user(size);
+	if (!ring)
+		return -ENOMEM;
+	ring->mask = entries - 1;
+
+	mutex_lock(&ep->mtx);
+	if (ep->ring) {
+		mutex_unlock(&ep->mtx);
+		vfree(ring);
+		return -EBUSY;
+	}
+	ep->ring_mask = entries - 1;
+	ep->ring_tail = 0;
+	WRITE_ONCE(ep->ring, ring);
+	mutex_unlock(&ep->mtx);
+
+	p.entries = entries;
+	p.ring_size = size;
+	if (copy_to_user(uparams, &p, sizeof(p)))
+		return -EFAULT;
+	return 0;
+}
+
+static long ep_eventpoll_ioctl(struct file *file, unsigned int cmd,
+			       unsigned long arg)
+{
+	struct eventpoll *ep = file->private_data;
+
+	switch (cmd) {
+	case EPIOCSRING:
+		return ep_ring_setup(ep, (void __user *)arg);
+	case EPIOCSPARAMS:
+	case EPIOCGPARAMS:
+		return ep_busy_poll_ioctl(ep, cmd, (void __user *)arg);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+static int ep_eventpoll_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct eventpoll *ep = file->private_data;
+	struct epoll_ring *ring = READ_ONCE(ep->ring);
+
+	if (!ring)
+		return -EINVAL;
+	return remap_vmalloc_range(vma, ring, vma->vm_pgoff);
+}
+
 /* File callbacks that implement the eventpoll file behaviour */
 static const struct file_operations eventpoll_fops = {
 #ifdef CONFIG_PROC_FS
@@ -885,6 +1108,9 @@ static const struct file_operations eventpoll_fops = {
 #endif
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.unlocked_ioctl	= ep_eventpoll_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+	.mmap		= ep_eventpoll_mmap,
 	.llseek		= noop_llseek,
 };
 
@@ -937,20 +1163,28 @@ static int ep_alloc(struct eventpoll **pep)
 	ep = kzalloc(sizeof(*ep), GFP_KERNEL);
 	if (unlikely(!ep))
 		goto free_uid;
+	ep->pcpu_pending = alloc_percpu(struct llist_head);
+	if (unlikely(!ep->pcpu_pending))
+		goto free_ep;
+	if (unlikely(!zalloc_cpumask_var(&ep->pending_cpus, GFP_KERNEL)))
+		goto free_pending;
 
 	mutex_init(&ep->mtx);
-	rwlock_init(&ep->lock);
+	spin_lock_init(&ep->lock);
 	init_waitqueue_head(&ep->wq);
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT_CACHED;
-	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
 
 	*pep = ep;
 
 	return 0;
 
+free_pending:
+	free_percpu(ep->pcpu_pending);
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -1030,78 +1264,33 @@ struct file *get_epoll_tfile_raw_ptr(struct file *file, int tfd,
 #endif /* CONFIG_KCMP */
 
 /*
- * Adds a new entry to the tail of the list in a lockless way, i.e.
- * multiple CPUs are allowed to call this function concurrently.
- *
- * Beware: it is necessary to prevent any other modifications of the
- *         existing list until all changes are completed, in other words
- *         concurrent list_add_tail_lockless() calls should be protected
- *         with a read lock, where write lock acts as a barrier which
- *         makes sure all list_add_tail_lockless() calls are fully
- *         completed.
- *
- *        Also an element can be locklessly added to the list only in one
- *        direction i.e. either to the tail or to the head, otherwise
- *        concurrent access will corrupt the list.
+ * Queues a new epi entry on the pending list of the current CPU in a
+ * lockless way, i.e. multiple CPUs are allowed to call this function
+ * concurrently.
  *
- * Return: %false if element has been already added to the list, %true
- * otherwise.
+ * Return: %false if epi element has been already queued, %true otherwise.
  */
-static inline bool list_add_tail_lockless(struct list_head *new,
-					  struct list_head *head)
-{
-	struct list_head *prev;
-
-	/*
-	 * This is simple 'new->next = head' operation, but cmpxchg()
-	 * is used in order to detect that same element has been just
-	 * added to the list from another CPU: the winner observes
-	 * new->next == new.
-	 */
-	if (cmpxchg(&new->next, new, head) != new)
-		return false;
-
-	/*
-	 * Initially ->next of a new element must be updated with the head
-	 * (we are inserting to the tail) and only then pointers are atomically
-	 * exchanged.  XCHG guarantees memory ordering, thus ->next should be
-	 * updated before pointers are actually swapped and pointers are
-	 * swapped before prev->next is updated.
-	 */
-
-	prev = xchg(&head->prev, new);
-
-	/*
-	 * It is safe to modify prev->next and new->prev, because a new element
-	 * is added only to the tail and new->next is updated before XCHG.
-	 */
-
-	prev->next = new;
-	new->prev = prev;
-
-	return true;
-}
-
-/*
- * Chains a new epi entry to the tail of the ep->ovflist in a lockless way,
- * i.e. multiple CPUs are allowed to call this function concurrently.
- *
- * Return: %false if epi element has been already chained, %true otherwise.
- */
-static inline bool chain_epi_lockless(struct epitem *epi)
+static inline bool ep_queue_pending(struct epitem *epi)
 {
 	struct eventpoll *ep = epi->ep;
+	int cpu;
 
 	/* Fast preliminary check */
-	if (epi->next != EP_UNACTIVE_PTR)
+	if (READ_ONCE(epi->rdlnode.next) != EP_UNACTIVE_PTR)
 		return false;
 
-	/* Check that the same epi has not been just chained from another CPU */
-	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
+	/* Check that the same epi has not been just queued from another CPU */
+	if (cmpxchg(&epi->rdlnode.next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
 		return false;
 
-	/* Atomically exchange tail */
-	epi->next = xchg(&ep->ovflist, epi);
+	/*
+	 * Any CPU's list would do as long as the matching bit is set, the
+	 * local one just keeps the cacheline where the wakeup happens.
+	 */
+	cpu = raw_smp_processor_id();
+	llist_add(&epi->rdlnode, per_cpu_ptr(ep->pcpu_pending, cpu));
+	if (!cpumask_test_cpu(cpu, ep->pending_cpus))
+		cpumask_set_cpu(cpu, ep->pending_cpus);
 
 	return true;
 }
@@ -1111,11 +1300,11 @@ static inline bool chain_epi_lockless(struct epitem *epi)
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
  *
- * This callback takes a read lock in order not to contend with concurrent
- * events from another file descriptor, thus all modifications to ->rdllist
- * or ->ovflist are lockless.  Read lock is paired with the write lock from
- * ep_scan_ready_list(), which stops all list modifications and guarantees
- * that lists state is seen correctly.
+ * This callback takes no lock in order not to contend with concurrent
+ * events from another file descriptor: ready items are queued on per-CPU
+ * pending lists, which ep_merge_pending() moves to ->rdllist under
+ * ep->lock. The barrier in wq_has_sleeper() pairs with the one in ep_poll()
+ * so that either the waiter sees the queued item or we see the waiter.
  *
  * Another thing worth to mention is that ep_poll_callback() can be called
  * concurrently for the same @epi from different CPUs if poll table was inited
@@ -1130,11 +1319,8 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 	__poll_t pollflags = key_to_poll(key);
-	unsigned long flags;
 	int ewake = 0;
 
-	read_lock_irqsave(&ep->lock, flags);
-
 	ep_set_busy_poll_napi_id(epi);
 
 	/*
@@ -1144,7 +1330,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		goto out;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -1153,28 +1339,21 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (pollflags && !(pollflags & epi->event.events))
-		goto out_unlock;
+		goto out;
 
 	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
+	 * Items are always queued on a pending list first, whether or not
+	 * events are being transferred to userspace at the moment, and get
+	 * merged into the ready list the next time it is scanned.
 	 */
-	if (READ_ONCE(ep->ovflist) != EP_UNACTIVE_PTR) {
-		if (chain_epi_lockless(epi))
-			ep_pm_stay_awake_rcu(epi);
-	} else if (!ep_is_linked(epi)) {
-		/* In the usual case, add event to ready list. */
-		if (list_add_tail_lockless(&epi->rdllink, &ep->rdllist))
-			ep_pm_stay_awake_rcu(epi);
-	}
+	if (ep_queue_pending(epi))
+		ep_pm_stay_awake_rcu(epi);
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq)) {
+	if (wq_has_sleeper(&ep->wq)) {
 		if ((epi->event.events & EPOLLEXCLUSIVE) &&
 					!(pollflags & POLLFREE)) {
 			switch (pollflags & EPOLLINOUT_BITS) {
@@ -1196,10 +1375,7 @@ static int ep_poll_callback(wait_queue_entry_t *wait, unsigned mode, int sync, v
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
-out_unlock:
-	read_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
+out:
 	if (pwake)
 		ep_poll_safewake(ep, epi);
 
@@ -1463,7 +1639,7 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	epi->ep = ep;
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->rdlnode.next = EP_UNACTIVE_PTR;
 
 	if (tep)
 		mutex_lock_nested(&tep->mtx, 1);
@@ -1525,7 +1701,7 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 	}
 
 	/* We have to drop the new item inside our item list to keep track of it */
-	write_lock_irq(&ep->lock);
+	spin_lock_irq(&ep->lock);
 
 	/* record NAPI ID of new item if present */
 	ep_set_busy_poll_napi_id(epi);
@@ -1536,13 +1712,13 @@ static int ep_insert(struct eventpoll *ep, const struct epoll_event *event,
 		ep_pm_stay_awake(epi);
 
 		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
+		if (wq_has_sleeper(&ep->wq))
 			wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
 
-	write_unlock_irq(&ep->lock);
+	spin_unlock_irq(&ep->lock);
 
 	/* We have to call this outside the lock */
 	if (pwake)
@@ -1586,8 +1762,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
 	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    changing epi above (and ep_poll_callback does not take
+	 *    any lock either).
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1606,18 +1782,18 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	 * list, push it inside.
 	 */
 	if (ep_item_poll(epi, &pt, 1)) {
-		write_lock_irq(&ep->lock);
+		spin_lock_irq(&ep->lock);
 		if (!ep_is_linked(epi)) {
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
 
 			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
+			if (wq_has_sleeper(&ep->wq))
 				wake_up(&ep->wq);
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
-		write_unlock_irq(&ep->lock);
+		spin_unlock_irq(&ep->lock);
 	}
 
 	/* We have to call this outside the lock */
@@ -1627,10 +1803,24 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi,
 	return 0;
 }
 
+/*
+ * Number of free entries in the event ring. The head is under userspace
+ * control, a bogus value just makes the ring look full.
+ */
+static unsigned int ep_ring_space(struct eventpoll *ep)
+{
+	unsigned int used = ep->ring_tail - smp_load_acquire(&ep->ring->head);
+
+	if (used > ep->ring_mask)
+		return 0;
+	return ep->ring_mask + 1 - used;
+}
+
 static int ep_send_events(struct eventpoll *ep,
 			  struct epoll_event __user *events, int maxevents)
 {
 	struct epitem *epi, *tmp;
+	struct epoll_ring *ring;
 	LIST_HEAD(txlist);
 	poll_table pt;
 	int res = 0;
@@ -1646,6 +1836,14 @@ static int ep_send_events(struct eventpoll *ep,
 	init_poll_funcptr(&pt, NULL);
 
 	mutex_lock(&ep->mtx);
+	ring = ep->ring;
+	if (ring) {
+		maxevents = min_t(unsigned int, maxevents, ep_ring_space(ep));
+		if (!maxevents) {
+			mutex_unlock(&ep->mtx);
+			return -ENOBUFS;
+		}
+	}
 	ep_start_scan(ep, &txlist);
 
 	/*
@@ -1686,8 +1884,15 @@ static int ep_send_events(struct eventpoll *ep,
 		if (!revents)
 			continue;
 
-		events = epoll_put_uevent(revents, epi->event.data, events);
-		if (!events) {
+		if (ring) {
+			struct epoll_event *rev;
+
+			/* plain stores, published by the tail update below */
+			rev = &ring->events[ep->ring_tail++ & ep->ring_mask];
+			rev->events = revents;
+			rev->data = epi->event.data;
+		} else if (!(events = epoll_put_uevent(revents, epi->event.data,
+						      events))) {
 			list_add(&epi->rdllink, &txlist);
 			ep_pm_stay_awake(epi);
 			if (!res)
@@ -1707,12 +1912,14 @@ static int ep_send_events(struct eventpoll *ep,
 			 * into ep->rdllist besides us. The epoll_ctl()
 			 * callers are locked out by
 			 * ep_scan_ready_list() holding "mtx" and the
-			 * poll callback will queue them in ep->ovflist.
+			 * poll callback only queues on the pending lists.
 			 */
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
 		}
 	}
+	if (ring && res > 0)
+		smp_store_release(&ring->tail, ep->ring_tail);
 	ep_done_scan(ep, &txlist);
 	mutex_unlock(&ep->mtx);
 
@@ -1834,7 +2041,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 * chance to harvest new event. Otherwise wakeup can be
 		 * lost. This is also good performance-wise, because on
 		 * normal wakeup path no need to call __remove_wait_queue()
-		 * explicitly, thus ep->lock is not taken, which halts the
+		 * explicitly, thus ep->wq.lock is not taken, which halts the
 		 * event delivery.
 		 *
 		 * In fact, we now use an even more aggressive function that
@@ -1846,26 +2053,24 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		init_wait(&wait);
 		wait.func = ep_autoremove_wake_function;
 
-		write_lock_irq(&ep->lock);
+		spin_lock_irq(&ep->wq.lock);
+		__add_wait_queue_exclusive(&ep->wq, &wait);
+		spin_unlock_irq(&ep->wq.lock);
+
 		/*
-		 * Barrierless variant, waitqueue_active() is called under
-		 * the same lock on wakeup ep_poll_callback() side, so it
-		 * is safe to avoid an explicit barrier.
+		 * The full barrier pairs with wq_has_sleeper() on the wakeup
+		 * side: ep_poll_callback() queues without taking any lock, so
+		 * either it sees us on the wait queue or we see its item in
+		 * the final check below.
 		 */
-		__set_current_state(TASK_INTERRUPTIBLE);
+		set_current_state(TASK_INTERRUPTIBLE);
 
 		/*
-		 * Do the final check under the lock. ep_scan_ready_list()
-		 * plays with two lists (->rdllist and ->ovflist) and there
-		 * is always a race when both lists are empty for short
-		 * period of time although events are pending, so lock is
-		 * important.
+		 * Do the final check after queueing ourselves. A scan in
+		 * progress may leave both lists empty for a short period of
+		 * time, ep_done_scan() wakes us up if events are left.
 		 */
 		eavail = ep_events_available(ep);
-		if (!eavail)
-			__add_wait_queue_exclusive(&ep->wq, &wait);
-
-		write_unlock_irq(&ep->lock);
 
 		if (!eavail)
 			timed_out = !schedule_hrtimeout_range(to, slack,
@@ -1880,7 +2085,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		eavail = 1;
 
 		if (!list_empty_careful(&wait.entry)) {
-			write_lock_irq(&ep->lock);
+			spin_lock_irq(&ep->wq.lock);
 			/*
 			 * If the thread timed out and is not on the wait queue,
 			 * it means that the thread was woken up after its
@@ -1891,7 +2096,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 			if (timed_out)
 				eavail = list_empty(&wait.entry);
 			__remove_wait_queue(&ep->wq, &wait);
-			write_unlock_irq(&ep->lock);
+			spin_unlock_irq(&ep->wq.lock);
 		}
 	}
 }
@@ -2222,10 +2427,6 @@ static int do_epoll_wait(int epfd, struct epoll_event __user *events,
 	if (maxevents <= 0 || maxevents > EP_MAX_EVENTS)
 		return -EINVAL;
 
-	/* Verify that the area passed by the user is writeable */
-	if (!access_ok(events, maxevents * sizeof(struct epoll_event)))
-		return -EFAULT;
-
 	/* Get the "struct file *" for the eventpoll file */
 	f = fdget(epfd);
 	if (!f.file)
@@ -2245,6 +2446,15 @@ static int do_epoll_wait(int epfd, struct epoll_event __user *events,
 	 */
 	ep = f.file->private_data;
 
+	/*
+	 * Verify that the area passed by the user is writeable, unless events
+	 * are delivered through the mapped ring.
+	 */
+	error = -EFAULT;
+	if (!READ_ONCE(ep->ring) &&
+	    !access_ok(events, maxevents * sizeof(struct epoll_event)))
+		goto error_fput;
+
 	/* Time to fish for events ... */
 	error = ep_poll(ep, events, maxevents, to);
 
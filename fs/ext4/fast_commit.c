@@ -1103,6 +1103,9 @@ static void ext4_fc_update_stats(struct super_block *sb, int status,
 				 stats->s_fc_avg_commit_time * 3) / 4;
 		else
 			stats->s_fc_avg_commit_time = commit_time;
+		stats->fc_commit_time_hist[min_t(int,
+			fls64(div_u64(commit_time, NSEC_PER_USEC)),
+			EXT4_FC_COMMIT_TIME_BUCKETS - 1)]++;
 	} else if (status == EXT4_FC_STATUS_FAILED ||
 		   status == EXT4_FC_STATUS_INELIGIBLE) {
 		if (status == EXT4_FC_STATUS_FAILED)
@@ -2139,6 +2142,29 @@ static const char *fc_ineligible_reasons[] = {
 	"FC Commit Failed"
 };
 
+/*
+ * Upper bound, in us, of the commit time of @pct percent of the fast commits,
+ * as far as the resolution of the histogram allows.
+ */
+static unsigned long ext4_fc_commit_time_pct(struct ext4_fc_stats *stats,
+					     unsigned int pct)
+{
+	unsigned long total = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < EXT4_FC_COMMIT_TIME_BUCKETS; i++)
+		total += stats->fc_commit_time_hist[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < EXT4_FC_COMMIT_TIME_BUCKETS - 1; i++) {
+		sum += stats->fc_commit_time_hist[i];
+		if (sum * 100 >= total * pct)
+			break;
+	}
+	return 1UL << i;
+}
+
 int ext4_fc_info_show(struct seq_file *seq, void *v)
 {
 	struct ext4_sb_info *sbi = EXT4_SB((struct super_block *)seq->private);
@@ -2153,6 +2179,14 @@ int ext4_fc_info_show(struct seq_file *seq, void *v)
 		   stats->fc_num_commits, stats->fc_ineligible_commits,
 		   stats->fc_numblks,
 		   div_u64(stats->s_fc_avg_commit_time, 1000));
+	/* Skipped commits were covered by a concurrent fast commit */
+	seq_printf(seq, "%ld batched\n%ld failed\n",
+		   stats->fc_skipped_commits, stats->fc_failed_commits);
+	seq_printf(seq,
+		"<%luus p50_commit_time\n<%luus p90_commit_time\n<%luus p99_commit_time\n",
+		   ext4_fc_commit_time_pct(stats, 50),
+		   ext4_fc_commit_time_pct(stats, 90),
+		   ext4_fc_commit_time_pct(stats, 99));
 	seq_puts(seq, "Ineligible reasons:\n");
 	for (i = 0; i < EXT4_FC_REASON_MAX; i++)
 		seq_printf(seq, "\"%s\":\t%d\n", fc_ineligible_reasons[i],
@@ -111,6 +111,12 @@ struct ext4_fc_dentry_update {
 	struct list_head fcd_list;
 };
 
+/*
+ * Fast commit times are kept in a log2 histogram, bucket i counting the
+ * commits that took less than 2^i us (and at least 2^(i-1) us).
+ */
+#define EXT4_FC_COMMIT_TIME_BUCKETS	24
+
 struct ext4_fc_stats {
 	unsigned int fc_ineligible_reason_count[EXT4_FC_REASON_MAX];
 	unsigned long fc_num_commits;
@@ -119,6 +125,7 @@ struct ext4_fc_stats {
 	unsigned long fc_skipped_commits;
 	unsigned long fc_numblks;
 	u64 s_fc_avg_commit_time;
+	unsigned long fc_commit_time_hist[EXT4_FC_COMMIT_TIME_BUCKETS];
 };
 
 #define EXT4_FC_REPLAY_REALLOC_INCREMENT	4
@@ -1045,6 +1045,43 @@ static int ext4_htree_next_block(struct inode *dir, __u32 hash,
 	return 1;
 }
 
+/* How far leaf readahead got in the index block it was started from */
+struct dx_ra {
+	sector_t index_block;
+	unsigned int next;
+};
+
+/*
+ * Keep reads going for the NAMEI_RA_SIZE leaf blocks that follow frame->at
+ * in hash order.  They are scattered over the directory, so without this a
+ * readdir of a large htree directory waits for one block at a time.  Each
+ * leaf is only looked up and submitted once, later calls for the same
+ * index block just extend the window.
+ */
+static void dx_readahead_leaves(struct inode *dir, struct dx_frame *frame,
+				struct dx_ra *ra)
+{
+	unsigned int at = frame->at - frame->entries;
+	unsigned int end = dx_get_count(frame->entries);
+	struct buffer_head *bh;
+
+	if (ra->index_block != frame->bh->b_blocknr || ra->next <= at) {
+		ra->index_block = frame->bh->b_blocknr;
+		ra->next = at + 1;
+	}
+	end = min(end, at + 1 + NAMEI_RA_SIZE);
+
+	for (; ra->next < end; ra->next++) {
+		bh = ext4_getblk(NULL, dir,
+				 dx_get_block(frame->entries + ra->next), 0);
+		if (IS_ERR_OR_NULL(bh))
+			continue;
+		if (!ext4_buffer_uptodate(bh))
+			ext4_read_bh_lock(bh, REQ_META | REQ_PRIO | REQ_RAHEAD,
+					  false);
+		brelse(bh);
+	}
+}
 
 /*
  * This function fills a red-black tree with information from a
@@ -1165,6 +1202,7 @@ int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
 	struct dx_hash_info hinfo;
 	struct ext4_dir_entry_2 *de;
 	struct dx_frame frames[EXT4_HTREE_LEVEL], *frame;
+	struct dx_ra ra = {};
 	struct inode *dir;
 	ext4_lblk_t block;
 	int count = 0;
@@ -1237,6 +1275,7 @@ int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
 		}
 		cond_resched();
 		block = dx_get_block(frame->at);
+		dx_readahead_leaves(dir, frame, &ra);
 		ret = htree_dirblock_to_tree(dir_file, dir, block, &hinfo,
 					     start_hash, start_minor_hash);
 		if (ret < 0) {
@@ -96,6 +96,21 @@ static int gc_thread_func(void *data)
 			goto do_gc;
 		}
 
+		/*
+		 * Writers are about to run out of free sections and fall into
+		 * foreground GC. Get ahead of them without waiting for the
+		 * device to go idle, until we are clear of the threshold again.
+		 */
+		if (!foreground && gc_th->boost_free_secs &&
+		    has_not_enough_free_secs(sbi, 0, gc_th->boost_free_secs)) {
+			wait_ms = gc_th->urgent_sleep_time;
+			if (!down_write_trylock(&sbi->gc_lock)) {
+				stat_other_skip_bggc_count(sbi);
+				goto next;
+			}
+			goto do_gc;
+		}
+
 		if (foreground) {
 			down_write(&sbi->gc_lock);
 			goto do_gc;
@@ -160,6 +175,7 @@ int f2fs_start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->min_sleep_time = DEF_GC_THREAD_MIN_SLEEP_TIME;
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
+	gc_th->boost_free_secs = 0;
 
 	gc_th->gc_wake = 0;
 
@@ -40,6 +40,12 @@ struct f2fs_gc_kthread {
 	unsigned int max_sleep_time;
 	unsigned int no_gc_sleep_time;
 
+	/*
+	 * collect at the urgent pace, busy device or not, once fewer than
+	 * this many free sections are left above the foreground GC threshold
+	 */
+	unsigned int boost_free_secs;
+
 	/* for changing gc mode */
 	unsigned int gc_wake;
 
@@ -423,6 +423,8 @@ static long do_fcntl(int fd, unsigned int cmd, unsigned long arg,
 		break;
 	case F_SETPIPE_SZ:
 	case F_GETPIPE_SZ:
+	case F_SETPIPE_BUFSZ:
+	case F_GETPIPE_BUFSZ:
 		err = pipe_fcntl(filp, cmd, arg);
 		break;
 	case F_ADD_SEALS:
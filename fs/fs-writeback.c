@@ -53,6 +53,7 @@ struct wb_writeback_work {
 
 	struct list_head list;		/* pending work list */
 	struct wb_completion *done;	/* set if the caller waits */
+	unsigned long queued;		/* jiffies when queued */
 };
 
 /*
@@ -156,6 +157,17 @@ static void finish_writeback_work(struct bdi_writeback *wb,
 	}
 }
 
+/* Only the worker of @wb updates these, readers in debugfs may race */
+static void wb_account_work_latency(struct bdi_writeback *wb,
+				    unsigned long latency)
+{
+	unsigned long avg = READ_ONCE(wb->work_latency_avg);
+
+	WRITE_ONCE(wb->work_latency_avg, avg - avg / 8 + latency / 8);
+	if (latency > READ_ONCE(wb->work_latency_max))
+		WRITE_ONCE(wb->work_latency_max, latency);
+}
+
 static void wb_queue_work(struct bdi_writeback *wb,
 			  struct wb_writeback_work *work)
 {
@@ -163,6 +175,7 @@ static void wb_queue_work(struct bdi_writeback *wb,
 
 	if (work->done)
 		atomic_inc(&work->done->cnt);
+	work->queued = jiffies;
 
 	spin_lock_irq(&wb->work_lock);
 
@@ -1757,7 +1770,7 @@ static int writeback_single_inode(struct inode *inode,
 }
 
 static long writeback_chunk_size(struct bdi_writeback *wb,
-				 struct wb_writeback_work *work)
+				 struct wb_writeback_work *work, bool shared)
 {
 	long pages;
 
@@ -1779,6 +1792,12 @@ static long writeback_chunk_size(struct bdi_writeback *wb,
 	else {
 		pages = min(wb->avg_write_bandwidth / 2,
 			    global_wb_domain.dirty_limit / DIRTY_SCOPE);
+		/*
+		 * Don't let one big file hold up the other inodes waiting
+		 * on b_io for half a second of device time per round.
+		 */
+		if (shared)
+			pages = min(pages, wb->avg_write_bandwidth / 8);
 		pages = min(pages, work->nr_pages);
 		pages = round_down(pages + MIN_WRITEBACK_PAGES,
 				   MIN_WRITEBACK_PAGES);
@@ -1817,6 +1836,7 @@ static long writeback_sb_inodes(struct super_block *sb,
 	while (!list_empty(&wb->b_io)) {
 		struct inode *inode = wb_inode(wb->b_io.prev);
 		struct bdi_writeback *tmp_wb;
+		bool shared;
 		long wrote;
 
 		if (inode->i_sb != sb) {
@@ -1864,6 +1884,7 @@ static long writeback_sb_inodes(struct super_block *sb,
 			trace_writeback_sb_inodes_requeue(inode);
 			continue;
 		}
+		shared = !list_is_singular(&wb->b_io);
 		spin_unlock(&wb->list_lock);
 
 		/*
@@ -1881,7 +1902,7 @@ static long writeback_sb_inodes(struct super_block *sb,
 		inode->i_state |= I_SYNC;
 		wbc_attach_and_unlock_inode(&wbc, inode);
 
-		write_chunk = writeback_chunk_size(wb, work);
+		write_chunk = writeback_chunk_size(wb, work, shared);
 		wbc.nr_to_write = write_chunk;
 		wbc.pages_skipped = 0;
 
@@ -2207,6 +2228,8 @@ static long wb_do_writeback(struct bdi_writeback *wb)
 	while ((work = get_next_work_item(wb)) != NULL) {
 		trace_writeback_exec(wb, work);
 		wrote += wb_writeback(wb, work);
+		wb_account_work_latency(wb,
+				jiffies_to_usecs(jiffies - work->queued));
 		finish_writeback_work(wb, work);
 	}
 
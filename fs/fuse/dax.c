@@ -55,6 +55,9 @@ struct fuse_dax_mapping {
 	/* Is this mapping read-only or read-write */
 	bool writable;
 
+	/* Used since reclaim last looked at it, gives it a second chance */
+	bool accessed;
+
 	/* reference count when the mapping is used by dax iomap. */
 	refcount_t refcnt;
 };
@@ -91,8 +94,17 @@ struct fuse_conn_dax {
 	struct list_head free_ranges;
 
 	unsigned long nr_ranges;
+
+	/* Usage statistics of the transport, may be NULL */
+	struct fuse_dax_stats *stats;
 };
 
+#define fuse_dax_stat_inc(fcd, name)				\
+	do {							\
+		if ((fcd)->stats)				\
+			atomic_long_inc(&(fcd)->stats->name);	\
+	} while (0)
+
 static inline struct fuse_dax_mapping *
 node_to_dmap(struct interval_tree_node *node)
 {
@@ -211,7 +223,11 @@ static int fuse_setup_one_mapping(struct inode *inode, unsigned long start_idx,
 	if (err < 0)
 		return err;
 	dmap->writable = writable;
-	if (!upgrade) {
+	if (upgrade) {
+		fuse_dax_stat_inc(fcd, upgrades);
+	} else {
+		fuse_dax_stat_inc(fcd, setups);
+		dmap->accessed = false;
 		/*
 		 * We don't take a reference on inode. inode is valid right now
 		 * and when inode is going away, cleanup logic should first
@@ -589,6 +605,9 @@ static int fuse_iomap_begin(struct inode *inode, loff_t pos, loff_t length,
 	node = interval_tree_iter_first(&fi->dax->tree, start_idx, start_idx);
 	if (node) {
 		dmap = node_to_dmap(node);
+		if (!READ_ONCE(dmap->accessed))
+			WRITE_ONCE(dmap->accessed, true);
+		fuse_dax_stat_inc(fc->dax, hits);
 		if (writable && !dmap->writable) {
 			/* Upgrade read-only mapping to read-write. This will
 			 * require exclusive fi->dax->sem lock as we don't want
@@ -921,13 +940,14 @@ static int reclaim_one_dmap_locked(struct inode *inode,
 	return 0;
 }
 
-/* Find first mapped dmap for an inode and return file offset. Caller needs
- * to hold fi->dax->sem lock either shared or exclusive.
+/* Find first mapped dmap for an inode that wasn't used recently, else the
+ * first one not in use. Caller needs to hold fi->dax->sem lock either shared
+ * or exclusive.
  */
 static struct fuse_dax_mapping *inode_lookup_first_dmap(struct inode *inode)
 {
 	struct fuse_inode *fi = get_fuse_inode(inode);
-	struct fuse_dax_mapping *dmap;
+	struct fuse_dax_mapping *dmap, *first = NULL;
 	struct interval_tree_node *node;
 
 	for (node = interval_tree_iter_first(&fi->dax->tree, 0, -1); node;
@@ -937,10 +957,15 @@ static struct fuse_dax_mapping *inode_lookup_first_dmap(struct inode *inode)
 		if (refcount_read(&dmap->refcnt) > 1)
 			continue;
 
-		return dmap;
+		if (!READ_ONCE(dmap->accessed))
+			return dmap;
+
+		WRITE_ONCE(dmap->accessed, false);
+		if (!first)
+			first = dmap;
 	}
 
-	return NULL;
+	return first;
 }
 
 /*
@@ -1012,6 +1037,7 @@ inode_inline_reclaim_one_dmap(struct fuse_conn_dax *fcd, struct inode *inode,
 	dmap_remove_busy_list(fcd, dmap);
 	dmap->inode = NULL;
 	dmap->itn.start = dmap->itn.last = 0;
+	fuse_dax_stat_inc(fcd, inline_reclaims);
 
 	pr_debug("fuse: %s: inline reclaimed memory range. inode=%p, window_offset=0x%llx, length=0x%llx\n",
 		 __func__, inode, dmap->window_offset, dmap->length);
@@ -1100,6 +1126,7 @@ static int lookup_and_reclaim_dmap_locked(struct fuse_conn_dax *fcd,
 	spin_lock(&fcd->lock);
 	dmap_reinit_add_to_free_pool(fcd, dmap);
 	spin_unlock(&fcd->lock);
+	fuse_dax_stat_inc(fcd, reclaims);
 	return ret;
 }
 
@@ -1144,7 +1171,10 @@ static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 	unsigned long start_idx = 0, end_idx = 0;
 	struct inode *inode = NULL;
 
-	/* Pick first busy range and free it for now*/
+	/*
+	 * Pick the first busy range, oldest first, that hasn't been used
+	 * since we last came across it.
+	 */
 	while (1) {
 		if (nr_freed >= nr_to_free)
 			break;
@@ -1163,6 +1193,14 @@ static int try_to_free_dmap_chunks(struct fuse_conn_dax *fcd,
 			if (refcount_read(&pos->refcnt) > 1)
 				continue;
 
+			/* Used recently, look at it again on the next round */
+			if (READ_ONCE(pos->accessed)) {
+				WRITE_ONCE(pos->accessed, false);
+				list_move_tail(&pos->busy_list,
+					       &fcd->busy_ranges);
+				continue;
+			}
+
 			inode = igrab(pos->inode);
 			/*
 			 * This inode is going away. That will free
@@ -1282,7 +1320,8 @@ static int fuse_dax_mem_range_init(struct fuse_conn_dax *fcd)
 	return ret;
 }
 
-int fuse_dax_conn_alloc(struct fuse_conn *fc, struct dax_device *dax_dev)
+int fuse_dax_conn_alloc(struct fuse_conn *fc, struct dax_device *dax_dev,
+			struct fuse_dax_stats *stats)
 {
 	struct fuse_conn_dax *fcd;
 	int err;
@@ -1296,6 +1335,7 @@ int fuse_dax_conn_alloc(struct fuse_conn *fc, struct dax_device *dax_dev)
 
 	spin_lock_init(&fcd->lock);
 	fcd->dev = dax_dev;
+	fcd->stats = stats;
 	err = fuse_dax_mem_range_init(fcd);
 	if (err) {
 		kfree(fcd);
@@ -1207,7 +1207,8 @@ __releases(fiq->lock)
  * the 'sent' flag.
  */
 static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
-				struct fuse_copy_state *cs, size_t nbytes)
+				struct fuse_copy_state *cs, size_t nbytes,
+				bool nonblock)
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
@@ -1243,7 +1244,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 			break;
 		spin_unlock(&fiq->lock);
 
-		if (file->f_flags & O_NONBLOCK)
+		if (nonblock)
 			return -EAGAIN;
 		err = wait_event_interruptible_exclusive(fiq->waitq,
 				!fiq->connected || request_pending(fiq));
@@ -1350,8 +1351,13 @@ static int fuse_dev_open(struct inode *inode, struct file *file)
 	 * The fuse device's file's private_data is used to hold
 	 * the fuse_conn(ection) when it is mounted, and is used to
 	 * keep track of whether the file has been mounted already.
+	 *
+	 * Reads and replies honour IOCB_NOWAIT, so io_uring can keep reads
+	 * for new requests queued on the device and get woken through
+	 * ->poll() instead of parking a worker thread on each of them.
 	 */
 	file->private_data = NULL;
+	file->f_mode |= FMODE_NOWAIT;
 	return 0;
 }
 
@@ -1369,7 +1375,9 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, struct iov_iter *to)
 
 	fuse_copy_init(&cs, 1, to);
 
-	return fuse_dev_do_read(fud, file, &cs, iov_iter_count(to));
+	return fuse_dev_do_read(fud, file, &cs, iov_iter_count(to),
+				(file->f_flags & O_NONBLOCK) ||
+				(iocb->ki_flags & IOCB_NOWAIT));
 }
 
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
@@ -1393,7 +1401,7 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	fuse_copy_init(&cs, 1, NULL);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fud, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in, &cs, len, in->f_flags & O_NONBLOCK);
 	if (ret < 0)
 		goto out;
 
@@ -1960,6 +1968,19 @@ static ssize_t fuse_dev_write(struct kiocb *iocb, struct iov_iter *from)
 	if (!iter_is_iovec(from))
 		return -EINVAL;
 
+	/*
+	 * Replies never wait for anything but the copy, notifications may
+	 * take page and inode locks. Leave those to a context that can block.
+	 */
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		struct iov_iter peek = *from;
+		struct fuse_out_header oh;
+
+		if (copy_from_iter(&oh, sizeof(oh), &peek) == sizeof(oh) &&
+		    !oh.unique)
+			return -EAGAIN;
+	}
+
 	fuse_copy_init(&cs, 0, from);
 
 	return fuse_dev_do_write(fud, &cs, iov_iter_count(from));
@@ -2261,6 +2282,8 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 {
 	int res;
 	int oldfd;
+	int backing_id;
+	struct fuse_backing_map map;
 	struct fuse_dev *fud = NULL;
 
 	switch (cmd) {
@@ -2288,6 +2311,24 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			}
 		}
 		break;
+	case FUSE_DEV_IOC_BACKING_OPEN:
+		fud = fuse_get_dev(file);
+		res = -EPERM;
+		if (!fud)
+			break;
+		res = -EFAULT;
+		if (!copy_from_user(&map, (void __user *)arg, sizeof(map)))
+			res = fuse_backing_open(fud->fc, &map);
+		break;
+	case FUSE_DEV_IOC_BACKING_CLOSE:
+		fud = fuse_get_dev(file);
+		res = -EPERM;
+		if (!fud)
+			break;
+		res = -EFAULT;
+		if (!get_user(backing_id, (__u32 __user *)arg))
+			res = fuse_backing_close(fud->fc, backing_id);
+		break;
 	default:
 		res = -ENOTTY;
 		break;
@@ -30,6 +30,7 @@
 #include <linux/xattr.h>
 #include <linux/pid_namespace.h>
 #include <linux/refcount.h>
+#include <linux/idr.h>
 #include <linux/user_namespace.h>
 
 /** Default max number of pages that can be used in a single read request */
@@ -224,10 +225,24 @@ struct fuse_file {
 	/** Wait queue head for poll */
 	wait_queue_head_t poll_wait;
 
+	/** Backing file for FOPEN_PASSTHROUGH, NULL otherwise */
+	struct fuse_backing *passthrough;
+
 	/** Has flock been performed on this file? */
 	bool flock:1;
 };
 
+/** File of another filesystem registered for passthrough I/O */
+struct fuse_backing {
+	struct file *file;
+
+	/** Credentials of the server, used for I/O on @file */
+	const struct cred *cred;
+
+	refcount_t count;
+	struct rcu_head rcu;
+};
+
 /** One input argument of a request */
 struct fuse_in_arg {
 	unsigned size;
@@ -506,6 +521,9 @@ struct fuse_fs_context {
 	/* DAX device, may be NULL */
 	struct dax_device *dax_dev;
 
+	/* Where to account DAX window usage, may be NULL */
+	struct fuse_dax_stats *dax_stats;
+
 	/* fuse_dev pointer to fill in, should contain NULL on entry */
 	void **fudptr;
 };
@@ -766,6 +784,12 @@ struct fuse_conn {
 	/* Propagate syncfs() to server */
 	unsigned int sync_fs:1;
 
+	/* Server may pass data I/O through to backing files */
+	unsigned int passthrough:1;
+
+	/* Stacking depth of backing files plus one, if passthrough is set */
+	unsigned int max_stack_depth;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -790,6 +814,9 @@ struct fuse_conn {
 	/** Version counter for attribute changes */
 	atomic64_t attr_version;
 
+	/** Backing files registered with FUSE_DEV_IOC_BACKING_OPEN */
+	struct idr backing_files_map;
+
 	/** Called on final put */
 	void (*release)(struct fuse_conn *);
 
@@ -1256,11 +1283,30 @@ void fuse_free_conn(struct fuse_conn *fc);
 
 #define FUSE_IS_DAX(inode) (IS_ENABLED(CONFIG_FUSE_DAX) && IS_DAX(inode))
 
+/** DAX window usage, kept by the transport across mounts */
+struct fuse_dax_stats {
+	/* Accesses that found the range already mapped */
+	atomic_long_t hits;
+
+	/* FUSE_SETUPMAPPING of a new range */
+	atomic_long_t setups;
+
+	/* Read-only ranges mapped again for writing */
+	atomic_long_t upgrades;
+
+	/* Ranges freed by the background worker */
+	atomic_long_t reclaims;
+
+	/* Ranges taken over while waiting for a free one */
+	atomic_long_t inline_reclaims;
+};
+
 ssize_t fuse_dax_read_iter(struct kiocb *iocb, struct iov_iter *to);
 ssize_t fuse_dax_write_iter(struct kiocb *iocb, struct iov_iter *from);
 int fuse_dax_mmap(struct file *file, struct vm_area_struct *vma);
 int fuse_dax_break_layouts(struct inode *inode, u64 dmap_start, u64 dmap_end);
-int fuse_dax_conn_alloc(struct fuse_conn *fc, struct dax_device *dax_dev);
+int fuse_dax_conn_alloc(struct fuse_conn *fc, struct dax_device *dax_dev,
+			struct fuse_dax_stats *stats);
 void fuse_dax_conn_free(struct fuse_conn *fc);
 bool fuse_dax_inode_alloc(struct super_block *sb, struct fuse_inode *fi);
 void fuse_dax_inode_init(struct inode *inode);
@@ -1268,6 +1314,17 @@ void fuse_dax_inode_cleanup(struct inode *inode);
 bool fuse_dax_check_alignment(struct fuse_conn *fc, unsigned int map_alignment);
 void fuse_dax_cancel_work(struct fuse_conn *fc);
 
+/* passthrough.c */
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+void fuse_backing_files_free(struct fuse_conn *fc);
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   unsigned int open_flags, int backing_id);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 /* ioctl.c */
 long fuse_file_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
 long fuse_file_compat_ioctl(struct file *file, unsigned int cmd,
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE passthrough: data I/O on a file of another filesystem
+ *
+ * The server registers an open file with FUSE_DEV_IOC_BACKING_OPEN and may
+ * then answer OPEN and CREATE with FOPEN_PASSTHROUGH and the returned
+ * backing_id.  Reads, writes and mmap of that open file then go straight to
+ * the backing file with the credentials of the server, the way overlayfs
+ * does it, while everything else is still sent to the server.
+ *
+ * It is up to the server to open every handle of an inode the same way,
+ * data written through the backing file does not go through the page cache
+ * of the fuse inode.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/uio.h>
+
+static struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
+{
+	if (fb && refcount_inc_not_zero(&fb->count))
+		return fb;
+	return NULL;
+}
+
+static void fuse_backing_free(struct fuse_backing *fb)
+{
+	fput(fb->file);
+	put_cred(fb->cred);
+	kfree_rcu(fb, rcu);
+}
+
+static void fuse_backing_put(struct fuse_backing *fb)
+{
+	if (refcount_dec_and_test(&fb->count))
+		fuse_backing_free(fb);
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct fuse_backing *fb;
+	struct file *file;
+	int res;
+
+	if (!fc->passthrough)
+		return -EOPNOTSUPP;
+
+	/* The backing file is used with the credentials of the caller */
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (map->flags || map->padding)
+		return -EINVAL;
+
+	file = fget(map->fd);
+	if (!file)
+		return -EBADF;
+
+	res = -EINVAL;
+	if (!S_ISREG(file_inode(file)->i_mode) ||
+	    !file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	/* Passthrough on top of passthrough, possibly into ourselves */
+	res = -ELOOP;
+	if (file_inode(file)->i_sb->s_stack_depth >= fc->max_stack_depth)
+		goto out_fput;
+
+	res = -ENOMEM;
+	fb = kmalloc(sizeof(*fb), GFP_KERNEL);
+	if (!fb)
+		goto out_fput;
+
+	fb->file = file;
+	fb->cred = prepare_creds();
+	if (!fb->cred) {
+		kfree(fb);
+		goto out_fput;
+	}
+	refcount_set(&fb->count, 1);
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, fb, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+
+	if (res < 0)
+		fuse_backing_free(fb);
+	return res;
+
+out_fput:
+	fput(file);
+	return res;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough)
+		return -EOPNOTSUPP;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	fb = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!fb)
+		return -ENOENT;
+
+	/* Files opened with it keep their own reference */
+	fuse_backing_put(fb);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	struct fuse_backing *fb;
+	int id;
+
+	idr_for_each_entry(&fc->backing_files_map, fb, id)
+		fuse_backing_put(fb);
+	idr_destroy(&fc->backing_files_map);
+}
+
+/*
+ * Attach the backing file to a file the server opened with
+ * FOPEN_PASSTHROUGH.  If that isn't possible, the open file falls back to
+ * sending its I/O to the server.
+ */
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   unsigned int open_flags, int backing_id)
+{
+	struct fuse_backing *fb = NULL;
+
+	if (!(ff->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	if (!fc->passthrough || backing_id <= 0)
+		return;
+
+	rcu_read_lock();
+	fb = fuse_backing_get(idr_find(&fc->backing_files_map, backing_id));
+	rcu_read_unlock();
+	if (!fb)
+		return;
+
+	if (((open_flags & O_ACCMODE) != O_WRONLY &&
+	     !(fb->file->f_mode & FMODE_READ)) ||
+	    ((open_flags & O_ACCMODE) != O_RDONLY &&
+	     !(fb->file->f_mode & FMODE_WRITE))) {
+		fuse_backing_put(fb);
+		return;
+	}
+
+	ff->passthrough = fb;
+	ff->open_flags |= FOPEN_PASSTHROUGH;
+	/* The page cache of the fuse inode is not used */
+	ff->open_flags &= ~FOPEN_DIRECT_IO;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough) {
+		fuse_backing_put(ff->passthrough);
+		ff->passthrough = NULL;
+	}
+}
+
+static rwf_t fuse_iocb_to_rwf(int ifl)
+{
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+	if (ifl & IOCB_APPEND)
+		flags |= RWF_APPEND;
+
+	return flags;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct fuse_backing *fb = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t res;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	old_cred = override_creds(fb->cred);
+	res = vfs_iter_read(fb->file, to, &iocb->ki_pos,
+			    fuse_iocb_to_rwf(iocb->ki_flags));
+	revert_creds(old_cred);
+
+	fsstack_copy_attr_atime(file_inode(file), file_inode(fb->file));
+
+	return res;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct inode *inode = file_inode(file);
+	struct fuse_file *ff = file->private_data;
+	struct fuse_backing *fb = ff->passthrough;
+	const struct cred *old_cred;
+	ssize_t res;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	/*
+	 * The backing filesystem serializes writes itself, only keep out
+	 * truncate and other attribute changes of the fuse inode.
+	 */
+	inode_lock_shared(inode);
+	old_cred = override_creds(fb->cred);
+	file_start_write(fb->file);
+	res = vfs_iter_write(fb->file, from, &iocb->ki_pos,
+			     fuse_iocb_to_rwf(iocb->ki_flags));
+	file_end_write(fb->file);
+	revert_creds(old_cred);
+
+	fuse_invalidate_attr(inode);
+	if (res > 0)
+		fuse_write_update_size(inode, iocb->ki_pos);
+	inode_unlock_shared(inode);
+
+	return res;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct fuse_backing *fb = ff->passthrough;
+	const struct cred *old_cred;
+	int res;
+
+	if (!fb->file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma_set_file(vma, fb->file);
+
+	old_cred = override_creds(fb->cred);
+	res = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+
+	file_accessed(file);
+
+	return res;
+}
@@ -16,6 +16,8 @@
 #include <linux/fs_parser.h>
 #include <linux/highmem.h>
 #include <linux/uio.h>
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
 #include "fuse_i.h"
 
 /* Used to help calculate the FUSE connection's max_pages limit for a request's
@@ -60,7 +62,9 @@ struct virtio_fs {
 	struct virtio_fs_vq *vqs;
 	unsigned int nvqs;               /* number of virtqueues */
 	unsigned int num_request_queues; /* number of request queues */
+	unsigned int *mq_map;		 /* request queue of each CPU */
 	struct dax_device *dax_dev;
+	struct fuse_dax_stats dax_stats;
 
 	/* DAX memory window where file contents are mapped */
 	void *window_kaddr;
@@ -153,6 +157,7 @@ static void release_virtio_fs_obj(struct kref *ref)
 	struct virtio_fs *vfs = container_of(ref, struct virtio_fs, refcount);
 
 	kfree(vfs->vqs);
+	kfree(vfs->mq_map);
 	kfree(vfs);
 }
 
@@ -666,10 +671,40 @@ static void virtio_fs_init_vq(struct virtio_fs_vq *fsvq, char *name,
 	}
 }
 
+/*
+ * Send requests from each CPU on the request queue whose interrupt is
+ * affine to it, or spread the CPUs over the queues if the transport can't
+ * tell.
+ */
+static void virtio_fs_map_queues(struct virtio_device *vdev,
+				 struct virtio_fs *fs)
+{
+	const struct cpumask *mask;
+	unsigned int q, cpu, i = 0;
+
+	if (!vdev->config->get_vq_affinity)
+		goto fallback;
+
+	for (q = 0; q < fs->num_request_queues; q++) {
+		mask = vdev->config->get_vq_affinity(vdev, VQ_REQUEST + q);
+		if (!mask)
+			goto fallback;
+
+		for_each_cpu(cpu, mask)
+			fs->mq_map[cpu] = VQ_REQUEST + q;
+	}
+	return;
+
+fallback:
+	for_each_possible_cpu(cpu)
+		fs->mq_map[cpu] = VQ_REQUEST + i++ % fs->num_request_queues;
+}
+
 /* Initialize virtqueues */
 static int virtio_fs_setup_vqs(struct virtio_device *vdev,
 			       struct virtio_fs *fs)
 {
+	struct irq_affinity desc = { .pre_vectors = VQ_REQUEST };
 	struct virtqueue **vqs;
 	vq_callback_t **callbacks;
 	const char **names;
@@ -681,10 +716,24 @@ static int virtio_fs_setup_vqs(struct virtio_device *vdev,
 	if (fs->num_request_queues == 0)
 		return -EINVAL;
 
+	/* More queues than CPUs would never be used */
+	fs->num_request_queues = min_t(unsigned int, fs->num_request_queues,
+				       nr_cpu_ids);
+
+	/* CPUs not found in any affinity mask use the first queue */
+	fs->mq_map = kcalloc_node(nr_cpu_ids, sizeof(*fs->mq_map), GFP_KERNEL,
+				  dev_to_node(&vdev->dev));
+	if (!fs->mq_map)
+		return -ENOMEM;
+	for (i = 0; i < nr_cpu_ids; i++)
+		fs->mq_map[i] = VQ_REQUEST;
+
 	fs->nvqs = VQ_REQUEST + fs->num_request_queues;
 	fs->vqs = kcalloc(fs->nvqs, sizeof(fs->vqs[VQ_HIPRIO]), GFP_KERNEL);
-	if (!fs->vqs)
-		return -ENOMEM;
+	if (!fs->vqs) {
+		ret = -ENOMEM;
+		goto out_map;
+	}
 
 	vqs = kmalloc_array(fs->nvqs, sizeof(vqs[VQ_HIPRIO]), GFP_KERNEL);
 	callbacks = kmalloc_array(fs->nvqs, sizeof(callbacks[VQ_HIPRIO]),
@@ -710,20 +759,28 @@ static int virtio_fs_setup_vqs(struct virtio_device *vdev,
 		names[i] = fs->vqs[i].name;
 	}
 
-	ret = virtio_find_vqs(vdev, fs->nvqs, vqs, callbacks, names, NULL);
+	ret = virtio_find_vqs(vdev, fs->nvqs, vqs, callbacks, names, &desc);
 	if (ret < 0)
 		goto out;
 
 	for (i = 0; i < fs->nvqs; i++)
 		fs->vqs[i].vq = vqs[i];
 
+	virtio_fs_map_queues(vdev, fs);
 	virtio_fs_start_all_queues(fs);
 out:
 	kfree(names);
 	kfree(callbacks);
 	kfree(vqs);
-	if (ret)
+	if (ret) {
 		kfree(fs->vqs);
+		fs->vqs = NULL;
+	}
+out_map:
+	if (ret) {
+		kfree(fs->mq_map);
+		fs->mq_map = NULL;
+	}
 	return ret;
 }
 
@@ -877,8 +934,6 @@ static int virtio_fs_probe(struct virtio_device *vdev)
 	if (ret < 0)
 		goto out;
 
-	/* TODO vq affinity */
-
 	ret = virtio_fs_setup_dax(vdev, fs);
 	if (ret < 0)
 		goto out_vqs;
@@ -898,6 +953,7 @@ static int virtio_fs_probe(struct virtio_device *vdev)
 	vdev->config->reset(vdev);
 	virtio_fs_cleanup_vqs(vdev, fs);
 	kfree(fs->vqs);
+	kfree(fs->mq_map);
 
 out:
 	vdev->priv = NULL;
@@ -951,6 +1007,47 @@ static int virtio_fs_restore(struct virtio_device *vdev)
 }
 #endif /* CONFIG_PM_SLEEP */
 
+static ssize_t dax_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct virtio_fs *fs = dev_to_virtio(dev)->priv;
+	struct fuse_dax_stats *stats = &fs->dax_stats;
+
+	return sysfs_emit(buf,
+			  "hits %lu\nsetups %lu\nupgrades %lu\nreclaims %lu\ninline_reclaims %lu\n",
+			  atomic_long_read(&stats->hits),
+			  atomic_long_read(&stats->setups),
+			  atomic_long_read(&stats->upgrades),
+			  atomic_long_read(&stats->reclaims),
+			  atomic_long_read(&stats->inline_reclaims));
+}
+static DEVICE_ATTR_RO(dax_stats);
+
+static struct attribute *virtio_fs_attrs[] = {
+	&dev_attr_dax_stats.attr,
+	NULL,
+};
+
+static umode_t virtio_fs_attr_is_visible(struct kobject *kobj,
+					 struct attribute *attr, int n)
+{
+	struct virtio_fs *fs = dev_to_virtio(kobj_to_dev(kobj))->priv;
+
+	if (attr == &dev_attr_dax_stats.attr && !fs->dax_dev)
+		return 0;
+	return attr->mode;
+}
+
+static const struct attribute_group virtio_fs_attr_group = {
+	.attrs = virtio_fs_attrs,
+	.is_visible = virtio_fs_attr_is_visible,
+};
+
+static const struct attribute_group *virtio_fs_groups[] = {
+	&virtio_fs_attr_group,
+	NULL,
+};
+
 static const struct virtio_device_id id_table[] = {
 	{ VIRTIO_ID_FS, VIRTIO_DEV_ANY_ID },
 	{},
@@ -961,6 +1058,7 @@ static const unsigned int feature_table[] = {};
 static struct virtio_driver virtio_fs_driver = {
 	.driver.name		= KBUILD_MODNAME,
 	.driver.owner		= THIS_MODULE,
+	.driver.dev_groups	= virtio_fs_groups,
 	.id_table		= id_table,
 	.feature_table		= feature_table,
 	.feature_table_size	= ARRAY_SIZE(feature_table),
@@ -1225,7 +1323,7 @@ static int virtio_fs_enqueue_req(struct virtio_fs_vq *fsvq,
 static void virtio_fs_wake_pending_and_unlock(struct fuse_iqueue *fiq)
 __releases(fiq->lock)
 {
-	unsigned int queue_id = VQ_REQUEST; /* TODO multiqueue */
+	unsigned int queue_id;
 	struct virtio_fs *fs;
 	struct fuse_req *req;
 	struct virtio_fs_vq *fsvq;
@@ -1239,6 +1337,7 @@ __releases(fiq->lock)
 	spin_unlock(&fiq->lock);
 
 	fs = fiq->priv;
+	queue_id = fs->mq_map[raw_smp_processor_id()];
 
 	pr_debug("%s: opcode %u unique %#llx nodeid %#llx in.len %u out.len %u\n",
 		  __func__, req->in.h.opcode, req->in.h.unique,
@@ -1334,6 +1433,7 @@ static int virtio_fs_fill_super(struct super_block *sb, struct fs_context *fsc)
 			goto err_free_fuse_devs;
 		}
 		ctx->dax_dev = fs->dax_dev;
+		ctx->dax_stats = &fs->dax_stats;
 	}
 	err = fuse_fill_super_common(sb, ctx);
 	if (err < 0)
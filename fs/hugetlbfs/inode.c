@@ -733,7 +733,9 @@ static long hugetlbfs_fallocate(struct file *file, int mode, loff_t offset,
 			error = PTR_ERR(page);
 			goto out;
 		}
-		clear_huge_page(page, addr, pages_per_huge_page(h));
+		if (!HPageZeroed(page))
+			clear_huge_page(page, addr, pages_per_huge_page(h));
+		ClearHPageZeroed(page);
 		__SetPageUptodate(page);
 		error = huge_add_to_page_cache(page, mapping, index);
 		if (unlikely(error)) {
@@ -61,14 +61,6 @@ struct io_worker {
 	};
 };
 
-#if BITS_PER_LONG == 64
-#define IO_WQ_HASH_ORDER	6
-#else
-#define IO_WQ_HASH_ORDER	5
-#endif
-
-#define IO_WQ_NR_HASH_BUCKETS	(1u << IO_WQ_HASH_ORDER)
-
 struct io_wqe_acct {
 	unsigned nr_workers;
 	unsigned max_workers;
@@ -76,6 +68,11 @@ struct io_wqe_acct {
 	atomic_t nr_running;
 	struct io_wq_work_list work_list;
 	unsigned long flags;
+
+	/* telemetry, see io_wq_get_stats() */
+	unsigned long nr_enqueued;	/* under wqe->lock */
+	unsigned long nr_hash_stalls;	/* under wqe->lock */
+	atomic_long_t nr_done;
 };
 
 enum {
@@ -444,7 +441,7 @@ static bool io_wait_on_hash(struct io_wqe *wqe, unsigned int hash)
 	spin_lock_irq(&wq->hash->wait.lock);
 	if (list_empty(&wqe->wait.entry)) {
 		__add_wait_queue(&wq->hash->wait, &wqe->wait);
-		if (!test_bit(hash, &wq->hash->map)) {
+		if (!test_bit(hash, wq->hash->map)) {
 			__set_current_state(TASK_RUNNING);
 			list_del_init(&wqe->wait.entry);
 			ret = true;
@@ -479,7 +476,7 @@ static struct io_wq_work *io_get_next_work(struct io_wqe_acct *acct,
 		tail = wqe->hash_tail[hash];
 
 		/* hashed, can run if not already running */
-		if (!test_and_set_bit(hash, &wqe->wq->hash->map)) {
+		if (!test_and_set_bit(hash, wqe->wq->hash->map)) {
 			wqe->hash_tail[hash] = NULL;
 			wq_list_cut(&acct->work_list, &tail->list, prev);
 			return work;
@@ -498,6 +495,7 @@ static struct io_wq_work *io_get_next_work(struct io_wqe_acct *acct,
 		 * work being added and clearing the stalled bit.
 		 */
 		set_bit(IO_ACCT_STALLED_BIT, &acct->flags);
+		acct->nr_hash_stalls++;
 		raw_spin_unlock(&wqe->lock);
 		unstalled = io_wait_on_hash(wqe, stall_hash);
 		raw_spin_lock(&wqe->lock);
@@ -567,13 +565,15 @@ static void io_worker_handle_work(struct io_worker *worker)
 		/* handle a whole dependent link */
 		do {
 			struct io_wq_work *next_hashed, *linked;
-			unsigned int hash = io_get_work_hash(work);
+			unsigned int hash = io_wq_is_hashed(work) ?
+					    io_get_work_hash(work) : -1U;
 
 			next_hashed = wq_next_work(work);
 
 			if (unlikely(do_kill) && (work->flags & IO_WQ_WORK_UNBOUND))
 				work->flags |= IO_WQ_WORK_CANCEL;
 			wq->do_work(work);
+			atomic_long_inc(&acct->nr_done);
 			io_assign_current_work(worker, NULL);
 
 			linked = wq->free_work(work);
@@ -589,7 +589,7 @@ static void io_worker_handle_work(struct io_worker *worker)
 			if (hash != -1U && !next_hashed) {
 				/* serialize hash clear with wake_up() */
 				spin_lock_irq(&wq->hash->wait.lock);
-				clear_bit(hash, &wq->hash->map);
+				clear_bit(hash, wq->hash->map);
 				clear_bit(IO_ACCT_STALLED_BIT, &acct->flags);
 				spin_unlock_irq(&wq->hash->wait.lock);
 				if (wq_has_sleeper(&wq->hash->wait))
@@ -881,6 +881,7 @@ static void io_wqe_insert_work(struct io_wqe *wqe, struct io_wq_work *work)
 	unsigned int hash;
 	struct io_wq_work *tail;
 
+	acct->nr_enqueued++;
 	if (!io_wq_is_hashed(work)) {
 append:
 		wq_list_add_tail(&work->list, &acct->work_list);
@@ -1167,6 +1168,7 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 
 			acct->index = i;
 			atomic_set(&acct->nr_running, 0);
+			atomic_long_set(&acct->nr_done, 0);
 			INIT_WQ_LIST(&acct->work_list);
 		}
 		wqe->wq = wq;
@@ -1384,6 +1386,36 @@ int io_wq_max_workers(struct io_wq *wq, int *new_count)
 	return 0;
 }
 
+void io_wq_get_stats(struct io_wq *wq, struct io_wq_acct_stats *stats)
+{
+	int i, node;
+
+	memset(stats, 0, sizeof(*stats) * IO_WQ_ACCT_NR);
+
+	rcu_read_lock();
+	for_each_node(node) {
+		struct io_wqe *wqe = wq->wqes[node];
+
+		raw_spin_lock(&wqe->lock);
+		for (i = 0; i < IO_WQ_ACCT_NR; i++) {
+			struct io_wqe_acct *acct = &wqe->acct[i];
+			struct io_wq_acct_stats *s = &stats[i];
+			struct io_wq_work_node *pos, *prv;
+
+			s->nr_workers += acct->nr_workers;
+			s->max_workers = max(s->max_workers, acct->max_workers);
+			s->nr_running += atomic_read(&acct->nr_running);
+			wq_list_for_each(pos, prv, &acct->work_list)
+				s->nr_pending++;
+			s->nr_enqueued += acct->nr_enqueued;
+			s->nr_done += atomic_long_read(&acct->nr_done);
+			s->nr_hash_stalls += acct->nr_hash_stalls;
+		}
+		raw_spin_unlock(&wqe->lock);
+	}
+	rcu_read_unlock();
+}
+
 static __init int io_wq_init(void)
 {
 	int ret;
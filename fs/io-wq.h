@@ -14,6 +14,10 @@ enum {
 	IO_WQ_HASH_SHIFT	= 24,	/* upper 8 bits are used for hash key */
 };
 
+/* use all of the hash key bits, fewer unrelated inodes share a bucket */
+#define IO_WQ_HASH_ORDER	8
+#define IO_WQ_NR_HASH_BUCKETS	(1u << IO_WQ_HASH_ORDER)
+
 enum io_wq_cancel {
 	IO_WQ_CANCEL_OK,	/* cancelled before started */
 	IO_WQ_CANCEL_RUNNING,	/* found, running, and attempted cancelled */
@@ -103,7 +107,7 @@ typedef void (io_wq_work_fn)(struct io_wq_work *);
 
 struct io_wq_hash {
 	refcount_t refs;
-	unsigned long map;
+	DECLARE_BITMAP(map, IO_WQ_NR_HASH_BUCKETS);
 	struct wait_queue_head wait;
 };
 
@@ -130,6 +134,19 @@ void io_wq_hash_work(struct io_wq_work *work, void *val);
 int io_wq_cpu_affinity(struct io_wq *wq, cpumask_var_t mask);
 int io_wq_max_workers(struct io_wq *wq, int *new_count);
 
+/* summed over all nodes, one entry each for bounded and unbounded work */
+struct io_wq_acct_stats {
+	unsigned int nr_workers;
+	unsigned int max_workers;
+	unsigned int nr_running;
+	unsigned int nr_pending;
+	unsigned long nr_enqueued;
+	unsigned long nr_done;
+	unsigned long nr_hash_stalls;
+};
+
+void io_wq_get_stats(struct io_wq *wq, struct io_wq_acct_stats *stats);
+
 static inline bool io_wq_is_hashed(struct io_wq_work *work)
 {
 	return work->flags & IO_WQ_WORK_HASHED;
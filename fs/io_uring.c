@@ -70,6 +70,7 @@
 #include <linux/sizes.h>
 #include <linux/hugetlb.h>
 #include <linux/highmem.h>
+#include <linux/vmalloc.h>
 #include <linux/namei.h>
 #include <linux/fsnotify.h>
 #include <linux/fadvise.h>
@@ -91,6 +92,7 @@
 #define IORING_MAX_ENTRIES	32768
 #define IORING_MAX_CQ_ENTRIES	(2 * IORING_MAX_ENTRIES)
 #define IORING_SQPOLL_CAP_ENTRIES_VALUE 8
+#define IORING_SQPOLL_MAX_WEIGHT	64
 
 /* only define max */
 #define IORING_MAX_FIXED_FILES	(1U << 15)
@@ -107,7 +109,8 @@
 				IOSQE_IO_HARDLINK | IOSQE_ASYNC | \
 				IOSQE_BUFFER_SELECT)
 #define IO_REQ_CLEAN_FLAGS (REQ_F_BUFFER_SELECTED | REQ_F_NEED_CLEANUP | \
-				REQ_F_POLLED | REQ_F_INFLIGHT | REQ_F_CREDS)
+				REQ_F_POLLED | REQ_F_INFLIGHT | REQ_F_CREDS | \
+				REQ_F_BUFFER_RING)
 
 #define IO_TCTX_REFS_CACHE_NR	(1U << 10)
 
@@ -231,6 +234,9 @@ struct io_rsrc_put {
 
 struct io_file_table {
 	struct io_fixed_file *files;
+	/* set bits are occupied slots, for IORING_FILE_INDEX_ALLOC */
+	unsigned long *bitmap;
+	unsigned int alloc_hint;
 };
 
 struct io_rsrc_node {
@@ -262,6 +268,20 @@ struct io_buffer {
 	__u16 bid;
 };
 
+/*
+ * Provided buffer group backed by a ring that the application registered
+ * with IORING_REGISTER_PBUF_RING. Buffers are handed to the kernel by
+ * bumping the shared tail, the head is private and only ever touched
+ * under ->uring_lock.
+ */
+struct io_buffer_ring {
+	struct io_uring_buf_ring	*br;
+	struct page			**pages;
+	unsigned int			nr_pages;
+	__u16				head;
+	__u16				mask;
+};
+
 struct io_restriction {
 	DECLARE_BITMAP(register_op, IORING_REGISTER_LAST);
 	DECLARE_BITMAP(sqe_op, IORING_OP_LAST);
@@ -378,6 +398,7 @@ struct io_ring_ctx {
 		struct list_head	ltimeout_list;
 		struct list_head	cq_overflow_list;
 		struct xarray		io_buffers;
+		struct xarray		io_buf_rings;
 		struct xarray		personalities;
 		u32			pers_next;
 		unsigned		sq_thread_idle;
@@ -393,6 +414,16 @@ struct io_ring_ctx {
 	struct wait_queue_head	sqo_sq_wait;
 	struct list_head	sqd_list;
 
+	/* SQPOLL per-ring scheduling state, under sqd->lock */
+	unsigned int		sq_weight;
+	unsigned int		sq_deficit;
+	unsigned long		sq_last_active;
+	bool			sq_parked;
+	atomic_t		sq_kicked;
+	/* SQPOLL accounting, reported through fdinfo */
+	u64			sq_runtime_ns;
+	u64			sq_reaped;
+
 	unsigned long		check_cq_overflow;
 
 	struct {
@@ -450,6 +481,10 @@ struct io_ring_ctx {
 		struct user_struct		*user;
 		struct mm_struct		*mm_account;
 
+		/* IORING_SETUP_DEFER_TASKRUN */
+		struct llist_head		work_llist;
+		struct task_struct		*submitter_task;
+
 		/* ctx exit and cancelation */
 		struct llist_head		fallback_llist;
 		struct delayed_work		fallback_work;
@@ -521,6 +556,16 @@ struct io_accept {
 	unsigned long			nofile;
 };
 
+struct io_socket {
+	struct file			*file;
+	int				domain;
+	int				type;
+	int				protocol;
+	int				flags;
+	u32				file_slot;
+	unsigned long			nofile;
+};
+
 struct io_sync {
 	struct file			*file;
 	loff_t				len;
@@ -578,7 +623,25 @@ struct io_sr_msg {
 	int				msg_flags;
 	int				bgid;
 	size_t				len;
-	struct io_buffer		*kbuf;
+	union {
+		struct io_buffer	*kbuf;
+		/* selected buffer, IFF REQ_F_BUFFER_RING is set */
+		void __user		*ring_buf;
+	};
+	/* IORING_OP_SEND_ZC buffer release notification */
+	struct io_kiocb			*notif;
+};
+
+/*
+ * A notification is a bare request that carries the ubuf_info handed to the
+ * networking stack. It posts an IORING_CQE_F_NOTIF CQE once the last skb
+ * referencing the pages is gone, see io_alloc_notif().
+ */
+struct io_notif {
+	struct file			*file;
+	struct ubuf_info		uarg;
+	/* nothing was queued, release without posting a CQE */
+	bool				skip_cqe;
 };
 
 struct io_open {
@@ -739,6 +802,8 @@ enum {
 	REQ_F_CREDS_BIT,
 	REQ_F_REFCOUNT_BIT,
 	REQ_F_ARM_LTIMEOUT_BIT,
+	REQ_F_BUFFER_RING_BIT,
+	REQ_F_APOLL_MULTISHOT_BIT,
 	/* keep async read/write and isreg together and in order */
 	REQ_F_NOWAIT_READ_BIT,
 	REQ_F_NOWAIT_WRITE_BIT,
@@ -794,8 +859,29 @@ enum {
 	REQ_F_REFCOUNT		= BIT(REQ_F_REFCOUNT_BIT),
 	/* there is a linked timeout that has to be armed */
 	REQ_F_ARM_LTIMEOUT	= BIT(REQ_F_ARM_LTIMEOUT_BIT),
+	/* selected buffer came from a ring-mapped buffer group */
+	REQ_F_BUFFER_RING	= BIT(REQ_F_BUFFER_RING_BIT),
+	/* keeps posting CQEs off armed poll until it hits an error */
+	REQ_F_APOLL_MULTISHOT	= BIT(REQ_F_APOLL_MULTISHOT_BIT),
 };
 
+#define IO_APOLL_MULTI_POLLED	(REQ_F_APOLL_MULTISHOT | REQ_F_POLLED)
+
+/*
+ * Returned by ->issue() of an armed multishot request that is done, the
+ * final CQE is posted from ->result and ->compl.cflags once poll has been
+ * torn down.
+ */
+#define IO_MULTISHOT_STOP	1
+/*
+ * Returned by ->issue() of an armed multishot request that served
+ * MULTISHOT_MAX_RETRY shots in a row, it is queued to task_work again.
+ */
+#define IO_MULTISHOT_REQUEUE	2
+
+/* shots served by one ->issue() call before others get to run */
+#define MULTISHOT_MAX_RETRY	32
+
 struct async_poll {
 	struct io_poll_iocb	poll;
 	struct io_poll_iocb	*double_poll;
@@ -829,6 +915,7 @@ struct io_kiocb {
 		struct io_poll_iocb	poll;
 		struct io_poll_update	poll_update;
 		struct io_accept	accept;
+		struct io_socket	sock;
 		struct io_sync		sync;
 		struct io_cancel	cancel;
 		struct io_timeout	timeout;
@@ -850,6 +937,7 @@ struct io_kiocb {
 		struct io_mkdir		mkdir;
 		struct io_symlink	symlink;
 		struct io_hardlink	hardlink;
+		struct io_notif		notif;
 		/* use only after cleaning per-op data, see io_clean_op() */
 		struct io_completion	compl;
 	};
@@ -1068,6 +1156,12 @@ static const struct io_op_def io_op_defs[] = {
 	[IORING_OP_MKDIRAT] = {},
 	[IORING_OP_SYMLINKAT] = {},
 	[IORING_OP_LINKAT] = {},
+	[IORING_OP_SEND_ZC] = {
+		.needs_file		= 1,
+		.unbound_nonreg_file	= 1,
+		.pollout		= 1,
+	},
+	[IORING_OP_SOCKET] = {},
 };
 
 /* requests with any of those set should undergo io_disarm_next() */
@@ -1081,6 +1175,7 @@ static void io_uring_try_cancel_requests(struct io_ring_ctx *ctx,
 static void io_uring_cancel_generic(bool cancel_all, struct io_sq_data *sqd);
 
 static void io_fill_cqe_req(struct io_kiocb *req, s32 res, u32 cflags);
+static int io_issue_sqe(struct io_kiocb *req, unsigned int issue_flags);
 
 static void io_put_req(struct io_kiocb *req);
 static void io_put_req_deferred(struct io_kiocb *req);
@@ -1096,11 +1191,12 @@ static void __io_queue_sqe(struct io_kiocb *req);
 static void io_rsrc_put_work(struct work_struct *work);
 
 static void io_req_task_queue(struct io_kiocb *req);
+static void io_req_task_work_add(struct io_kiocb *req);
 static void io_submit_flush_completions(struct io_ring_ctx *ctx);
 static int io_req_prep_async(struct io_kiocb *req);
 
 static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
-				 unsigned int issue_flags, u32 slot_index);
+				 unsigned int issue_flags, u32 file_index);
 static int io_close_fixed(struct io_kiocb *req, unsigned int issue_flags);
 
 static enum hrtimer_restart io_link_timeout_fn(struct hrtimer *timer);
@@ -1338,6 +1434,7 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	INIT_LIST_HEAD(&ctx->cq_overflow_list);
 	init_completion(&ctx->ref_comp);
 	xa_init_flags(&ctx->io_buffers, XA_FLAGS_ALLOC1);
+	xa_init(&ctx->io_buf_rings);
 	xa_init_flags(&ctx->personalities, XA_FLAGS_ALLOC1);
 	mutex_init(&ctx->uring_lock);
 	init_waitqueue_head(&ctx->cq_wait);
@@ -1355,6 +1452,7 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 	INIT_LIST_HEAD(&ctx->submit_state.free_list);
 	INIT_LIST_HEAD(&ctx->locked_free_list);
 	INIT_DELAYED_WORK(&ctx->fallback_work, io_fallback_req_func);
+	init_llist_head(&ctx->work_llist);
 	return ctx;
 err:
 	kfree(ctx->dummy_ubuf);
@@ -1819,6 +1917,22 @@ static noinline bool io_fill_cqe_aux(struct io_ring_ctx *ctx, u64 user_data,
 	return __io_fill_cqe(ctx, user_data, res, cflags);
 }
 
+/* post a CQE on behalf of a request that stays alive, see IORING_CQE_F_MORE */
+static bool io_post_multishot_cqe(struct io_kiocb *req, s32 res, u32 cflags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	bool filled;
+
+	spin_lock(&ctx->completion_lock);
+	filled = io_fill_cqe_aux(ctx, req->user_data, res,
+				 cflags | IORING_CQE_F_MORE);
+	io_commit_cqring(ctx);
+	spin_unlock(&ctx->completion_lock);
+	if (filled)
+		io_cqring_ev_posted(ctx);
+	return filled;
+}
+
 static void io_req_complete_post(struct io_kiocb *req, s32 res,
 				 u32 cflags)
 {
@@ -1871,13 +1985,21 @@ static inline void io_req_complete_state(struct io_kiocb *req, s32 res,
 	req->flags |= REQ_F_COMPLETE_INLINE;
 }
 
+static void io_req_task_complete_state(struct io_kiocb *req, bool *locked);
+
 static inline void __io_req_complete(struct io_kiocb *req, unsigned issue_flags,
 				     s32 res, u32 cflags)
 {
-	if (issue_flags & IO_URING_F_COMPLETE_DEFER)
+	if (issue_flags & IO_URING_F_COMPLETE_DEFER) {
 		io_req_complete_state(req, res, cflags);
-	else
+	} else if (req->ctx->flags & IORING_SETUP_DEFER_TASKRUN) {
+		/* e.g. io-wq, leave posting to the submitter's next batch */
+		io_req_complete_state(req, res, cflags);
+		req->io_task_work.func = io_req_task_complete_state;
+		io_req_task_work_add(req);
+	} else {
 		io_req_complete_post(req, res, cflags);
+	}
 }
 
 static inline void io_req_complete(struct io_kiocb *req, s32 res)
@@ -1885,6 +2007,57 @@ static inline void io_req_complete(struct io_kiocb *req, s32 res)
 	__io_req_complete(req, 0, res, 0);
 }
 
+static inline bool io_req_multishot(struct io_kiocb *req,
+				    unsigned int issue_flags)
+{
+	/* io-wq issues blocking, it only ever serves a single shot */
+	return (req->flags & REQ_F_APOLL_MULTISHOT) &&
+		(issue_flags & IO_URING_F_NONBLOCK);
+}
+
+static inline bool io_req_multishot_armed(struct io_kiocb *req,
+					  unsigned int issue_flags)
+{
+	return (req->flags & IO_APOLL_MULTI_POLLED) == IO_APOLL_MULTI_POLLED &&
+		(issue_flags & IO_URING_F_NONBLOCK);
+}
+
+/*
+ * Final completion of a multishot capable request. Once armed, poll owns
+ * the request and has to remove its wait entries before it can complete,
+ * so leave the result for it to post.
+ */
+static int io_req_complete_multishot(struct io_kiocb *req,
+				     unsigned int issue_flags, s32 res,
+				     u32 cflags)
+{
+	if (io_req_multishot_armed(req, issue_flags)) {
+		req->result = res;
+		/* per-op data isn't needed past this point */
+		req->compl.cflags = cflags;
+		return IO_MULTISHOT_STOP;
+	}
+	__io_req_complete(req, issue_flags, res, cflags);
+	return 0;
+}
+
+/*
+ * A multishot request that keeps finding work stops after
+ * MULTISHOT_MAX_RETRY shots, so that a socket that stays readable can't
+ * keep the task inside one ->issue() call and starve other task_work.
+ */
+static int io_multishot_requeue(struct io_kiocb *req, unsigned int issue_flags)
+{
+	if (io_req_multishot_armed(req, issue_flags))
+		return IO_MULTISHOT_REQUEUE;
+	/*
+	 * Not armed yet, arming poll finds the file ready and queues tw. A
+	 * REQ_F_NOWAIT request never arms poll and ends here, as it would
+	 * once it ran out of data.
+	 */
+	return -EAGAIN;
+}
+
 static void io_req_complete_failed(struct io_kiocb *req, s32 res)
 {
 	req_set_fail(req);
@@ -2206,6 +2379,76 @@ static void tctx_task_work(struct callback_head *cb)
 		io_uring_drop_tctx_refs(current);
 }
 
+/*
+ * IORING_SETUP_DEFER_TASKRUN rings queue task_work on the ctx instead of the
+ * task. There is no task_work_add() notification. Nothing gets posted until
+ * the submitter enters the ring and runs the list, so everyone who waits for
+ * CQEs (io_cqring_wait(), poll, eventfd) is told that it's time to do so.
+ */
+static void io_req_local_work_add(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (!llist_add(&req->io_task_work.fallback_node, &ctx->work_llist))
+		return;
+	/* wq_has_sleeper() pairs with prepare_to_wait() in io_cqring_wait() */
+	if (wq_has_sleeper(&ctx->cq_wait))
+		wake_up(&ctx->cq_wait);
+	if (io_should_trigger_evfd(ctx))
+		eventfd_signal(ctx->cq_ev_fd, 1);
+	if (waitqueue_active(&ctx->poll_wait))
+		wake_up_interruptible(&ctx->poll_wait);
+}
+
+/*
+ * Task work of a DEFER_TASKRUN ring must only be run by the submitter. When
+ * somebody else needs it done, e.g. ring exit from a kworker, punt it to the
+ * fallback work, like task_work of a task that is exiting.
+ */
+static bool io_move_task_work_from_local(struct io_ring_ctx *ctx)
+{
+	struct llist_node *node = llist_del_all(&ctx->work_llist);
+	struct io_kiocb *req, *tmp;
+
+	if (!node)
+		return false;
+
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(req, tmp, node, io_task_work.fallback_node) {
+		if (llist_add(&req->io_task_work.fallback_node,
+			      &ctx->fallback_llist))
+			schedule_delayed_work(&ctx->fallback_work, 1);
+	}
+	return true;
+}
+
+static bool io_run_local_work(struct io_ring_ctx *ctx)
+{
+	struct llist_node *node;
+	bool locked = true;
+	bool ran = false;
+
+	if (llist_empty(&ctx->work_llist))
+		return false;
+
+	mutex_lock(&ctx->uring_lock);
+	while ((node = llist_del_all(&ctx->work_llist)) != NULL) {
+		node = llist_reverse_order(node);
+		while (node) {
+			struct io_kiocb *req = container_of(node, struct io_kiocb,
+						io_task_work.fallback_node);
+
+			node = node->next;
+			req->io_task_work.func(req, &locked);
+		}
+		ran = true;
+	}
+	if (ctx->submit_state.compl_nr)
+		io_submit_flush_completions(ctx);
+	mutex_unlock(&ctx->uring_lock);
+	return ran;
+}
+
 static void io_req_task_work_add(struct io_kiocb *req)
 {
 	struct task_struct *tsk = req->task;
@@ -2215,6 +2458,11 @@ static void io_req_task_work_add(struct io_kiocb *req)
 	unsigned long flags;
 	bool running;
 
+	if (req->ctx->flags & IORING_SETUP_DEFER_TASKRUN) {
+		io_req_local_work_add(req);
+		return;
+	}
+
 	WARN_ON_ONCE(!tctx);
 
 	spin_lock_irqsave(&tctx->task_lock, flags);
@@ -2435,6 +2683,13 @@ static unsigned int io_put_kbuf(struct io_kiocb *req, struct io_buffer *kbuf)
 {
 	unsigned int cflags;
 
+	/* ring buffers are owned by the application, only report the ID */
+	if (req->flags & REQ_F_BUFFER_RING) {
+		cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+		req->flags &= ~(REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING);
+		return cflags | IORING_CQE_F_BUFFER;
+	}
+
 	cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
 	cflags |= IORING_CQE_F_BUFFER;
 	req->flags &= ~REQ_F_BUFFER_SELECTED;
@@ -2701,24 +2956,38 @@ static bool __io_complete_rw_common(struct io_kiocb *req, long res)
 	return false;
 }
 
+static void io_req_add_compl_list(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_submit_state *state = &ctx->submit_state;
+
+	state->compl_reqs[state->compl_nr++] = req;
+	if (state->compl_nr == ARRAY_SIZE(state->compl_reqs))
+		io_submit_flush_completions(ctx);
+}
+
 static void io_req_task_complete(struct io_kiocb *req, bool *locked)
 {
 	unsigned int cflags = io_put_rw_kbuf(req);
 	int res = req->result;
 
 	if (*locked) {
-		struct io_ring_ctx *ctx = req->ctx;
-		struct io_submit_state *state = &ctx->submit_state;
-
 		io_req_complete_state(req, res, cflags);
-		state->compl_reqs[state->compl_nr++] = req;
-		if (state->compl_nr == ARRAY_SIZE(state->compl_reqs))
-			io_submit_flush_completions(ctx);
+		io_req_add_compl_list(req);
 	} else {
 		io_req_complete_post(req, res, cflags);
 	}
 }
 
+/* result and cflags were stashed by io_req_complete_state() */
+static void io_req_task_complete_state(struct io_kiocb *req, bool *locked)
+{
+	if (*locked)
+		io_req_add_compl_list(req);
+	else
+		io_req_complete_post(req, req->result, req->compl.cflags);
+}
+
 static void __io_complete_rw(struct io_kiocb *req, long res, long res2,
 			     unsigned int issue_flags)
 {
@@ -3016,11 +3285,10 @@ static void kiocb_done(struct kiocb *kiocb, ssize_t ret,
 	}
 }
 
-static int __io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter,
-			     struct io_mapped_ubuf *imu)
+static int __io_import_fixed(int rw, struct iov_iter *iter,
+			     struct io_mapped_ubuf *imu, u64 buf_addr, size_t len)
 {
-	size_t len = req->rw.len;
-	u64 buf_end, buf_addr = req->rw.addr;
+	u64 buf_end;
 	size_t offset;
 
 	if (unlikely(check_add_overflow(buf_addr, (u64)len, &buf_end)))
@@ -3078,7 +3346,7 @@ static int io_import_fixed(struct io_kiocb *req, int rw, struct iov_iter *iter)
 {
 	if (WARN_ON_ONCE(!req->imu))
 		return -EFAULT;
-	return __io_import_fixed(req, rw, iter, req->imu);
+	return __io_import_fixed(rw, iter, req->imu, req->rw.addr, req->rw.len);
 }
 
 static void io_ring_submit_unlock(struct io_ring_ctx *ctx, bool needs_lock)
@@ -3099,54 +3367,100 @@ static void io_ring_submit_lock(struct io_ring_ctx *ctx, bool needs_lock)
 		mutex_lock(&ctx->uring_lock);
 }
 
-static struct io_buffer *io_buffer_select(struct io_kiocb *req, size_t *len,
-					  int bgid, struct io_buffer *kbuf,
-					  bool needs_lock)
+static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
+					  struct io_buffer_ring *bl)
+{
+	struct io_uring_buf_ring *br = bl->br;
+	struct io_uring_buf *buf;
+	__u32 buf_len;
+
+	/* pairs with the release store of the tail by the application */
+	if (smp_load_acquire(&br->tail) == bl->head)
+		return ERR_PTR(-ENOBUFS);
+
+	buf = &br->bufs[bl->head & bl->mask];
+	bl->head++;
+
+	buf_len = min_t(__u32, READ_ONCE(buf->len), MAX_RW_COUNT);
+	if (*len == 0 || *len > buf_len)
+		*len = buf_len;
+	req->buf_index = READ_ONCE(buf->bid);
+	req->flags |= REQ_F_BUFFER_RING;
+	return u64_to_user_ptr(READ_ONCE(buf->addr));
+}
+
+/*
+ * Pick a buffer from group @bgid. Classic provided buffers are detached
+ * from the group and returned through @kbuf, they're freed when the buffer
+ * is put. Ring-mapped buffers stay owned by the application, for those
+ * only the buffer ID is kept in ->buf_index and REQ_F_BUFFER_RING is set.
+ */
+static void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
+				     int bgid, struct io_buffer **kbuf,
+				     bool needs_lock)
 {
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_ring *bl;
 	struct io_buffer *head;
+	void __user *buf;
 
-	if (req->flags & REQ_F_BUFFER_SELECTED)
-		return kbuf;
+	io_ring_submit_lock(ctx, needs_lock);
 
-	io_ring_submit_lock(req->ctx, needs_lock);
+	lockdep_assert_held(&ctx->uring_lock);
 
-	lockdep_assert_held(&req->ctx->uring_lock);
+	bl = xa_load(&ctx->io_buf_rings, bgid);
+	if (bl) {
+		buf = io_ring_buffer_select(req, len, bl);
+		goto out;
+	}
 
-	head = xa_load(&req->ctx->io_buffers, bgid);
+	head = xa_load(&ctx->io_buffers, bgid);
 	if (head) {
 		if (!list_empty(&head->list)) {
-			kbuf = list_last_entry(&head->list, struct io_buffer,
+			*kbuf = list_last_entry(&head->list, struct io_buffer,
 							list);
-			list_del(&kbuf->list);
+			list_del(&(*kbuf)->list);
 		} else {
-			kbuf = head;
-			xa_erase(&req->ctx->io_buffers, bgid);
+			*kbuf = head;
+			xa_erase(&ctx->io_buffers, bgid);
 		}
-		if (*len > kbuf->len)
-			*len = kbuf->len;
+		if (*len == 0 || *len > (*kbuf)->len)
+			*len = (*kbuf)->len;
+		buf = u64_to_user_ptr((*kbuf)->addr);
 	} else {
-		kbuf = ERR_PTR(-ENOBUFS);
+		buf = ERR_PTR(-ENOBUFS);
 	}
+out:
+	if (!IS_ERR(buf))
+		req->flags |= REQ_F_BUFFER_SELECTED;
+	io_ring_submit_unlock(ctx, needs_lock);
 
-	io_ring_submit_unlock(req->ctx, needs_lock);
-
-	return kbuf;
+	return buf;
 }
 
 static void __user *io_rw_buffer_select(struct io_kiocb *req, size_t *len,
 					bool needs_lock)
 {
 	struct io_buffer *kbuf;
-	u16 bgid;
+	void __user *buf;
 
-	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
-	bgid = req->buf_index;
-	kbuf = io_buffer_select(req, len, bgid, kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
-	req->rw.addr = (u64) (unsigned long) kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
-	return u64_to_user_ptr(kbuf->addr);
+	if (req->flags & REQ_F_BUFFER_SELECTED) {
+		if (req->flags & REQ_F_BUFFER_RING)
+			return u64_to_user_ptr(req->rw.addr);
+		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
+		return u64_to_user_ptr(kbuf->addr);
+	}
+
+	buf = io_buffer_select(req, len, req->buf_index, &kbuf, needs_lock);
+	if (IS_ERR(buf))
+		return buf;
+	if (req->flags & REQ_F_BUFFER_RING) {
+		req->rw.addr = (u64) (unsigned long) buf;
+		req->rw.len = *len;
+	} else {
+		req->rw.addr = (u64) (unsigned long) kbuf;
+	}
+	return buf;
 }
 
 #ifdef CONFIG_COMPAT
@@ -3203,6 +3517,11 @@ static ssize_t io_iov_buffer_select(struct io_kiocb *req, struct iovec *iov,
 	if (req->flags & REQ_F_BUFFER_SELECTED) {
 		struct io_buffer *kbuf;
 
+		if (req->flags & REQ_F_BUFFER_RING) {
+			iov[0].iov_base = u64_to_user_ptr(req->rw.addr);
+			iov[0].iov_len = req->rw.len;
+			return 0;
+		}
 		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
 		iov[0].iov_base = u64_to_user_ptr(kbuf->addr);
 		iov[0].iov_len = kbuf->len;
@@ -4313,7 +4632,7 @@ static int io_openat2(struct io_kiocb *req, unsigned int issue_flags)
 		fd_install(ret, file);
 	else
 		ret = io_install_fixed_file(req, file, issue_flags,
-					    req->open.file_slot - 1);
+					    req->open.file_slot);
 err:
 	putname(req->open.filename);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
@@ -4475,6 +4794,12 @@ static int io_provide_buffers(struct io_kiocb *req, unsigned int issue_flags)
 
 	lockdep_assert_held(&ctx->uring_lock);
 
+	/* ring-mapped groups are only ever refilled through the ring */
+	if (unlikely(xa_load(&ctx->io_buf_rings, p->bgid))) {
+		ret = -EEXIST;
+		goto out;
+	}
+
 	list = head = xa_load(&ctx->io_buffers, p->bgid);
 
 	ret = io_add_buffers(p, &head);
@@ -4484,6 +4809,7 @@ static int io_provide_buffers(struct io_kiocb *req, unsigned int issue_flags)
 		if (ret < 0)
 			__io_remove_buffers(ctx, head, p->bgid, -1U);
 	}
+out:
 	if (ret < 0)
 		req_set_fail(req);
 	/* complete before unlock, IOPOLL may need the lock */
@@ -4774,6 +5100,7 @@ static int io_sendmsg_copy_hdr(struct io_kiocb *req,
 			       struct io_async_msghdr *iomsg)
 {
 	iomsg->msg.msg_name = &iomsg->addr;
+	iomsg->msg.msg_ubuf = NULL;
 	iomsg->free_iov = iomsg->fast_iov;
 	return sendmsg_copy_msghdr(&iomsg->msg, req->sr_msg.umsg,
 				   req->sr_msg.msg_flags, &iomsg->free_iov);
@@ -4877,6 +5204,7 @@ static int io_send(struct io_kiocb *req, unsigned int issue_flags)
 	msg.msg_control = NULL;
 	msg.msg_controllen = 0;
 	msg.msg_namelen = 0;
+	msg.msg_ubuf = NULL;
 
 	flags = req->sr_msg.msg_flags;
 	if (issue_flags & IO_URING_F_NONBLOCK)
@@ -4897,6 +5225,162 @@ static int io_send(struct io_kiocb *req, unsigned int issue_flags)
 	return 0;
 }
 
+static void io_notif_complete_tw(struct io_kiocb *notif, bool *locked)
+{
+	struct io_ring_ctx *ctx = notif->ctx;
+
+	if (!notif->notif.skip_cqe) {
+		spin_lock(&ctx->completion_lock);
+		io_fill_cqe_aux(ctx, notif->user_data, 0, IORING_CQE_F_NOTIF);
+		io_commit_cqring(ctx);
+		spin_unlock(&ctx->completion_lock);
+		io_cqring_ev_posted(ctx);
+	}
+	io_free_req(notif);
+}
+
+/* may be called from softirq context when the last skb is freed */
+static void io_uring_tx_zerocopy_callback(struct sk_buff *skb,
+					  struct ubuf_info *uarg,
+					  bool success)
+{
+	struct io_notif *nd = container_of(uarg, struct io_notif, uarg);
+	struct io_kiocb *notif = container_of(nd, struct io_kiocb, notif);
+
+	if (refcount_dec_and_test(&uarg->refcnt)) {
+		notif->io_task_work.func = io_notif_complete_tw;
+		io_req_task_work_add(notif);
+	}
+}
+
+/*
+ * The notification holds its own ctx, task and rsrc node references, so
+ * neither the ring nor the registered buffers go away while the networking
+ * stack still has pages of them attached to skbs.
+ */
+static struct io_kiocb *io_alloc_notif(struct io_ring_ctx *ctx, u64 user_data)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_kiocb *notif;
+
+	notif = io_alloc_req(ctx);
+	if (unlikely(!notif))
+		return NULL;
+
+	notif->opcode = IORING_OP_NOP;
+	notif->flags = 0;
+	notif->file = NULL;
+	notif->fixed_rsrc_refs = NULL;
+	notif->task = current;
+	notif->user_data = user_data;
+	io_get_task_refs(1);
+	percpu_ref_get(&ctx->refs);
+	io_req_set_rsrc_node(notif);
+
+	notif->notif.skip_cqe = false;
+	memset(&notif->notif.uarg, 0, sizeof(notif->notif.uarg));
+	notif->notif.uarg.callback = io_uring_tx_zerocopy_callback;
+	notif->notif.uarg.flags = SKBFL_ZEROCOPY_FRAG | SKBFL_DONT_ORPHAN;
+	refcount_set(&notif->notif.uarg.refcnt, 1);
+	return notif;
+}
+
+/* drop the submission reference, the CQE follows once skbs release theirs */
+static void io_notif_flush(struct io_kiocb *notif)
+{
+	net_zcopy_put(&notif->notif.uarg);
+}
+
+static void io_send_zc_cleanup(struct io_kiocb *req)
+{
+	struct io_kiocb *notif = req->sr_msg.notif;
+
+	/* never issued, nothing can reference the buffer */
+	notif->notif.skip_cqe = true;
+	io_notif_flush(notif);
+	req->sr_msg.notif = NULL;
+}
+
+static int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_sr_msg *sr = &req->sr_msg;
+	struct io_ring_ctx *ctx = req->ctx;
+	u16 index;
+
+	if (unlikely(ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (unlikely(sqe->addr2 || sqe->file_index || sqe->ioprio))
+		return -EINVAL;
+
+	req->buf_index = READ_ONCE(sqe->buf_index);
+	if (unlikely(req->buf_index >= ctx->nr_user_bufs))
+		return -EFAULT;
+	index = array_index_nospec(req->buf_index, ctx->nr_user_bufs);
+	req->imu = ctx->user_bufs[index];
+	io_req_set_rsrc_node(req);
+
+	sr->buf = u64_to_user_ptr(READ_ONCE(sqe->addr));
+	sr->len = READ_ONCE(sqe->len);
+	sr->msg_flags = READ_ONCE(sqe->msg_flags) | MSG_NOSIGNAL;
+	if (sr->msg_flags & MSG_DONTWAIT)
+		req->flags |= REQ_F_NOWAIT;
+
+	sr->notif = io_alloc_notif(ctx, req->user_data);
+	if (unlikely(!sr->notif))
+		return -ENOMEM;
+	req->flags |= REQ_F_NEED_CLEANUP;
+	return 0;
+}
+
+static int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_sr_msg *sr = &req->sr_msg;
+	struct io_kiocb *notif = sr->notif;
+	struct msghdr msg;
+	struct socket *sock;
+	unsigned flags;
+	int min_ret = 0;
+	int ret;
+
+	sock = sock_from_file(req->file);
+	if (unlikely(!sock))
+		return -ENOTSOCK;
+	if (!test_bit(SOCK_SUPPORT_ZC, &sock->flags))
+		return -EOPNOTSUPP;
+
+	ret = __io_import_fixed(WRITE, &msg.msg_iter, req->imu,
+				(u64)(unsigned long)sr->buf, sr->len);
+	if (unlikely(ret))
+		return ret;
+
+	msg.msg_name = NULL;
+	msg.msg_control = NULL;
+	msg.msg_controllen = 0;
+	msg.msg_namelen = 0;
+	msg.msg_ubuf = &notif->notif.uarg;
+
+	flags = sr->msg_flags | MSG_ZEROCOPY;
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		flags |= MSG_DONTWAIT;
+	if (flags & MSG_WAITALL)
+		min_ret = iov_iter_count(&msg.msg_iter);
+
+	msg.msg_flags = flags;
+	ret = sock_sendmsg(sock, &msg);
+	if ((issue_flags & IO_URING_F_NONBLOCK) && ret == -EAGAIN)
+		return -EAGAIN;
+	if (ret == -ERESTARTSYS)
+		ret = -EINTR;
+
+	if (ret < min_ret)
+		req_set_fail(req);
+	sr->notif = NULL;
+	req->flags &= ~REQ_F_NEED_CLEANUP;
+	io_notif_flush(notif);
+	__io_req_complete(req, issue_flags, ret, IORING_CQE_F_MORE);
+	return 0;
+}
+
 static int __io_recvmsg_copy_hdr(struct io_kiocb *req,
 				 struct io_async_msghdr *iomsg)
 {
@@ -4984,19 +5468,28 @@ static int io_recvmsg_copy_hdr(struct io_kiocb *req,
 	return __io_recvmsg_copy_hdr(req, iomsg);
 }
 
-static struct io_buffer *io_recv_buffer_select(struct io_kiocb *req,
-					       bool needs_lock)
+static void __user *io_recv_buffer_select(struct io_kiocb *req,
+					  bool needs_lock)
 {
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct io_buffer *kbuf;
+	void __user *buf;
+
+	if (req->flags & REQ_F_BUFFER_SELECTED) {
+		if (req->flags & REQ_F_BUFFER_RING)
+			return sr->ring_buf;
+		return u64_to_user_ptr(sr->kbuf->addr);
+	}
 
-	kbuf = io_buffer_select(req, &sr->len, sr->bgid, sr->kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
+	buf = io_buffer_select(req, &sr->len, sr->bgid, &kbuf, needs_lock);
+	if (IS_ERR(buf))
+		return buf;
 
-	sr->kbuf = kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
-	return kbuf;
+	if (req->flags & REQ_F_BUFFER_RING)
+		sr->ring_buf = buf;
+	else
+		sr->kbuf = kbuf;
+	return buf;
 }
 
 static inline unsigned int io_put_recv_kbuf(struct io_kiocb *req)
@@ -5017,13 +5510,12 @@ static int io_recvmsg_prep_async(struct io_kiocb *req)
 static int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_sr_msg *sr = &req->sr_msg;
+	unsigned int ioprio;
 
 	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
 		return -EINVAL;
 	if (unlikely(sqe->addr2 || sqe->file_index))
 		return -EINVAL;
-	if (unlikely(sqe->addr2 || sqe->file_index || sqe->ioprio))
-		return -EINVAL;
 
 	sr->umsg = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	sr->len = READ_ONCE(sqe->len);
@@ -5032,6 +5524,19 @@ static int io_recvmsg_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 	if (sr->msg_flags & MSG_DONTWAIT)
 		req->flags |= REQ_F_NOWAIT;
 
+	ioprio = READ_ONCE(sqe->ioprio);
+	if (ioprio & ~IORING_RECV_MULTISHOT)
+		return -EINVAL;
+	if (ioprio & IORING_RECV_MULTISHOT) {
+		/* every shot consumes a provided buffer of its own */
+		if (req->opcode != IORING_OP_RECV ||
+		    !(req->flags & REQ_F_BUFFER_SELECT))
+			return -EINVAL;
+		if (sr->len || (sr->msg_flags & MSG_WAITALL))
+			return -EINVAL;
+		req->flags |= REQ_F_APOLL_MULTISHOT;
+	}
+
 #ifdef CONFIG_COMPAT
 	if (req->ctx->compat)
 		sr->msg_flags |= MSG_CMSG_COMPAT;
@@ -5043,7 +5548,7 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 {
 	struct io_async_msghdr iomsg, *kmsg;
 	struct socket *sock;
-	struct io_buffer *kbuf;
+	void __user *buf;
 	unsigned flags;
 	int min_ret = 0;
 	int ret, cflags = 0;
@@ -5062,10 +5567,10 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 	}
 
 	if (req->flags & REQ_F_BUFFER_SELECT) {
-		kbuf = io_recv_buffer_select(req, !force_nonblock);
-		if (IS_ERR(kbuf))
-			return PTR_ERR(kbuf);
-		kmsg->fast_iov[0].iov_base = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, !force_nonblock);
+		if (IS_ERR(buf))
+			return PTR_ERR(buf);
+		kmsg->fast_iov[0].iov_base = buf;
 		kmsg->fast_iov[0].iov_len = req->sr_msg.len;
 		iov_iter_init(&kmsg->msg.msg_iter, READ, kmsg->fast_iov,
 				1, req->sr_msg.len);
@@ -5098,7 +5603,6 @@ static int io_recvmsg(struct io_kiocb *req, unsigned int issue_flags)
 
 static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 {
-	struct io_buffer *kbuf;
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct msghdr msg;
 	void __user *buf = sr->buf;
@@ -5108,16 +5612,18 @@ static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 	int min_ret = 0;
 	int ret, cflags = 0;
 	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
+	bool multishot = io_req_multishot(req, issue_flags);
+	unsigned int shots = 0;
 
 	sock = sock_from_file(req->file);
 	if (unlikely(!sock))
 		return -ENOTSOCK;
 
+retry_multishot:
 	if (req->flags & REQ_F_BUFFER_SELECT) {
-		kbuf = io_recv_buffer_select(req, !force_nonblock);
-		if (IS_ERR(kbuf))
-			return PTR_ERR(kbuf);
-		buf = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, !force_nonblock);
+		if (IS_ERR(buf))
+			return PTR_ERR(buf);
 	}
 
 	ret = import_single_range(READ, buf, sr->len, &iov, &msg.msg_iter);
@@ -5138,26 +5644,40 @@ static int io_recv(struct io_kiocb *req, unsigned int issue_flags)
 		min_ret = iov_iter_count(&msg.msg_iter);
 
 	ret = sock_recvmsg(sock, &msg, flags);
-	if (force_nonblock && ret == -EAGAIN)
+	if (force_nonblock && ret == -EAGAIN) {
+		/* keep the selected buffer, it's used once data arrives */
+		if (io_req_multishot_armed(req, issue_flags))
+			return 0;
 		return -EAGAIN;
+	}
 	if (ret == -ERESTARTSYS)
 		ret = -EINTR;
 out_free:
 	if (req->flags & REQ_F_BUFFER_SELECTED)
 		cflags = io_put_recv_kbuf(req);
+	if (multishot && ret > 0) {
+		if (io_post_multishot_cqe(req, ret, cflags)) {
+			sr->len = 0;
+			cflags = 0;
+			if (++shots >= MULTISHOT_MAX_RETRY)
+				return io_multishot_requeue(req, issue_flags);
+			goto retry_multishot;
+		}
+		ret = -ECANCELED;
+	}
 	if (ret < min_ret || ((flags & MSG_WAITALL) && (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))))
 		req_set_fail(req);
-	__io_req_complete(req, issue_flags, ret, cflags);
-	return 0;
+	return io_req_complete_multishot(req, issue_flags, ret, cflags);
 }
 
 static int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_accept *accept = &req->accept;
+	unsigned int ioprio;
 
 	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
 		return -EINVAL;
-	if (sqe->ioprio || sqe->len || sqe->buf_index)
+	if (sqe->len || sqe->buf_index)
 		return -EINVAL;
 
 	accept->addr = u64_to_user_ptr(READ_ONCE(sqe->addr));
@@ -5172,6 +5692,17 @@ static int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 		return -EINVAL;
 	if (SOCK_NONBLOCK != O_NONBLOCK && (accept->flags & SOCK_NONBLOCK))
 		accept->flags = (accept->flags & ~SOCK_NONBLOCK) | O_NONBLOCK;
+
+	ioprio = READ_ONCE(sqe->ioprio);
+	if (ioprio & ~IORING_ACCEPT_MULTISHOT)
+		return -EINVAL;
+	if (ioprio & IORING_ACCEPT_MULTISHOT) {
+		/* a single fixed slot can't take more than one connection */
+		if (accept->file_slot &&
+		    accept->file_slot != IORING_FILE_INDEX_ALLOC)
+			return -EINVAL;
+		req->flags |= REQ_F_APOLL_MULTISHOT;
+	}
 	return 0;
 }
 
@@ -5181,12 +5712,14 @@ static int io_accept(struct io_kiocb *req, unsigned int issue_flags)
 	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
 	unsigned int file_flags = force_nonblock ? O_NONBLOCK : 0;
 	bool fixed = !!accept->file_slot;
+	unsigned int shots = 0;
 	struct file *file;
 	int ret, fd;
 
 	if (req->file->f_flags & O_NONBLOCK)
 		req->flags |= REQ_F_NOWAIT;
 
+retry:
 	if (!fixed) {
 		fd = __get_unused_fd_flags(accept->flags, accept->nofile);
 		if (unlikely(fd < 0))
@@ -5198,8 +5731,12 @@ static int io_accept(struct io_kiocb *req, unsigned int issue_flags)
 		if (!fixed)
 			put_unused_fd(fd);
 		ret = PTR_ERR(file);
-		if (ret == -EAGAIN && force_nonblock)
+		if (ret == -EAGAIN && force_nonblock) {
+			/* poll is already armed, wait for the next connection */
+			if (io_req_multishot_armed(req, issue_flags))
+				return 0;
 			return -EAGAIN;
+		}
 		if (ret == -ERESTARTSYS)
 			ret = -EINTR;
 		req_set_fail(req);
@@ -5208,8 +5745,80 @@ static int io_accept(struct io_kiocb *req, unsigned int issue_flags)
 		ret = fd;
 	} else {
 		ret = io_install_fixed_file(req, file, issue_flags,
-					    accept->file_slot - 1);
+					    accept->file_slot);
+	}
+
+	if (ret >= 0 && io_req_multishot(req, issue_flags)) {
+		if (io_post_multishot_cqe(req, ret, 0)) {
+			if (++shots >= MULTISHOT_MAX_RETRY)
+				return io_multishot_requeue(req, issue_flags);
+			goto retry;
+		}
+		ret = -ECANCELED;
+		req_set_fail(req);
+	}
+	return io_req_complete_multishot(req, issue_flags, ret, 0);
+}
+
+static int io_socket_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
+{
+	struct io_socket *sock = &req->sock;
+
+	if (unlikely(req->ctx->flags & IORING_SETUP_IOPOLL))
+		return -EINVAL;
+	if (sqe->ioprio || sqe->addr || sqe->rw_flags || sqe->buf_index)
+		return -EINVAL;
+
+	sock->domain = READ_ONCE(sqe->fd);
+	sock->type = READ_ONCE(sqe->off);
+	sock->protocol = READ_ONCE(sqe->len);
+	sock->file_slot = READ_ONCE(sqe->file_index);
+	sock->nofile = rlimit(RLIMIT_NOFILE);
+
+	sock->flags = sock->type & ~SOCK_TYPE_MASK;
+	if (sock->file_slot && (sock->flags & SOCK_CLOEXEC))
+		return -EINVAL;
+	if (sock->flags & ~(SOCK_CLOEXEC | SOCK_NONBLOCK))
+		return -EINVAL;
+	sock->type &= SOCK_TYPE_MASK;
+	if (SOCK_NONBLOCK != O_NONBLOCK && (sock->flags & SOCK_NONBLOCK))
+		sock->flags = (sock->flags & ~SOCK_NONBLOCK) | O_NONBLOCK;
+	return 0;
+}
+
+static int io_socket(struct io_kiocb *req, unsigned int issue_flags)
+{
+	struct io_socket *sock = &req->sock;
+	bool fixed = !!sock->file_slot;
+	struct socket *newsock;
+	struct file *file;
+	int ret, fd;
+
+	if (!fixed) {
+		fd = __get_unused_fd_flags(sock->flags, sock->nofile);
+		if (unlikely(fd < 0))
+			return fd;
 	}
+	ret = sock_create(sock->domain, sock->type, sock->protocol, &newsock);
+	if (unlikely(ret < 0)) {
+		file = ERR_PTR(ret);
+	} else {
+		/* drops the socket on failure */
+		file = sock_alloc_file(newsock, sock->flags & O_NONBLOCK, NULL);
+	}
+	if (IS_ERR(file)) {
+		if (!fixed)
+			put_unused_fd(fd);
+		ret = PTR_ERR(file);
+	} else if (!fixed) {
+		fd_install(fd, file);
+		ret = fd;
+	} else {
+		ret = io_install_fixed_file(req, file, issue_flags,
+					    sock->file_slot);
+	}
+	if (ret < 0)
+		req_set_fail(req);
 	__io_req_complete(req, issue_flags, ret, 0);
 	return 0;
 }
@@ -5304,6 +5913,12 @@ IO_NETOP_PREP_ASYNC(connect);
 IO_NETOP_PREP(accept);
 IO_NETOP_FN(send);
 IO_NETOP_FN(recv);
+IO_NETOP_PREP(send_zc);
+IO_NETOP_PREP(socket);
+
+static void io_send_zc_cleanup(struct io_kiocb *req)
+{
+}
 #endif /* CONFIG_NET */
 
 struct io_poll_table {
@@ -5406,19 +6021,48 @@ static void io_poll_remove_entries(struct io_kiocb *req)
 	rcu_read_unlock();
 }
 
+enum {
+	/* done with the request, the mask is stored in req->result */
+	IO_POLL_DONE,
+	/* spurious wakeup or a multishot CQE was served */
+	IO_POLL_NO_ACTION,
+	/* multishot request finished, its result is stored in req->result */
+	IO_POLL_REMOVE_USE_RES,
+	/* multishot request hit MULTISHOT_MAX_RETRY, run it again from tw */
+	IO_POLL_REQUEUE,
+};
+
+/*
+ * Let a multishot request consume what the poll event signalled. It goes
+ * back to waiting when ->issue() runs into -EAGAIN.
+ */
+static int io_poll_issue_multishot(struct io_kiocb *req, bool *locked)
+{
+	int ret;
+
+	io_tw_lock(req->ctx, locked);
+	/* req->task == current here, checking PF_EXITING is safe */
+	if (unlikely(req->task->flags & PF_EXITING))
+		return -EFAULT;
+
+	ret = io_issue_sqe(req, IO_URING_F_NONBLOCK);
+	if (ret == IO_MULTISHOT_STOP)
+		return IO_POLL_REMOVE_USE_RES;
+	if (ret == IO_MULTISHOT_REQUEUE)
+		return IO_POLL_REQUEUE;
+	return ret;
+}
+
 /*
  * All poll tw should go through this. Checks for poll events, manages
  * references, does rewait, etc.
  *
- * Returns a negative error on failure. >0 when no action require, which is
- * either spurious wakeup or multishot CQE is served. 0 when it's done with
- * the request, then the mask is stored in req->result.
+ * Returns a negative error on failure, otherwise one of IO_POLL_*.
  */
-static int io_poll_check_events(struct io_kiocb *req)
+static int io_poll_check_events(struct io_kiocb *req, bool *locked)
 {
-	struct io_ring_ctx *ctx = req->ctx;
 	struct io_poll_iocb *poll = io_poll_get_single(req);
-	int v;
+	int v, ret;
 
 	/* req->task == current here, checking PF_EXITING is safe */
 	if (unlikely(req->task->flags & PF_EXITING))
@@ -5429,7 +6073,7 @@ static int io_poll_check_events(struct io_kiocb *req)
 
 		/* tw handler should be the owner, and so have some references */
 		if (WARN_ON_ONCE(!(v & IO_POLL_REF_MASK)))
-			return 0;
+			return IO_POLL_DONE;
 		if (v & IO_POLL_CANCEL_FLAG)
 			return -ECANCELED;
 
@@ -5441,19 +6085,22 @@ static int io_poll_check_events(struct io_kiocb *req)
 
 		/* multishot, just fill an CQE and proceed */
 		if (req->result && !(poll->events & EPOLLONESHOT)) {
-			__poll_t mask = mangle_poll(req->result & poll->events);
-			bool filled;
+			if (req->flags & REQ_F_APOLL_MULTISHOT) {
+				ret = io_poll_issue_multishot(req, locked);
+				if (ret)
+					return ret;
+				/* repoll if there were more wakeups meanwhile */
+				req->result = 0;
+			} else {
+				__poll_t mask = mangle_poll(req->result &
+							    poll->events);
 
-			spin_lock(&ctx->completion_lock);
-			filled = io_fill_cqe_aux(ctx, req->user_data, mask,
-						 IORING_CQE_F_MORE);
-			io_commit_cqring(ctx);
-			spin_unlock(&ctx->completion_lock);
-			if (unlikely(!filled))
-				return -ECANCELED;
-			io_cqring_ev_posted(ctx);
+				if (unlikely(!io_post_multishot_cqe(req, mask,
+								    0)))
+					return -ECANCELED;
+			}
 		} else if (req->result) {
-			return 0;
+			return IO_POLL_DONE;
 		}
 
 		/*
@@ -5462,7 +6109,7 @@ static int io_poll_check_events(struct io_kiocb *req)
 		 */
 	} while (atomic_sub_return(v & IO_POLL_REF_MASK, &req->poll_refs));
 
-	return 1;
+	return IO_POLL_NO_ACTION;
 }
 
 static void io_poll_task_func(struct io_kiocb *req, bool *locked)
@@ -5470,11 +6117,11 @@ static void io_poll_task_func(struct io_kiocb *req, bool *locked)
 	struct io_ring_ctx *ctx = req->ctx;
 	int ret;
 
-	ret = io_poll_check_events(req);
-	if (ret > 0)
+	ret = io_poll_check_events(req, locked);
+	if (ret == IO_POLL_NO_ACTION)
 		return;
 
-	if (!ret) {
+	if (ret == IO_POLL_DONE) {
 		req->result = mangle_poll(req->result & req->poll.events);
 	} else {
 		req->result = ret;
@@ -5493,16 +6140,23 @@ static void io_apoll_task_func(struct io_kiocb *req, bool *locked)
 	struct io_ring_ctx *ctx = req->ctx;
 	int ret;
 
-	ret = io_poll_check_events(req);
-	if (ret > 0)
+	ret = io_poll_check_events(req, locked);
+	if (ret == IO_POLL_NO_ACTION)
+		return;
+	if (ret == IO_POLL_REQUEUE) {
+		/* still the owner, go to the back of the task_work queue */
+		__io_poll_execute(req, 0);
 		return;
+	}
 
 	io_poll_remove_entries(req);
 	spin_lock(&ctx->completion_lock);
 	hash_del(&req->hash_node);
 	spin_unlock(&ctx->completion_lock);
 
-	if (!ret)
+	if (ret == IO_POLL_REMOVE_USE_RES)
+		io_req_complete_post(req, req->result, req->compl.cflags);
+	else if (ret == IO_POLL_DONE)
 		io_req_task_submit(req, locked);
 	else
 		io_req_complete_failed(req, ret);
@@ -5671,6 +6325,7 @@ static int __io_arm_poll_handler(struct io_kiocb *req,
 		/* can't multishot if failed, just queue the event we've got */
 		if (unlikely(ipt->error || !ipt->nr_entries)) {
 			poll->events |= EPOLLONESHOT;
+			req->flags &= ~REQ_F_APOLL_MULTISHOT;
 			ipt->error = 0;
 		}
 		__io_poll_execute(req, mask);
@@ -5728,6 +6383,9 @@ static int io_arm_poll_handler(struct io_kiocb *req)
 	} else {
 		mask |= POLLOUT | POLLWRNORM;
 	}
+	/* stay on the waitqueue, ->issue() reaps each event as it comes in */
+	if (req->flags & REQ_F_APOLL_MULTISHOT)
+		mask &= ~EPOLLONESHOT;
 
 	apoll = kmalloc(sizeof(*apoll), GFP_ATOMIC);
 	if (unlikely(!apoll))
@@ -6455,6 +7113,10 @@ static int io_req_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 		return io_symlinkat_prep(req, sqe);
 	case IORING_OP_LINKAT:
 		return io_linkat_prep(req, sqe);
+	case IORING_OP_SEND_ZC:
+		return io_send_zc_prep(req, sqe);
+	case IORING_OP_SOCKET:
+		return io_socket_prep(req, sqe);
 	}
 
 	printk_once(KERN_WARNING "io_uring: unhandled opcode %d\n",
@@ -6575,7 +7237,9 @@ static bool io_drain_req(struct io_kiocb *req)
 
 static void io_clean_op(struct io_kiocb *req)
 {
-	if (req->flags & REQ_F_BUFFER_SELECTED) {
+	/* ring-mapped buffers belong to the application, nothing to free */
+	if ((req->flags & (REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING)) ==
+	    REQ_F_BUFFER_SELECTED) {
 		switch (req->opcode) {
 		case IORING_OP_READV:
 		case IORING_OP_READ_FIXED:
@@ -6632,6 +7296,9 @@ static void io_clean_op(struct io_kiocb *req)
 			putname(req->hardlink.oldpath);
 			putname(req->hardlink.newpath);
 			break;
+		case IORING_OP_SEND_ZC:
+			io_send_zc_cleanup(req);
+			break;
 		}
 	}
 	if ((req->flags & REQ_F_POLLED) && req->apoll) {
@@ -6769,6 +7436,12 @@ static int io_issue_sqe(struct io_kiocb *req, unsigned int issue_flags)
 	case IORING_OP_LINKAT:
 		ret = io_linkat(req, issue_flags);
 		break;
+	case IORING_OP_SEND_ZC:
+		ret = io_send_zc(req, issue_flags);
+		break;
+	case IORING_OP_SOCKET:
+		ret = io_socket(req, issue_flags);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -6838,6 +7511,37 @@ static inline struct io_fixed_file *io_fixed_file_slot(struct io_file_table *tab
 	return &table->files[i];
 }
 
+static inline void io_file_bitmap_set(struct io_file_table *table, int bit)
+{
+	WARN_ON_ONCE(test_bit(bit, table->bitmap));
+	__set_bit(bit, table->bitmap);
+	table->alloc_hint = bit + 1;
+}
+
+static inline void io_file_bitmap_clear(struct io_file_table *table, int bit)
+{
+	__clear_bit(bit, table->bitmap);
+	table->alloc_hint = bit;
+}
+
+/* find a free slot, starting after the last one handed out */
+static int io_file_bitmap_get(struct io_ring_ctx *ctx)
+{
+	struct io_file_table *table = &ctx->file_table;
+	unsigned long nr = ctx->nr_user_files;
+	unsigned long ret;
+
+	ret = find_next_zero_bit(table->bitmap, nr, table->alloc_hint);
+	if (ret != nr)
+		return ret;
+	if (table->alloc_hint) {
+		ret = find_first_zero_bit(table->bitmap, table->alloc_hint);
+		if (ret != table->alloc_hint)
+			return ret;
+	}
+	return -ENFILE;
+}
+
 static inline struct file *io_file_from_index(struct io_ring_ctx *ctx,
 					      int index)
 {
@@ -7110,7 +7814,7 @@ static int io_init_req(struct io_ring_ctx *ctx, struct io_kiocb *req,
 	 */
 	if (!state->plug_started && state->ios_left > 1 &&
 	    io_op_defs[req->opcode].plug) {
-		blk_start_plug(&state->plug);
+		blk_start_plug_nr_ios(&state->plug, state->ios_left);
 		state->plug_started = true;
 	}
 
@@ -7349,17 +8053,26 @@ static inline void io_ring_clear_wakeup_flag(struct io_ring_ctx *ctx)
 
 static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 {
-	unsigned int to_submit;
+	unsigned int to_submit, avail;
 	int ret = 0;
 
-	to_submit = io_sqring_entries(ctx);
-	/* if we're handling multiple rings, cap submit size for fairness */
-	if (cap_entries && to_submit > IORING_SQPOLL_CAP_ENTRIES_VALUE)
-		to_submit = IORING_SQPOLL_CAP_ENTRIES_VALUE;
+	avail = to_submit = io_sqring_entries(ctx);
+	/*
+	 * If we're handling multiple rings, cap submit size for fairness. Each
+	 * pass a ring earns a quantum proportional to its weight, whatever it
+	 * couldn't use because of the cap is carried over to the next pass as
+	 * long as it stays backlogged (deficit round robin).
+	 */
+	if (cap_entries && avail) {
+		ctx->sq_deficit += ctx->sq_weight * IORING_SQPOLL_CAP_ENTRIES_VALUE;
+		if (to_submit > ctx->sq_deficit)
+			to_submit = ctx->sq_deficit;
+	}
 
 	if (!list_empty(&ctx->iopoll_list) || to_submit) {
 		unsigned nr_events = 0;
 		const struct cred *creds = NULL;
+		u64 start = ktime_get_ns();
 
 		if (ctx->sq_creds != current_cred())
 			creds = override_creds(ctx->sq_creds);
@@ -7381,11 +8094,62 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 			wake_up(&ctx->sqo_sq_wait);
 		if (creds)
 			revert_creds(creds);
+
+		if (ret > 0)
+			ctx->sq_reaped += ret;
+		ctx->sq_runtime_ns += ktime_get_ns() - start;
 	}
 
+	if (cap_entries) {
+		/* an emptied queue doesn't get to bank its leftover quantum */
+		if (ret <= 0 || ret >= avail)
+			ctx->sq_deficit = 0;
+		else
+			ctx->sq_deficit -= min_t(unsigned int, ret, ctx->sq_deficit);
+	}
 	return ret;
 }
 
+/*
+ * With several rings on one SQPOLL thread, a ring that has been idle for
+ * longer than its own sq_thread_idle is parked: NEED_WAKEUP is raised for
+ * it and the thread stops looking at its SQ ring until the application
+ * kicks it with IORING_ENTER_SQ_WAKEUP, while it keeps spinning for the
+ * rings that are still busy.
+ */
+static void io_sq_ring_check_idle(struct io_ring_ctx *ctx)
+{
+	if (!time_after(jiffies, ctx->sq_last_active + ctx->sq_thread_idle))
+		return;
+
+	io_ring_set_wakeup_flag(ctx);
+	/* pairs with the application's barrier between SQ tail and flags */
+	smp_mb();
+	if (io_sqring_entries(ctx)) {
+		io_ring_clear_wakeup_flag(ctx);
+		ctx->sq_last_active = jiffies;
+		return;
+	}
+	ctx->sq_parked = true;
+}
+
+static void io_sq_ring_unpark(struct io_ring_ctx *ctx)
+{
+	ctx->sq_parked = false;
+	ctx->sq_last_active = jiffies;
+}
+
+static bool io_sq_ring_parked(struct io_ring_ctx *ctx)
+{
+	if (!ctx->sq_parked)
+		return false;
+	if (!atomic_xchg(&ctx->sq_kicked, 0))
+		return true;
+	io_ring_clear_wakeup_flag(ctx);
+	io_sq_ring_unpark(ctx);
+	return false;
+}
+
 static void io_sqd_update_thread_idle(struct io_sq_data *sqd)
 {
 	struct io_ring_ctx *ctx;
@@ -7441,10 +8205,17 @@ static int io_sq_thread(void *data)
 
 		cap_entries = !list_is_singular(&sqd->ctx_list);
 		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
-			int ret = __io_sq_thread(ctx, cap_entries);
+			int ret;
 
-			if (!sqt_spin && (ret > 0 || !list_empty(&ctx->iopoll_list)))
+			if (io_sq_ring_parked(ctx))
+				continue;
+			ret = __io_sq_thread(ctx, cap_entries);
+			if (ret > 0 || !list_empty(&ctx->iopoll_list)) {
+				ctx->sq_last_active = jiffies;
 				sqt_spin = true;
+			} else if (cap_entries) {
+				io_sq_ring_check_idle(ctx);
+			}
 		}
 		if (io_run_task_work())
 			sqt_spin = true;
@@ -7479,8 +8250,10 @@ static int io_sq_thread(void *data)
 				schedule();
 				mutex_lock(&sqd->lock);
 			}
-			list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+			list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
 				io_ring_clear_wakeup_flag(ctx);
+				io_sq_ring_unpark(ctx);
+			}
 		}
 
 		finish_wait(&sqd->wait, &wait);
@@ -7528,7 +8301,8 @@ static int io_wake_function(struct wait_queue_entry *curr, unsigned int mode,
 	 * Cannot safely flush overflowed CQEs from here, ensure we wake up
 	 * the task, and the next invocation will do it.
 	 */
-	if (io_should_wake(iowq) || test_bit(0, &iowq->ctx->check_cq_overflow))
+	if (io_should_wake(iowq) || test_bit(0, &iowq->ctx->check_cq_overflow) ||
+	    !llist_empty(&iowq->ctx->work_llist))
 		return autoremove_wake_function(curr, mode, wake_flags, key);
 	return -1;
 }
@@ -7551,6 +8325,12 @@ static inline int io_cqring_wait_schedule(struct io_ring_ctx *ctx,
 {
 	int ret;
 
+	if (!llist_empty(&ctx->work_llist)) {
+		__set_current_state(TASK_RUNNING);
+		if (io_run_local_work(ctx))
+			return 1;
+	}
+
 	/* make sure we run task_work before checking for signals */
 	ret = io_run_task_work_sig();
 	if (ret || io_should_wake(iowq))
@@ -7578,10 +8358,14 @@ static int io_cqring_wait(struct io_ring_ctx *ctx, int min_events,
 	int ret;
 
 	do {
+		bool ran;
+
+		io_run_local_work(ctx);
 		io_cqring_overflow_flush(ctx);
 		if (io_cqring_events(ctx) >= min_events)
 			return 0;
-		if (!io_run_task_work())
+		ran = io_run_task_work();
+		if (!ran && llist_empty(&ctx->work_llist))
 			break;
 	} while (1);
 
@@ -7860,13 +8644,25 @@ static bool io_alloc_file_tables(struct io_file_table *table, unsigned nr_files)
 {
 	table->files = kvcalloc(nr_files, sizeof(table->files[0]),
 				GFP_KERNEL_ACCOUNT);
-	return !!table->files;
+	if (unlikely(!table->files))
+		return false;
+
+	table->bitmap = bitmap_zalloc(nr_files, GFP_KERNEL_ACCOUNT);
+	if (unlikely(!table->bitmap)) {
+		kvfree(table->files);
+		table->files = NULL;
+		return false;
+	}
+	table->alloc_hint = 0;
+	return true;
 }
 
 static void io_free_file_tables(struct io_file_table *table)
 {
 	kvfree(table->files);
+	bitmap_free(table->bitmap);
 	table->files = NULL;
+	table->bitmap = NULL;
 }
 
 static void __io_sqe_files_unregister(struct io_ring_ctx *ctx)
@@ -8312,6 +9108,7 @@ static int io_sqe_files_register(struct io_ring_ctx *ctx, void __user *arg,
 			goto out_fput;
 		}
 		io_fixed_file_set(io_fixed_file_slot(&ctx->file_table, i), file);
+		io_file_bitmap_set(&ctx->file_table, i);
 	}
 
 	ret = io_sqe_files_scm(ctx);
@@ -8396,13 +9193,20 @@ static int io_queue_rsrc_removal(struct io_rsrc_data *data, unsigned idx,
 	return 0;
 }
 
+/*
+ * Install @file into the fixed file table. @file_index is the sqe->file_index
+ * value, either a 1-based slot or IORING_FILE_INDEX_ALLOC, in which case the
+ * picked slot is returned.
+ */
 static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
-				 unsigned int issue_flags, u32 slot_index)
+				 unsigned int issue_flags, u32 file_index)
 {
 	struct io_ring_ctx *ctx = req->ctx;
 	bool force_nonblock = issue_flags & IO_URING_F_NONBLOCK;
+	bool alloc_slot = file_index == IORING_FILE_INDEX_ALLOC;
 	bool needs_switch = false;
 	struct io_fixed_file *file_slot;
+	u32 slot_index;
 	int ret = -EBADF;
 
 	io_ring_submit_lock(ctx, !force_nonblock);
@@ -8411,9 +9215,17 @@ static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
 	ret = -ENXIO;
 	if (!ctx->file_data)
 		goto err;
-	ret = -EINVAL;
-	if (slot_index >= ctx->nr_user_files)
-		goto err;
+	if (alloc_slot) {
+		ret = io_file_bitmap_get(ctx);
+		if (ret < 0)
+			goto err;
+		slot_index = ret;
+	} else {
+		ret = -EINVAL;
+		slot_index = file_index - 1;
+		if (slot_index >= ctx->nr_user_files)
+			goto err;
+	}
 
 	slot_index = array_index_nospec(slot_index, ctx->nr_user_files);
 	file_slot = io_fixed_file_slot(&ctx->file_table, slot_index);
@@ -8431,18 +9243,21 @@ static int io_install_fixed_file(struct io_kiocb *req, struct file *file,
 		if (ret)
 			goto err;
 		file_slot->file_ptr = 0;
+		io_file_bitmap_clear(&ctx->file_table, slot_index);
 		needs_switch = true;
 	}
 
 	*io_get_tag_slot(ctx->file_data, slot_index) = 0;
 	io_fixed_file_set(file_slot, file);
+	io_file_bitmap_set(&ctx->file_table, slot_index);
 	ret = io_sqe_file_register(ctx, file, slot_index);
 	if (ret) {
 		file_slot->file_ptr = 0;
+		io_file_bitmap_clear(&ctx->file_table, slot_index);
 		goto err;
 	}
 
-	ret = 0;
+	ret = alloc_slot ? slot_index : 0;
 err:
 	if (needs_switch)
 		io_rsrc_node_switch(ctx, ctx->file_data);
@@ -8483,6 +9298,7 @@ static int io_close_fixed(struct io_kiocb *req, unsigned int issue_flags)
 		goto out;
 
 	file_slot->file_ptr = 0;
+	io_file_bitmap_clear(&ctx->file_table, offset);
 	io_rsrc_node_switch(ctx, ctx->file_data);
 	ret = 0;
 out:
@@ -8532,6 +9348,7 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 			if (err)
 				break;
 			file_slot->file_ptr = 0;
+			io_file_bitmap_clear(&ctx->file_table, i);
 			needs_switch = true;
 		}
 		if (fd != -1) {
@@ -8555,9 +9372,11 @@ static int __io_sqe_files_update(struct io_ring_ctx *ctx,
 			}
 			*io_get_tag_slot(data, i) = tag;
 			io_fixed_file_set(file_slot, file);
+			io_file_bitmap_set(&ctx->file_table, i);
 			err = io_sqe_file_register(ctx, file, i);
 			if (err) {
 				file_slot->file_ptr = 0;
+				io_file_bitmap_clear(&ctx->file_table, i);
 				fput(file);
 				break;
 			}
@@ -8673,6 +9492,9 @@ static int io_sq_offload_create(struct io_ring_ctx *ctx,
 		struct io_sq_data *sqd;
 		bool attached;
 
+		if (p->sq_thread_weight > IORING_SQPOLL_MAX_WEIGHT)
+			return -EINVAL;
+
 		sqd = io_get_sq_data(p, &attached);
 		if (IS_ERR(sqd)) {
 			ret = PTR_ERR(sqd);
@@ -8684,6 +9506,8 @@ static int io_sq_offload_create(struct io_ring_ctx *ctx,
 		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
 		if (!ctx->sq_thread_idle)
 			ctx->sq_thread_idle = HZ;
+		ctx->sq_weight = p->sq_thread_weight ?: 1;
+		ctx->sq_last_active = jiffies;
 
 		io_sq_thread_park(sqd);
 		list_add(&ctx->sqd_list, &sqd->ctx_list);
@@ -8721,8 +9545,8 @@ static int io_sq_offload_create(struct io_ring_ctx *ctx,
 		wake_up_new_task(tsk);
 		if (ret)
 			goto err;
-	} else if (p->flags & IORING_SETUP_SQ_AFF) {
-		/* Can't have SQ_AFF without SQPOLL */
+	} else if ((p->flags & IORING_SETUP_SQ_AFF) || p->sq_thread_weight) {
+		/* Can't have SQ_AFF or a weight without SQPOLL */
 		ret = -EINVAL;
 		goto err;
 	}
@@ -9256,13 +10080,116 @@ static int io_eventfd_unregister(struct io_ring_ctx *ctx)
 	return -ENXIO;
 }
 
+static void io_free_buf_ring(struct io_buffer_ring *bl)
+{
+	vunmap(bl->br);
+	unpin_user_pages(bl->pages, bl->nr_pages);
+	kvfree(bl->pages);
+	kfree(bl);
+}
+
 static void io_destroy_buffers(struct io_ring_ctx *ctx)
 {
+	struct io_buffer_ring *bl;
 	struct io_buffer *buf;
 	unsigned long index;
 
 	xa_for_each(&ctx->io_buffers, index, buf)
 		__io_remove_buffers(ctx, buf, index, -1U);
+	xa_for_each(&ctx->io_buf_rings, index, bl) {
+		xa_erase(&ctx->io_buf_rings, index);
+		io_free_buf_ring(bl);
+	}
+}
+
+static int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *bl;
+	struct page **pages;
+	unsigned long nr_pages;
+	long pret;
+	int ret;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+	if (!reg.ring_addr)
+		return -EFAULT;
+	if (reg.ring_addr & ~PAGE_MASK)
+		return -EINVAL;
+	/* head and tail are u16, a full ring must be told apart from empty */
+	if (!is_power_of_2(reg.ring_entries) || reg.ring_entries >= 65536)
+		return -EINVAL;
+	if (xa_load(&ctx->io_buffers, reg.bgid) ||
+	    xa_load(&ctx->io_buf_rings, reg.bgid))
+		return -EEXIST;
+
+	bl = kzalloc(sizeof(*bl), GFP_KERNEL_ACCOUNT);
+	if (!bl)
+		return -ENOMEM;
+
+	nr_pages = PAGE_ALIGN(reg.ring_entries * sizeof(struct io_uring_buf))
+			>> PAGE_SHIFT;
+	pages = kvmalloc_array(nr_pages, sizeof(struct page *), GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!pages)
+		goto err_free;
+
+	mmap_read_lock(current->mm);
+	pret = pin_user_pages(reg.ring_addr, nr_pages, FOLL_LONGTERM, pages,
+			      NULL);
+	mmap_read_unlock(current->mm);
+	if (pret != nr_pages) {
+		if (pret > 0)
+			unpin_user_pages(pages, pret);
+		ret = pret < 0 ? pret : -EFAULT;
+		goto err_pages;
+	}
+
+	bl->br = vmap(pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	ret = -ENOMEM;
+	if (!bl->br)
+		goto err_unpin;
+	bl->pages = pages;
+	bl->nr_pages = nr_pages;
+	bl->mask = reg.ring_entries - 1;
+
+	ret = xa_insert(&ctx->io_buf_rings, reg.bgid, bl, GFP_KERNEL_ACCOUNT);
+	if (ret)
+		io_free_buf_ring(bl);
+	return ret;
+err_unpin:
+	unpin_user_pages(pages, nr_pages);
+err_pages:
+	kvfree(pages);
+err_free:
+	kfree(bl);
+	return ret;
+}
+
+static int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *bl;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+
+	/*
+	 * Requests holding a buffer from this ring only reference it by
+	 * address and ID, so it can go away under them.
+	 */
+	bl = xa_erase(&ctx->io_buf_rings, reg.bgid);
+	if (!bl)
+		return -ENOENT;
+	io_free_buf_ring(bl);
+	return 0;
 }
 
 static void io_req_cache_free(struct list_head *list)
@@ -9300,6 +10227,8 @@ static void io_wait_rsrc_data(struct io_rsrc_data *data)
 static void io_ring_ctx_free(struct io_ring_ctx *ctx)
 {
 	io_sq_thread_finish(ctx);
+	if (ctx->submitter_task)
+		put_task_struct(ctx->submitter_task);
 
 	if (ctx->mm_account) {
 		mmdrop(ctx->mm_account);
@@ -9381,7 +10310,8 @@ static __poll_t io_uring_poll(struct file *file, poll_table *wait)
 	 * Users may get EPOLLIN meanwhile seeing nothing in cqring, this
 	 * pushs them to do the flush.
 	 */
-	if (io_cqring_events(ctx) || test_bit(0, &ctx->check_cq_overflow))
+	if (io_cqring_events(ctx) || test_bit(0, &ctx->check_cq_overflow) ||
+	    !llist_empty(&ctx->work_llist))
 		mask |= EPOLLIN | EPOLLRDNORM;
 
 	return mask;
@@ -9656,6 +10586,12 @@ static void io_uring_try_cancel_requests(struct io_ring_ctx *ctx,
 		ret |= io_cancel_defer_files(ctx, task, cancel_all);
 		ret |= io_poll_remove_all(ctx, task, cancel_all);
 		ret |= io_kill_timeouts(ctx, task, cancel_all);
+		if (ctx->flags & IORING_SETUP_DEFER_TASKRUN) {
+			if (current == ctx->submitter_task)
+				ret |= io_run_local_work(ctx);
+			else
+				ret |= io_move_task_work_from_local(ctx);
+		}
 		if (task)
 			ret |= io_run_task_work();
 		if (!ret)
@@ -9998,6 +10934,13 @@ SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
 	if (unlikely(ctx->flags & IORING_SETUP_R_DISABLED))
 		goto out;
 
+	if (ctx->flags & IORING_SETUP_DEFER_TASKRUN) {
+		ret = -EEXIST;
+		if (unlikely(current != ctx->submitter_task))
+			goto out;
+		io_run_local_work(ctx);
+	}
+
 	/*
 	 * For SQ polling, the thread will do all submissions and completions.
 	 * Just return the requested submit count, and wake the thread if
@@ -10011,8 +10954,10 @@ SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
 			ret = -EOWNERDEAD;
 			goto out;
 		}
-		if (flags & IORING_ENTER_SQ_WAKEUP)
+		if (flags & IORING_ENTER_SQ_WAKEUP) {
+			atomic_set(&ctx->sq_kicked, 1);
 			wake_up(&ctx->sq_data->wait);
+		}
 		if (flags & IORING_ENTER_SQ_WAIT) {
 			ret = io_sqpoll_wait_sq(ctx);
 			if (ret)
@@ -10116,6 +11061,13 @@ static void __io_uring_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
 
 	seq_printf(m, "SqThread:\t%d\n", sq ? task_pid_nr(sq->thread) : -1);
 	seq_printf(m, "SqThreadCpu:\t%d\n", sq ? task_cpu(sq->thread) : -1);
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		seq_printf(m, "SqWeight:\t%u\n", ctx->sq_weight);
+		seq_printf(m, "SqReaped:\t%llu\n", READ_ONCE(ctx->sq_reaped));
+		seq_printf(m, "SqRuntimeUsec:\t%llu\n",
+			   div_u64(READ_ONCE(ctx->sq_runtime_ns), NSEC_PER_USEC));
+		seq_printf(m, "SqParked:\t%d\n", READ_ONCE(ctx->sq_parked));
+	}
 	seq_printf(m, "UserFiles:\t%u\n", ctx->nr_user_files);
 	for (i = 0; has_lock && i < ctx->nr_user_files; i++) {
 		struct file *f = io_file_from_index(ctx, i);
@@ -10140,6 +11092,30 @@ static void __io_uring_show_fdinfo(struct io_ring_ctx *ctx, struct seq_file *m)
 		xa_for_each(&ctx->personalities, index, cred)
 			io_uring_show_cred(m, index, cred);
 	}
+	if (has_lock && !list_empty(&ctx->tctx_list)) {
+		struct io_tctx_node *node;
+
+		seq_printf(m, "IoWq:\n");
+		list_for_each_entry(node, &ctx->tctx_list, ctx_node) {
+			struct io_uring_task *tctx = node->task->io_uring;
+			struct io_wq_acct_stats stats[2];
+
+			if (!tctx || !tctx->io_wq)
+				continue;
+			io_wq_get_stats(tctx->io_wq, stats);
+			for (i = 0; i < ARRAY_SIZE(stats); i++) {
+				struct io_wq_acct_stats *s = &stats[i];
+
+				seq_printf(m, "  pid=%d, %s: workers=%u/%u, running=%u, pending=%u, enqueued=%lu, done=%lu, hash_stalls=%lu\n",
+					   task_pid_nr(node->task),
+					   i ? "unbound" : "bound",
+					   s->nr_workers, s->max_workers,
+					   s->nr_running, s->nr_pending,
+					   s->nr_enqueued, s->nr_done,
+					   s->nr_hash_stalls);
+			}
+		}
+	}
 	seq_printf(m, "PollList:\n");
 	spin_lock(&ctx->completion_lock);
 	for (i = 0; i < (1U << ctx->cancel_hash_bits); i++) {
@@ -10317,6 +11293,8 @@ static int io_uring_create(unsigned entries, struct io_uring_params *p,
 	if (!ctx)
 		return -ENOMEM;
 	ctx->compat = in_compat_syscall();
+	if (ctx->flags & IORING_SETUP_DEFER_TASKRUN)
+		ctx->submitter_task = get_task_struct(current);
 	if (!capable(CAP_IPC_LOCK))
 		ctx->user = get_uid(current_user());
 
@@ -10416,7 +11394,11 @@ static long io_uring_setup(u32 entries, struct io_uring_params __user *params)
 	if (p.flags & ~(IORING_SETUP_IOPOLL | IORING_SETUP_SQPOLL |
 			IORING_SETUP_SQ_AFF | IORING_SETUP_CQSIZE |
 			IORING_SETUP_CLAMP | IORING_SETUP_ATTACH_WQ |
-			IORING_SETUP_R_DISABLED))
+			IORING_SETUP_R_DISABLED | IORING_SETUP_DEFER_TASKRUN))
+		return -EINVAL;
+	/* the SQPOLL thread is the one submitting, nobody to defer to */
+	if ((p.flags & (IORING_SETUP_SQPOLL | IORING_SETUP_DEFER_TASKRUN)) ==
+	    (IORING_SETUP_SQPOLL | IORING_SETUP_DEFER_TASKRUN))
 		return -EINVAL;
 
 	return  io_uring_create(entries, &p, params);
@@ -10792,6 +11774,8 @@ static bool io_register_op_must_quiesce(int op)
 	case IORING_REGISTER_IOWQ_AFF:
 	case IORING_UNREGISTER_IOWQ_AFF:
 	case IORING_REGISTER_IOWQ_MAX_WORKERS:
+	case IORING_REGISTER_PBUF_RING:
+	case IORING_UNREGISTER_PBUF_RING:
 		return false;
 	default:
 		return true;
@@ -10954,6 +11938,18 @@ static int __io_uring_register(struct io_ring_ctx *ctx, unsigned opcode,
 			break;
 		ret = io_register_iowq_max_workers(ctx, arg);
 		break;
+	case IORING_REGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_register_pbuf_ring(ctx, arg);
+		break;
+	case IORING_UNREGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_unregister_pbuf_ring(ctx, arg);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -11045,6 +12041,11 @@ static int __init io_uring_init(void)
 	/* ->buf_index is u16 */
 	BUILD_BUG_ON(IORING_MAX_REG_BUFFERS >= (1u << 16));
 
+	/* the buf ring tail must overlay the first buffer's resv field */
+	BUILD_BUG_ON(offsetof(struct io_uring_buf_ring, bufs) != 0);
+	BUILD_BUG_ON(offsetof(struct io_uring_buf, resv) !=
+		     offsetof(struct io_uring_buf_ring, tail));
+
 	/* should fit into one byte */
 	BUILD_BUG_ON(SQE_VALID_FLAGS >= (1 << 8));
 
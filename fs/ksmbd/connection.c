@@ -141,6 +141,47 @@ int ksmbd_conn_try_dequeue_request(struct ksmbd_work *work)
 	return ret;
 }
 
+void ksmbd_conn_account_request(struct ksmbd_work *work)
+{
+	struct ksmbd_stats *stats = &work->conn->stats;
+	s64 us = ktime_us_delta(ktime_get(), work->start_time);
+	s64 max = atomic64_read(&stats->request_time_max_us);
+
+	atomic64_add(us, &stats->request_time_us);
+	while (us > max) {
+		s64 old = atomic64_cmpxchg(&stats->request_time_max_us, max, us);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
+/**
+ * ksmbd_conn_show_stats() - print the request stats of every connection
+ * @buf:	sysfs buffer, PAGE_SIZE bytes
+ *
+ * One line per connection: peer address, requests served, total and
+ * maximum request time in usecs.  The time of a request runs from its
+ * reception until its response has been sent.
+ */
+ssize_t ksmbd_conn_show_stats(char *buf)
+{
+	struct ksmbd_conn *conn;
+	ssize_t sz = 0;
+
+	read_lock(&conn_list_lock);
+	list_for_each_entry(conn, &conn_list, conns_list) {
+		sz += scnprintf(buf + sz, PAGE_SIZE - sz, "%pIS %lld %lld %lld\n",
+				KSMBD_TCP_PEER_SOCKADDR(conn),
+				atomic64_read(&conn->stats.request_served),
+				atomic64_read(&conn->stats.request_time_us),
+				atomic64_read(&conn->stats.request_time_max_us));
+	}
+	read_unlock(&conn_list_lock);
+	return sz;
+}
+
 static void ksmbd_conn_lock(struct ksmbd_conn *conn)
 {
 	mutex_lock(&conn->srv_mutex);
@@ -38,6 +38,9 @@ enum {
 struct ksmbd_stats {
 	atomic_t			open_files_count;
 	atomic64_t			request_served;
+	/* Time from reception to response sent, in usecs */
+	atomic64_t			request_time_us;
+	atomic64_t			request_time_max_us;
 };
 
 struct ksmbd_transport;
@@ -160,9 +163,11 @@ int ksmbd_conn_rdma_write(struct ksmbd_conn *conn, void *buf,
 			  u32 remote_len);
 void ksmbd_conn_enqueue_request(struct ksmbd_work *work);
 int ksmbd_conn_try_dequeue_request(struct ksmbd_work *work);
+void ksmbd_conn_account_request(struct ksmbd_work *work);
 void ksmbd_conn_init_server_callbacks(struct ksmbd_conn_ops *ops);
 int ksmbd_conn_handler_loop(void *p);
 int ksmbd_conn_transport_init(void);
+ssize_t ksmbd_conn_show_stats(char *buf);
 void ksmbd_conn_transport_destroy(void);
 
 /*
@@ -61,7 +61,11 @@ int ksmbd_work_pool_init(void)
 
 int ksmbd_workqueue_init(void)
 {
-	ksmbd_wq = alloc_workqueue("ksmbd-io", 0, 0);
+	/*
+	 * Unbound, so the requests read by one connection thread are not
+	 * all processed on the CPU that thread happens to run on.
+	 */
+	ksmbd_wq = alloc_workqueue("ksmbd-io", WQ_UNBOUND, 0);
 	if (!ksmbd_wq)
 		return -ENOMEM;
 	return 0;
@@ -78,6 +78,8 @@ struct ksmbd_work {
 	void                            (*cancel_fn)(void **argv);
 
 	struct work_struct              work;
+	/* Time the request was received */
+	ktime_t				start_time;
 	/* List head at conn->requests */
 	struct list_head                request_entry;
 	/* List head at conn->async_requests */
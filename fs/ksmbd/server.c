@@ -258,6 +258,7 @@ static void handle_ksmbd_work(struct work_struct *wk)
 	atomic64_inc(&conn->stats.request_served);
 
 	__handle_ksmbd_work(work, conn);
+	ksmbd_conn_account_request(work);
 
 	ksmbd_conn_try_dequeue_request(work);
 	ksmbd_free_work_struct(work);
@@ -294,6 +295,7 @@ static int queue_ksmbd_work(struct ksmbd_conn *conn)
 	atomic_inc(&conn->r_count);
 	/* update activity on connection */
 	conn->last_active = jiffies;
+	work->start_time = ktime_get();
 	INIT_WORK(&work->work, handle_ksmbd_work);
 	ksmbd_queue_work(work);
 	return 0;
@@ -435,6 +437,12 @@ static ssize_t stats_show(struct class *class, struct class_attribute *attr,
 	return sz;
 }
 
+static ssize_t conn_stats_show(struct class *class,
+			       struct class_attribute *attr, char *buf)
+{
+	return ksmbd_conn_show_stats(buf);
+}
+
 static ssize_t kill_server_store(struct class *class,
 				 struct class_attribute *attr, const char *buf,
 				 size_t len)
@@ -507,11 +515,13 @@ static ssize_t debug_store(struct class *class, struct class_attribute *attr,
 }
 
 static CLASS_ATTR_RO(stats);
+static CLASS_ATTR_RO(conn_stats);
 static CLASS_ATTR_WO(kill_server);
 static CLASS_ATTR_RW(debug);
 
 static struct attribute *ksmbd_control_class_attrs[] = {
 	&class_attr_stats.attr,
+	&class_attr_conn_stats.attr,
 	&class_attr_kill_server.attr,
 	&class_attr_debug.attr,
 	NULL,
@@ -920,6 +920,7 @@ static int find_and_lock_cache_page(struct nfs_readdir_descriptor *desc)
 	if (!desc->page)
 		return -ENOMEM;
 	if (nfs_readdir_page_needs_filling(desc->page)) {
+		nfs_inc_stats(inode, NFSIOS_READDIRCACHEMISS);
 		res = nfs_readdir_xdr_to_array(desc, nfsi->cookieverf, verf,
 					       &desc->page, 1);
 		if (res < 0) {
@@ -937,7 +938,8 @@ static int find_and_lock_cache_page(struct nfs_readdir_descriptor *desc)
 		if (desc->page_index == 0)
 			memcpy(nfsi->cookieverf, verf,
 			       sizeof(nfsi->cookieverf));
-	}
+	} else
+		nfs_inc_stats(inode, NFSIOS_READDIRCACHEHIT);
 	res = nfs_readdir_search_array(desc);
 	if (res == 0)
 		return 0;
@@ -945,6 +947,107 @@ static int find_and_lock_cache_page(struct nfs_readdir_descriptor *desc)
 	return res;
 }
 
+/*
+ * Readdir readahead: once a reader has moved past the first page of a
+ * directory, fill the next few pages of the cache from nfsiod while the
+ * reader is busy with the current one.
+ */
+#define NFS_READDIR_RA_PAGES	8
+
+struct nfs_readdir_ra {
+	struct work_struct work;
+	struct file	*file;
+	pgoff_t		index;
+	u64		cookie;
+	bool		plus;
+};
+
+static void nfs_readdir_readahead_work(struct work_struct *work)
+{
+	struct nfs_readdir_ra *ra = container_of(work, struct nfs_readdir_ra,
+						 work);
+	struct address_space *mapping = ra->file->f_mapping;
+	struct nfs_inode *nfsi = NFS_I(file_inode(ra->file));
+	struct nfs_readdir_descriptor *desc;
+	__be32 verf[NFS_DIR_VERIFIER_SIZE];
+	struct nfs_cache_array *array;
+	u64 cookie = ra->cookie;
+	struct page *page;
+	pgoff_t index;
+	bool done;
+
+	desc = kzalloc(sizeof(*desc), GFP_KERNEL);
+	if (!desc)
+		goto out;
+	desc->file = ra->file;
+	desc->plus = ra->plus;
+
+	for (index = ra->index; index < ra->index + NFS_READDIR_RA_PAGES;
+	     index++) {
+		page = nfs_readdir_page_get_locked(mapping, index, cookie);
+		if (!page)
+			break;
+		if (nfs_readdir_page_needs_filling(page) &&
+		    nfs_readdir_xdr_to_array(desc, nfsi->cookieverf, verf,
+					     &page, 1) < 0) {
+			nfs_readdir_page_unlock_and_put(page);
+			break;
+		}
+		array = kmap_atomic(page);
+		done = array->page_is_eof || !array->page_full;
+		cookie = array->last_cookie;
+		kunmap_atomic(array);
+		nfs_readdir_page_unlock_and_put(page);
+		if (done)
+			break;
+	}
+	kfree(desc);
+out:
+	clear_bit(NFS_INO_READDIR_RA, &nfsi->flags);
+	fput(ra->file);
+	kfree(ra);
+}
+
+/* Called with desc->page locked and found to hold desc->dir_cookie */
+static void nfs_readdir_start_readahead(struct nfs_readdir_descriptor *desc)
+{
+	struct address_space *mapping = desc->file->f_mapping;
+	struct nfs_inode *nfsi = NFS_I(file_inode(desc->file));
+	struct nfs_cache_array *array;
+	struct nfs_readdir_ra *ra;
+	struct page *page;
+	bool done;
+	u64 cookie;
+
+	array = kmap_atomic(desc->page);
+	done = array->page_is_eof || !array->page_full;
+	cookie = array->last_cookie;
+	kunmap_atomic(array);
+	if (done)
+		return;
+
+	/* Pages are filled in order, so this one is the end of the window */
+	page = find_get_page(mapping, desc->page_index + NFS_READDIR_RA_PAGES);
+	if (page) {
+		put_page(page);
+		return;
+	}
+
+	if (test_and_set_bit(NFS_INO_READDIR_RA, &nfsi->flags))
+		return;
+	ra = kmalloc(sizeof(*ra), GFP_KERNEL);
+	if (!ra) {
+		clear_bit(NFS_INO_READDIR_RA, &nfsi->flags);
+		return;
+	}
+	INIT_WORK(&ra->work, nfs_readdir_readahead_work);
+	ra->file = get_file(desc->file);
+	ra->index = desc->page_index + 1;
+	ra->cookie = cookie;
+	ra->plus = desc->plus;
+	queue_work(nfsiod_workqueue, &ra->work);
+}
+
 static bool nfs_readdir_dont_search_cache(struct nfs_readdir_descriptor *desc)
 {
 	struct address_space *mapping = desc->file->f_mapping;
@@ -1147,6 +1250,8 @@ static int nfs_readdir(struct file *file, struct dir_context *ctx)
 		if (res < 0)
 			break;
 
+		if (desc->page_index > 0)
+			nfs_readdir_start_readahead(desc);
 		nfs_do_filldir(desc, nfsi->cookieverf);
 		nfs_readdir_page_unlock_and_put_cached(desc);
 	} while (!desc->eof);
@@ -1195,8 +1195,12 @@ struct file *file_open_root(const struct path *root,
 }
 EXPORT_SYMBOL(file_open_root);
 
-static long do_sys_openat2(int dfd, const char __user *filename,
-			   struct open_how *how)
+/*
+ * Open @filename and reserve an fd for it without installing it, so that the
+ * caller can still back out with fput() and put_unused_fd().
+ */
+static long do_sys_openat2_reserve(int dfd, const char __user *filename,
+				   struct open_how *how, struct file **filp)
 {
 	struct open_flags op;
 	int fd = build_open_flags(how, &op);
@@ -1216,14 +1220,27 @@ static long do_sys_openat2(int dfd, const char __user *filename,
 			put_unused_fd(fd);
 			fd = PTR_ERR(f);
 		} else {
-			fsnotify_open(f);
-			fd_install(fd, f);
+			*filp = f;
 		}
 	}
 	putname(tmp);
 	return fd;
 }
 
+static long do_sys_openat2(int dfd, const char __user *filename,
+			   struct open_how *how)
+{
+	struct file *f;
+	long fd;
+
+	fd = do_sys_openat2_reserve(dfd, filename, how, &f);
+	if (fd >= 0) {
+		fsnotify_open(f);
+		fd_install(fd, f);
+	}
+	return fd;
+}
+
 long do_sys_open(int dfd, const char __user *filename, int flags, umode_t mode)
 {
 	struct open_how how = build_open_how(flags, mode);
@@ -1269,6 +1286,62 @@ SYSCALL_DEFINE4(openat2, int, dfd, const char __user *, filename,
 	return do_sys_openat2(dfd, filename, &tmp);
 }
 
+/*
+ * openat2() a batch of names relative to @dfd.  Each entry gets the new fd
+ * or the error openat2() would have returned for it.  Returns the number of
+ * entries processed, which is less than @nr only when the entry array can't
+ * be accessed or a fatal signal is pending, or an error if none was.
+ */
+SYSCALL_DEFINE4(openat_many, int, dfd,
+		struct open_many_entry __user *, entries, unsigned int, nr,
+		unsigned int, flags)
+{
+	struct open_many_entry entry;
+	struct file *f;
+	unsigned int i;
+	long fd;
+
+	if (flags)
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		if (fatal_signal_pending(current))
+			return i ? i : -EINTR;
+		if (copy_from_user(&entry, &entries[i], sizeof(entry)))
+			return i ? i : -EFAULT;
+
+		if (entry.__reserved) {
+			fd = -EINVAL;
+		} else {
+			if (force_o_largefile())
+				entry.how.flags |= O_LARGEFILE;
+			fd = do_sys_openat2_reserve(dfd,
+						    u64_to_user_ptr(entry.name),
+						    &entry.how, &f);
+		}
+
+		/*
+		 * Only install the fd once userspace has been told about it;
+		 * an installed fd may already have been closed and reused by
+		 * another thread, so it can't be taken back.
+		 */
+		if (put_user((s32)fd, &entries[i].result)) {
+			if (fd >= 0) {
+				fput(f);
+				put_unused_fd(fd);
+			}
+			return i ? i : -EFAULT;
+		}
+		if (fd >= 0) {
+			fsnotify_open(f);
+			fd_install(fd, f);
+		}
+		cond_resched();
+	}
+
+	return nr;
+}
+
 #ifdef CONFIG_COMPAT
 /*
  * Exactly like sys_open(), except that it doesn't set the
@@ -19,10 +19,16 @@
 #include <linux/fdtable.h>
 #include <linux/ratelimit.h>
 #include <linux/exportfs.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
 #include "overlayfs.h"
 
 #define OVL_COPY_UP_CHUNK_SIZE (1 << 20)
 
+/* Don't bother splitting up the copy of files smaller than this per thread */
+#define OVL_COPY_UP_PARALLEL_MIN (16 << 20)
+#define OVL_COPY_UP_MAX_THREADS 16U
+
 static int ovl_ccup_set(const char *buf, const struct kernel_param *param)
 {
 	pr_warn("\"check_copy_up\" module option is obsolete\n");
@@ -37,6 +43,11 @@ static int ovl_ccup_get(char *buf, const struct kernel_param *param)
 module_param_call(check_copy_up, ovl_ccup_set, ovl_ccup_get, NULL, 0644);
 MODULE_PARM_DESC(check_copy_up, "Obsolete; does nothing");
 
+static unsigned int ovl_copy_up_threads = 4;
+module_param_named(copy_up_threads, ovl_copy_up_threads, uint, 0644);
+MODULE_PARM_DESC(copy_up_threads,
+		 "Maximum number of threads copying up the data of one large file");
+
 static bool ovl_must_copy_xattr(const char *name)
 {
 	return !strcmp(name, XATTR_POSIX_ACL_ACCESS) ||
@@ -193,42 +204,42 @@ static int ovl_copy_fileattr(struct inode *inode, struct path *old,
 	return ovl_real_fileattr_set(new, &newfa);
 }
 
-static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
-			    struct path *new, loff_t len)
-{
+/* State shared by the threads copying up the data of one file */
+struct ovl_copy_up_job {
 	struct file *old_file;
 	struct file *new_file;
-	loff_t old_pos = 0;
-	loff_t new_pos = 0;
-	loff_t cloned;
-	loff_t data_pos = -1;
-	loff_t hole_len;
-	bool skip_hole = false;
-	int error = 0;
-
-	if (len == 0)
-		return 0;
-
-	old_file = ovl_path_open(old, O_LARGEFILE | O_RDONLY);
-	if (IS_ERR(old_file))
-		return PTR_ERR(old_file);
+	const struct cred *cred;
+	bool skip_hole;
+	bool copy_file_range;
+	/* First error, also stops the other threads */
+	int error;
+	atomic_t pending;
+	struct completion done;
+};
 
-	new_file = ovl_path_open(new, O_LARGEFILE | O_WRONLY);
-	if (IS_ERR(new_file)) {
-		error = PTR_ERR(new_file);
-		goto out_fput;
-	}
+struct ovl_copy_up_work {
+	struct work_struct work;
+	struct ovl_copy_up_job *job;
+	loff_t pos;
+	loff_t len;
+};
 
-	/* Try to use clone_file_range to clone up within the same fs */
-	cloned = do_clone_file_range(old_file, 0, new_file, 0, len, 0);
-	if (cloned == len)
-		goto out;
-	/* Couldn't clone, so now we try to copy the data */
+static void ovl_copy_up_set_error(struct ovl_copy_up_job *job, int error)
+{
+	cmpxchg(&job->error, 0, error);
+}
 
-	/* Check if lower fs supports seek operation */
-	if (old_file->f_mode & FMODE_LSEEK &&
-	    old_file->f_op->llseek)
-		skip_hole = true;
+/* Copy [pos, pos + len) of the file */
+static int ovl_copy_up_range(struct ovl_copy_up_job *job, loff_t pos,
+			     loff_t len)
+{
+	struct file *old_file = job->old_file;
+	struct file *new_file = job->new_file;
+	loff_t old_pos = pos;
+	loff_t new_pos = pos;
+	loff_t data_pos = -1;
+	loff_t hole_len;
+	bool skip_hole = job->skip_hole;
 
 	while (len) {
 		size_t this_len = OVL_COPY_UP_CHUNK_SIZE;
@@ -237,10 +248,12 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 		if (len < this_len)
 			this_len = len;
 
-		if (signal_pending_state(TASK_KILLABLE, current)) {
-			error = -EINTR;
-			break;
-		}
+		if (signal_pending_state(TASK_KILLABLE, current))
+			return -EINTR;
+
+		/* Another thread failed, the copy up is going to fail */
+		if (READ_ONCE(job->error))
+			return 0;
 
 		/*
 		 * Fill zero for hole will cost unnecessary disk space
@@ -260,7 +273,10 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 
 		if (skip_hole && data_pos < old_pos) {
 			data_pos = vfs_llseek(old_file, old_pos, SEEK_DATA);
-			if (data_pos > old_pos) {
+			if (data_pos >= old_pos + len) {
+				/* The rest of this range is a hole */
+				break;
+			} else if (data_pos > old_pos) {
 				hole_len = data_pos - old_pos;
 				len -= hole_len;
 				old_pos = new_pos = data_pos;
@@ -272,17 +288,152 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 			}
 		}
 
+		/*
+		 * Let the filesystem offload the copy if it can, a server
+		 * side copy or a clone of part of the file still beats
+		 * moving the data through the page cache.
+		 */
+		if (READ_ONCE(job->copy_file_range)) {
+			bytes = new_file->f_op->copy_file_range(old_file,
+					old_pos, new_file, new_pos, this_len, 0);
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				len -= bytes;
+				continue;
+			}
+			if (bytes && bytes != -EOPNOTSUPP && bytes != -EXDEV &&
+			    bytes != -EINVAL)
+				return bytes;
+			WRITE_ONCE(job->copy_file_range, false);
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
-		if (bytes <= 0) {
-			error = bytes;
-			break;
-		}
+		if (bytes <= 0)
+			return bytes;
 		WARN_ON(old_pos != new_pos);
 
 		len -= bytes;
 	}
+
+	return 0;
+}
+
+static void ovl_copy_up_workfn(struct work_struct *work)
+{
+	struct ovl_copy_up_work *w = container_of(work, typeof(*w), work);
+	struct ovl_copy_up_job *job = w->job;
+	const struct cred *old_cred;
+	int error;
+
+	old_cred = override_creds(job->cred);
+	error = ovl_copy_up_range(job, w->pos, w->len);
+	revert_creds(old_cred);
+
+	if (error)
+		ovl_copy_up_set_error(job, error);
+	if (atomic_dec_and_test(&job->pending))
+		complete(&job->done);
+}
+
+/* Number of threads copying up a file of size len */
+static unsigned int ovl_copy_up_nr_threads(loff_t len)
+{
+	loff_t nr = div64_u64(len, OVL_COPY_UP_PARALLEL_MIN);
+
+	return clamp_t(loff_t, nr, 1,
+		       min3(READ_ONCE(ovl_copy_up_threads),
+			    num_online_cpus(), OVL_COPY_UP_MAX_THREADS));
+}
+
+/*
+ * Large files are split into as many ranges as there are threads, the
+ * caller copies the first one and unbound workers the others.
+ */
+static int ovl_copy_up_file(struct ovl_copy_up_job *job, loff_t len)
+{
+	unsigned int i, nr = ovl_copy_up_nr_threads(len);
+	struct ovl_copy_up_work *works;
+	loff_t chunk, pos;
+	int error;
+
+	if (nr <= 1)
+		return ovl_copy_up_range(job, 0, len);
+
+	works = kcalloc(nr - 1, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return ovl_copy_up_range(job, 0, len);
+
+	chunk = round_up(div_u64(len + nr - 1, nr), OVL_COPY_UP_CHUNK_SIZE);
+	init_completion(&job->done);
+	atomic_set(&job->pending, 1);
+	for (i = 0, pos = chunk; i < nr - 1 && pos < len; i++, pos += chunk) {
+		works[i].job = job;
+		works[i].pos = pos;
+		works[i].len = min(chunk, len - pos);
+		INIT_WORK(&works[i].work, ovl_copy_up_workfn);
+		atomic_inc(&job->pending);
+		queue_work(system_unbound_wq, &works[i].work);
+	}
+
+	error = ovl_copy_up_range(job, 0, min(chunk, len));
+	if (error)
+		ovl_copy_up_set_error(job, error);
+
+	/* The workers use our files and credentials, wait even when killed */
+	if (!atomic_dec_and_test(&job->pending))
+		wait_for_completion(&job->done);
+	kfree(works);
+
+	return job->error;
+}
+
+static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
+			    struct path *new, loff_t len)
+{
+	struct ovl_copy_up_job job = {
+		.cred = current_cred(),
+	};
+	struct file *old_file;
+	struct file *new_file;
+	loff_t cloned;
+	int error = 0;
+
+	if (len == 0)
+		return 0;
+
+	old_file = ovl_path_open(old, O_LARGEFILE | O_RDONLY);
+	if (IS_ERR(old_file))
+		return PTR_ERR(old_file);
+
+	new_file = ovl_path_open(new, O_LARGEFILE | O_WRONLY);
+	if (IS_ERR(new_file)) {
+		error = PTR_ERR(new_file);
+		goto out_fput;
+	}
+
+	/* Try to use clone_file_range to clone up within the same fs */
+	cloned = do_clone_file_range(old_file, 0, new_file, 0, len, 0);
+	if (cloned == len)
+		goto out;
+	/* Couldn't clone, so now we try to copy the data */
+
+	job.old_file = old_file;
+	job.new_file = new_file;
+
+	/* Check if lower fs supports seek operation */
+	if (old_file->f_mode & FMODE_LSEEK &&
+	    old_file->f_op->llseek)
+		job.skip_hole = true;
+
+	/* Same condition as vfs_copy_file_range() for using the method */
+	if (new_file->f_op->copy_file_range &&
+	    new_file->f_op->copy_file_range == old_file->f_op->copy_file_range)
+		job.copy_file_range = true;
+
+	error = ovl_copy_up_file(&job, len);
 out:
 	if (!error && ovl_should_sync(ofs))
 		error = vfs_fsync(new_file, 0);
@@ -130,8 +130,9 @@ static void anon_pipe_buf_release(struct pipe_inode_info *pipe,
 	 * If nobody else uses this page, and we don't already have a
 	 * temporary page, let's keep track of it as a one-deep
 	 * allocation cache. (Otherwise just release our reference to it)
+	 * Only order-0 pages are cached, large buffers are freed right away.
 	 */
-	if (page_count(page) == 1 && !pipe->tmp_page)
+	if (page_count(page) == 1 && !pipe->tmp_page && !PageCompound(page))
 		pipe->tmp_page = page;
 	else
 		put_page(page);
@@ -142,7 +143,7 @@ static bool anon_pipe_buf_try_steal(struct pipe_inode_info *pipe,
 {
 	struct page *page = buf->page;
 
-	if (page_count(page) != 1)
+	if (page_count(page) != 1 || PageCompound(page))
 		return false;
 	memcg_kmem_uncharge_page(page, 0);
 	__SetPageLocked(page);
@@ -459,7 +460,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 		int offset = buf->offset + buf->len;
 
 		if ((buf->flags & PIPE_BUF_FLAG_CAN_MERGE) &&
-		    offset + chars <= PAGE_SIZE) {
+		    offset + chars <= page_size(buf->page)) {
 			ret = pipe_buf_confirm(pipe, buf);
 			if (ret)
 				goto out;
@@ -489,8 +490,21 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			unsigned int mask = pipe->ring_size - 1;
 			struct pipe_buffer *buf = &pipe->bufs[head & mask];
 			struct page *page = pipe->tmp_page;
+			size_t size;
 			int copied;
 
+			/*
+			 * Pipes set up with F_SETPIPE_BUFSZ fill large buffers
+			 * for big writes.  They are lowmem since the copy below
+			 * maps the whole buffer at once.
+			 */
+			if (pipe->buf_order && iov_iter_count(from) > PAGE_SIZE) {
+				page = alloc_pages(GFP_USER | __GFP_ACCOUNT |
+						   __GFP_COMP | __GFP_NORETRY |
+						   __GFP_NOWARN, pipe->buf_order);
+				if (!page)
+					page = pipe->tmp_page;
+			}
 			if (!page) {
 				page = alloc_page(GFP_HIGHUSER | __GFP_ACCOUNT);
 				if (unlikely(!page)) {
@@ -499,6 +513,7 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				}
 				pipe->tmp_page = page;
 			}
+			size = page_size(page);
 
 			/* Allocate a slot in the ring in advance and attach an
 			 * empty buffer.  If we fault or otherwise fail to use
@@ -510,6 +525,8 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 			head = pipe->head;
 			if (pipe_full(head, pipe->tail, pipe->max_usage)) {
 				spin_unlock_irq(&pipe->rd_wait.lock);
+				if (page != pipe->tmp_page)
+					put_page(page);
 				continue;
 			}
 
@@ -526,10 +543,11 @@ pipe_write(struct kiocb *iocb, struct iov_iter *from)
 				buf->flags = PIPE_BUF_FLAG_PACKET;
 			else
 				buf->flags = PIPE_BUF_FLAG_CAN_MERGE;
-			pipe->tmp_page = NULL;
+			if (page == pipe->tmp_page)
+				pipe->tmp_page = NULL;
 
-			copied = copy_page_from_iter(page, 0, PAGE_SIZE, from);
-			if (unlikely(copied < PAGE_SIZE && iov_iter_count(from))) {
+			copied = copy_page_from_iter(page, 0, size, from);
+			if (unlikely(copied < size && iov_iter_count(from))) {
 				if (!ret)
 					ret = -EFAULT;
 				break;
@@ -1316,7 +1334,7 @@ int pipe_resize_ring(struct pipe_inode_info *pipe, unsigned int nr_slots)
 static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 {
 	unsigned long user_bufs;
-	unsigned int nr_slots, size;
+	unsigned int nr_slots, nr_pages, size;
 	long ret = 0;
 
 #ifdef CONFIG_WATCH_QUEUE
@@ -1338,10 +1356,12 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 	 * if the user is currently over a limit.
 	 */
 	if (nr_slots > pipe->max_usage &&
-			size > pipe_max_size && !capable(CAP_SYS_RESOURCE))
+			((unsigned long)size << pipe->buf_order) > pipe_max_size &&
+			!capable(CAP_SYS_RESOURCE))
 		return -EPERM;
 
-	user_bufs = account_pipe_buffers(pipe->user, pipe->nr_accounted, nr_slots);
+	nr_pages = nr_slots << pipe->buf_order;
+	user_bufs = account_pipe_buffers(pipe->user, pipe->nr_accounted, nr_pages);
 
 	if (nr_slots > pipe->max_usage &&
 			(too_many_pipe_buffers_hard(user_bufs) ||
@@ -1356,14 +1376,57 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long arg)
 		goto out_revert_acct;
 
 	pipe->max_usage = nr_slots;
-	pipe->nr_accounted = nr_slots;
+	pipe->nr_accounted = nr_pages;
 	return pipe->max_usage * PAGE_SIZE;
 
 out_revert_acct:
-	(void) account_pipe_buffers(pipe->user, nr_slots, pipe->nr_accounted);
+	(void) account_pipe_buffers(pipe->user, nr_pages, pipe->nr_accounted);
 	return ret;
 }
 
+/*
+ * Set the size of the buffers that back each slot of the ring. The pipe is
+ * charged for its full capacity, the number of slots times the buffer size,
+ * under the same limits as F_SETPIPE_SZ. Returns the buffer size if
+ * successful, or -ERROR on error.
+ */
+static long pipe_set_buf_size(struct pipe_inode_info *pipe, unsigned long arg)
+{
+	unsigned long user_bufs;
+	unsigned int order, nr_pages;
+
+#ifdef CONFIG_WATCH_QUEUE
+	if (pipe->watch_queue)
+		return -EBUSY;
+#endif
+
+	if (arg < PAGE_SIZE || !is_power_of_2(arg))
+		return -EINVAL;
+	order = ilog2(arg) - PAGE_SHIFT;
+	if (order > PIPE_MAX_BUF_ORDER)
+		return -EINVAL;
+
+	nr_pages = pipe->max_usage << order;
+	if (order > pipe->buf_order &&
+			(unsigned long)nr_pages * PAGE_SIZE > pipe_max_size &&
+			!capable(CAP_SYS_RESOURCE))
+		return -EPERM;
+
+	user_bufs = account_pipe_buffers(pipe->user, pipe->nr_accounted, nr_pages);
+
+	if (order > pipe->buf_order &&
+			(too_many_pipe_buffers_hard(user_bufs) ||
+			 too_many_pipe_buffers_soft(user_bufs)) &&
+			pipe_is_unprivileged_user()) {
+		(void) account_pipe_buffers(pipe->user, nr_pages, pipe->nr_accounted);
+		return -EPERM;
+	}
+
+	pipe->buf_order = order;
+	pipe->nr_accounted = nr_pages;
+	return PAGE_SIZE << order;
+}
+
 /*
  * Note that i_pipe and i_cdev share the same location, so checking ->i_pipe is
  * not enough to verify that this is a pipe.
@@ -1399,6 +1462,12 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 	case F_GETPIPE_SZ:
 		ret = pipe->max_usage * PAGE_SIZE;
 		break;
+	case F_SETPIPE_BUFSZ:
+		ret = pipe_set_buf_size(pipe, arg);
+		break;
+	case F_GETPIPE_BUFSZ:
+		ret = PAGE_SIZE << pipe->buf_order;
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -638,6 +638,53 @@ SYSCALL_DEFINE5(statx,
 	return do_statx(dfd, filename, flags, mask, buffer);
 }
 
+/**
+ * sys_statx_many - statx() a batch of names
+ * @dfd: Base directory to pathwalk from *or* fd to stat.
+ * @entries: Names, result buffers and per-name results.
+ * @nr: Number of entries.
+ * @flags: AT_* flags to control pathwalk, used for every name.
+ * @mask: Parts of statx struct actually required.
+ *
+ * Each entry gets the result statx() would have returned for it, so a
+ * missing name doesn't stop the others.  Returns the number of entries
+ * processed, which is less than @nr only when the entry array can't be
+ * accessed or a fatal signal is pending, or an error if none was.
+ */
+SYSCALL_DEFINE5(statx_many,
+		int, dfd, struct statx_many_entry __user *, entries,
+		unsigned int, nr, unsigned int, flags, unsigned int, mask)
+{
+	struct statx_many_entry entry;
+	unsigned int i;
+	int error;
+
+	if (mask & STATX__RESERVED)
+		return -EINVAL;
+	if ((flags & AT_STATX_SYNC_TYPE) == AT_STATX_SYNC_TYPE)
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		if (fatal_signal_pending(current))
+			return i ? i : -EINTR;
+		if (copy_from_user(&entry, &entries[i], sizeof(entry)))
+			return i ? i : -EFAULT;
+
+		if (entry.__reserved)
+			error = -EINVAL;
+		else
+			error = do_statx(dfd, u64_to_user_ptr(entry.name),
+					 flags, mask,
+					 u64_to_user_ptr(entry.buf));
+
+		if (put_user(error, &entries[i].result))
+			return i ? i : -EFAULT;
+		cond_resched();
+	}
+
+	return nr;
+}
+
 #ifdef CONFIG_COMPAT
 static int cp_compat_stat(struct kstat *stat, struct compat_stat __user *ubuf)
 {
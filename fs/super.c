@@ -162,6 +162,7 @@ static void destroy_super_work(struct work_struct *work)
 
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_free_rwsem(&s->s_writers.rw_sem[i]);
+	percpu_counter_destroy(&s->s_nr_negative_dentry);
 	kfree(s);
 }
 
@@ -271,6 +272,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 		goto fail;
 	if (list_lru_init_memcg(&s->s_dentry_lru, &s->s_shrink))
 		goto fail;
+	if (percpu_counter_init(&s->s_nr_negative_dentry, 0, GFP_KERNEL))
+		goto fail;
+	INIT_WORK(&s->s_negative_dentry_work, prune_negative_dentries_work);
 	if (list_lru_init_memcg(&s->s_inode_lru, &s->s_shrink))
 		goto fail;
 	return s;
@@ -333,6 +337,7 @@ void deactivate_locked_super(struct super_block *s)
 		cleancache_invalidate_fs(s);
 		unregister_shrinker(&s->s_shrink);
 		fs->kill_sb(s);
+		cancel_work_sync(&s->s_negative_dentry_work);
 
 		/*
 		 * Since list_lru_destroy() may sleep, we cannot call it from
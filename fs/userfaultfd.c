@@ -877,11 +877,12 @@ static int userfaultfd_release(struct inode *inode, struct file *file)
 				 new_flags, vma->anon_vma,
 				 vma->vm_file, vma->vm_pgoff,
 				 vma_policy(vma),
-				 NULL_VM_UFFD_CTX);
+				 NULL_VM_UFFD_CTX, vma->vm_fault_around);
 		if (prev)
 			vma = prev;
 		else
 			prev = vma;
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx = NULL_VM_UFFD_CTX;
 	}
@@ -1254,9 +1255,12 @@ static __always_inline int validate_range(struct mm_struct *mm,
 static inline bool vma_can_userfault(struct vm_area_struct *vma,
 				     unsigned long vm_flags)
 {
-	/* FIXME: add WP support to hugetlbfs and shmem */
+	/*
+	 * FIXME: add WP support to shmem, its ptes are zapped by reclaim
+	 * and the write protection would be lost with them.
+	 */
 	if (vm_flags & VM_UFFD_WP) {
-		if (is_vm_hugetlb_page(vma) || vma_is_shmem(vma))
+		if (vma_is_shmem(vma))
 			return false;
 	}
 
@@ -1436,7 +1440,8 @@ static int userfaultfd_register(struct userfaultfd_ctx *ctx,
 		prev = vma_merge(mm, prev, start, vma_end, new_flags,
 				 vma->anon_vma, vma->vm_file, vma->vm_pgoff,
 				 vma_policy(vma),
-				 ((struct vm_userfaultfd_ctx){ ctx }));
+				 ((struct vm_userfaultfd_ctx){ ctx }),
+				 vma->vm_fault_around);
 		if (prev) {
 			vma = prev;
 			goto next;
@@ -1457,6 +1462,7 @@ static int userfaultfd_register(struct userfaultfd_ctx *ctx,
 		 * the next vma was merged into the current one and
 		 * the current one has not been updated yet.
 		 */
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx.ctx = ctx;
 
@@ -1486,7 +1492,8 @@ static int userfaultfd_register(struct userfaultfd_ctx *ctx,
 
 		/* CONTINUE ioctl is only supported for MINOR ranges. */
 		if (!(uffdio_register.mode & UFFDIO_REGISTER_MODE_MINOR))
-			ioctls_out &= ~((__u64)1 << _UFFDIO_CONTINUE);
+			ioctls_out &= ~((__u64)1 << _UFFDIO_CONTINUE |
+					(__u64)1 << _UFFDIO_CONTINUE_VEC);
 
 		/*
 		 * Now that we scanned all vmas we can already tell
@@ -1613,7 +1620,7 @@ static int userfaultfd_unregister(struct userfaultfd_ctx *ctx,
 		prev = vma_merge(mm, prev, start, vma_end, new_flags,
 				 vma->anon_vma, vma->vm_file, vma->vm_pgoff,
 				 vma_policy(vma),
-				 NULL_VM_UFFD_CTX);
+				 NULL_VM_UFFD_CTX, vma->vm_fault_around);
 		if (prev) {
 			vma = prev;
 			goto next;
@@ -1634,6 +1641,7 @@ static int userfaultfd_unregister(struct userfaultfd_ctx *ctx,
 		 * the next vma was merged into the current one and
 		 * the current one has not been updated yet.
 		 */
+		vma_start_write(vma);
 		vma->vm_flags = new_flags;
 		vma->vm_userfaultfd_ctx = NULL_VM_UFFD_CTX;
 
@@ -1907,6 +1915,98 @@ static int userfaultfd_continue(struct userfaultfd_ctx *ctx, unsigned long arg)
 	return ret;
 }
 
+/*
+ * UFFDIO_COPY_VEC and UFFDIO_CONTINUE_VEC resolve a whole batch of ranges,
+ * typically all the faults read in one go, for the cost of a single ioctl.
+ */
+static int userfaultfd_vec(struct userfaultfd_ctx *ctx, unsigned long arg,
+			   bool is_continue)
+{
+	__s64 ret, done = 0;
+	struct uffdio_vec uffdio_vec;
+	struct uffdio_vec __user *user_uffdio_vec;
+	struct uffdio_iovec __user *user_iov;
+	struct uffdio_iovec iov;
+	struct userfaultfd_wake_range range;
+	__u64 mode_mask, i;
+	bool dontwake;
+
+	user_uffdio_vec = (struct uffdio_vec __user *)arg;
+
+	ret = -EAGAIN;
+	if (atomic_read(&ctx->mmap_changing))
+		goto out;
+
+	ret = -EFAULT;
+	if (copy_from_user(&uffdio_vec, user_uffdio_vec,
+			   /* don't copy "done" last field */
+			   sizeof(uffdio_vec) - sizeof(__s64)))
+		goto out;
+
+	if (is_continue) {
+		mode_mask = UFFDIO_CONTINUE_MODE_DONTWAKE;
+		dontwake = uffdio_vec.mode & UFFDIO_CONTINUE_MODE_DONTWAKE;
+	} else {
+		mode_mask = UFFDIO_COPY_MODE_DONTWAKE | UFFDIO_COPY_MODE_WP;
+		dontwake = uffdio_vec.mode & UFFDIO_COPY_MODE_DONTWAKE;
+	}
+
+	ret = -EINVAL;
+	if (uffdio_vec.mode & ~mode_mask)
+		goto out;
+	if (!uffdio_vec.nr_iov || uffdio_vec.nr_iov > UFFDIO_VEC_MAX)
+		goto out;
+
+	if (!mmget_not_zero(ctx->mm))
+		return -ESRCH;
+
+	user_iov = u64_to_user_ptr(uffdio_vec.iov);
+	for (i = 0; i < uffdio_vec.nr_iov; i++) {
+		ret = -EFAULT;
+		if (copy_from_user(&iov, &user_iov[i], sizeof(iov)))
+			break;
+
+		ret = validate_range(ctx->mm, iov.dst, iov.len);
+		if (ret)
+			break;
+		/* same wraparound check as userfaultfd_copy() */
+		ret = -EINVAL;
+		if (!is_continue && iov.src + iov.len <= iov.src)
+			break;
+
+		if (is_continue)
+			ret = mcopy_continue(ctx->mm, iov.dst, iov.len,
+					     &ctx->mmap_changing);
+		else
+			ret = mcopy_atomic(ctx->mm, iov.dst, iov.src, iov.len,
+					   &ctx->mmap_changing,
+					   uffdio_vec.mode);
+		if (ret < 0)
+			break;
+
+		/* len == 0 would wake all */
+		BUG_ON(!ret);
+		done += ret;
+		if (!dontwake) {
+			range.start = iov.dst;
+			range.len = ret;
+			wake_userfault(ctx, &range);
+		}
+
+		if (ret != iov.len) {
+			ret = -EAGAIN;
+			break;
+		}
+		ret = 0;
+	}
+	mmput(ctx->mm);
+
+	if (unlikely(put_user(done ? done : ret, &user_uffdio_vec->done)))
+		return -EFAULT;
+out:
+	return ret;
+}
+
 static inline unsigned int uffd_ctx_features(__u64 user_features)
 {
 	/*
@@ -1947,7 +2047,11 @@ static int userfaultfd_api(struct userfaultfd_ctx *ctx,
 		~(UFFD_FEATURE_MINOR_HUGETLBFS | UFFD_FEATURE_MINOR_SHMEM);
 #endif
 #ifndef CONFIG_HAVE_ARCH_USERFAULTFD_WP
-	uffdio_api.features &= ~UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+	uffdio_api.features &=
+		~(UFFD_FEATURE_PAGEFAULT_FLAG_WP | UFFD_FEATURE_WP_HUGETLBFS);
+#endif
+#ifndef CONFIG_HUGETLB_PAGE
+	uffdio_api.features &= ~UFFD_FEATURE_WP_HUGETLBFS;
 #endif
 	uffdio_api.ioctls = UFFD_API_IOCTLS;
 	ret = -EFAULT;
@@ -2004,6 +2108,12 @@ static long userfaultfd_ioctl(struct file *file, unsigned cmd,
 	case UFFDIO_CONTINUE:
 		ret = userfaultfd_continue(ctx, arg);
 		break;
+	case UFFDIO_COPY_VEC:
+		ret = userfaultfd_vec(ctx, arg, false);
+		break;
+	case UFFDIO_CONTINUE_VEC:
+		ret = userfaultfd_vec(ctx, arg, true);
+		break;
 	}
 	return ret;
 }
@@ -9,7 +9,8 @@
  * Tunable XFS parameters.  xfs_params is required even when CONFIG_SYSCTL=n,
  * other XFS code uses these values.  Times are measured in centisecs (i.e.
  * 100ths of a second) with the exception of blockgc_timer, which is measured
- * in seconds.
+ * in seconds.  inodegc_batch and inodegc_backlog are counted in inodes per
+ * CPU, an inodegc_batch of 0 means one inode cluster's worth.
  */
 xfs_param_t xfs_params = {
 			  /*	MIN		DFLT		MAX	*/
@@ -29,6 +30,8 @@ xfs_param_t xfs_params = {
 	.inherit_nodfrg	= {	0,		1,		1	},
 	.fstrm_timer	= {	1,		30*100,		3600*100},
 	.blockgc_timer	= {	1,		300,		3600*24},
+	.inodegc_batch	= {	0,		0,		64*1024	},
+	.inodegc_backlog = {	1,		4*64,		1024*1024},
 };
 
 struct xfs_globals xfs_globals = {
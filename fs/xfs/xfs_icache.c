@@ -1855,6 +1855,8 @@ xfs_inodegc_worker(
 							work);
 	struct llist_node	*node = llist_del_all(&gc->list);
 	struct xfs_inode	*ip, *n;
+	struct xfs_mount	*mp;
+	unsigned int		inactivated = 0;
 
 	WRITE_ONCE(gc->items, 0);
 
@@ -1862,13 +1864,16 @@ xfs_inodegc_worker(
 		return;
 
 	ip = llist_entry(node, struct xfs_inode, i_gclist);
-	trace_xfs_inodegc_worker(ip->i_mount, READ_ONCE(gc->shrinker_hits));
+	mp = ip->i_mount;
+	trace_xfs_inodegc_worker(mp, READ_ONCE(gc->shrinker_hits));
 
 	WRITE_ONCE(gc->shrinker_hits, 0);
 	llist_for_each_entry_safe(ip, n, node, i_gclist) {
 		xfs_iflags_set(ip, XFS_INACTIVATING);
 		xfs_inodegc_inactivate(ip);
+		inactivated++;
 	}
+	XFS_STATS_ADD(mp, xs_inodegc_inactivated, inactivated);
 }
 
 /*
@@ -1941,7 +1946,8 @@ xfs_inodegc_want_queue_rt_file(
 /*
  * Schedule the inactivation worker when:
  *
- *  - We've accumulated more than one inode cluster buffer's worth of inodes.
+ *  - We've accumulated more than one inode cluster buffer's worth of inodes,
+ *    or more than fs.xfs.inodegc_batch if that is set.
  *  - There is less than 5% free space left.
  *  - Any of the quotas for this inode are near an enforcement limit.
  */
@@ -1951,8 +1957,9 @@ xfs_inodegc_want_queue_work(
 	unsigned int		items)
 {
 	struct xfs_mount	*mp = ip->i_mount;
+	unsigned int		batch = READ_ONCE(xfs_inodegc_batch);
 
-	if (items > mp->m_ino_geo.inodes_per_cluster)
+	if (items > (batch ? batch : mp->m_ino_geo.inodes_per_cluster))
 		return true;
 
 	if (__percpu_counter_compare(&mp->m_fdblocks,
@@ -1975,17 +1982,14 @@ xfs_inodegc_want_queue_work(
 	return false;
 }
 
-/*
- * Upper bound on the number of inodes in each AG that can be queued for
- * inactivation at any given time, to avoid monopolizing the workqueue.
- */
-#define XFS_INODEGC_MAX_BACKLOG		(4 * XFS_INODES_PER_CHUNK)
-
 /*
  * Make the frontend wait for inactivations when:
  *
  *  - Memory shrinkers queued the inactivation worker and it hasn't finished.
- *  - The queue depth exceeds the maximum allowable percpu backlog.
+ *  - The queue depth exceeds the maximum allowable percpu backlog, which is
+ *    fs.xfs.inodegc_max_backlog inodes.  This bounds how many inodes can be
+ *    queued for inactivation at any given time, to avoid monopolizing the
+ *    workqueue.
  *
  * Note: If the current thread is running a transaction, we don't ever want to
  * wait for other transactions because that could introduce a deadlock.
@@ -2002,7 +2006,7 @@ xfs_inodegc_want_flush_work(
 	if (shrinker_hits > 0)
 		return true;
 
-	if (items > XFS_INODEGC_MAX_BACKLOG)
+	if (items > READ_ONCE(xfs_inodegc_backlog))
 		return true;
 
 	return false;
@@ -2033,6 +2037,7 @@ xfs_inodegc_queue(
 	WRITE_ONCE(gc->items, items + 1);
 	shrinker_hits = READ_ONCE(gc->shrinker_hits);
 	put_cpu_ptr(gc);
+	XFS_STATS_INC(mp, xs_inodegc_queued);
 
 	if (!xfs_is_inodegc_enabled(mp))
 		return;
@@ -2043,8 +2048,13 @@ xfs_inodegc_queue(
 	}
 
 	if (xfs_inodegc_want_flush_work(ip, items, shrinker_hits)) {
+		u64	start = ktime_get_ns();
+
 		trace_xfs_inodegc_throttle(mp, __return_address);
 		flush_work(&gc->work);
+		XFS_STATS_INC(mp, xs_inodegc_throttled);
+		XFS_STATS_ADD(mp, inodegc_throttle_us,
+			      div_u64(ktime_get_ns() - start, NSEC_PER_USEC));
 	}
 }
 
@@ -2181,6 +2191,7 @@ xfs_inodegc_shrinker_scan(
 
 			WRITE_ONCE(gc->shrinker_hits, h + 1);
 			queue_work_on(cpu, mp->m_inodegc_wq, &gc->work);
+			XFS_STATS_INC(mp, xs_inodegc_shrinker_kicks);
 			no_items = false;
 		}
 	}
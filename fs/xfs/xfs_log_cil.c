@@ -61,6 +61,7 @@ xlog_cil_ctx_alloc(void)
 	ctx = kmem_zalloc(sizeof(*ctx), KM_NOFS);
 	INIT_LIST_HEAD(&ctx->committing);
 	INIT_LIST_HEAD(&ctx->busy_extents);
+	INIT_LIST_HEAD(&ctx->log_items);
 	INIT_WORK(&ctx->push_work, xlog_cil_push_work);
 	return ctx;
 }
@@ -73,6 +74,7 @@ xlog_cil_ctx_switch(
 	ctx->sequence = ++cil->xc_current_sequence;
 	ctx->cil = cil;
 	cil->xc_ctx = ctx;
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 }
 
 /*
@@ -425,10 +427,12 @@ xlog_cil_insert_items(
 {
 	struct xfs_cil		*cil = log->l_cilp;
 	struct xfs_cil_ctx	*ctx = cil->xc_ctx;
+	struct xlog_cil_pcp	*cilpcp;
 	struct xfs_log_item	*lip;
 	int			len = 0;
 	int			diff_iovecs = 0;
 	int			iclog_space;
+	uint32_t		order;
 	int			iovhdr_res = 0, split_res = 0, ctx_res = 0;
 
 	ASSERT(tp);
@@ -446,10 +450,6 @@ xlog_cil_insert_items(
 	len += iovhdr_res;
 	ctx->nvecs += diff_iovecs;
 
-	/* attach the transaction to the CIL if it has any busy extents */
-	if (!list_empty(&tp->t_busy))
-		list_splice_init(&tp->t_busy, &ctx->busy_extents);
-
 	/*
 	 * Now transfer enough transaction reservation to the context ticket
 	 * for the checkpoint. The context ticket is special - the unit
@@ -493,27 +493,42 @@ xlog_cil_insert_items(
 		xlog_print_trans(tp);
 	}
 
+	spin_unlock(&cil->xc_cil_lock);
+
 	/*
-	 * Now (re-)position everything modified at the tail of the CIL.
-	 * We do this here so we only need to take the CIL lock once during
-	 * the transaction commit.
+	 * Now update the order of everything modified in the transaction and
+	 * insert the items that aren't in the CIL yet into the list of this
+	 * CPU. The items are locked by the transaction, so the order ID taken
+	 * here orders this commit against any other commit of the same items.
+	 * The push sorts the items back into commit order, so items already in
+	 * the CIL can stay on whatever per-cpu list they were first added to.
+	 *
+	 * Running with preemption disabled is enough to serialise against
+	 * other commits, the push is locked out by the xc_ctx_lock.
 	 */
+	order = atomic_inc_return(&ctx->order_id);
+	cilpcp = get_cpu_ptr(cil->xc_pcp);
+	if (!cpumask_test_cpu(smp_processor_id(), &ctx->cil_pcpmask))
+		cpumask_set_cpu(smp_processor_id(), &ctx->cil_pcpmask);
+
+	/* attach the transaction to the CIL if it has any busy extents */
+	if (!list_empty(&tp->t_busy))
+		list_splice_init(&tp->t_busy, &cilpcp->busy_extents);
+
 	list_for_each_entry(lip, &tp->t_items, li_trans) {
 
 		/* Skip items which aren't dirty in this transaction. */
 		if (!test_bit(XFS_LI_DIRTY, &lip->li_flags))
 			continue;
 
-		/*
-		 * Only move the item if it isn't already at the tail. This is
-		 * to prevent a transient list_empty() state when reinserting
-		 * an item that is already the only item in the CIL.
-		 */
-		if (!list_is_last(&lip->li_cil, &cil->xc_cil))
-			list_move_tail(&lip->li_cil, &cil->xc_cil);
+		lip->li_order_id = order;
+		if (!list_empty(&lip->li_cil))
+			continue;
+		list_add_tail(&lip->li_cil, &cilpcp->log_items);
+		if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
+			clear_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
 	}
-
-	spin_unlock(&cil->xc_cil_lock);
+	put_cpu_ptr(cilpcp);
 
 	if (tp->t_ticket->t_curr_res < 0)
 		xfs_force_shutdown(log->l_mp, SHUTDOWN_LOG_IO_ERROR);
@@ -844,6 +859,42 @@ xlog_cil_write_commit_record(
 	return error;
 }
 
+static int
+xlog_cil_order_cmp(
+	void			*priv,
+	const struct list_head	*a,
+	const struct list_head	*b)
+{
+	struct xfs_log_item	*l1 = container_of(a, struct xfs_log_item,
+						   li_cil);
+	struct xfs_log_item	*l2 = container_of(b, struct xfs_log_item,
+						   li_cil);
+
+	return l1->li_order_id > l2->li_order_id;
+}
+
+/*
+ * Pull the per-cpu item lists and busy extents of all the CPUs that committed
+ * into this context onto the context itself, and put the items back into the
+ * order they were committed in. The caller must hold the xc_ctx_lock
+ * exclusively so that no commit can be adding items at the same time.
+ */
+static void
+xlog_cil_pcp_aggregate(
+	struct xfs_cil		*cil,
+	struct xfs_cil_ctx	*ctx)
+{
+	struct xlog_cil_pcp	*cilpcp;
+	int			cpu;
+
+	for_each_cpu(cpu, &ctx->cil_pcpmask) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+		list_splice_init(&cilpcp->busy_extents, &ctx->busy_extents);
+		list_splice_init(&cilpcp->log_items, &ctx->log_items);
+	}
+	list_sort(NULL, &ctx->log_items, xlog_cil_order_cmp);
+}
+
 /*
  * Push the Committed Item List to the log.
  *
@@ -904,7 +955,7 @@ xlog_cil_push_work(
 	 * move on to a new sequence number and so we have to be able to push
 	 * this sequence again later.
 	 */
-	if (list_empty(&cil->xc_cil)) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		cil->xc_push_seq = 0;
 		spin_unlock(&cil->xc_push_lock);
 		goto out_skip;
@@ -950,12 +1001,13 @@ xlog_cil_push_work(
 	 * needed on the transaction commit side which is currently locked out
 	 * by the flush lock.
 	 */
+	xlog_cil_pcp_aggregate(cil, ctx);
 	lv = NULL;
 	num_iovecs = 0;
-	while (!list_empty(&cil->xc_cil)) {
+	while (!list_empty(&ctx->log_items)) {
 		struct xfs_log_item	*item;
 
-		item = list_first_entry(&cil->xc_cil,
+		item = list_first_entry(&ctx->log_items,
 					struct xfs_log_item, li_cil);
 		list_del_init(&item->li_cil);
 		if (!ctx->lv_chain)
@@ -1121,7 +1173,7 @@ xlog_cil_push_background(
 	 * The cil won't be empty because we are called while holding the
 	 * context lock so whatever we added to the CIL will still be there
 	 */
-	ASSERT(!list_empty(&cil->xc_cil));
+	ASSERT(!test_bit(XLOG_CIL_EMPTY, &cil->xc_flags));
 
 	/*
 	 * Don't do a background push if we haven't used up all the
@@ -1208,7 +1260,8 @@ xlog_cil_push_now(
 	 * there's no work we need to do.
 	 */
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil) || push_seq <= cil->xc_push_seq) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) ||
+	    push_seq <= cil->xc_push_seq) {
 		spin_unlock(&cil->xc_push_lock);
 		return;
 	}
@@ -1227,7 +1280,7 @@ xlog_cil_empty(
 	bool		empty = false;
 
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil))
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
 		empty = true;
 	spin_unlock(&cil->xc_push_lock);
 	return empty;
@@ -1395,7 +1448,7 @@ xlog_cil_force_seq(
 	 * we would have found the context on the committing list.
 	 */
 	if (sequence == cil->xc_current_sequence &&
-	    !list_empty(&cil->xc_cil)) {
+	    !test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		spin_unlock(&cil->xc_push_lock);
 		goto restart;
 	}
@@ -1450,10 +1503,23 @@ xlog_cil_init(
 {
 	struct xfs_cil	*cil;
 	struct xfs_cil_ctx *ctx;
+	struct xlog_cil_pcp *cilpcp;
+	int		cpu;
 
 	cil = kmem_zalloc(sizeof(*cil), KM_MAYFAIL);
 	if (!cil)
 		return -ENOMEM;
+
+	cil->xc_pcp = alloc_percpu(struct xlog_cil_pcp);
+	if (!cil->xc_pcp)
+		goto out_destroy_cil;
+
+	for_each_possible_cpu(cpu) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+		INIT_LIST_HEAD(&cilpcp->busy_extents);
+		INIT_LIST_HEAD(&cilpcp->log_items);
+	}
+
 	/*
 	 * Limit the CIL pipeline depth to 4 concurrent works to bound the
 	 * concurrency the log spinlocks will be exposed to.
@@ -1462,9 +1528,8 @@ xlog_cil_init(
 			XFS_WQFLAGS(WQ_FREEZABLE | WQ_MEM_RECLAIM | WQ_UNBOUND),
 			4, log->l_mp->m_super->s_id);
 	if (!cil->xc_push_wq)
-		goto out_destroy_cil;
+		goto out_free_pcp;
 
-	INIT_LIST_HEAD(&cil->xc_cil);
 	INIT_LIST_HEAD(&cil->xc_committing);
 	spin_lock_init(&cil->xc_cil_lock);
 	spin_lock_init(&cil->xc_push_lock);
@@ -1480,6 +1545,8 @@ xlog_cil_init(
 
 	return 0;
 
+out_free_pcp:
+	free_percpu(cil->xc_pcp);
 out_destroy_cil:
 	kmem_free(cil);
 	return -ENOMEM;
@@ -1495,8 +1562,9 @@ xlog_cil_destroy(
 		kmem_free(log->l_cilp->xc_ctx);
 	}
 
-	ASSERT(list_empty(&log->l_cilp->xc_cil));
+	ASSERT(test_bit(XLOG_CIL_EMPTY, &log->l_cilp->xc_flags));
 	destroy_workqueue(log->l_cilp->xc_push_wq);
+	free_percpu(log->l_cilp->xc_pcp);
 	kmem_free(log->l_cilp);
 }
 
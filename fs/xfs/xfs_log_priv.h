@@ -245,11 +245,26 @@ struct xfs_cil_ctx {
 	int			nvecs;		/* number of regions */
 	int			space_used;	/* aggregate size of regions */
 	struct list_head	busy_extents;	/* busy extents in chkpt */
+	struct list_head	log_items;	/* items being pushed */
 	struct xfs_log_vec	*lv_chain;	/* logvecs being pushed */
 	struct list_head	iclog_entry;
 	struct list_head	committing;	/* ctx committing list */
 	struct work_struct	discard_endio_work;
 	struct work_struct	push_work;
+	atomic_t		order_id;	/* item commit order */
+	cpumask_t		cil_pcpmask;	/* CPUs with items to push */
+};
+
+/*
+ * Per-cpu CIL tracking items. Transaction commits add log items and busy
+ * extents to the list of the CPU they run on, so the fast path doesn't bounce
+ * a shared list head between CPUs. The push aggregates the lists of all the
+ * CPUs in the context's cil_pcpmask and restores the commit order of the items
+ * from li_order_id.
+ */
+struct xlog_cil_pcp {
+	struct list_head	busy_extents;
+	struct list_head	log_items;
 };
 
 /*
@@ -270,7 +285,8 @@ struct xfs_cil_ctx {
  */
 struct xfs_cil {
 	struct xlog		*xc_log;
-	struct list_head	xc_cil;
+	unsigned long		xc_flags;
+	struct xlog_cil_pcp __percpu *xc_pcp;
 	spinlock_t		xc_cil_lock;
 	struct workqueue_struct	*xc_push_wq;
 
@@ -287,6 +303,9 @@ struct xfs_cil {
 	wait_queue_head_t	xc_push_wait;	/* background push throttle */
 } ____cacheline_aligned_in_smp;
 
+/* xc_flags bit values */
+#define	XLOG_CIL_EMPTY		1
+
 /*
  * The amount of log space we allow the CIL to aggregate is difficult to size.
  * Whatever we choose, we have to make sure we can get a reservation for the
@@ -133,11 +133,16 @@ struct __xfsstats {
 	uint32_t		xs_qm_dqwants;
 	uint32_t		xs_qm_dquot;
 	uint32_t		xs_qm_dquot_unused;
+	uint32_t		xs_inodegc_queued;
+	uint32_t		xs_inodegc_inactivated;
+	uint32_t		xs_inodegc_throttled;
+	uint32_t		xs_inodegc_shrinker_kicks;
 /* Extra precision counters */
 	uint64_t		xs_xstrat_bytes;
 	uint64_t		xs_write_bytes;
 	uint64_t		xs_read_bytes;
 	uint64_t		defer_relog;
+	uint64_t		inodegc_throttle_us;
 };
 
 #define	xfsstats_offset(f)	(offsetof(struct __xfsstats, f)/sizeof(uint32_t))
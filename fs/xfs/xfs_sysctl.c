@@ -194,6 +194,24 @@ static struct ctl_table xfs_table[] = {
 		.extra1		= &xfs_params.blockgc_timer.min,
 		.extra2		= &xfs_params.blockgc_timer.max,
 	},
+	{
+		.procname	= "inodegc_batch",
+		.data		= &xfs_params.inodegc_batch.val,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &xfs_params.inodegc_batch.min,
+		.extra2		= &xfs_params.inodegc_batch.max,
+	},
+	{
+		.procname	= "inodegc_max_backlog",
+		.data		= &xfs_params.inodegc_backlog.val,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &xfs_params.inodegc_backlog.min,
+		.extra2		= &xfs_params.inodegc_backlog.max,
+	},
 	/* please keep this the last entry */
 #ifdef CONFIG_PROC_FS
 	{
@@ -36,6 +36,8 @@ typedef struct xfs_param {
 	xfs_sysctl_val_t inherit_nodfrg;/* Inherit the "nodefrag" inode flag. */
 	xfs_sysctl_val_t fstrm_timer;	/* Filestream dir-AG assoc'n timeout. */
 	xfs_sysctl_val_t blockgc_timer;	/* Interval between blockgc scans */
+	xfs_sysctl_val_t inodegc_batch;	/* Inodes queued before inodegc runs */
+	xfs_sysctl_val_t inodegc_backlog;/* Inodes queued before throttling */
 } xfs_param_t;
 
 /*
@@ -147,6 +147,10 @@ struct bdi_writeback {
 
 	unsigned long dirty_sleep;	/* last wait */
 
+	unsigned long work_latency_avg;	/* smoothed queue to completion time
+					   of writeback works, in usecs */
+	unsigned long work_latency_max;	/* worst one seen, in usecs */
+
 	struct list_head bdi_node;	/* anchored at bdi->wb_list */
 
 #ifdef CONFIG_CGROUP_WRITEBACK
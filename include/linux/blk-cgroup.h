@@ -45,6 +45,7 @@ enum blkg_iostat_type {
 };
 
 struct blkcg_gq;
+struct blk_lat_hist;
 
 struct blkcg {
 	struct cgroup_subsys_state	css;
@@ -127,6 +128,9 @@ struct blkcg_gq {
 	struct blkg_iostat_set __percpu	*iostat_cpu;
 	struct blkg_iostat_set		iostat;
 
+	/* per-op latency histograms while the queue has them enabled */
+	struct blk_lat_hist __percpu	*lat_hist;
+
 	struct blkg_policy_data		*pd[BLKCG_MAX_POLS];
 
 	spinlock_t			async_bio_lock;
@@ -621,6 +625,15 @@ static inline bool blk_cgroup_mergeable(struct request *rq, struct bio *bio)
 }
 
 void blk_cgroup_bio_start(struct bio *bio);
+void blkcg_enable_lat_hist(struct request_queue *q);
+void __blkcg_lat_hist_add(struct bio *bio);
+
+static inline void blkcg_lat_hist_add(struct bio *bio)
+{
+	if (bio->bi_blkg && bio->bi_blkg->lat_hist)
+		__blkcg_lat_hist_add(bio);
+}
+
 void blkcg_add_delay(struct blkcg_gq *blkg, u64 now, u64 delta);
 void blkcg_schedule_throttle(struct request_queue *q, bool use_memdelay);
 void blkcg_maybe_throttle_current(void);
@@ -675,6 +688,8 @@ static inline void blkg_put(struct blkcg_gq *blkg) { }
 static inline bool blkcg_punt_bio_submit(struct bio *bio) { return false; }
 static inline void blkcg_bio_issue_init(struct bio *bio) { }
 static inline void blk_cgroup_bio_start(struct bio *bio) { }
+static inline void blkcg_enable_lat_hist(struct request_queue *q) { }
+static inline void blkcg_lat_hist_add(struct bio *bio) { }
 static inline bool blk_cgroup_mergeable(struct request *rq, struct bio *bio) { return true; }
 
 #define blk_queue_for_each_rl(rl, q)	\
@@ -154,6 +154,19 @@ struct blk_mq_hw_ctx {
 	unsigned long		poll_invoked;
 	/** @poll_success: Count how many polled requests were completed. */
 	unsigned long		poll_success;
+	/** @poll_time_ns: CPU time spent polling, hybrid sleeps excluded. */
+	u64			poll_time_ns;
+	/**
+	 * @poll_mode: How to wait for completions with adaptive polling, one
+	 * of BLK_MQ_POLL_MODE_*. See blk_mq_poll_adapt().
+	 */
+	unsigned int		poll_mode;
+	/** @poll_next_adapt: When to reconsider @poll_mode, in jiffies. */
+	unsigned long		poll_next_adapt;
+	/** @poll_last_time_ns: @poll_time_ns when @poll_mode was chosen. */
+	u64			poll_last_time_ns;
+	/** @poll_last_success: @poll_success when @poll_mode was chosen. */
+	unsigned long		poll_last_success;
 
 #ifdef CONFIG_BLK_DEBUG_FS
 	/**
@@ -452,6 +465,7 @@ int blk_mq_alloc_sq_tag_set(struct blk_mq_tag_set *set,
 void blk_mq_free_tag_set(struct blk_mq_tag_set *set);
 
 void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule);
+void blk_mq_free_plug_rqs(struct blk_plug *plug);
 
 void blk_mq_free_request(struct request *rq);
 
@@ -525,6 +539,43 @@ void blk_mq_start_request(struct request *rq);
 void blk_mq_end_request(struct request *rq, blk_status_t error);
 void __blk_mq_end_request(struct request *rq, blk_status_t error);
 
+/*
+ * Requests completed together by a driver, chained through ->queuelist and
+ * ended by ->complete once the driver has dropped its locks.
+ */
+struct io_comp_batch {
+	struct list_head req_list;
+	bool need_ts;
+	void (*complete)(struct io_comp_batch *);
+};
+
+#define DEFINE_IO_COMP_BATCH(name)					\
+	struct io_comp_batch name = {					\
+		.req_list = LIST_HEAD_INIT(name.req_list),		\
+	}
+
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
+
+/*
+ * Add @req to @iob if it can go through blk_mq_end_request_batch(): no error,
+ * no ->end_io and no I/O scheduler to tell. Returns false if the driver has
+ * to complete it on its own.
+ */
+static inline bool blk_mq_add_to_batch(struct request *req,
+				       struct io_comp_batch *iob, int ioerror,
+				       void (*complete)(struct io_comp_batch *))
+{
+	if (!iob || req->q->elevator || req->end_io || ioerror)
+		return false;
+	if (!iob->complete)
+		iob->complete = complete;
+	else if (iob->complete != complete)
+		return false;
+	iob->need_ts |= !!(req->rq_flags & (RQF_IO_STAT | RQF_STATS));
+	list_add_tail(&req->queuelist, &iob->req_list);
+	return true;
+}
+
 void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list);
 void blk_mq_kick_requeue_list(struct request_queue *q);
 void blk_mq_delay_kick_requeue_list(struct request_queue *q, unsigned long msecs);
@@ -299,6 +299,7 @@ enum {
 	BIO_REMAPPED,
 	BIO_ZONE_WRITE_LOCKED,	/* Owns a zoned device zone write lock */
 	BIO_PERCPU_CACHE,	/* can participate in per-cpu alloc cache */
+	BIO_WBT_CGROUP,		/* holds a per-cgroup writeback throttling slot */
 	BIO_FLAG_LAST
 };
 
@@ -528,6 +529,7 @@ struct blk_rq_stat {
 	u64 max;
 	u32 nr_samples;
 	u64 batch;
+	u64 batch_sq;		/* sum of squares, in units of 1024ns */
 };
 
 #endif /* __LINUX_BLK_TYPES_H */
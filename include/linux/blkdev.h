@@ -47,6 +47,8 @@ struct blk_keyslot_manager;
 
 /* Doing classic polling */
 #define BLK_MQ_POLL_CLASSIC -1
+/* Let every poll hctx pick between spinning, hybrid sleep and interrupts */
+#define BLK_MQ_POLL_ADAPTIVE -2
 
 /*
  * Maximum number of blkcg policies allowed to be registered concurrently.
@@ -1201,7 +1203,9 @@ void blk_mark_disk_dead(struct gendisk *disk);
 struct blk_plug {
 	struct list_head mq_list; /* blk-mq requests */
 	struct list_head cb_list; /* md requires an unplug callback */
+	struct list_head cached_rqs; /* allocated ahead, see blk_mq_submit_bio() */
 	unsigned short rq_count;
+	unsigned short nr_ios; /* requests to allocate at once */
 	bool multiple_queues;
 	bool nowait;
 };
@@ -1216,6 +1220,7 @@ struct blk_plug_cb {
 extern struct blk_plug_cb *blk_check_plugged(blk_plug_cb_fn unplug,
 					     void *data, int size);
 extern void blk_start_plug(struct blk_plug *);
+extern void blk_start_plug_nr_ios(struct blk_plug *, unsigned int);
 extern void blk_finish_plug(struct blk_plug *);
 extern void blk_flush_plug_list(struct blk_plug *, bool);
 
@@ -1241,7 +1246,8 @@ static inline bool blk_needs_flush_plug(struct task_struct *tsk)
 
 	return plug &&
 		 (!list_empty(&plug->mq_list) ||
-		 !list_empty(&plug->cb_list));
+		 !list_empty(&plug->cb_list) ||
+		 !list_empty(&plug->cached_rqs));
 }
 
 int blkdev_issue_flush(struct block_device *bdev);
@@ -1254,6 +1260,11 @@ static inline void blk_start_plug(struct blk_plug *plug)
 {
 }
 
+static inline void blk_start_plug_nr_ios(struct blk_plug *plug,
+					 unsigned int nr_ios)
+{
+}
+
 static inline void blk_finish_plug(struct blk_plug *plug)
 {
 }
@@ -96,6 +96,10 @@ struct bpf_map_ops {
 	u32 (*map_fd_sys_lookup_elem)(void *ptr);
 	void (*map_seq_show_elem)(struct bpf_map *map, void *key,
 				  struct seq_file *m);
+	/* Bytes currently allocated for the map, reported in fdinfo */
+	u64 (*map_mem_usage)(const struct bpf_map *map);
+	/* Map type specific fdinfo lines */
+	void (*map_show_fdinfo)(const struct bpf_map *map, struct seq_file *m);
 	int (*map_check_btf)(const struct bpf_map *map,
 			     const struct btf *btf,
 			     const struct btf_type *key_type,
@@ -1452,6 +1456,8 @@ struct bpf_prog *bpf_prog_get_curr_or_next(u32 *id);
 void *bpf_map_kmalloc_node(const struct bpf_map *map, size_t size, gfp_t flags,
 			   int node);
 void *bpf_map_kzalloc(const struct bpf_map *map, size_t size, gfp_t flags);
+void *bpf_map_kvcalloc(const struct bpf_map *map, size_t n, size_t size,
+		       gfp_t flags);
 void __percpu *bpf_map_alloc_percpu(const struct bpf_map *map, size_t size,
 				    size_t align, gfp_t flags);
 #else
@@ -1468,6 +1474,12 @@ bpf_map_kzalloc(const struct bpf_map *map, size_t size, gfp_t flags)
 	return kzalloc(size, flags);
 }
 
+static inline void *
+bpf_map_kvcalloc(const struct bpf_map *map, size_t n, size_t size, gfp_t flags)
+{
+	return kvcalloc(n, size, flags);
+}
+
 static inline void __percpu *
 bpf_map_alloc_percpu(const struct bpf_map *map, size_t size, size_t align,
 		     gfp_t flags)
@@ -1527,6 +1539,14 @@ int bpf_obj_get_user(const char __user *pathname, int flags);
 
 struct bpf_iter_aux_info {
 	struct bpf_map *map;
+	struct {
+		u32 tid_start;
+		u32 tid_end;
+		struct cgroup *cgrp;
+		u32 flags;
+		/* jiffies when the last complete walk started, 0 if none */
+		unsigned long last_walk;
+	} task;
 };
 
 typedef int (*bpf_iter_attach_target_t)(struct bpf_prog *prog,
@@ -1543,6 +1563,7 @@ typedef const struct bpf_func_proto *
 
 enum bpf_iter_feature {
 	BPF_ITER_RESCHED	= BIT(0),
+	BPF_ITER_SLEEPABLE	= BIT(1),
 };
 
 #define BPF_ITER_CTX_ARG_MAX 2
@@ -364,6 +364,9 @@ struct bpf_insn_aux_data {
 	/* below fields are initialized once */
 	unsigned int orig_idx; /* original instruction index */
 	bool prune_point;
+	/* states added and pruning hits at this prune point, saturating */
+	u16 prune_adds;
+	u16 prune_hits;
 };
 
 #define MAX_USED_MAPS 64 /* max number of maps accessed by one eBPF program */
@@ -416,6 +419,9 @@ struct bpf_subprog_info {
 	bool tail_call_reachable;
 	bool has_ld_abs;
 	bool is_async_cb;
+	/* insns processed and time spent when verified via do_check_common() */
+	u32 insn_processed;
+	u64 verification_time;
 };
 
 /* single container for all structs
@@ -473,6 +479,8 @@ struct bpf_verifier_env {
 	 * memory consumption during verification
 	 */
 	u32 peak_states;
+	/* states_equal() hits and misses, states dropped as not useful */
+	u32 prune_hits, prune_misses, states_evicted;
 	/* longest register parentage chain walked for liveness marking */
 	u32 longest_mark_read_walk;
 	bpfptr_t fd_array;
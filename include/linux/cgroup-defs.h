@@ -10,6 +10,7 @@
 
 #include <linux/limits.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/idr.h>
 #include <linux/wait.h>
 #include <linux/mutex.h>
@@ -178,8 +179,8 @@ struct cgroup_subsys_state {
 	 */
 	atomic_t online_cnt;
 
-	/* percpu_ref killing and RCU release */
-	struct work_struct destroy_work;
+	/* percpu_ref killing and release are batched, then RCU free */
+	struct llist_node destroy_llnode;
 	struct rcu_work destroy_rwork;
 
 	/*
@@ -288,6 +289,10 @@ struct css_set {
 
 struct cgroup_base_stat {
 	struct task_cputime cputime;
+
+#ifdef CONFIG_SCHED_CORE
+	u64 forceidle_sum;
+#endif
 };
 
 /*
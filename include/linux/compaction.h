@@ -82,6 +82,8 @@ static inline unsigned long compact_gap(unsigned int order)
 
 #ifdef CONFIG_COMPACTION
 extern unsigned int sysctl_compaction_proactiveness;
+extern unsigned int sysctl_compaction_goal_budget_ms;
+extern unsigned int sysctl_compaction_goal_migrate_limit;
 extern int sysctl_compaction_handler(struct ctl_table *table, int write,
 			void *buffer, size_t *length, loff_t *ppos);
 extern int compaction_proactiveness_sysctl_handler(struct ctl_table *table,
@@ -180,6 +182,7 @@ bool compaction_zonelist_suitable(struct alloc_context *ac, int order,
 extern int kcompactd_run(int nid);
 extern void kcompactd_stop(int nid);
 extern void wakeup_kcompactd(pg_data_t *pgdat, int order, int highest_zoneidx);
+extern void compaction_alloc_failed(struct zone *zone, int order);
 
 #else
 static inline void reset_isolation_suitable(pg_data_t *pgdat)
@@ -225,6 +228,10 @@ static inline void wakeup_kcompactd(pg_data_t *pgdat,
 {
 }
 
+static inline void compaction_alloc_failed(struct zone *zone, int order)
+{
+}
+
 #endif /* CONFIG_COMPACTION */
 
 struct node;
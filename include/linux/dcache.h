@@ -67,9 +67,10 @@ struct dentry_stat_t {
 	long age_limit;		/* age in seconds */
 	long want_pages;	/* pages requested by system */
 	long nr_negative;	/* # of unused negative dentries */
-	long dummy;		/* Reserved for future use */
+	long nr_negative_hits;	/* # of lookups that found a negative dentry */
 };
 extern struct dentry_stat_t dentry_stat;
+extern unsigned long sysctl_negative_dentry_limit;
 
 /*
  * Try to keep struct dentry aligned on 64 byte cachelines (this will
@@ -444,6 +444,8 @@ struct dma_buf {
 	struct dma_buf_sysfs_entry {
 		struct kobject kobj;
 		struct dma_buf *dmabuf;
+		atomic64_t cpu_access_waits;
+		atomic64_t cpu_access_wait_ns;
 	} *sysfs_entry;
 #endif
 };
@@ -31,6 +31,7 @@
 #include <linux/uidgid.h>
 #include <linux/lockdep.h>
 #include <linux/percpu-rwsem.h>
+#include <linux/percpu_counter.h>
 #include <linux/workqueue.h>
 #include <linux/delayed_call.h>
 #include <linux/uuid.h>
@@ -943,6 +944,7 @@ struct fown_struct {
  * @async_size: Start next readahead when this many pages are left.
  * @ra_pages: Maximum size of a readahead request.
  * @mmap_miss: How many mmap accesses missed in the page cache.
+ * @adapt_pages: Window limit learned from readahead feedback, 0 if none.
  * @prev_pos: The last byte in the most recent read request.
  */
 struct file_ra_state {
@@ -951,6 +953,7 @@ struct file_ra_state {
 	unsigned int async_size;
 	unsigned int ra_pages;
 	unsigned int mmap_miss;
+	unsigned int adapt_pages;
 	loff_t prev_pos;
 };
 
@@ -1587,6 +1590,10 @@ struct super_block {
 	struct rcu_head		rcu;
 	struct work_struct	destroy_work;
 
+	/* Unused negative dentries, trimmed past negative-dentry-limit */
+	struct percpu_counter	s_nr_negative_dentry;
+	struct work_struct	s_negative_dentry_work;
+
 	struct mutex		s_sync_lock;	/* sync serialisation lock */
 
 	/*
@@ -530,11 +530,20 @@ static inline int arch_make_page_accessible(struct page *page)
 struct page *__alloc_pages(gfp_t gfp, unsigned int order, int preferred_nid,
 		nodemask_t *nodemask);
 
-unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
-				nodemask_t *nodemask, int nr_pages,
-				struct list_head *page_list,
+unsigned long __alloc_pages_bulk_order(gfp_t gfp, unsigned int order,
+				int preferred_nid, nodemask_t *nodemask,
+				int nr_pages, struct list_head *page_list,
 				struct page **page_array);
 
+static inline unsigned long
+__alloc_pages_bulk(gfp_t gfp, int preferred_nid, nodemask_t *nodemask,
+		   int nr_pages, struct list_head *page_list,
+		   struct page **page_array)
+{
+	return __alloc_pages_bulk_order(gfp, 0, preferred_nid, nodemask,
+					nr_pages, page_list, page_array);
+}
+
 /* Bulk allocate order-0 pages */
 static inline unsigned long
 alloc_pages_bulk_list(gfp_t gfp, unsigned long nr_pages, struct list_head *list)
@@ -557,6 +566,18 @@ alloc_pages_bulk_array_node(gfp_t gfp, int nid, unsigned long nr_pages, struct p
 	return __alloc_pages_bulk(gfp, nid, NULL, nr_pages, NULL, page_array);
 }
 
+/* Bulk allocate pages of @order, each one a separate (compound) allocation */
+static inline unsigned long
+alloc_pages_bulk_array_order_node(gfp_t gfp, int nid, unsigned int order,
+				  unsigned long nr_pages, struct page **page_array)
+{
+	if (nid == NUMA_NO_NODE)
+		nid = numa_mem_id();
+
+	return __alloc_pages_bulk_order(gfp, order, nid, NULL, nr_pages, NULL,
+					page_array);
+}
+
 /*
  * Allocate pages, preferring the node given as nid. The node must be valid and
  * online. For more general interface, see alloc_pages_node().
@@ -25,7 +25,8 @@ struct iova {
 struct iova_magazine;
 struct iova_cpu_rcache;
 
-#define IOVA_RANGE_CACHE_MAX_SIZE 6	/* log of max cached IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_MAX_SIZE 9	/* log of max cacheable IOVA range size (in pages) */
+#define IOVA_RANGE_CACHE_DEFAULT 6	/* log of max cached IOVA range size by default */
 #define MAX_GLOBAL_MAGS 32	/* magazines per bin */
 
 struct iova_rcache {
@@ -149,6 +150,7 @@ void queue_iova(struct iova_domain *iovad,
 		unsigned long data);
 unsigned long alloc_iova_fast(struct iova_domain *iovad, unsigned long size,
 			      unsigned long limit_pfn, bool flush_rcache);
+unsigned long iova_rcache_range(void);
 struct iova *reserve_iova(struct iova_domain *iovad, unsigned long pfn_lo,
 	unsigned long pfn_hi);
 void init_iova_domain(struct iova_domain *iovad, unsigned long granule,
@@ -203,6 +205,11 @@ static inline unsigned long alloc_iova_fast(struct iova_domain *iovad,
 	return 0;
 }
 
+static inline unsigned long iova_rcache_range(void)
+{
+	return 0;
+}
+
 static inline struct iova *reserve_iova(struct iova_domain *iovad,
 					unsigned long pfn_lo,
 					unsigned long pfn_hi)
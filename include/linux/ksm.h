@@ -23,6 +23,17 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+vm_flags_t ksm_vma_flags(struct mm_struct *mm, const struct file *file,
+			 vm_flags_t vm_flags);
+int ksm_enable_merge_any(struct mm_struct *mm);
+int ksm_disable_merge_any(struct mm_struct *mm);
+long ksm_process_profit(struct mm_struct *mm);
+
+static inline void ksm_mm_init(struct mm_struct *mm)
+{
+	mm->ksm_merging_pages = 0;
+	mm->ksm_rmap_items = 0;
+}
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
@@ -65,6 +76,17 @@ static inline void ksm_exit(struct mm_struct *mm)
 {
 }
 
+static inline vm_flags_t ksm_vma_flags(struct mm_struct *mm,
+				       const struct file *file,
+				       vm_flags_t vm_flags)
+{
+	return vm_flags;
+}
+
+static inline void ksm_mm_init(struct mm_struct *mm)
+{
+}
+
 #ifdef CONFIG_MMU
 static inline int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
@@ -319,6 +319,9 @@ struct kvm_vcpu {
 	sigset_t sigset;
 	unsigned int halt_poll_ns;
 	bool valid_wakeup;
+	/* Recent block times by power of two, for the adaptive policy */
+	u16 halt_block_hist[HALT_POLL_HIST_COUNT];
+	u32 halt_block_samples;
 
 #ifdef CONFIG_HAS_IOMEM
 	int mmio_needed;
@@ -722,6 +725,8 @@ struct kvm {
 	struct srcu_struct irq_srcu;
 	pid_t userspace_pid;
 	unsigned int max_halt_poll_ns;
+	bool halt_poll_adaptive;
+	unsigned int halt_poll_pct;
 	u32 dirty_ring_size;
 	bool vm_bugged;
 
@@ -1559,7 +1564,9 @@ struct _kvm_stats_desc {
 	STATS_DESC_LOGHIST_TIME_NSEC(VCPU_GENERIC, halt_poll_fail_hist,	       \
 			HALT_POLL_HIST_COUNT),				       \
 	STATS_DESC_LOGHIST_TIME_NSEC(VCPU_GENERIC, halt_wait_hist,	       \
-			HALT_POLL_HIST_COUNT)
+			HALT_POLL_HIST_COUNT),				       \
+	STATS_DESC_COUNTER(VCPU_GENERIC, dirty_ring_pushes),		       \
+	STATS_DESC_COUNTER(VCPU_GENERIC, dirty_ring_full_exits)
 
 extern struct dentry *kvm_debugfs_dir;
 
@@ -1768,6 +1775,7 @@ extern unsigned int halt_poll_ns;
 extern unsigned int halt_poll_ns_grow;
 extern unsigned int halt_poll_ns_grow_start;
 extern unsigned int halt_poll_ns_shrink;
+extern unsigned int halt_poll_pct;
 
 struct kvm_device {
 	const struct kvm_device_ops *ops;
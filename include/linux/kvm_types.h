@@ -94,6 +94,8 @@ struct kvm_vcpu_stat_generic {
 	u64 halt_poll_success_hist[HALT_POLL_HIST_COUNT];
 	u64 halt_poll_fail_hist[HALT_POLL_HIST_COUNT];
 	u64 halt_wait_hist[HALT_POLL_HIST_COUNT];
+	u64 dirty_ring_pushes;
+	u64 dirty_ring_full_exits;
 };
 
 #define KVM_STATS_NAME_SIZE	48
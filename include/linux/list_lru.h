@@ -103,6 +103,35 @@ bool list_lru_add(struct list_lru *lru, struct list_head *item);
  */
 bool list_lru_del(struct list_lru *lru, struct list_head *item);
 
+/**
+ * list_lru_add_memcg: add an element to the lru list of a given memcg
+ * @list_lru: the lru pointer
+ * @item: the item to be added.
+ * @nid: the node id of the list to add to.
+ * @memcg: the cgroup of the list to add to, NULL for the root list.
+ *
+ * Like list_lru_add(), for items that are charged to a different cgroup
+ * than the one owning the memory they live in.
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_add_memcg(struct list_lru *lru, struct list_head *item,
+			int nid, struct mem_cgroup *memcg);
+
+/**
+ * list_lru_del_memcg: delete an element from the lru list of a given memcg
+ * @list_lru: the lru pointer
+ * @item: the item to be deleted.
+ * @nid: the node id the item was added with.
+ * @memcg: the cgroup the item was added with.
+ *
+ * The counterpart of list_lru_add_memcg().
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_del_memcg(struct list_lru *lru, struct list_head *item,
+			int nid, struct mem_cgroup *memcg);
+
 /**
  * list_lru_count_one: return the number of objects currently held by @lru
  * @lru: the lru pointer.
@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_LRU_GEN_H
+#define _LINUX_LRU_GEN_H
+
+#include <linux/mm.h>
+#include <linux/jump_label.h>
+
+#ifdef CONFIG_LRU_GEN
+
+/*
+ * Page table walk based aging, see mm/lru_gen.c.
+ *
+ * Every aging pass walks the page tables of the processes that ran since
+ * their last walk, clears the accessed bits it finds and stamps the pages
+ * behind them with the sequence number of the pass. Reclaim then asks how
+ * many passes ago a page was last found young instead of walking its rmap.
+ *
+ * The stamp lives in LRU_GEN_WIDTH bits of page->flags and stores
+ * (seq % MAX_NR_GENS) + 1, so that 0 means "not seen by aging". A page is
+ * young if its stamp is from one of the last MIN_NR_GENS passes. Older
+ * stamps are turned into LRU_GEN_OLD by the next walk that sees the page,
+ * and every mm is walked at least once every MAX_NR_GENS - MIN_NR_GENS
+ * passes, so that a stamp is never left to alias with a later pass once
+ * the sequence number wraps around modulo MAX_NR_GENS.
+ */
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+#define LRU_GEN_OLD		MAX_NR_GENS
+
+DECLARE_STATIC_KEY_FALSE(lru_gen_enabled_key);
+
+static inline bool lru_gen_enabled(void)
+{
+	return static_branch_unlikely(&lru_gen_enabled_key);
+}
+
+extern unsigned long lru_gen_seq;
+
+static inline int page_lru_gen(struct page *page)
+{
+	return ((READ_ONCE(page->flags) >> LRU_GEN_PGSHIFT) & LRU_GEN_MASK) - 1;
+}
+
+static inline void page_set_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, flags;
+
+	do {
+		old_flags = flags = READ_ONCE(page->flags);
+		flags &= ~(LRU_GEN_MASK << LRU_GEN_PGSHIFT);
+		flags |= ((unsigned long)(gen + 1) & LRU_GEN_MASK) <<
+			 LRU_GEN_PGSHIFT;
+	} while (unlikely(cmpxchg(&page->flags, old_flags, flags) != old_flags));
+}
+
+/* The page is being freed, nobody else can look at its flags */
+static inline void page_reset_lru_gen(struct page *page)
+{
+	page->flags &= ~(LRU_GEN_MASK << LRU_GEN_PGSHIFT);
+}
+
+/**
+ * lru_gen_test_clear_young - consume the aging stamp of a page
+ * @page: the head page to check
+ *
+ * Returns 1 if the page was found young by the current or the previous aging
+ * pass, 0 if it was found young earlier than that and -1 if the page carries
+ * no stamp, in which case the caller has to fall back to the rmap walk. The
+ * stamp is consumed.
+ */
+static inline int lru_gen_test_clear_young(struct page *page)
+{
+	int gen = page_lru_gen(page);
+
+	if (gen < 0)
+		return -1;
+
+	page_set_lru_gen(page, -1);
+	if (gen == LRU_GEN_OLD)
+		return 0;
+
+	return (READ_ONCE(lru_gen_seq) + MAX_NR_GENS - gen) % MAX_NR_GENS <
+	       MIN_NR_GENS;
+}
+
+/* Called on context switch into a user address space */
+static inline void lru_gen_use_mm(struct mm_struct *mm)
+{
+	if (lru_gen_enabled() && !READ_ONCE(mm->lru_gen.active))
+		WRITE_ONCE(mm->lru_gen.active, true);
+}
+
+void lru_gen_add_mm(struct mm_struct *mm);
+void lru_gen_del_mm(struct mm_struct *mm);
+void lru_gen_age(bool force);
+
+#else /* !CONFIG_LRU_GEN */
+
+static inline bool lru_gen_enabled(void)
+{
+	return false;
+}
+
+static inline void page_reset_lru_gen(struct page *page)
+{
+}
+
+static inline int lru_gen_test_clear_young(struct page *page)
+{
+	return -1;
+}
+
+static inline void lru_gen_use_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_add_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_del_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_age(bool force)
+{
+}
+
+#endif /* CONFIG_LRU_GEN */
+
+#endif /* _LINUX_LRU_GEN_H */
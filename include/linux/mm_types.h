@@ -15,6 +15,7 @@
 #include <linux/page-flags-layout.h>
 #include <linux/workqueue.h>
 #include <linux/seqlock.h>
+#include <linux/vma_tree.h>
 
 #include <asm/mmu.h>
 
@@ -166,6 +167,7 @@ struct page {
 			union {
 				struct mm_struct *pt_mm; /* x86 pgds only */
 				atomic_t pt_frag_refcount; /* powerpc */
+				atomic_t pt_share_count; /* x86-64 pte tables */
 			};
 #if ALLOC_SPLIT_PTLOCKS
 			spinlock_t *ptl;
@@ -385,6 +387,18 @@ struct vm_area_struct {
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
+	/*
+	 * Fault-around window in pages set by MADV_[NO]FAULTAROUND, 0 when
+	 * unset (fault_around_bytes for file faults only), 1 when disabled.
+	 */
+	unsigned int vm_fault_around;
+#ifdef CONFIG_PER_VMA_LOCK
+	/* Page faults without mmap_lock, see vma_start_read() */
+	int vm_lock_seq;
+	bool detached;
+	struct rw_semaphore vm_lock;
+	struct rcu_head vm_rcu;
+#endif
 } __randomize_layout;
 
 struct core_thread {
@@ -403,7 +417,7 @@ struct mm_struct {
 	struct {
 		struct vm_area_struct *mmap;		/* list of VMAs */
 		struct rb_root mm_rb;
-		u64 vmacache_seqnum;                   /* per-thread vmacache */
+		struct vma_tree mm_vt;		/* lockless VMA lookups */
 #ifdef CONFIG_MMU
 		unsigned long (*get_unmapped_area) (struct file *filp,
 				unsigned long addr, unsigned long len,
@@ -471,6 +485,18 @@ struct mm_struct {
 		 * cacheline.
 		 */
 		struct rw_semaphore mmap_lock;
+#ifdef CONFIG_PER_VMA_LOCK
+		/*
+		 * Bumped when mmap_lock is released for write, which drops
+		 * the VMA locks taken under it, see vma_start_write().
+		 */
+		int mm_lock_seq;
+#endif
+		/*
+		 * jiffies when mmap_lock was last released for write, lets
+		 * VMA walkers skip address spaces that have not changed.
+		 */
+		unsigned long mmap_write_stamp;
 
 		struct list_head mmlist; /* List of maybe swapped mm's.	These
 					  * are globally strung together off
@@ -579,6 +605,26 @@ struct mm_struct {
 
 #ifdef CONFIG_IOMMU_SUPPORT
 		u32 pasid;
+#endif
+#ifdef CONFIG_LRU_GEN
+		struct {
+			/* link into lru_gen_mm_list, see mm/lru_gen.c */
+			struct list_head list;
+			/* aging pass in which this mm was last looked at */
+			unsigned long seq;
+			/* aging pass in which its page tables were walked */
+			unsigned long walked;
+			/* set on context switch, cleared when walked */
+			bool active;
+		} lru_gen;
+#endif
+#ifdef CONFIG_KSM
+		/*
+		 * Pages of this mm that map a KSM page, and the rmap_items
+		 * ksmd keeps to track pages of this mm, see mm/ksm.c.
+		 */
+		unsigned long ksm_merging_pages;
+		unsigned long ksm_rmap_items;
 #endif
 	} __randomize_layout;
 
@@ -1,6 +1,7 @@
 #ifndef _LINUX_MMAP_LOCK_H
 #define _LINUX_MMAP_LOCK_H
 
+#include <linux/jiffies.h>
 #include <linux/lockdep.h>
 #include <linux/mm_types.h>
 #include <linux/mmdebug.h>
@@ -63,6 +64,18 @@ static inline void __mmap_lock_trace_released(struct mm_struct *mm, bool write)
 static inline void mmap_init_lock(struct mm_struct *mm)
 {
 	init_rwsem(&mm->mmap_lock);
+#ifdef CONFIG_PER_VMA_LOCK
+	mm->mm_lock_seq = 0;
+#endif
+	mm->mmap_write_stamp = jiffies;
+}
+
+/* Drop all the VMA write locks taken under the mmap_lock held for write */
+static inline void vma_end_write_all(struct mm_struct *mm)
+{
+#ifdef CONFIG_PER_VMA_LOCK
+	WRITE_ONCE(mm->mm_lock_seq, mm->mm_lock_seq + 1);
+#endif
 }
 
 static inline void mmap_write_lock(struct mm_struct *mm)
@@ -102,12 +115,16 @@ static inline bool mmap_write_trylock(struct mm_struct *mm)
 static inline void mmap_write_unlock(struct mm_struct *mm)
 {
 	__mmap_lock_trace_released(mm, true);
+	vma_end_write_all(mm);
+	WRITE_ONCE(mm->mmap_write_stamp, jiffies);
 	up_write(&mm->mmap_lock);
 }
 
 static inline void mmap_write_downgrade(struct mm_struct *mm)
 {
 	__mmap_lock_trace_acquire_returned(mm, false, true);
+	vma_end_write_all(mm);
+	WRITE_ONCE(mm->mmap_write_stamp, jiffies);
 	downgrade_write(&mm->mmap_lock);
 }
 
@@ -209,6 +209,11 @@ enum node_stat_item {
 	NR_PAGETABLE,		/* used for pagetables */
 #ifdef CONFIG_SWAP
 	NR_SWAPCACHE,
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	PGPROMOTE_SUCCESS,	/* promote successfully */
+	PGPROMOTE_CANDIDATE,	/* candidate pages to promote */
+	PGPROMOTE_RATE_LIMITED,	/* candidates dropped by the rate limit */
 #endif
 	NR_VM_NODE_STAT_ITEMS
 };
@@ -342,7 +347,9 @@ enum zone_watermarks {
 #else
 #define NR_PCP_THP 0
 #endif
-#define NR_PCP_LISTS (MIGRATE_PCPTYPES * (PAGE_ALLOC_COSTLY_ORDER + 1 + NR_PCP_THP))
+#define NR_PCP_ORDERS (PAGE_ALLOC_COSTLY_ORDER + 1 + NR_PCP_THP)
+#define NR_PCP_HIGH_ORDERS (NR_PCP_ORDERS - 1)
+#define NR_PCP_LISTS (MIGRATE_PCPTYPES * NR_PCP_ORDERS)
 
 /*
  * Shift to encode migratetype and order in the same integer, with order
@@ -366,6 +373,13 @@ struct per_cpu_pages {
 	short expire;		/* When 0, remote pagesets are drained */
 #endif
 
+	/*
+	 * Number of pages (of that order) on each order's lists. high and
+	 * batch above apply to order-0 only; the high-order lists have
+	 * their own limits, see pcp_order_high().
+	 */
+	int order_nr[NR_PCP_ORDERS];
+
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[NR_PCP_LISTS];
 };
@@ -854,6 +868,13 @@ typedef struct pglist_data {
 	wait_queue_head_t kcompactd_wait;
 	struct task_struct *kcompactd;
 	bool proactive_compact_trigger;
+	/*
+	 * High-order allocations that missed the free lists since the last
+	 * goal update, and the free blocks kcompactd keeps for each order in
+	 * return. Indexed like the high-order pcp lists, see mm/compaction.c.
+	 */
+	unsigned int compact_alloc_fail[NR_PCP_HIGH_ORDERS];
+	unsigned int compact_goal[NR_PCP_HIGH_ORDERS];
 #endif
 	/*
 	 * This is a per-node reserve of pages that are not available
@@ -895,6 +916,13 @@ typedef struct pglist_data {
 
 	unsigned long		flags;
 
+#ifdef CONFIG_NUMA_BALANCING
+	/* start time in ms of current promote rate limit period */
+	unsigned int nbp_rl_start;
+	/* number of promote candidate pages at start time of current rate limit period */
+	unsigned long nbp_rl_nr_cand;
+#endif
+
 	ZONE_PADDING(_pad2_)
 
 	/* Per-node vmstats */
@@ -1075,6 +1103,8 @@ int sysctl_min_slab_ratio_sysctl_handler(struct ctl_table *, int,
 int numa_zonelist_order_handler(struct ctl_table *, int,
 		void *, size_t *, loff_t *);
 extern int percpu_pagelist_high_fraction;
+extern int sysctl_percpu_pagelist_order_high[NR_PCP_HIGH_ORDERS];
+extern int sysctl_percpu_pagelist_order_batch[NR_PCP_HIGH_ORDERS];
 extern char numa_zonelist_order[];
 #define NUMA_ZONELIST_ORDER_LEN	16
 
@@ -306,10 +306,12 @@ struct gro_list {
 };
 
 /*
- * size of gro hash buckets, must less than bit number of
- * napi_struct::gro_bitmask
+ * default size of gro hash buckets, embedded in napi_struct.  Bigger
+ * tables (net_device::gro_hash_buckets) are allocated, but can't have
+ * more buckets than napi_struct::gro_bitmask has bits.
  */
 #define GRO_HASH_BUCKETS	8
+#define GRO_HASH_MAX_BUCKETS	BITS_PER_LONG
 
 /*
  * Structure for NAPI scheduling similar to tasklet but with weighting
@@ -332,7 +334,8 @@ struct napi_struct {
 	int			poll_owner;
 #endif
 	struct net_device	*dev;
-	struct gro_list		gro_hash[GRO_HASH_BUCKETS];
+	struct gro_list		*gro_hash;
+	unsigned int		gro_hash_mask;
 	struct sk_buff		*skb;
 	struct list_head	rx_list; /* Pending GRO_NORMAL skbs */
 	int			rx_count; /* length of rx_list */
@@ -341,6 +344,11 @@ struct napi_struct {
 	struct hlist_node	napi_hash_node;
 	unsigned int		napi_id;
 	struct task_struct	*thread;
+	/* stats, only updated by the owner of NAPI_STATE_SCHED */
+	u64			poll_count;
+	u64			poll_packets;
+	u64			poll_idle;	/* empty busy polls of the thread */
+	struct gro_list		gro_hash_inline[GRO_HASH_BUCKETS];
 };
 
 enum {
@@ -354,6 +362,7 @@ enum {
 	NAPI_STATE_PREFER_BUSY_POLL,	/* prefer busy-polling over softirq processing*/
 	NAPI_STATE_THREADED,		/* The poll is performed inside its own thread*/
 	NAPI_STATE_SCHED_THREADED,	/* Napi is currently scheduled in threaded mode */
+	NAPI_STATE_THREADED_BUSY_POLL,	/* The napi thread busy polls instead of waiting for irqs */
 };
 
 enum {
@@ -367,6 +376,7 @@ enum {
 	NAPIF_STATE_PREFER_BUSY_POLL	= BIT(NAPI_STATE_PREFER_BUSY_POLL),
 	NAPIF_STATE_THREADED		= BIT(NAPI_STATE_THREADED),
 	NAPIF_STATE_SCHED_THREADED	= BIT(NAPI_STATE_SCHED_THREADED),
+	NAPIF_STATE_THREADED_BUSY_POLL	= BIT(NAPI_STATE_THREADED_BUSY_POLL),
 };
 
 enum gro_result {
@@ -493,6 +503,7 @@ static inline bool napi_complete(struct napi_struct *n)
 }
 
 int dev_set_threaded(struct net_device *dev, bool threaded);
+int dev_set_threaded_busy_poll(struct net_device *dev, bool busy_poll);
 
 /**
  *	napi_disable - prevent NAPI from scheduling
@@ -1849,6 +1860,10 @@ enum netdev_ml_priv_type {
  *	@gro_flush_timeout:	timeout for GRO layer in NAPI
  *	@napi_defer_hard_irqs:	If not zero, provides a counter that would
  *				allow to avoid NIC hard IRQ, on busy queues.
+ *	@gro_hash_buckets:	Number of GRO hash buckets of NAPI instances
+ *				added from now on, a power of two
+ *	@gro_max_size:	Maximum size of aggregated packet in generic
+ *			receive offload (GRO)
  *
  *	@rx_handler:		handler for received packets
  *	@rx_handler_data: 	XXX: need comments on this one
@@ -1917,6 +1932,9 @@ enum netdev_ml_priv_type {
  *	@gso_max_size:	Maximum size of generic segmentation offload
  *	@gso_max_segs:	Maximum number of segments that can be passed to the
  *			NIC for GSO
+ *	@tso_max_size:	Device (as in HW) limit on the max TSO request size,
+ *			gso_max_size cannot be set above it.  Packets above
+ *			GSO_LEGACY_MAX_SIZE are IPv6 with a HBH jumbo header.
  *
  *	@dcbnl_ops:	Data Center Bridging netlink ops
  *	@num_tc:	Number of traffic classes in the net device
@@ -1940,6 +1958,10 @@ enum netdev_ml_priv_type {
  *	@wol_enabled:	Wake-on-LAN is enabled
  *
  *	@threaded:	napi threaded mode is enabled
+ *	@threaded_busy_poll:	napi threads busy poll their queue
+ *	@threaded_busy_poll_usecs:	how long a busy polling napi thread
+ *				keeps polling without finding packets, 0 for
+ *				no limit
  *
  *	@net_notifier_list:	List of per-net netdev notifier block
  *				that follow this device when it is moved
@@ -1951,6 +1973,8 @@ enum netdev_ml_priv_type {
  *				offload capabilities of the device
  *	@udp_tunnel_nic:	UDP tunnel offload state
  *	@xdp_state:		stores info on attached XDP BPF programs
+ *	@xdp_zc_max_chunk_size:	Largest AF_XDP umem chunk the driver can use
+ *				in zero-copy mode, if larger than PAGE_SIZE
  *
  *	@nested_level:	Used as as a parameter of spin_lock_nested() of
  *			dev->addr_list_lock.
@@ -2141,6 +2165,14 @@ struct net_device {
 	struct bpf_prog __rcu	*xdp_prog;
 	unsigned long		gro_flush_timeout;
 	int			napi_defer_hard_irqs;
+	unsigned int		gro_hash_buckets;
+	unsigned int		threaded_busy_poll_usecs;
+#define GRO_LEGACY_MAX_SIZE	65536u
+/* TCP minimal MSS is 8 (TCP_MIN_GSO_SIZE),
+ * and shinfo->gso_segs is a 16bit field.
+ */
+#define GRO_MAX_SIZE		(8 * GSO_MAX_SEGS)
+	unsigned int		gro_max_size;
 	rx_handler_func_t __rcu	*rx_handler;
 	void __rcu		*rx_handler_data;
 
@@ -2244,10 +2276,15 @@ struct net_device {
 	const struct rtnl_link_ops *rtnl_link_ops;
 
 	/* for setting kernel sock attribute on TCP connection setup */
-#define GSO_MAX_SIZE		65536
+#define GSO_LEGACY_MAX_SIZE	65536u
+#define GSO_MAX_SEGS		65535u
+/* TCP minimal MSS is 8 (TCP_MIN_GSO_SIZE),
+ * and shinfo->gso_segs is a 16bit field.
+ */
+#define GSO_MAX_SIZE		(8 * GSO_MAX_SEGS)
 	unsigned int		gso_max_size;
-#define GSO_MAX_SEGS		65535
 	u16			gso_max_segs;
+	unsigned int		tso_max_size;
 
 #ifdef CONFIG_DCB
 	const struct dcbnl_rtnl_ops *dcbnl_ops;
@@ -2269,6 +2306,7 @@ struct net_device {
 	bool			proto_down;
 	unsigned		wol_enabled:1;
 	unsigned		threaded:1;
+	unsigned		threaded_busy_poll:1;
 
 	struct list_head	net_notifier_list;
 
@@ -2281,6 +2319,7 @@ struct net_device {
 
 	/* protected by rtnl_lock */
 	struct bpf_xdp_entity	xdp_state[__MAX_XDP_MODE];
+	u32			xdp_zc_max_chunk_size;
 };
 #define to_net_dev(d) container_of(d, struct net_device, dev)
 
@@ -3348,6 +3387,13 @@ struct softnet_data {
 	unsigned int		processed;
 	unsigned int		time_squeeze;
 	unsigned int		received_rps;
+	unsigned int		gro_held;
+	unsigned int		gro_merged;
+	/* per-CPU skb head caches, see net/core/skbuff.c */
+	unsigned int		skb_cache_hit;
+	unsigned int		skb_cache_refill;
+	unsigned int		skb_cache_put;
+	unsigned int		skb_cache_flush;
 #ifdef CONFIG_RPS
 	struct softnet_data	*rps_ipi_list;
 #endif
@@ -4025,6 +4071,9 @@ int netif_receive_skb_core(struct sk_buff *skb);
 void netif_receive_skb_list(struct list_head *head);
 gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb);
 void napi_gro_flush(struct napi_struct *napi, bool flush_old);
+void napi_gro_init(struct napi_struct *napi);
+void napi_gro_flush_normal(struct napi_struct *napi, bool flush_old);
+void napi_gro_cleanup(struct napi_struct *napi);
 struct sk_buff *napi_get_frags(struct napi_struct *napi);
 gro_result_t napi_gro_frags(struct napi_struct *napi);
 struct packet_offload *gro_find_receive_by_type(__be16 type);
@@ -5128,7 +5177,31 @@ static inline bool netif_needs_gso(struct sk_buff *skb,
 static inline void netif_set_gso_max_size(struct net_device *dev,
 					  unsigned int size)
 {
-	dev->gso_max_size = size;
+	/* dev->gso_max_size is read locklessly from sk_setup_caps() */
+	WRITE_ONCE(dev->gso_max_size, size);
+}
+
+static inline void netif_set_gro_max_size(struct net_device *dev,
+					  unsigned int size)
+{
+	/* This pairs with the READ_ONCE() in skb_gro_receive() */
+	WRITE_ONCE(dev->gro_max_size, size);
+}
+
+/**
+ * netif_set_tso_max_size() - set the max size of TSO frames supported
+ * @dev:	netdev to update
+ * @size:	max skb->len of a TSO frame
+ *
+ * Drivers that strip the IPv6 HBH jumbo header themselves may raise this
+ * above GSO_LEGACY_MAX_SIZE.  Also caps gso_max_size to the new limit.
+ */
+static inline void netif_set_tso_max_size(struct net_device *dev,
+					  unsigned int size)
+{
+	dev->tso_max_size = min(size, GSO_MAX_SIZE);
+	if (dev->tso_max_size < READ_ONCE(dev->gso_max_size))
+		netif_set_gso_max_size(dev, dev->tso_max_size);
 }
 
 static inline void skb_gso_error_unwind(struct sk_buff *skb, __be16 protocol,
@@ -87,6 +87,10 @@ enum nfs_stat_bytecounters {
  * change the size of a file (such operations can often be the
  * source of data corruption if applications aren't using file
  * locking properly).
+ *
+ * READDIRCACHEHIT and READDIRCACHEMISS count the readdir page cache
+ * pages that were found filled, and those that had to be filled by a
+ * READDIR or READDIRPLUS request on the wire.
  */
 enum nfs_stat_eventcounters {
 	NFSIOS_INODEREVALIDATE = 0,
@@ -116,6 +120,8 @@ enum nfs_stat_eventcounters {
 	NFSIOS_DELAY,
 	NFSIOS_PNFS_READ,
 	NFSIOS_PNFS_WRITE,
+	NFSIOS_READDIRCACHEHIT,
+	NFSIOS_READDIRCACHEMISS,
 	__NFSIOS_COUNTSMAX,
 };
 
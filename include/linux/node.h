@@ -181,4 +181,13 @@ static inline void register_hugetlbfs_with_node(node_registration_func_t reg,
 
 #define to_node(device) container_of(device, struct node, dev)
 
+/*
+ * Nodes with CPUs are the fast memory tier, CPU-less nodes (CXL, PMEM)
+ * are treated as slow memory that hot pages get promoted out of.
+ */
+static inline bool node_is_toptier(int node)
+{
+	return node_state(node, N_CPU);
+}
+
 #endif /* _LINUX_NODE_H_ */
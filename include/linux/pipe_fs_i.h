@@ -42,6 +42,7 @@ struct pipe_buffer {
  *	@max_usage: The maximum number of slots that may be used in the ring
  *	@ring_size: total number of buffers (should be a power of 2)
  *	@nr_accounted: The amount this pipe accounts for in user->pipe_bufs
+ *	@buf_order: page order of the buffers pipe_write() tries to allocate
  *	@tmp_page: cached released page
  *	@readers: number of current readers of this pipe
  *	@writers: number of current writers of this pipe
@@ -66,6 +67,7 @@ struct pipe_inode_info {
 	bool note_loss;
 #endif
 	unsigned int nr_accounted;
+	unsigned int buf_order;
 	unsigned int readers;
 	unsigned int writers;
 	unsigned int files;
@@ -273,6 +275,9 @@ bool too_many_pipe_buffers_hard(unsigned long user_bufs);
 bool pipe_is_unprivileged_user(void);
 #endif
 
+/* Largest buffer F_SETPIPE_BUFSZ accepts */
+#define PIPE_MAX_BUF_ORDER	PAGE_ALLOC_COSTLY_ORDER
+
 /* for F_SETPIPE_SZ and F_GETPIPE_SZ */
 #ifdef CONFIG_WATCH_QUEUE
 int pipe_resize_ring(struct pipe_inode_info *pipe, unsigned int nr_slots);
@@ -65,7 +65,8 @@ struct rhash_lock_head {};
  * struct bucket_table - Table of hash buckets
  * @size: Number of hash buckets
  * @nest: Number of bits of first-level nested table.
- * @rehash: Current bucket being rehashed
+ * @rehash: Next bucket to be rehashed
+ * @rehash_busy: Number of tasks moving buckets of this table
  * @hash_rnd: Random seed to fold into hash
  * @walkers: List of active walkers
  * @rcu: RCU structure for freeing the table
@@ -76,6 +77,8 @@ struct rhash_lock_head {};
 struct bucket_table {
 	unsigned int		size;
 	unsigned int		nest;
+	atomic_t		rehash;
+	atomic_t		rehash_busy;
 	u32			hash_rnd;
 	struct list_head	walkers;
 	struct rcu_head		rcu;
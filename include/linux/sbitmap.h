@@ -11,6 +11,7 @@
 
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/topology.h>
 
 struct seq_file;
 
@@ -61,6 +62,12 @@ struct sbitmap {
 	 */
 	bool round_robin;
 
+	/**
+	 * @numa: Split the words between the NUMA nodes, see
+	 * sbitmap_enable_numa().
+	 */
+	bool numa;
+
 	/**
 	 * @map: Allocated bitmap.
 	 */
@@ -73,6 +80,12 @@ struct sbitmap {
 	 * cachelines until the map is exhausted.
 	 */
 	unsigned int __percpu *alloc_hint;
+
+	/**
+	 * @remote_alloc: Number of bits a CPU took from the words of another
+	 * node, only allocated if @numa is set.
+	 */
+	unsigned long __percpu *remote_alloc;
 };
 
 #define SBQ_WAIT_QUEUES 8
@@ -161,11 +174,28 @@ int sbitmap_init_node(struct sbitmap *sb, unsigned int depth, int shift,
  */
 static inline void sbitmap_free(struct sbitmap *sb)
 {
+	free_percpu(sb->remote_alloc);
 	free_percpu(sb->alloc_hint);
 	kfree(sb->map);
 	sb->map = NULL;
 }
 
+/**
+ * sbitmap_enable_numa() - Make the allocation hints of a &struct sbitmap
+ * NUMA aware.
+ * @sb: Bitmap to set up, initialized with per-cpu allocation hints.
+ * @flags: Allocation flags.
+ *
+ * The words are split in one range per node. Each CPU starts looking for
+ * free bits in the range of its node and only takes bits from other nodes
+ * once that is full, so the words mostly stay in the caches of one node. Does
+ * nothing on single node systems, for round robin bitmaps and for bitmaps
+ * with fewer words than nodes.
+ *
+ * Return: Zero on success or negative errno on failure.
+ */
+int sbitmap_enable_numa(struct sbitmap *sb, gfp_t flags);
+
 /**
  * sbitmap_resize() - Resize a &struct sbitmap.
  * @sb: Bitmap to resize.
@@ -406,6 +436,18 @@ static inline void sbitmap_queue_free(struct sbitmap_queue *sbq)
 	sbitmap_free(&sbq->sb);
 }
 
+/**
+ * sbitmap_queue_enable_numa() - Make a &struct sbitmap_queue NUMA aware.
+ * @sbq: Bitmap queue to set up.
+ * @flags: Allocation flags.
+ *
+ * See sbitmap_enable_numa(). On top of that, waiters and wakers prefer the
+ * wait queues of their own node and the wake batch is sized per node.
+ *
+ * Return: Zero on success or negative errno on failure.
+ */
+int sbitmap_queue_enable_numa(struct sbitmap_queue *sbq, gfp_t flags);
+
 /**
  * sbitmap_queue_resize() - Resize a &struct sbitmap_queue.
  * @sbq: Bitmap queue to resize.
@@ -426,6 +468,22 @@ void sbitmap_queue_resize(struct sbitmap_queue *sbq, unsigned int depth);
  */
 int __sbitmap_queue_get(struct sbitmap_queue *sbq);
 
+/**
+ * __sbitmap_queue_get_batch() - Try to allocate a batch of free bits
+ * @sbq: Bitmap queue to allocate from.
+ * @nr_tags: number of tags requested, at most BITS_PER_LONG - 1.
+ * @offset: offset to add to returned bits
+ *
+ * The bits are all taken from a single word, so fewer than @nr_tags may
+ * be returned.
+ *
+ * Return: Mask of allocated tags, 0 if none are found. Each tag allocated is
+ * a bit in the mask returned, and the caller must add @offset to the value to
+ * get the absolute tag value.
+ */
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset);
+
 /**
  * __sbitmap_queue_get_shallow() - Try to allocate a free bit from a &struct
  * sbitmap_queue, limiting the depth used from each word, with preemption
@@ -515,6 +573,17 @@ void sbitmap_queue_min_shallow_depth(struct sbitmap_queue *sbq,
 void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 			 unsigned int cpu);
 
+/**
+ * sbitmap_queue_clear_batch() - Free a batch of allocated bits and wake up
+ * waiters on a &struct sbitmap_queue.
+ * @sbq: Bitmap to free from.
+ * @offset: offset for each tag in array
+ * @tags: array of tags
+ * @nr_tags: number of tags in array
+ */
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags);
+
 static inline int sbq_index_inc(int index)
 {
 	return (index + 1) & (SBQ_WAIT_QUEUES - 1);
@@ -527,6 +596,20 @@ static inline void sbq_index_atomic_inc(atomic_t *index)
 	atomic_cmpxchg(index, old, new);
 }
 
+/* Number of wait queues of each node of a NUMA aware &struct sbitmap_queue */
+static inline int sbq_node_wait_queues(void)
+{
+	return max_t(int, SBQ_WAIT_QUEUES / nr_node_ids, 1);
+}
+
+/* Map @index to one of the wait queues of node @nid */
+static inline int sbq_node_wait_index(int nid, int index)
+{
+	int nr = sbq_node_wait_queues();
+
+	return (nid * nr + index % nr) & (SBQ_WAIT_QUEUES - 1);
+}
+
 /**
  * sbq_wait_ptr() - Get the next wait queue to use for a &struct
  * sbitmap_queue.
@@ -537,8 +620,11 @@ static inline struct sbq_wait_state *sbq_wait_ptr(struct sbitmap_queue *sbq,
 						  atomic_t *wait_index)
 {
 	struct sbq_wait_state *ws;
+	int index = atomic_read(wait_index);
 
-	ws = &sbq->ws[atomic_read(wait_index)];
+	if (unlikely(sbq->sb.numa))
+		index = sbq_node_wait_index(numa_node_id(), index);
+	ws = &sbq->ws[index];
 	sbq_index_atomic_inc(wait_index);
 	return ws;
 }
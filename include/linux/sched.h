@@ -521,6 +521,10 @@ struct sched_statistics {
 	u64				nr_wakeups_affine_attempts;
 	u64				nr_wakeups_passive;
 	u64				nr_wakeups_idle;
+
+#ifdef CONFIG_SCHED_CORE
+	u64				core_forceidle_sum;
+#endif
 #endif
 };
 
@@ -538,6 +542,17 @@ struct sched_entity {
 
 	u64				nr_migrations;
 
+#ifdef CONFIG_SMP
+	/* CPU burst tracking, used to measure the cost of a migration: */
+	u64				burst_start;
+	u64				avg_burst;
+	/* sched_domain level + 1 of the last balancer migration, or 0: */
+	int				migr_level;
+#endif
+
+	/* See MIN_LATENCY_NICE, negative values preempt sooner: */
+	int				latency_nice;
+
 	struct sched_statistics		statistics;
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -602,6 +617,7 @@ struct sched_dl_entity {
 	s64				runtime;	/* Remaining runtime for this instance	*/
 	u64				deadline;	/* Absolute deadline for this instance	*/
 	unsigned int			flags;		/* Specifying the scheduler behaviour	*/
+	int				part_cpu;	/* CPU charged with our partitioned bw, or -1 */
 
 	/*
 	 * Some bool flags:
@@ -857,9 +873,6 @@ struct task_struct {
 	struct mm_struct		*mm;
 	struct mm_struct		*active_mm;
 
-	/* Per-thread vma caching: */
-	struct vmacache			vmacache;
-
 #ifdef SPLIT_RSS_COUNTING
 	struct task_rss_stat		rss_stat;
 #endif
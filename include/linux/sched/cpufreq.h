@@ -9,6 +9,17 @@
  */
 
 #define SCHED_CPUFREQ_IOWAIT	(1U << 0)
+#define SCHED_CPUFREQ_WAKE_BOOST	(1U << 1)
+
+/*
+ * Reasons behind a schedutil frequency decision, see the
+ * sugov_update_freq tracepoint.
+ */
+#define SUGOV_REASON_UTIL	(1U << 0)	/* plain PELT utilization */
+#define SUGOV_REASON_IOWAIT	(1U << 1)	/* IO wait boost applied */
+#define SUGOV_REASON_WAKE_BOOST	(1U << 2)	/* uclamp.min wakeup boost applied */
+#define SUGOV_REASON_LIMITS	(1U << 3)	/* rate limit bypassed (limits, DL, boost) */
+#define SUGOV_REASON_BUSY	(1U << 4)	/* reduction held back, CPU not idle */
 
 #ifdef CONFIG_CPU_FREQ
 struct cpufreq_policy;
@@ -75,8 +75,19 @@ struct sched_domain_shared {
 	atomic_t	nr_busy_cpus;
 	int		has_idle_cores;
 	int		nr_idle_scan;
+
+	/*
+	 * CPUs of the LLC that may be idle, used to filter the wakeup
+	 * idle CPU search (SIS_FILTER). Set on idle entry, cleared lazily.
+	 */
+	unsigned long	idle_cpus_span[];
 };
 
+static inline struct cpumask *sds_idle_cpus(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_cpus_span);
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain __rcu *parent;	/* top domain must be null terminated */
@@ -103,6 +114,8 @@ struct sched_domain {
 
 	u64 avg_scan_cost;		/* select_idle_sibling */
 
+	u64 migration_cost;		/* measured post-migration penalty */
+
 #ifdef CONFIG_SCHEDSTATS
 	/* load_balance() stats */
 	unsigned int lb_count[CPU_MAX_IDLE_TYPES];
@@ -39,6 +39,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	SHEAF_ALLOC,		/* Allocation from cpu sheaf */
+	SHEAF_FREE,		/* Free to cpu sheaf */
+	SHEAF_REFILL,		/* Bulk refill of an empty cpu sheaf */
+	SHEAF_FLUSH,		/* Bulk flush of a full cpu sheaf */
 	NR_SLUB_STAT_ITEMS };
 
 /*
@@ -75,6 +79,19 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+/*
+ * Optional per cpu array of free objects ("sheaf"), see sheaf_capacity in
+ * sysfs. Objects in a sheaf have been through the free hooks and are handed
+ * out again without touching the slab freelists.
+ */
+#define SLUB_SHEAF_MAX_CAPACITY	64
+
+struct slub_percpu_sheaf {
+	local_lock_t lock;	/* Protects the fields below */
+	unsigned int size;	/* Number of objects in the sheaf */
+	void *objects[SLUB_SHEAF_MAX_CAPACITY];
+};
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -100,6 +117,9 @@ struct kmem_cache {
 	/* Number of per cpu partial objects to keep around */
 	unsigned int cpu_partial;
 #endif
+	/* Number of objects per cpu sheaf, 0 if sheaves are disabled */
+	unsigned int sheaf_capacity;
+	struct slub_percpu_sheaf __percpu *cpu_sheaves;
 	struct kmem_cache_order_objects oo;
 
 	/* Allocation and freeing of slabs */
@@ -27,6 +27,7 @@ struct svc_pool_stats {
 	unsigned long	sockets_queued;
 	atomic_long_t	threads_woken;
 	atomic_long_t	threads_timedout;
+	atomic_long_t	wakeup_usecs;	/* enqueue to thread running, total */
 };
 
 /*
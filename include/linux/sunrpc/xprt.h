@@ -243,6 +243,8 @@ struct rpc_xprt {
 	 * Send stuff
 	 */
 	atomic_long_t		queuelen;
+	unsigned long		srtt;		/* smoothed reply time in
+						   usecs, scaled by 8 */
 	spinlock_t		transport_lock;	/* lock transport info */
 	spinlock_t		reserve_lock;	/* lock slot table */
 	spinlock_t		queue_lock;	/* send/receive queue lock */
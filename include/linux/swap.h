@@ -220,10 +220,13 @@ struct swap_cluster_info {
 				 */
 	unsigned int data:24;
 	unsigned int flags:8;
+	struct list_head list;	/* entry in nonfull_clusters */
 };
 #define CLUSTER_FLAG_FREE 1 /* This cluster is free */
 #define CLUSTER_FLAG_NEXT_NULL 2 /* This cluster has no next cluster */
 #define CLUSTER_FLAG_HUGE 4 /* This cluster is backing a transparent huge page */
+#define CLUSTER_FLAG_NONFULL 8 /* This cluster is on the nonfull list */
+#define CLUSTER_FLAG_FROM_HUGE 16 /* This cluster was allocated for a THP */
 
 /*
  * We assign a cluster to each CPU, so each CPU can allocate swap entry from
@@ -253,6 +256,7 @@ struct swap_info_struct {
 	unsigned char *swap_map;	/* vmalloc'ed array of usage counts */
 	struct swap_cluster_info *cluster_info; /* cluster info. Only for SSD */
 	struct swap_cluster_list free_clusters; /* free clusters list */
+	struct list_head nonfull_clusters; /* partially used clusters */
 	unsigned int lowest_bit;	/* index of first free in swap_map */
 	unsigned int highest_bit;	/* index of last free in swap_map */
 	unsigned int pages;		/* total of usable pages of swap */
@@ -383,6 +387,16 @@ extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 						  unsigned long nr_pages,
 						  gfp_t gfp_mask,
 						  bool may_swap);
+
+/* memory.reclaim swappiness=max: reclaim anonymous memory only */
+#define SWAPPINESS_ANON_ONLY	(200 + 1)
+
+extern unsigned long try_to_free_mem_cgroup_pages_proactive(struct mem_cgroup *memcg,
+							    unsigned long nr_pages,
+							    gfp_t gfp_mask,
+							    bool may_swap,
+							    int *swappiness,
+							    unsigned long *nr_scanned);
 extern unsigned long mem_cgroup_shrink_node(struct mem_cgroup *mem,
 						gfp_t gfp_mask, bool noswap,
 						pg_data_t *pgdat,
@@ -508,6 +522,7 @@ extern int __swp_swapcount(swp_entry_t entry);
 extern int swp_swapcount(swp_entry_t entry);
 extern struct swap_info_struct *page_swap_info(struct page *);
 extern struct swap_info_struct *swp_swap_info(swp_entry_t entry);
+extern bool swap_entry_from_huge(swp_entry_t entry);
 extern bool reuse_swap_page(struct page *, int *);
 extern int try_to_free_swap(struct page *);
 struct backing_dev_info;
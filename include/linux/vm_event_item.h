@@ -22,12 +22,27 @@
 
 #define FOR_ALL_ZONES(xx) DMA_ZONE(xx) DMA32_ZONE(xx) xx##_NORMAL, HIGHMEM_ZONE(xx) xx##_MOVABLE
 
+/* One per pcp list order: 0..PAGE_ALLOC_COSTLY_ORDER, plus THP if configured */
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define PCP_THP_ORDER(xx) , xx##_THP
+#else
+#define PCP_THP_ORDER(xx)
+#endif
+
+#define FOR_ALL_PCP_ORDERS(xx) xx##_ORDER0, xx##_ORDER1, xx##_ORDER2, \
+			       xx##_ORDER3 PCP_THP_ORDER(xx)
+#define FOR_ALL_PCP_HIGH_ORDERS(xx) xx##_ORDER1, xx##_ORDER2, \
+				    xx##_ORDER3 PCP_THP_ORDER(xx)
+
 enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(PGALLOC),
 		FOR_ALL_ZONES(ALLOCSTALL),
 		FOR_ALL_ZONES(PGSCAN_SKIP),
+		FOR_ALL_PCP_ORDERS(PCP_HIT),
+		FOR_ALL_PCP_ORDERS(PCP_MISS),
 		PGFREE, PGACTIVATE, PGDEACTIVATE, PGLAZYFREE,
 		PGFAULT, PGMAJFAULT,
+		FAULT_AROUND, FAULT_AROUND_HIT, FAULT_AROUND_PAGES,
 		PGLAZYFREED,
 		PGREFILL,
 		PGREUSE,
@@ -42,6 +57,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGSCAN_FILE,
 		PGSTEAL_ANON,
 		PGSTEAL_FILE,
+		PGREADAHEAD,
+		PGREADAHEAD_WASTED,
 #ifdef CONFIG_NUMA
 		PGSCAN_ZONE_RECLAIM_FAILED,
 #endif
@@ -69,6 +86,9 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
 		KCOMPACTD_WAKE,
 		KCOMPACTD_MIGRATE_SCANNED, KCOMPACTD_FREE_SCANNED,
+		FOR_ALL_PCP_HIGH_ORDERS(KCOMPACTD_GOAL_MIGRATED),
+		FOR_ALL_PCP_HIGH_ORDERS(KCOMPACTD_GOAL_SUCCESS),
+		KCOMPACTD_GOAL_THROTTLED,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -116,13 +136,11 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_DEBUG_TLBFLUSH
 		NR_TLB_REMOTE_FLUSH,	/* cpu tried to flush others' tlbs */
 		NR_TLB_REMOTE_FLUSH_RECEIVED,/* cpu received ipi for flush */
+		NR_TLB_REMOTE_FLUSH_LAZY,	/* ipi not sent, cpu was lazy */
+		NR_TLB_REMOTE_FLUSH_UPTODATE,	/* ipi not sent, cpu caught up */
 		NR_TLB_LOCAL_FLUSH_ALL,
 		NR_TLB_LOCAL_FLUSH_ONE,
 #endif /* CONFIG_DEBUG_TLBFLUSH */
-#ifdef CONFIG_DEBUG_VM_VMACACHE
-		VMACACHE_FIND_CALLS,
-		VMACACHE_FIND_HITS,
-#endif
 #ifdef CONFIG_SWAP
 		SWAP_RA,
 		SWAP_RA_HIT,
@@ -130,6 +148,11 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_X86
 		DIRECT_MAP_LEVEL2_SPLIT,
 		DIRECT_MAP_LEVEL3_SPLIT,
+#endif
+#ifdef CONFIG_PER_VMA_LOCK
+		VMA_LOCK_SUCCESS,
+		VMA_LOCK_ABORT,
+		VMA_LOCK_RETRY,
 #endif
 		NR_VM_EVENT_ITEMS
 };
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_VMA_TREE_H
+#define _LINUX_VMA_TREE_H
+
+#include <linux/types.h>
+#include <linux/rcupdate.h>
+
+/*
+ * B-tree index of the VMAs of an mm, keyed by vm_start, see mm/vma_tree.c.
+ *
+ * Modifications are serialized by the caller (mmap_lock held for write,
+ * or for read plus page_table_lock when a stack grows) and copy the nodes
+ * they change, so lookups can also run locklessly under rcu_read_lock().
+ */
+struct vma_tree_node;
+struct vm_area_struct;
+
+struct vma_tree {
+	struct vma_tree_node __rcu *root;
+};
+
+#define VMA_TREE_INIT	{ .root = NULL }
+
+static inline void vma_tree_init(struct vma_tree *vt)
+{
+	RCU_INIT_POINTER(vt->root, NULL);
+}
+
+void vma_tree_insert(struct vma_tree *vt, struct vm_area_struct *vma);
+void vma_tree_erase(struct vma_tree *vt, struct vm_area_struct *vma);
+void vma_tree_move(struct vma_tree *vt, struct vm_area_struct *vma,
+		   unsigned long old_start);
+struct vm_area_struct *vma_tree_find(struct vma_tree *vt, unsigned long addr);
+int vma_tree_build(struct vma_tree *vt, struct vm_area_struct *vma, int nr);
+void vma_tree_destroy(struct vma_tree *vt);
+
+#endif /* _LINUX_VMA_TREE_H */
@@ -351,6 +351,12 @@ void *xa_store(struct xarray *, unsigned long index, void *entry, gfp_t);
 void *xa_erase(struct xarray *, unsigned long index);
 void *xa_store_range(struct xarray *, unsigned long first, unsigned long last,
 			void *entry, gfp_t);
+unsigned int xa_load_bulk(struct xarray *, unsigned long index, void **dst,
+		unsigned int nr);
+int xa_store_bulk(struct xarray *, unsigned long index, void **entries,
+		unsigned int nr, gfp_t);
+void *xa_store_order(struct xarray *, unsigned long index, unsigned int order,
+		void *entry, gfp_t);
 bool xa_get_mark(struct xarray *, unsigned long index, xa_mark_t);
 void xa_set_mark(struct xarray *, unsigned long index, xa_mark_t);
 void xa_clear_mark(struct xarray *, unsigned long index, xa_mark_t);
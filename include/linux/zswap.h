@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_ZSWAP_H
+#define _LINUX_ZSWAP_H
+
+#include <linux/types.h>
+
+struct mem_cgroup;
+
+#ifdef CONFIG_ZSWAP
+
+unsigned long zswap_writeback_memcg(struct mem_cgroup *memcg,
+				    unsigned long nr_to_walk);
+
+#else
+
+static inline unsigned long zswap_writeback_memcg(struct mem_cgroup *memcg,
+						  unsigned long nr_to_walk)
+{
+	return 0;
+}
+
+#endif
+
+#endif /* _LINUX_ZSWAP_H */
@@ -142,6 +142,7 @@ struct bond_params {
 	int lp_interval;
 	int packets_per_slave;
 	int tlb_dynamic_lb;
+	int xmit_hash_stable;
 	struct reciprocal_value reciprocal_packets_per_slave;
 	u16 ad_actor_sys_prio;
 	u16 ad_user_port_key;
@@ -186,12 +187,38 @@ static inline struct slave *to_slave(struct kobject *kobj)
 	return container_of(kobj, struct slave, kobj);
 }
 
+/* Number of hash buckets the usable slaves array spreads flows over */
+#define BOND_HASH_BUCKETS	256
+
 struct bond_up_slave {
 	unsigned int	count;
 	struct rcu_head rcu;
+	/* Hash bucket to arr index, kept stable across rebuilds so that only
+	 * the flows of slaves that come or go are moved. Only built with
+	 * xmit_hash_stable, NULL otherwise.
+	 */
+	u16		*map;
 	struct slave	*arr[];
 };
 
+static inline struct slave *bond_slave_arr_get(struct bond_up_slave *slaves,
+					       u32 hash)
+{
+	unsigned int count = slaves ? READ_ONCE(slaves->count) : 0;
+	u16 idx;
+
+	if (unlikely(!count))
+		return NULL;
+
+	if (slaves->map) {
+		idx = READ_ONCE(slaves->map[hash % BOND_HASH_BUCKETS]);
+		if (likely(idx < count))
+			return slaves->arr[idx];
+	}
+
+	return slaves->arr[hash % count];
+}
+
 /*
  * Link pseudo-state only used internally by monitors
  */
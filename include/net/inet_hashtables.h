@@ -98,6 +98,12 @@ static inline struct net *ib_net(struct inet_bind_bucket *ib)
 #define inet_bind_bucket_for_each(tb, head) \
 	hlist_for_each_entry(tb, head, node)
 
+/* bind_bucket_cachep is SLAB_TYPESAFE_BY_RCU: a lockless walk may see a
+ * bucket being reused, so it can only be used as a hint.
+ */
+#define inet_bind_bucket_for_each_rcu(tb, head) \
+	hlist_for_each_entry_rcu(tb, head, node)
+
 struct inet_bind_hashbucket {
 	spinlock_t		lock;
 	struct hlist_head	chain;
@@ -412,7 +418,8 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 			struct sock *sk, u64 port_offset,
 			int (*check_established)(struct inet_timewait_death_row *,
 						 struct sock *, __u16,
-						 struct inet_timewait_sock **));
+						 struct inet_timewait_sock **,
+						 bool rcu_lookup));
 
 int inet_hash_connect(struct inet_timewait_death_row *death_row,
 		      struct sock *sk);
@@ -92,9 +92,31 @@ struct mptcp_out_options {
 #endif
 };
 
+#define MPTCP_SCHED_NAME_MAX	16
+
+struct mptcp_sock;
+
+/* Packet scheduler, picks the subflow the next chunk of data is sent on.
+ * get_subflow() is called with the msk socket lock held and returns NULL
+ * if no subflow can currently send.
+ */
+struct mptcp_sched_ops {
+	struct sock *(*get_subflow)(struct mptcp_sock *msk);
+
+	char			name[MPTCP_SCHED_NAME_MAX];
+	struct module		*owner;
+	struct list_head	list;
+
+	void (*init)(struct mptcp_sock *msk);
+	void (*release)(struct mptcp_sock *msk);
+};
+
 #ifdef CONFIG_MPTCP
 extern struct request_sock_ops mptcp_subflow_request_sock_ops;
 
+int mptcp_register_scheduler(struct mptcp_sched_ops *sched);
+void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched);
+
 void mptcp_init(void);
 
 static inline bool sk_is_mptcp(const struct sock *sk)
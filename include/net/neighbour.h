@@ -124,12 +124,15 @@ struct neigh_statistics {
 
 	unsigned long periodic_gc_runs;	/* number of periodic GC runs */
 	unsigned long forced_gc_runs;	/* number of forced GC runs */
+	unsigned long periodic_gc_usecs; /* time spent in periodic GC */
 
 	unsigned long unres_discards;	/* number of unresolved drops */
 	unsigned long table_fulls;      /* times even gc couldn't help */
 };
 
 #define NEIGH_CACHE_STAT_INC(tbl, field) this_cpu_inc((tbl)->stats->field)
+#define NEIGH_CACHE_STAT_ADD(tbl, field, val) \
+	this_cpu_add((tbl)->stats->field, val)
 
 struct neighbour {
 	struct neighbour __rcu	*next;
@@ -223,6 +226,7 @@ struct neigh_table {
 	struct list_head	gc_list;
 	rwlock_t		lock;
 	unsigned long		last_rand;
+	unsigned int		gc_bucket;	/* next bucket for periodic GC */
 	struct neigh_statistics	__percpu *stats;
 	struct neigh_hash_table __rcu *nht;
 	struct pneigh_entry	**phash_buckets;
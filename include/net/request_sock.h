@@ -167,6 +167,10 @@ struct fastopen_queue {
  *
  * @rskq_accept_head - FIFO head of established children
  * @rskq_accept_tail - FIFO tail of established children
+ * @rskq_accept_batch - children moved off the FIFO by accept(), protected
+ *		       by the listener socket lock
+ * @rskq_batch_taken - children accepted from the batch and still counted
+ *		       in sk_ack_backlog
  * @rskq_defer_accept - User waits for some data after accept()
  *
  */
@@ -180,6 +184,8 @@ struct request_sock_queue {
 
 	struct request_sock	*rskq_accept_head;
 	struct request_sock	*rskq_accept_tail;
+	struct request_sock	*rskq_accept_batch;
+	u32			rskq_batch_taken;
 	struct fastopen_queue	fastopenq;  /* Check max_qlen != 0 to determine
 					     * if TFO is enabled.
 					     */
@@ -192,23 +198,41 @@ void reqsk_fastopen_remove(struct sock *sk, struct request_sock *req,
 
 static inline bool reqsk_queue_empty(const struct request_sock_queue *queue)
 {
-	return READ_ONCE(queue->rskq_accept_head) == NULL;
+	return READ_ONCE(queue->rskq_accept_batch) == NULL &&
+	       READ_ONCE(queue->rskq_accept_head) == NULL;
 }
 
+/*
+ * Called with the listener socket lock held.  Instead of taking rskq_lock,
+ * which the softirq adding children also needs, for every child, take the
+ * whole FIFO at once and hand it out from rskq_accept_batch.  sk_ack_backlog
+ * is only updated under rskq_lock, once the batch is used up.
+ */
 static inline struct request_sock *reqsk_queue_remove(struct request_sock_queue *queue,
 						      struct sock *parent)
 {
-	struct request_sock *req;
+	struct request_sock *req = queue->rskq_accept_batch;
+
+	if (!req) {
+		spin_lock_bh(&queue->rskq_lock);
+		req = queue->rskq_accept_head;
+		WRITE_ONCE(queue->rskq_accept_head, NULL);
+		queue->rskq_accept_tail = NULL;
+		spin_unlock_bh(&queue->rskq_lock);
+		if (!req)
+			return NULL;
+	}
+
+	WRITE_ONCE(queue->rskq_accept_batch, req->dl_next);
+	queue->rskq_batch_taken++;
 
-	spin_lock_bh(&queue->rskq_lock);
-	req = queue->rskq_accept_head;
-	if (req) {
-		sk_acceptq_removed(parent);
-		WRITE_ONCE(queue->rskq_accept_head, req->dl_next);
-		if (queue->rskq_accept_head == NULL)
-			queue->rskq_accept_tail = NULL;
+	if (!req->dl_next) {
+		spin_lock_bh(&queue->rskq_lock);
+		WRITE_ONCE(parent->sk_ack_backlog,
+			   parent->sk_ack_backlog - queue->rskq_batch_taken);
+		spin_unlock_bh(&queue->rskq_lock);
+		queue->rskq_batch_taken = 0;
 	}
-	spin_unlock_bh(&queue->rskq_lock);
 	return req;
 }
 
@@ -1604,7 +1604,7 @@ static inline void sk_wmem_free_skb(struct sock *sk, struct sk_buff *skb)
 		sk->sk_tx_skb_cache = skb;
 		return;
 	}
-	__kfree_skb(skb);
+	__kfree_skb_cached(skb);
 }
 
 static inline void sock_release_ownership(struct sock *sk)
@@ -273,6 +273,8 @@ static inline bool udp_sk_bound_dev_eq(struct net *net, int bound_dev_if,
 void udp_destruct_sock(struct sock *sk);
 void skb_consume_udp(struct sock *sk, struct sk_buff *skb, int len);
 int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb);
+bool udp_batch_begin(struct sock *sk);
+void udp_batch_end(struct sock *sk);
 void udp_skb_destructor(struct sock *sk, struct sk_buff *skb);
 struct sk_buff *__skb_recv_udp(struct sock *sk, unsigned int flags,
 			       int noblock, int *off, int *err);
@@ -59,6 +59,8 @@ struct xdp_sock {
 
 	struct xsk_queue *tx ____cacheline_aligned_in_smp;
 	struct list_head tx_list;
+	/* Frames sent per sendmsg() in copy mode */
+	u32 max_tx_budget;
 	/* Protects generic receive. */
 	spinlock_t rx_lock;
 
@@ -155,8 +155,13 @@ static inline bool xp_desc_crosses_non_contig_pg(struct xsk_buff_pool *pool,
 		return false;
 
 	if (pool->dma_pages_cnt) {
-		return !(pool->dma_pages[addr >> PAGE_SHIFT] &
-			 XSK_NEXT_PG_CONTIG_MASK);
+		u64 pg = addr >> PAGE_SHIFT, last = (addr + len - 1) >> PAGE_SHIFT;
+
+		/* Chunks larger than a page can span more than two pages */
+		for (; pg < last; pg++)
+			if (!(pool->dma_pages[pg] & XSK_NEXT_PG_CONTIG_MASK))
+				return true;
+		return false;
 	}
 
 	/* skb path */
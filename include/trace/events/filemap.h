@@ -110,6 +110,45 @@ TRACE_EVENT(file_check_and_advance_wb_err,
 			MINOR(__entry->s_dev), __entry->i_ino, __entry->old,
 			__entry->new)
 );
+
+TRACE_EVENT(mm_filemap_readahead,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t index, pgoff_t start,
+		 unsigned long size, unsigned long async_size,
+		 unsigned long max_pages, const char *reason),
+
+	TP_ARGS(mapping, index, start, size, async_size, max_pages, reason),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, i_ino)
+		__field(dev_t, s_dev)
+		__field(pgoff_t, index)
+		__field(pgoff_t, start)
+		__field(unsigned long, size)
+		__field(unsigned long, async_size)
+		__field(unsigned long, max_pages)
+		__string(reason, reason)
+	),
+
+	TP_fast_assign(
+		__entry->i_ino = mapping->host->i_ino;
+		if (mapping->host->i_sb)
+			__entry->s_dev = mapping->host->i_sb->s_dev;
+		else
+			__entry->s_dev = mapping->host->i_rdev;
+		__entry->index = index;
+		__entry->start = start;
+		__entry->size = size;
+		__entry->async_size = async_size;
+		__entry->max_pages = max_pages;
+		__assign_str(reason, reason);
+	),
+
+	TP_printk("dev=%d:%d ino=0x%lx index=%lu start=%lu size=%lu async_size=%lu max=%lu reason=%s",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev), __entry->i_ino,
+		__entry->index, __entry->start, __entry->size,
+		__entry->async_size, __entry->max_pages, __get_str(reason))
+);
 #endif /* _TRACE_FILEMAP_H */
 
 /* This part must be outside protection */
@@ -8,6 +8,7 @@
 #include <linux/cpufreq.h>
 #include <linux/ktime.h>
 #include <linux/pm_qos.h>
+#include <linux/sched/cpufreq.h>
 #include <linux/tracepoint.h>
 #include <linux/trace_events.h>
 
@@ -173,6 +174,44 @@ TRACE_EVENT(cpu_frequency_limits,
 		  (unsigned long)__entry->cpu_id)
 );
 
+/*
+ * A schedutil frequency decision: @freq is the target frequency, or 0 when
+ * the driver was handed a performance level (adjust_perf) instead.
+ */
+TRACE_EVENT(sugov_update_freq,
+
+	TP_PROTO(unsigned int cpu, unsigned long util, unsigned long max,
+		 unsigned int freq, unsigned int reason),
+
+	TP_ARGS(cpu, util, max, freq, reason),
+
+	TP_STRUCT__entry(
+		__field(u32,		cpu_id)
+		__field(unsigned long,	util)
+		__field(unsigned long,	max)
+		__field(u32,		freq)
+		__field(u32,		reason)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu;
+		__entry->util = util;
+		__entry->max = max;
+		__entry->freq = freq;
+		__entry->reason = reason;
+	),
+
+	TP_printk("cpu_id=%lu util=%lu max=%lu freq=%lu reason=%s",
+		  (unsigned long)__entry->cpu_id, __entry->util, __entry->max,
+		  (unsigned long)__entry->freq,
+		  __print_flags(__entry->reason, "|",
+				{ SUGOV_REASON_UTIL,		"util" },
+				{ SUGOV_REASON_IOWAIT,		"iowait" },
+				{ SUGOV_REASON_WAKE_BOOST,	"wake_boost" },
+				{ SUGOV_REASON_LIMITS,		"limits" },
+				{ SUGOV_REASON_BUSY,		"busy" }))
+);
+
 TRACE_EVENT(device_pm_callback_start,
 
 	TP_PROTO(struct device *dev, const char *pm_ops, int event),
@@ -91,6 +91,20 @@ union bpf_iter_link_info {
 	struct {
 		__u32	map_fd;
 	} map;
+	/* task, task_file and task_vma iterators */
+	struct {
+		__u32	tid_start;	/* first tid to visit */
+		__u32	tid_end;	/* last tid to visit, 0 for no limit */
+		__u32	cgroup_fd;	/* only tasks in this cgroup v2 subtree */
+		__u32	flags;		/* BPF_ITER_TASK_* flags */
+	} task;
+};
+
+enum {
+	/* task_vma only: skip processes whose address space did not change
+	 * since the last complete walk through the same link started.
+	 */
+	BPF_ITER_TASK_VMA_SKIP_UNCHANGED	= (1U << 0),
 };
 
 /* BPF syscall commands, see bpf(2) man-page for more details. */
@@ -1210,6 +1224,12 @@ enum {
 
 /* Create a map that is suitable to be an inner map with dynamic max entries */
 	BPF_F_INNER_MAP		= (1U << 12),
+
+/* Build a multibit lookup table for LPM_TRIE maps */
+	BPF_F_LPM_STRIDE	= (1U << 13),
+
+/* Coalesce ring buffer consumer wakeups by fill level or time */
+	BPF_F_RB_WAKEUP_COALESCE = (1U << 14),
 };
 
 /* Flags for BPF_PROG_QUERY. */
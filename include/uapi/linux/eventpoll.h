@@ -18,6 +18,7 @@
 /* For O_CLOEXEC */
 #include <linux/fcntl.h>
 #include <linux/types.h>
+#include <linux/ioctl.h>
 
 /* Flags for epoll_create1.  */
 #define EPOLL_CLOEXEC O_CLOEXEC
@@ -79,6 +80,48 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/*
+ * Event ring set up with EPIOCSRING and mapped with mmap(2) at offset 0 of
+ * the epoll file. Once set up, epoll_wait(2) ignores its events argument and
+ * instead appends ready events at ->tail, returning how many were added.
+ * The application consumes entries and advances ->head. If the ring is full,
+ * epoll_wait(2) fails with ENOBUFS and events stay queued in the kernel.
+ */
+struct epoll_ring {
+	__u32 head;		/* written by the application */
+	__u32 tail;		/* written by the kernel */
+	__u32 mask;		/* number of entries - 1 */
+	__u32 resv;
+	struct epoll_event events[];
+};
+
+struct epoll_ring_params {
+	__u32 entries;		/* in: minimum entries, out: actual entries */
+	__u32 flags;
+	__u32 ring_size;	/* out: bytes to mmap */
+	__u32 resv[5];
+};
+
+/*
+ * Per-instance busy poll settings. A non-zero busy_poll_usecs enables busy
+ * polling of the NAPI contexts of the watched sockets regardless of the
+ * net.core.busy_poll sysctl. A budget above the NAPI weight requires
+ * CAP_NET_ADMIN, zero selects the default.
+ */
+struct epoll_params {
+	__u32 busy_poll_usecs;
+	__u16 busy_poll_budget;
+	__u8 prefer_busy_poll;
+
+	/* pad the struct to a multiple of 64bits */
+	__u8 __pad;
+};
+
+#define EPOLL_IOC_TYPE	0x8A
+#define EPIOCSRING	_IOWR(EPOLL_IOC_TYPE, 0x01, struct epoll_ring_params)
+#define EPIOCSPARAMS	_IOW(EPOLL_IOC_TYPE, 0x02, struct epoll_params)
+#define EPIOCGPARAMS	_IOR(EPOLL_IOC_TYPE, 0x03, struct epoll_params)
+
 #ifdef CONFIG_PM_SLEEP
 static inline void ep_take_care_of_epollwakeup(struct epoll_event *epev)
 {
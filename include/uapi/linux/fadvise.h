@@ -19,4 +19,11 @@
 #define POSIX_FADV_NOREUSE	5 /* Data will be accessed once.  */
 #endif
 
+/*
+ * Linux specific, numbered like MADV_[NO]HUGEPAGE: back the whole file with
+ * huge pages where the filesystem supports it (currently tmpfs), or never.
+ */
+#define POSIX_FADV_HUGEPAGE	14 /* Use huge pages for this file.  */
+#define POSIX_FADV_NOHUGEPAGE	15 /* Never use huge pages for it.  */
+
 #endif	/* FADVISE_H_INCLUDED */
@@ -61,6 +61,10 @@
 #define TUNSETFILTEREBPF _IOR('T', 225, int)
 #define TUNSETCARRIER _IOW('T', 226, int)
 #define TUNGETDEVNETNS _IO('T', 227)
+/* Out-of-tree: numbers from 240 up are kept clear of the upstream range.
+ * With TUNSETWRITEBATCH set, each iovec of a write() carries one packet.
+ */
+#define TUNSETWRITEBATCH _IOW('T', 240, int)
 
 /* TUNSETIFF ifr flags */
 #define IFF_TUN		0x0001
@@ -63,6 +63,11 @@ struct xdp_mmap_offsets {
 #define XDP_UMEM_COMPLETION_RING	6
 #define XDP_STATISTICS			7
 #define XDP_OPTIONS			8
+/* Number of frames one sendto() sends in copy mode, from 32 up to the size
+ * of the Tx ring. Copy mode has no kernel Tx poller, every batch still
+ * needs a sendto().
+ */
+#define XDP_MAX_TX_SKB_BUDGET		9
 
 struct xdp_umem_reg {
 	__u64 addr; /* Start of packet data area */
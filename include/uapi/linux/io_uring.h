@@ -63,6 +63,15 @@ struct io_uring_sqe {
 	__u64	__pad2[2];
 };
 
+/*
+ * If sqe->file_index is set to this for opcodes that instantiate a new
+ * direct descriptor (like openat/openat2/accept/socket), then io_uring will
+ * allocate an available direct descriptor instead of having the application
+ * pass one in. The picked direct descriptor will be returned in cqe->res,
+ * or -ENFILE if the table has no free slot.
+ */
+#define IORING_FILE_INDEX_ALLOC		(~0U)
+
 enum {
 	IOSQE_FIXED_FILE_BIT,
 	IOSQE_IO_DRAIN_BIT,
@@ -98,6 +107,12 @@ enum {
 #define IORING_SETUP_CLAMP	(1U << 4)	/* clamp SQ/CQ ring sizes */
 #define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq */
 #define IORING_SETUP_R_DISABLED	(1U << 6)	/* start with ring disabled */
+/*
+ * Defer all completion task_work to the ring creator, it runs only when the
+ * task enters io_uring_enter() for submission or waiting. Only the creating
+ * task may submit.
+ */
+#define IORING_SETUP_DEFER_TASKRUN	(1U << 7)
 
 enum {
 	IORING_OP_NOP,
@@ -140,6 +155,8 @@ enum {
 	IORING_OP_MKDIRAT,
 	IORING_OP_SYMLINKAT,
 	IORING_OP_LINKAT,
+	IORING_OP_SEND_ZC,
+	IORING_OP_SOCKET,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -181,6 +198,24 @@ enum {
 #define IORING_POLL_UPDATE_EVENTS	(1U << 1)
 #define IORING_POLL_UPDATE_USER_DATA	(1U << 2)
 
+/*
+ * send/recv flags, stored in sqe->ioprio
+ *
+ * IORING_RECV_MULTISHOT	Multishot recv. Each completion picks its own
+ *				provided buffer and sets IORING_CQE_F_MORE as
+ *				long as the request stays armed.
+ */
+#define IORING_RECV_MULTISHOT	(1U << 1)
+
+/*
+ * accept flags, stored in sqe->ioprio
+ *
+ * IORING_ACCEPT_MULTISHOT	Post a CQE with IORING_CQE_F_MORE for every
+ *				accepted connection until an error or
+ *				cancelation terminates the request.
+ */
+#define IORING_ACCEPT_MULTISHOT	(1U << 0)
+
 /*
  * IO completion data structure (Completion Queue Entry)
  */
@@ -195,9 +230,12 @@ struct io_uring_cqe {
  *
  * IORING_CQE_F_BUFFER	If set, the upper 16 bits are the buffer ID
  * IORING_CQE_F_MORE	If set, parent SQE will generate more CQE entries
+ * IORING_CQE_F_NOTIF	Notification CQE, the buffer of a zerocopy send
+ *			may be reused
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
 #define IORING_CQE_F_MORE		(1U << 1)
+#define IORING_CQE_F_NOTIF		(1U << 2)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -269,7 +307,8 @@ struct io_uring_params {
 	__u32 sq_thread_idle;
 	__u32 features;
 	__u32 wq_fd;
-	__u32 resv[3];
+	__u32 sq_thread_weight;
+	__u32 resv[2];
 	struct io_sqring_offsets sq_off;
 	struct io_cqring_offsets cq_off;
 };
@@ -320,6 +359,10 @@ enum {
 	/* set/get max number of io-wq workers */
 	IORING_REGISTER_IOWQ_MAX_WORKERS	= 19,
 
+	/* register/unregister ring-mapped provided buffers */
+	IORING_REGISTER_PBUF_RING		= 20,
+	IORING_UNREGISTER_PBUF_RING		= 21,
+
 	/* this goes last */
 	IORING_REGISTER_LAST
 };
@@ -410,6 +453,44 @@ enum {
 	IORING_RESTRICTION_LAST
 };
 
+struct io_uring_buf {
+	__u64	addr;
+	__u32	len;
+	__u16	bid;
+	__u16	resv;
+};
+
+/*
+ * Ring of provided buffers, shared with the kernel. The application adds
+ * buffers by filling in the entry at (tail & (ring_entries - 1)) and then
+ * bumping tail with a release store; the kernel consumes from its private
+ * head as buffers are selected.
+ */
+struct io_uring_buf_ring {
+	union {
+		/*
+		 * To avoid spilling into more pages than we need to, the
+		 * ring tail is overlaid with the io_uring_buf->resv field.
+		 */
+		struct {
+			__u64	resv1;
+			__u32	resv2;
+			__u16	resv3;
+			__u16	tail;
+		};
+		struct io_uring_buf	bufs[0];
+	};
+};
+
+/* argument for IORING_(UN)REGISTER_PBUF_RING */
+struct io_uring_buf_reg {
+	__u64	ring_addr;
+	__u32	ring_entries;
+	__u16	bgid;
+	__u16	pad;
+	__u64	resv[3];
+};
+
 struct io_uring_getevents_arg {
 	__u64	sigmask;
 	__u32	sigmask_sz;
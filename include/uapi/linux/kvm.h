@@ -1112,6 +1112,11 @@ struct kvm_ppc_resize_hpt {
 #define KVM_CAP_BINARY_STATS_FD 203
 #define KVM_CAP_EXIT_ON_EMULATION_FAILURE 204
 #define KVM_CAP_ARM_MTE 205
+/*
+ * Out-of-tree: kept well past the upstream range so that later upstream
+ * capabilities can't collide with it.
+ */
+#define KVM_CAP_DIRTY_LOG_RING_VCPU_RESET 0x10000
 
 #ifdef KVM_CAP_IRQ_ROUTING
 
@@ -1624,6 +1629,11 @@ struct kvm_pv_cmd {
 
 /* Available with KVM_CAP_DIRTY_LOG_RING */
 #define KVM_RESET_DIRTY_RINGS		_IO(KVMIO, 0xc7)
+/*
+ * Available with KVM_CAP_DIRTY_LOG_RING_VCPU_RESET, on the vcpu fd.
+ * Out-of-tree: 0xff is kept clear of the upstream ioctl numbers.
+ */
+#define KVM_RESET_DIRTY_RING		_IO(KVMIO, 0xff)
 
 /* Per-VM Xen attributes */
 #define KVM_XEN_HVM_GET_ATTR	_IOWR(KVMIO, 0xc8, struct kvm_xen_hvm_attr)
@@ -1881,6 +1891,9 @@ struct kvm_hyperv_eventfd {
 #define KVM_DIRTY_LOG_MANUAL_PROTECT_ENABLE    (1 << 0)
 #define KVM_DIRTY_LOG_INITIALLY_SET            (1 << 1)
 
+/* KVM_CAP_HALT_POLL flags, args[1] is the wakeup percentile to poll for */
+#define KVM_HALT_POLL_ADAPTIVE                 (1 << 0)
+
 /*
  * Arch needs to define the macro after implementing the dirty ring
  * feature.  KVM_DIRTY_LOG_PAGE_OFFSET should be defined as the
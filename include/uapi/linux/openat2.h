@@ -40,4 +40,16 @@ struct open_how {
 					return -EAGAIN if that's not
 					possible. */
 
+/*
+ * One name for openat_many(2), opened relative to the dirfd of the call as
+ * openat2(2) would with @how.  The new fd or a negative errno is stored in
+ * @result.
+ */
+struct open_many_entry {
+	__u64 name;		/* const char * */
+	struct open_how how;
+	__s32 result;
+	__u32 __reserved;	/* Must be zero */
+};
+
 #endif /* _UAPI_LINUX_OPENAT2_H */
@@ -435,6 +435,9 @@ enum {
 	TCA_HTB_CEIL64,
 	TCA_HTB_PAD,
 	TCA_HTB_OFFLOAD,
+	TCA_HTB_SHARED_GROUP,	/* u32, group of HTBs sharing a rate */
+	TCA_HTB_SHARED_RATE64,	/* u64, bytes per second */
+	TCA_HTB_SHARED_BURST,	/* u32, bytes */
 	__TCA_HTB_MAX,
 };
 
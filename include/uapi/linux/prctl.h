@@ -269,4 +269,12 @@ struct prctl_mm_map {
 # define PR_SCHED_CORE_SHARE_FROM	3 /* pull core_sched cookie to pid */
 # define PR_SCHED_CORE_MAX		4
 
+/* Let KSM merge all eligible mappings of the process */
+#define PR_SET_MEMORY_MERGE		67
+#define PR_GET_MEMORY_MERGE		68
+
+/* Share the page tables of private anonymous memory with forked children */
+#define PR_SET_FORK_SHARED_PTES		69
+#define PR_GET_FORK_SHARED_PTES		70
+
 #endif /* _LINUX_PRCTL_H */
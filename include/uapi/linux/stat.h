@@ -155,6 +155,17 @@ struct statx {
 
 #define STATX__RESERVED		0x80000000U	/* Reserved for future struct statx expansion */
 
+/*
+ * One name for statx_many(2), looked up relative to the dirfd of the call.
+ * The outcome of statx(2) for it is stored in @result, 0 or a negative errno.
+ */
+struct statx_many_entry {
+	__u64	name;		/* const char * */
+	__u64	buf;		/* struct statx * */
+	__s32	result;
+	__u32	__reserved;	/* Must be zero */
+};
+
 #ifndef __KERNEL__
 /*
  * This is deprecated, and shall remain the same value in the future.  To avoid
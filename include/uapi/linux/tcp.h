@@ -128,6 +128,7 @@ enum {
 #define TCP_CM_INQ		TCP_INQ
 
 #define TCP_TX_DELAY		37	/* delay outgoing packets by XX usec */
+#define TCP_PACING_HORIZON	38	/* max usecs EDT may schedule ahead */
 
 
 #define TCP_REPAIR_ON		1
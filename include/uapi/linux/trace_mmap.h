@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _TRACE_MMAP_H_
+#define _TRACE_MMAP_H_
+
+#include <linux/types.h>
+
+/**
+ * struct trace_buffer_meta - Ring-buffer Meta-page description
+ * @meta_page_size:	Size of this meta-page.
+ * @meta_struct_len:	Size of this structure.
+ * @subbuf_size:	Size of each sub-buffer, header included.
+ * @nr_subbufs:		Number of sub-buffers in the ring-buffer, including
+ *			the reader one.
+ * @reader.lost_events:	Number of events lost before the reader sub-buffer.
+ * @reader.id:		ID of the sub-buffer currently owned by the reader.
+ * @reader.read:	Offset, in the data part of the sub-buffer, of the
+ *			first event not consumed yet.
+ * @reader.commit:	End of the data the reader may consume. Consumed by
+ *			the next TRACE_MMAP_IOCTL_GET_READER.
+ * @flags:		Reserved, 0 for now.
+ * @entries:		Number of entries in the ring-buffer.
+ * @overrun:		Number of entries lost in the ring-buffer.
+ * @read:		Number of entries that have been read.
+ *
+ * The meta-page is mapped at offset 0, sub-buffer ID n at page n + 1. Each
+ * sub-buffer starts with a u64 time stamp and a long commit field, followed
+ * by the events.
+ */
+struct trace_buffer_meta {
+	__u32		meta_page_size;
+	__u32		meta_struct_len;
+
+	__u32		subbuf_size;
+	__u32		nr_subbufs;
+
+	struct {
+		__u64	lost_events;
+		__u32	id;
+		__u32	read;
+		__u32	commit;
+		__u32	__reserved;
+	} reader;
+
+	__u64	flags;
+
+	__u64	entries;
+	__u64	overrun;
+	__u64	read;
+};
+
+/*
+ * Consume [reader.read, reader.commit) and make the next events available,
+ * either further on the same sub-buffer or on a newly swapped one.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('R', 0x20)
+
+#endif /* _TRACE_MMAP_H_ */
@@ -32,7 +32,8 @@
 			   UFFD_FEATURE_SIGBUS |		\
 			   UFFD_FEATURE_THREAD_ID |		\
 			   UFFD_FEATURE_MINOR_HUGETLBFS |	\
-			   UFFD_FEATURE_MINOR_SHMEM)
+			   UFFD_FEATURE_MINOR_SHMEM |		\
+			   UFFD_FEATURE_WP_HUGETLBFS)
 #define UFFD_API_IOCTLS				\
 	((__u64)1 << _UFFDIO_REGISTER |		\
 	 (__u64)1 << _UFFDIO_UNREGISTER |	\
@@ -42,11 +43,16 @@
 	 (__u64)1 << _UFFDIO_COPY |		\
 	 (__u64)1 << _UFFDIO_ZEROPAGE |		\
 	 (__u64)1 << _UFFDIO_WRITEPROTECT |	\
-	 (__u64)1 << _UFFDIO_CONTINUE)
+	 (__u64)1 << _UFFDIO_CONTINUE |		\
+	 (__u64)1 << _UFFDIO_COPY_VEC |		\
+	 (__u64)1 << _UFFDIO_CONTINUE_VEC)
 #define UFFD_API_RANGE_IOCTLS_BASIC		\
 	((__u64)1 << _UFFDIO_WAKE |		\
 	 (__u64)1 << _UFFDIO_COPY |		\
-	 (__u64)1 << _UFFDIO_CONTINUE)
+	 (__u64)1 << _UFFDIO_WRITEPROTECT |	\
+	 (__u64)1 << _UFFDIO_CONTINUE |		\
+	 (__u64)1 << _UFFDIO_COPY_VEC |		\
+	 (__u64)1 << _UFFDIO_CONTINUE_VEC)
 
 /*
  * Valid ioctl command number range with this API is from 0x00 to
@@ -63,6 +69,8 @@
 #define _UFFDIO_ZEROPAGE		(0x04)
 #define _UFFDIO_WRITEPROTECT		(0x06)
 #define _UFFDIO_CONTINUE		(0x07)
+#define _UFFDIO_COPY_VEC		(0x08)
+#define _UFFDIO_CONTINUE_VEC		(0x09)
 #define _UFFDIO_API			(0x3F)
 
 /* userfaultfd ioctl ids */
@@ -83,6 +91,10 @@
 				      struct uffdio_writeprotect)
 #define UFFDIO_CONTINUE		_IOWR(UFFDIO, _UFFDIO_CONTINUE,	\
 				      struct uffdio_continue)
+#define UFFDIO_COPY_VEC		_IOWR(UFFDIO, _UFFDIO_COPY_VEC,	\
+				      struct uffdio_vec)
+#define UFFDIO_CONTINUE_VEC	_IOWR(UFFDIO, _UFFDIO_CONTINUE_VEC, \
+				      struct uffdio_vec)
 
 /* read() structure */
 struct uffd_msg {
@@ -189,6 +201,12 @@ struct uffdio_api {
 	 *
 	 * UFFD_FEATURE_MINOR_SHMEM indicates the same support as
 	 * UFFD_FEATURE_MINOR_HUGETLBFS, but for shmem-backed pages instead.
+	 *
+	 * UFFD_FEATURE_WP_HUGETLBFS indicates that UFFDIO_REGISTER_MODE_WP
+	 * and UFFDIO_WRITEPROTECT are supported on hugetlbfs-backed
+	 * ranges, both private and shared.  Only huge pages that are mapped
+	 * can be write protected, a range that is not populated yet has to
+	 * be filled with UFFDIO_COPY_MODE_WP to start out protected.
 	 */
 #define UFFD_FEATURE_PAGEFAULT_FLAG_WP		(1<<0)
 #define UFFD_FEATURE_EVENT_FORK			(1<<1)
@@ -201,6 +219,7 @@ struct uffdio_api {
 #define UFFD_FEATURE_THREAD_ID			(1<<8)
 #define UFFD_FEATURE_MINOR_HUGETLBFS		(1<<9)
 #define UFFD_FEATURE_MINOR_SHMEM		(1<<10)
+#define UFFD_FEATURE_WP_HUGETLBFS		(1<<11)
 	__u64 features;
 
 	__u64 ioctls;
@@ -290,6 +309,41 @@ struct uffdio_continue {
 	__s64 mapped;
 };
 
+/*
+ * One range of a UFFDIO_COPY_VEC or UFFDIO_CONTINUE_VEC request, with the
+ * same meaning as the fields of struct uffdio_copy.  "src" is ignored by
+ * UFFDIO_CONTINUE_VEC.
+ */
+struct uffdio_iovec {
+	__u64 dst;
+	__u64 src;
+	__u64 len;
+};
+
+/*
+ * Resolve up to UFFDIO_VEC_MAX discontiguous ranges with a single ioctl.
+ * "mode" takes the UFFDIO_COPY_MODE_* or UFFDIO_CONTINUE_MODE_* flags of
+ * the respective single range ioctl and applies to all the ranges.  The
+ * ranges are resolved in order and the faulting threads of each one are
+ * woken up as soon as it is resolved, unless DONTWAKE is set.
+ */
+#define UFFDIO_VEC_MAX				1024
+
+struct uffdio_vec {
+	__u64 iov;
+	__u64 nr_iov;
+	__u64 mode;
+
+	/*
+	 * "done" is written by the ioctl and must be at the end: the
+	 * copy_from_user will not read the last 8 bytes.  It is the
+	 * number of bytes resolved over all the ranges, or a negative
+	 * error if none was, just like uffdio_copy.copy.  Any range past
+	 * the resolved bytes was not touched.
+	 */
+	__s64 done;
+};
+
 /*
  * Flags for the userfaultfd(2) system call itself.
  */
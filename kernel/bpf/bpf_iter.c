@@ -5,6 +5,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/filter.h>
 #include <linux/bpf.h>
+#include <linux/rcupdate_trace.h>
 
 struct bpf_iter_target_info {
 	struct list_head list;
@@ -22,6 +23,8 @@ struct bpf_iter_priv_data {
 	struct bpf_iter_target_info *tinfo;
 	const struct bpf_iter_seq_info *seq_info;
 	struct bpf_prog *prog;
+	/* keeps link->aux alive for init_seq_private() users */
+	struct bpf_link *link;
 	u64 session_id;
 	u64 seq_num;
 	bool done_stop;
@@ -266,6 +269,7 @@ static int iter_release(struct inode *inode, struct file *file)
 		iter_priv->seq_info->fini_seq_private(seq->private);
 
 	bpf_prog_put(iter_priv->prog);
+	bpf_link_put(iter_priv->link);
 	seq->private = iter_priv;
 
 	return seq_release_private(inode, file);
@@ -539,6 +543,11 @@ int bpf_iter_link_attach(const union bpf_attr *attr, bpfptr_t uattr,
 	if (!existed)
 		return -ENOENT;
 
+	/* Most targets hold spinlocks or RCU across ->show() */
+	if (prog->aux->sleepable &&
+	    !(tinfo->reg_info->feature & BPF_ITER_SLEEPABLE))
+		return -EINVAL;
+
 	link = kzalloc(sizeof(*link), GFP_USER | __GFP_NOWARN);
 	if (!link)
 		return -ENOMEM;
@@ -608,6 +617,8 @@ static int prepare_seq_file(struct file *file, struct bpf_iter_link *link,
 	}
 
 	init_seq_meta(priv_data, tinfo, seq_info, prog);
+	bpf_link_inc(&link->link);
+	priv_data->link = &link->link;
 	seq = file->private_data;
 	seq->private = priv_data->target_private;
 
@@ -684,11 +695,20 @@ int bpf_iter_run_prog(struct bpf_prog *prog, void *ctx)
 {
 	int ret;
 
-	rcu_read_lock();
-	migrate_disable();
-	ret = bpf_prog_run(prog, ctx);
-	migrate_enable();
-	rcu_read_unlock();
+	if (prog->aux->sleepable) {
+		rcu_read_lock_trace();
+		migrate_disable();
+		might_fault();
+		ret = bpf_prog_run(prog, ctx);
+		migrate_enable();
+		rcu_read_unlock_trace();
+	} else {
+		rcu_read_lock();
+		migrate_disable();
+		ret = bpf_prog_run(prog, ctx);
+		migrate_enable();
+		rcu_read_unlock();
+	}
 
 	/* bpf program can only return 0 or 1:
 	 *  0 : okay
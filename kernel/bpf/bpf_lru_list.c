@@ -4,6 +4,8 @@
 #include <linux/cpumask.h>
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
 
 #include "bpf_lru_list.h"
 
@@ -41,7 +43,7 @@ static struct list_head *local_pending_list(struct bpf_lru_locallist *loc_l)
 /* bpf_lru_node helpers */
 static bool bpf_lru_node_is_ref(const struct bpf_lru_node *node)
 {
-	return node->ref;
+	return READ_ONCE(node->ref);
 }
 
 static void bpf_lru_list_count_inc(struct bpf_lru_list *l,
@@ -220,6 +222,7 @@ __bpf_lru_list_shrink_inactive(struct bpf_lru *lru,
 		} else if (lru->del_from_htab(lru->del_arg, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
+			l->evictions++;
 			if (++nshrinked == tgt_nshrink)
 				break;
 		}
@@ -279,6 +282,7 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 		if (lru->del_from_htab(lru->del_arg, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
+			l->evictions++;
 			return 1;
 		}
 	}
@@ -288,12 +292,13 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 
 /* Flush the nodes from the local pending list to the LRU list */
 static void __local_list_flush(struct bpf_lru_list *l,
-			       struct bpf_lru_locallist *loc_l)
+			       struct bpf_lru_locallist *loc_l, u16 shard)
 {
 	struct bpf_lru_node *node, *tmp_node;
 
 	list_for_each_entry_safe_reverse(node, tmp_node,
 					 local_pending_list(loc_l), list) {
+		node->shard = shard;
 		if (bpf_lru_node_is_ref(node))
 			__bpf_lru_node_move_in(l, node, BPF_LRU_LIST_T_ACTIVE);
 		else
@@ -315,17 +320,13 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
-static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+static unsigned int __bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+						     struct bpf_lru_list *l,
+						     struct bpf_lru_locallist *loc_l)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
-	raw_spin_lock(&l->lock);
-
-	__local_list_flush(l, loc_l);
-
 	__bpf_lru_list_rotate(lru, l);
 
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
@@ -337,11 +338,38 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 	}
 
 	if (nfree < LOCAL_FREE_TARGET)
-		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
-				      local_free_list(loc_l),
-				      BPF_LRU_LOCAL_LIST_T_FREE);
+		nfree += __bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
+					       local_free_list(loc_l),
+					       BPF_LRU_LOCAL_LIST_T_FREE);
 
-	raw_spin_unlock(&l->lock);
+	return nfree;
+}
+
+/* Refill from the shard @hash maps to, falling back to the other shards
+ * only when that one has nothing left to give.
+ */
+static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+					   struct bpf_lru_locallist *loc_l,
+					   u32 hash)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	struct bpf_lru_list *l;
+	unsigned int nfree;
+	u32 i, shard;
+
+	for (i = 0; i <= clru->shard_mask; i++) {
+		shard = (hash + i) & clru->shard_mask;
+		l = &clru->shards[shard];
+
+		raw_spin_lock(&l->lock);
+		if (!i)
+			__local_list_flush(l, loc_l, shard);
+		nfree = __bpf_lru_list_pop_free_to_local(lru, l, loc_l);
+		raw_spin_unlock(&l->lock);
+
+		if (nfree)
+			break;
+	}
 }
 
 static void __local_list_add_pending(struct bpf_lru *lru,
@@ -444,7 +472,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 	node = __local_list_pop_free(loc_l);
 	if (!node) {
-		bpf_lru_list_pop_free_to_local(lru, loc_l);
+		bpf_lru_list_pop_free_to_local(lru, loc_l, hash);
 		node = __local_list_pop_free(loc_l);
 	}
 
@@ -474,6 +502,8 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 		node = __local_list_pop_free(steal_loc_l);
 		if (!node)
 			node = __local_list_pop_pending(lru, steal_loc_l);
+		if (node)
+			steal_loc_l->steals++;
 
 		raw_spin_unlock_irqrestore(&steal_loc_l->lock, flags);
 
@@ -530,7 +560,7 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	bpf_lru_list_push_free(&lru->common_lru.shards[node->shard], node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -560,16 +590,24 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
-	u32 i;
+	struct bpf_common_lru *clru = &lru->common_lru;
+	u32 i, nr_shards = clru->shard_mask + 1;
+
+	/* Keep enough nodes in each shard for a few local list refills */
+	while (nr_shards > 1 && nr_elems < nr_shards * LOCAL_FREE_TARGET * 2)
+		nr_shards /= 2;
+	clru->shard_mask = nr_shards - 1;
 
 	for (i = 0; i < nr_elems; i++) {
 		struct bpf_lru_node *node;
+		u16 shard = i & clru->shard_mask;
 
 		node = (struct bpf_lru_node *)(buf + node_offset);
 		node->type = BPF_LRU_LIST_T_FREE;
 		node->ref = 0;
-		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
+		node->shard = shard;
+		list_add(&node->list,
+			 &clru->shards[shard].lists[BPF_LRU_LIST_T_FREE]);
 		buf += elem_size;
 	}
 }
@@ -624,6 +662,7 @@ static void bpf_lru_locallist_init(struct bpf_lru_locallist *loc_l, int cpu)
 		INIT_LIST_HEAD(&loc_l->lists[i]);
 
 	loc_l->next_steal = cpu;
+	loc_l->steals = 0;
 
 	raw_spin_lock_init(&loc_l->lock);
 }
@@ -637,6 +676,7 @@ static void bpf_lru_list_init(struct bpf_lru_list *l)
 
 	for (i = 0; i < NR_BPF_LRU_LIST_COUNT; i++)
 		l->counts[i] = 0;
+	l->evictions = 0;
 
 	l->next_inactive_rotation = &l->lists[BPF_LRU_LIST_T_INACTIVE];
 
@@ -646,6 +686,7 @@ static void bpf_lru_list_init(struct bpf_lru_list *l)
 int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		 del_from_htab_func del_from_htab, void *del_arg)
 {
+	u32 i, nr_shards;
 	int cpu;
 
 	if (percpu) {
@@ -663,9 +704,19 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 	} else {
 		struct bpf_common_lru *clru = &lru->common_lru;
 
+		nr_shards = min_t(u32, roundup_pow_of_two(num_possible_cpus()),
+				  BPF_LRU_MAX_SHARDS);
+		clru->shards = kcalloc(nr_shards, sizeof(*clru->shards),
+				       GFP_KERNEL);
+		if (!clru->shards)
+			return -ENOMEM;
+		clru->shard_mask = nr_shards - 1;
+
 		clru->local_list = alloc_percpu(struct bpf_lru_locallist);
-		if (!clru->local_list)
+		if (!clru->local_list) {
+			kfree(clru->shards);
 			return -ENOMEM;
+		}
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
@@ -674,7 +725,8 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 			bpf_lru_locallist_init(loc_l, cpu);
 		}
 
-		bpf_lru_list_init(&clru->lru_list);
+		for (i = 0; i < nr_shards; i++)
+			bpf_lru_list_init(&clru->shards[i]);
 		lru->nr_scans = LOCAL_NR_SCANS;
 	}
 
@@ -688,8 +740,33 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
 		free_percpu(lru->common_lru.local_list);
+		kfree(lru->common_lru.shards);
+	}
+}
+
+/* Racy reads, the counters are only reported to userspace */
+void bpf_lru_stats(struct bpf_lru *lru, u64 *evictions, u64 *steals)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	int cpu;
+	u32 i;
+
+	*evictions = 0;
+	*steals = 0;
+
+	if (lru->percpu) {
+		for_each_possible_cpu(cpu)
+			*evictions += READ_ONCE(per_cpu_ptr(lru->percpu_lru,
+							    cpu)->evictions);
+		return;
+	}
+
+	for (i = 0; i <= clru->shard_mask; i++)
+		*evictions += READ_ONCE(clru->shards[i].evictions);
+	for_each_possible_cpu(cpu)
+		*steals += READ_ONCE(per_cpu_ptr(clru->local_list, cpu)->steals);
 }
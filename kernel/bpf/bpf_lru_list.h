@@ -11,6 +11,7 @@
 #define NR_BPF_LRU_LIST_COUNT	(2)
 #define NR_BPF_LRU_LOCAL_LIST_T (2)
 #define BPF_LOCAL_LIST_T_OFFSET NR_BPF_LRU_LIST_T
+#define BPF_LRU_MAX_SHARDS	(16)
 
 enum bpf_lru_list_type {
 	BPF_LRU_LIST_T_ACTIVE,
@@ -25,6 +26,7 @@ struct bpf_lru_node {
 	u16 cpu;
 	u8 type;
 	u8 ref;
+	u16 shard;
 };
 
 struct bpf_lru_list {
@@ -32,6 +34,8 @@ struct bpf_lru_list {
 	unsigned int counts[NR_BPF_LRU_LIST_COUNT];
 	/* The next inactive list rotation starts from here */
 	struct list_head *next_inactive_rotation;
+	/* nodes taken off the active/inactive lists to be reused */
+	unsigned long evictions;
 
 	raw_spinlock_t lock ____cacheline_aligned_in_smp;
 };
@@ -39,11 +43,17 @@ struct bpf_lru_list {
 struct bpf_lru_locallist {
 	struct list_head lists[NR_BPF_LRU_LOCAL_LIST_T];
 	u16 next_steal;
+	/* nodes other CPUs took from this local list */
+	unsigned long steals;
 	raw_spinlock_t lock;
 };
 
 struct bpf_common_lru {
-	struct bpf_lru_list lru_list;
+	/* The global list is split in shards selected by hash, so that
+	 * CPUs refilling their local lists mostly take different locks.
+	 */
+	struct bpf_lru_list *shards;
+	u32 shard_mask;
 	struct bpf_lru_locallist __percpu *local_list;
 };
 
@@ -64,10 +74,11 @@ struct bpf_lru {
 static inline void bpf_lru_node_set_ref(struct bpf_lru_node *node)
 {
 	/* ref is an approximation on access frequency.  It does not
-	 * have to be very accurate.  Hence, no protection is used.
+	 * have to be very accurate.  Hence, no protection is used and
+	 * the cacheline is only written when the bit is not set yet.
 	 */
-	if (!node->ref)
-		node->ref = 1;
+	if (!READ_ONCE(node->ref))
+		WRITE_ONCE(node->ref, 1);
 }
 
 int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
@@ -78,5 +89,6 @@ void bpf_lru_destroy(struct bpf_lru *lru);
 struct bpf_lru_node *bpf_lru_pop_free(struct bpf_lru *lru, u32 hash);
 void bpf_lru_push_free(struct bpf_lru *lru, struct bpf_lru_node *node);
 void bpf_lru_promote(struct bpf_lru *lru, struct bpf_lru_node *node);
+void bpf_lru_stats(struct bpf_lru *lru, u64 *evictions, u64 *steals);
 
 #endif
@@ -66,6 +66,9 @@ struct bpf_cpu_map_entry {
 	struct bpf_cpumap_val value;
 	struct bpf_prog *prog;
 
+	/* Only used by the kthread, to aggregate the frames it builds */
+	struct napi_struct napi;
+
 	atomic_t refcnt; /* Control when this struct can be free'ed */
 	struct rcu_head rcu;
 
@@ -381,10 +384,16 @@ static int cpu_map_kthread_run(void *data)
 				continue;
 			}
 
-			list_add_tail(&skb->list, &list);
+			napi_gro_receive(&rcpu->napi, skb);
 		}
 		netif_receive_skb_list(&list);
 
+		/* Hold on to flows only while more frames are queued, and
+		 * at most a jiffy, like a NAPI poll loop would.
+		 */
+		napi_gro_flush_normal(&rcpu->napi,
+				      !__ptr_ring_empty(rcpu->queue));
+
 		/* Feedback loop via tracepoint */
 		trace_xdp_cpumap_kthread(rcpu->map_id, n, kmem_alloc_drops,
 					 sched, &stats);
@@ -393,6 +402,7 @@ static int cpu_map_kthread_run(void *data)
 	}
 	__set_current_state(TASK_RUNNING);
 
+	napi_gro_cleanup(&rcpu->napi);
 	put_cpu_map_entry(rcpu);
 	return 0;
 }
@@ -456,6 +466,7 @@ __cpu_map_entry_alloc(struct bpf_map *map, struct bpf_cpumap_val *value,
 	rcpu->cpu    = cpu;
 	rcpu->map_id = map->id;
 	rcpu->value.qsize  = value->qsize;
+	napi_gro_init(&rcpu->napi);
 
 	if (fd > 0 && __cpu_map_load_bpf_program(rcpu, fd))
 		goto free_ptr_ring;
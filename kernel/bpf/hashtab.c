@@ -11,6 +11,7 @@
 #include <uapi/linux/btf.h>
 #include <linux/rcupdate_trace.h>
 #include "percpu_freelist.h"
+#include "memalloc.h"
 #include "bpf_lru_list.h"
 #include "map_in_map.h"
 
@@ -97,6 +98,7 @@ struct bpf_htab {
 		struct pcpu_freelist freelist;
 		struct bpf_lru lru;
 	};
+	struct bpf_mem_alloc ma;	/* elements of !prealloc maps */
 	struct htab_elem *__percpu *extra_elems;
 	atomic_t count;	/* number of elements in this hashtable */
 	u32 n_buckets;	/* number of hash buckets */
@@ -543,6 +545,11 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 			if (err)
 				goto free_prealloc;
 		}
+	} else {
+		err = bpf_mem_alloc_init(&htab->ma, &htab->map,
+					 htab->elem_size);
+		if (err)
+			goto free_map_locked;
 	}
 
 	return &htab->map;
@@ -826,7 +833,7 @@ static void htab_elem_free(struct bpf_htab *htab, struct htab_elem *l)
 	if (htab->map.map_type == BPF_MAP_TYPE_PERCPU_HASH)
 		free_percpu(htab_elem_get_ptr(l, htab->map.key_size));
 	check_and_free_timer(htab, l);
-	kfree(l);
+	bpf_mem_cache_free(&htab->ma, l);
 }
 
 static void htab_elem_free_rcu(struct rcu_head *head)
@@ -855,10 +862,15 @@ static void free_htab_elem(struct bpf_htab *htab, struct htab_elem *l)
 	if (htab_is_prealloc(htab)) {
 		check_and_free_timer(htab, l);
 		__pcpu_freelist_push(&htab->freelist, &l->fnode);
-	} else {
+	} else if (htab_is_percpu(htab)) {
+		/* the percpu value has to outlive RCU readers as well */
 		atomic_dec(&htab->count);
 		l->htab = htab;
 		call_rcu(&l->rcu, htab_elem_free_rcu);
+	} else {
+		atomic_dec(&htab->count);
+		check_and_free_timer(htab, l);
+		bpf_mem_cache_free_rcu(&htab->ma, l);
 	}
 }
 
@@ -912,10 +924,14 @@ static bool fd_htab_map_needs_adjust(const struct bpf_htab *htab)
 	       BITS_PER_LONG == 64;
 }
 
+/* @spare, if not NULL, is used instead of allocating and only consumed on
+ * success, so that callers can allocate before taking the bucket lock.
+ */
 static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 					 void *value, u32 key_size, u32 hash,
 					 bool percpu, bool onallcpus,
-					 struct htab_elem *old_elem)
+					 struct htab_elem *old_elem,
+					 struct htab_elem *spare)
 {
 	u32 size = htab->map.value_size;
 	bool prealloc = htab_is_prealloc(htab);
@@ -950,9 +966,7 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 				l_new = ERR_PTR(-E2BIG);
 				goto dec_count;
 			}
-		l_new = bpf_map_kmalloc_node(&htab->map, htab->elem_size,
-					     GFP_ATOMIC | __GFP_NOWARN,
-					     htab->map.numa_node);
+		l_new = spare ?: bpf_mem_cache_alloc(&htab->ma);
 		if (!l_new) {
 			l_new = ERR_PTR(-ENOMEM);
 			goto dec_count;
@@ -971,7 +985,8 @@ static struct htab_elem *alloc_htab_elem(struct bpf_htab *htab, void *key,
 			pptr = bpf_map_alloc_percpu(&htab->map, size, 8,
 						    GFP_ATOMIC | __GFP_NOWARN);
 			if (!pptr) {
-				kfree(l_new);
+				if (l_new != spare)
+					bpf_mem_cache_free(&htab->ma, l_new);
 				l_new = ERR_PTR(-ENOMEM);
 				goto dec_count;
 			}
@@ -1016,7 +1031,7 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 				u64 map_flags)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
-	struct htab_elem *l_new = NULL, *l_old;
+	struct htab_elem *l_new = NULL, *l_old, *l_spare = NULL;
 	struct hlist_nulls_head *head;
 	unsigned long flags;
 	struct bucket *b;
@@ -1059,9 +1074,18 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 		 */
 	}
 
+	/* Don't hold the bucket lock across the allocation, concurrent
+	 * updates and deletes hashing to the same bucket would spin on it
+	 * meanwhile. If the element isn't needed after all it is freed below.
+	 */
+	if (!htab_is_prealloc(htab))
+		l_spare = bpf_mem_cache_alloc(&htab->ma);
+
 	ret = htab_lock_bucket(htab, b, hash, &flags);
-	if (ret)
+	if (ret) {
+		bpf_mem_cache_free(&htab->ma, l_spare);
 		return ret;
+	}
 
 	l_old = lookup_elem_raw(head, hash, key, key_size);
 
@@ -1084,7 +1108,7 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	}
 
 	l_new = alloc_htab_elem(htab, key, value, key_size, hash, false, false,
-				l_old);
+				l_old, l_spare);
 	if (IS_ERR(l_new)) {
 		/* all pre-allocated elements are in use or memory exhausted */
 		ret = PTR_ERR(l_new);
@@ -1105,6 +1129,8 @@ static int htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	ret = 0;
 err:
 	htab_unlock_bucket(htab, b, hash, flags);
+	if (l_spare && l_spare != l_new)
+		bpf_mem_cache_free(&htab->ma, l_spare);
 	return ret;
 }
 
@@ -1223,7 +1249,7 @@ static int __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
 				value, onallcpus);
 	} else {
 		l_new = alloc_htab_elem(htab, key, value, key_size,
-					hash, true, onallcpus, NULL);
+					hash, true, onallcpus, NULL, NULL);
 		if (IS_ERR(l_new)) {
 			ret = PTR_ERR(l_new);
 			goto err;
@@ -1434,6 +1460,44 @@ static void htab_map_free_timers(struct bpf_map *map)
 		htab_free_prealloced_timers(htab);
 }
 
+static u64 htab_map_mem_usage(const struct bpf_map *map)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	u32 value_size = round_up(htab->map.value_size, 8);
+	bool percpu = htab_is_percpu(htab);
+	u64 num_entries, usage;
+
+	usage = sizeof(struct bpf_htab) +
+		(u64)sizeof(struct bucket) * htab->n_buckets +
+		(u64)sizeof(int) * num_possible_cpus() * HASHTAB_MAP_LOCK_COUNT;
+
+	if (htab_is_prealloc(htab)) {
+		num_entries = htab->map.max_entries;
+		if (htab_has_extra_elems(htab)) {
+			num_entries += num_possible_cpus();
+			usage += sizeof(struct htab_elem *) * num_possible_cpus();
+		}
+		usage += htab->elem_size * num_entries;
+	} else {
+		num_entries = atomic_read(&htab->count);
+		usage += bpf_mem_alloc_usage(&htab->ma);
+	}
+	if (percpu)
+		usage += value_size * num_possible_cpus() * num_entries;
+	return usage;
+}
+
+static void htab_lru_map_show_fdinfo(const struct bpf_map *map,
+				     struct seq_file *m)
+{
+	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
+	u64 evictions, steals;
+
+	bpf_lru_stats(&htab->lru, &evictions, &steals);
+	seq_printf(m, "lru_evictions:\t%llu\n", evictions);
+	seq_printf(m, "lru_steals:\t%llu\n", steals);
+}
+
 /* Called when map->refcnt goes to zero, either from workqueue or from syscall */
 static void htab_map_free(struct bpf_map *map)
 {
@@ -1449,10 +1513,12 @@ static void htab_map_free(struct bpf_map *map)
 	 * not have executed. Wait for them.
 	 */
 	rcu_barrier();
-	if (!htab_is_prealloc(htab))
+	if (!htab_is_prealloc(htab)) {
 		delete_all_elements(htab);
-	else
+		bpf_mem_alloc_destroy(&htab->ma);
+	} else {
 		prealloc_destroy(htab);
+	}
 
 	free_percpu(htab->extra_elems);
 	bpf_map_area_free(htab->buckets);
@@ -2110,6 +2176,7 @@ const struct bpf_map_ops htab_map_ops = {
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_mem_usage = htab_map_mem_usage,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_release_uref = htab_map_free_timers,
 	.map_lookup_elem = htab_map_lookup_elem,
@@ -2132,6 +2199,7 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_mem_usage = htab_map_mem_usage,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_release_uref = htab_map_free_timers,
 	.map_lookup_elem = htab_lru_map_lookup_elem,
@@ -2141,6 +2209,7 @@ const struct bpf_map_ops htab_lru_map_ops = {
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_gen_lookup = htab_lru_map_gen_lookup,
 	.map_seq_show_elem = htab_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru),
@@ -2257,6 +2326,7 @@ const struct bpf_map_ops htab_percpu_map_ops = {
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_mem_usage = htab_map_mem_usage,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_lookup_elem = htab_percpu_map_lookup_elem,
 	.map_lookup_and_delete_elem = htab_percpu_map_lookup_and_delete_elem,
@@ -2277,12 +2347,14 @@ const struct bpf_map_ops htab_lru_percpu_map_ops = {
 	.map_alloc_check = htab_map_alloc_check,
 	.map_alloc = htab_map_alloc,
 	.map_free = htab_map_free,
+	.map_mem_usage = htab_map_mem_usage,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_lookup_elem = htab_lru_percpu_map_lookup_elem,
 	.map_lookup_and_delete_elem = htab_lru_percpu_map_lookup_and_delete_elem,
 	.map_update_elem = htab_lru_percpu_map_update_elem,
 	.map_delete_elem = htab_lru_map_delete_elem,
 	.map_seq_show_elem = htab_percpu_map_seq_show_elem,
+	.map_show_fdinfo = htab_lru_map_show_fdinfo,
 	.map_set_for_each_callback_args = map_set_for_each_callback_args,
 	.map_for_each_callback = bpf_for_each_hash_elem,
 	BATCH_OPS(htab_lru_percpu),
@@ -2416,6 +2488,7 @@ const struct bpf_map_ops htab_of_maps_map_ops = {
 	.map_alloc_check = fd_htab_map_alloc_check,
 	.map_alloc = htab_of_map_alloc,
 	.map_free = htab_of_map_free,
+	.map_mem_usage = htab_map_mem_usage,
 	.map_get_next_key = htab_map_get_next_key,
 	.map_lookup_elem = htab_of_map_lookup_elem,
 	.map_delete_elem = htab_map_delete_elem,
@@ -9,9 +9,14 @@
 #include <linux/bpf.h>
 #include <linux/btf.h>
 #include <linux/err.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/spinlock.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <net/ipv6.h>
 #include <uapi/linux/btf.h>
 
@@ -28,6 +33,26 @@ struct lpm_trie_node {
 	u8				data[];
 };
 
+/* Multibit snapshot of the trie for BPF_F_LPM_STRIDE maps, see below */
+#define LPM_STRIDE_BITS		8
+#define LPM_STRIDE_SIZE		(1U << LPM_STRIDE_BITS)
+#define LPM_STRIDE_CHILD	BIT(31)
+#define LPM_STRIDE_REBUILD_DELAY (HZ / 10)
+
+struct lpm_stride {
+	u32				gen;
+	u32				nr_tables;
+	u32				nr_leaves;
+	struct lpm_trie_node		**leaves;
+	u32				*tables;
+};
+
+struct lpm_trie_stats {
+	u64				lookups;
+	u64				depth;
+	u64				stride_lookups;
+};
+
 struct lpm_trie {
 	struct bpf_map			map;
 	struct lpm_trie_node __rcu	*root;
@@ -35,6 +60,12 @@ struct lpm_trie {
 	size_t				max_prefixlen;
 	size_t				data_size;
 	spinlock_t			lock;
+	struct lpm_trie_stats __percpu	*stats;
+	/* BPF_F_LPM_STRIDE only */
+	struct lpm_stride __rcu		*stride;
+	u32				gen;
+	u64				stride_rebuilds;
+	struct delayed_work		stride_work;
 };
 
 /* This trie implements a longest prefix match algorithm that can be used to
@@ -146,6 +177,19 @@ struct lpm_trie {
  * is a child that can be used to become more specific, the trie is traversed
  * downwards. The last node in the traversal that is a non-intermediate one is
  * returned.
+ *
+ * With BPF_F_LPM_STRIDE the trie is additionally flattened into a multibit
+ * trie with a stride of 8 bits, so a full length lookup reads one table entry
+ * per key byte instead of one scattered node per prefix bit. Every prefix is
+ * expanded into the table of the level it ends in, and the entries of a child
+ * table inherit the best match of the entry they hang off ("leaf pushing"),
+ * so the first entry that is not a child pointer is the result.
+ *
+ * The snapshot is rebuilt from a worker shortly after updates. Updates bump
+ * trie->gen under trie->lock before touching the trie, lookups only use a
+ * snapshot built for the current generation and walk the trie otherwise.
+ * Nodes referenced by a snapshot are freed via RCU after such a bump, so a
+ * reader that saw the old generation can still dereference them.
  */
 
 static inline int extract_bit(const u8 *data, size_t index)
@@ -223,17 +267,48 @@ static size_t longest_prefix_match(const struct lpm_trie *trie,
 	return prefixlen;
 }
 
+static void *lpm_stride_lookup(const struct lpm_trie *trie,
+			       const struct lpm_stride *st, const u8 *data)
+{
+	u32 ent = 0, tbl = 0, i;
+
+	for (i = 0; i < trie->data_size; i++) {
+		ent = st->tables[tbl * LPM_STRIDE_SIZE + data[i]];
+		if (!(ent & LPM_STRIDE_CHILD))
+			break;
+		tbl = ent & ~LPM_STRIDE_CHILD;
+	}
+	this_cpu_add(trie->stats->depth, i + 1);
+	this_cpu_inc(trie->stats->stride_lookups);
+
+	if (!ent || (ent & LPM_STRIDE_CHILD))
+		return NULL;
+	return st->leaves[ent - 1]->data + trie->data_size;
+}
+
 /* Called from syscall or from eBPF program */
 static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 {
 	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
 	struct lpm_trie_node *node, *found = NULL;
 	struct bpf_lpm_trie_key *key = _key;
+	unsigned int depth = 0;
+
+	this_cpu_inc(trie->stats->lookups);
+
+	if ((map->map_flags & BPF_F_LPM_STRIDE) &&
+	    key->prefixlen == trie->max_prefixlen) {
+		struct lpm_stride *st;
+
+		st = rcu_dereference_check(trie->stride, rcu_read_lock_bh_held());
+		if (st && st->gen == READ_ONCE(trie->gen))
+			return lpm_stride_lookup(trie, st, key->data);
+	}
 
 	/* Start walking the trie from the root node ... */
 
 	for (node = rcu_dereference_check(trie->root, rcu_read_lock_bh_held());
-	     node;) {
+	     node; depth++) {
 		unsigned int next_bit;
 		size_t matchlen;
 
@@ -269,12 +344,259 @@ static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 					     rcu_read_lock_bh_held());
 	}
 
+	this_cpu_add(trie->stats->depth, depth);
+
 	if (!found)
 		return NULL;
 
 	return found->data + trie->data_size;
 }
 
+/* Build time copy of a real node. The trie may change while the snapshot is
+ * built, so everything the tables are built from is copied during the walk,
+ * under RCU. Only the node pointer is kept past that, for the lookup result,
+ * and it is only dereferenced if the generation still matches.
+ */
+struct lpm_stride_key {
+	struct lpm_trie_node	*node;
+	u32			prefixlen;
+	u8			data[];
+};
+
+struct lpm_stride_build {
+	const struct bpf_map	*map;
+	u32			*tables;
+	u32			nr_tables;
+	u32			max_tables;
+	void			*keys;
+	size_t			key_size;
+	u32			nr_keys;
+};
+
+static struct lpm_stride_key *lpm_stride_key(struct lpm_stride_build *b,
+					     u32 i)
+{
+	return b->keys + i * b->key_size;
+}
+
+static int lpm_stride_new_table(struct lpm_stride_build *b, u32 fill)
+{
+	u32 *tables;
+
+	if (b->nr_tables == b->max_tables) {
+		/* Also keeps table indices clear of LPM_STRIDE_CHILD */
+		if ((size_t)b->max_tables * 2 * LPM_STRIDE_SIZE * sizeof(u32) >
+		    INT_MAX)
+			return -E2BIG;
+		tables = bpf_map_kvcalloc(b->map, (size_t)b->max_tables * 2 *
+					  LPM_STRIDE_SIZE, sizeof(u32),
+					  GFP_KERNEL);
+		if (!tables)
+			return -ENOMEM;
+		memcpy(tables, b->tables,
+		       (size_t)b->nr_tables * LPM_STRIDE_SIZE * sizeof(u32));
+		kvfree(b->tables);
+		b->tables = tables;
+		b->max_tables *= 2;
+	}
+
+	memset32(&b->tables[b->nr_tables * LPM_STRIDE_SIZE], fill,
+		 LPM_STRIDE_SIZE);
+	return b->nr_tables++;
+}
+
+/* Prefixes have to be inserted by increasing length: the range a prefix
+ * expands to then never contains child pointers yet, and longer prefixes
+ * overwrite the shorter ones they are more specific than.
+ */
+static int lpm_stride_insert(struct lpm_stride_build *b,
+			     const struct lpm_stride_key *key, u32 leaf)
+{
+	u32 level = key->prefixlen ? (key->prefixlen - 1) / LPM_STRIDE_BITS : 0;
+	u32 span = 1U << ((level + 1) * LPM_STRIDE_BITS - key->prefixlen);
+	u32 tbl = 0, first, i, *ent;
+	int child;
+
+	for (i = 0; i < level; i++) {
+		ent = &b->tables[tbl * LPM_STRIDE_SIZE + key->data[i]];
+		if (!(*ent & LPM_STRIDE_CHILD)) {
+			child = lpm_stride_new_table(b, *ent);
+			if (child < 0)
+				return child;
+			/* lpm_stride_new_table() may have moved the tables */
+			ent = &b->tables[tbl * LPM_STRIDE_SIZE + key->data[i]];
+			*ent = child | LPM_STRIDE_CHILD;
+		}
+		tbl = *ent & ~LPM_STRIDE_CHILD;
+	}
+
+	first = key->data[level] & ~(span - 1);
+	memset32(&b->tables[tbl * LPM_STRIDE_SIZE + first], leaf, span);
+	return 0;
+}
+
+static int lpm_stride_cmp(const void *a, const void *b)
+{
+	const struct lpm_stride_key *ka = a, *kb = b;
+
+	return (int)ka->prefixlen - (int)kb->prefixlen;
+}
+
+static void lpm_stride_free(struct lpm_stride *st)
+{
+	if (!st)
+		return;
+	kvfree(st->tables);
+	kvfree(st->leaves);
+	kfree(st);
+}
+
+/* Copy out the real nodes of the trie. A concurrent update is caught by the
+ * generation check before the result is published.
+ */
+static int lpm_stride_collect(struct lpm_trie *trie, struct lpm_stride_build *b,
+			      u32 max_leaves)
+{
+	struct lpm_trie_node *node, *child, **stack;
+	u32 sp = 0, max_sp = trie->max_prefixlen + 2;
+	struct lpm_stride_key *key;
+	int i, err = 0;
+
+	stack = kmalloc_array(max_sp, sizeof(*stack), GFP_KERNEL);
+	if (!stack)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	node = rcu_dereference(trie->root);
+	if (node)
+		stack[sp++] = node;
+	while (sp) {
+		node = stack[--sp];
+		if (!(READ_ONCE(node->flags) & LPM_TREE_NODE_FLAG_IM)) {
+			if (b->nr_keys == max_leaves) {
+				err = -EAGAIN;
+				break;
+			}
+			key = lpm_stride_key(b, b->nr_keys++);
+			key->node = node;
+			key->prefixlen = node->prefixlen;
+			memcpy(key->data, node->data, trie->data_size);
+		}
+		for (i = 0; i < 2; i++) {
+			child = rcu_dereference(node->child[i]);
+			if (!child)
+				continue;
+			if (sp == max_sp) {
+				err = -EAGAIN;
+				goto out;
+			}
+			stack[sp++] = child;
+		}
+	}
+out:
+	rcu_read_unlock();
+	kfree(stack);
+	return err;
+}
+
+/* Memory is charged to the map's memcg, not to the kworker's */
+static void lpm_stride_rebuild(struct work_struct *work)
+{
+	struct lpm_trie *trie = container_of(to_delayed_work(work),
+					     struct lpm_trie, stride_work);
+	struct lpm_stride_build b = { .map = &trie->map };
+	struct lpm_stride *st, *old = NULL;
+	unsigned long irq_flags;
+	u32 gen, max_leaves, i;
+	int err;
+
+	gen = READ_ONCE(trie->gen);
+	/* Pairs with the barrier in lpm_stride_invalidate() */
+	smp_rmb();
+	max_leaves = max_t(u32, READ_ONCE(trie->n_entries), 1);
+	b.key_size = ALIGN(sizeof(struct lpm_stride_key) + trie->data_size,
+			   sizeof(void *));
+
+	/* Too large to snapshot, lookups keep walking the trie */
+	if ((size_t)max_leaves * b.key_size > INT_MAX)
+		return;
+
+	st = bpf_map_kzalloc(&trie->map, sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return;
+	st->gen = gen;
+	st->leaves = bpf_map_kvcalloc(&trie->map, max_leaves,
+				      sizeof(*st->leaves), GFP_KERNEL);
+	b.keys = bpf_map_kvcalloc(&trie->map, max_leaves, b.key_size,
+				  GFP_KERNEL);
+	b.max_tables = 16;
+	b.tables = bpf_map_kvcalloc(&trie->map, b.max_tables * LPM_STRIDE_SIZE,
+				    sizeof(u32), GFP_KERNEL);
+	if (!st->leaves || !b.keys || !b.tables)
+		goto free;
+
+	err = lpm_stride_collect(trie, &b, max_leaves);
+	if (err)
+		goto free;
+
+	sort(b.keys, b.nr_keys, b.key_size, lpm_stride_cmp, NULL);
+
+	lpm_stride_new_table(&b, 0);
+	for (i = 0; i < b.nr_keys; i++) {
+		struct lpm_stride_key *key = lpm_stride_key(&b, i);
+
+		err = lpm_stride_insert(&b, key, i + 1);
+		if (err)
+			goto free;
+		st->leaves[i] = key->node;
+		cond_resched();
+	}
+	st->nr_leaves = b.nr_keys;
+	st->tables = b.tables;
+	st->nr_tables = b.nr_tables;
+	b.tables = NULL;
+
+	spin_lock_irqsave(&trie->lock, irq_flags);
+	if (trie->gen == gen) {
+		old = rcu_dereference_protected(trie->stride,
+						lockdep_is_held(&trie->lock));
+		rcu_assign_pointer(trie->stride, st);
+		trie->stride_rebuilds++;
+		st = NULL;
+	}
+	spin_unlock_irqrestore(&trie->lock, irq_flags);
+
+	/* If the trie changed meanwhile, the update queued another rebuild */
+	if (old) {
+		synchronize_rcu();
+		lpm_stride_free(old);
+	}
+free:
+	kvfree(b.keys);
+	kvfree(b.tables);
+	lpm_stride_free(st);
+}
+
+/* Called with trie->lock held, before the trie is modified */
+static void lpm_stride_invalidate(struct lpm_trie *trie)
+{
+	if (!(trie->map.map_flags & BPF_F_LPM_STRIDE))
+		return;
+
+	WRITE_ONCE(trie->gen, trie->gen + 1);
+	/* Lookups seeing the new generation stop using the snapshot
+	 * before they can observe the modification.
+	 */
+	smp_wmb();
+}
+
+static void lpm_stride_schedule(struct lpm_trie *trie)
+{
+	if (trie->map.map_flags & BPF_F_LPM_STRIDE)
+		queue_delayed_work(system_unbound_wq, &trie->stride_work,
+				   LPM_STRIDE_REBUILD_DELAY);
+}
+
 static struct lpm_trie_node *lpm_trie_node_alloc(const struct lpm_trie *trie,
 						 const void *value)
 {
@@ -319,6 +641,8 @@ static int trie_update_elem(struct bpf_map *map,
 
 	spin_lock_irqsave(&trie->lock, irq_flags);
 
+	lpm_stride_invalidate(trie);
+
 	/* Allocate and fill a new node */
 
 	if (trie->n_entries == trie->map.max_entries) {
@@ -425,6 +749,7 @@ static int trie_update_elem(struct bpf_map *map,
 	}
 
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
+	lpm_stride_schedule(trie);
 
 	return ret;
 }
@@ -446,6 +771,8 @@ static int trie_delete_elem(struct bpf_map *map, void *_key)
 
 	spin_lock_irqsave(&trie->lock, irq_flags);
 
+	lpm_stride_invalidate(trie);
+
 	/* Walk the tree looking for an exact key/length match and keeping
 	 * track of the path we traverse.  We will need to know the node
 	 * we wish to delete, and the slot that points to the node we want
@@ -521,6 +848,7 @@ static int trie_delete_elem(struct bpf_map *map, void *_key)
 
 out:
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
+	lpm_stride_schedule(trie);
 
 	return ret;
 }
@@ -537,7 +865,7 @@ static int trie_delete_elem(struct bpf_map *map, void *_key)
 #define LPM_KEY_SIZE_MIN	LPM_KEY_SIZE(LPM_DATA_SIZE_MIN)
 
 #define LPM_CREATE_FLAG_MASK	(BPF_F_NO_PREALLOC | BPF_F_NUMA_NODE |	\
-				 BPF_F_ACCESS_MASK)
+				 BPF_F_ACCESS_MASK | BPF_F_LPM_STRIDE)
 
 static struct bpf_map *trie_alloc(union bpf_attr *attr)
 {
@@ -567,7 +895,15 @@ static struct bpf_map *trie_alloc(union bpf_attr *attr)
 			  offsetof(struct bpf_lpm_trie_key, data);
 	trie->max_prefixlen = trie->data_size * 8;
 
+	trie->stats = bpf_map_alloc_percpu(&trie->map, sizeof(*trie->stats),
+					   __alignof__(u64), GFP_USER);
+	if (!trie->stats) {
+		kfree(trie);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	spin_lock_init(&trie->lock);
+	INIT_DELAYED_WORK(&trie->stride_work, lpm_stride_rebuild);
 
 	return &trie->map;
 }
@@ -578,6 +914,9 @@ static void trie_free(struct bpf_map *map)
 	struct lpm_trie_node __rcu **slot;
 	struct lpm_trie_node *node;
 
+	cancel_delayed_work_sync(&trie->stride_work);
+	lpm_stride_free(rcu_dereference_protected(trie->stride, 1));
+
 	/* Always start at the root and walk down to a node that has no
 	 * children. Then free that node, nullify its reference in the parent
 	 * and start over.
@@ -608,6 +947,7 @@ static void trie_free(struct bpf_map *map)
 	}
 
 out:
+	free_percpu(trie->stats);
 	kfree(trie);
 }
 
@@ -719,6 +1059,38 @@ static int trie_check_btf(const struct bpf_map *map,
 	       -EINVAL : 0;
 }
 
+static void trie_show_fdinfo(const struct bpf_map *map, struct seq_file *m)
+{
+	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
+	u64 lookups = 0, depth = 0, stride_lookups = 0;
+	struct lpm_stride *st;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_trie_stats *stats = per_cpu_ptr(trie->stats, cpu);
+
+		lookups += READ_ONCE(stats->lookups);
+		depth += READ_ONCE(stats->depth);
+		stride_lookups += READ_ONCE(stats->stride_lookups);
+	}
+
+	/* Nodes (or stride tables) visited, summed over all lookups */
+	seq_printf(m, "lookups:\t%llu\n", lookups);
+	seq_printf(m, "lookup_depth:\t%llu\n", depth);
+
+	if (!(map->map_flags & BPF_F_LPM_STRIDE))
+		return;
+
+	rcu_read_lock();
+	st = rcu_dereference(trie->stride);
+	seq_printf(m, "stride_lookups:\t%llu\n", stride_lookups);
+	seq_printf(m, "stride_rebuilds:\t%llu\n", READ_ONCE(trie->stride_rebuilds));
+	seq_printf(m, "stride_tables:\t%u\n", st ? st->nr_tables : 0);
+	seq_printf(m, "stride_current:\t%u\n",
+		   st && st->gen == READ_ONCE(trie->gen));
+	rcu_read_unlock();
+}
+
 static int trie_map_btf_id;
 const struct bpf_map_ops trie_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
@@ -732,6 +1104,7 @@ const struct bpf_map_ops trie_map_ops = {
 	.map_update_batch = generic_map_update_batch,
 	.map_delete_batch = generic_map_delete_batch,
 	.map_check_btf = trie_check_btf,
+	.map_show_fdinfo = trie_show_fdinfo,
 	.map_btf_name = "lpm_trie",
 	.map_btf_id = &trie_map_btf_id,
 };
@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <linux/bpf.h>
+#include <linux/slab.h>
+#include <linux/irqflags.h>
+#include <linux/rcupdate_trace.h>
+#include "memalloc.h"
+
+/* Every object is preceded by an llist_node that links it on the free
+ * lists, so the user part of the object is never touched by the cache.
+ *
+ * free_llist is only modified by its own CPU with interrupts disabled and
+ * 'active' raised. An NMI (or a tracing program nested into the cache)
+ * finds 'active' set and backs off: allocation fails and a free goes to
+ * free_llist_extra, which is lockless and drained by the irq_work.
+ */
+#define LLIST_NODE_SZ		sizeof(struct llist_node)
+
+#define BPF_MEM_LOW_WATERMARK	32
+#define BPF_MEM_HIGH_WATERMARK	96
+#define BPF_MEM_BATCH		((BPF_MEM_LOW_WATERMARK + BPF_MEM_HIGH_WATERMARK) / 2)
+#define BPF_MEM_PREFILL		4
+
+static void *__alloc(struct bpf_mem_alloc *ma, int node, gfp_t flags)
+{
+	void *obj;
+
+	obj = bpf_map_kmalloc_node(ma->map, ma->unit_size,
+				   flags | __GFP_NOWARN, node);
+	if (obj)
+		atomic_long_inc(&ma->nr_objs);
+	return obj;
+}
+
+static void __free(struct bpf_mem_alloc *ma, void *obj)
+{
+	atomic_long_dec(&ma->nr_objs);
+	kfree(obj);
+}
+
+static void free_all(struct bpf_mem_alloc *ma, struct llist_node *llnode)
+{
+	struct llist_node *pos, *t;
+
+	llist_for_each_safe(pos, t, llnode)
+		__free(ma, pos);
+}
+
+static void add_obj_to_free_list(struct bpf_mem_cache *c, void *obj)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	WARN_ON_ONCE(local_inc_return(&c->active) != 1);
+	__llist_add(obj, &c->free_llist);
+	c->free_cnt++;
+	local_dec(&c->active);
+	local_irq_restore(flags);
+}
+
+static void *del_obj_from_free_list(struct bpf_mem_cache *c)
+{
+	struct llist_node *llnode;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	WARN_ON_ONCE(local_inc_return(&c->active) != 1);
+	llnode = c->free_llist.first;
+	if (llnode) {
+		c->free_llist.first = llnode->next;
+		c->free_cnt--;
+	}
+	local_dec(&c->active);
+	local_irq_restore(flags);
+	return llnode;
+}
+
+/* Runs from irq_work on the CPU owning @c */
+static void alloc_bulk(struct bpf_mem_cache *c, int cnt, int node)
+{
+	struct llist_node *obj;
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		/* Frees that raced with free_llist updates come first */
+		obj = llist_del_first(&c->free_llist_extra);
+		if (!obj) {
+			obj = __alloc(c->ma, node, GFP_NOWAIT);
+			if (!obj)
+				break;
+		}
+		add_obj_to_free_list(c, obj);
+	}
+}
+
+static void free_bulk(struct bpf_mem_cache *c)
+{
+	struct llist_node *llnode;
+
+	while (READ_ONCE(c->free_cnt) > BPF_MEM_HIGH_WATERMARK - BPF_MEM_BATCH) {
+		llnode = del_obj_from_free_list(c);
+		if (!llnode)
+			break;
+		__free(c->ma, llnode);
+	}
+	free_all(c->ma, llist_del_all(&c->free_llist_extra));
+}
+
+static void do_call_rcu(struct bpf_mem_cache *c);
+
+static void __free_rcu(struct rcu_head *head)
+{
+	struct bpf_mem_cache *c = container_of(head, struct bpf_mem_cache, rcu);
+
+	free_all(c->ma, __llist_del_all(&c->waiting_for_gp));
+	atomic_set(&c->call_rcu_in_progress, 0);
+	/* Pairs with the barrier in bpf_mem_cache_free_rcu(), either the
+	 * freeing side sees call_rcu_in_progress cleared and kicks the
+	 * irq_work, or the objects it queued are picked up here.
+	 */
+	smp_mb();
+	if (!llist_empty(&c->free_by_rcu))
+		do_call_rcu(c);
+}
+
+/* Sleepable programs only hold rcu_read_lock_trace(), and a tasks trace
+ * grace period does not imply a regular one, so wait for both.
+ */
+static void __free_rcu_tasks_trace(struct rcu_head *head)
+{
+	call_rcu(head, __free_rcu);
+}
+
+static void do_call_rcu(struct bpf_mem_cache *c)
+{
+	if (atomic_xchg(&c->call_rcu_in_progress, 1))
+		return;
+
+	WARN_ON_ONCE(!llist_empty(&c->waiting_for_gp));
+	c->waiting_for_gp.first = llist_del_all(&c->free_by_rcu);
+	if (!c->waiting_for_gp.first) {
+		atomic_set(&c->call_rcu_in_progress, 0);
+		return;
+	}
+	/* Objects go back to slab once both the RCU tasks trace and the
+	 * regular grace period have passed, refill allocates new ones.
+	 */
+	call_rcu_tasks_trace(&c->rcu, __free_rcu_tasks_trace);
+}
+
+static void bpf_mem_refill(struct irq_work *work)
+{
+	struct bpf_mem_cache *c = container_of(work, struct bpf_mem_cache,
+					       refill_work);
+	int cnt;
+
+	/* Racy read, only a hint. Refill never runs in parallel with itself
+	 * and only the owning CPU touches free_llist.
+	 */
+	cnt = READ_ONCE(c->free_cnt);
+	if (cnt < BPF_MEM_LOW_WATERMARK)
+		alloc_bulk(c, BPF_MEM_BATCH, NUMA_NO_NODE);
+	else if (cnt > BPF_MEM_HIGH_WATERMARK)
+		free_bulk(c);
+
+	do_call_rcu(c);
+}
+
+/* The cache is picked with interrupts disabled and the irq_work queued
+ * before they are enabled again, so that both end up on the same CPU
+ * even when the caller can migrate (map free from a workqueue).
+ */
+void *bpf_mem_cache_alloc(struct bpf_mem_alloc *ma)
+{
+	struct llist_node *llnode = NULL;
+	struct bpf_mem_cache *c;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	c = this_cpu_ptr(ma->cache);
+	if (local_inc_return(&c->active) == 1) {
+		llnode = c->free_llist.first;
+		if (llnode) {
+			c->free_llist.first = llnode->next;
+			c->free_cnt--;
+		}
+	}
+	local_dec(&c->active);
+	if (c->free_cnt < BPF_MEM_LOW_WATERMARK)
+		irq_work_queue(&c->refill_work);
+	local_irq_restore(flags);
+
+	return llnode ? (void *)llnode + LLIST_NODE_SZ : NULL;
+}
+
+void bpf_mem_cache_free(struct bpf_mem_alloc *ma, void *ptr)
+{
+	struct llist_node *llnode = ptr - LLIST_NODE_SZ;
+	struct bpf_mem_cache *c;
+	unsigned long flags;
+
+	if (!ptr)
+		return;
+
+	local_irq_save(flags);
+	c = this_cpu_ptr(ma->cache);
+	if (local_inc_return(&c->active) == 1) {
+		__llist_add(llnode, &c->free_llist);
+		c->free_cnt++;
+	} else {
+		llist_add(llnode, &c->free_llist_extra);
+	}
+	local_dec(&c->active);
+	if (c->free_cnt > BPF_MEM_HIGH_WATERMARK)
+		irq_work_queue(&c->refill_work);
+	local_irq_restore(flags);
+}
+
+void bpf_mem_cache_free_rcu(struct bpf_mem_alloc *ma, void *ptr)
+{
+	struct bpf_mem_cache *c;
+	unsigned long flags;
+
+	if (!ptr)
+		return;
+
+	local_irq_save(flags);
+	c = this_cpu_ptr(ma->cache);
+	llist_add(ptr - LLIST_NODE_SZ, &c->free_by_rcu);
+	/* Pairs with the barrier in __free_rcu() */
+	smp_mb__after_atomic();
+	if (!atomic_read(&c->call_rcu_in_progress))
+		irq_work_queue(&c->refill_work);
+	local_irq_restore(flags);
+}
+
+int bpf_mem_alloc_init(struct bpf_mem_alloc *ma, const struct bpf_map *map,
+		       u32 size)
+{
+	struct bpf_mem_cache *c;
+	void *obj;
+	int cpu, i;
+
+	ma->map = map;
+	ma->unit_size = size + LLIST_NODE_SZ;
+	atomic_long_set(&ma->nr_objs, 0);
+
+	/* alloc_percpu zero-fills */
+	ma->cache = bpf_map_alloc_percpu(map, sizeof(*c), 8, GFP_KERNEL);
+	if (!ma->cache)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(ma->cache, cpu);
+		c->ma = ma;
+		init_irq_work(&c->refill_work, bpf_mem_refill);
+
+		/* A few objects to start with, the first updates on each
+		 * CPU then don't have to wait for the irq_work.
+		 */
+		for (i = 0; i < BPF_MEM_PREFILL; i++) {
+			obj = __alloc(ma, cpu_to_node(cpu), GFP_KERNEL);
+			if (!obj)
+				break;
+			__llist_add(obj, &c->free_llist);
+			c->free_cnt++;
+		}
+	}
+	return 0;
+}
+
+static bool rcu_in_progress(struct bpf_mem_alloc *ma)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (atomic_read(&per_cpu_ptr(ma->cache, cpu)->call_rcu_in_progress))
+			return true;
+	return false;
+}
+
+void bpf_mem_alloc_destroy(struct bpf_mem_alloc *ma)
+{
+	struct bpf_mem_cache *c;
+	int cpu;
+
+	if (!ma->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		irq_work_sync(&per_cpu_ptr(ma->cache, cpu)->refill_work);
+
+	/* __free_rcu() may queue another callback for objects that were
+	 * freed while the previous grace period was running. The tasks
+	 * trace callback queues the regular one, so wait for it first.
+	 */
+	do {
+		rcu_barrier_tasks_trace();
+		rcu_barrier();
+	} while (rcu_in_progress(ma));
+
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(ma->cache, cpu);
+		free_all(ma, __llist_del_all(&c->free_llist));
+		free_all(ma, __llist_del_all(&c->free_llist_extra));
+		free_all(ma, __llist_del_all(&c->free_by_rcu));
+		free_all(ma, __llist_del_all(&c->waiting_for_gp));
+	}
+	WARN_ON_ONCE(atomic_long_read(&ma->nr_objs));
+	free_percpu(ma->cache);
+	ma->cache = NULL;
+}
+
+u64 bpf_mem_alloc_usage(const struct bpf_mem_alloc *ma)
+{
+	return (u64)atomic_long_read(&ma->nr_objs) * ma->unit_size +
+	       (u64)sizeof(struct bpf_mem_cache) * num_possible_cpus();
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef __BPF_MEMALLOC_H__
+#define __BPF_MEMALLOC_H__
+#include <linux/llist.h>
+#include <linux/percpu.h>
+#include <linux/irq_work.h>
+#include <linux/rcupdate.h>
+#include <asm/local.h>
+
+struct bpf_map;
+struct bpf_mem_alloc;
+
+/* Per-CPU cache of fixed size objects that can be used from any context,
+ * NMI included. The free lists are refilled and trimmed from irq_work,
+ * neither allocation nor free ever calls into the slab allocator itself.
+ */
+struct bpf_mem_cache {
+	/* objects ready to be handed out, only used by the owning CPU */
+	struct llist_head free_llist;
+	local_t active;
+	int free_cnt;
+	/* frees that found free_llist in use, e.g. from NMI */
+	struct llist_head free_llist_extra;
+	/* objects to go back to slab once readers are gone */
+	struct llist_head free_by_rcu;
+	struct llist_head waiting_for_gp;
+	atomic_t call_rcu_in_progress;
+	struct rcu_head rcu;
+	struct irq_work refill_work;
+	struct bpf_mem_alloc *ma;
+};
+
+struct bpf_mem_alloc {
+	struct bpf_mem_cache __percpu *cache;
+	const struct bpf_map *map;
+	u32 unit_size;
+	atomic_long_t nr_objs;	/* objects allocated from slab */
+};
+
+int bpf_mem_alloc_init(struct bpf_mem_alloc *ma, const struct bpf_map *map,
+		       u32 size);
+void bpf_mem_alloc_destroy(struct bpf_mem_alloc *ma);
+void *bpf_mem_cache_alloc(struct bpf_mem_alloc *ma);
+/* for objects never seen by RCU readers, they are reused right away */
+void bpf_mem_cache_free(struct bpf_mem_alloc *ma, void *ptr);
+/* for objects RCU readers, sleepable programs included, may still look at */
+void bpf_mem_cache_free_rcu(struct bpf_mem_alloc *ma, void *ptr);
+u64 bpf_mem_alloc_usage(const struct bpf_mem_alloc *ma);
+#endif
@@ -9,9 +9,17 @@
 #include <linux/wait.h>
 #include <linux/poll.h>
 #include <linux/kmemleak.h>
+#include <linux/hrtimer.h>
+#include <linux/seq_file.h>
 #include <uapi/linux/btf.h>
 
-#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE)
+#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE | BPF_F_RB_WAKEUP_COALESCE)
+
+/* With BPF_F_RB_WAKEUP_COALESCE the consumer is woken up once this share
+ * of the ring is filled, or this long after the first unnotified record.
+ */
+#define RINGBUF_WAKEUP_FRAC	8
+#define RINGBUF_WAKEUP_DELAY_NS	NSEC_PER_MSEC
 
 /* non-mmap()'able part of bpf_ringbuf (everything up to consumer page) */
 #define RINGBUF_PGOFF \
@@ -33,6 +41,13 @@
 struct bpf_ringbuf {
 	wait_queue_head_t waitq;
 	struct irq_work work;
+	/* wakeup coalescing, wakeup_bytes is 0 without it */
+	struct hrtimer wakeup_timer;
+	unsigned long wakeup_bytes;
+	atomic_t wakeup_pending;
+	int wakeup_now;
+	atomic_long_t wakeups;
+	atomic_long_t reserve_fails;
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
@@ -119,14 +134,45 @@ static struct bpf_ringbuf *bpf_ringbuf_area_alloc(size_t data_sz, int numa_node)
 	return NULL;
 }
 
+static unsigned long ringbuf_avail_data_sz(struct bpf_ringbuf *rb);
+
+static void bpf_ringbuf_wakeup(struct bpf_ringbuf *rb)
+{
+	atomic_set(&rb->wakeup_pending, 0);
+	atomic_long_inc(&rb->wakeups);
+	wake_up_all(&rb->waitq);
+}
+
+static enum hrtimer_restart bpf_ringbuf_wakeup_timer(struct hrtimer *timer)
+{
+	struct bpf_ringbuf *rb = container_of(timer, struct bpf_ringbuf,
+					      wakeup_timer);
+
+	bpf_ringbuf_wakeup(rb);
+	return HRTIMER_NORESTART;
+}
+
 static void bpf_ringbuf_notify(struct irq_work *work)
 {
 	struct bpf_ringbuf *rb = container_of(work, struct bpf_ringbuf, work);
 
-	wake_up_all(&rb->waitq);
+	if (!rb->wakeup_bytes || xchg(&rb->wakeup_now, 0) ||
+	    ringbuf_avail_data_sz(rb) >= rb->wakeup_bytes) {
+		if (rb->wakeup_bytes)
+			hrtimer_try_to_cancel(&rb->wakeup_timer);
+		bpf_ringbuf_wakeup(rb);
+		return;
+	}
+
+	/* Commits can come from NMI, so the timer is armed from here */
+	if (!hrtimer_active(&rb->wakeup_timer))
+		hrtimer_start(&rb->wakeup_timer,
+			      ns_to_ktime(RINGBUF_WAKEUP_DELAY_NS),
+			      HRTIMER_MODE_REL);
 }
 
-static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
+static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node,
+					     bool coalesce)
 {
 	struct bpf_ringbuf *rb;
 
@@ -137,6 +183,10 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	spin_lock_init(&rb->spinlock);
 	init_waitqueue_head(&rb->waitq);
 	init_irq_work(&rb->work, bpf_ringbuf_notify);
+	hrtimer_init(&rb->wakeup_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	rb->wakeup_timer.function = bpf_ringbuf_wakeup_timer;
+	if (coalesce)
+		rb->wakeup_bytes = data_sz / RINGBUF_WAKEUP_FRAC;
 
 	rb->mask = data_sz - 1;
 	rb->consumer_pos = 0;
@@ -169,7 +219,8 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 
 	bpf_map_init_from_attr(&rb_map->map, attr);
 
-	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node);
+	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node,
+				       attr->map_flags & BPF_F_RB_WAKEUP_COALESCE);
 	if (!rb_map->rb) {
 		kfree(rb_map);
 		return ERR_PTR(-ENOMEM);
@@ -186,6 +237,9 @@ static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
 	struct page **pages = rb->pages;
 	int i, nr_pages = rb->nr_pages;
 
+	irq_work_sync(&rb->work);
+	hrtimer_cancel(&rb->wakeup_timer);
+
 	vunmap(rb);
 	for (i = 0; i < nr_pages; i++)
 		__free_page(pages[i]);
@@ -263,6 +317,17 @@ static __poll_t ringbuf_map_poll(struct bpf_map *map, struct file *filp,
 	return 0;
 }
 
+static void ringbuf_map_show_fdinfo(const struct bpf_map *map,
+				    struct seq_file *m)
+{
+	struct bpf_ringbuf *rb;
+
+	rb = container_of(map, struct bpf_ringbuf_map, map)->rb;
+	seq_printf(m, "wakeups:\t%lu\n", atomic_long_read(&rb->wakeups));
+	seq_printf(m, "reserve_fails:\t%lu\n",
+		   atomic_long_read(&rb->reserve_fails));
+}
+
 static int ringbuf_map_btf_id;
 const struct bpf_map_ops ringbuf_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
@@ -274,6 +339,7 @@ const struct bpf_map_ops ringbuf_map_ops = {
 	.map_update_elem = ringbuf_map_update_elem,
 	.map_delete_elem = ringbuf_map_delete_elem,
 	.map_get_next_key = ringbuf_map_get_next_key,
+	.map_show_fdinfo = ringbuf_map_show_fdinfo,
 	.map_btf_name = "bpf_ringbuf_map",
 	.map_btf_id = &ringbuf_map_btf_id,
 };
@@ -318,8 +384,10 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	cons_pos = smp_load_acquire(&rb->consumer_pos);
 
 	if (in_nmi()) {
-		if (!spin_trylock_irqsave(&rb->spinlock, flags))
+		if (!spin_trylock_irqsave(&rb->spinlock, flags)) {
+			atomic_long_inc(&rb->reserve_fails);
 			return NULL;
+		}
 	} else {
 		spin_lock_irqsave(&rb->spinlock, flags);
 	}
@@ -332,6 +400,7 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	 */
 	if (new_prod_pos - cons_pos > rb->mask) {
 		spin_unlock_irqrestore(&rb->spinlock, flags);
+		atomic_long_inc(&rb->reserve_fails);
 		return NULL;
 	}
 
@@ -367,6 +436,21 @@ const struct bpf_func_proto bpf_ringbuf_reserve_proto = {
 	.arg3_type	= ARG_ANYTHING,
 };
 
+/* Kick the irq_work when the fill level crosses wakeup_bytes, or, when no
+ * wakeup is pending yet, to arm the timer. Other commits stay silent.
+ */
+static void bpf_ringbuf_coalesce_wakeup(struct bpf_ringbuf *rb, u32 len)
+{
+	unsigned long avail = ringbuf_avail_data_sz(rb);
+
+	len = round_up((len & ~BPF_RINGBUF_DISCARD_BIT) + BPF_RINGBUF_HDR_SZ, 8);
+	if (avail >= rb->wakeup_bytes && avail - len < rb->wakeup_bytes)
+		irq_work_queue(&rb->work);
+	else if (!atomic_read(&rb->wakeup_pending) &&
+		 !atomic_xchg(&rb->wakeup_pending, 1))
+		irq_work_queue(&rb->work);
+}
+
 static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 {
 	unsigned long rec_pos, cons_pos;
@@ -389,10 +473,16 @@ static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 	rec_pos = (void *)hdr - (void *)rb->data;
 	cons_pos = smp_load_acquire(&rb->consumer_pos) & rb->mask;
 
-	if (flags & BPF_RB_FORCE_WAKEUP)
+	if (flags & BPF_RB_FORCE_WAKEUP) {
+		WRITE_ONCE(rb->wakeup_now, 1);
 		irq_work_queue(&rb->work);
-	else if (cons_pos == rec_pos && !(flags & BPF_RB_NO_WAKEUP))
+	} else if (flags & BPF_RB_NO_WAKEUP) {
+		return;
+	} else if (rb->wakeup_bytes) {
+		bpf_ringbuf_coalesce_wakeup(rb, new_len);
+	} else if (cons_pos == rec_pos) {
 		irq_work_queue(&rb->work);
+	}
 }
 
 BPF_CALL_2(bpf_ringbuf_submit, void *, sample, u64, flags)
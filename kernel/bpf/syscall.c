@@ -445,6 +445,19 @@ void *bpf_map_kzalloc(const struct bpf_map *map, size_t size, gfp_t flags)
 	return ptr;
 }
 
+void *bpf_map_kvcalloc(const struct bpf_map *map, size_t n, size_t size,
+		       gfp_t flags)
+{
+	struct mem_cgroup *old_memcg;
+	void *ptr;
+
+	old_memcg = set_active_memcg(map->memcg);
+	ptr = kvcalloc(n, size, flags | __GFP_ACCOUNT);
+	set_active_memcg(old_memcg);
+
+	return ptr;
+}
+
 void __percpu *bpf_map_alloc_percpu(const struct bpf_map *map, size_t size,
 				    size_t align, gfp_t flags)
 {
@@ -585,6 +598,11 @@ static void bpf_map_show_fdinfo(struct seq_file *m, struct file *filp)
 		seq_printf(m, "owner_prog_type:\t%u\n", type);
 		seq_printf(m, "owner_jited:\t%u\n", jited);
 	}
+	if (map->ops->map_mem_usage)
+		seq_printf(m, "mem_usage:\t%llu\n",
+			   map->ops->map_mem_usage(map));
+	if (map->ops->map_show_fdinfo)
+		map->ops->map_show_fdinfo(map, m);
 }
 #endif
 
@@ -8,9 +8,19 @@
 #include <linux/fdtable.h>
 #include <linux/filter.h>
 #include <linux/btf_ids.h>
+#include <linux/cgroup.h>
 
 struct bpf_iter_seq_task_common {
 	struct pid_namespace *ns;
+	/* filters from bpf_iter_link_info, see bpf_iter_attach_task() */
+	u32 tid_start;
+	u32 tid_end;
+	struct cgroup *cgrp;
+	u32 flags;
+	/* aux->task.last_walk when this walk started, and the start time */
+	unsigned long since;
+	unsigned long start;
+	struct bpf_iter_aux_info *aux;
 };
 
 struct bpf_iter_seq_task_info {
@@ -21,30 +31,77 @@ struct bpf_iter_seq_task_info {
 	u32 tid;
 };
 
-static struct task_struct *task_seq_get_next(struct pid_namespace *ns,
-					     u32 *tid,
-					     bool skip_if_dup_files)
+#ifdef CONFIG_CGROUPS
+static bool task_seq_filtered(struct bpf_iter_seq_task_common *common,
+			      struct task_struct *task)
 {
+	return common->cgrp && !task_under_cgroup_hierarchy(task, common->cgrp);
+}
+
+static struct cgroup *task_iter_cgroup_get_fd(int fd)
+{
+	return cgroup_get_from_fd(fd);
+}
+
+static void task_iter_cgroup_get(struct cgroup *cgrp)
+{
+	if (cgrp)
+		cgroup_get(cgrp);
+}
+
+static void task_iter_cgroup_put(struct cgroup *cgrp)
+{
+	if (cgrp)
+		cgroup_put(cgrp);
+}
+#else
+static bool task_seq_filtered(struct bpf_iter_seq_task_common *common,
+			      struct task_struct *task)
+{
+	return false;
+}
+
+static struct cgroup *task_iter_cgroup_get_fd(int fd)
+{
+	return ERR_PTR(-EOPNOTSUPP);
+}
+
+static void task_iter_cgroup_get(struct cgroup *cgrp) {}
+static void task_iter_cgroup_put(struct cgroup *cgrp) {}
+#endif
+
+static struct task_struct *
+task_seq_get_next(struct bpf_iter_seq_task_common *common, u32 *tid,
+		  bool skip_if_dup_files)
+{
+	struct pid_namespace *ns = common->ns;
 	struct task_struct *task = NULL;
 	struct pid *pid;
 
+	if (*tid < common->tid_start)
+		*tid = common->tid_start;
+
 	rcu_read_lock();
 retry:
 	pid = find_ge_pid(*tid, ns);
 	if (pid) {
 		*tid = pid_nr_ns(pid, ns);
+		if (common->tid_end && *tid > common->tid_end)
+			goto out;
 		task = get_pid_task(pid, PIDTYPE_PID);
 		if (!task) {
 			++*tid;
 			goto retry;
-		} else if (skip_if_dup_files && !thread_group_leader(task) &&
-			   task->files == task->group_leader->files) {
+		} else if ((skip_if_dup_files && !thread_group_leader(task) &&
+			    task->files == task->group_leader->files) ||
+			   task_seq_filtered(common, task)) {
 			put_task_struct(task);
 			task = NULL;
 			++*tid;
 			goto retry;
 		}
 	}
+out:
 	rcu_read_unlock();
 
 	return task;
@@ -55,7 +112,7 @@ static void *task_seq_start(struct seq_file *seq, loff_t *pos)
 	struct bpf_iter_seq_task_info *info = seq->private;
 	struct task_struct *task;
 
-	task = task_seq_get_next(info->common.ns, &info->tid, false);
+	task = task_seq_get_next(&info->common, &info->tid, false);
 	if (!task)
 		return NULL;
 
@@ -72,7 +129,7 @@ static void *task_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	++*pos;
 	++info->tid;
 	put_task_struct((struct task_struct *)v);
-	task = task_seq_get_next(info->common.ns, &info->tid, false);
+	task = task_seq_get_next(&info->common, &info->tid, false);
 	if (!task)
 		return NULL;
 
@@ -137,7 +194,6 @@ struct bpf_iter_seq_task_file_info {
 static struct file *
 task_file_seq_get_next(struct bpf_iter_seq_task_file_info *info)
 {
-	struct pid_namespace *ns = info->common.ns;
 	u32 curr_tid = info->tid;
 	struct task_struct *curr_task;
 	unsigned int curr_fd = info->fd;
@@ -151,7 +207,7 @@ task_file_seq_get_next(struct bpf_iter_seq_task_file_info *info)
 		curr_task = info->task;
 		curr_fd = info->fd;
 	} else {
-                curr_task = task_seq_get_next(ns, &curr_tid, true);
+                curr_task = task_seq_get_next(&info->common, &curr_tid, true);
                 if (!curr_task) {
                         info->task = NULL;
                         info->tid = curr_tid;
@@ -269,6 +325,15 @@ static int init_seq_pidns(void *priv_data, struct bpf_iter_aux_info *aux)
 	struct bpf_iter_seq_task_common *common = priv_data;
 
 	common->ns = get_pid_ns(task_active_pid_ns(current));
+	common->tid_start = aux->task.tid_start;
+	common->tid_end = aux->task.tid_end;
+	common->flags = aux->task.flags;
+	common->cgrp = aux->task.cgrp;
+	task_iter_cgroup_get(common->cgrp);
+	/* The iterator holds a link reference, aux stays around */
+	common->aux = aux;
+	common->since = READ_ONCE(aux->task.last_walk);
+	common->start = jiffies;
 	return 0;
 }
 
@@ -276,9 +341,63 @@ static void fini_seq_pidns(void *priv_data)
 {
 	struct bpf_iter_seq_task_common *common = priv_data;
 
+	task_iter_cgroup_put(common->cgrp);
 	put_pid_ns(common->ns);
 }
 
+static int bpf_iter_attach_task(struct bpf_prog *prog,
+				union bpf_iter_link_info *linfo,
+				struct bpf_iter_aux_info *aux)
+{
+	struct cgroup *cgrp = NULL;
+
+	if (linfo->task.flags & ~BPF_ITER_TASK_VMA_SKIP_UNCHANGED)
+		return -EINVAL;
+	if (linfo->task.tid_end && linfo->task.tid_end < linfo->task.tid_start)
+		return -EINVAL;
+
+	if (linfo->task.cgroup_fd) {
+		cgrp = task_iter_cgroup_get_fd(linfo->task.cgroup_fd);
+		if (IS_ERR(cgrp))
+			return PTR_ERR(cgrp);
+	}
+
+	aux->task.tid_start = linfo->task.tid_start;
+	aux->task.tid_end = linfo->task.tid_end;
+	aux->task.flags = linfo->task.flags;
+	aux->task.cgrp = cgrp;
+	aux->task.last_walk = 0;
+	return 0;
+}
+
+static int bpf_iter_attach_task_common(struct bpf_prog *prog,
+				       union bpf_iter_link_info *linfo,
+				       struct bpf_iter_aux_info *aux)
+{
+	/* only task_vma knows how to skip unchanged address spaces */
+	if (linfo->task.flags)
+		return -EINVAL;
+	return bpf_iter_attach_task(prog, linfo, aux);
+}
+
+static void bpf_iter_detach_task(struct bpf_iter_aux_info *aux)
+{
+	task_iter_cgroup_put(aux->task.cgrp);
+}
+
+static void bpf_iter_task_show_fdinfo(const struct bpf_iter_aux_info *aux,
+				      struct seq_file *seq)
+{
+	if (aux->task.tid_start || aux->task.tid_end)
+		seq_printf(seq, "tid_range:\t%u-%u\n", aux->task.tid_start,
+			   aux->task.tid_end);
+	if (aux->task.cgrp)
+		seq_printf(seq, "cgroup_id:\t%llu\n",
+			   cgroup_id(aux->task.cgrp));
+	if (aux->task.flags)
+		seq_printf(seq, "task_flags:\t%#x\n", aux->task.flags);
+}
+
 static const struct seq_operations task_file_seq_ops = {
 	.start	= task_file_seq_start,
 	.next	= task_file_seq_next,
@@ -307,7 +426,6 @@ enum bpf_task_vma_iter_find_op {
 static struct vm_area_struct *
 task_vma_seq_get_next(struct bpf_iter_seq_task_vma_info *info)
 {
-	struct pid_namespace *ns = info->common.ns;
 	enum bpf_task_vma_iter_find_op op;
 	struct vm_area_struct *curr_vma;
 	struct task_struct *curr_task;
@@ -371,9 +489,12 @@ task_vma_seq_get_next(struct bpf_iter_seq_task_vma_info *info)
 		}
 	} else {
 again:
-		curr_task = task_seq_get_next(ns, &curr_tid, true);
+		curr_task = task_seq_get_next(&info->common, &curr_tid, true);
 		if (!curr_task) {
 			info->tid = curr_tid + 1;
+			/* Every address space changed since 'since' was seen */
+			WRITE_ONCE(info->common.aux->task.last_walk,
+				   info->common.start);
 			goto finish;
 		}
 
@@ -394,6 +515,16 @@ task_vma_seq_get_next(struct bpf_iter_seq_task_vma_info *info)
 		if (!curr_task->mm)
 			goto next_task;
 
+		/* A whole address space was walked since it last changed.
+		 * Partially walked ones (op == task_vma_iter_find_vma) are
+		 * finished, the stamp may have moved meanwhile.
+		 */
+		if (op == task_vma_iter_first_vma && info->common.since &&
+		    (info->common.flags & BPF_ITER_TASK_VMA_SKIP_UNCHANGED) &&
+		    time_before(READ_ONCE(curr_task->mm->mmap_write_stamp),
+				info->common.since))
+			goto next_task;
+
 		if (mmap_read_lock_killable(curr_task->mm))
 			goto finish;
 	}
@@ -537,7 +668,10 @@ static const struct bpf_iter_seq_info task_seq_info = {
 
 static struct bpf_iter_reg task_reg_info = {
 	.target			= "task",
-	.feature		= BPF_ITER_RESCHED,
+	.attach_target		= bpf_iter_attach_task_common,
+	.detach_target		= bpf_iter_detach_task,
+	.show_fdinfo		= bpf_iter_task_show_fdinfo,
+	.feature		= BPF_ITER_RESCHED | BPF_ITER_SLEEPABLE,
 	.ctx_arg_info_size	= 1,
 	.ctx_arg_info		= {
 		{ offsetof(struct bpf_iter__task, task),
@@ -555,7 +689,10 @@ static const struct bpf_iter_seq_info task_file_seq_info = {
 
 static struct bpf_iter_reg task_file_reg_info = {
 	.target			= "task_file",
-	.feature		= BPF_ITER_RESCHED,
+	.attach_target		= bpf_iter_attach_task_common,
+	.detach_target		= bpf_iter_detach_task,
+	.show_fdinfo		= bpf_iter_task_show_fdinfo,
+	.feature		= BPF_ITER_RESCHED | BPF_ITER_SLEEPABLE,
 	.ctx_arg_info_size	= 2,
 	.ctx_arg_info		= {
 		{ offsetof(struct bpf_iter__task_file, task),
@@ -575,7 +712,10 @@ static const struct bpf_iter_seq_info task_vma_seq_info = {
 
 static struct bpf_iter_reg task_vma_reg_info = {
 	.target			= "task_vma",
-	.feature		= BPF_ITER_RESCHED,
+	.attach_target		= bpf_iter_attach_task,
+	.detach_target		= bpf_iter_detach_task,
+	.show_fdinfo		= bpf_iter_task_show_fdinfo,
+	.feature		= BPF_ITER_RESCHED | BPF_ITER_SLEEPABLE,
 	.ctx_arg_info_size	= 2,
 	.ctx_arg_info		= {
 		{ offsetof(struct bpf_iter__task_vma, task),
@@ -10628,14 +10628,16 @@ static bool states_maybe_looping(struct bpf_verifier_state *old,
 
 static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 {
+	struct bpf_insn_aux_data *aux = &env->insn_aux_data[insn_idx];
 	struct bpf_verifier_state_list *new_sl;
 	struct bpf_verifier_state_list *sl, **pprev;
 	struct bpf_verifier_state *cur = env->cur_state, *new;
 	int i, j, err, states_cnt = 0;
 	bool add_new_state = env->test_state_freq ? true : false;
+	u32 backoff;
 
 	cur->last_insn_idx = env->prev_insn_idx;
-	if (!env->insn_aux_data[insn_idx].prune_point)
+	if (!aux->prune_point)
 		/* this 'insn_idx' instruction wasn't marked, so we will not
 		 * be doing state search here
 		 */
@@ -10648,9 +10650,22 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	 * This heuristics helps decrease 'total_states' and 'peak_states' metric.
 	 * In tests that amounts to up to 50% reduction into total verifier
 	 * memory consumption and 20% verifier time speedup.
+	 *
+	 * A prune point that keeps getting new states without ever pruning,
+	 * e.g. inside a large unrolled body where every path differs, only
+	 * costs memory and states_equal() calls. Space its checkpoints out
+	 * exponentially, the back-off is gone after the first hit. Fewer
+	 * checkpoints can mean less pruning, so only do this while a program
+	 * has used less than a quarter of BPF_COMPLEXITY_LIMIT_INSNS. Past
+	 * that every prune point is back to the normal rate, and a program
+	 * getting close to the limit is not slowed down further by it.
 	 */
-	if (env->jmps_processed - env->prev_jmps_processed >= 2 &&
-	    env->insn_processed - env->prev_insn_processed >= 8)
+	backoff = 0;
+	if (!aux->prune_hits &&
+	    env->insn_processed < BPF_COMPLEXITY_LIMIT_INSNS / 4)
+		backoff = min_t(u32, aux->prune_adds / 8, 4);
+	if (env->jmps_processed - env->prev_jmps_processed >= (2U << backoff) &&
+	    env->insn_processed - env->prev_insn_processed >= (8U << backoff))
 		add_new_state = true;
 
 	pprev = explored_state(env, insn_idx);
@@ -10704,6 +10719,9 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 		}
 		if (states_equal(env, &sl->state, cur)) {
 			sl->hit_cnt++;
+			env->prune_hits++;
+			if (aux->prune_hits < U16_MAX)
+				aux->prune_hits++;
 			/* reached equivalent register/stack state,
 			 * prune the search.
 			 * Registers read by the continuation are read by us.
@@ -10727,6 +10745,7 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 				return err;
 			return 1;
 		}
+		env->prune_misses++;
 miss:
 		/* when new state is not going to be added do not increase miss count.
 		 * Otherwise several loop iterations will remove the state
@@ -10745,6 +10764,7 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 			/* the state is unlikely to be useful. Remove it to
 			 * speed up verification
 			 */
+			env->states_evicted++;
 			*pprev = sl->next;
 			if (sl->state.frame[0]->regs[0].live & REG_LIVE_DONE) {
 				u32 br = sl->state.branches;
@@ -10794,6 +10814,8 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 		return -ENOMEM;
 	env->total_states++;
 	env->peak_states++;
+	if (aux->prune_adds < U16_MAX)
+		aux->prune_adds++;
 	env->prev_jmps_processed = env->jmps_processed;
 	env->prev_insn_processed = env->insn_processed;
 
@@ -11376,6 +11398,14 @@ static int check_pseudo_btf_id(struct bpf_verifier_env *env,
 
 static int check_map_prealloc(struct bpf_map *map)
 {
+	/* Elements of a run-time allocated hash map come from an NMI safe
+	 * per-CPU cache, and are only returned to slab after an RCU tasks
+	 * trace grace period, so sleepable programs may use them too. Only
+	 * the bucket lock, which is a sleeping lock on RT for such maps,
+	 * still rules them out there.
+	 */
+	if (map->map_type == BPF_MAP_TYPE_HASH && !IS_ENABLED(CONFIG_PREEMPT_RT))
+		return true;
 	return (map->map_type != BPF_MAP_TYPE_HASH &&
 		map->map_type != BPF_MAP_TYPE_PERCPU_HASH &&
 		map->map_type != BPF_MAP_TYPE_HASH_OF_MAPS) ||
@@ -13120,6 +13150,8 @@ static void free_states(struct bpf_verifier_env *env)
 static int do_check_common(struct bpf_verifier_env *env, int subprog)
 {
 	bool pop_log = !(env->log.level & BPF_LOG_LEVEL2);
+	u32 insn_processed = env->insn_processed;
+	u64 start_time = ktime_get_ns();
 	struct bpf_verifier_state *state;
 	struct bpf_reg_state *regs;
 	int ret, i;
@@ -13181,6 +13213,10 @@ static int do_check_common(struct bpf_verifier_env *env, int subprog)
 	}
 
 	ret = do_check(env);
+	env->subprog_info[subprog].insn_processed =
+		env->insn_processed - insn_processed;
+	env->subprog_info[subprog].verification_time =
+		ktime_get_ns() - start_time;
 out:
 	/* check for NULL is necessary, since cur_state can be freed inside
 	 * do_check() under memory pressure.
@@ -13266,6 +13302,19 @@ static void print_verification_stats(struct bpf_verifier_env *env)
 				verbose(env, "+");
 		}
 		verbose(env, "\n");
+		/* static subprogs are verified as part of their callers */
+		for (i = 0; i < env->subprog_cnt; i++) {
+			struct bpf_subprog_info *info = &env->subprog_info[i];
+
+			if (!info->verification_time)
+				continue;
+			verbose(env, "func#%d processed %u insns in %llu usec\n",
+				i, info->insn_processed,
+				div_u64(info->verification_time, 1000));
+		}
+		verbose(env, "prune hits %u misses %u states evicted %u\n",
+			env->prune_hits, env->prune_misses,
+			env->states_evicted);
 	}
 	verbose(env, "processed %d insns (limit %d) max_states_per_insn %d "
 		"total_states %d peak_states %d mark_read %d\n",
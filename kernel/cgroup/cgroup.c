@@ -5139,7 +5139,7 @@ static struct cftype cgroup_base_files[] = {
  * 2. When the percpu_ref is confirmed to be visible as killed on all CPUs
  *    and thus css_tryget_online() is guaranteed to fail, the css can be
  *    offlined by invoking offline_css().  After offlining, the base ref is
- *    put.  Implemented in css_killed_work_fn().
+ *    put.  Implemented in css_killed_one().
  *
  * 3. When the percpu_ref reaches zero, the only possible remaining
  *    accessors are inside RCU read sections.  css_release() schedules the
@@ -5149,9 +5149,25 @@ static struct cftype cgroup_base_files[] = {
  *    css_free_work_fn().
  *
  * It is actually hairier because both step 2 and 4 require process context
- * and thus involve punting to css->destroy_work adding two additional
- * steps to the already complex sequence.
+ * and thus involve punting to a work item adding two additional steps to
+ * the already complex sequence.  Step 2 and the process context part of
+ * step 3 both need cgroup_mutex.  Instead of a work item and a cgroup_mutex
+ * round trip per css, the csses are collected on lockless lists and
+ * processed in batches, see css_release_batch_workfn() and
+ * css_killed_batch_workfn().
  */
+
+/* cgroup_mutex is released for a moment after this many csses */
+#define CSS_DESTROY_BATCH	32
+
+static void css_release_batch_workfn(struct work_struct *work);
+static void css_killed_batch_workfn(struct work_struct *work);
+
+static LLIST_HEAD(css_release_llist);
+static DECLARE_WORK(css_release_work, css_release_batch_workfn);
+static LLIST_HEAD(css_killed_llist);
+static DECLARE_WORK(css_killed_work, css_killed_batch_workfn);
+
 static void css_free_rwork_fn(struct work_struct *work)
 {
 	struct cgroup_subsys_state *css = container_of(to_rcu_work(work),
@@ -5201,14 +5217,12 @@ static void css_free_rwork_fn(struct work_struct *work)
 	}
 }
 
-static void css_release_work_fn(struct work_struct *work)
+static void css_release_one(struct cgroup_subsys_state *css)
 {
-	struct cgroup_subsys_state *css =
-		container_of(work, struct cgroup_subsys_state, destroy_work);
 	struct cgroup_subsys *ss = css->ss;
 	struct cgroup *cgrp = css->cgroup;
 
-	mutex_lock(&cgroup_mutex);
+	lockdep_assert_held(&cgroup_mutex);
 
 	css->flags |= CSS_RELEASED;
 	list_del_rcu(&css->sibling);
@@ -5249,19 +5263,40 @@ static void css_release_work_fn(struct work_struct *work)
 					 NULL);
 	}
 
-	mutex_unlock(&cgroup_mutex);
-
 	INIT_RCU_WORK(&css->destroy_rwork, css_free_rwork_fn);
 	queue_rcu_work(cgroup_destroy_wq, &css->destroy_rwork);
 }
 
+static void css_release_batch_workfn(struct work_struct *work)
+{
+	struct cgroup_subsys_state *css, *next;
+	struct llist_node *list;
+	int nr = 0;
+
+	/* release in the order the refs dropped to zero */
+	list = llist_reverse_order(llist_del_all(&css_release_llist));
+
+	mutex_lock(&cgroup_mutex);
+	llist_for_each_entry_safe(css, next, list, destroy_llnode) {
+		/* @css may be freed once its RCU work has been queued */
+		css_release_one(css);
+
+		if (!(++nr % CSS_DESTROY_BATCH)) {
+			mutex_unlock(&cgroup_mutex);
+			cond_resched();
+			mutex_lock(&cgroup_mutex);
+		}
+	}
+	mutex_unlock(&cgroup_mutex);
+}
+
 static void css_release(struct percpu_ref *ref)
 {
 	struct cgroup_subsys_state *css =
 		container_of(ref, struct cgroup_subsys_state, refcnt);
 
-	INIT_WORK(&css->destroy_work, css_release_work_fn);
-	queue_work(cgroup_destroy_wq, &css->destroy_work);
+	if (llist_add(&css->destroy_llnode, &css_release_llist))
+		queue_work(cgroup_destroy_wq, &css_release_work);
 }
 
 static void init_and_link_css(struct cgroup_subsys_state *css,
@@ -5593,12 +5628,9 @@ int cgroup_mkdir(struct kernfs_node *parent_kn, const char *name, umode_t mode)
  * css_tryget_online() is now guaranteed to fail.  Tell the subsystem to
  * initiate destruction and put the css ref from kill_css().
  */
-static void css_killed_work_fn(struct work_struct *work)
+static void css_killed_one(struct cgroup_subsys_state *css)
 {
-	struct cgroup_subsys_state *css =
-		container_of(work, struct cgroup_subsys_state, destroy_work);
-
-	mutex_lock(&cgroup_mutex);
+	lockdep_assert_held(&cgroup_mutex);
 
 	do {
 		offline_css(css);
@@ -5606,7 +5638,26 @@ static void css_killed_work_fn(struct work_struct *work)
 		/* @css can't go away while we're holding cgroup_mutex */
 		css = css->parent;
 	} while (css && atomic_dec_and_test(&css->online_cnt));
+}
 
+static void css_killed_batch_workfn(struct work_struct *work)
+{
+	struct cgroup_subsys_state *css, *next;
+	struct llist_node *list;
+	int nr = 0;
+
+	list = llist_reverse_order(llist_del_all(&css_killed_llist));
+
+	mutex_lock(&cgroup_mutex);
+	llist_for_each_entry_safe(css, next, list, destroy_llnode) {
+		css_killed_one(css);
+
+		if (!(++nr % CSS_DESTROY_BATCH)) {
+			mutex_unlock(&cgroup_mutex);
+			cond_resched();
+			mutex_lock(&cgroup_mutex);
+		}
+	}
 	mutex_unlock(&cgroup_mutex);
 }
 
@@ -5617,8 +5668,8 @@ static void css_killed_ref_fn(struct percpu_ref *ref)
 		container_of(ref, struct cgroup_subsys_state, refcnt);
 
 	if (atomic_dec_and_test(&css->online_cnt)) {
-		INIT_WORK(&css->destroy_work, css_killed_work_fn);
-		queue_work(cgroup_destroy_wq, &css->destroy_work);
+		if (llist_add(&css->destroy_llnode, &css_killed_llist))
+			queue_work(cgroup_destroy_wq, &css_killed_work);
 	}
 }
 
@@ -6552,7 +6603,7 @@ struct cgroup_subsys_state *css_tryget_online_from_dir(struct dentry *dentry,
 	/*
 	 * This path doesn't originate from kernfs and @kn could already
 	 * have been or be removed at any point.  @kn->priv is RCU
-	 * protected for this access.  See css_release_work_fn() for details.
+	 * protected for this access.  See css_release_one() for details.
 	 */
 	cgrp = rcu_dereference(*(void __rcu __force **)&kn->priv);
 	if (cgrp)
@@ -7568,6 +7568,15 @@ __perf_event_output(struct perf_event *event,
 	/* protect the callchain buffers */
 	rcu_read_lock();
 
+	/*
+	 * Don't unwind the stack and copy registers for a sample that can't
+	 * even fit its fixed size part, it would be dropped anyway.
+	 */
+	if (perf_output_would_drop(event, sizeof(header) + event->header_size)) {
+		err = -ENOSPC;
+		goto exit;
+	}
+
 	perf_prepare_sample(&header, data, event, regs);
 
 	err = output_begin(&handle, data, event, header.size);
@@ -284,6 +284,44 @@ int perf_output_begin(struct perf_output_handle *handle,
 				   unlikely(is_write_backward(event)));
 }
 
+/*
+ * Tell whether a record of at least @size bytes would be dropped by
+ * perf_output_begin() right now, so that a sample can be discarded before
+ * its callchain and registers are collected. The record is accounted as
+ * lost just like __perf_output_begin() does. Must be called under
+ * rcu_read_lock().
+ */
+bool perf_output_would_drop(struct perf_event *event, unsigned int size)
+{
+	struct perf_buffer *rb;
+	unsigned long tail, head;
+
+	if (event->parent)
+		event = event->parent;
+
+	rb = rcu_dereference(event->rb);
+	if (unlikely(!rb))
+		return false;
+
+	if (unlikely(rb->paused)) {
+		if (rb->nr_pages)
+			local_inc(&rb->lost);
+		return true;
+	}
+
+	if (rb->overwrite)
+		return false;
+
+	tail = READ_ONCE(rb->user_page->data_tail);
+	head = local_read(&rb->head);
+	if (likely(ring_buffer_has_space(head, tail, perf_data_size(rb), size,
+					 unlikely(is_write_backward(event)))))
+		return false;
+
+	local_inc(&rb->lost);
+	return true;
+}
+
 unsigned int perf_output_copy(struct perf_output_handle *handle,
 		      const void *buf, unsigned int len)
 {
@@ -35,6 +35,16 @@ LOCK_EVENT(pv_wait_head)	/* # of vCPU wait's at the queue head	   */
 LOCK_EVENT(pv_wait_node)	/* # of vCPU wait's at non-head queue node */
 #endif /* CONFIG_PARAVIRT_SPINLOCKS */
 
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+/*
+ * Locking events for CNA qspinlock.
+ */
+LOCK_EVENT(cna_intra_node)	/* # of handoffs within the same node	   */
+LOCK_EVENT(cna_inter_node)	/* # of handoffs to a waiter on another node */
+LOCK_EVENT(cna_splice_next)	/* # of waiters moved to the secondary queue */
+LOCK_EVENT(cna_flush)		/* # of secondary queue flushes (threshold) */
+#endif /* CONFIG_NUMA_AWARE_SPINLOCKS */
+
 /*
  * Locking events for qspinlock
  *
@@ -27,6 +27,7 @@
 #include <linux/moduleparam.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/topology.h>
 #include <linux/torture.h>
 #include <linux/reboot.h>
 
@@ -61,10 +62,12 @@ static struct task_struct **reader_tasks;
 static bool lock_is_write_held;
 static atomic_t lock_is_read_held;
 static unsigned long last_lock_release;
+static int last_lock_node = NUMA_NO_NODE;
 
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	long n_lock_remote;	/* acquired after a holder on another node */
 };
 
 /* Forward reference. */
@@ -668,6 +671,7 @@ static int lock_torture_writer(void *arg)
 {
 	struct lock_stress_stats *lwsp = arg;
 	int tid = lwsp - cxt.lwsa;
+	int node;
 	DEFINE_TORTURE_RANDOM(rand);
 
 	VERBOSE_TOROUT_STRING("lock_torture_writer task started");
@@ -686,6 +690,13 @@ static int lock_torture_writer(void *arg)
 			lwsp->n_lock_fail++; /* rare, but... */
 
 		lwsp->n_lock_acquired++;
+
+		/* Count write-lock handoffs that crossed a NUMA node. */
+		node = numa_node_id();
+		if (last_lock_node != NUMA_NO_NODE && last_lock_node != node)
+			lwsp->n_lock_remote++;
+		last_lock_node = node;
+
 		cxt.cur_ops->write_delay(&rand);
 		lock_is_write_held = false;
 		WRITE_ONCE(last_lock_release, jiffies);
@@ -742,7 +753,7 @@ static void __torture_print_stats(char *page,
 	bool fail = false;
 	int i, n_stress;
 	long max = 0, min = statp ? data_race(statp[0].n_lock_acquired) : 0;
-	long long sum = 0;
+	long long sum = 0, remote = 0;
 
 	n_stress = write ? cxt.nrealwriters_stress : cxt.nrealreaders_stress;
 	for (i = 0; i < n_stress; i++) {
@@ -750,6 +761,7 @@ static void __torture_print_stats(char *page,
 			fail = true;
 		cur = data_race(statp[i].n_lock_acquired);
 		sum += cur;
+		remote += data_race(statp[i].n_lock_remote);
 		if (max < cur)
 			max = cur;
 		if (min > cur)
@@ -761,6 +773,9 @@ static void __torture_print_stats(char *page,
 			sum, max, min,
 			!onoff_interval && max / 2 > min ? "???" : "",
 			fail, fail ? "!!!" : "");
+	if (write && nr_node_ids > 1)
+		page += sprintf(page, "Writes:  Cross-node handoffs: %lld\n",
+				remote);
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
 }
@@ -968,6 +983,7 @@ static int __init lock_torture_init(void)
 	/* Initialize the statistics so that each run gets its own numbers. */
 	if (nwriters_stress) {
 		lock_is_write_held = false;
+		last_lock_node = NUMA_NO_NODE;
 		cxt.lwsa = kmalloc_array(cxt.nrealwriters_stress,
 					 sizeof(*cxt.lwsa),
 					 GFP_KERNEL);
@@ -980,6 +996,7 @@ static int __init lock_torture_init(void)
 		for (i = 0; i < cxt.nrealwriters_stress; i++) {
 			cxt.lwsa[i].n_lock_fail = 0;
 			cxt.lwsa[i].n_lock_acquired = 0;
+			cxt.lwsa[i].n_lock_remote = 0;
 		}
 	}
 
@@ -1012,6 +1029,7 @@ static int __init lock_torture_init(void)
 			for (i = 0; i < cxt.nrealreaders_stress; i++) {
 				cxt.lrsa[i].n_lock_fail = 0;
 				cxt.lrsa[i].n_lock_acquired = 0;
+				cxt.lrsa[i].n_lock_remote = 0;
 			}
 		}
 	}
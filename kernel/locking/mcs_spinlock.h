@@ -45,6 +45,16 @@ do {									\
 	smp_store_release((l), 1)
 #endif
 
+#ifndef arch_mcs_lock_handoff
+/*
+ * Same as arch_mcs_spin_unlock_contended(), except that the value stored
+ * into the successor's @locked field is @val rather than 1. The qspinlock
+ * slowpath uses it to pass state along with the MCS lock.
+ */
+#define arch_mcs_lock_handoff(l, val)					\
+	smp_store_release((l), (val))
+#endif
+
 /*
  * Note: the smp_load_acquire/smp_store_release pair is not
  * sufficient to form a full memory barrier across
@@ -11,7 +11,7 @@
  *          Peter Zijlstra <peterz@infradead.org>
  */
 
-#ifndef _GEN_PV_LOCK_SLOWPATH
+#if !defined(_GEN_PV_LOCK_SLOWPATH) && !defined(_GEN_CNA_LOCK_SLOWPATH)
 
 #include <linux/smp.h>
 #include <linux/bug.h>
@@ -20,6 +20,7 @@
 #include <linux/hardirq.h>
 #include <linux/mutex.h>
 #include <linux/prefetch.h>
+#include <linux/jump_label.h>
 #include <asm/byteorder.h>
 #include <asm/qspinlock.h>
 
@@ -77,10 +78,12 @@
  * to have more than 2 levels of slowpath nesting in actual use. We don't
  * want to penalize pvqspinlocks to optimize for a rare case in native
  * qspinlocks.
+ *
+ * The CNA slowpath keeps its per-waiter NUMA state in the same padding.
  */
 struct qnode {
 	struct mcs_spinlock mcs;
-#ifdef CONFIG_PARAVIRT_SPINLOCKS
+#if defined(CONFIG_PARAVIRT_SPINLOCKS) || defined(CONFIG_NUMA_AWARE_SPINLOCKS)
 	long reserved[2];
 #endif
 };
@@ -263,6 +266,33 @@ static __always_inline void set_locked(struct qspinlock *lock)
 	WRITE_ONCE(lock->locked, _Q_LOCKED_VAL);
 }
 
+/*
+ * __try_clear_tail - try to clear the tail and grab the lock when the queue
+ * head is the only waiter
+ * @lock: Pointer to queued spinlock structure
+ * @val : Current value of the queued spinlock 32-bit word
+ * @node: Pointer to the MCS node of the queue head
+ *
+ * Return: true if the lock was taken and no waiters are left
+ */
+static __always_inline bool __try_clear_tail(struct qspinlock *lock,
+					     u32 val,
+					     struct mcs_spinlock *node)
+{
+	return atomic_try_cmpxchg_relaxed(&lock->val, &val, _Q_LOCKED_VAL);
+}
+
+/*
+ * __mcs_lock_handoff - pass the MCS lock to the next waiter
+ * @node: Pointer to the MCS node of the current queue head
+ * @next: Pointer to the MCS node of the next waiter
+ */
+static __always_inline void __mcs_lock_handoff(struct mcs_spinlock *node,
+					       struct mcs_spinlock *next)
+{
+	arch_mcs_lock_handoff(&next->locked, 1);
+}
+
 
 /*
  * Generate the native code for queued_spin_unlock_slowpath(); provide NOPs for
@@ -285,11 +315,26 @@ static __always_inline u32  __pv_wait_head_or_lock(struct qspinlock *lock,
 #define pv_kick_node		__pv_kick_node
 #define pv_wait_head_or_lock	__pv_wait_head_or_lock
 
+#define try_clear_tail		__try_clear_tail
+#define mcs_lock_handoff	__mcs_lock_handoff
+
+/*
+ * With CONFIG_NUMA_AWARE_SPINLOCKS the native slowpath hands over to the CNA
+ * one once the numa_spinlock= boot option has enabled it.
+ */
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+static DEFINE_STATIC_KEY_FALSE(cna_lock_key);
+void __cna_queued_spin_lock_slowpath(struct qspinlock *lock, u32 val);
+#define cna_enabled()		static_branch_unlikely(&cna_lock_key)
+#else
+#define cna_enabled()		false
+#endif
+
 #ifdef CONFIG_PARAVIRT_SPINLOCKS
 #define queued_spin_lock_slowpath	native_queued_spin_lock_slowpath
 #endif
 
-#endif /* _GEN_PV_LOCK_SLOWPATH */
+#endif /* !_GEN_PV_LOCK_SLOWPATH && !_GEN_CNA_LOCK_SLOWPATH */
 
 /**
  * queued_spin_lock_slowpath - acquire the queued spinlock
@@ -320,6 +365,11 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 
 	BUILD_BUG_ON(CONFIG_NR_CPUS >= (1U << _Q_TAIL_CPU_BITS));
 
+	if (cna_enabled()) {
+		__cna_queued_spin_lock_slowpath(lock, val);
+		return;
+	}
+
 	if (pv_enabled())
 		goto pv_queue;
 
@@ -533,7 +583,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	 *       PENDING will make the uncontended transition fail.
 	 */
 	if ((val & _Q_TAIL_MASK) == tail) {
-		if (atomic_try_cmpxchg_relaxed(&lock->val, &val, _Q_LOCKED_VAL))
+		if (try_clear_tail(lock, val, node))
 			goto release; /* No contention */
 	}
 
@@ -550,7 +600,7 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 	if (!next)
 		next = smp_cond_load_relaxed(&node->next, (VAL));
 
-	arch_mcs_spin_unlock_contended(&next->locked);
+	mcs_lock_handoff(node, next);
 	pv_kick_node(lock, next);
 
 release:
@@ -561,12 +611,43 @@ void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
 }
 EXPORT_SYMBOL(queued_spin_lock_slowpath);
 
+/*
+ * Generate the code for the NUMA-aware (CNA) queued_spin_lock_slowpath().
+ */
+#if !defined(_GEN_CNA_LOCK_SLOWPATH) && defined(CONFIG_NUMA_AWARE_SPINLOCKS)
+#define _GEN_CNA_LOCK_SLOWPATH
+
+#undef  cna_enabled
+#define cna_enabled()		false
+
+#undef pv_init_node
+#define pv_init_node		cna_init_node
+
+#undef pv_wait_head_or_lock
+#define pv_wait_head_or_lock	cna_wait_head_or_lock
+
+#undef try_clear_tail
+#define try_clear_tail		cna_try_clear_tail
+
+#undef mcs_lock_handoff
+#define mcs_lock_handoff	cna_lock_handoff
+
+#undef  queued_spin_lock_slowpath
+#define queued_spin_lock_slowpath	__cna_queued_spin_lock_slowpath
+
+#include "qspinlock_cna.h"
+#include "qspinlock.c"
+#endif
+
 /*
  * Generate the paravirt code for queued_spin_unlock_slowpath().
  */
 #if !defined(_GEN_PV_LOCK_SLOWPATH) && defined(CONFIG_PARAVIRT_SPINLOCKS)
 #define _GEN_PV_LOCK_SLOWPATH
 
+#undef  cna_enabled
+#define cna_enabled()		false
+
 #undef  pv_enabled
 #define pv_enabled()	true
 
@@ -575,6 +656,12 @@ EXPORT_SYMBOL(queued_spin_lock_slowpath);
 #undef pv_kick_node
 #undef pv_wait_head_or_lock
 
+#undef try_clear_tail
+#define try_clear_tail		__try_clear_tail
+
+#undef mcs_lock_handoff
+#define mcs_lock_handoff	__mcs_lock_handoff
+
 #undef  queued_spin_lock_slowpath
 #define queued_spin_lock_slowpath	__pv_queued_spin_lock_slowpath
 
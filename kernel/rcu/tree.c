@@ -62,6 +62,8 @@
 #include <linux/vmalloc.h>
 #include <linux/mm.h>
 #include <linux/kasan.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "../time/tick-internal.h"
 
 #include "tree.h"
@@ -2964,7 +2966,7 @@ static void check_cb_ovld(struct rcu_data *rdp)
 
 /* Helper function for call_rcu() and friends.  */
 static void
-__call_rcu(struct rcu_head *head, rcu_callback_t func)
+__call_rcu(struct rcu_head *head, rcu_callback_t func, bool lazy)
 {
 	static atomic_t doublefrees;
 	unsigned long flags;
@@ -3005,7 +3007,7 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func)
 	}
 
 	check_cb_ovld(rdp);
-	if (rcu_nocb_try_bypass(rdp, head, &was_alldone, flags))
+	if (rcu_nocb_try_bypass(rdp, head, &was_alldone, flags, lazy))
 		return; // Enqueued onto ->nocb_bypass, so just leave.
 	// If no-CBs CPU gets here, rcu_nocb_try_bypass() acquired ->nocb_lock.
 	rcu_segcblist_enqueue(&rdp->cblist, head);
@@ -3070,10 +3072,31 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func)
  */
 void call_rcu(struct rcu_head *head, rcu_callback_t func)
 {
-	__call_rcu(head, func);
+	__call_rcu(head, func, false);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
+#ifdef CONFIG_RCU_LAZY
+/**
+ * call_rcu_lazy() - Queue a non-urgent RCU callback.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * Same as call_rcu(), except that on no-CBs CPUs the callback may be
+ * held back for up to rcutree.nocb_lazy_flush_ms, so that many of them
+ * share one grace period and one wakeup of the callback kthreads.  Use
+ * it for callbacks that only free memory and that nobody waits for.
+ * Anything else such a callback releases, a module or netns reference or
+ * accounted memory for instance, stays held for that long as well.
+ * rcu_barrier() still waits for lazy callbacks.
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	__call_rcu(head, func, true);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+#endif
+
 
 /* Maximum number of jiffies to wait before draining a batch. */
 #define KFREE_DRAIN_JIFFIES (HZ / 50)
@@ -3135,6 +3158,10 @@ struct kfree_rcu_cpu_work {
  * @work_in_progress: Indicates that page_cache_work is running
  * @hrtimer: A hrtimer for scheduling a page_cache_work
  * @nr_bkv_objs: number of allocated objects at @bkvcache.
+ * @nr_batches: Number of batches handed to a grace period
+ * @nr_bulk_freed: Number of objects freed from page blocks
+ * @nr_list_freed: Number of objects freed through their rcu_head
+ * @nr_inline_freed: Number of objects freed after synchronize_rcu()
  *
  * This is a per-CPU structure.  The reason that it is not included in
  * the rcu_data structure is to permit this code to be extracted from
@@ -3158,6 +3185,11 @@ struct kfree_rcu_cpu {
 
 	struct llist_head bkvcache;
 	int nr_bkv_objs;
+
+	atomic_long_t nr_batches;
+	atomic_long_t nr_bulk_freed;
+	atomic_long_t nr_list_freed;
+	atomic_long_t nr_inline_freed;
 };
 
 static DEFINE_PER_CPU(struct kfree_rcu_cpu, krc) = {
@@ -3248,6 +3280,7 @@ static void kfree_rcu_work(struct work_struct *work)
 	struct rcu_head *head, *next;
 	struct kfree_rcu_cpu *krcp;
 	struct kfree_rcu_cpu_work *krwp;
+	long nr_freed = 0;
 	int i, j;
 
 	krwp = container_of(to_rcu_work(work),
@@ -3290,6 +3323,7 @@ static void kfree_rcu_work(struct work_struct *work)
 				}
 			}
 			rcu_lock_release(&rcu_callback_map);
+			nr_freed += bkvhead[i]->nr_records;
 
 			raw_spin_lock_irqsave(&krcp->lock, flags);
 			if (put_cached_bnode(krcp, bkvhead[i]))
@@ -3302,6 +3336,8 @@ static void kfree_rcu_work(struct work_struct *work)
 			cond_resched_tasks_rcu_qs();
 		}
 	}
+	atomic_long_add(nr_freed, &krcp->nr_bulk_freed);
+	nr_freed = 0;
 
 	/*
 	 * This is used when the "bulk" path can not be used for the
@@ -3323,8 +3359,10 @@ static void kfree_rcu_work(struct work_struct *work)
 			kvfree(ptr);
 
 		rcu_lock_release(&rcu_callback_map);
+		nr_freed++;
 		cond_resched_tasks_rcu_qs();
 	}
+	atomic_long_add(nr_freed, &krcp->nr_list_freed);
 }
 
 /*
@@ -3375,6 +3413,7 @@ static void kfree_rcu_monitor(struct work_struct *work)
 			// channels have been detached following by each
 			// other.
 			queue_rcu_work(system_wq, &krwp->rcu_work);
+			atomic_long_inc(&krcp->nr_batches);
 		}
 	}
 
@@ -3591,6 +3630,7 @@ void kvfree_call_rcu(struct rcu_head *head, rcu_callback_t func)
 		debug_rcu_head_unqueue((struct rcu_head *) ptr);
 		synchronize_rcu();
 		kvfree(ptr);
+		atomic_long_inc(&krcp->nr_inline_freed);
 	}
 }
 EXPORT_SYMBOL_GPL(kvfree_call_rcu);
@@ -3643,6 +3683,41 @@ static struct shrinker kfree_rcu_shrinker = {
 	.seeks = DEFAULT_SEEKS,
 };
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Per-CPU kvfree_rcu() statistics: batches handed to a grace period,
+ * objects freed in bulk from page blocks, one by one through their
+ * rcu_head when no page block was available, and inline after
+ * synchronize_rcu() for single-argument callers.
+ */
+static int kfree_rcu_stats_show(struct seq_file *m, void *v)
+{
+	struct kfree_rcu_cpu *krcp;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		krcp = per_cpu_ptr(&krc, cpu);
+		seq_printf(m, "cpu%d: batches %ld bulk %ld list %ld inline %ld pending %d cached %d\n",
+			   cpu, atomic_long_read(&krcp->nr_batches),
+			   atomic_long_read(&krcp->nr_bulk_freed),
+			   atomic_long_read(&krcp->nr_list_freed),
+			   atomic_long_read(&krcp->nr_inline_freed),
+			   READ_ONCE(krcp->count),
+			   READ_ONCE(krcp->nr_bkv_objs));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(kfree_rcu_stats);
+
+static int __init kfree_rcu_debugfs_init(void)
+{
+	debugfs_create_file("kfree_rcu_stats", 0444, NULL, NULL,
+			    &kfree_rcu_stats_fops);
+	return 0;
+}
+late_initcall(kfree_rcu_debugfs_init);
+#endif /* #ifdef CONFIG_DEBUG_FS */
+
 void __init kfree_rcu_scheduler_running(void)
 {
 	int cpu;
@@ -3957,12 +4032,20 @@ static void rcu_barrier_func(void *cpu_in)
 {
 	uintptr_t cpu = (uintptr_t)cpu_in;
 	struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
+	bool wake_nocb;
 
 	rcu_barrier_trace(TPS("IRQ"), -1, rcu_state.barrier_sequence);
 	rdp->barrier_head.func = rcu_barrier_callback;
 	debug_rcu_head_queue(&rdp->barrier_head);
 	rcu_nocb_lock(rdp);
+	/*
+	 * Callbacks flushed from ->nocb_bypass could otherwise wait for
+	 * the lazy timer of the no-CBs GP kthread.
+	 */
+	wake_nocb = rcu_rdp_is_offloaded(rdp) &&
+		    !rcu_segcblist_pend_cbs(&rdp->cblist);
 	WARN_ON_ONCE(!rcu_nocb_flush_bypass(rdp, NULL, jiffies));
+	wake_nocb = wake_nocb && rcu_segcblist_pend_cbs(&rdp->cblist);
 	if (rcu_segcblist_entrain(&rdp->cblist, &rdp->barrier_head)) {
 		atomic_inc(&rcu_state.barrier_cpu_count);
 	} else {
@@ -3971,6 +4054,8 @@ static void rcu_barrier_func(void *cpu_in)
 				  rcu_state.barrier_sequence);
 	}
 	rcu_nocb_unlock(rdp);
+	if (wake_nocb)
+		wake_nocb_gp(rdp, false);
 }
 
 /**
@@ -86,6 +86,19 @@ early_param("rcu_nocb_poll", parse_rcu_nocb_poll);
 static int nocb_nobypass_lim_per_jiffy = 16 * 1000 / HZ;
 module_param(nocb_nobypass_lim_per_jiffy, int, 0);
 
+/*
+ * Callbacks queued by call_rcu_lazy() wait on ->nocb_bypass for up to
+ * this long, or until qhimark of them have piled up, before being handed
+ * to a grace period.
+ */
+static unsigned int nocb_lazy_flush_ms = 10 * MSEC_PER_SEC;
+module_param(nocb_lazy_flush_ms, uint, 0644);
+
+static unsigned long rcu_lazy_flush_jiffies(void)
+{
+	return msecs_to_jiffies(READ_ONCE(nocb_lazy_flush_ms));
+}
+
 /*
  * Acquire the specified rcu_data structure's ->nocb_bypass_lock.  If the
  * lock isn't immediately available, increment ->nocb_lock_contended to
@@ -274,10 +287,17 @@ static void wake_nocb_gp_defer(struct rcu_data *rdp, int waketype,
 	raw_spin_lock_irqsave(&rdp_gp->nocb_gp_lock, flags);
 
 	/*
-	 * Bypass wakeup overrides previous deferments. In case
-	 * of callback storm, no need to wake up too early.
+	 * Lazy wakeup never delays an earlier deferment. Bypass wakeup
+	 * overrides previous deferments. In case of callback storm, no
+	 * need to wake up too early.
 	 */
-	if (waketype == RCU_NOCB_WAKE_BYPASS) {
+	if (waketype == RCU_NOCB_WAKE_LAZY) {
+		if (rdp_gp->nocb_defer_wakeup == RCU_NOCB_WAKE_NOT) {
+			mod_timer(&rdp_gp->nocb_timer,
+				  jiffies + rcu_lazy_flush_jiffies());
+			WRITE_ONCE(rdp_gp->nocb_defer_wakeup, waketype);
+		}
+	} else if (waketype == RCU_NOCB_WAKE_BYPASS) {
 		mod_timer(&rdp_gp->nocb_timer, jiffies + 2);
 		WRITE_ONCE(rdp_gp->nocb_defer_wakeup, waketype);
 	} else {
@@ -318,6 +338,7 @@ static bool rcu_nocb_do_flush_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 	rcu_cblist_flush_enqueue(&rcl, &rdp->nocb_bypass, rhp);
 	rcu_segcblist_insert_pend_cbs(&rdp->cblist, &rcl);
 	WRITE_ONCE(rdp->nocb_bypass_first, j);
+	WRITE_ONCE(rdp->lazy_len, 0);
 	rcu_nocb_bypass_unlock(rdp);
 	return true;
 }
@@ -366,18 +387,25 @@ static void rcu_nocb_try_flush_bypass(struct rcu_data *rdp, unsigned long j)
  * non-empty, the corresponding no-CBs grace-period kthread must not be
  * in an indefinite sleep state.
  *
+ * Lazy callbacks always go to ->nocb_bypass.  As long as it holds
+ * nothing else, it is flushed only once it has been waiting for
+ * nocb_lazy_flush_ms or has grown to qhimark callbacks, and the no-CBs
+ * grace-period kthread is only armed with a timer of that length.
+ *
  * Finally, it is not permitted to use the bypass during early boot,
  * as doing so would confuse the auto-initialization code.  Besides
  * which, there is no point in worrying about lock contention while
  * there is only one CPU in operation.
  */
 static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
-				bool *was_alldone, unsigned long flags)
+				bool *was_alldone, unsigned long flags,
+				bool lazy)
 {
 	unsigned long c;
 	unsigned long cur_gp_seq;
 	unsigned long j = jiffies;
 	long ncbs = rcu_cblist_n_cbs(&rdp->nocb_bypass);
+	bool bypass_is_lazy = ncbs && ncbs == READ_ONCE(rdp->lazy_len);
 
 	lockdep_assert_irqs_disabled();
 
@@ -421,8 +449,8 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 
 	// If there hasn't yet been all that many ->cblist enqueues
 	// this jiffy, tell the caller to enqueue onto ->cblist.  But flush
-	// ->nocb_bypass first.
-	if (rdp->nocb_nobypass_count < nocb_nobypass_lim_per_jiffy) {
+	// ->nocb_bypass first.  Lazy callbacks are never in a hurry.
+	if (!lazy && rdp->nocb_nobypass_count < nocb_nobypass_lim_per_jiffy) {
 		rcu_nocb_lock(rdp);
 		*was_alldone = !rcu_segcblist_pend_cbs(&rdp->cblist);
 		if (*was_alldone)
@@ -435,7 +463,11 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 
 	// If ->nocb_bypass has been used too long or is too full,
 	// flush ->nocb_bypass to ->cblist.
-	if ((ncbs && j != READ_ONCE(rdp->nocb_bypass_first)) ||
+	if ((ncbs && !bypass_is_lazy &&
+	     j != READ_ONCE(rdp->nocb_bypass_first)) ||
+	    (bypass_is_lazy &&
+	     time_after(j, READ_ONCE(rdp->nocb_bypass_first) +
+			   rcu_lazy_flush_jiffies())) ||
 	    ncbs >= qhimark) {
 		rcu_nocb_lock(rdp);
 		if (!rcu_nocb_flush_bypass(rdp, rhp, j)) {
@@ -453,6 +485,15 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 			rdp->nocb_gp_adv_time = j;
 		}
 		rcu_nocb_unlock_irqrestore(rdp, flags);
+		// The GP kthread may be waiting for the lazy timer, which
+		// can be far ahead, so get it to look at the flushed CBs.
+		if (bypass_is_lazy) {
+			if (!irqs_disabled_flags(flags))
+				wake_nocb_gp(rdp, false);
+			else
+				wake_nocb_gp_defer(rdp, RCU_NOCB_WAKE,
+						   TPS("WakeLazyIsDeferred"));
+		}
 		return true; // Callback already enqueued.
 	}
 
@@ -462,6 +503,8 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 	ncbs = rcu_cblist_n_cbs(&rdp->nocb_bypass);
 	rcu_segcblist_inc_len(&rdp->cblist); /* Must precede enqueue. */
 	rcu_cblist_enqueue(&rdp->nocb_bypass, rhp);
+	if (lazy)
+		WRITE_ONCE(rdp->lazy_len, rdp->lazy_len + 1);
 	if (!ncbs) {
 		WRITE_ONCE(rdp->nocb_bypass_first, j);
 		trace_rcu_nocb_wake(rcu_state.name, rdp->cpu, TPS("FirstBQ"));
@@ -470,10 +513,19 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 	smp_mb(); /* Order enqueue before wake. */
 	if (ncbs) {
 		local_irq_restore(flags);
+		// Don't leave a non-lazy CB waiting for the lazy timer.
+		if (bypass_is_lazy && !lazy)
+			wake_nocb_gp_defer(rdp, RCU_NOCB_WAKE_BYPASS,
+					   TPS("WakeBypassNotLazy"));
 	} else {
 		// No-CBs GP kthread might be indefinitely asleep, if so, wake.
+		// For lazy CBs it is enough to do so once they are due.
 		rcu_nocb_lock(rdp); // Rare during call_rcu() flood.
-		if (!rcu_segcblist_pend_cbs(&rdp->cblist)) {
+		if (!rcu_segcblist_pend_cbs(&rdp->cblist) && lazy) {
+			rcu_nocb_unlock_irqrestore(rdp, flags);
+			wake_nocb_gp_defer(rdp, RCU_NOCB_WAKE_LAZY,
+					   TPS("FirstLazyBQwake"));
+		} else if (!rcu_segcblist_pend_cbs(&rdp->cblist)) {
 			trace_rcu_nocb_wake(rcu_state.name, rdp->cpu,
 					    TPS("FirstBQwake"));
 			__call_rcu_nocb_wake(rdp, true, flags);
@@ -607,6 +659,8 @@ static void nocb_gp_wait(struct rcu_data *my_rdp)
 {
 	bool bypass = false;
 	long bypass_ncbs;
+	bool lazy = false;
+	long lazy_ncbs;
 	int __maybe_unused cpu = my_rdp->cpu;
 	unsigned long cur_gp_seq;
 	unsigned long flags;
@@ -640,19 +694,27 @@ static void nocb_gp_wait(struct rcu_data *my_rdp)
 			continue;
 		}
 		bypass_ncbs = rcu_cblist_n_cbs(&rdp->nocb_bypass);
+		lazy_ncbs = READ_ONCE(rdp->lazy_len);
 		if (bypass_ncbs &&
-		    (time_after(j, READ_ONCE(rdp->nocb_bypass_first) + 1) ||
+		    (time_after(j, READ_ONCE(rdp->nocb_bypass_first) +
+				   (bypass_ncbs == lazy_ncbs ?
+				    rcu_lazy_flush_jiffies() : 1)) ||
 		     bypass_ncbs > 2 * qhimark)) {
 			// Bypass full or old, so flush it.
 			(void)rcu_nocb_try_flush_bypass(rdp, j);
 			bypass_ncbs = rcu_cblist_n_cbs(&rdp->nocb_bypass);
+			lazy_ncbs = READ_ONCE(rdp->lazy_len);
 		} else if (!bypass_ncbs && rcu_segcblist_empty(&rdp->cblist)) {
 			rcu_nocb_unlock_irqrestore(rdp, flags);
 			if (needwake_state)
 				swake_up_one(&rdp->nocb_state_wq);
 			continue; /* No callbacks here, try next. */
 		}
-		if (bypass_ncbs) {
+		if (bypass_ncbs && bypass_ncbs == lazy_ncbs) {
+			trace_rcu_nocb_wake(rcu_state.name, rdp->cpu,
+					    TPS("Lazy"));
+			lazy = true;
+		} else if (bypass_ncbs) {
 			trace_rcu_nocb_wake(rcu_state.name, rdp->cpu,
 					    TPS("Bypass"));
 			bypass = true;
@@ -710,6 +772,10 @@ static void nocb_gp_wait(struct rcu_data *my_rdp)
 		// timer in order to avoid stranding its callbacks.
 		wake_nocb_gp_defer(my_rdp, RCU_NOCB_WAKE_BYPASS,
 				   TPS("WakeBypassIsDeferred"));
+	} else if (lazy && !rcu_nocb_poll) {
+		// Only lazy CBs are waiting, come back once they are due.
+		wake_nocb_gp_defer(my_rdp, RCU_NOCB_WAKE_LAZY,
+				   TPS("WakeLazyIsDeferred"));
 	}
 	if (rcu_nocb_poll) {
 		/* Polling, so trace if first poll in the series. */
@@ -909,7 +975,7 @@ static void do_nocb_deferred_wakeup_timer(struct timer_list *t)
 
 	raw_spin_lock_irqsave(&rdp->nocb_gp_lock, flags);
 	smp_mb__after_spinlock(); /* Timer expire before wakeup. */
-	do_nocb_deferred_wakeup_common(rdp, rdp, RCU_NOCB_WAKE_BYPASS, flags);
+	do_nocb_deferred_wakeup_common(rdp, rdp, RCU_NOCB_WAKE_LAZY, flags);
 }
 
 /*
@@ -1111,6 +1177,59 @@ int rcu_nocb_cpu_offload(int cpu)
 }
 EXPORT_SYMBOL_GPL(rcu_nocb_cpu_offload);
 
+#ifdef CONFIG_RCU_LAZY
+static unsigned long
+lazy_rcu_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	/* Snapshot count of all CPUs */
+	for_each_cpu(cpu, rcu_nocb_mask)
+		count += READ_ONCE(per_cpu_ptr(&rcu_data, cpu)->lazy_len);
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/*
+ * Under memory pressure, make the lazy callbacks look like ordinary
+ * bypass ones, so that the GP kthread flushes them on its next pass.
+ */
+static unsigned long
+lazy_rcu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long count = 0;
+	unsigned long flags;
+	long nr;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
+
+		nr = READ_ONCE(rdp->lazy_len);
+		if (!nr)
+			continue;
+		rcu_nocb_lock_irqsave(rdp, flags);
+		WRITE_ONCE(rdp->lazy_len, 0);
+		rcu_nocb_unlock_irqrestore(rdp, flags);
+		wake_nocb_gp(rdp, false);
+		sc->nr_to_scan -= nr;
+		count += nr;
+		if (sc->nr_to_scan <= 0)
+			break;
+	}
+
+	return count ? count : SHRINK_STOP;
+}
+
+static struct shrinker lazy_rcu_shrinker = {
+	.count_objects = lazy_rcu_shrink_count,
+	.scan_objects = lazy_rcu_shrink_scan,
+	.batch = 0,
+	.seeks = DEFAULT_SEEKS,
+};
+#endif /* #ifdef CONFIG_RCU_LAZY */
+
 void __init rcu_init_nohz(void)
 {
 	int cpu;
@@ -1149,6 +1268,11 @@ void __init rcu_init_nohz(void)
 	if (rcu_nocb_poll)
 		pr_info("\tPoll for callbacks from no-CBs CPUs.\n");
 
+#ifdef CONFIG_RCU_LAZY
+	if (register_shrinker(&lazy_rcu_shrinker))
+		pr_err("Failed to register lazy_rcu shrinker!\n");
+#endif
+
 	for_each_cpu(cpu, rcu_nocb_mask) {
 		rdp = per_cpu_ptr(&rcu_data, cpu);
 		if (rcu_segcblist_empty(&rdp->cblist))
@@ -1456,7 +1580,13 @@ static bool rcu_nocb_flush_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 }
 
 static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
-				bool *was_alldone, unsigned long flags)
+				bool *was_alldone, unsigned long flags,
+				bool lazy)
+{
+	return false;
+}
+
+static bool wake_nocb_gp(struct rcu_data *rdp, bool force)
 {
 	return false;
 }
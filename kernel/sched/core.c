@@ -16,6 +16,7 @@
 
 #include <linux/kcov.h>
 #include <linux/scs.h>
+#include <linux/lru_gen.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -141,7 +142,7 @@ static inline bool __sched_core_less(struct task_struct *a, struct task_struct *
 		return false;
 
 	/* flip prio, so high prio is leftmost */
-	if (prio_less(b, a, task_rq(a)->core->core_forceidle))
+	if (prio_less(b, a, !!task_rq(a)->core->core_forceidle_count))
 		return true;
 
 	return false;
@@ -171,6 +172,7 @@ static inline int rb_sched_core_cmp(const void *key, const struct rb_node *node)
 void sched_core_enqueue(struct rq *rq, struct task_struct *p)
 {
 	rq->core->core_task_seq++;
+	rq->core_rq_seq++;
 
 	if (!p->core_cookie)
 		return;
@@ -181,6 +183,7 @@ void sched_core_enqueue(struct rq *rq, struct task_struct *p)
 void sched_core_dequeue(struct rq *rq, struct task_struct *p)
 {
 	rq->core->core_task_seq++;
+	rq->core_rq_seq++;
 
 	if (!sched_core_enqueued(p))
 		return;
@@ -274,8 +277,10 @@ static void __sched_core_flip(bool enabled)
 
 		sched_core_lock(cpu, &flags);
 
-		for_each_cpu(t, smt_mask)
+		for_each_cpu(t, smt_mask) {
 			cpu_rq(t)->core_enabled = enabled;
+			cpu_rq(t)->core_cache_class = NULL;
+		}
 
 		sched_core_unlock(cpu, &flags);
 
@@ -288,8 +293,10 @@ static void __sched_core_flip(bool enabled)
 	cpumask_copy(&sched_core_mask, cpu_possible_mask);
 	cpumask_andnot(&sched_core_mask, &sched_core_mask, cpu_online_mask);
 
-	for_each_cpu(cpu, &sched_core_mask)
+	for_each_cpu(cpu, &sched_core_mask) {
 		cpu_rq(cpu)->core_enabled = enabled;
+		cpu_rq(cpu)->core_cache_class = NULL;
+	}
 
 	cpus_read_unlock();
 }
@@ -4241,7 +4248,9 @@ DEFINE_STATIC_KEY_FALSE(sched_numa_balancing);
 
 #ifdef CONFIG_NUMA_BALANCING
 
-void set_numabalancing_state(bool enabled)
+int sysctl_numa_balancing_mode;
+
+static void __set_numabalancing_state(bool enabled)
 {
 	if (enabled)
 		static_branch_enable(&sched_numa_balancing);
@@ -4249,13 +4258,22 @@ void set_numabalancing_state(bool enabled)
 		static_branch_disable(&sched_numa_balancing);
 }
 
+void set_numabalancing_state(bool enabled)
+{
+	if (enabled)
+		sysctl_numa_balancing_mode = NUMA_BALANCING_NORMAL;
+	else
+		sysctl_numa_balancing_mode = NUMA_BALANCING_DISABLED;
+	__set_numabalancing_state(enabled);
+}
+
 #ifdef CONFIG_PROC_SYSCTL
 int sysctl_numa_balancing(struct ctl_table *table, int write,
 			  void *buffer, size_t *lenp, loff_t *ppos)
 {
 	struct ctl_table t;
 	int err;
-	int state = static_branch_likely(&sched_numa_balancing);
+	int state = sysctl_numa_balancing_mode;
 
 	if (write && !capable(CAP_SYS_ADMIN))
 		return -EPERM;
@@ -4265,8 +4283,10 @@ int sysctl_numa_balancing(struct ctl_table *table, int write,
 	err = proc_dointvec_minmax(&t, write, buffer, lenp, ppos);
 	if (err < 0)
 		return err;
-	if (write)
-		set_numabalancing_state(state);
+	if (write) {
+		sysctl_numa_balancing_mode = state;
+		__set_numabalancing_state(state);
+	}
 	return err;
 }
 #endif
@@ -4367,6 +4387,9 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		} else if (PRIO_TO_NICE(p->static_prio) < 0)
 			p->static_prio = NICE_TO_PRIO(0);
 
+		if (p->se.latency_nice < DEFAULT_LATENCY_NICE)
+			p->se.latency_nice = DEFAULT_LATENCY_NICE;
+
 		p->prio = p->normal_prio = p->static_prio;
 		set_load_weight(p, false);
 
@@ -4978,6 +5001,7 @@ context_switch(struct rq *rq, struct task_struct *prev,
 		 * finish_task_switch()'s mmdrop().
 		 */
 		switch_mm_irqs_off(prev->active_mm, next->mm, next);
+		lru_gen_use_mm(next->mm);
 
 		if (!prev->mm) {                        // from kernel
 			/* will mmdrop() in finish_task_switch(). */
@@ -5263,6 +5287,7 @@ void scheduler_tick(void)
 	thermal_pressure = arch_scale_thermal_pressure(cpu_of(rq));
 	update_thermal_load_avg(rq_clock_thermal(rq), rq, thermal_pressure);
 	curr->sched_class->task_tick(rq, curr, 0);
+	sched_core_tick(rq);
 	if (sched_feat(LATENCY_WARN))
 		resched_latency = cpu_resched_latency(rq);
 	calc_global_load_tick(rq);
@@ -5276,6 +5301,8 @@ void scheduler_tick(void)
 
 #ifdef CONFIG_SMP
 	rq->idle_balance = idle_cpu(cpu);
+	if (!rq->idle_balance)
+		update_idle_cpumask(cpu, false);
 	trigger_load_balance(rq);
 #endif
 }
@@ -5657,6 +5684,45 @@ static inline bool cookie_match(struct task_struct *a, struct task_struct *b)
 	return a->core_cookie == b->core_cookie;
 }
 
+/*
+ * Core-wide selection walks the classes of every sibling from the top down
+ * and stops at the first one that has a runnable task. The walk is repeated
+ * whenever the selection has to start over because of a cookie mismatch,
+ * and again by every sibling that schedules before anything changed on the
+ * runqueue. Remember the first non-empty class and its pick until the next
+ * {en,de}queue or tick on @rq.
+ */
+static struct task_struct *
+sched_core_pick_class(struct rq *rq, const struct sched_class *class)
+{
+	const struct sched_class *c;
+	struct task_struct *p = NULL;
+
+	if (!sched_feat(CORE_PICK_CACHE))
+		return class->pick_task(rq);
+
+	if (!rq->core_cache_class || rq->core_cache_seq != rq->core_rq_seq) {
+		for_each_class(c) {
+			p = c->pick_task(rq);
+			if (p)
+				break;
+		}
+
+		rq->core_cache_class = c;
+		rq->core_cache_pick = p;
+		rq->core_cache_seq = rq->core_rq_seq;
+	}
+
+	if (class == rq->core_cache_class)
+		return rq->core_cache_pick;
+
+	/* Every class above the cached one is known to be empty. */
+	if (class > rq->core_cache_class)
+		return NULL;
+
+	return class->pick_task(rq);
+}
+
 // XXX fairness/fwd progress conditions
 /*
  * Returns
@@ -5671,7 +5737,7 @@ pick_task(struct rq *rq, const struct sched_class *class, struct task_struct *ma
 	struct task_struct *class_pick, *cookie_pick;
 	unsigned long cookie = rq->core->core_cookie;
 
-	class_pick = class->pick_task(rq);
+	class_pick = sched_core_pick_class(rq, class);
 	if (!class_pick)
 		return NULL;
 
@@ -5716,6 +5782,7 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 	const struct sched_class *class;
 	const struct cpumask *smt_mask;
 	bool fi_before = false;
+	bool core_clock_updated = (rq == rq->core);
 	int i, j, cpu, occ = 0;
 	bool need_sync;
 
@@ -5766,10 +5833,18 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 
 	/* reset state */
 	rq->core->core_cookie = 0UL;
-	if (rq->core->core_forceidle) {
+	if (rq->core->core_forceidle_count) {
+		if (!core_clock_updated) {
+			update_rq_clock(rq->core);
+			core_clock_updated = true;
+		}
+		sched_core_account_forceidle(rq);
+		/* reset after accounting force idle */
+		rq->core->core_forceidle_start = 0;
+		rq->core->core_forceidle_count = 0;
+		rq->core->core_forceidle_occupation = 0;
 		need_sync = true;
 		fi_before = true;
-		rq->core->core_forceidle = false;
 	}
 
 	/*
@@ -5812,7 +5887,7 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 
 		rq_i->core_pick = NULL;
 
-		if (i != cpu)
+		if (i != cpu && (rq_i != rq->core || !core_clock_updated))
 			update_rq_clock(rq_i);
 	}
 
@@ -5844,7 +5919,7 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 
 			rq_i->core_pick = p;
 			if (rq_i->idle == p && rq_i->nr_running) {
-				rq->core->core_forceidle = true;
+				rq->core->core_forceidle_count++;
 				if (!fi_before)
 					rq->core->core_forceidle_seq++;
 			}
@@ -5866,7 +5941,7 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 				max = p;
 
 				if (old_max) {
-					rq->core->core_forceidle = false;
+					rq->core->core_forceidle_count = 0;
 					for_each_cpu(j, smt_mask) {
 						if (j == i)
 							continue;
@@ -5884,6 +5959,11 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 	next = rq->core_pick;
 	rq->core_sched_seq = rq->core->core_pick_seq;
 
+	if (schedstat_enabled() && rq->core->core_forceidle_count) {
+		rq->core->core_forceidle_start = rq_clock(rq->core);
+		rq->core->core_forceidle_occupation = occ;
+	}
+
 	/* Something should have been selected for current CPU */
 	WARN_ON_ONCE(!next);
 
@@ -5916,8 +5996,8 @@ pick_next_task(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 		 *  1            0       1
 		 *  1            1       0
 		 */
-		if (!(fi_before && rq->core->core_forceidle))
-			task_vruntime_update(rq_i, rq_i->core_pick, rq->core->core_forceidle);
+		if (!(fi_before && rq->core->core_forceidle_count))
+			task_vruntime_update(rq_i, rq_i->core_pick, !!rq->core->core_forceidle_count);
 
 		rq_i->core_pick->core_occupation = occ;
 
@@ -6124,8 +6204,16 @@ static void sched_core_cpu_deactivate(unsigned int cpu)
 	core_rq->core_task_seq      = rq->core_task_seq;
 	core_rq->core_pick_seq      = rq->core_pick_seq;
 	core_rq->core_cookie        = rq->core_cookie;
-	core_rq->core_forceidle     = rq->core_forceidle;
+	core_rq->core_forceidle_count = rq->core_forceidle_count;
 	core_rq->core_forceidle_seq = rq->core_forceidle_seq;
+	core_rq->core_forceidle_occupation = rq->core_forceidle_occupation;
+
+	/*
+	 * Accounting edge for forced idle is handled in pick_next_task().
+	 * Don't need another one here, since the hotplug thread shouldn't
+	 * have a cookie.
+	 */
+	core_rq->core_forceidle_start = 0;
 
 	/* install new leader */
 	for_each_cpu(t, smt_mask) {
@@ -7266,6 +7354,13 @@ static bool check_same_owner(struct task_struct *p)
 	return match;
 }
 
+static void __setscheduler_latency(struct task_struct *p,
+				   const struct sched_attr *attr)
+{
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE)
+		p->se.latency_nice = attr->sched_latency_nice;
+}
+
 static int __sched_setscheduler(struct task_struct *p,
 				const struct sched_attr *attr,
 				bool user, bool pi)
@@ -7307,6 +7402,12 @@ static int __sched_setscheduler(struct task_struct *p,
 	    (rt_policy(policy) != (attr->sched_priority != 0)))
 		return -EINVAL;
 
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE) {
+		if (attr->sched_latency_nice > MAX_LATENCY_NICE ||
+		    attr->sched_latency_nice < MIN_LATENCY_NICE)
+			return -EINVAL;
+	}
+
 	/*
 	 * Allow unprivileged RT tasks to decrease priority:
 	 */
@@ -7356,6 +7457,11 @@ static int __sched_setscheduler(struct task_struct *p,
 		/* Normal users shall not reset the sched_reset_on_fork flag: */
 		if (p->sched_reset_on_fork && !reset_on_fork)
 			return -EPERM;
+
+		/* Can't ask for lower latency than what we already have: */
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice < p->se.latency_nice)
+			return -EPERM;
 	}
 
 	if (user) {
@@ -7408,6 +7514,9 @@ static int __sched_setscheduler(struct task_struct *p,
 			goto change;
 		if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP)
 			goto change;
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice != p->se.latency_nice)
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		retval = 0;
@@ -7432,14 +7541,23 @@ static int __sched_setscheduler(struct task_struct *p,
 		if (dl_bandwidth_enabled() && dl_policy(policy) &&
 				!(attr->sched_flags & SCHED_FLAG_SUGOV)) {
 			cpumask_t *span = rq->rd->span;
+			bool fits;
 
 			/*
 			 * Don't allow tasks with an affinity mask smaller than
-			 * the entire root_domain to become SCHED_DEADLINE. We
-			 * will also fail if there's no bandwidth available.
+			 * the entire root_domain to become SCHED_DEADLINE,
+			 * unless they ask for partitioned admission, which
+			 * in turn requires them to be pinned to one CPU and
+			 * to be on it already, since that is the CPU charged.
+			 * We will also fail if there's no bandwidth available.
 			 */
-			if (!cpumask_subset(span, p->cpus_ptr) ||
-			    rq->rd->dl_bw.bw == 0) {
+			if (attr->sched_flags & SCHED_FLAG_DL_PARTITIONED)
+				fits = p->nr_cpus_allowed == 1 &&
+				       cpumask_test_cpu(task_cpu(p), p->cpus_ptr);
+			else
+				fits = cpumask_subset(span, p->cpus_ptr);
+
+			if (!fits || rq->rd->dl_bw.bw == 0) {
 				retval = -EPERM;
 				goto unlock;
 			}
@@ -7497,6 +7615,7 @@ static int __sched_setscheduler(struct task_struct *p,
 		__setscheduler_prio(p, newprio);
 	}
 	__setscheduler_uclamp(p, attr);
+	__setscheduler_latency(p, attr);
 
 	if (queued) {
 		/*
@@ -7706,6 +7825,10 @@ static int sched_copy_attr(struct sched_attr __user *uattr, struct sched_attr *a
 	    size < SCHED_ATTR_SIZE_VER1)
 		return -EINVAL;
 
+	if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+	    size < SCHED_ATTR_SIZE_VER2)
+		return -EINVAL;
+
 	/*
 	 * XXX: Do we want to be lenient like existing syscalls; or do we want
 	 * to be strict and return an error on out-of-bounds values?
@@ -7953,6 +8076,8 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	kattr.sched_util_max = p->uclamp_req[UCLAMP_MAX].value;
 #endif
 
+	kattr.sched_latency_nice = p->se.latency_nice;
+
 	rcu_read_unlock();
 
 	return sched_attr_copy_to_user(uattr, &kattr, usize);
@@ -7978,11 +8103,17 @@ int dl_task_check_affinity(struct task_struct *p, const struct cpumask *mask)
 	 * Since bandwidth control happens on root_domain basis,
 	 * if admission test is enabled, we only admit -deadline
 	 * tasks allowed to run on all the CPUs in the task's
-	 * root_domain.
+	 * root_domain. Partitioned tasks were admitted on their
+	 * current CPU and may not leave it.
 	 */
 	rcu_read_lock();
-	if (!cpumask_subset(task_rq(p)->rd->span, mask))
+	if (p->dl.flags & SCHED_FLAG_DL_PARTITIONED) {
+		if (cpumask_weight(mask) != 1 ||
+		    !cpumask_test_cpu(task_cpu(p), mask))
+			ret = -EBUSY;
+	} else if (!cpumask_subset(task_rq(p)->rd->span, mask)) {
 		ret = -EBUSY;
+	}
 	rcu_read_unlock();
 	return ret;
 }
@@ -8769,6 +8900,13 @@ int task_can_attach(struct task_struct *p,
 		goto out;
 	}
 
+	/* Partitioned bandwidth is bound to the task's current CPU. */
+	if (dl_task(p) && (p->dl.flags & SCHED_FLAG_DL_PARTITIONED) &&
+	    !cpumask_test_cpu(task_cpu(p), cs_effective_cpus)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
 	if (dl_task(p) && !cpumask_intersects(task_rq(p)->rd->span,
 					      cs_effective_cpus)) {
 		int cpu = cpumask_any_and(cpu_active_mask, cs_effective_cpus);
@@ -9486,7 +9624,10 @@ void __init sched_init(void)
 		rq->core_pick = NULL;
 		rq->core_enabled = 0;
 		rq->core_tree = RB_ROOT;
-		rq->core_forceidle = false;
+		rq->core_cache_class = NULL;
+		rq->core_forceidle_count = 0;
+		rq->core_forceidle_occupation = 0;
+		rq->core_forceidle_start = 0;
 
 		rq->core_cookie = 0UL;
 #endif
@@ -9768,6 +9909,9 @@ static void sched_free_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHEDSTATS
+	free_percpu(tg->lat_hist);
+#endif
 	kmem_cache_free(task_group_cache, tg);
 }
 
@@ -9802,6 +9946,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHEDSTATS
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	alloc_uclamp_sched_group(tg, parent);
 
 	return tg;
@@ -10597,6 +10747,18 @@ static int cpu_idle_write_s64(struct cgroup_subsys_state *css,
 {
 	return sched_group_set_idle(css_tg(css), idle);
 }
+
+static s64 cpu_latency_nice_read_s64(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	return css_tg(css)->latency_nice;
+}
+
+static int cpu_latency_nice_write_s64(struct cgroup_subsys_state *css,
+				      struct cftype *cft, s64 nice)
+{
+	return sched_group_set_latency(css_tg(css), nice);
+}
 #endif
 
 static struct cftype cpu_legacy_files[] = {
@@ -10611,6 +10773,12 @@ static struct cftype cpu_legacy_files[] = {
 		.read_s64 = cpu_idle_read_s64,
 		.write_s64 = cpu_idle_write_s64,
 	},
+	{
+		.name = "latency.nice",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
@@ -10662,9 +10830,59 @@ static struct cftype cpu_legacy_files[] = {
 	{ }	/* Terminate */
 };
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Sum up the runqueue latency histogram of @css and all its descendants.
+ * The root group has no histogram of its own, it covers every task and
+ * is read from the runqueues instead.
+ */
+static void cpu_lat_hist_read(struct cgroup_subsys_state *css,
+			      struct sched_lat_hist *hist)
+{
+	struct cgroup_subsys_state *pos;
+	int cpu, i;
+
+	memset(hist, 0, sizeof(*hist));
+
+	if (css_tg(css) == &root_task_group) {
+		for_each_possible_cpu(cpu) {
+			for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+				hist->buckets[i] += READ_ONCE(cpu_rq(cpu)->rq_lat_hist.buckets[i]);
+		}
+		return;
+	}
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		struct task_group *tg = css_tg(pos);
+
+		for_each_possible_cpu(cpu) {
+			struct sched_lat_hist *h = per_cpu_ptr(tg->lat_hist, cpu);
+
+			for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+				hist->buckets[i] += READ_ONCE(h->buckets[i]);
+		}
+	}
+	rcu_read_unlock();
+}
+#endif
+
 static int cpu_extra_stat_show(struct seq_file *sf,
 			       struct cgroup_subsys_state *css)
 {
+#ifdef CONFIG_SCHEDSTATS
+	{
+		struct sched_lat_hist hist;
+		int i;
+
+		cpu_lat_hist_read(css, &hist);
+
+		for (i = 0; i < SCHED_LAT_BUCKETS - 1; i++)
+			seq_printf(sf, "runq_lat_lt_%luus %lu\n",
+				   1UL << i, hist.buckets[i]);
+		seq_printf(sf, "runq_lat_inf %lu\n", hist.buckets[i]);
+	}
+#endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
 		struct task_group *tg = css_tg(css);
@@ -10824,6 +11042,12 @@ static struct cftype cpu_files[] = {
 		.read_s64 = cpu_idle_read_s64,
 		.write_s64 = cpu_idle_write_s64,
 	},
+	{
+		.name = "latency.nice",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
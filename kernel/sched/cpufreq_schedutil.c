@@ -17,7 +17,8 @@
 
 struct sugov_tunables {
 	struct gov_attr_set	attr_set;
-	unsigned int		rate_limit_us;
+	unsigned int		up_rate_limit_us;
+	unsigned int		down_rate_limit_us;
 };
 
 struct sugov_policy {
@@ -29,8 +30,11 @@ struct sugov_policy {
 	raw_spinlock_t		update_lock;
 	u64			last_freq_update_time;
 	s64			freq_update_delay_ns;
+	s64			up_rate_delay_ns;
+	s64			down_rate_delay_ns;
 	unsigned int		next_freq;
 	unsigned int		cached_raw_freq;
+	unsigned int		prev_cached_raw_freq;
 
 	/* The next fields are only needed if fast switch cannot be used: */
 	struct			irq_work irq_work;
@@ -53,9 +57,14 @@ struct sugov_cpu {
 	unsigned int		iowait_boost;
 	u64			last_update;
 
+	/* uclamp.min boost of the last boosted wakeup, decays every tick */
+	unsigned long		wake_boost;
+	u64			wake_boost_time;
+
 	unsigned long		util;
 	unsigned long		bw_dl;
 	unsigned long		max;
+	unsigned int		reason;
 
 	/* The field below is for single-CPU policies only: */
 #ifdef CONFIG_NO_HZ_COMMON
@@ -100,6 +109,25 @@ static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 	return delta_ns >= sg_policy->freq_update_delay_ns;
 }
 
+/*
+ * sugov_should_update_freq() only enforces the shorter of the two rate
+ * limits; now that the direction of the change is known, apply the one
+ * that matches it.
+ */
+static bool sugov_up_down_rate_limit(struct sugov_policy *sg_policy, u64 time,
+				     unsigned long cur, unsigned long next)
+{
+	s64 delta_ns = time - sg_policy->last_freq_update_time;
+
+	if (next > cur && delta_ns < sg_policy->up_rate_delay_ns)
+		return true;
+
+	if (next < cur && delta_ns < sg_policy->down_rate_delay_ns)
+		return true;
+
+	return false;
+}
+
 static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
 				   unsigned int next_freq)
 {
@@ -107,6 +135,16 @@ static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
 		sg_policy->need_freq_update = cpufreq_driver_test_flags(CPUFREQ_NEED_UPDATE_LIMITS);
 	else if (sg_policy->next_freq == next_freq)
 		return false;
+	else if (sugov_up_down_rate_limit(sg_policy, time, sg_policy->next_freq,
+					  next_freq)) {
+		/*
+		 * get_next_freq() cached the raw frequency of a change
+		 * that is not made: forget it, or the same request would
+		 * be taken for the current one until the util changes.
+		 */
+		sg_policy->cached_raw_freq = sg_policy->prev_cached_raw_freq;
+		return false;
+	}
 
 	sg_policy->next_freq = next_freq;
 	sg_policy->last_freq_update_time = time;
@@ -157,6 +195,7 @@ static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 	if (freq == sg_policy->cached_raw_freq && !sg_policy->need_freq_update)
 		return sg_policy->next_freq;
 
+	sg_policy->prev_cached_raw_freq = sg_policy->cached_raw_freq;
 	sg_policy->cached_raw_freq = freq;
 	return cpufreq_driver_resolve_freq(policy, freq);
 }
@@ -170,6 +209,7 @@ static void sugov_get_util(struct sugov_cpu *sg_cpu)
 	sg_cpu->bw_dl = cpu_bw_dl(rq);
 	sg_cpu->util = effective_cpu_util(sg_cpu->cpu, cpu_util_cfs(rq), max,
 					  FREQUENCY_UTIL, NULL);
+	sg_cpu->reason = SUGOV_REASON_UTIL;
 }
 
 /**
@@ -290,8 +330,74 @@ static void sugov_iowait_apply(struct sugov_cpu *sg_cpu, u64 time)
 	 */
 	boost = (sg_cpu->iowait_boost * sg_cpu->max) >> SCHED_CAPACITY_SHIFT;
 	boost = uclamp_rq_util_with(cpu_rq(sg_cpu->cpu), boost, NULL);
-	if (sg_cpu->util < boost)
+	if (sg_cpu->util < boost) {
 		sg_cpu->util = boost;
+		sg_cpu->reason |= SUGOV_REASON_IOWAIT;
+	}
+}
+
+/**
+ * sugov_wake_boost() - Record a wakeup of a uclamp.min boosted task.
+ * @sg_cpu: the sugov data for the CPU to boost
+ * @time: the update time from the caller
+ * @flags: SCHED_CPUFREQ_WAKE_BOOST if a boosted task is waking up
+ *
+ * The rq's min clamp only holds while the boosted task is runnable, so a
+ * bursty task that sleeps between requests keeps finding the CPU at the low
+ * frequency PELT decayed to while it was idle. Remember the boost at wakeup
+ * and keep it applied, decaying, for a few ticks after the task is gone.
+ *
+ * A wakeup that raises the boost past the current utilization also bypasses
+ * the rate limit, so that the ramp happens right away.
+ */
+static void sugov_wake_boost(struct sugov_cpu *sg_cpu, u64 time,
+			     unsigned int flags)
+{
+	unsigned long boost;
+
+	if (!(flags & SCHED_CPUFREQ_WAKE_BOOST))
+		return;
+
+	boost = uclamp_rq_util_with(cpu_rq(sg_cpu->cpu), 0, NULL);
+	if (!boost)
+		return;
+
+	if (boost > sg_cpu->util)
+		sg_cpu->sg_policy->limits_changed = true;
+
+	sg_cpu->wake_boost = boost;
+	sg_cpu->wake_boost_time = time;
+}
+
+/**
+ * sugov_wake_boost_apply() - Apply the wakeup boost to a CPU.
+ * @sg_cpu: the sugov data for the cpu to boost
+ * @time: the update time from the caller
+ *
+ * Like the IO boost, the wakeup boost is halved for each tick that elapsed
+ * without a new boosted wakeup, and dropped once it is below
+ * IOWAIT_BOOST_MIN.
+ */
+static void sugov_wake_boost_apply(struct sugov_cpu *sg_cpu, u64 time)
+{
+	unsigned long boost;
+	u64 ticks;
+
+	if (!sg_cpu->wake_boost)
+		return;
+
+	ticks = div_u64(time - sg_cpu->wake_boost_time, TICK_NSEC);
+	boost = ticks < BITS_PER_LONG ? sg_cpu->wake_boost >> ticks : 0;
+	if (boost < IOWAIT_BOOST_MIN) {
+		sg_cpu->wake_boost = 0;
+		return;
+	}
+
+	boost = min(boost, sg_cpu->max);
+	if (sg_cpu->util < boost) {
+		sg_cpu->util = boost;
+		sg_cpu->reason |= SUGOV_REASON_WAKE_BOOST;
+	}
 }
 
 #ifdef CONFIG_NO_HZ_COMMON
@@ -320,16 +426,23 @@ static inline void ignore_dl_rate_limit(struct sugov_cpu *sg_cpu)
 static inline bool sugov_update_single_common(struct sugov_cpu *sg_cpu,
 					      u64 time, unsigned int flags)
 {
+	bool limits_changed;
+
 	sugov_iowait_boost(sg_cpu, time, flags);
+	sugov_wake_boost(sg_cpu, time, flags);
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
 
+	limits_changed = sg_cpu->sg_policy->limits_changed;
 	if (!sugov_should_update_freq(sg_cpu->sg_policy, time))
 		return false;
 
 	sugov_get_util(sg_cpu);
 	sugov_iowait_apply(sg_cpu, time);
+	sugov_wake_boost_apply(sg_cpu, time);
+	if (limits_changed)
+		sg_cpu->reason |= SUGOV_REASON_LIMITS;
 
 	return true;
 }
@@ -352,6 +465,7 @@ static void sugov_update_single_freq(struct update_util_data *hook, u64 time,
 	 */
 	if (sugov_cpu_is_busy(sg_cpu) && next_f < sg_policy->next_freq) {
 		next_f = sg_policy->next_freq;
+		sg_cpu->reason |= SUGOV_REASON_BUSY;
 
 		/* Restore cached freq as next_freq has changed */
 		sg_policy->cached_raw_freq = cached_freq;
@@ -360,6 +474,9 @@ static void sugov_update_single_freq(struct update_util_data *hook, u64 time,
 	if (!sugov_update_next_freq(sg_policy, time, next_f))
 		return;
 
+	trace_sugov_update_freq(sg_cpu->cpu, sg_cpu->util, sg_cpu->max, next_f,
+				sg_cpu->reason);
+
 	/*
 	 * This code runs under rq->lock for the target CPU, so it won't run
 	 * concurrently on two different CPUs for the same target and it is not
@@ -397,8 +514,21 @@ static void sugov_update_single_perf(struct update_util_data *hook, u64 time,
 	 * Do not reduce the target performance level if the CPU has not been
 	 * idle recently, as the reduction is likely to be premature then.
 	 */
-	if (sugov_cpu_is_busy(sg_cpu) && sg_cpu->util < prev_util)
+	if (sugov_cpu_is_busy(sg_cpu) && sg_cpu->util < prev_util) {
 		sg_cpu->util = prev_util;
+		sg_cpu->reason |= SUGOV_REASON_BUSY;
+	}
+
+	/* The split up/down rate limits apply to performance levels too */
+	if (!(sg_cpu->reason & SUGOV_REASON_LIMITS) &&
+	    sugov_up_down_rate_limit(sg_cpu->sg_policy, time, prev_util,
+				     sg_cpu->util)) {
+		sg_cpu->util = prev_util;
+		return;
+	}
+
+	trace_sugov_update_freq(sg_cpu->cpu, sg_cpu->util, sg_cpu->max, 0,
+				sg_cpu->reason);
 
 	cpufreq_driver_adjust_perf(sg_cpu->cpu, map_util_perf(sg_cpu->bw_dl),
 				   map_util_perf(sg_cpu->util), sg_cpu->max);
@@ -406,25 +536,30 @@ static void sugov_update_single_perf(struct update_util_data *hook, u64 time,
 	sg_cpu->sg_policy->last_freq_update_time = time;
 }
 
-static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
+static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time,
+					   struct sugov_cpu **max_sg_cpu)
 {
 	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
 	struct cpufreq_policy *policy = sg_policy->policy;
 	unsigned long util = 0, max = 1;
 	unsigned int j;
 
+	*max_sg_cpu = sg_cpu;
+
 	for_each_cpu(j, policy->cpus) {
 		struct sugov_cpu *j_sg_cpu = &per_cpu(sugov_cpu, j);
 		unsigned long j_util, j_max;
 
 		sugov_get_util(j_sg_cpu);
 		sugov_iowait_apply(j_sg_cpu, time);
+		sugov_wake_boost_apply(j_sg_cpu, time);
 		j_util = j_sg_cpu->util;
 		j_max = j_sg_cpu->max;
 
 		if (j_util * max > j_max * util) {
 			util = j_util;
 			max = j_max;
+			*max_sg_cpu = j_sg_cpu;
 		}
 	}
 
@@ -436,21 +571,30 @@ sugov_update_shared(struct update_util_data *hook, u64 time, unsigned int flags)
 {
 	struct sugov_cpu *sg_cpu = container_of(hook, struct sugov_cpu, update_util);
 	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	struct sugov_cpu *max_sg_cpu;
+	bool limits_changed;
 	unsigned int next_f;
 
 	raw_spin_lock(&sg_policy->update_lock);
 
 	sugov_iowait_boost(sg_cpu, time, flags);
+	sugov_wake_boost(sg_cpu, time, flags);
 	sg_cpu->last_update = time;
 
 	ignore_dl_rate_limit(sg_cpu);
 
+	limits_changed = sg_policy->limits_changed;
 	if (sugov_should_update_freq(sg_policy, time)) {
-		next_f = sugov_next_freq_shared(sg_cpu, time);
+		next_f = sugov_next_freq_shared(sg_cpu, time, &max_sg_cpu);
 
 		if (!sugov_update_next_freq(sg_policy, time, next_f))
 			goto unlock;
 
+		trace_sugov_update_freq(max_sg_cpu->cpu, max_sg_cpu->util,
+					max_sg_cpu->max, next_f,
+					max_sg_cpu->reason |
+					(limits_changed ? SUGOV_REASON_LIMITS : 0));
+
 		if (sg_policy->policy->fast_switch_enabled)
 			cpufreq_driver_fast_switch(sg_policy->policy, next_f);
 		else
@@ -505,13 +649,25 @@ static inline struct sugov_tunables *to_sugov_tunables(struct gov_attr_set *attr
 	return container_of(attr_set, struct sugov_tunables, attr_set);
 }
 
+static void sugov_update_rate_limits(struct sugov_policy *sg_policy)
+{
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	sg_policy->up_rate_delay_ns = tunables->up_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->down_rate_delay_ns = tunables->down_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->freq_update_delay_ns = min(sg_policy->up_rate_delay_ns,
+					      sg_policy->down_rate_delay_ns);
+}
+
 static ssize_t rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
 {
 	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
 
-	return sprintf(buf, "%u\n", tunables->rate_limit_us);
+	return sprintf(buf, "%u\n", min(tunables->up_rate_limit_us,
+					tunables->down_rate_limit_us));
 }
 
+/* Legacy knob: sets both the ramp up and the ramp down rate limit. */
 static ssize_t
 rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
 {
@@ -522,18 +678,73 @@ rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count
 	if (kstrtouint(buf, 10, &rate_limit_us))
 		return -EINVAL;
 
-	tunables->rate_limit_us = rate_limit_us;
+	tunables->up_rate_limit_us = rate_limit_us;
+	tunables->down_rate_limit_us = rate_limit_us;
+
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook)
+		sugov_update_rate_limits(sg_policy);
+
+	return count;
+}
+
+static ssize_t up_rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->up_rate_limit_us);
+}
+
+static ssize_t
+up_rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	struct sugov_policy *sg_policy;
+	unsigned int rate_limit_us;
+
+	if (kstrtouint(buf, 10, &rate_limit_us))
+		return -EINVAL;
+
+	tunables->up_rate_limit_us = rate_limit_us;
+
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook)
+		sugov_update_rate_limits(sg_policy);
+
+	return count;
+}
+
+static ssize_t down_rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->down_rate_limit_us);
+}
+
+static ssize_t
+down_rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	struct sugov_policy *sg_policy;
+	unsigned int rate_limit_us;
+
+	if (kstrtouint(buf, 10, &rate_limit_us))
+		return -EINVAL;
+
+	tunables->down_rate_limit_us = rate_limit_us;
 
 	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook)
-		sg_policy->freq_update_delay_ns = rate_limit_us * NSEC_PER_USEC;
+		sugov_update_rate_limits(sg_policy);
 
 	return count;
 }
 
 static struct governor_attr rate_limit_us = __ATTR_RW(rate_limit_us);
+static struct governor_attr up_rate_limit_us = __ATTR_RW(up_rate_limit_us);
+static struct governor_attr down_rate_limit_us = __ATTR_RW(down_rate_limit_us);
 
 static struct attribute *sugov_attrs[] = {
 	&rate_limit_us.attr,
+	&up_rate_limit_us.attr,
+	&down_rate_limit_us.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(sugov);
@@ -696,7 +907,8 @@ static int sugov_init(struct cpufreq_policy *policy)
 		goto stop_kthread;
 	}
 
-	tunables->rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->up_rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->down_rate_limit_us = tunables->up_rate_limit_us;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
@@ -756,7 +968,7 @@ static int sugov_start(struct cpufreq_policy *policy)
 	void (*uu)(struct update_util_data *data, u64 time, unsigned int flags);
 	unsigned int cpu;
 
-	sg_policy->freq_update_delay_ns	= sg_policy->tunables->rate_limit_us * NSEC_PER_USEC;
+	sugov_update_rate_limits(sg_policy);
 	sg_policy->last_freq_update_time	= 0;
 	sg_policy->next_freq			= 0;
 	sg_policy->work_in_progress		= false;
@@ -130,6 +130,33 @@ static inline bool dl_bw_visited(int cpu, u64 gen)
 	rd->visit_gen = gen;
 	return false;
 }
+
+/*
+ * Partitioned (SCHED_FLAG_DL_PARTITIONED) tasks are pinned to a single CPU
+ * and are admitted against that CPU's share of the root domain bandwidth,
+ * on top of the usual root domain wide test. All helpers below must be
+ * called with dl_bw_of(cpu)->lock held.
+ */
+static inline void __dl_part_add(int cpu, u64 tsk_bw)
+{
+	cpu_rq(cpu)->dl.part_bw += tsk_bw;
+}
+
+static inline void __dl_part_sub(int cpu, u64 tsk_bw)
+{
+	struct dl_rq *dl_rq = &cpu_rq(cpu)->dl;
+
+	SCHED_WARN_ON(dl_rq->part_bw < tsk_bw); /* underflow */
+	dl_rq->part_bw -= min(dl_rq->part_bw, tsk_bw);
+}
+
+static inline bool __dl_part_overflow(struct dl_bw *dl_b, int cpu,
+				      u64 old_bw, u64 new_bw)
+{
+	return dl_b->bw != -1 &&
+	       cap_scale(dl_b->bw, capacity_orig_of(cpu)) <
+	       cpu_rq(cpu)->dl.part_bw - old_bw + new_bw;
+}
 #else
 static inline struct dl_bw *dl_bw_of(int i)
 {
@@ -150,8 +177,42 @@ static inline bool dl_bw_visited(int cpu, u64 gen)
 {
 	return false;
 }
+
+static inline void __dl_part_add(int cpu, u64 tsk_bw) { }
+static inline void __dl_part_sub(int cpu, u64 tsk_bw) { }
+
+static inline bool __dl_part_overflow(struct dl_bw *dl_b, int cpu,
+				      u64 old_bw, u64 new_bw)
+{
+	return false;
+}
 #endif
 
+static inline bool dl_partitioned(struct sched_dl_entity *dl_se)
+{
+	return dl_se->flags & SCHED_FLAG_DL_PARTITIONED;
+}
+
+/*
+ * @p's bandwidth is going away: drop its per-CPU share too, if any. The
+ * share is given back to the CPU that was charged with it, which
+ * migrate_task_rq_dl() keeps equal to task_cpu(p).
+ */
+static inline void __dl_sub_task(struct dl_bw *dl_b, struct task_struct *p)
+{
+	__dl_sub(dl_b, p->dl.dl_bw, dl_bw_cpus(task_cpu(p)));
+	if (p->dl.part_cpu >= 0) {
+		__dl_part_sub(p->dl.part_cpu, p->dl.dl_bw);
+		p->dl.part_cpu = -1;
+	}
+}
+
+static inline void __dl_part_add_task(struct task_struct *p, int cpu, u64 bw)
+{
+	__dl_part_add(cpu, bw);
+	p->dl.part_cpu = cpu;
+}
+
 static inline
 void __add_running_bw(u64 dl_bw, struct dl_rq *dl_rq)
 {
@@ -354,7 +415,7 @@ static void task_non_contending(struct task_struct *p)
 			if (READ_ONCE(p->__state) == TASK_DEAD)
 				sub_rq_bw(&p->dl, &rq->dl);
 			raw_spin_lock(&dl_b->lock);
-			__dl_sub(dl_b, p->dl.dl_bw, dl_bw_cpus(task_cpu(p)));
+			__dl_sub_task(dl_b, p);
 			__dl_clear_params(p);
 			raw_spin_unlock(&dl_b->lock);
 		}
@@ -443,6 +504,7 @@ void init_dl_rq(struct dl_rq *dl_rq)
 	dl_rq->dl_nr_migratory = 0;
 	dl_rq->overloaded = 0;
 	dl_rq->pushable_dl_tasks_root = RB_ROOT_CACHED;
+	dl_rq->part_bw = 0;
 #else
 	init_dl_bw(&dl_rq->dl_bw);
 #endif
@@ -567,7 +629,7 @@ static int push_dl_task(struct rq *rq);
 
 static inline bool need_pull_dl_task(struct rq *rq, struct task_struct *prev)
 {
-	return rq->online && dl_task(prev);
+	return rq->online && dl_task(prev) && !dl_partitioned(&prev->dl);
 }
 
 static DEFINE_PER_CPU(struct callback_head, dl_push_head);
@@ -1111,6 +1173,7 @@ static enum hrtimer_restart dl_task_timer(struct hrtimer *timer)
 #endif
 
 	enqueue_task_dl(rq, p, ENQUEUE_REPLENISH);
+	sched_core_pick_invalidate(rq);
 	if (dl_task(rq->curr))
 		check_preempt_curr_dl(rq, p, 0);
 	else
@@ -1310,6 +1373,7 @@ static void update_curr_dl(struct rq *rq)
 		__dequeue_task_dl(rq, curr, 0);
 		if (unlikely(is_dl_boosted(dl_se) || !start_dl_timer(curr)))
 			enqueue_task_dl(rq, curr, ENQUEUE_REPLENISH);
+		sched_core_pick_invalidate(rq);
 
 		if (!is_leftmost(curr, &rq->dl))
 			resched_curr(rq);
@@ -1365,7 +1429,7 @@ static enum hrtimer_restart inactive_task_timer(struct hrtimer *timer)
 		}
 
 		raw_spin_lock(&dl_b->lock);
-		__dl_sub(dl_b, p->dl.dl_bw, dl_bw_cpus(task_cpu(p)));
+		__dl_sub_task(dl_b, p);
 		raw_spin_unlock(&dl_b->lock);
 		__dl_clear_params(p);
 
@@ -1721,11 +1785,36 @@ select_task_rq_dl(struct task_struct *p, int cpu, int flags)
 	return cpu;
 }
 
-static void migrate_task_rq_dl(struct task_struct *p, int new_cpu __maybe_unused)
+/*
+ * A partitioned task's share follows it around, so that it is always given
+ * back to the CPU it was charged to. Only the kernel can move such a task
+ * (e.g. a cpuset update, or the wakeup after its affinity changed while it
+ * slept), so there is no admission test on the destination here.
+ */
+static void dl_part_move(struct task_struct *p, int new_cpu)
+{
+	int old_cpu = p->dl.part_cpu;
+	struct dl_bw *dl_b;
+
+	dl_b = dl_bw_of(old_cpu);
+	raw_spin_lock(&dl_b->lock);
+	__dl_part_sub(old_cpu, p->dl.dl_bw);
+	raw_spin_unlock(&dl_b->lock);
+
+	dl_b = dl_bw_of(new_cpu);
+	raw_spin_lock(&dl_b->lock);
+	__dl_part_add_task(p, new_cpu, p->dl.dl_bw);
+	raw_spin_unlock(&dl_b->lock);
+}
+
+static void migrate_task_rq_dl(struct task_struct *p, int new_cpu)
 {
 	struct rq_flags rf;
 	struct rq *rq;
 
+	if (p->dl.part_cpu >= 0 && p->dl.part_cpu != new_cpu)
+		dl_part_move(p, new_cpu);
+
 	if (READ_ONCE(p->__state) != TASK_WAKING)
 		return;
 
@@ -2365,6 +2454,11 @@ static void set_cpus_allowed_dl(struct task_struct *p,
 		raw_spin_unlock(&src_dl_b->lock);
 	}
 
+	/*
+	 * A partitioned share stays on task_cpu(p) until @p actually
+	 * moves; migrate_task_rq_dl() then transfers it.
+	 */
+
 	set_cpus_allowed_common(p, new_mask, flags);
 }
 
@@ -2469,9 +2563,11 @@ static void switched_from_dl(struct rq *rq, struct task_struct *p)
 	/*
 	 * Since this might be the only -deadline task on the rq,
 	 * this is the right place to try to pull some other one
-	 * from an overloaded CPU, if any.
+	 * from an overloaded CPU, if any. Partitioned tasks keep their
+	 * CPU to themselves and never trigger a pull.
 	 */
-	if (!task_on_rq_queued(p) || rq->dl.dl_nr_running)
+	if (!task_on_rq_queued(p) || rq->dl.dl_nr_running ||
+	    dl_partitioned(&p->dl))
 		return;
 
 	deadline_queue_pull_task(rq);
@@ -2522,7 +2618,7 @@ static void prio_changed_dl(struct rq *rq, struct task_struct *p,
 		 * we can't argue if the task is increasing
 		 * or lowering its prio, so...
 		 */
-		if (!rq->dl.overloaded)
+		if (!rq->dl.overloaded && !dl_partitioned(&p->dl))
 			deadline_queue_pull_task(rq);
 
 		/*
@@ -2679,6 +2775,10 @@ int sched_dl_overflow(struct task_struct *p, int policy,
 	u64 period = attr->sched_period ?: attr->sched_deadline;
 	u64 runtime = attr->sched_runtime;
 	u64 new_bw = dl_policy(policy) ? to_ratio(period, runtime) : 0;
+	bool old_part = dl_partitioned(&p->dl);
+	bool new_part = attr->sched_flags & SCHED_FLAG_DL_PARTITIONED;
+	u64 part_old_bw = 0;
+	bool part_fits;
 	int cpus, err = -1, cpu = task_cpu(p);
 	struct dl_bw *dl_b = dl_bw_of(cpu);
 	unsigned long cap;
@@ -2687,7 +2787,8 @@ int sched_dl_overflow(struct task_struct *p, int policy,
 		return 0;
 
 	/* !deadline task may carry old deadline bandwidth */
-	if (new_bw == p->dl.dl_bw && task_has_dl_policy(p))
+	if (new_bw == p->dl.dl_bw && old_part == new_part &&
+	    task_has_dl_policy(p))
 		return 0;
 
 	/*
@@ -2699,14 +2800,27 @@ int sched_dl_overflow(struct task_struct *p, int policy,
 	cpus = dl_bw_cpus(cpu);
 	cap = dl_bw_capacity(cpu);
 
+	/*
+	 * A partitioned task must also fit in its CPU's share; whatever it
+	 * still holds there (possibly waiting for its 0-lag time) is
+	 * given back first.
+	 */
+	if (p->dl.part_cpu >= 0)
+		part_old_bw = p->dl.dl_bw;
+	part_fits = !new_part ||
+		    !__dl_part_overflow(dl_b, cpu, part_old_bw, new_bw);
+
 	if (dl_policy(policy) && !task_has_dl_policy(p) &&
-	    !__dl_overflow(dl_b, cap, 0, new_bw)) {
+	    !__dl_overflow(dl_b, cap, 0, new_bw) && part_fits) {
 		if (hrtimer_active(&p->dl.inactive_timer))
-			__dl_sub(dl_b, p->dl.dl_bw, cpus);
+			__dl_sub_task(dl_b, p);
 		__dl_add(dl_b, new_bw, cpus);
+		if (new_part)
+			__dl_part_add_task(p, cpu, new_bw);
 		err = 0;
 	} else if (dl_policy(policy) && task_has_dl_policy(p) &&
-		   !__dl_overflow(dl_b, cap, p->dl.dl_bw, new_bw)) {
+		   !__dl_overflow(dl_b, cap, p->dl.dl_bw, new_bw) &&
+		   part_fits) {
 		/*
 		 * XXX this is slightly incorrect: when the task
 		 * utilization decreases, we should delay the total
@@ -2714,8 +2828,10 @@ int sched_dl_overflow(struct task_struct *p, int policy,
 		 * But this would require to set the task's "inactive
 		 * timer" when the task is not inactive.
 		 */
-		__dl_sub(dl_b, p->dl.dl_bw, cpus);
+		__dl_sub_task(dl_b, p);
 		__dl_add(dl_b, new_bw, cpus);
+		if (new_part)
+			__dl_part_add_task(p, cpu, new_bw);
 		dl_change_utilization(p, new_bw);
 		err = 0;
 	} else if (!dl_policy(policy) && task_has_dl_policy(p)) {
@@ -2837,6 +2953,7 @@ void __dl_clear_params(struct task_struct *p)
 	dl_se->dl_deadline		= 0;
 	dl_se->dl_period		= 0;
 	dl_se->flags			= 0;
+	dl_se->part_cpu			= -1;
 	dl_se->dl_bw			= 0;
 	dl_se->dl_density		= 0;
 
@@ -2897,6 +3014,10 @@ int dl_cpu_busy(int cpu, struct task_struct *p)
 	cap = dl_bw_capacity(cpu);
 	overflow = __dl_overflow(dl_b, cap, 0, p ? p->dl.dl_bw : 0);
 
+	/* Partitioned bandwidth cannot be moved off its CPU. */
+	if (!p && cpu_rq(cpu)->dl.part_bw)
+		overflow = true;
+
 	if (!overflow && p) {
 		/*
 		 * We reserve space for this task in the destination
@@ -320,6 +320,8 @@ static __init int sched_init_debug(void)
 	debugfs_create_file("tunable_scaling", 0644, debugfs_sched, NULL, &sched_scaling_fops);
 	debugfs_create_u32("migration_cost_ns", 0644, debugfs_sched, &sysctl_sched_migration_cost);
 	debugfs_create_u32("nr_migrate", 0644, debugfs_sched, &sysctl_sched_nr_migrate);
+	debugfs_create_u32("blocked_stale_ns", 0644, debugfs_sched, &sysctl_sched_blocked_stale_ns);
+	debugfs_create_u32("blocked_budget", 0644, debugfs_sched, &sysctl_sched_blocked_budget);
 
 	mutex_lock(&sched_domains_mutex);
 	update_sched_domain_debugfs();
@@ -333,6 +335,7 @@ static __init int sched_init_debug(void)
 	debugfs_create_u32("scan_period_min_ms", 0644, numa, &sysctl_numa_balancing_scan_period_min);
 	debugfs_create_u32("scan_period_max_ms", 0644, numa, &sysctl_numa_balancing_scan_period_max);
 	debugfs_create_u32("scan_size_mb", 0644, numa, &sysctl_numa_balancing_scan_size);
+	debugfs_create_u32("hot_threshold_ms", 0644, numa, &sysctl_numa_balancing_hot_threshold);
 #endif
 
 	debugfs_create_file("debug", 0444, debugfs_sched, NULL, &sched_debug_fops);
@@ -380,6 +383,7 @@ static void register_sd(struct sched_domain *sd, struct dentry *parent)
 	SDM(ulong, 0644, min_interval);
 	SDM(ulong, 0644, max_interval);
 	SDM(u64,   0644, max_newidle_lb_cost);
+	SDM(u64,   0444, migration_cost);
 	SDM(u32,   0644, busy_factor);
 	SDM(u32,   0644, imbalance_pct);
 	SDM(u32,   0644, cache_nice_tries);
@@ -694,6 +698,7 @@ void print_dl_rq(struct seq_file *m, int cpu, struct dl_rq *dl_rq)
 	PU(dl_nr_running);
 #ifdef CONFIG_SMP
 	PU(dl_nr_migratory);
+	SEQ_printf(m, "  .%-30s: %lld\n", "part_bw", dl_rq->part_bw);
 	dl_bw = &cpu_rq(cpu)->rd->dl_bw;
 #else
 	dl_bw = &dl_rq->dl_bw;
@@ -754,6 +759,9 @@ do {									\
 		P(sched_goidle);
 		P(ttwu_count);
 		P(ttwu_local);
+		P(sis_search);
+		P(sis_scanned);
+		P(sis_found);
 	}
 #undef P
 
@@ -954,6 +962,7 @@ void proc_sched_show_task(struct task_struct *p, struct pid_namespace *ns,
 	nr_switches = p->nvcsw + p->nivcsw;
 
 	P(se.nr_migrations);
+	P(se.latency_nice);
 
 	if (schedstat_enabled()) {
 		u64 avg_atom, avg_per_cpu;
@@ -976,6 +985,9 @@ void proc_sched_show_task(struct task_struct *p, struct pid_namespace *ns,
 		P_SCHEDSTAT(se.statistics.nr_failed_migrations_running);
 		P_SCHEDSTAT(se.statistics.nr_failed_migrations_hot);
 		P_SCHEDSTAT(se.statistics.nr_forced_migrations);
+#ifdef CONFIG_SCHED_CORE
+		PN_SCHEDSTAT(se.statistics.core_forceidle_sum);
+#endif
 		P_SCHEDSTAT(se.statistics.nr_wakeups);
 		P_SCHEDSTAT(se.statistics.nr_wakeups_sync);
 		P_SCHEDSTAT(se.statistics.nr_wakeups_migrate);
@@ -120,6 +120,21 @@ int __weak arch_asym_cpu_priority(int cpu)
  * (default: ~5%)
  */
 #define capacity_greater(cap1, cap2) ((cap1) * 1024 > (cap2) * 1078)
+
+/*
+ * Lazy decay of blocked cgroup load.
+ *
+ * A leaf cfs_rq whose averages were updated less than
+ * sysctl_sched_blocked_stale_ns ago and that has nothing pending is skipped
+ * by update_blocked_averages(). At most sysctl_sched_blocked_budget leaf
+ * cfs_rqs are updated per pass, the next pass carries on where it stopped.
+ * Every SCHED_BLOCKED_MAX_DEFER passes that held something back are
+ * followed by a pass that updates everything.
+ *
+ * (default: 0, both limits disabled)
+ */
+const_debug unsigned int sysctl_sched_blocked_stale_ns	= 0;
+const_debug unsigned int sysctl_sched_blocked_budget	= 0;
 #endif
 
 #ifdef CONFIG_CFS_BANDWIDTH
@@ -1069,6 +1084,12 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+/* The page with hint page fault latency < threshold in ms is considered hot */
+unsigned int sysctl_numa_balancing_hot_threshold = MSEC_PER_SEC;
+
+/* Restrict the NUMA promotion throughput (MB/s) for each target node. */
+unsigned int sysctl_numa_balancing_promote_rate_limit = 65536;
+
 struct numa_group {
 	refcount_t refcount;
 
@@ -1409,6 +1430,46 @@ static inline unsigned long group_weight(struct task_struct *p, int nid,
 	return 1000 * faults / total_faults;
 }
 
+/*
+ * For memory tiering mode, the time between the page table scan marking a
+ * slow memory page and the hint fault on it is used to tell hot pages from
+ * cold ones.
+ */
+static int numa_hint_fault_latency(struct page *page)
+{
+	int last_time, time;
+
+	time = jiffies_to_msecs(jiffies);
+	last_time = xchg_page_access_time(page, time);
+
+	return (time - last_time) & PAGE_ACCESS_TIME_MASK;
+}
+
+/*
+ * For memory tiering mode, too high promotion/demotion throughput may hurt
+ * application latency.  So we provide a mechanism to rate limit the number
+ * of pages that are tried to be promoted.
+ */
+static bool numa_promotion_rate_limit(struct pglist_data *pgdat,
+				      unsigned long rate_limit, int nr)
+{
+	unsigned long nr_cand;
+	unsigned int now, start;
+
+	now = jiffies_to_msecs(jiffies);
+	mod_node_page_state(pgdat, PGPROMOTE_CANDIDATE, nr);
+	nr_cand = node_page_state(pgdat, PGPROMOTE_CANDIDATE);
+	start = pgdat->nbp_rl_start;
+	if (now - start > MSEC_PER_SEC &&
+	    cmpxchg(&pgdat->nbp_rl_start, start, now) == start)
+		pgdat->nbp_rl_nr_cand = nr_cand;
+	if (nr_cand - pgdat->nbp_rl_nr_cand >= rate_limit) {
+		mod_node_page_state(pgdat, PGPROMOTE_RATE_LIMITED, nr);
+		return true;
+	}
+	return false;
+}
+
 bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 				int src_nid, int dst_cpu)
 {
@@ -1416,6 +1477,27 @@ bool should_numa_migrate_memory(struct task_struct *p, struct page * page,
 	int dst_nid = cpu_to_node(dst_cpu);
 	int last_cpupid, this_cpupid;
 
+	/*
+	 * The pages in slow memory node should be migrated according
+	 * to hot/cold instead of private/shared.
+	 */
+	if ((sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING) &&
+	    !node_is_toptier(src_nid)) {
+		struct pglist_data *pgdat;
+		unsigned long rate_limit;
+
+		if (numa_hint_fault_latency(page) >=
+		    READ_ONCE(sysctl_numa_balancing_hot_threshold))
+			return false;
+
+		pgdat = NODE_DATA(dst_nid);
+		rate_limit = READ_ONCE(sysctl_numa_balancing_promote_rate_limit) <<
+			     (20 - PAGE_SHIFT);
+
+		return !numa_promotion_rate_limit(pgdat, rate_limit,
+						  thp_nr_pages(page));
+	}
+
 	this_cpupid = cpu_pid_to_cpupid(dst_cpu, current->pid);
 	last_cpupid = page_cpupid_xchg_last(page, this_cpupid);
 
@@ -2636,6 +2718,14 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 	if (!p->mm)
 		return;
 
+	/*
+	 * NUMA faults statistics are unnecessary for the slow memory
+	 * node for memory tiering mode.
+	 */
+	if ((sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING) &&
+	    !node_is_toptier(mem_node))
+		return;
+
 	/* Allocate buffer to track faults on a per-node basis */
 	if (unlikely(!p->numa_faults)) {
 		int size = sizeof(*p->numa_faults) *
@@ -4922,6 +5012,7 @@ static bool throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	 */
 	cfs_rq->throttled = 1;
 	cfs_rq->throttled_clock = rq_clock(rq);
+	sched_core_pick_invalidate(rq);
 	return true;
 }
 
@@ -4935,6 +5026,7 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	se = cfs_rq->tg->se[cpu_of(rq)];
 
 	cfs_rq->throttled = 0;
+	sched_core_pick_invalidate(rq);
 
 	update_rq_clock(rq);
 
@@ -5592,6 +5684,55 @@ static int sched_idle_cpu(int cpu)
 {
 	return sched_idle_rq(cpu_rq(cpu));
 }
+
+/*
+ * Effective migration cost of @sd: the measured cache refill penalty,
+ * never below the sysctl_sched_migration_cost floor.
+ */
+static inline u64 sd_migration_cost(struct sched_domain *sd)
+{
+	u64 cost = sysctl_sched_migration_cost;
+
+	if (sched_feat(LB_MIGRATION_COST))
+		cost = max(cost, READ_ONCE(sd->migration_cost));
+
+	return cost;
+}
+
+/*
+ * A task that got pulled by the load balancer has to refill its cache
+ * footprint on the new CPU, which shows up as a longer than usual CPU
+ * burst. Charge the excess over the task's average burst to the domain
+ * that did the migration.
+ */
+static void update_migration_cost(struct rq *rq, struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+	u64 burst = se->sum_exec_runtime - se->burst_start;
+	int level = se->migr_level;
+	struct sched_domain *sd;
+	u64 penalty;
+
+	if (level) {
+		se->migr_level = 0;
+
+		penalty = burst > se->avg_burst ? burst - se->avg_burst : 0;
+		penalty = min_t(u64, penalty, sysctl_sched_latency);
+
+		rcu_read_lock();
+		for_each_domain(cpu_of(rq), sd) {
+			if (sd->level + 1 != level)
+				continue;
+			update_avg(&sd->migration_cost, penalty);
+			break;
+		}
+		rcu_read_unlock();
+	}
+
+	update_avg(&se->avg_burst, burst);
+}
+#else
+static inline void update_migration_cost(struct rq *rq, struct task_struct *p) { }
 #endif
 
 /*
@@ -5606,6 +5747,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	struct sched_entity *se = &p->se;
 	int idle_h_nr_running = task_has_idle_policy(p);
 	int task_new = !(flags & ENQUEUE_WAKEUP);
+	unsigned int cpufreq_flags = 0;
 
 	/*
 	 * The code below (indirectly) updates schedutil which looks at
@@ -5618,10 +5760,20 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	/*
 	 * If in_iowait is set, the code below may not trigger any cpufreq
 	 * utilization updates, so do it here explicitly with the IOWAIT flag
-	 * passed.
+	 * passed. Likewise for wakeups of uclamp.min boosted tasks, which
+	 * schedutil wants to ramp up for without waiting for PELT.
 	 */
 	if (p->in_iowait)
-		cpufreq_update_util(rq, SCHED_CPUFREQ_IOWAIT);
+		cpufreq_flags |= SCHED_CPUFREQ_IOWAIT;
+	if (!task_new && uclamp_boosted(p))
+		cpufreq_flags |= SCHED_CPUFREQ_WAKE_BOOST;
+	if (cpufreq_flags)
+		cpufreq_update_util(rq, cpufreq_flags);
+
+#ifdef CONFIG_SMP
+	if (!task_new)
+		se->burst_start = se->sum_exec_runtime;
+#endif
 
 	for_each_sched_entity(se) {
 		if (se->on_rq)
@@ -5725,6 +5877,9 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 	util_est_dequeue(&rq->cfs, p);
 
+	if (task_sleep)
+		update_migration_cost(rq, p);
+
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
@@ -6271,10 +6426,74 @@ static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd
 
 #endif /* CONFIG_SCHED_SMT */
 
+/*
+ * Maintain sd_llc_shared->idle_cpus_span for SIS_FILTER. A CPU sets its bit
+ * itself when it enters the idle loop; bits of CPUs that went busy again are
+ * cleared lazily, from the tick and by select_idle_cpu() when it finds them
+ * busy, so that leaving idle does not write the shared cacheline.
+ */
+void update_idle_cpumask(int cpu, bool idle)
+{
+	struct sched_domain_shared *sds;
+	struct cpumask *mask;
+
+	if (!sched_feat(SIS_FILTER))
+		return;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (!sds)
+		goto unlock;
+
+	mask = sds_idle_cpus(sds);
+	if (cpumask_test_cpu(cpu, mask) == idle)
+		goto unlock;
+
+	if (idle) {
+		/*
+		 * Order rq->curr == rq->idle before the bit, pairs with
+		 * sis_clear_busy_cpu().
+		 */
+		smp_mb__before_atomic();
+		cpumask_set_cpu(cpu, mask);
+	} else {
+		cpumask_clear_cpu(cpu, mask);
+	}
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * @cpu was found busy by the idle search, drop it from the filter unless it
+ * went idle meanwhile, in which case its own update may have been lost.
+ */
+static void sis_clear_busy_cpu(struct sched_domain_shared *sds, int cpu)
+{
+	struct cpumask *mask = sds_idle_cpus(sds);
+
+	cpumask_clear_cpu(cpu, mask);
+	smp_mb__after_atomic();
+	if (available_idle_cpu(cpu))
+		cpumask_set_cpu(cpu, mask);
+}
+
+/* Scan limit for tasks with a negative latency_nice */
+#define SIS_LATENCY_NR	4
+
+static inline void sis_account(struct rq *rq, int scanned, int idle_cpu)
+{
+	schedstat_inc(rq->sis_search);
+	schedstat_add(rq->sis_scanned, scanned);
+	if ((unsigned int)idle_cpu < nr_cpumask_bits)
+		schedstat_inc(rq->sis_found);
+}
+
 /*
  * Scan the LLC domain for idle CPUs; this is dynamically regulated by
  * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
  * average idle time for this rq (as found in rq->avg_idle).
+ *
+ * With SIS_FILTER only the CPUs that recently entered idle are scanned.
  */
 static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool has_idle_core, int target)
 {
@@ -6283,15 +6502,31 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 	struct sched_domain_shared *sd_share;
 	struct rq *this_rq = this_rq();
 	int this = smp_processor_id();
+	bool latency_sensitive = p->se.latency_nice < 0;
 	struct sched_domain *this_sd;
+	bool filter = false;
+	int scanned = 0;
 	u64 time = 0;
 
 	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
 	if (!this_sd)
 		return -1;
 
+	/*
+	 * Latency sensitive tasks would rather take the first idle CPU
+	 * than pay for a scan of the whole LLC looking for an idle core.
+	 */
+	if (latency_sensitive)
+		has_idle_core = false;
+
 	cpumask_and(cpus, sched_domain_span(sd), p->cpus_ptr);
 
+	sd_share = rcu_dereference(per_cpu(sd_llc_shared, target));
+	if (sched_feat(SIS_FILTER) && sd_share) {
+		cpumask_and(cpus, cpus, sds_idle_cpus(sd_share));
+		filter = true;
+	}
+
 	if (sched_feat(SIS_PROP) && !has_idle_core) {
 		u64 avg_cost, avg_idle, span_avg;
 		unsigned long now = jiffies;
@@ -6320,29 +6555,36 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 		time = cpu_clock(this);
 	}
 
-	if (sched_feat(SIS_UTIL)) {
-		sd_share = rcu_dereference(per_cpu(sd_llc_shared, target));
-		if (sd_share) {
-			/* because !--nr is the condition to stop scan */
-			nr = READ_ONCE(sd_share->nr_idle_scan) + 1;
-			/* overloaded LLC is unlikely to have idle cpu/core */
-			if (nr == 1)
-				return -1;
-		}
+	if (sched_feat(SIS_UTIL) && sd_share) {
+		/* because !--nr is the condition to stop scan */
+		nr = READ_ONCE(sd_share->nr_idle_scan) + 1;
+		/* overloaded LLC is unlikely to have idle cpu/core */
+		if (nr == 1)
+			return -1;
 	}
 
+	if (latency_sensitive)
+		nr = min(nr, SIS_LATENCY_NR);
+
 	for_each_cpu_wrap(cpu, cpus, target + 1) {
+		scanned++;
 		if (has_idle_core) {
 			i = select_idle_core(p, cpu, cpus, &idle_cpu);
-			if ((unsigned int)i < nr_cpumask_bits)
+			if ((unsigned int)i < nr_cpumask_bits) {
+				sis_account(this_rq, scanned, i);
 				return i;
+			}
 
 		} else {
-			if (!--nr)
+			if (!--nr) {
+				sis_account(this_rq, scanned, -1);
 				return -1;
+			}
 			idle_cpu = __select_idle_cpu(cpu, p);
 			if ((unsigned int)idle_cpu < nr_cpumask_bits)
 				break;
+			if (filter)
+				sis_clear_busy_cpu(sd_share, cpu);
 		}
 	}
 
@@ -6361,6 +6603,7 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, bool
 		update_avg(&this_sd->avg_scan_cost, time);
 	}
 
+	sis_account(this_rq, scanned, idle_cpu);
 	return idle_cpu;
 }
 
@@ -7051,6 +7294,9 @@ static void migrate_task_rq_fair(struct task_struct *p, int new_cpu)
 	/* Tell new CPU we are migrated */
 	p->se.avg.last_update_time = 0;
 
+	/* Only migrations done by the load balancer are measured */
+	p->se.migr_level = 0;
+
 	/* We have migrated, no longer consider this task hot */
 	p->se.exec_start = 0;
 
@@ -7092,6 +7338,29 @@ static unsigned long wakeup_gran(struct sched_entity *se)
 	return calc_delta_fair(gran, se);
 }
 
+/*
+ * latency_nice maps linearly onto a vruntime offset of up to about
+ * +/- sysctl_sched_latency, negative for latency sensitive entities.
+ */
+static inline s64 latency_offset(struct sched_entity *se)
+{
+	return div_s64((s64)sysctl_sched_latency * READ_ONCE(se->latency_nice),
+		       LATENCY_NICE_WIDTH / 2);
+}
+
+/*
+ * How much earlier 'se' may preempt 'curr' because of their relative
+ * latency_nice. This only shifts the preemption point, vruntime and
+ * therefore the CPU share of either entity are unchanged.
+ */
+static s64 wakeup_latency_gran(struct sched_entity *curr, struct sched_entity *se)
+{
+	s64 offset = latency_offset(curr) - latency_offset(se);
+	s64 max = sysctl_sched_latency;
+
+	return clamp(offset, -max, max);
+}
+
 /*
  * Should 'se' preempt 'curr'.
  *
@@ -7111,6 +7380,9 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 {
 	s64 gran, vdiff = curr->vruntime - se->vruntime;
 
+	/* Take into account the latency requirements of both entities */
+	vdiff += wakeup_latency_gran(curr, se);
+
 	if (vdiff <= 0)
 		return -1;
 
@@ -7740,7 +8012,7 @@ static int task_hot(struct task_struct *p, struct lb_env *env)
 
 	delta = rq_clock_task(env->src_rq) - p->se.exec_start;
 
-	return delta < (s64)sysctl_sched_migration_cost;
+	return delta < (s64)sd_migration_cost(env->sd);
 }
 
 #ifdef CONFIG_NUMA_BALANCING
@@ -7904,6 +8176,7 @@ static void detach_task(struct task_struct *p, struct lb_env *env)
 
 	deactivate_task(env->src_rq, p, DEQUEUE_NOCLOCK);
 	set_task_cpu(p, env->dst_cpu);
+	p->se.migr_level = env->sd->level + 1;
 }
 
 /*
@@ -8202,10 +8475,32 @@ static bool __update_blocked_others(struct rq *rq, bool *done)
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 
+/*
+ * After this many update_blocked_averages() passes in a row that left some
+ * cfs_rqs out, one pass updates them all regardless of the limits.
+ */
+#define SCHED_BLOCKED_MAX_DEFER		8
+
+/*
+ * Returns true if the blocked load of @cfs_rq was updated recently enough
+ * to be left for a later pass, see sysctl_sched_blocked_stale_ns.
+ */
+static inline bool blocked_update_is_recent(struct cfs_rq *cfs_rq)
+{
+	unsigned int stale = sysctl_sched_blocked_stale_ns;
+
+	/* Removed load and pending propagation must not be held back. */
+	return stale && !cfs_rq->propagate && !cfs_rq->removed.nr &&
+	       cfs_rq_clock_pelt(cfs_rq) - cfs_rq->avg.last_update_time < stale;
+}
+
 static bool __update_blocked_fair(struct rq *rq, bool *done)
 {
+	unsigned int budget = sysctl_sched_blocked_budget;
+	bool full = rq->blocked_deferred >= SCHED_BLOCKED_MAX_DEFER;
+	unsigned int idx = 0, cursor = 0;
 	struct cfs_rq *cfs_rq, *pos;
-	bool decayed = false;
+	bool decayed = false, deferred = false;
 	int cpu = cpu_of(rq);
 
 	/*
@@ -8215,6 +8510,32 @@ static bool __update_blocked_fair(struct rq *rq, bool *done)
 	for_each_leaf_cfs_rq_safe(rq, cfs_rq, pos) {
 		struct sched_entity *se;
 
+		/*
+		 * Deferred cfs_rqs stay on the list and keep the CPU marked
+		 * as having blocked load, so a later pass gets to them. The
+		 * budget is spent from where the previous pass stopped, so
+		 * every cfs_rq gets its turn, not just the head of the list.
+		 * The root cfs_rq feeds cpufreq and load balancing directly
+		 * and is always updated.
+		 */
+		if (!full && cfs_rq != &rq->cfs) {
+			bool defer = blocked_update_is_recent(cfs_rq);
+
+			if (!defer && sysctl_sched_blocked_budget) {
+				if (idx < rq->blocked_cursor || !budget)
+					defer = true;
+				else if (!--budget)
+					cursor = idx + 1;
+			}
+			idx++;
+
+			if (defer) {
+				deferred = true;
+				*done = false;
+				continue;
+			}
+		}
+
 		if (update_cfs_rq_load_avg(cfs_rq_clock_pelt(cfs_rq), cfs_rq)) {
 			update_tg_load_avg(cfs_rq);
 
@@ -8239,6 +8560,10 @@ static bool __update_blocked_fair(struct rq *rq, bool *done)
 			*done = false;
 	}
 
+	/* Wrap around once the budget reached the end of the list. */
+	rq->blocked_cursor = cursor < idx ? cursor : 0;
+	rq->blocked_deferred = deferred ? rq->blocked_deferred + 1 : 0;
+
 	return decayed;
 }
 
@@ -10917,7 +11242,13 @@ static int newidle_balance(struct rq *this_rq, struct rq_flags *rf)
 		int continue_balancing = 1;
 		u64 t0, domain_cost;
 
-		if (this_rq->avg_idle < curr_cost + sd->max_newidle_lb_cost) {
+		/*
+		 * Pulling a task only pays off if we expect to stay idle for
+		 * longer than it takes to find one plus the cache refill the
+		 * pulled task will have to go through.
+		 */
+		if (this_rq->avg_idle < curr_cost + sd->max_newidle_lb_cost +
+		    (sched_feat(LB_MIGRATION_COST) ? sd->migration_cost : 0)) {
 			update_next_balance(sd, &next_balance);
 			break;
 		}
@@ -11071,7 +11402,7 @@ static inline void task_tick_core(struct rq *rq, struct task_struct *curr)
 	 * MIN_NR_TASKS_DURING_FORCEIDLE - 1 tasks and use that to check
 	 * if we need to give up the CPU.
 	 */
-	if (rq->core->core_forceidle && rq->cfs.nr_running == 1 &&
+	if (rq->core->core_forceidle_count && rq->cfs.nr_running == 1 &&
 	    __entity_slice_used(&curr->se, MIN_NR_TASKS_DURING_FORCEIDLE))
 		resched_curr(rq);
 }
@@ -11584,6 +11915,7 @@ void init_tg_cfs_entry(struct task_group *tg, struct cfs_rq *cfs_rq,
 	se->my_q = cfs_rq;
 	/* guarantee group entities always have weight */
 	update_load_set(&se->load, NICE_0_LOAD);
+	se->latency_nice = tg->latency_nice;
 	se->parent = parent;
 }
 
@@ -11704,6 +12036,26 @@ int sched_group_set_idle(struct task_group *tg, long idle)
 	return 0;
 }
 
+int sched_group_set_latency(struct task_group *tg, long latency)
+{
+	int i;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (latency < MIN_LATENCY_NICE || latency > MAX_LATENCY_NICE)
+		return -EINVAL;
+
+	mutex_lock(&shares_mutex);
+
+	tg->latency_nice = latency;
+	for_each_possible_cpu(i)
+		WRITE_ONCE(tg->se[i]->latency_nice, latency);
+
+	mutex_unlock(&shares_mutex);
+	return 0;
+}
+
 #else /* CONFIG_FAIR_GROUP_SCHED */
 
 void free_fair_sched_group(struct task_group *tg) { }
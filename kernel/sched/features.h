@@ -57,6 +57,7 @@ SCHED_FEAT(TTWU_QUEUE, true)
  */
 SCHED_FEAT(SIS_PROP, false)
 SCHED_FEAT(SIS_UTIL, true)
+SCHED_FEAT(SIS_FILTER, true)
 
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
@@ -96,3 +97,16 @@ SCHED_FEAT(LATENCY_WARN, false)
 
 SCHED_FEAT(ALT_PERIOD, true)
 SCHED_FEAT(BASE_SLICE, true)
+
+/*
+ * Learn a per-domain migration cost from the extra CPU time tasks burn
+ * right after being moved by the load balancer, and use it for cache
+ * hotness and newidle balance decisions.
+ */
+SCHED_FEAT(LB_MIGRATION_COST, true)
+
+/*
+ * Cache the per-runqueue class pick used by core-wide selection until
+ * something is {en,de}queued on that runqueue.
+ */
+SCHED_FEAT(CORE_PICK_CACHE, true)
@@ -267,6 +267,9 @@ static void do_idle(void)
 	 */
 	nohz_run_idle_balance(cpu);
 
+	/* Advertise ourselves to select_idle_cpu() */
+	update_idle_cpumask(cpu, true);
+
 	/*
 	 * If the arch has a polling bit, we maintain an invariant:
 	 *
@@ -936,8 +936,10 @@ static int do_sched_rt_period_timer(struct rt_bandwidth *rt_b, int overrun)
 		if (rt_rq->rt_throttled)
 			throttled = 1;
 
-		if (enqueue)
+		if (enqueue) {
 			sched_rt_rq_enqueue(rt_rq);
+			sched_core_pick_invalidate(rq);
+		}
 		rq_unlock(rq, &rf);
 	}
 
@@ -995,6 +997,7 @@ static int sched_rt_runtime_exceeded(struct rt_rq *rt_rq)
 
 		if (rt_rq_throttled(rt_rq)) {
 			sched_rt_rq_dequeue(rt_rq);
+			sched_core_pick_invalidate(rq_of_rt_rq(rt_rq));
 			return 1;
 		}
 	}
@@ -54,6 +54,7 @@
 #include <linux/migrate.h>
 #include <linux/mmu_context.h>
 #include <linux/nmi.h>
+#include <linux/node.h>
 #include <linux/proc_fs.h>
 #include <linux/prefetch.h>
 #include <linux/profile.h>
@@ -227,7 +228,8 @@ static inline void update_avg(u64 *avg, u64 sample)
  */
 #define SCHED_FLAG_SUGOV	0x10000000
 
-#define SCHED_DL_FLAGS (SCHED_FLAG_RECLAIM | SCHED_FLAG_DL_OVERRUN | SCHED_FLAG_SUGOV)
+#define SCHED_DL_FLAGS (SCHED_FLAG_RECLAIM | SCHED_FLAG_DL_OVERRUN | \
+			SCHED_FLAG_SUGOV | SCHED_FLAG_DL_PARTITIONED)
 
 static inline bool dl_entity_is_special(struct sched_dl_entity *dl_se)
 {
@@ -351,6 +353,28 @@ extern bool dl_param_changed(struct task_struct *p, const struct sched_attr *att
 extern int  dl_cpuset_cpumask_can_shrink(const struct cpumask *cur, const struct cpumask *trial);
 extern int  dl_cpu_busy(int cpu, struct task_struct *p);
 
+#ifdef CONFIG_SCHEDSTATS
+/*
+ * Runqueue latency histogram: bucket 0 counts waits below 1us (1024ns),
+ * bucket i waits in [2^(i-1), 2^i) us, and the last bucket everything
+ * longer.
+ */
+#define SCHED_LAT_BUCKETS	20
+
+struct sched_lat_hist {
+	unsigned long		buckets[SCHED_LAT_BUCKETS];
+};
+
+static inline unsigned int sched_lat_bucket(unsigned long long delta)
+{
+	delta >>= 10;
+	if (!delta)
+		return 0;
+
+	return min_t(unsigned int, ilog2(delta) + 1, SCHED_LAT_BUCKETS - 1);
+}
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 #include <linux/cgroup.h>
@@ -398,6 +422,9 @@ struct task_group {
 	/* A positive value indicates that this is a SCHED_IDLE group. */
 	int			idle;
 
+	/* latency_nice of the group entities, see cpu.latency.nice */
+	int			latency_nice;
+
 #ifdef	CONFIG_SMP
 	/*
 	 * load_avg can be heavily contended at clock tick time, so put
@@ -437,6 +464,10 @@ struct task_group {
 	struct uclamp_se	uclamp[UCLAMP_CNT];
 #endif
 
+#ifdef CONFIG_SCHEDSTATS
+	/* Runqueue latency of the group's own tasks, NULL for the root */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 };
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
@@ -510,6 +541,8 @@ extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 
 extern int sched_group_set_idle(struct task_group *tg, long idle);
 
+extern int sched_group_set_latency(struct task_group *tg, long latency);
+
 #ifdef CONFIG_SMP
 extern void set_task_rq_fair(struct sched_entity *se,
 			     struct cfs_rq *prev, struct cfs_rq *next);
@@ -702,6 +735,13 @@ struct dl_rq {
 	 * of the leftmost (earliest deadline) element.
 	 */
 	struct rb_root_cached	pushable_dl_tasks_root;
+
+	/*
+	 * Bandwidth admitted for SCHED_FLAG_DL_PARTITIONED tasks pinned
+	 * to this CPU. Protected by the root domain's dl_bw lock and
+	 * checked against that domain's per-CPU bw (partitioned EDF).
+	 */
+	u64			part_bw;
 #else
 	struct dl_bw		dl_bw;
 #endif
@@ -963,6 +1003,9 @@ struct rq {
 	/* list of leaf cfs_rq on this CPU: */
 	struct list_head	leaf_cfs_rq_list;
 	struct list_head	*tmp_alone_branch;
+	/* update_blocked_averages(): where the budget resumes, passes deferred */
+	unsigned int		blocked_cursor;
+	unsigned int		blocked_deferred;
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
 	/*
@@ -1071,6 +1114,7 @@ struct rq {
 	struct sched_info	rq_sched_info;
 	unsigned long long	rq_cpu_time;
 	/* could above be rq->cfs_rq.exec_clock + rq->rt_rq.rt_runtime ? */
+	struct sched_lat_hist	rq_lat_hist;
 
 	/* sys_sched_yield() stats */
 	unsigned int		yld_count;
@@ -1082,6 +1126,11 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int		ttwu_count;
 	unsigned int		ttwu_local;
+
+	/* select_idle_cpu() stats */
+	unsigned int		sis_search;
+	unsigned int		sis_scanned;
+	unsigned int		sis_found;
 #endif
 
 #ifdef CONFIG_CPU_IDLE
@@ -1103,12 +1152,20 @@ struct rq {
 	unsigned int		core_sched_seq;
 	struct rb_root		core_tree;
 
+	/* per rq class pick cache, see sched_core_pick_class() */
+	unsigned int		core_rq_seq;
+	unsigned int		core_cache_seq;
+	const struct sched_class *core_cache_class;
+	struct task_struct	*core_cache_pick;
+
 	/* shared state -- careful with sched_core_cpu_deactivate() */
 	unsigned int		core_task_seq;
 	unsigned int		core_pick_seq;
 	unsigned long		core_cookie;
-	unsigned char		core_forceidle;
+	unsigned int		core_forceidle_count;
 	unsigned int		core_forceidle_seq;
+	unsigned int		core_forceidle_occupation;
+	u64			core_forceidle_start;
 #endif
 };
 
@@ -1251,6 +1308,16 @@ static inline bool sched_core_enqueued(struct task_struct *p)
 extern void sched_core_enqueue(struct rq *rq, struct task_struct *p);
 extern void sched_core_dequeue(struct rq *rq, struct task_struct *p);
 
+/*
+ * Bandwidth throttling changes what ->pick_task() returns without going
+ * through {en,de}queue_task(), so it has to drop the class pick cache of
+ * sched_core_pick_class() by hand.
+ */
+static inline void sched_core_pick_invalidate(struct rq *rq)
+{
+	rq->core_rq_seq++;
+}
+
 extern void sched_core_get(void);
 extern void sched_core_put(void);
 
@@ -1285,6 +1352,10 @@ static inline void queue_core_balance(struct rq *rq)
 {
 }
 
+static inline void sched_core_pick_invalidate(struct rq *rq)
+{
+}
+
 static inline bool sched_cpu_cookie_match(struct rq *rq, struct task_struct *p)
 {
 	return true;
@@ -2402,6 +2473,8 @@ extern void check_preempt_curr(struct rq *rq, struct task_struct *p, int flags);
 
 extern const_debug unsigned int sysctl_sched_nr_migrate;
 extern const_debug unsigned int sysctl_sched_migration_cost;
+extern const_debug unsigned int sysctl_sched_blocked_stale_ns;
+extern const_debug unsigned int sysctl_sched_blocked_budget;
 
 #ifdef CONFIG_SCHED_DEBUG
 extern unsigned int sysctl_sched_latency;
@@ -2416,6 +2489,7 @@ extern unsigned int sysctl_numa_balancing_scan_delay;
 extern unsigned int sysctl_numa_balancing_scan_period_min;
 extern unsigned int sysctl_numa_balancing_scan_period_max;
 extern unsigned int sysctl_numa_balancing_scan_size;
+extern unsigned int sysctl_numa_balancing_hot_threshold;
 #endif
 
 #ifdef CONFIG_SCHED_HRTICK
@@ -2753,6 +2827,12 @@ extern void nohz_run_idle_balance(int cpu);
 static inline void nohz_run_idle_balance(int cpu) { }
 #endif
 
+#ifdef CONFIG_SMP
+extern void update_idle_cpumask(int cpu, bool idle);
+#else
+static inline void update_idle_cpumask(int cpu, bool idle) { }
+#endif
+
 #ifdef CONFIG_SMP
 static inline
 void __dl_update(struct dl_bw *dl_b, s64 bw)
@@ -2915,6 +2995,12 @@ static inline bool uclamp_is_used(void)
 {
 	return static_branch_likely(&sched_uclamp_used);
 }
+
+/* Is @p (or its task group) asking for a non-zero minimum utilization? */
+static inline bool uclamp_boosted(struct task_struct *p)
+{
+	return uclamp_is_used() && uclamp_eff_value(p, UCLAMP_MIN) > 0;
+}
 #else /* CONFIG_UCLAMP_TASK */
 static inline
 unsigned long uclamp_rq_util_with(struct rq *rq, unsigned long util,
@@ -2927,6 +3013,11 @@ static inline bool uclamp_is_used(void)
 {
 	return false;
 }
+
+static inline bool uclamp_boosted(struct task_struct *p)
+{
+	return false;
+}
 #endif /* CONFIG_UCLAMP_TASK */
 
 #ifdef arch_scale_freq_capacity
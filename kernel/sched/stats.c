@@ -10,7 +10,7 @@
  * Bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 16
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
@@ -21,6 +21,7 @@ static int show_schedstat(struct seq_file *seq, void *v)
 		seq_printf(seq, "timestamp %lu\n", jiffies);
 	} else {
 		struct rq *rq;
+		int i;
 #ifdef CONFIG_SMP
 		struct sched_domain *sd;
 		int dcount = 0;
@@ -37,6 +38,10 @@ static int show_schedstat(struct seq_file *seq, void *v)
 		    rq->rq_cpu_time,
 		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount);
 
+		/* v16: runqueue latency histogram, see SCHED_LAT_BUCKETS */
+		for (i = 0; i < SCHED_LAT_BUCKETS; i++)
+			seq_printf(seq, " %lu", rq->rq_lat_hist.buckets[i]);
+
 		seq_printf(seq, "\n");
 
 #ifdef CONFIG_SMP
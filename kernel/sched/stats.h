@@ -6,12 +6,29 @@
  * Expects runqueue lock to be held for atomicity of update
  */
 static inline void
-rq_sched_info_arrive(struct rq *rq, unsigned long long delta)
+rq_sched_info_arrive(struct rq *rq, struct task_struct *t,
+		     unsigned long long delta)
 {
-	if (rq) {
-		rq->rq_sched_info.run_delay += delta;
-		rq->rq_sched_info.pcount++;
-	}
+	unsigned int bucket;
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg;
+#endif
+
+	if (!rq)
+		return;
+
+	rq->rq_sched_info.run_delay += delta;
+	rq->rq_sched_info.pcount++;
+
+	bucket = sched_lat_bucket(delta);
+	rq->rq_lat_hist.buckets[bucket]++;
+
+#ifdef CONFIG_CGROUP_SCHED
+	/* task_group() itself is only defined further down in sched.h */
+	tg = t->sched_task_group;
+	if (tg && tg->lat_hist)
+		per_cpu_ptr(tg->lat_hist, cpu_of(rq))->buckets[bucket]++;
+#endif
 }
 
 /*
@@ -41,7 +58,7 @@ rq_sched_info_dequeue(struct rq *rq, unsigned long long delta)
 #define   schedstat_val_or_zero(var)	((schedstat_enabled()) ? (var) : 0)
 
 #else /* !CONFIG_SCHEDSTATS: */
-static inline void rq_sched_info_arrive  (struct rq *rq, unsigned long long delta) { }
+static inline void rq_sched_info_arrive  (struct rq *rq, struct task_struct *t, unsigned long long delta) { }
 static inline void rq_sched_info_dequeue(struct rq *rq, unsigned long long delta) { }
 static inline void rq_sched_info_depart  (struct rq *rq, unsigned long long delta) { }
 # define   schedstat_enabled()		0
@@ -192,7 +209,7 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
 
-	rq_sched_info_arrive(rq, delta);
+	rq_sched_info_arrive(rq, t, delta);
 }
 
 /*
@@ -249,3 +266,24 @@ sched_info_switch(struct rq *rq, struct task_struct *prev, struct task_struct *n
 # define sched_info_dequeue(rq, t)	do { } while (0)
 # define sched_info_switch(rq, t, next)	do { } while (0)
 #endif /* CONFIG_SCHED_INFO */
+
+#ifdef CONFIG_SCHED_CORE
+extern void __sched_core_account_forceidle(struct rq *rq);
+
+static inline void sched_core_account_forceidle(struct rq *rq)
+{
+	if (schedstat_enabled())
+		__sched_core_account_forceidle(rq);
+}
+
+extern void __sched_core_tick(struct rq *rq);
+
+static inline void sched_core_tick(struct rq *rq)
+{
+	if (sched_core_enabled(rq))
+		__sched_core_tick(rq);
+}
+#else /* !CONFIG_SCHED_CORE: */
+static inline void sched_core_account_forceidle(struct rq *rq) { }
+static inline void sched_core_tick(struct rq *rq) { }
+#endif /* CONFIG_SCHED_CORE */
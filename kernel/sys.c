@@ -38,6 +38,7 @@
 #include <linux/file.h>
 #include <linux/mount.h>
 #include <linux/gfp.h>
+#include <linux/ksm.h>
 #include <linux/syscore_ops.h>
 #include <linux/version.h>
 #include <linux/ctype.h>
@@ -2537,6 +2538,39 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 	case PR_SCHED_CORE:
 		error = sched_core_share_pid(arg2, arg3, arg4, arg5);
 		break;
+#endif
+#ifdef CONFIG_KSM
+	case PR_SET_MEMORY_MERGE:
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (mmap_write_lock_killable(me->mm))
+			return -EINTR;
+		if (arg2)
+			error = ksm_enable_merge_any(me->mm);
+		else
+			error = ksm_disable_merge_any(me->mm);
+		mmap_write_unlock(me->mm);
+		break;
+	case PR_GET_MEMORY_MERGE:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
+		break;
+#endif
+#ifdef CONFIG_FORK_SHARED_PTES
+	case PR_SET_FORK_SHARED_PTES:
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (arg2)
+			set_bit(MMF_FORK_SHARED_PTES, &me->mm->flags);
+		else
+			clear_bit(MMF_FORK_SHARED_PTES, &me->mm->flags);
+		break;
+	case PR_GET_FORK_SHARED_PTES:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_FORK_SHARED_PTES, &me->mm->flags);
+		break;
 #endif
 	default:
 		error = -EINVAL;
@@ -112,6 +112,9 @@
 #ifdef CONFIG_LOCKUP_DETECTOR
 static int sixty = 60;
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+static int three = 3;
+#endif
 
 static unsigned long zero_ul;
 static unsigned long one_ul = 1;
@@ -1812,7 +1815,14 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= sysctl_numa_balancing,
 		.extra1		= SYSCTL_ZERO,
-		.extra2		= SYSCTL_ONE,
+		.extra2		= &three,
+	},
+	{
+		.procname	= "numa_balancing_promote_rate_limit_MBps",
+		.data		= &sysctl_numa_balancing_promote_rate_limit,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
 	},
 #endif /* CONFIG_NUMA_BALANCING */
 	{
@@ -2922,6 +2932,24 @@ static struct ctl_table vm_table[] = {
 		.extra1		= SYSCTL_ZERO,
 		.extra2		= SYSCTL_ONE_HUNDRED,
 	},
+	{
+		.procname	= "compaction_goal_budget_ms",
+		.data		= &sysctl_compaction_goal_budget_ms,
+		.maxlen		= sizeof(sysctl_compaction_goal_budget_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE_THOUSAND,
+	},
+	{
+		.procname	= "compaction_goal_migrate_limit",
+		.data		= &sysctl_compaction_goal_migrate_limit,
+		.maxlen		= sizeof(sysctl_compaction_goal_migrate_limit),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_INT_MAX,
+	},
 	{
 		.procname	= "extfrag_threshold",
 		.data		= &sysctl_extfrag_threshold,
@@ -2975,6 +3003,22 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_high_fraction_sysctl_handler,
 		.extra1		= SYSCTL_ZERO,
 	},
+	{
+		.procname	= "percpu_pagelist_order_high",
+		.data		= &sysctl_percpu_pagelist_order_high,
+		.maxlen		= sizeof(sysctl_percpu_pagelist_order_high),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+	},
+	{
+		.procname	= "percpu_pagelist_order_batch",
+		.data		= &sysctl_percpu_pagelist_order_batch,
+		.maxlen		= sizeof(sysctl_percpu_pagelist_order_batch),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+	},
 	{
 		.procname	= "page_lock_unfairness",
 		.data		= &sysctl_page_lock_unfairness,
@@ -3234,6 +3278,13 @@ static struct ctl_table fs_table[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_nr_dentry,
 	},
+	{
+		.procname	= "negative-dentry-limit",
+		.data		= &sysctl_negative_dentry_limit,
+		.maxlen		= sizeof(sysctl_negative_dentry_limit),
+		.mode		= 0644,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
 	{
 		.procname	= "overflowuid",
 		.data		= &fs_overflowuid,
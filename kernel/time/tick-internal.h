@@ -165,6 +165,22 @@ DECLARE_PER_CPU(struct hrtimer_cpu_base, hrtimer_bases);
 
 extern u64 get_next_timer_interrupt(unsigned long basej, u64 basem);
 void timer_clear_idle(void);
+u64 get_jiffies_update(unsigned long *basej);
+
+#ifdef CONFIG_TIMER_MIGRATION
+unsigned int timer_expire_remote(unsigned int cpu);
+u64 timer_global_next_event(unsigned int cpu, unsigned long basej, u64 basem);
+
+/* Timer migration hierarchy, see timer_migration.c */
+void tmigr_handle_remote(void);
+bool tmigr_requires_handle_remote(void);
+u64 tmigr_cpu_deactivate(u64 nextevt);
+void tmigr_cpu_activate(void);
+#else
+static inline void tmigr_handle_remote(void) { }
+static inline bool tmigr_requires_handle_remote(void) { return false; }
+static inline void tmigr_cpu_activate(void) { }
+#endif
 
 #define CLOCK_SET_WALL							\
 	(BIT(HRTIMER_BASE_REALTIME) | BIT(HRTIMER_BASE_REALTIME_SOFT) |	\
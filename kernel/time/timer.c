@@ -180,18 +180,21 @@ EXPORT_SYMBOL(jiffies_64);
 #define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
 
 /*
- * The resulting wheel size. If NOHZ is configured we allocate two
- * wheels so we have a separate storage for the deferrable timers.
+ * The resulting wheel size. If NOHZ is configured we allocate three
+ * wheels: pinned timers go to the local one, timers which may be expired
+ * by any CPU to the global one and deferrable timers have their own storage.
  */
 #define WHEEL_SIZE	(LVL_SIZE * LVL_DEPTH)
 
 #ifdef CONFIG_NO_HZ_COMMON
-# define NR_BASES	2
-# define BASE_STD	0
-# define BASE_DEF	1
+# define NR_BASES	3
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	1
+# define BASE_DEF	2
 #else
 # define NR_BASES	1
-# define BASE_STD	0
+# define BASE_LOCAL	0
+# define BASE_GLOBAL	0
 # define BASE_DEF	0
 #endif
 
@@ -566,8 +569,21 @@ trigger_dyntick_cpu(struct timer_base *base, struct timer_list *timer)
 	 * timer is not deferrable. If the other CPU is on the way to idle
 	 * then it can't set base->is_idle as we hold the base lock:
 	 */
-	if (base->is_idle)
-		wake_up_nohz_cpu(base->cpu);
+	if (!base->is_idle)
+		return;
+
+#ifdef CONFIG_TIMER_MIGRATION
+	/*
+	 * A global timer which re-arms itself while the timers of the idle
+	 * CPU are expired by another CPU. The new expiry is handed to the
+	 * timer migration hierarchy once the expiry is done, no need to
+	 * wake the idle CPU.
+	 */
+	if (static_branch_likely(&timers_migration_enabled) &&
+	    !(timer->flags & TIMER_PINNED) && base->running_timer == timer)
+		return;
+#endif
+	wake_up_nohz_cpu(base->cpu);
 }
 
 /*
@@ -849,7 +865,8 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 
 static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 {
-	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_STD], cpu);
+	int index = tflags & TIMER_PINNED ? BASE_LOCAL : BASE_GLOBAL;
+	struct timer_base *base = per_cpu_ptr(&timer_bases[index], cpu);
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
@@ -862,7 +879,8 @@ static inline struct timer_base *get_timer_cpu_base(u32 tflags, u32 cpu)
 
 static inline struct timer_base *get_timer_this_cpu_base(u32 tflags)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	int index = tflags & TIMER_PINNED ? BASE_LOCAL : BASE_GLOBAL;
+	struct timer_base *base = this_cpu_ptr(&timer_bases[index]);
 
 	/*
 	 * If the timer is deferrable and NO_HZ_COMMON is set then we need
@@ -881,7 +899,13 @@ static inline struct timer_base *get_timer_base(u32 tflags)
 static inline struct timer_base *
 get_target_base(struct timer_base *base, unsigned tflags)
 {
-#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
+	/*
+	 * With the timer migration hierarchy global timers stay on the local
+	 * CPU. When it goes idle they are expired by the last active CPU of
+	 * its group instead.
+	 */
+#if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON) && \
+    !defined(CONFIG_TIMER_MIGRATION)
 	if (static_branch_likely(&timers_migration_enabled) &&
 	    !(tflags & TIMER_PINNED))
 		return get_timer_cpu_base(tflags, get_nohz_timer_target());
@@ -1159,7 +1183,11 @@ void add_timer_on(struct timer_list *timer, int cpu)
 
 	BUG_ON(timer_pending(timer) || !timer->function);
 
-	new_base = get_timer_cpu_base(timer->flags, cpu);
+	/*
+	 * The timer has to be expired on @cpu, so it goes to the local base
+	 * and is never handed to the timer migration hierarchy.
+	 */
+	new_base = get_timer_cpu_base(timer->flags | TIMER_PINNED, cpu);
 
 	/*
 	 * If @timer was on a different CPU, it should be migrated with the
@@ -1174,7 +1202,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 		base = new_base;
 		raw_spin_lock(&base->lock);
 		WRITE_ONCE(timer->flags,
-			   (timer->flags & ~TIMER_BASEMASK) | cpu);
+			   (timer->flags & ~TIMER_BASEMASK) | TIMER_PINNED | cpu);
 	}
 	forward_timer_base(base);
 
@@ -1436,7 +1464,8 @@ static void call_timer_fn(struct timer_list *timer,
 	}
 }
 
-static void expire_timers(struct timer_base *base, struct hlist_head *head)
+static unsigned int expire_timers(struct timer_base *base,
+				  struct hlist_head *head)
 {
 	/*
 	 * This value is required only for tracing. base->clk was
@@ -1444,6 +1473,7 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 	 * is related to the old base->clk value.
 	 */
 	unsigned long baseclk = base->clk - 1;
+	unsigned int nr = 0;
 
 	while (!hlist_empty(head)) {
 		struct timer_list *timer;
@@ -1468,7 +1498,9 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 			base->running_timer = NULL;
 			timer_sync_wait_running(base);
 		}
+		nr++;
 	}
+	return nr;
 }
 
 static int collect_expired_timers(struct timer_base *base,
@@ -1625,6 +1657,46 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
 	return DIV_ROUND_UP_ULL(nextevt, TICK_NSEC) * TICK_NSEC;
 }
 
+/*
+ * Recalculate the next expiry of @base if needed and forward its clock to
+ * @basej. Caller must hold base->lock.
+ */
+static unsigned long timer_base_next_expiry(struct timer_base *base,
+					    unsigned long basej)
+{
+	unsigned long nextevt;
+
+	if (base->next_expiry_recalc)
+		base->next_expiry = __next_timer_interrupt(base);
+	nextevt = base->next_expiry;
+
+	/*
+	 * We have a fresh next event. Check whether we can forward the
+	 * base. We can only do that when @basej is past base->clk
+	 * otherwise we might rewind base->clk.
+	 */
+	if (time_after(basej, base->clk)) {
+		if (time_after(nextevt, basej))
+			base->clk = basej;
+		else if (time_after(nextevt, base->clk))
+			base->clk = nextevt;
+	}
+	return nextevt;
+}
+
+/* Convert the next expiry of @base into clock monotonic time */
+static u64 timer_base_next_event(struct timer_base *base, unsigned long basej,
+				 u64 basem)
+{
+	unsigned long nextevt = timer_base_next_expiry(base, basej);
+
+	if (time_before_eq(nextevt, basej))
+		return basem;
+	if (!base->timers_pending)
+		return KTIME_MAX;
+	return basem + (u64)(nextevt - basej) * TICK_NSEC;
+}
+
 /**
  * get_next_timer_interrupt - return the time (clock mono) of the next timer
  * @basej:	base time jiffies
@@ -1632,54 +1704,53 @@ static u64 cmp_next_hrtimer_event(u64 basem, u64 expires)
  *
  * Returns the tick aligned clock monotonic time of the next pending
  * timer or KTIME_MAX if no timer is pending.
+ *
+ * When the CPU goes idle its global timers are handed to the timer
+ * migration hierarchy and only the local timers, plus whatever the
+ * hierarchy asks this CPU to take care of, are accounted for.
  */
 u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-	u64 expires = KTIME_MAX;
-	unsigned long nextevt;
+	struct timer_base *base_local, *base_global;
+	u64 local_evt, global_evt, expires;
+	bool is_idle;
 
 	/*
 	 * Pretend that there is no timer pending if the cpu is offline.
 	 * Possible pending timers will be migrated later to an active cpu.
 	 */
 	if (cpu_is_offline(smp_processor_id()))
-		return expires;
+		return KTIME_MAX;
 
-	raw_spin_lock(&base->lock);
-	if (base->next_expiry_recalc)
-		base->next_expiry = __next_timer_interrupt(base);
-	nextevt = base->next_expiry;
+	base_local = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	base_global = this_cpu_ptr(&timer_bases[BASE_GLOBAL]);
+
+	raw_spin_lock(&base_local->lock);
+	raw_spin_lock_nested(&base_global->lock, SINGLE_DEPTH_NESTING);
+
+	local_evt = timer_base_next_event(base_local, basej, basem);
+	global_evt = timer_base_next_event(base_global, basej, basem);
+	expires = min(local_evt, global_evt);
 
 	/*
-	 * We have a fresh next event. Check whether we can forward the
-	 * base. We can only do that when @basej is past base->clk
-	 * otherwise we might rewind base->clk.
+	 * If we expect to sleep more than a tick, mark the bases idle.
+	 * Also the tick is stopped so any added timer must forward
+	 * the base clk itself to keep granularity small. This idle
+	 * logic is only maintained for the local and global bases,
+	 * deferrable timers may still see large granularity skew (by
+	 * design).
 	 */
-	if (time_after(basej, base->clk)) {
-		if (time_after(nextevt, basej))
-			base->clk = basej;
-		else if (time_after(nextevt, base->clk))
-			base->clk = nextevt;
-	}
+	is_idle = (expires - basem) > TICK_NSEC;
+	base_local->is_idle = is_idle;
+	base_global->is_idle = is_idle;
 
-	if (time_before_eq(nextevt, basej)) {
-		expires = basem;
-		base->is_idle = false;
-	} else {
-		if (base->timers_pending)
-			expires = basem + (u64)(nextevt - basej) * TICK_NSEC;
-		/*
-		 * If we expect to sleep more than a tick, mark the base idle.
-		 * Also the tick is stopped so any added timer must forward
-		 * the base clk itself to keep granularity small. This idle
-		 * logic is only maintained for the BASE_STD base, deferrable
-		 * timers may still see large granularity skew (by design).
-		 */
-		if ((expires - basem) > TICK_NSEC)
-			base->is_idle = true;
-	}
-	raw_spin_unlock(&base->lock);
+	raw_spin_unlock(&base_global->lock);
+	raw_spin_unlock(&base_local->lock);
+
+#ifdef CONFIG_TIMER_MIGRATION
+	if (is_idle && static_branch_likely(&timers_migration_enabled))
+		expires = min(local_evt, tmigr_cpu_deactivate(global_evt));
+#endif
 
 	return cmp_next_hrtimer_event(basem, expires);
 }
@@ -1691,29 +1762,34 @@ u64 get_next_timer_interrupt(unsigned long basej, u64 basem)
  */
 void timer_clear_idle(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
 	/*
 	 * We do this unlocked. The worst outcome is a remote enqueue sending
 	 * a pointless IPI, but taking the lock would just make the window for
 	 * sending the IPI a few instructions smaller for the cost of taking
 	 * the lock in the exit from idle path.
 	 */
-	base->is_idle = false;
+	__this_cpu_write(timer_bases[BASE_LOCAL].is_idle, false);
+	__this_cpu_write(timer_bases[BASE_GLOBAL].is_idle, false);
+
+	/* Take the global timers back from the timer migration hierarchy */
+	tmigr_cpu_activate();
 }
 #endif
 
 /**
- * __run_timers - run all expired timers (if any) on this CPU.
+ * __run_timers - run all expired timers (if any) of a timer base.
  * @base: the timer vector to be processed.
+ *
+ * Return: the number of expired timers.
  */
-static inline void __run_timers(struct timer_base *base)
+static inline unsigned int __run_timers(struct timer_base *base)
 {
 	struct hlist_head heads[LVL_DEPTH];
+	unsigned int nr = 0;
 	int levels;
 
 	if (time_before(jiffies, base->next_expiry))
-		return;
+		return 0;
 
 	timer_base_lock_expiry(base);
 	raw_spin_lock_irq(&base->lock);
@@ -1734,22 +1810,63 @@ static inline void __run_timers(struct timer_base *base)
 		base->next_expiry = __next_timer_interrupt(base);
 
 		while (levels--)
-			expire_timers(base, heads + levels);
+			nr += expire_timers(base, heads + levels);
 	}
 	raw_spin_unlock_irq(&base->lock);
 	timer_base_unlock_expiry(base);
+
+	return nr;
+}
+
+#ifdef CONFIG_TIMER_MIGRATION
+/**
+ * timer_expire_remote - expire the global timers of an idle CPU
+ * @cpu:	the idle CPU
+ *
+ * Called from the timer migration hierarchy in softirq context on the CPU
+ * which took over the global timers of @cpu.
+ *
+ * Return: the number of expired timers.
+ */
+unsigned int timer_expire_remote(unsigned int cpu)
+{
+	return __run_timers(per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu));
+}
+
+/**
+ * timer_global_next_event - clock monotonic time of the next global timer
+ * @cpu:	the CPU owning the global base
+ * @basej:	base time jiffies
+ * @basem:	base time clock monotonic
+ *
+ * Return: the next expiry of the global timers of @cpu or KTIME_MAX if none
+ * is pending.
+ */
+u64 timer_global_next_event(unsigned int cpu, unsigned long basej, u64 basem)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases[BASE_GLOBAL], cpu);
+	unsigned long flags;
+	u64 expires;
+
+	raw_spin_lock_irqsave(&base->lock, flags);
+	expires = timer_base_next_event(base, basej, basem);
+	raw_spin_unlock_irqrestore(&base->lock, flags);
+
+	return expires;
 }
+#endif
 
 /*
  * This function runs timers and the timer-tq in bottom half context.
  */
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
-
-	__run_timers(base);
-	if (IS_ENABLED(CONFIG_NO_HZ_COMMON))
+	__run_timers(this_cpu_ptr(&timer_bases[BASE_LOCAL]));
+	if (IS_ENABLED(CONFIG_NO_HZ_COMMON)) {
+		__run_timers(this_cpu_ptr(&timer_bases[BASE_GLOBAL]));
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+		tmigr_handle_remote();
+	}
 }
 
 /*
@@ -1757,19 +1874,24 @@ static __latent_entropy void run_timer_softirq(struct softirq_action *h)
  */
 static void run_local_timers(void)
 {
-	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_LOCAL]);
+	int i;
 
 	hrtimer_run_queues();
-	/* Raise the softirq only if required. */
-	if (time_before(jiffies, base->next_expiry)) {
-		if (!IS_ENABLED(CONFIG_NO_HZ_COMMON))
-			return;
-		/* CPU is awake, so check the deferrable base. */
-		base++;
-		if (time_before(jiffies, base->next_expiry))
+	/*
+	 * Raise the softirq only if required. The CPU is awake, so the
+	 * deferrable base is checked as well.
+	 */
+	for (i = 0; i < NR_BASES; i++, base++) {
+		if (time_after_eq(jiffies, base->next_expiry)) {
+			raise_softirq(TIMER_SOFTIRQ);
 			return;
+		}
 	}
-	raise_softirq(TIMER_SOFTIRQ);
+
+	/* Global timers of idle CPUs this CPU has taken over */
+	if (tmigr_requires_handle_remote())
+		raise_softirq(TIMER_SOFTIRQ);
 }
 
 /*
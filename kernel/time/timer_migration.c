@@ -0,0 +1,552 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Infrastructure for migrating the expiry of global timers of idle CPUs
+ *
+ * Timers which are not pinned to a CPU are queued on the global timer base
+ * of the local CPU. When a CPU goes idle it does not wake up for its global
+ * timers. They are handed to a hierarchy of groups instead and expired by
+ * an active CPU of the group, so idle CPUs can stay idle.
+ *
+ * The hierarchy is built at boot for all possible CPUs. Up to
+ * TMIGR_CHILDREN_PER_GROUP CPUs of a NUMA node form a level 0 group. Groups
+ * are bundled the same way into the next level, first within a node and
+ * then across nodes, until a single top level group is left.
+ *
+ * Every group tracks which of its children are active. One of the active
+ * children is the migrator of the group: it handles the events of the idle
+ * children. While a child is idle, its first event is queued in its parent
+ * group. When the last child of a group goes idle, the group itself becomes
+ * idle in its parent and so on. When the last active CPU of the whole
+ * system goes idle, it programs its own wakeup for the first event of the
+ * top level group.
+ *
+ * Locking: the per CPU lock nests outside the group locks and group locks
+ * are always taken bottom up. Neither is held while timers are expired.
+ */
+
+#include <linux/cpuhotplug.h>
+#include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+#include <linux/spinlock.h>
+#include <linux/timerqueue.h>
+#include <linux/sched/nohz.h>
+
+#include "tick-internal.h"
+#include "timer_migration.h"
+
+static DEFINE_PER_CPU(struct tmigr_cpu, tmigr_cpu);
+
+static unsigned int tmigr_hierarchy_levels __read_mostly;
+
+/* Caller must hold group->lock */
+static void tmigr_update_next(struct tmigr_group *group)
+{
+	struct timerqueue_node *node = timerqueue_getnext(&group->events);
+
+	WRITE_ONCE(group->next_expiry, node ? node->expires : KTIME_MAX);
+}
+
+/*
+ * Queue @evt in @group with expiry @expires, or just dequeue it if @expires
+ * is KTIME_MAX. Caller must hold group->lock.
+ */
+static void tmigr_queue_event(struct tmigr_group *group,
+			      struct tmigr_event *evt, u64 expires)
+{
+	if (timerqueue_node_queued(&evt->nextevt))
+		timerqueue_del(&group->events, &evt->nextevt);
+
+	if (expires != KTIME_MAX) {
+		evt->nextevt.expires = expires;
+		timerqueue_add(&group->events, &evt->nextevt);
+	}
+	tmigr_update_next(group);
+}
+
+/*
+ * Mark the child @childmask of @group inactive, then walk up as long as
+ * the groups are idle and queue their first event in their parent. A
+ * @childmask of 0 only updates the events of an already idle @group.
+ *
+ * Called with @group->lock held and interrupts disabled, the lock is
+ * released.
+ *
+ * Return: the first event of the top level group if the whole hierarchy
+ * is idle, KTIME_MAX otherwise.
+ */
+static u64 tmigr_inactive_up(struct tmigr_group *group, u8 childmask)
+{
+	struct tmigr_group *parent;
+	u64 firstexp = KTIME_MAX;
+
+	for (;;) {
+		group->active &= ~childmask;
+		if (childmask && group->migrator == childmask) {
+			WRITE_ONCE(group->migrator, group->active ?
+				   BIT(__ffs(group->active)) : 0);
+		}
+
+		if (group->active)
+			break;
+
+		parent = group->parent;
+		if (!parent) {
+			firstexp = group->next_expiry;
+			break;
+		}
+
+		raw_spin_lock_nested(&parent->lock, parent->level);
+		tmigr_queue_event(parent, &group->groupevt, group->next_expiry);
+		childmask = group->childmask;
+		raw_spin_unlock(&group->lock);
+		group = parent;
+	}
+	raw_spin_unlock(&group->lock);
+
+	return firstexp;
+}
+
+/* Called with interrupts disabled */
+static void __tmigr_cpu_activate(struct tmigr_cpu *tmc)
+{
+	struct tmigr_group *group = tmc->tmgroup;
+	struct tmigr_group *parent;
+	u8 childmask = tmc->childmask;
+	u8 was_active;
+
+	raw_spin_lock(&tmc->lock);
+	raw_spin_lock_nested(&group->lock, group->level);
+	tmc->idle = false;
+	tmigr_queue_event(group, &tmc->cpuevt, KTIME_MAX);
+	raw_spin_unlock(&tmc->lock);
+
+	for (;;) {
+		was_active = group->active;
+		group->active |= childmask;
+		if (!group->migrator)
+			WRITE_ONCE(group->migrator, childmask);
+
+		parent = group->parent;
+		if (was_active || !parent)
+			break;
+
+		/* The group is active again, its event leaves the parent */
+		raw_spin_lock_nested(&parent->lock, parent->level);
+		tmigr_queue_event(parent, &group->groupevt, KTIME_MAX);
+		childmask = group->childmask;
+		raw_spin_unlock(&group->lock);
+		group = parent;
+	}
+	raw_spin_unlock(&group->lock);
+}
+
+/**
+ * tmigr_cpu_activate - the CPU leaves idle and handles its global timers
+ *
+ * Called from timer_clear_idle() with interrupts disabled.
+ */
+void tmigr_cpu_activate(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->online || !tmc->idle)
+		return;
+
+	__tmigr_cpu_activate(tmc);
+}
+
+/* Called with interrupts disabled */
+static u64 __tmigr_cpu_deactivate(struct tmigr_cpu *tmc, u64 nextevt)
+{
+	struct tmigr_group *group = tmc->tmgroup;
+	u8 childmask = tmc->childmask;
+
+	raw_spin_lock(&tmc->lock);
+	raw_spin_lock_nested(&group->lock, group->level);
+	tmc->idle = true;
+	/* The CPU might have been idle already, then only its event changes */
+	tmigr_queue_event(group, &tmc->cpuevt, nextevt);
+	raw_spin_unlock(&tmc->lock);
+
+	return tmigr_inactive_up(group, childmask);
+}
+
+/**
+ * tmigr_cpu_deactivate - hand the global timers of the CPU to the hierarchy
+ * @nextevt:	next expiry of the global timers of the CPU
+ *
+ * Called from get_next_timer_interrupt() with interrupts disabled when the
+ * CPU is about to go idle. It may be called again while the CPU is idle to
+ * update @nextevt.
+ *
+ * Return: the time at which the CPU has to wake up for global timers. That
+ * is KTIME_MAX unless this was the last active CPU, which has to take care
+ * of the first event of the whole hierarchy.
+ */
+u64 tmigr_cpu_deactivate(u64 nextevt)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	if (!tmc->online)
+		return nextevt;
+
+	return __tmigr_cpu_deactivate(tmc, nextevt);
+}
+
+/* Expire the global timers of the idle @cpu and requeue its next event */
+static void tmigr_handle_cpu(struct tmigr_cpu *self, unsigned int cpu,
+			     unsigned long basej, u64 now)
+{
+	struct tmigr_cpu *tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+	struct tmigr_group *group = tmc->tmgroup;
+	unsigned int nr;
+	u64 next;
+
+	/* The CPU might have woken up meanwhile and handle its timers itself */
+	if (!READ_ONCE(tmc->idle))
+		return;
+
+	nr = timer_expire_remote(cpu);
+	self->nr_remote_runs++;
+	self->nr_remote_timers += nr;
+
+	raw_spin_lock_irq(&tmc->lock);
+	if (!tmc->idle || !tmc->online) {
+		raw_spin_unlock_irq(&tmc->lock);
+		return;
+	}
+	tmc->nr_migrated += nr;
+
+	/*
+	 * Read the next expiry with tmc->lock held so a concurrent update
+	 * from the CPU itself is not overwritten with a stale value.
+	 */
+	next = timer_global_next_event(cpu, basej, now);
+	raw_spin_lock_nested(&group->lock, group->level);
+	tmigr_queue_event(group, &tmc->cpuevt, next);
+	raw_spin_unlock(&tmc->lock);
+
+	tmigr_inactive_up(group, 0);
+	local_irq_enable();
+}
+
+static void tmigr_handle_group(struct tmigr_cpu *self,
+			       struct tmigr_group *group,
+			       unsigned long basej, u64 now);
+
+/* Handle the expired events of the idle @child and requeue its first one */
+static void tmigr_handle_child(struct tmigr_cpu *self,
+			       struct tmigr_group *child,
+			       unsigned long basej, u64 now)
+{
+	tmigr_handle_group(self, child, basej, now);
+
+	local_irq_disable();
+	raw_spin_lock_nested(&child->lock, child->level);
+	tmigr_inactive_up(child, 0);
+	local_irq_enable();
+}
+
+static void tmigr_handle_group(struct tmigr_cpu *self,
+			       struct tmigr_group *group,
+			       unsigned long basej, u64 now)
+{
+	struct timerqueue_node *node;
+	struct tmigr_event *evt;
+
+	raw_spin_lock_irq(&group->lock);
+	while ((node = timerqueue_getnext(&group->events)) &&
+	       node->expires <= now) {
+		evt = container_of(node, struct tmigr_event, nextevt);
+		tmigr_queue_event(group, evt, KTIME_MAX);
+		raw_spin_unlock_irq(&group->lock);
+
+		if (evt->group)
+			tmigr_handle_child(self, evt->group, basej, now);
+		else
+			tmigr_handle_cpu(self, evt->cpu, basej, now);
+
+		raw_spin_lock_irq(&group->lock);
+	}
+	raw_spin_unlock_irq(&group->lock);
+}
+
+/**
+ * tmigr_handle_remote - expire global timers of idle CPUs
+ *
+ * Called from the timer softirq. The CPU handles the expired events of all
+ * groups it is the migrator of.
+ */
+void tmigr_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long basej;
+	u8 childmask;
+	u64 now;
+
+	if (!tmc->online || tmc->idle)
+		return;
+
+	now = get_jiffies_update(&basej);
+	childmask = tmc->childmask;
+	for (group = tmc->tmgroup; group; group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask)
+			break;
+		if (READ_ONCE(group->next_expiry) <= now)
+			tmigr_handle_group(tmc, group, basej, now);
+		childmask = group->childmask;
+	}
+}
+
+/**
+ * tmigr_requires_handle_remote - check for expired events of idle CPUs
+ *
+ * Called from the tick with interrupts disabled.
+ *
+ * Return: true if the CPU is the migrator of a group with expired events.
+ */
+bool tmigr_requires_handle_remote(void)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	struct tmigr_group *group;
+	unsigned long basej;
+	u8 childmask;
+	u64 now;
+
+	if (!tmc->online || tmc->idle)
+		return false;
+
+	now = get_jiffies_update(&basej);
+	childmask = tmc->childmask;
+	for (group = tmc->tmgroup; group; group = group->parent) {
+		if (READ_ONCE(group->migrator) != childmask)
+			break;
+		if (READ_ONCE(group->next_expiry) <= now)
+			return true;
+		childmask = group->childmask;
+	}
+	return false;
+}
+
+static int tmigr_cpu_online(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+
+	/* Not part of the hierarchy, the CPU handles its timers itself */
+	if (WARN_ON_ONCE(!tmc->tmgroup))
+		return 0;
+
+	local_irq_disable();
+	tmc->online = true;
+	__tmigr_cpu_activate(tmc);
+	local_irq_enable();
+	return 0;
+}
+
+static int tmigr_cpu_offline(unsigned int cpu)
+{
+	struct tmigr_cpu *tmc = this_cpu_ptr(&tmigr_cpu);
+	unsigned int target;
+	u64 firstexp;
+
+	/*
+	 * The timers of the outgoing CPU are migrated by timers_dead_cpu(),
+	 * so there is no event to leave behind.
+	 */
+	local_irq_disable();
+	tmc->online = false;
+	firstexp = __tmigr_cpu_deactivate(tmc, KTIME_MAX);
+	local_irq_enable();
+
+	/*
+	 * If this was the last active CPU, one of the idle ones has to take
+	 * over the pending events. Kicking it out of idle makes it pick up
+	 * the first event of the hierarchy on its way back to idle.
+	 */
+	if (firstexp != KTIME_MAX) {
+		target = cpumask_any_but(cpu_online_mask, cpu);
+		if (target < nr_cpu_ids)
+			wake_up_nohz_cpu(target);
+	}
+	return 0;
+}
+
+static struct tmigr_group * __init tmigr_group_alloc(int level, int node)
+{
+	struct tmigr_group *group;
+
+	group = kzalloc_node(sizeof(*group), GFP_KERNEL, node);
+	if (!group)
+		return NULL;
+
+	raw_spin_lock_init(&group->lock);
+	timerqueue_init_head(&group->events);
+	timerqueue_init(&group->groupevt.nextevt);
+	group->groupevt.group = group;
+	group->next_expiry = KTIME_MAX;
+	group->level = level;
+	group->numa_node = node;
+	return group;
+}
+
+static int __init tmigr_cpu_node(unsigned int cpu)
+{
+	int node = cpu_to_node(cpu);
+
+	return node == NUMA_NO_NODE ? first_node(node_possible_map) : node;
+}
+
+/* Whether two consecutive groups share a node, the next level is per node */
+static bool __init tmigr_level_per_node(struct tmigr_group **groups, int nr)
+{
+	int i;
+
+	for (i = 1; i < nr; i++) {
+		if (groups[i]->numa_node != NUMA_NO_NODE &&
+		    groups[i]->numa_node == groups[i - 1]->numa_node)
+			return true;
+	}
+	return false;
+}
+
+static int __init tmigr_build_hierarchy(void)
+{
+	struct tmigr_group **children, **parents, *group, *child;
+	int nr_children = 0, nr_parents, level = 0, ret = 0;
+	struct tmigr_cpu *tmc;
+	unsigned int cpu;
+	bool per_node;
+	int node, i;
+
+	children = kcalloc(nr_cpu_ids, sizeof(*children), GFP_KERNEL);
+	parents = kcalloc(nr_cpu_ids, sizeof(*parents), GFP_KERNEL);
+	if (!children || !parents) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* Level 0: CPUs of the same node */
+	for_each_node(node) {
+		group = NULL;
+		for_each_possible_cpu(cpu) {
+			if (tmigr_cpu_node(cpu) != node)
+				continue;
+
+			if (!group || group->num_children == TMIGR_CHILDREN_PER_GROUP) {
+				group = tmigr_group_alloc(0, node);
+				if (!group) {
+					ret = -ENOMEM;
+					goto out;
+				}
+				children[nr_children++] = group;
+			}
+
+			tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+			raw_spin_lock_init(&tmc->lock);
+			timerqueue_init(&tmc->cpuevt.nextevt);
+			tmc->cpuevt.cpu = cpu;
+			tmc->idle = true;
+			tmc->tmgroup = group;
+			tmc->childmask = BIT(group->num_children++);
+		}
+	}
+
+	/* Upper levels: groups of the same node first, then across nodes */
+	while (nr_children > 1) {
+		/* Group locks of different levels nest, see lockdep subclasses */
+		if (++level >= MAX_LOCKDEP_SUBCLASSES) {
+			ret = -E2BIG;
+			goto out;
+		}
+
+		per_node = tmigr_level_per_node(children, nr_children);
+		nr_parents = 0;
+		group = NULL;
+		for (i = 0; i < nr_children; i++) {
+			child = children[i];
+			node = per_node ? child->numa_node : NUMA_NO_NODE;
+
+			if (!group || group->num_children == TMIGR_CHILDREN_PER_GROUP ||
+			    group->numa_node != node) {
+				group = tmigr_group_alloc(level, node);
+				if (!group) {
+					ret = -ENOMEM;
+					goto out;
+				}
+				parents[nr_parents++] = group;
+			}
+
+			child->parent = group;
+			child->childmask = BIT(group->num_children++);
+		}
+		swap(children, parents);
+		nr_children = nr_parents;
+	}
+	tmigr_hierarchy_levels = level + 1;
+
+out:
+	kfree(children);
+	kfree(parents);
+	return ret;
+}
+
+static int __init tmigr_init(void)
+{
+	int ret;
+
+	BUILD_BUG_ON_NOT_POWER_OF_2(TMIGR_CHILDREN_PER_GROUP);
+	BUILD_BUG_ON(TMIGR_CHILDREN_PER_GROUP > BITS_PER_TYPE(u8));
+
+	/* Nothing to migrate to */
+	if (num_possible_cpus() <= 1)
+		return 0;
+
+	ret = tmigr_build_hierarchy();
+	if (ret)
+		goto err;
+
+	ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN, "tmigr:online",
+				tmigr_cpu_online, tmigr_cpu_offline);
+	if (ret < 0)
+		goto err;
+
+	pr_info("Timer migration: %u hierarchy levels; %d children per group\n",
+		tmigr_hierarchy_levels, TMIGR_CHILDREN_PER_GROUP);
+	return 0;
+
+err:
+	pr_err("Timer migration setup failed: %d\n", ret);
+	return ret;
+}
+early_initcall(tmigr_init);
+
+static int tmigr_stats_show(struct seq_file *m, void *v)
+{
+	struct tmigr_cpu *tmc;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		tmc = per_cpu_ptr(&tmigr_cpu, cpu);
+		if (!tmc->tmgroup)
+			continue;
+		seq_printf(m, "cpu%u: online %d idle %d node %d remote_runs %lu remote_timers %lu migrated %lu\n",
+			   cpu, READ_ONCE(tmc->online), READ_ONCE(tmc->idle),
+			   tmc->tmgroup->numa_node,
+			   READ_ONCE(tmc->nr_remote_runs),
+			   READ_ONCE(tmc->nr_remote_timers),
+			   READ_ONCE(tmc->nr_migrated));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tmigr_stats);
+
+static int __init tmigr_debugfs_init(void)
+{
+	if (tmigr_hierarchy_levels)
+		debugfs_create_file("timer_migration", 0444, NULL, NULL,
+				    &tmigr_stats_fops);
+	return 0;
+}
+late_initcall(tmigr_debugfs_init);
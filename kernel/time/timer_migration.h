@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef _KERNEL_TIME_MIGRATION_H
+#define _KERNEL_TIME_MIGRATION_H
+
+/* Per group capacity. Must be a power of 2! */
+#define TMIGR_CHILDREN_PER_GROUP	8
+
+/**
+ * struct tmigr_event - a timer event queued in a group
+ * @nextevt:	timerqueue node holding the expiry time
+ * @group:	the idle child group this event represents, NULL for the
+ *		event of a CPU
+ * @cpu:	the CPU this event belongs to, only valid if @group is NULL
+ */
+struct tmigr_event {
+	struct timerqueue_node	nextevt;
+	struct tmigr_group	*group;
+	unsigned int		cpu;
+};
+
+/**
+ * struct tmigr_group - timer migration hierarchy group
+ * @lock:		protects the group and its event queue
+ * @parent:		parent group, NULL for the top level group
+ * @groupevt:		first event of the group, queued in @parent while
+ *			none of the group's children is active
+ * @events:		first events of the idle children
+ * @next_expiry:	cached expiry of the first event in @events,
+ *			KTIME_MAX if empty; read locklessly from the tick
+ * @active:		bitmask of the active children
+ * @migrator:		childmask of the active child which handles the events
+ *			of the idle children, 0 if all children are idle
+ * @childmask:		bit of this group in @parent->active
+ * @num_children:	number of children of this group
+ * @level:		level of the group in the hierarchy, 0 for the groups
+ *			of CPUs
+ * @numa_node:		NUMA node of the children, NUMA_NO_NODE if they
+ *			span several nodes
+ */
+struct tmigr_group {
+	raw_spinlock_t		lock;
+	struct tmigr_group	*parent;
+	struct tmigr_event	groupevt;
+	struct timerqueue_head	events;
+	u64			next_expiry;
+	u8			active;
+	u8			migrator;
+	u8			childmask;
+	u8			num_children;
+	int			level;
+	int			numa_node;
+};
+
+/**
+ * struct tmigr_cpu - timer migration per CPU state
+ * @lock:		protects the per CPU state
+ * @online:		the CPU takes part in the hierarchy
+ * @idle:		the CPU is idle and its global timers are handled by
+ *			the hierarchy
+ * @cpuevt:		first global timer of the CPU, queued in @tmgroup
+ *			while the CPU is idle
+ * @tmgroup:		level 0 group of the CPU
+ * @childmask:		bit of the CPU in @tmgroup->active
+ * @nr_remote_runs:	how often this CPU expired global timers of idle CPUs
+ * @nr_remote_timers:	timers of idle CPUs this CPU expired
+ * @nr_migrated:	timers of this CPU expired by other CPUs while it
+ *			was idle
+ */
+struct tmigr_cpu {
+	raw_spinlock_t		lock;
+	bool			online;
+	bool			idle;
+	struct tmigr_event	cpuevt;
+	struct tmigr_group	*tmgroup;
+	u8			childmask;
+	unsigned long		nr_remote_runs;
+	unsigned long		nr_remote_timers;
+	unsigned long		nr_migrated;
+};
+
+#endif
@@ -26,8 +26,12 @@
 #include <linux/list.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/mm.h>
 
 #include <asm/local.h>
+#include <asm/cacheflush.h>
+
+#include <uapi/linux/trace_mmap.h>
 
 static void update_pages_handler(struct work_struct *work);
 
@@ -323,6 +327,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	u32		 id;		/* ID for user space mapping */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -525,6 +530,13 @@ struct ring_buffer_per_cpu {
 	struct completion		update_done;
 
 	struct rb_irq_work		irq_work;
+
+	/* user space mapping, see ring_buffer_map() */
+	struct mutex			mapping_lock;
+	unsigned long			*subbuf_ids;	/* ID to data page */
+	struct trace_buffer_meta	*meta_page;
+	int				mapped;
+	unsigned int			user_commit;	/* end of published data */
 };
 
 struct trace_buffer {
@@ -1637,6 +1649,7 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	init_irq_work(&cpu_buffer->irq_work.work, rb_wake_up_waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.waiters);
 	init_waitqueue_head(&cpu_buffer->irq_work.full_waiters);
+	mutex_init(&cpu_buffer->mapping_lock);
 
 	bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 			    GFP_KERNEL, cpu_to_node(cpu));
@@ -5135,6 +5148,7 @@ rb_reset_cpu(struct ring_buffer_per_cpu *cpu_buffer)
 
 	cpu_buffer->lost_events = 0;
 	cpu_buffer->last_overrun = 0;
+	cpu_buffer->user_commit = 0;
 
 	rb_head_page_activate(cpu_buffer);
 }
@@ -5358,6 +5372,11 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	if (atomic_read(&cpu_buffer_b->record_disabled))
 		goto out;
 
+	/* The mapped pages would move to the other buffer */
+	ret = -EBUSY;
+	if (READ_ONCE(cpu_buffer_a->mapped) || READ_ONCE(cpu_buffer_b->mapped))
+		goto out;
+
 	/*
 	 * We can't do a synchronize_rcu here because this
 	 * function can be called in atomic context.
@@ -5563,12 +5582,14 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * If this page has been partially read or
 	 * if len is not big enough to read the rest of the page or
-	 * a writer is still on the page, then
+	 * a writer is still on the page or
+	 * the pages are mapped to user space, then
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
 	if (read || (len < (commit - read)) ||
-	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
+	    cpu_buffer->reader_page == cpu_buffer->commit_page ||
+	    cpu_buffer->mapped) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
 		unsigned int pos = 0;
@@ -5677,6 +5698,286 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/*
+ * User space mapping of a per CPU buffer.
+ *
+ * The meta page and every data page, the reader page included, are mapped
+ * read-only. A page keeps its ID while it moves between the ring and the
+ * reader slot, so user space only needs the meta page to find the reader
+ * page and reads events in place. The data pages must therefore stay put
+ * while mapped: resizing and swapping CPU buffers fail with -EBUSY, and
+ * ring_buffer_read_page() copies instead of swapping pages.
+ */
+static void rb_update_meta_page(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer_meta *meta = cpu_buffer->meta_page;
+	struct buffer_page *reader = cpu_buffer->reader_page;
+
+	WRITE_ONCE(meta->reader.id, reader->id);
+	WRITE_ONCE(meta->reader.read, reader->read);
+	WRITE_ONCE(meta->reader.commit, cpu_buffer->user_commit);
+	WRITE_ONCE(meta->entries, local_read(&cpu_buffer->entries));
+	WRITE_ONCE(meta->overrun, local_read(&cpu_buffer->overrun));
+	WRITE_ONCE(meta->read, cpu_buffer->read);
+
+	/* Some archs do not have data cache coherency with user space */
+	flush_dcache_page(virt_to_page(reader->page));
+}
+
+/* Make the unread data on the reader page, swapped in if needed, visible */
+static void rb_publish_reader(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct buffer_page *reader;
+
+	reader = rb_get_reader_page(cpu_buffer);
+	if (!reader) {
+		cpu_buffer->user_commit = cpu_buffer->reader_page->read;
+		return;
+	}
+	cpu_buffer->user_commit = rb_page_size(reader);
+
+	WRITE_ONCE(cpu_buffer->meta_page->reader.lost_events,
+		   cpu_buffer->lost_events);
+	cpu_buffer->lost_events = 0;
+}
+
+static void rb_setup_ids_meta_page(struct ring_buffer_per_cpu *cpu_buffer,
+				   unsigned long *subbuf_ids,
+				   struct trace_buffer_meta *meta)
+{
+	struct buffer_page *first, *bpage;
+	u32 id = 0;
+
+	subbuf_ids[id] = (unsigned long)cpu_buffer->reader_page->page;
+	cpu_buffer->reader_page->id = id++;
+
+	first = bpage = rb_set_head_page(cpu_buffer);
+	do {
+		if (WARN_ON(id > cpu_buffer->nr_pages))
+			break;
+		subbuf_ids[id] = (unsigned long)bpage->page;
+		bpage->id = id++;
+		rb_inc_page(&bpage);
+	} while (bpage != first);
+
+	meta->meta_page_size = PAGE_SIZE;
+	meta->meta_struct_len = sizeof(*meta);
+	meta->subbuf_size = PAGE_SIZE;
+	meta->nr_subbufs = id;
+
+	cpu_buffer->subbuf_ids = subbuf_ids;
+	cpu_buffer->meta_page = meta;
+}
+
+static int rb_alloc_mapping(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer *buffer = cpu_buffer->buffer;
+	struct trace_buffer_meta *meta;
+	unsigned long *subbuf_ids;
+	unsigned long flags;
+
+	meta = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!meta)
+		return -ENOMEM;
+
+	/* Serialize against ring_buffer_resize() */
+	mutex_lock(&buffer->mutex);
+	subbuf_ids = kcalloc(cpu_buffer->nr_pages + 1, sizeof(*subbuf_ids),
+			     GFP_KERNEL);
+	if (!subbuf_ids) {
+		mutex_unlock(&buffer->mutex);
+		free_page((unsigned long)meta);
+		return -ENOMEM;
+	}
+	atomic_inc(&cpu_buffer->resize_disabled);
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	rb_setup_ids_meta_page(cpu_buffer, subbuf_ids, meta);
+	cpu_buffer->mapped = 1;
+	rb_publish_reader(cpu_buffer);
+	rb_update_meta_page(cpu_buffer);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	mutex_unlock(&buffer->mutex);
+
+	return 0;
+}
+
+static void rb_free_mapping(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	struct trace_buffer *buffer = cpu_buffer->buffer;
+	unsigned long flags;
+
+	mutex_lock(&buffer->mutex);
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	cpu_buffer->mapped = 0;
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+	atomic_dec(&cpu_buffer->resize_disabled);
+	mutex_unlock(&buffer->mutex);
+
+	free_page((unsigned long)cpu_buffer->meta_page);
+	kfree(cpu_buffer->subbuf_ids);
+	cpu_buffer->meta_page = NULL;
+	cpu_buffer->subbuf_ids = NULL;
+}
+
+/**
+ * ring_buffer_map - map a per CPU buffer into user space
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the CPU buffer to map
+ * @vma: the VMA to map it into, read-only and at offset 0
+ *
+ * The meta page goes first, followed by the data pages in ID order. The
+ * mapping is dropped with ring_buffer_unmap().
+ *
+ * Returns 0 on success, a negative errno otherwise.
+ */
+int ring_buffer_map(struct trace_buffer *buffer, int cpu,
+		    struct vm_area_struct *vma)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	unsigned long i, nr_pages;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+	if (!cpu_buffer->mapped) {
+		err = rb_alloc_mapping(cpu_buffer);
+		if (err)
+			goto unlock;
+	} else {
+		cpu_buffer->mapped++;
+	}
+
+	nr_pages = vma_pages(vma);
+	if (nr_pages > cpu_buffer->meta_page->nr_subbufs + 1) {
+		err = -EINVAL;
+		goto unmap;
+	}
+
+	vma->vm_flags |= VM_DONTCOPY | VM_DONTEXPAND | VM_DONTDUMP;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	err = vm_insert_page(vma, vma->vm_start,
+			     virt_to_page(cpu_buffer->meta_page));
+	for (i = 1; !err && i < nr_pages; i++)
+		err = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE,
+				virt_to_page((void *)cpu_buffer->subbuf_ids[i - 1]));
+	if (!err)
+		goto unlock;
+
+unmap:
+	/* mmap_region() zaps whatever was inserted */
+	if (cpu_buffer->mapped > 1)
+		cpu_buffer->mapped--;
+	else
+		rb_free_mapping(cpu_buffer);
+unlock:
+	mutex_unlock(&cpu_buffer->mapping_lock);
+	return err;
+}
+
+/**
+ * ring_buffer_map_dup - account for a copy of an existing mapping
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * For the vm_operations open callback, e.g. when mremap() moves the VMA.
+ */
+void ring_buffer_map_dup(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+	if (!WARN_ON(!cpu_buffer->mapped))
+		cpu_buffer->mapped++;
+	mutex_unlock(&cpu_buffer->mapping_lock);
+}
+
+/**
+ * ring_buffer_unmap - drop a mapping set up by ring_buffer_map()
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * Returns 0 on success, -ENODEV if the CPU buffer was not mapped.
+ */
+int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	int err = 0;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	mutex_lock(&cpu_buffer->mapping_lock);
+	if (!cpu_buffer->mapped)
+		err = -ENODEV;
+	else if (cpu_buffer->mapped > 1)
+		cpu_buffer->mapped--;
+	else
+		rb_free_mapping(cpu_buffer);
+	mutex_unlock(&cpu_buffer->mapping_lock);
+
+	return err;
+}
+
+/**
+ * ring_buffer_map_get_reader - consume the published data, publish new data
+ * @buffer: the buffer the CPU buffer belongs to
+ * @cpu: the mapped CPU buffer
+ *
+ * The events between reader.read and reader.commit of the meta page are
+ * consumed. If the writer added events to the reader page since, those
+ * are published next. Otherwise the reader page is swapped with the head
+ * of the ring, when there is anything to read.
+ *
+ * Returns 0 on success, -ENODEV if the CPU buffer is not mapped.
+ */
+int ring_buffer_map_get_reader(struct trace_buffer *buffer, int cpu)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_page *reader;
+	unsigned long flags;
+
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
+		return -EINVAL;
+
+	cpu_buffer = buffer->buffers[cpu];
+
+	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (!cpu_buffer->mapped) {
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+		return -ENODEV;
+	}
+
+	/*
+	 * A kernel reader may have moved on meanwhile, only consume what is
+	 * still on the page that was published.
+	 */
+	reader = cpu_buffer->reader_page;
+	if (reader->id == READ_ONCE(cpu_buffer->meta_page->reader.id)) {
+		while (reader == cpu_buffer->reader_page &&
+		       reader->read < cpu_buffer->user_commit)
+			rb_advance_reader(cpu_buffer);
+	}
+
+	rb_publish_reader(cpu_buffer);
+	rb_update_meta_page(cpu_buffer);
+	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+	return 0;
+}
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
@@ -50,6 +50,8 @@
 #include <linux/irq_work.h>
 #include <linux/workqueue.h>
 
+#include <uapi/linux/trace_mmap.h>
+
 #include "trace.h"
 #include "trace_output.h"
 
@@ -1195,12 +1197,16 @@ EXPORT_SYMBOL_GPL(tracing_cond_snapshot_data);
 static int resize_buffer_duplicate_size(struct array_buffer *trace_buf,
 					struct array_buffer *size_buf, int cpu_id);
 static void set_buffer_entries(struct array_buffer *buf, unsigned long val);
+static void free_snapshot(struct trace_array *tr);
 
 int tracing_alloc_snapshot_instance(struct trace_array *tr)
 {
 	int ret;
 
 	if (!tr->allocated_snapshot) {
+		/* A mapped buffer cannot be swapped with the snapshot */
+		if (READ_ONCE(tr->mapped))
+			return -EBUSY;
 
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
@@ -1208,7 +1214,17 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 		if (ret < 0)
 			return ret;
 
-		tr->allocated_snapshot = true;
+		local_irq_disable();
+		arch_spin_lock(&tr->max_lock);
+		if (!tr->mapped)
+			tr->allocated_snapshot = true;
+		arch_spin_unlock(&tr->max_lock);
+		local_irq_enable();
+
+		if (!tr->allocated_snapshot) {
+			free_snapshot(tr);
+			return -EBUSY;
+		}
 	}
 
 	return 0;
@@ -1808,6 +1824,10 @@ update_max_tr(struct trace_array *tr, struct task_struct *tsk, int cpu,
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* The mapped buffers must stay in place */
+	if (tr->mapped)
+		goto out_unlock;
+
 	/* Inherit the recordable setting from array_buffer */
 	if (ring_buffer_record_is_set_on(tr->array_buffer.buffer))
 		ring_buffer_record_on(tr->max_buffer.buffer);
@@ -1851,6 +1871,12 @@ update_max_tr_single(struct trace_array *tr, struct task_struct *tsk, int cpu)
 
 	arch_spin_lock(&tr->max_lock);
 
+	/* The mapped buffers must stay in place */
+	if (tr->mapped) {
+		arch_spin_unlock(&tr->max_lock);
+		return;
+	}
+
 	ret = ring_buffer_swap_cpu(tr->max_buffer.buffer, tr->array_buffer.buffer, cpu);
 
 	if (ret == -EBUSY) {
@@ -5633,7 +5659,8 @@ static const char readme_msg[] =
 	"\t            [:values=<field1[,field2,...]>]\n"
 	"\t            [:sort=<field1[,field2,...]>]\n"
 	"\t            [:size=#entries]\n"
-	"\t            [:pause][:continue][:clear]\n"
+	"\t            [:pause][:continue][:clear][:clear_vals]\n"
+	"\t            [:percpu]\n"
 	"\t            [:name=histname1]\n"
 	"\t            [:<handler>.<action>]\n"
 	"\t            [if <filter>]\n\n"
@@ -5678,7 +5705,12 @@ static const char readme_msg[] =
 	"\t    restart a paused hist trigger.\n\n"
 	"\t    The 'clear' parameter will clear the contents of a running\n"
 	"\t    hist trigger and leave its current paused/active state\n"
-	"\t    unchanged.\n\n"
+	"\t    unchanged.  'clear_vals' only zeroes the values and keeps\n"
+	"\t    the keys, without pausing the trigger meanwhile.\n\n"
+	"\t    With 'percpu', values are summed per CPU and merged when\n"
+	"\t    the histogram is read.  This avoids sharing cachelines\n"
+	"\t    between CPUs hitting the same entries, at the cost of\n"
+	"\t    memory per possible CPU for each entry.\n\n"
 	"\t    The enable_hist and disable_hist triggers can be used to\n"
 	"\t    have one event conditionally start and stop another event's\n"
 	"\t    already-attached hist trigger.  The syntax is analogous to\n"
@@ -8268,12 +8300,114 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
+static long tracing_buffers_ioctl(struct file *file, unsigned int cmd,
+				  unsigned long arg)
+{
+	struct ftrace_buffer_info *info = file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOTTY;
+
+	return ring_buffer_map_get_reader(iter->array_buffer->buffer,
+					  iter->cpu_file);
+}
+
+/* A snapshot would swap the mapped buffer away, so refuse to map both. */
+static int get_snapshot_map(struct trace_array *tr)
+{
+	int ret = 0;
+
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+#ifdef CONFIG_TRACER_MAX_TRACE
+	if (tr->allocated_snapshot)
+		ret = -EBUSY;
+#endif
+	if (!ret)
+		tr->mapped++;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+
+	return ret;
+}
+
+static void put_snapshot_map(struct trace_array *tr)
+{
+	local_irq_disable();
+	arch_spin_lock(&tr->max_lock);
+	if (!WARN_ON(!tr->mapped))
+		tr->mapped--;
+	arch_spin_unlock(&tr->max_lock);
+	local_irq_enable();
+}
+
+/*
+ * vm_private_data is the mapped buffer. No snapshot can swap the buffers of
+ * the array_buffer while it is mapped, but keep the buffer that was mapped
+ * anyway.
+ */
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	WARN_ON(get_snapshot_map(info->iter.tr));
+	ring_buffer_map_dup(vma->vm_private_data, info->iter.cpu_file);
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	WARN_ON(ring_buffer_unmap(vma->vm_private_data, info->iter.cpu_file));
+	put_snapshot_map(info->iter.tr);
+}
+
+static int tracing_buffers_mmap_split(struct vm_area_struct *vma,
+				      unsigned long addr)
+{
+	/* the meta page describes the whole mapping */
+	return -EINVAL;
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.may_split	= tracing_buffers_mmap_split,
+};
+
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	struct trace_iterator *iter = &info->iter;
+	int ret;
+
+	if (iter->cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	ret = get_snapshot_map(iter->tr);
+	if (ret)
+		return ret;
+
+	ret = ring_buffer_map(iter->array_buffer->buffer, iter->cpu_file, vma);
+	if (ret) {
+		put_snapshot_map(iter->tr);
+		return ret;
+	}
+
+	vma->vm_private_data = iter->array_buffer->buffer;
+	vma->vm_ops = &tracing_buffers_vmops;
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
 	.poll		= tracing_buffers_poll,
 	.release	= tracing_buffers_release,
 	.splice_read	= tracing_buffers_splice_read,
+	.unlocked_ioctl	= tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
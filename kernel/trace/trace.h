@@ -334,6 +334,12 @@ struct trace_array {
 	 * CONFIG_TRACER_MAX_TRACE.
 	 */
 	arch_spinlock_t		max_lock;
+	/*
+	 * Number of user space mappings of the per-CPU buffers. A mapped
+	 * buffer must not be swapped with the snapshot one, so mapping and
+	 * allocating the snapshot exclude each other under max_lock.
+	 */
+	unsigned int		mapped;
 	int			buffer_disabled;
 #ifdef CONFIG_FTRACE_SYSCALLS
 	int			sys_refcount_enter;
@@ -358,6 +358,8 @@ struct hist_trigger_attrs {
 	bool		pause;
 	bool		cont;
 	bool		clear;
+	bool		clear_vals;
+	bool		percpu;
 	bool		ts_in_usecs;
 	unsigned int	map_bits;
 
@@ -1356,6 +1358,10 @@ parse_hist_trigger_attrs(struct trace_array *tr, char *trigger_str)
 			attrs->cont = true;
 		else if (strcmp(str, "clear") == 0)
 			attrs->clear = true;
+		else if (strcmp(str, "clear_vals") == 0)
+			attrs->clear_vals = true;
+		else if (strcmp(str, "percpu") == 0)
+			attrs->percpu = true;
 		else {
 			ret = parse_action(str, attrs);
 			if (ret)
@@ -4551,6 +4557,7 @@ create_hist_data(unsigned int map_bits,
 		hist_data->map = NULL;
 		goto free;
 	}
+	hist_data->map->percpu_sums = attrs->percpu;
 
 	ret = create_tracing_map_fields(hist_data);
 	if (ret)
@@ -4899,8 +4906,8 @@ static void hist_trigger_show(struct seq_file *m,
 	track_data_snapshot_print(m, hist_data);
 
 	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %u\n    Dropped: %llu\n",
-		   (u64)atomic64_read(&hist_data->map->hits),
-		   n_entries, (u64)atomic64_read(&hist_data->map->drops));
+		   tracing_map_read_hits(hist_data->map),
+		   n_entries, tracing_map_read_drops(hist_data->map));
 }
 
 static int hist_show(struct seq_file *m, void *v)
@@ -5340,6 +5347,8 @@ static int event_hist_trigger_print(struct seq_file *m,
 			seq_puts(m, ".descending");
 	}
 	seq_printf(m, ":size=%u", (1 << hist_data->map->map_bits));
+	if (hist_data->map->percpu_sums)
+		seq_puts(m, ":percpu");
 	if (hist_data->enable_timestamps)
 		seq_printf(m, ":clock=%s", hist_data->attrs->clock);
 
@@ -5472,6 +5481,14 @@ static void hist_clear(struct event_trigger_data *data)
 		unpause_named_trigger(data);
 }
 
+/* Zero the values in place, the trigger keeps running */
+static void hist_clear_vals(struct event_trigger_data *data)
+{
+	struct hist_trigger_data *hist_data = data->private_data;
+
+	tracing_map_clear_sums(hist_data->map);
+}
+
 static bool compatible_field(struct ftrace_event_field *field,
 			     struct ftrace_event_field *test_field)
 {
@@ -5598,6 +5615,8 @@ static int hist_register_trigger(char *glob, struct event_trigger_ops *ops,
 				test->paused = false;
 			else if (hist_data->attrs->clear)
 				hist_clear(test);
+			else if (hist_data->attrs->clear_vals)
+				hist_clear_vals(test);
 			else {
 				hist_err(tr, HIST_ERR_TRIGGER_EEXIST, 0);
 				ret = -EEXIST;
@@ -5606,7 +5625,8 @@ static int hist_register_trigger(char *glob, struct event_trigger_ops *ops,
 		}
 	}
  new:
-	if (hist_data->attrs->cont || hist_data->attrs->clear) {
+	if (hist_data->attrs->cont || hist_data->attrs->clear ||
+	    hist_data->attrs->clear_vals) {
 		hist_err(tr, HIST_ERR_TRIGGER_ENOENT_CLEAR, 0);
 		ret = -ENOENT;
 		goto out;
@@ -5920,7 +5940,8 @@ static int event_hist_trigger_func(struct event_command *cmd_ops,
 	 * triggers registered a failure too.
 	 */
 	if (!ret) {
-		if (!(attrs->pause || attrs->cont || attrs->clear))
+		if (!(attrs->pause || attrs->cont || attrs->clear ||
+		      attrs->clear_vals))
 			ret = -ENOENT;
 		goto out_free;
 	} else if (ret < 0)
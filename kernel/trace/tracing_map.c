@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/sort.h>
 #include <linux/kmemleak.h>
+#include <linux/percpu.h>
 
 #include "tracing_map.h"
 #include "trace.h"
@@ -38,7 +39,15 @@
  */
 void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
 {
-	atomic64_add(n, &elt->fields[i].sum);
+	/*
+	 * Atomic because tracing_map_fold_sums() drains it from another
+	 * CPU, but the cacheline stays with the CPU producing the events.
+	 * Being migrated meanwhile just adds to another CPU's part.
+	 */
+	if (elt->pcpu_sums)
+		atomic64_add(n, raw_cpu_ptr(elt->pcpu_sums) + i);
+	else
+		atomic64_add(n, &elt->fields[i].sum);
 }
 
 /**
@@ -55,7 +64,14 @@ void tracing_map_update_sum(struct tracing_map_elt *elt, unsigned int i, u64 n)
  */
 u64 tracing_map_read_sum(struct tracing_map_elt *elt, unsigned int i)
 {
-	return (u64)atomic64_read(&elt->fields[i].sum);
+	u64 sum = atomic64_read(&elt->fields[i].sum);
+	int cpu;
+
+	if (elt->pcpu_sums)
+		for_each_possible_cpu(cpu)
+			sum += atomic64_read(per_cpu_ptr(elt->pcpu_sums, cpu) + i);
+
+	return sum;
 }
 
 /**
@@ -355,13 +371,50 @@ static struct tracing_map_array *tracing_map_array_alloc(unsigned int n_elts,
 	goto out;
 }
 
+/* Move the per-CPU parts of the sums into fields[], which sorting uses */
+static void tracing_map_fold_sums(struct tracing_map_elt *elt)
+{
+	atomic64_t *part;
+	unsigned int i;
+	s64 val;
+	int cpu;
+
+	if (!elt->pcpu_sums)
+		return;
+
+	for (i = 0; i < elt->map->n_fields; i++) {
+		if (elt->fields[i].cmp_fn != tracing_map_cmp_atomic64)
+			continue;
+		for_each_possible_cpu(cpu) {
+			part = per_cpu_ptr(elt->pcpu_sums, cpu) + i;
+			if (!atomic64_read(part))
+				continue;
+			val = atomic64_xchg(part, 0);
+			atomic64_add(val, &elt->fields[i].sum);
+		}
+	}
+}
+
+static void tracing_map_elt_clear_sums(struct tracing_map_elt *elt)
+{
+	unsigned int i;
+	int cpu;
+
+	for (i = 0; i < elt->map->n_fields; i++) {
+		if (elt->fields[i].cmp_fn != tracing_map_cmp_atomic64)
+			continue;
+		atomic64_set(&elt->fields[i].sum, 0);
+		if (elt->pcpu_sums)
+			for_each_possible_cpu(cpu)
+				atomic64_set(per_cpu_ptr(elt->pcpu_sums, cpu) + i, 0);
+	}
+}
+
 static void tracing_map_elt_clear(struct tracing_map_elt *elt)
 {
 	unsigned i;
 
-	for (i = 0; i < elt->map->n_fields; i++)
-		if (elt->fields[i].cmp_fn == tracing_map_cmp_atomic64)
-			atomic64_set(&elt->fields[i].sum, 0);
+	tracing_map_elt_clear_sums(elt);
 
 	for (i = 0; i < elt->map->n_vars; i++) {
 		atomic64_set(&elt->vars[i], 0);
@@ -393,6 +446,7 @@ static void tracing_map_elt_free(struct tracing_map_elt *elt)
 
 	if (elt->map->ops && elt->map->ops->elt_free)
 		elt->map->ops->elt_free(elt);
+	free_percpu(elt->pcpu_sums);
 	kfree(elt->fields);
 	kfree(elt->vars);
 	kfree(elt->var_set);
@@ -423,6 +477,15 @@ static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
 		goto free;
 	}
 
+	if (map->percpu_sums) {
+		elt->pcpu_sums = __alloc_percpu(map->n_fields * sizeof(atomic64_t),
+						__alignof__(atomic64_t));
+		if (!elt->pcpu_sums) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
 	elt->vars = kcalloc(map->n_vars, sizeof(*elt->vars), GFP_KERNEL);
 	if (!elt->vars) {
 		err = -ENOMEM;
@@ -535,7 +598,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 			if (val &&
 			    keys_match(key, val->key, map->key_size)) {
 				if (!lookup_only)
-					atomic64_inc(&map->hits);
+					this_cpu_inc(map->stats->hits);
 				return val;
 			} else if (unlikely(!val)) {
 				/*
@@ -552,7 +615,7 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 
 				dup_try++;
 				if (dup_try > map->map_size) {
-					atomic64_inc(&map->drops);
+					this_cpu_inc(map->stats->drops);
 					break;
 				}
 				continue;
@@ -568,14 +631,14 @@ __tracing_map_insert(struct tracing_map *map, void *key, bool lookup_only)
 
 				elt = get_free_elt(map);
 				if (!elt) {
-					atomic64_inc(&map->drops);
+					this_cpu_inc(map->stats->drops);
 					entry->key = 0;
 					break;
 				}
 
 				memcpy(elt->key, key, map->key_size);
 				entry->val = elt;
-				atomic64_inc(&map->hits);
+				this_cpu_inc(map->stats->hits);
 
 				return entry->val;
 			} else {
@@ -676,6 +739,7 @@ void tracing_map_destroy(struct tracing_map *map)
 	tracing_map_free_elts(map);
 
 	tracing_map_array_free(map->map);
+	free_percpu(map->stats);
 	kfree(map);
 }
 
@@ -693,10 +757,13 @@ void tracing_map_destroy(struct tracing_map *map)
 void tracing_map_clear(struct tracing_map *map)
 {
 	unsigned int i;
+	int cpu;
 
 	atomic_set(&map->next_elt, -1);
-	atomic64_set(&map->hits, 0);
-	atomic64_set(&map->drops, 0);
+	for_each_possible_cpu(cpu) {
+		per_cpu_ptr(map->stats, cpu)->hits = 0;
+		per_cpu_ptr(map->stats, cpu)->drops = 0;
+	}
 
 	tracing_map_array_clear(map->map);
 
@@ -704,6 +771,58 @@ void tracing_map_clear(struct tracing_map *map)
 		tracing_map_elt_clear(*(TRACING_MAP_ELT(map->elts, i)));
 }
 
+/**
+ * tracing_map_clear_sums - Zero the sums of a tracing_map
+ * @map: The tracing_map to clear
+ *
+ * Unlike tracing_map_clear(), the keys stay in place and the sums are
+ * zeroed one by one, so writers may keep updating the map meanwhile.
+ * An update racing with this ends up either before or after the clear.
+ */
+void tracing_map_clear_sums(struct tracing_map *map)
+{
+	unsigned int i, n_elts;
+
+	n_elts = min_t(unsigned int, atomic_read(&map->next_elt) + 1,
+		       map->max_elts);
+
+	for (i = 0; i < n_elts; i++)
+		tracing_map_elt_clear_sums(*(TRACING_MAP_ELT(map->elts, i)));
+}
+
+static u64 tracing_map_read_stat(struct tracing_map *map, size_t offset)
+{
+	u64 sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += *(u64 *)((void *)per_cpu_ptr(map->stats, cpu) + offset);
+
+	return sum;
+}
+
+/**
+ * tracing_map_read_hits - Return the number of hits of a tracing_map
+ * @map: The tracing_map
+ *
+ * Return: the number of successful inserts and lookups by inserters.
+ */
+u64 tracing_map_read_hits(struct tracing_map *map)
+{
+	return tracing_map_read_stat(map, offsetof(struct tracing_map_stats, hits));
+}
+
+/**
+ * tracing_map_read_drops - Return the number of drops of a tracing_map
+ * @map: The tracing_map
+ *
+ * Return: the number of inserts that failed for lack of free elements.
+ */
+u64 tracing_map_read_drops(struct tracing_map *map)
+{
+	return tracing_map_read_stat(map, offsetof(struct tracing_map_stats, drops));
+}
+
 static void set_sort_key(struct tracing_map *map,
 			 struct tracing_map_sort_key *sort_key)
 {
@@ -785,6 +904,10 @@ struct tracing_map *tracing_map_create(unsigned int map_bits,
 
 	map->private_data = private_data;
 
+	map->stats = alloc_percpu(struct tracing_map_stats);
+	if (!map->stats)
+		goto free;
+
 	map->map = tracing_map_array_alloc(map->map_size,
 					   sizeof(struct tracing_map_entry));
 	if (!map->map)
@@ -1087,6 +1210,7 @@ int tracing_map_sort_entries(struct tracing_map *map,
 		if (!entry->key || !entry->val)
 			continue;
 
+		tracing_map_fold_sums(entry->val);
 		entries[n_entries] = create_sort_entry(entry->val->key,
 						       entry->val);
 		if (!entries[n_entries++]) {
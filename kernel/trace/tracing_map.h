@@ -138,6 +138,8 @@ struct tracing_map_field {
 struct tracing_map_elt {
 	struct tracing_map		*map;
 	struct tracing_map_field	*fields;
+	/* per-CPU parts of the sums, folded into fields[] before sorting */
+	atomic64_t __percpu		*pcpu_sums;
 	atomic64_t			*vars;
 	bool				*var_set;
 	void				*key;
@@ -180,6 +182,12 @@ struct tracing_map_array {
 #define TRACING_MAP_ELT(array, idx)					\
 	((struct tracing_map_elt **)TRACING_MAP_ARRAY_ELT(array, idx))
 
+/* hits and drops, per CPU so that inserts don't share a cacheline */
+struct tracing_map_stats {
+	u64				hits;
+	u64				drops;
+};
+
 struct tracing_map {
 	unsigned int			key_size;
 	unsigned int			map_bits;
@@ -196,8 +204,8 @@ struct tracing_map {
 	unsigned int			n_keys;
 	struct tracing_map_sort_key	sort_key;
 	unsigned int			n_vars;
-	atomic64_t			hits;
-	atomic64_t			drops;
+	bool				percpu_sums;
+	struct tracing_map_stats __percpu *stats;
 };
 
 /**
@@ -252,6 +260,9 @@ extern int tracing_map_add_key_field(struct tracing_map *map,
 
 extern void tracing_map_destroy(struct tracing_map *map);
 extern void tracing_map_clear(struct tracing_map *map);
+extern void tracing_map_clear_sums(struct tracing_map *map);
+extern u64 tracing_map_read_hits(struct tracing_map *map);
+extern u64 tracing_map_read_drops(struct tracing_map *map);
 
 extern struct tracing_map_elt *
 tracing_map_insert(struct tracing_map *map, void *key);
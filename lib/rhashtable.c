@@ -29,6 +29,9 @@
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
 
+/* Buckets an insertion moves to the new table while a rehash is running */
+#define RHT_INSERT_REHASH	2U
+
 union nested_table {
 	union nested_table __rcu *table;
 	struct rhash_lock_head __rcu *bucket;
@@ -222,10 +225,10 @@ static struct bucket_table *rhashtable_last_table(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
 				 struct rhash_lock_head __rcu **bkt,
 				 unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht, old_tbl);
 	int err = -EAGAIN;
 	struct rhash_head *head, *next, *entry;
@@ -272,9 +275,9 @@ static int rhashtable_rehash_one(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_chain(struct rhashtable *ht,
+				    struct bucket_table *old_tbl,
 				    unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct rhash_lock_head __rcu **bkt = rht_bucket_var(old_tbl, old_hash);
 	int err;
 
@@ -282,7 +285,7 @@ static int rhashtable_rehash_chain(struct rhashtable *ht,
 		return 0;
 	rht_lock(old_tbl, bkt);
 
-	while (!(err = rhashtable_rehash_one(ht, bkt, old_hash)))
+	while (!(err = rhashtable_rehash_one(ht, old_tbl, bkt, old_hash)))
 		;
 
 	if (err == -ENOENT)
@@ -292,6 +295,59 @@ static int rhashtable_rehash_chain(struct rhashtable *ht,
 	return err;
 }
 
+/*
+ * Move up to @n buckets of @old_tbl to the newest table.  Buckets are
+ * handed out by old_tbl->rehash so that the worker and inserting tasks
+ * can share the work, old_tbl->rehash_busy tells the worker whether a
+ * bucket that was handed out may still be in flight.
+ */
+static int rhashtable_rehash_chains(struct rhashtable *ht,
+				    struct bucket_table *old_tbl,
+				    unsigned int n)
+{
+	unsigned int old_hash;
+	int err = 0;
+
+	atomic_inc(&old_tbl->rehash_busy);
+	while (n--) {
+		old_hash = atomic_fetch_inc(&old_tbl->rehash);
+		if (old_hash >= old_tbl->size)
+			break;
+
+		err = rhashtable_rehash_chain(ht, old_tbl, old_hash);
+		if (err) {
+			/* The bucket may be half done, start over */
+			atomic_set(&old_tbl->rehash, 0);
+			break;
+		}
+	}
+	smp_mb__before_atomic();
+	atomic_dec(&old_tbl->rehash_busy);
+
+	return err;
+}
+
+/*
+ * Called by insertions that take the slow path while a rehash is
+ * running.  Each of them moves a few buckets on behalf of the worker,
+ * which bounds the work done by a single insertion and makes the rehash
+ * finish with the insert rate instead of lagging behind it.
+ */
+static void rhashtable_rehash_help(struct rhashtable *ht)
+{
+	struct bucket_table *old_tbl = rcu_dereference(ht->tbl);
+
+	if (!rcu_access_pointer(old_tbl->future_tbl) ||
+	    atomic_read(&old_tbl->rehash) >= old_tbl->size)
+		return;
+
+	/* Nothing can be moved into a nested table, leave it to the worker */
+	if (rhashtable_last_table(ht, old_tbl)->nest)
+		return;
+
+	rhashtable_rehash_chains(ht, old_tbl, RHT_INSERT_REHASH);
+}
+
 static int rhashtable_rehash_attach(struct rhashtable *ht,
 				    struct bucket_table *old_tbl,
 				    struct bucket_table *new_tbl)
@@ -314,19 +370,29 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
-	unsigned int old_hash;
 	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
-		err = rhashtable_rehash_chain(ht, old_hash);
-		if (err)
-			return err;
-		cond_resched();
-	}
+	do {
+		while (atomic_read(&old_tbl->rehash) < old_tbl->size) {
+			err = rhashtable_rehash_chains(ht, old_tbl, 1);
+			if (err)
+				return err;
+			cond_resched();
+		}
+
+		/* Wait for insertions to finish the buckets they took */
+		smp_rmb();
+		while (atomic_read_acquire(&old_tbl->rehash_busy)) {
+			cond_resched();
+			cpu_relax();
+		}
+
+		/* One of them failed and started over */
+	} while (atomic_read(&old_tbl->rehash) < old_tbl->size);
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
@@ -633,6 +699,7 @@ void *rhashtable_insert_slow(struct rhashtable *ht, const void *key,
 
 	do {
 		rcu_read_lock();
+		rhashtable_rehash_help(ht);
 		data = rhashtable_try_insert(ht, key, obj);
 		rcu_read_unlock();
 	} while (PTR_ERR(data) == -EAGAIN);
@@ -26,12 +26,53 @@ static int init_alloc_hint(struct sbitmap *sb, gfp_t flags)
 	return 0;
 }
 
+/*
+ * With sb->numa set, the words are split in nr_node_ids consecutive ranges
+ * and node @nid prefers the words from sbitmap_node_word(sb, nid) up to
+ * sbitmap_node_word(sb, nid + 1). The range is recomputed from map_nr, so it
+ * follows sbitmap_resize().
+ */
+static inline unsigned int sbitmap_node_word(struct sbitmap *sb, int nid)
+{
+	return nid * sb->map_nr / nr_node_ids;
+}
+
+static inline bool sbitmap_word_is_remote(struct sbitmap *sb,
+					  unsigned int index, int nid)
+{
+	unsigned int first = sbitmap_node_word(sb, nid);
+	unsigned int last = sbitmap_node_word(sb, nid + 1);
+
+	/* A node without words of its own takes them from anywhere */
+	return first < last && (index < first || index >= last);
+}
+
+/* Move @hint back into the words of the local node if it left them */
+static unsigned int sbitmap_node_hint(struct sbitmap *sb, unsigned int hint,
+				      unsigned int depth)
+{
+	int nid = numa_node_id();
+	unsigned int first, nr;
+
+	if (!depth || !sbitmap_word_is_remote(sb, SB_NR_TO_INDEX(sb, hint), nid))
+		return hint;
+
+	first = sbitmap_node_word(sb, nid);
+	nr = (sbitmap_node_word(sb, nid + 1) - first) << sb->shift;
+	hint = min((first << sb->shift) + prandom_u32() % nr, depth - 1);
+	this_cpu_write(*sb->alloc_hint, hint);
+
+	return hint;
+}
+
 static inline unsigned update_alloc_hint_before_get(struct sbitmap *sb,
 						    unsigned int depth)
 {
 	unsigned hint;
 
 	hint = this_cpu_read(*sb->alloc_hint);
+	if (unlikely(sb->numa))
+		hint = sbitmap_node_hint(sb, hint, depth);
 	if (unlikely(hint >= depth)) {
 		hint = depth ? prandom_u32() % depth : 0;
 		this_cpu_write(*sb->alloc_hint, hint);
@@ -45,6 +86,11 @@ static inline void update_alloc_hint_after_get(struct sbitmap *sb,
 					       unsigned int hint,
 					       unsigned int nr)
 {
+	/* Local words were full, count the bits stolen from another node */
+	if (unlikely(sb->numa) && nr != -1 &&
+	    sbitmap_word_is_remote(sb, SB_NR_TO_INDEX(sb, nr), numa_node_id()))
+		this_cpu_inc(*sb->remote_alloc);
+
 	if (nr == -1) {
 		/* If the map is full, a hint won't do us much good. */
 		this_cpu_write(*sb->alloc_hint, 0);
@@ -98,6 +144,8 @@ int sbitmap_init_node(struct sbitmap *sb, unsigned int depth, int shift,
 	sb->depth = depth;
 	sb->map_nr = DIV_ROUND_UP(sb->depth, bits_per_word);
 	sb->round_robin = round_robin;
+	sb->numa = false;
+	sb->remote_alloc = NULL;
 
 	if (depth == 0) {
 		sb->map = NULL;
@@ -125,6 +173,21 @@ int sbitmap_init_node(struct sbitmap *sb, unsigned int depth, int shift,
 }
 EXPORT_SYMBOL_GPL(sbitmap_init_node);
 
+int sbitmap_enable_numa(struct sbitmap *sb, gfp_t flags)
+{
+	if (nr_node_ids < 2 || sb->round_robin || !sb->alloc_hint ||
+	    sb->map_nr < nr_node_ids)
+		return 0;
+
+	sb->remote_alloc = alloc_percpu_gfp(unsigned long, flags);
+	if (!sb->remote_alloc)
+		return -ENOMEM;
+	sb->numa = true;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sbitmap_enable_numa);
+
 void sbitmap_resize(struct sbitmap *sb, unsigned int depth)
 {
 	unsigned int bits_per_word = 1U << sb->shift;
@@ -342,6 +405,14 @@ void sbitmap_show(struct sbitmap *sb, struct seq_file *m)
 	seq_printf(m, "cleared=%u\n", sbitmap_cleared(sb));
 	seq_printf(m, "bits_per_word=%u\n", 1U << sb->shift);
 	seq_printf(m, "map_nr=%u\n", sb->map_nr);
+	if (sb->numa) {
+		unsigned long remote = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			remote += *per_cpu_ptr(sb->remote_alloc, cpu);
+		seq_printf(m, "remote_alloc=%lu\n", remote);
+	}
 }
 EXPORT_SYMBOL_GPL(sbitmap_show);
 
@@ -420,8 +491,17 @@ static unsigned int sbq_calc_wake_batch(struct sbitmap_queue *sbq,
 	shallow_depth = min(1U << sbq->sb.shift, sbq->min_shallow_depth);
 	depth = ((depth >> sbq->sb.shift) * shallow_depth +
 		 min(depth & ((1U << sbq->sb.shift) - 1), shallow_depth));
-	wake_batch = clamp_t(unsigned int, depth / SBQ_WAIT_QUEUES, 1,
-			     SBQ_WAKE_BATCH);
+
+	/*
+	 * A NUMA aware bitmap mostly frees a node's bits to the waiters of
+	 * the same node, so size the batch for one node's share of the bits
+	 * and of the wait queues.
+	 */
+	if (sbq->sb.numa)
+		wake_batch = depth / nr_node_ids / sbq_node_wait_queues();
+	else
+		wake_batch = depth / SBQ_WAIT_QUEUES;
+	wake_batch = clamp_t(unsigned int, wake_batch, 1, SBQ_WAKE_BATCH);
 
 	return wake_batch;
 }
@@ -476,6 +556,19 @@ static void sbitmap_queue_update_wake_batch(struct sbitmap_queue *sbq,
 	}
 }
 
+int sbitmap_queue_enable_numa(struct sbitmap_queue *sbq, gfp_t flags)
+{
+	int ret;
+
+	ret = sbitmap_enable_numa(&sbq->sb, flags);
+	if (ret)
+		return ret;
+
+	sbitmap_queue_update_wake_batch(sbq, sbq->sb.depth);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sbitmap_queue_enable_numa);
+
 void sbitmap_queue_resize(struct sbitmap_queue *sbq, unsigned int depth)
 {
 	sbitmap_queue_update_wake_batch(sbq, depth);
@@ -489,6 +582,56 @@ int __sbitmap_queue_get(struct sbitmap_queue *sbq)
 }
 EXPORT_SYMBOL_GPL(__sbitmap_queue_get);
 
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned int hint, depth;
+	unsigned long index, nr;
+	int i;
+
+	if (unlikely(sb->round_robin))
+		return 0;
+
+	depth = READ_ONCE(sb->depth);
+	hint = update_alloc_hint_before_get(sb, depth);
+
+	index = SB_NR_TO_INDEX(sb, hint);
+
+	for (i = 0; i < sb->map_nr; i++) {
+		struct sbitmap_word *map = &sb->map[index];
+		unsigned long get_mask;
+
+		sbitmap_deferred_clear(map);
+		nr = find_first_zero_bit(&map->word, map->depth);
+		if (nr + nr_tags <= map->depth) {
+			atomic_long_t *ptr = (atomic_long_t *) &map->word;
+			unsigned long val;
+
+			get_mask = ((1UL << nr_tags) - 1) << nr;
+			val = READ_ONCE(map->word);
+			while (!atomic_long_try_cmpxchg(ptr, (long *)&val,
+							get_mask | val))
+				;
+			/* Only the bits that were still free are ours */
+			get_mask = (get_mask & ~val) >> nr;
+			if (get_mask) {
+				*offset = nr + (index << sb->shift);
+				update_alloc_hint_after_get(sb, depth, hint,
+							*offset + nr_tags - 1);
+				return get_mask;
+			}
+		}
+
+		/* Jump to next index. */
+		if (++index >= sb->map_nr)
+			index = 0;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(__sbitmap_queue_get_batch);
+
 int __sbitmap_queue_get_shallow(struct sbitmap_queue *sbq,
 				unsigned int shallow_depth)
 {
@@ -514,6 +657,9 @@ static struct sbq_wait_state *sbq_wake_ptr(struct sbitmap_queue *sbq)
 		return NULL;
 
 	wake_index = atomic_read(&sbq->wake_index);
+	/* Look at the queues of the local node first */
+	if (sbq->sb.numa)
+		wake_index = sbq_node_wait_index(numa_node_id(), wake_index);
 	for (i = 0; i < SBQ_WAIT_QUEUES; i++) {
 		struct sbq_wait_state *ws = &sbq->ws[wake_index];
 
@@ -577,6 +723,12 @@ void sbitmap_queue_wake_up(struct sbitmap_queue *sbq)
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_wake_up);
 
+static inline void sbitmap_update_cpu_hint(struct sbitmap *sb, int cpu, int tag)
+{
+	if (likely(!sb->round_robin && tag < sb->depth))
+		*per_cpu_ptr(sb->alloc_hint, cpu) = tag;
+}
+
 void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 			 unsigned int cpu)
 {
@@ -601,12 +753,47 @@ void sbitmap_queue_clear(struct sbitmap_queue *sbq, unsigned int nr,
 	 */
 	smp_mb__after_atomic();
 	sbitmap_queue_wake_up(sbq);
-
-	if (likely(!sbq->sb.round_robin && nr < sbq->sb.depth))
-		*per_cpu_ptr(sbq->sb.alloc_hint, cpu) = nr;
+	sbitmap_update_cpu_hint(&sbq->sb, cpu, nr);
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_clear);
 
+void sbitmap_queue_clear_batch(struct sbitmap_queue *sbq, int offset,
+			       int *tags, int nr_tags)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned long *addr = NULL;
+	unsigned long mask = 0;
+	int i;
+
+	/* See sbitmap_queue_clear() for the barriers */
+	smp_mb__before_atomic();
+	for (i = 0; i < nr_tags; i++) {
+		const int tag = tags[i] - offset;
+		unsigned long *this_addr;
+
+		/* Clearing a batch anyway, skip the deferred map */
+		this_addr = &sb->map[SB_NR_TO_INDEX(sb, tag)].word;
+		if (!addr) {
+			addr = this_addr;
+		} else if (addr != this_addr) {
+			atomic_long_andnot(mask, (atomic_long_t *) addr);
+			mask = 0;
+			addr = this_addr;
+		}
+		mask |= (1UL << SB_NR_TO_BIT(sb, tag));
+	}
+
+	if (mask)
+		atomic_long_andnot(mask, (atomic_long_t *) addr);
+
+	smp_mb__after_atomic();
+	for (i = 0; i < nr_tags; i++)
+		sbitmap_queue_wake_up(sbq);
+	sbitmap_update_cpu_hint(&sbq->sb, raw_smp_processor_id(),
+				tags[nr_tags - 1] - offset);
+}
+EXPORT_SYMBOL_GPL(sbitmap_queue_clear_batch);
+
 void sbitmap_queue_wake_all(struct sbitmap_queue *sbq)
 {
 	int i, wake_index;
@@ -660,6 +847,7 @@ void sbitmap_queue_show(struct sbitmap_queue *sbq, struct seq_file *m)
 	seq_puts(m, "}\n");
 
 	seq_printf(m, "round_robin=%d\n", sbq->sb.round_robin);
+	seq_printf(m, "numa=%d\n", sbq->sb.numa);
 	seq_printf(m, "min_shallow_depth=%u\n", sbq->min_shallow_depth);
 }
 EXPORT_SYMBOL_GPL(sbitmap_queue_show);
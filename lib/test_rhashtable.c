@@ -74,6 +74,10 @@ struct thread_data {
 	int id;
 	struct task_struct *task;
 	struct test_obj *objs;
+	u64 insert_ns;
+	u64 lookup_ns;
+	u64 remove_ns;
+	unsigned int removes;
 };
 
 static u32 my_hashfn(const void *data, u32 len, u32 seed)
@@ -633,6 +637,7 @@ static int threadfunc(void *data)
 {
 	int i, step, err = 0, insert_retries = 0;
 	struct thread_data *tdata = data;
+	u64 start;
 
 	if (atomic_dec_and_test(&startup_count))
 		wake_up(&startup_wait);
@@ -641,6 +646,8 @@ static int threadfunc(void *data)
 		goto out;
 	}
 
+	/* The table starts small, so the inserts race with its resizes */
+	start = ktime_get_ns();
 	for (i = 0; i < tdata->entries; i++) {
 		tdata->objs[i].value.id = i;
 		tdata->objs[i].value.tid = tdata->id;
@@ -653,11 +660,14 @@ static int threadfunc(void *data)
 			goto out;
 		}
 	}
+	tdata->insert_ns = ktime_get_ns() - start;
 	if (insert_retries)
 		pr_info("  thread[%d]: %u insertions retried due to memory pressure\n",
 			tdata->id, insert_retries);
 
+	start = ktime_get_ns();
 	err = thread_lookup_test(tdata);
+	tdata->lookup_ns = ktime_get_ns() - start;
 	if (err) {
 		pr_err("  thread[%d]: rhashtable_lookup_test failed\n",
 		       tdata->id);
@@ -665,9 +675,11 @@ static int threadfunc(void *data)
 	}
 
 	for (step = 10; step > 0; step--) {
+		start = ktime_get_ns();
 		for (i = 0; i < tdata->entries; i += step) {
 			if (tdata->objs[i].value.id == TEST_INSERT_FAIL)
 				continue;
+			tdata->removes++;
 			err = rhashtable_remove_fast(&ht, &tdata->objs[i].node,
 			                             test_rht_params);
 			if (err) {
@@ -679,6 +691,7 @@ static int threadfunc(void *data)
 
 			cond_resched();
 		}
+		tdata->remove_ns += ktime_get_ns() - start;
 		err = thread_lookup_test(tdata);
 		if (err) {
 			pr_err("  thread[%d]: rhashtable_lookup_test (2) failed\n",
@@ -694,6 +707,31 @@ static int threadfunc(void *data)
 	return err;
 }
 
+/* Average cost of each operation while all threads were running it */
+static void __init test_thread_stats(struct thread_data *tdata, int threads)
+{
+	u64 insert_ns = 0, lookup_ns = 0, remove_ns = 0;
+	u64 entries = 0, removes = 0;
+	int i;
+
+	for (i = 0; i < tcount; i++) {
+		if (IS_ERR(tdata[i].task))
+			continue;
+		insert_ns += tdata[i].insert_ns;
+		lookup_ns += tdata[i].lookup_ns;
+		remove_ns += tdata[i].remove_ns;
+		entries += tdata[i].entries;
+		removes += tdata[i].removes;
+	}
+	if (!threads || !entries)
+		return;
+
+	pr_info("  %d threads: insert %llu ns, lookup %llu ns, remove %llu ns per op\n",
+		threads, div64_u64(insert_ns, entries),
+		div64_u64(lookup_ns, entries),
+		removes ? div64_u64(remove_ns, removes) : 0);
+}
+
 static int __init test_rht_init(void)
 {
 	unsigned int entries;
@@ -805,6 +843,7 @@ static int __init test_rht_init(void)
 			failed_threads++;
 		}
 	}
+	test_thread_stats(tdata, started_threads);
 	rhashtable_destroy(&ht);
 	vfree(tdata);
 	vfree(objs);
@@ -63,26 +63,6 @@ static void xa_erase_index(struct xarray *xa, unsigned long index)
 	XA_BUG_ON(xa, xa_load(xa, index) != NULL);
 }
 
-/*
- * If anyone needs this, please move it to xarray.c.  We have no current
- * users outside the test suite because all current multislot users want
- * to use the advanced API.
- */
-static void *xa_store_order(struct xarray *xa, unsigned long index,
-		unsigned order, void *entry, gfp_t gfp)
-{
-	XA_STATE_ORDER(xas, xa, index, order);
-	void *curr;
-
-	do {
-		xas_lock(&xas);
-		curr = xas_store(&xas, entry);
-		xas_unlock(&xas);
-	} while (xas_nomem(&xas, gfp));
-
-	return curr;
-}
-
 static noinline void check_xa_err(struct xarray *xa)
 {
 	XA_BUG_ON(xa, xa_err(xa_store_index(xa, 0, GFP_NOWAIT)) != 0);
@@ -1550,6 +1530,139 @@ static noinline void check_store_range(struct xarray *xa)
 	}
 }
 
+static noinline void __check_bulk(struct xarray *xa, unsigned long start,
+		unsigned int nr)
+{
+	void *entries[80], *dst[80];
+	unsigned int i;
+
+	/* Leave some holes */
+	for (i = 0; i < nr; i++)
+		entries[i] = (i % 3) ? xa_mk_index(start + i) : NULL;
+
+	XA_BUG_ON(xa, xa_store_bulk(xa, start, entries, nr, GFP_KERNEL));
+	for (i = 0; i < nr; i++)
+		XA_BUG_ON(xa, xa_load(xa, start + i) != entries[i]);
+	XA_BUG_ON(xa, xa_load(xa, start + nr) != NULL);
+
+	XA_BUG_ON(xa, xa_load_bulk(xa, start, dst, nr) != nr);
+	for (i = 0; i < nr; i++)
+		XA_BUG_ON(xa, dst[i] != entries[i]);
+
+	xa_destroy(xa);
+}
+
+static noinline void check_bulk(struct xarray *xa)
+{
+	void *dst[4] = { };
+	unsigned int nr;
+
+	for (nr = 1; nr <= 80; nr++) {
+		__check_bulk(xa, 0, nr);
+		__check_bulk(xa, 60, nr);
+		__check_bulk(xa, 4090, nr);
+		__check_bulk(xa, 123456, nr);
+	}
+
+	/* Neither may wrap around */
+	XA_BUG_ON(xa, xa_store_bulk(xa, ULONG_MAX, dst, 2, GFP_KERNEL) !=
+			-EINVAL);
+	XA_BUG_ON(xa, xa_load_bulk(xa, ULONG_MAX - 1, dst, 4) != 2);
+	XA_BUG_ON(xa, xa_load_bulk(xa, 5, dst, 0) != 0);
+
+#ifdef CONFIG_XARRAY_MULTI
+	/* A multi-index entry is returned at each index it covers */
+	xa_store_order(xa, 64, 4, xa_mk_index(64), GFP_KERNEL);
+	XA_BUG_ON(xa, xa_load_bulk(xa, 62, dst, 4) != 4);
+	XA_BUG_ON(xa, dst[0] != NULL || dst[1] != NULL);
+	XA_BUG_ON(xa, dst[2] != xa_mk_index(64) || dst[3] != xa_mk_index(64));
+	XA_BUG_ON(xa, xa_load_bulk(xa, 78, dst, 4) != 4);
+	XA_BUG_ON(xa, dst[0] != xa_mk_index(64) || dst[1] != xa_mk_index(64));
+	XA_BUG_ON(xa, dst[2] != NULL || dst[3] != NULL);
+	xa_store_order(xa, 64, 4, NULL, GFP_KERNEL);
+#endif
+
+	XA_BUG_ON(xa, !xa_empty(xa));
+}
+
+#ifdef __KERNEL__
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+
+static bool bench;
+module_param(bench, bool, 0444);
+MODULE_PARM_DESC(bench, "Time single index against bulk stores and loads");
+
+#define BENCH_INDICES	(1UL << 18)
+#define BENCH_BATCH	512
+
+static void bench_report(const char *what, u64 start)
+{
+	u64 ns = ktime_get_ns() - start;
+
+	pr_info("XArray: %-14s %llu ns per index\n", what,
+		div64_u64(ns, BENCH_INDICES));
+}
+
+/*
+ * Per index cost of filling and reading an XArray the way the page cache
+ * handles a large read: one index at a time, in batches of BENCH_BATCH
+ * contiguous indices, and as multi-index entries of BENCH_BATCH indices.
+ */
+static noinline void xarray_bench(struct xarray *xa)
+{
+	unsigned long index, i;
+	void **entries;
+	u64 start;
+
+	entries = kmalloc_array(BENCH_BATCH, sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		return;
+
+	start = ktime_get_ns();
+	for (index = 0; index < BENCH_INDICES; index++)
+		xa_store_index(xa, index, GFP_KERNEL);
+	bench_report("store", start);
+
+	start = ktime_get_ns();
+	for (index = 0; index < BENCH_INDICES; index++)
+		xa_load(xa, index);
+	bench_report("load", start);
+	xa_destroy(xa);
+
+	start = ktime_get_ns();
+	for (index = 0; index < BENCH_INDICES; index += BENCH_BATCH) {
+		for (i = 0; i < BENCH_BATCH; i++)
+			entries[i] = xa_mk_index(index + i);
+		xa_store_bulk(xa, index, entries, BENCH_BATCH, GFP_KERNEL);
+	}
+	bench_report("store_bulk", start);
+
+	start = ktime_get_ns();
+	for (index = 0; index < BENCH_INDICES; index += BENCH_BATCH)
+		xa_load_bulk(xa, index, entries, BENCH_BATCH);
+	bench_report("load_bulk", start);
+	xa_destroy(xa);
+
+	if (IS_ENABLED(CONFIG_XARRAY_MULTI)) {
+		start = ktime_get_ns();
+		for (index = 0; index < BENCH_INDICES; index += BENCH_BATCH)
+			xa_store_order(xa, index, ilog2(BENCH_BATCH),
+				       xa_mk_index(index), GFP_KERNEL);
+		bench_report("store_order", start);
+
+		start = ktime_get_ns();
+		for (index = 0; index < BENCH_INDICES; index += BENCH_BATCH)
+			xa_load_bulk(xa, index, entries, BENCH_BATCH);
+		bench_report("load_bulk_mi", start);
+		xa_destroy(xa);
+	}
+
+	kfree(entries);
+}
+#endif
+
 #ifdef CONFIG_XARRAY_MULTI
 static void check_split_1(struct xarray *xa, unsigned long index,
 				unsigned int order, unsigned int new_order)
@@ -1814,6 +1927,7 @@ static int xarray_checks(void)
 	check_move(&array);
 	check_create_range(&array);
 	check_store_range(&array);
+	check_bulk(&array);
 	check_store_iter(&array);
 	check_align(&xa0);
 	check_split(&array);
@@ -1823,6 +1937,10 @@ static int xarray_checks(void)
 	check_workingset(&array, 4096);
 
 	printk("XArray: %u of %u tests passed\n", tests_passed, tests_run);
+#ifdef __KERNEL__
+	if (bench)
+		xarray_bench(&array);
+#endif
 	return (tests_run == tests_passed) ? 0 : -EINVAL;
 }
 
@@ -1467,6 +1467,80 @@ void *xa_load(struct xarray *xa, unsigned long index)
 }
 EXPORT_SYMBOL(xa_load);
 
+/*
+ * xas_load() of an index covered by a multi-index entry leaves xa_offset at
+ * the canonical slot of the entry.  Point it back at the slot of xa_index,
+ * so that xas_next() steps through the sibling slots in step with it.
+ */
+static void *xas_load_bulk(struct xa_state *xas)
+{
+	void *entry = xas_load(xas);
+
+	if (!xas_top(xas->xa_node))
+		xas_set_offset(xas);
+	return entry;
+}
+
+/**
+ * xa_load_bulk() - Load the entries of a range of indices.
+ * @xa: XArray.
+ * @index: First index to load.
+ * @dst: Array of at least @nr pointers.
+ * @nr: Number of indices to load.
+ *
+ * Stores the entry at @index + i in @dst[i], %NULL if there is none.  A
+ * multi-index entry is stored once for every index it covers.  Unlike
+ * xa_extract() the position of an entry in @dst tells its index.  The
+ * walk only goes back to the root of the tree when it leaves a node, so
+ * this is a lot cheaper than calling xa_load() for each index.
+ *
+ * As with xa_extract(), the entries do not represent a snapshot of the
+ * XArray at a moment in time.
+ *
+ * Context: Any context.  Takes and releases the RCU lock.
+ * Return: The number of entries loaded, which is smaller than @nr only if
+ * the range would go past %ULONG_MAX.
+ */
+unsigned int xa_load_bulk(struct xarray *xa, unsigned long index,
+			  void **dst, unsigned int nr)
+{
+	XA_STATE(xas, xa, index);
+	unsigned int i;
+	void *entry;
+
+	if (nr && index + nr - 1 < index)
+		nr = ULONG_MAX - index + 1;
+
+	rcu_read_lock();
+	for (i = 0; i < nr; i++) {
+		/*
+		 * Covers the first index too.  Past the end of the tree
+		 * xas_next() would stay at the same index.
+		 */
+		if (xas_invalid(&xas)) {
+			xas_set(&xas, index + i);
+			entry = xas_load_bulk(&xas);
+		} else {
+			entry = xas_next(&xas);
+		}
+		for (;;) {
+			if (xa_is_sibling(entry))
+				entry = xa_entry(xa, xas.xa_node,
+						 xa_to_sibling(entry));
+			if (xa_is_zero(entry))
+				entry = NULL;
+			if (!xas_retry(&xas, entry))
+				break;
+			entry = xas_load_bulk(&xas);
+		}
+		dst[i] = entry;
+	}
+	rcu_read_unlock();
+
+	return i;
+}
+EXPORT_SYMBOL(xa_load_bulk);
+
 static void *xas_result(struct xa_state *xas, void *curr)
 {
 	if (xa_is_zero(curr))
@@ -1583,6 +1657,103 @@ void *xa_store(struct xarray *xa, unsigned long index, void *entry, gfp_t gfp)
 }
 EXPORT_SYMBOL(xa_store);
 
+/**
+ * xa_store_bulk() - Store entries at a range of indices.
+ * @xa: XArray.
+ * @index: First index to store to.
+ * @entries: Array of @nr entries.
+ * @nr: Number of entries.
+ * @gfp: Memory allocation flags.
+ *
+ * After this function returns, loads from @index + i will return
+ * @entries[i].  Contiguous indices are filled from the same xa_state,
+ * which only walks the tree again when it moves to the next node, so
+ * filling a range costs about one xa_store() per node rather than one
+ * per index.  If memory allocation fails part way, the entries before
+ * the failing index have been stored.
+ *
+ * Context: Process context.  Takes and releases the xa_lock.  May sleep
+ * if the @gfp flags permit.
+ * Return: 0 on success, -EINVAL if one of @entries cannot be stored in an
+ * XArray or the range goes past %ULONG_MAX, or -ENOMEM if memory
+ * allocation failed.
+ */
+int xa_store_bulk(struct xarray *xa, unsigned long index, void **entries,
+		  unsigned int nr, gfp_t gfp)
+{
+	XA_STATE(xas, xa, index);
+	unsigned int i = 0;
+	void *entry;
+
+	if (nr && index + nr - 1 < index)
+		return -EINVAL;
+
+	do {
+		xas_lock(&xas);
+		for (; i < nr; i++) {
+			entry = entries[i];
+			if (WARN_ON_ONCE(xa_is_advanced(entry))) {
+				xas_set_err(&xas, -EINVAL);
+				break;
+			}
+			if (xa_track_free(xa) && !entry)
+				entry = XA_ZERO_ENTRY;
+
+			xas_store(&xas, entry);
+			if (xas_error(&xas))
+				break;
+			if (xa_track_free(xa))
+				xas_clear_mark(&xas, XA_FREE_MARK);
+			if (xas_invalid(&xas))
+				xas_set(&xas, index + i + 1);
+			else
+				xas_next(&xas);
+		}
+		xas_unlock(&xas);
+	} while (xas_nomem(&xas, gfp));
+
+	return xas_error(&xas);
+}
+EXPORT_SYMBOL(xa_store_bulk);
+
+/**
+ * xa_store_order() - Store a multi-index entry in the XArray.
+ * @xa: XArray.
+ * @index: Any index covered by the entry.
+ * @order: The entry covers 2^@order indices.
+ * @entry: New entry.
+ * @gfp: Memory allocation flags.
+ *
+ * Stores @entry at the naturally aligned range of 2^@order indices that
+ * contains @index, e.g. a folio of that order in the page cache.  The
+ * entry occupies a single slot and its siblings instead of one slot per
+ * index, whatever the order.  For a range that is not naturally aligned
+ * to a power of two, use xa_store_range().
+ *
+ * Context: Process context.  Takes and releases the xa_lock.  May sleep
+ * if the @gfp flags permit.
+ * Return: The first old entry in the range, or xa_err() if an error
+ * happened.
+ */
+void *xa_store_order(struct xarray *xa, unsigned long index,
+		unsigned int order, void *entry, gfp_t gfp)
+{
+	XA_STATE_ORDER(xas, xa, index, order);
+	void *curr;
+
+	if (WARN_ON_ONCE(xa_is_advanced(entry)))
+		return XA_ERROR(-EINVAL);
+
+	do {
+		xas_lock(&xas);
+		curr = xas_store(&xas, entry);
+		xas_unlock(&xas);
+	} while (xas_nomem(&xas, gfp));
+
+	return xas_result(&xas, curr);
+}
+EXPORT_SYMBOL(xa_store_order);
+
 /**
  * __xa_cmpxchg() - Store this entry in the XArray.
  * @xa: XArray.
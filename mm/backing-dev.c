@@ -105,12 +105,47 @@ static int bdi_debug_stats_show(struct seq_file *m, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(bdi_debug_stats);
 
+/* One line per wb, the root one and one per cgroup with cgroup writeback */
+static int bdi_debug_wb_stats_show(struct seq_file *m, void *v)
+{
+	struct backing_dev_info *bdi = m->private;
+	struct bdi_writeback *wb;
+
+	seq_puts(m, "cgroup_ino writeback_kB reclaimable_kB dirtied_kB written_kB bandwidth_kBps latency_avg_us latency_max_us state\n");
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(wb, &bdi->wb_list, bdi_node) {
+		unsigned long ino = 1;
+
+#ifdef CONFIG_CGROUP_WRITEBACK
+		if (wb->memcg_css)
+			ino = cgroup_ino(wb->memcg_css->cgroup);
+#endif
+		seq_printf(m, "%lu %lu %lu %lu %lu %lu %lu %lu %lx\n",
+			   ino,
+			   (unsigned long) K(wb_stat(wb, WB_WRITEBACK)),
+			   (unsigned long) K(wb_stat(wb, WB_RECLAIMABLE)),
+			   (unsigned long) K(wb_stat(wb, WB_DIRTIED)),
+			   (unsigned long) K(wb_stat(wb, WB_WRITTEN)),
+			   (unsigned long) K(wb->avg_write_bandwidth),
+			   READ_ONCE(wb->work_latency_avg),
+			   READ_ONCE(wb->work_latency_max),
+			   wb->state);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(bdi_debug_wb_stats);
+
 static void bdi_debug_register(struct backing_dev_info *bdi, const char *name)
 {
 	bdi->debug_dir = debugfs_create_dir(name, bdi_debug_root);
 
 	debugfs_create_file("stats", 0444, bdi->debug_dir, bdi,
 			    &bdi_debug_stats_fops);
+	debugfs_create_file("wb_stats", 0444, bdi->debug_dir, bdi,
+			    &bdi_debug_wb_stats_fops);
 }
 
 static void bdi_debug_unregister(struct backing_dev_info *bdi)
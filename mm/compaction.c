@@ -2025,6 +2025,124 @@ static bool should_proactive_compact_node(pg_data_t *pgdat)
 	return fragmentation_score_node(pgdat) > wmark_high;
 }
 
+/*
+ * Goal-driven proactive compaction.
+ *
+ * High-order allocations that find the free lists empty are counted per node
+ * by compaction_alloc_failed(). Every HPAGE_FRAG_CHECK_INTERVAL_MSEC kcompactd
+ * turns the counts into a number of free blocks to keep for each order,
+ * following rising demand right away and forgetting it slowly, and compacts
+ * towards the highest order that falls short. A pass stops when the goal is
+ * met, after sysctl_compaction_goal_budget_ms or after migrating
+ * sysctl_compaction_goal_migrate_limit pages.
+ *
+ * The orders tracked are those of the high-order pcp lists: 1 up to
+ * PAGE_ALLOC_COSTLY_ORDER, and the THP order.
+ */
+unsigned int __read_mostly sysctl_compaction_goal_budget_ms = 20;
+unsigned int __read_mostly sysctl_compaction_goal_migrate_limit = 8192;
+
+static int compact_goal_index(int order)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order == HPAGE_PMD_ORDER)
+		return NR_PCP_HIGH_ORDERS - 1;
+#endif
+	if (order < 1 || order > PAGE_ALLOC_COSTLY_ORDER)
+		return -1;
+	return order - 1;
+}
+
+static int compact_goal_order(int idx)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (idx == NR_PCP_HIGH_ORDERS - 1)
+		return HPAGE_PMD_ORDER;
+#endif
+	return idx + 1;
+}
+
+/* Called by the page allocator when a high-order fast path allocation fails */
+void compaction_alloc_failed(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+	int idx = compact_goal_index(order);
+
+	if (idx < 0 || !READ_ONCE(sysctl_compaction_goal_budget_ms))
+		return;
+
+	/* Racy, losing the odd update does not matter */
+	WRITE_ONCE(pgdat->compact_alloc_fail[idx],
+		   READ_ONCE(pgdat->compact_alloc_fail[idx]) + 1);
+}
+
+/* Free blocks of at least @order in the node, in units of @order */
+static unsigned long node_free_blocks(pg_data_t *pgdat, int order)
+{
+	unsigned long nr = 0;
+	int zoneid, o;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		for (o = order; o < MAX_ORDER; o++)
+			nr += READ_ONCE(zone->free_area[o].nr_free) << (o - order);
+	}
+
+	return nr;
+}
+
+static void kcompactd_update_goals(pg_data_t *pgdat)
+{
+	unsigned long free = 0;
+	int zoneid, idx;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++)
+		free += zone_page_state(&pgdat->node_zones[zoneid],
+					NR_FREE_PAGES);
+
+	for (idx = 0; idx < NR_PCP_HIGH_ORDERS; idx++) {
+		unsigned int fail = xchg(&pgdat->compact_alloc_fail[idx], 0);
+		unsigned int goal = pgdat->compact_goal[idx];
+
+		goal = max(fail, goal - DIV_ROUND_UP(goal, 16));
+		/* Compaction moves free memory around, it cannot create it */
+		goal = min_t(unsigned long, goal,
+			     (free >> compact_goal_order(idx)) / 2);
+		pgdat->compact_goal[idx] = goal;
+	}
+}
+
+/* Returns the index of the highest order short of its goal, or -1 */
+static int kcompactd_goal_short(pg_data_t *pgdat)
+{
+	int idx;
+
+	if (!READ_ONCE(sysctl_compaction_goal_budget_ms) ||
+	    kswapd_is_running(pgdat))
+		return -1;
+
+	for (idx = NR_PCP_HIGH_ORDERS - 1; idx >= 0; idx--) {
+		unsigned int goal = pgdat->compact_goal[idx];
+
+		if (goal &&
+		    node_free_blocks(pgdat, compact_goal_order(idx)) < goal)
+			return idx;
+	}
+
+	return -1;
+}
+
+static bool compact_goal_budget_exhausted(struct compact_control *cc)
+{
+	if (cc->migrate_limit && cc->nr_migrated >= cc->migrate_limit)
+		return true;
+	return time_after(jiffies, cc->deadline);
+}
+
 static enum compact_result __compact_finished(struct compact_control *cc)
 {
 	unsigned int order;
@@ -2070,6 +2188,21 @@ static enum compact_result __compact_finished(struct compact_control *cc)
 		goto out;
 	}
 
+	if (cc->free_goal) {
+		pg_data_t *pgdat = cc->zone->zone_pgdat;
+
+		if (kswapd_is_running(pgdat) ||
+		    compact_goal_budget_exhausted(cc))
+			return COMPACT_PARTIAL_SKIPPED;
+
+		if (node_free_blocks(pgdat, cc->order) >= cc->free_goal)
+			ret = COMPACT_SUCCESS;
+		else
+			ret = COMPACT_CONTINUE;
+
+		goto out;
+	}
+
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
@@ -2291,6 +2424,9 @@ compact_zone(struct compact_control *cc, struct capture_control *capc)
 	cc->migratetype = gfp_migratetype(cc->gfp_mask);
 	ret = compaction_suitable(cc->zone, cc->order, cc->alloc_flags,
 							cc->highest_zoneidx);
+	/* A free block is not enough when working towards a goal */
+	if (ret == COMPACT_SUCCESS && cc->free_goal)
+		ret = COMPACT_CONTINUE;
 	/* Compaction is likely to fail */
 	if (ret == COMPACT_SUCCESS || ret == COMPACT_SKIPPED)
 		return ret;
@@ -2353,6 +2489,7 @@ compact_zone(struct compact_control *cc, struct capture_control *capc)
 
 	while ((ret = compact_finished(cc)) == COMPACT_CONTINUE) {
 		int err;
+		unsigned int nr_succeeded = 0;
 		unsigned long iteration_start_pfn = cc->migrate_pfn;
 
 		/*
@@ -2394,7 +2531,8 @@ compact_zone(struct compact_control *cc, struct capture_control *capc)
 
 		err = migrate_pages(&cc->migratepages, compaction_alloc,
 				compaction_free, (unsigned long)cc, cc->mode,
-				MR_COMPACTION, NULL);
+				MR_COMPACTION, &nr_succeeded);
+		cc->nr_migrated += nr_succeeded;
 
 		trace_mm_compaction_migratepages(cc->nr_migratepages, err,
 							&cc->migratepages);
@@ -2653,6 +2791,62 @@ static void proactive_compact_node(pg_data_t *pgdat)
 	}
 }
 
+/*
+ * Compact the zones of a node until the node has the free blocks of the
+ * order at @idx that recent allocation failures asked for, or the budget
+ * of the pass runs out.
+ */
+static void goal_compact_node(pg_data_t *pgdat, int idx)
+{
+	int order = compact_goal_order(idx);
+	enum compact_result status = COMPACT_SKIPPED;
+	int zoneid;
+	struct zone *zone;
+	struct compact_control cc = {
+		.order = order,
+		.search_order = order,
+		.highest_zoneidx = pgdat->nr_zones - 1,
+		.mode = MIGRATE_SYNC_LIGHT,
+		.gfp_mask = GFP_KERNEL,
+		.free_goal = pgdat->compact_goal[idx],
+		.migrate_limit = READ_ONCE(sysctl_compaction_goal_migrate_limit),
+		.deadline = jiffies +
+			msecs_to_jiffies(READ_ONCE(sysctl_compaction_goal_budget_ms)),
+	};
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		zone = &pgdat->node_zones[zoneid];
+		if (!populated_zone(zone))
+			continue;
+
+		if (kthread_should_stop())
+			break;
+
+		cc.zone = zone;
+		status = compact_zone(&cc, NULL);
+
+		count_compact_events(KCOMPACTD_MIGRATE_SCANNED,
+				     cc.total_migrate_scanned);
+		count_compact_events(KCOMPACTD_FREE_SCANNED,
+				     cc.total_free_scanned);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (status == COMPACT_SUCCESS ||
+		    compact_goal_budget_exhausted(&cc))
+			break;
+	}
+
+	/* Charge the work to the order it was done for */
+	count_compact_events(KCOMPACTD_GOAL_MIGRATED_ORDER1 + idx,
+			     cc.nr_migrated);
+	if (status == COMPACT_SUCCESS)
+		count_compact_event(KCOMPACTD_GOAL_SUCCESS_ORDER1 + idx);
+	else if (compact_goal_budget_exhausted(&cc))
+		count_compact_event(KCOMPACTD_GOAL_THROTTLED);
+}
+
 /* Compact all zones within a node */
 static void compact_node(int nid)
 {
@@ -2921,12 +3115,14 @@ static int kcompactd(void *p)
 
 	while (!kthread_should_stop()) {
 		unsigned long pflags;
+		int goal_idx;
 
 		/*
 		 * Avoid the unnecessary wakeup for proactive compaction
 		 * when it is disabled.
 		 */
-		if (!sysctl_compaction_proactiveness)
+		if (!sysctl_compaction_proactiveness &&
+		    !sysctl_compaction_goal_budget_ms)
 			timeout = MAX_SCHEDULE_TIMEOUT;
 		trace_mm_compaction_kcompactd_sleep(pgdat->node_id);
 		if (wait_event_freezable_timeout(pgdat->kcompactd_wait,
@@ -2952,6 +3148,11 @@ static int kcompactd(void *p)
 		 * on the fragmentation score, this timeout is updated.
 		 */
 		timeout = default_timeout;
+		kcompactd_update_goals(pgdat);
+		goal_idx = kcompactd_goal_short(pgdat);
+		if (goal_idx >= 0)
+			goal_compact_node(pgdat, goal_idx);
+
 		if (should_proactive_compact_node(pgdat)) {
 			unsigned int prev_score, score;
 
@@ -109,9 +109,93 @@ static void damon_dbgfs_test_set_targets(struct kunit *test)
 	dbgfs_destroy_ctx(ctx);
 }
 
+static void damon_dbgfs_test_str_to_schemes(struct kunit *test)
+{
+	struct damos **schemes;
+	ssize_t nr_schemes = 0;
+	char *question;
+
+	question = "4096 8192 0 5 10 20 2 0 1024 1000 0 0 1 1 10 800 500 200\n"
+		"0 1048576 0 0 0 100 5 0 0 0 0 0 0 0 0 0 0 0";
+	schemes = str_to_schemes(question, strlen(question), &nr_schemes);
+	KUNIT_EXPECT_EQ(test, (ssize_t)2, nr_schemes);
+	KUNIT_EXPECT_EQ(test, 4096ul, schemes[0]->min_sz_region);
+	KUNIT_EXPECT_EQ(test, 20u, schemes[0]->max_age_region);
+	KUNIT_EXPECT_EQ(test, DAMOS_PAGEOUT, schemes[0]->action);
+	KUNIT_EXPECT_EQ(test, 1024ul, schemes[0]->quota.sz);
+	KUNIT_EXPECT_EQ(test, DAMOS_WMARK_FREE_MEM_RATE,
+			schemes[0]->wmarks.metric);
+	KUNIT_EXPECT_EQ(test, DAMOS_STAT, schemes[1]->action);
+	free_schemes_arr(schemes, nr_schemes);
+
+	/* Invalid action */
+	question = "4096 8192 0 5 10 20 42 0 1024 1000 0 0 1 1 10 800 500 200";
+	schemes = str_to_schemes(question, strlen(question), &nr_schemes);
+	KUNIT_EXPECT_PTR_EQ(test, (struct damos **)NULL, schemes);
+
+	/* Watermarks out of order */
+	question = "4096 8192 0 5 10 20 2 0 1024 1000 0 0 1 1 10 200 500 800";
+	schemes = str_to_schemes(question, strlen(question), &nr_schemes);
+	KUNIT_EXPECT_PTR_EQ(test, (struct damos **)NULL, schemes);
+}
+
+static void damon_dbgfs_test_set_init_regions(struct kunit *test)
+{
+	struct damon_ctx *ctx = damon_new_ctx();
+	unsigned long ids[] = {1, 2, 3};
+	/* Each line represents one region in ``<target idx> <start> <end>`` */
+	char * const valid_inputs[] = {"2 10 20\n 2   20 30\n2 35 45",
+		"2 10 20\n",
+		"2 10 20\n1 39 59\n0 70 134\n  2  25 35\n",
+		""};
+	/* Reading the file again shows the regions grouped by target */
+	char * const valid_expects[] = {"2 10 20\n2 20 30\n2 35 45\n",
+		"2 10 20\n",
+		"0 70 134\n1 39 59\n2 10 20\n2 25 35\n",
+		""};
+	char * const invalid_inputs[] = {"4 10 20\n",	/* target not exists */
+		"2 10 20\n 2 14 26\n",		/* regions overlap */
+		"1 10 20\n0 30 40\n 0 5 8"};	/* not sorted by address */
+	char *input, *expect;
+	int i, rc;
+	char buf[256];
+
+	damon_set_targets(ctx, ids, 3);
+
+	/* Put valid inputs and check the results */
+	for (i = 0; i < ARRAY_SIZE(valid_inputs); i++) {
+		input = valid_inputs[i];
+		expect = valid_expects[i];
+
+		rc = set_init_regions(ctx, input, strnlen(input, 256));
+		KUNIT_EXPECT_EQ(test, rc, 0);
+
+		memset(buf, 0, 256);
+		sprint_init_regions(ctx, buf, 256);
+
+		KUNIT_EXPECT_STREQ(test, (char *)buf, expect);
+	}
+	/* Put invalid inputs and check the return error code */
+	for (i = 0; i < ARRAY_SIZE(invalid_inputs); i++) {
+		input = invalid_inputs[i];
+		rc = set_init_regions(ctx, input, strnlen(input, 256));
+		KUNIT_EXPECT_EQ(test, rc, -EINVAL);
+
+		memset(buf, 0, 256);
+		sprint_init_regions(ctx, buf, 256);
+
+		KUNIT_EXPECT_STREQ(test, (char *)buf, "");
+	}
+
+	damon_set_targets(ctx, NULL, 0);
+	damon_destroy_ctx(ctx);
+}
+
 static struct kunit_case damon_test_cases[] = {
 	KUNIT_CASE(damon_dbgfs_test_str_to_target_ids),
 	KUNIT_CASE(damon_dbgfs_test_set_targets),
+	KUNIT_CASE(damon_dbgfs_test_str_to_schemes),
+	KUNIT_CASE(damon_dbgfs_test_set_init_regions),
 	{},
 };
 
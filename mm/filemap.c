@@ -3298,6 +3298,7 @@ vm_fault_t filemap_map_pages(struct vm_fault *vmf,
 	XA_STATE(xas, &mapping->i_pages, start_pgoff);
 	struct page *head, *page;
 	unsigned int mmap_miss = READ_ONCE(file->f_ra.mmap_miss);
+	unsigned long nr_around = 0;
 	vm_fault_t ret = 0;
 
 	rcu_read_lock();
@@ -3330,6 +3331,8 @@ vm_fault_t filemap_map_pages(struct vm_fault *vmf,
 		/* We're about to handle the fault */
 		if (vmf->address == addr)
 			ret = VM_FAULT_NOPAGE;
+		else
+			nr_around++;
 
 		do_set_pte(vmf, page, addr);
 		/* no need to invalidate: a not-present page won't be cached */
@@ -3341,6 +3344,7 @@ vm_fault_t filemap_map_pages(struct vm_fault *vmf,
 		put_page(head);
 	} while ((head = next_map_page(mapping, &xas, end_pgoff)) != NULL);
 	pte_unmap_unlock(vmf->pte, vmf->ptl);
+	count_vm_events(FAULT_AROUND_PAGES, nr_around);
 out:
 	rcu_read_unlock();
 	WRITE_ONCE(file->f_ra.mmap_miss, mmap_miss);
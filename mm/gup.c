@@ -1208,19 +1208,46 @@ static long __get_user_pages(struct mm_struct *mm,
 			goto out;
 		}
 		if (pages) {
-			pages[i] = page;
-			flush_anon_page(vma, page, start);
-			flush_dcache_page(page);
-			ctx.page_mask = 0;
+			unsigned int j;
+
+			page_increm = 1 + (~(start >> PAGE_SHIFT) & ctx.page_mask);
+			if (page_increm > nr_pages)
+				page_increm = nr_pages;
+
+			/*
+			 * follow_page_mask() took a reference on one subpage
+			 * of a huge page, take the ones for the rest of the
+			 * range it maps in one go rather than looking up every
+			 * subpage again.  If that is not possible, e.g. for a
+			 * longterm pin of a page that has to be migrated first,
+			 * go page by page.
+			 */
+			if (page_increm > 1 &&
+			    !try_grab_compound_head(page, page_increm - 1,
+						    foll_flags)) {
+				ctx.page_mask = 0;
+				page_increm = 1;
+			}
+
+			for (j = 0; j < page_increm; j++) {
+				struct page *subpage = nth_page(page, j);
+
+				pages[i + j] = subpage;
+				flush_anon_page(vma, subpage,
+						start + j * PAGE_SIZE);
+				flush_dcache_page(subpage);
+			}
 		}
 next_page:
-		if (vmas) {
-			vmas[i] = vma;
-			ctx.page_mask = 0;
-		}
 		page_increm = 1 + (~(start >> PAGE_SHIFT) & ctx.page_mask);
 		if (page_increm > nr_pages)
 			page_increm = nr_pages;
+		if (vmas) {
+			unsigned int j;
+
+			for (j = 0; j < page_increm; j++)
+				vmas[i + j] = vma;
+		}
 		i += page_increm;
 		start += page_increm * PAGE_SIZE;
 		nr_pages -= page_increm;
@@ -2266,6 +2293,41 @@ static void __maybe_unused undo_dev_pagemap(int *nr, int nr_start,
 }
 
 #ifdef CONFIG_ARCH_HAS_PTE_SPECIAL
+/*
+ * Count how many ptes starting at @ptep map consecutive subpages of the
+ * compound page @page with sufficient permissions, so that gup_pte_range()
+ * can take the references for all of them at once.  The compound page is
+ * not stable yet, the caller has to recheck once it holds the references.
+ */
+static int gup_pte_batch(pte_t *ptep, pte_t pte, struct page *page,
+			 unsigned long addr, unsigned long end,
+			 unsigned int flags)
+{
+	struct page *head = compound_head(page);
+	unsigned long pfn = pte_pfn(pte);
+	long max;
+	int nr;
+
+	if (!PageCompound(page) || pte_devmap(pte))
+		return 1;
+
+	max = (end - addr) >> PAGE_SHIFT;
+	if (page >= head && page - head < compound_nr(head))
+		max = min_t(long, max, compound_nr(head) - (page - head));
+
+	for (nr = 1; nr < max; nr++) {
+		pte_t next = ptep_get_lockless(ptep + nr);
+
+		if (!pte_present(next) || pte_protnone(next) ||
+		    !pte_access_permitted(next, flags & FOLL_WRITE) ||
+		    pte_special(next) || pte_devmap(next) ||
+		    pte_pfn(next) != pfn + nr)
+			break;
+	}
+
+	return nr;
+}
+
 static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
 			 unsigned int flags, struct page **pages, int *nr)
 {
@@ -2277,6 +2339,7 @@ static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
 	do {
 		pte_t pte = ptep_get_lockless(ptep);
 		struct page *head, *page;
+		int refs, i;
 
 		/*
 		 * Similar to the PMD case below, NUMA hinting must take slow
@@ -2302,40 +2365,60 @@ static int gup_pte_range(pmd_t pmd, unsigned long addr, unsigned long end,
 
 		VM_BUG_ON(!pfn_valid(pte_pfn(pte)));
 		page = pte_page(pte);
+		refs = gup_pte_batch(ptep, pte, page, addr, end, flags);
 
-		head = try_grab_compound_head(page, 1, flags);
+		head = try_grab_compound_head(page, refs, flags);
 		if (!head)
 			goto pte_unmap;
 
 		if (unlikely(page_is_secretmem(page))) {
-			put_compound_head(head, 1, flags);
+			put_compound_head(head, refs, flags);
 			goto pte_unmap;
 		}
 
 		if (unlikely(pte_val(pte) != pte_val(*ptep))) {
-			put_compound_head(head, 1, flags);
+			put_compound_head(head, refs, flags);
 			goto pte_unmap;
 		}
 
 		VM_BUG_ON_PAGE(compound_head(page) != head, page);
 
 		/*
-		 * We need to make the page accessible if and only if we are
-		 * going to access its content (the FOLL_PIN case).  Please
-		 * see Documentation/core-api/pin_user_pages.rst for
-		 * details.
+		 * The compound page is stable now, make sure that the batch
+		 * did not run past its end and that none of the other ptes
+		 * changed before the references were taken.
 		 */
-		if (flags & FOLL_PIN) {
-			ret = arch_make_page_accessible(page);
-			if (ret) {
-				unpin_user_page(page);
-				goto pte_unmap;
+		if (refs > 1 &&
+		    (compound_head(nth_page(page, refs - 1)) != head ||
+		     gup_pte_batch(ptep, pte, page, addr, end, flags) < refs)) {
+			put_compound_head(head, refs, flags);
+			goto pte_unmap;
+		}
+
+		for (i = 0; i < refs; i++) {
+			struct page *subpage = nth_page(page, i);
+
+			/*
+			 * We need to make the page accessible if and only if
+			 * we are going to access its content (the FOLL_PIN
+			 * case).  Please see
+			 * Documentation/core-api/pin_user_pages.rst for
+			 * details.
+			 */
+			if (flags & FOLL_PIN) {
+				ret = arch_make_page_accessible(subpage);
+				if (ret) {
+					put_compound_head(head, refs - i, flags);
+					goto pte_unmap;
+				}
 			}
+			SetPageReferenced(subpage);
+			pages[*nr] = subpage;
+			(*nr)++;
 		}
-		SetPageReferenced(page);
-		pages[*nr] = page;
-		(*nr)++;
 
+		ptep += refs - 1;
+		addr += (refs - 1) * PAGE_SIZE;
 	} while (ptep++, addr += PAGE_SIZE, addr != end);
 
 	ret = 1;
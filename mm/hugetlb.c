@@ -31,6 +31,9 @@
 #include <linux/llist.h>
 #include <linux/cma.h>
 #include <linux/migrate.h>
+#include <linux/padata.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 #include <asm/page.h>
 #include <asm/pgalloc.h>
@@ -80,6 +83,21 @@ DEFINE_SPINLOCK(hugetlb_lock);
 static int num_fault_mutexes;
 struct mutex *hugetlb_fault_mutex_table ____cacheline_aligned_in_smp;
 
+/*
+ * Background clearing of free huge pages, enabled per hstate through the
+ * "prezero" sysfs file.  See hugetlb_prezero_fn().
+ */
+static struct task_struct *hugetlb_prezero_thread;
+static DEFINE_MUTEX(hugetlb_prezero_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(hugetlb_prezero_wait);
+static bool hugetlb_prezero_kick;
+
+static void hugetlb_prezero_wake(void)
+{
+	WRITE_ONCE(hugetlb_prezero_kick, true);
+	wake_up(&hugetlb_prezero_wait);
+}
+
 /* Forward declaration */
 static int hugetlb_acct_memory(struct hstate *h, long delta);
 
@@ -1074,7 +1092,18 @@ static void enqueue_huge_page(struct hstate *h, struct page *page)
 	lockdep_assert_held(&hugetlb_lock);
 	VM_BUG_ON_PAGE(page_count(page), page);
 
-	list_move(&page->lru, &h->hugepage_freelists[nid]);
+	if (HPageZeroed(page)) {
+		list_move(&page->lru, &h->hugepage_freelists[nid]);
+		h->free_zeroed_huge_pages++;
+	} else if (READ_ONCE(h->prezero)) {
+		/*
+		 * Zeroed pages are dequeued first, the pre-zeroing thread
+		 * picks the ones it still has to clear from the tail.
+		 */
+		list_move_tail(&page->lru, &h->hugepage_freelists[nid]);
+	} else {
+		list_move(&page->lru, &h->hugepage_freelists[nid]);
+	}
 	h->free_huge_pages++;
 	h->free_huge_pages_node[nid]++;
 	SetHPageFreed(page);
@@ -1098,6 +1127,8 @@ static struct page *dequeue_huge_page_node_exact(struct hstate *h, int nid)
 		ClearHPageFreed(page);
 		h->free_huge_pages--;
 		h->free_huge_pages_node[nid]--;
+		if (HPageZeroed(page))
+			h->free_zeroed_huge_pages--;
 		return page;
 	}
 
@@ -1374,7 +1405,10 @@ static void remove_hugetlb_page(struct hstate *h, struct page *page,
 	if (HPageFreed(page)) {
 		h->free_huge_pages--;
 		h->free_huge_pages_node[nid]--;
+		if (HPageZeroed(page))
+			h->free_zeroed_huge_pages--;
 	}
+	ClearHPageZeroed(page);
 	if (adjust_surplus) {
 		h->surplus_huge_pages--;
 		h->surplus_huge_pages_node[nid]--;
@@ -1613,6 +1647,7 @@ void free_huge_page(struct page *page)
 
 	spin_lock_irqsave(&hugetlb_lock, flags);
 	ClearHPageMigratable(page);
+	ClearHPageZeroed(page);
 	hugetlb_cgroup_uncharge_page(hstate_index(h),
 				     pages_per_huge_page(h), page);
 	hugetlb_cgroup_uncharge_page_rsvd(hstate_index(h),
@@ -1633,6 +1668,8 @@ void free_huge_page(struct page *page)
 		arch_clear_hugepage_flags(page);
 		enqueue_huge_page(h, page);
 		spin_unlock_irqrestore(&hugetlb_lock, flags);
+		if (READ_ONCE(h->prezero))
+			hugetlb_prezero_wake();
 	}
 }
 
@@ -2902,76 +2939,174 @@ int __alloc_bootmem_huge_page(struct hstate *h)
 	return 1;
 }
 
+static void __init gather_bootmem_prealloc_node(unsigned long start,
+						unsigned long end, void *arg)
+{
+	struct list_head *lists = arg;
+	struct huge_bootmem_page *m, *next;
+	unsigned long nid;
+
+	for (nid = start; nid < end; nid++) {
+		list_for_each_entry_safe(m, next, &lists[nid], list) {
+			struct page *page = virt_to_page(m);
+			struct hstate *h = m->hstate;
+
+			VM_BUG_ON(!hstate_is_gigantic(h));
+			WARN_ON(page_count(page) != 1);
+			if (prep_compound_gigantic_page(page, huge_page_order(h))) {
+				WARN_ON(PageReserved(page));
+				prep_new_huge_page(h, page, page_to_nid(page));
+				put_page(page); /* add to the hugepage allocator */
+			} else {
+				/* VERY unlikely inflated ref count on a tail page */
+				free_gigantic_page(page, huge_page_order(h));
+			}
+
+			/*
+			 * We need to restore the 'stolen' pages to
+			 * totalram_pages in order to fix confusing memory
+			 * reports from free(1) and other side-effects, like
+			 * CommitLimit going negative.
+			 */
+			adjust_managed_page_count(page, pages_per_huge_page(h));
+			cond_resched();
+		}
+	}
+}
+
 /*
  * Put bootmem huge pages into the standard lists after mem_map is up.
  * Note: This only applies to gigantic (order > MAX_ORDER) pages.
+ *
+ * Initializing the struct pages of a gigantic page dominates here, so the
+ * pages are sorted by node and each node is handled by its own thread.
  */
 static void __init gather_bootmem_prealloc(void)
 {
-	struct huge_bootmem_page *m;
+	static struct list_head lists[MAX_NUMNODES] __initdata;
+	struct huge_bootmem_page *m, *next;
+	struct padata_mt_job job = {
+		.thread_fn	= gather_bootmem_prealloc_node,
+		.fn_arg		= lists,
+		.start		= 0,
+		.size		= nr_node_ids,
+		.align		= 1,
+		.min_chunk	= 1,
+		.max_threads	= num_node_state(N_MEMORY),
+	};
+	int nid;
+
+	if (list_empty(&huge_boot_pages))
+		return;
 
-	list_for_each_entry(m, &huge_boot_pages, list) {
-		struct page *page = virt_to_page(m);
-		struct hstate *h = m->hstate;
+	for (nid = 0; nid < nr_node_ids; nid++)
+		INIT_LIST_HEAD(&lists[nid]);
+	list_for_each_entry_safe(m, next, &huge_boot_pages, list)
+		list_move_tail(&m->list, &lists[page_to_nid(virt_to_page(m))]);
 
-		VM_BUG_ON(!hstate_is_gigantic(h));
-		WARN_ON(page_count(page) != 1);
-		if (prep_compound_gigantic_page(page, huge_page_order(h))) {
-			WARN_ON(PageReserved(page));
-			prep_new_huge_page(h, page, page_to_nid(page));
-			put_page(page); /* add to the hugepage allocator */
-		} else {
-			/* VERY unlikely inflated ref count on a tail page */
-			free_gigantic_page(page, huge_page_order(h));
+	padata_do_multithreaded(&job);
+}
+
+/*
+ * Boot time variant of alloc_pool_huge_page().  The node to allocate from
+ * is interleaved with a cursor owned by the calling thread rather than
+ * h->next_nid_to_alloc, as several threads allocate concurrently.
+ */
+static int __init alloc_pool_huge_page_boot(struct hstate *h,
+					    nodemask_t *node_alloc_noretry,
+					    int *next_node)
+{
+	nodemask_t *nodes_allowed = &node_states[N_MEMORY];
+	gfp_t gfp_mask = htlb_alloc_mask(h) | __GFP_THISNODE;
+	int nr_nodes, node;
+	struct page *page;
+
+	for (nr_nodes = nodes_weight(*nodes_allowed); nr_nodes > 0; nr_nodes--) {
+		node = get_valid_node_allowed(*next_node, nodes_allowed);
+		*next_node = next_node_allowed(node, nodes_allowed);
+
+		page = alloc_fresh_huge_page(h, gfp_mask, node, nodes_allowed,
+					     node_alloc_noretry);
+		if (page) {
+			put_page(page); /* free it into the hugepage allocator */
+			return 1;
 		}
+	}
 
-		/*
-		 * We need to restore the 'stolen' pages to totalram_pages
-		 * in order to fix confusing memory reports from free(1) and
-		 * other side-effects, like CommitLimit going negative.
-		 */
-		adjust_managed_page_count(page, pages_per_huge_page(h));
+	return 0;
+}
+
+static void __init hugetlb_pages_alloc_boot_node(unsigned long start,
+						 unsigned long end, void *arg)
+{
+	struct hstate *h = arg;
+	/* bit mask controlling how hard we retry per-node allocations */
+	nodemask_t node_alloc_noretry;
+	int next_node = first_memory_node;
+	unsigned long i, skip;
+
+	nodes_clear(node_alloc_noretry);
+
+	/*
+	 * Start each chunk on a different node, so that the threads do not
+	 * all contend on the same zone at the same time.
+	 */
+	skip = (start / (end - start)) % nodes_weight(node_states[N_MEMORY]);
+	for (i = 0; i < skip; i++)
+		next_node = next_node_allowed(next_node,
+					      &node_states[N_MEMORY]);
+
+	for (i = start; i < end; i++) {
+		if (!alloc_pool_huge_page_boot(h, &node_alloc_noretry,
+					       &next_node))
+			break;
 		cond_resched();
 	}
 }
 
+/*
+ * Allocate the boot time pool of a non-gigantic hstate with a couple of
+ * threads per node, each interleaving its share over all nodes.  Returns
+ * the number of pages allocated.
+ */
+static unsigned long __init hugetlb_pages_alloc_boot(struct hstate *h)
+{
+	int nr_nodes = num_node_state(N_MEMORY);
+	struct padata_mt_job job = {
+		.thread_fn	= hugetlb_pages_alloc_boot_node,
+		.fn_arg		= h,
+		.start		= 0,
+		.size		= h->max_huge_pages,
+		.align		= 1,
+		.min_chunk	= max(h->max_huge_pages / nr_nodes / 2, 1UL),
+		.max_threads	= nr_nodes * 2,
+	};
+
+	padata_do_multithreaded(&job);
+
+	return h->nr_huge_pages;
+}
+
 static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 {
 	unsigned long i;
-	nodemask_t *node_alloc_noretry;
 
 	if (!hstate_is_gigantic(h)) {
-		/*
-		 * Bit mask controlling how hard we retry per-node allocations.
-		 * Ignore errors as lower level routines can deal with
-		 * node_alloc_noretry == NULL.  If this kmalloc fails at boot
-		 * time, we are likely in bigger trouble.
-		 */
-		node_alloc_noretry = kmalloc(sizeof(*node_alloc_noretry),
-						GFP_KERNEL);
-	} else {
-		/* allocations done at boot time */
-		node_alloc_noretry = NULL;
+		i = hugetlb_pages_alloc_boot(h);
+		goto out;
 	}
 
-	/* bit mask controlling how hard we retry per-node allocations */
-	if (node_alloc_noretry)
-		nodes_clear(*node_alloc_noretry);
-
 	for (i = 0; i < h->max_huge_pages; ++i) {
-		if (hstate_is_gigantic(h)) {
-			if (hugetlb_cma_size) {
-				pr_warn_once("HugeTLB: hugetlb_cma is enabled, skip boot time allocation\n");
-				goto free;
-			}
-			if (!alloc_bootmem_huge_page(h))
-				break;
-		} else if (!alloc_pool_huge_page(h,
-					 &node_states[N_MEMORY],
-					 node_alloc_noretry))
+		/* allocations done at boot time */
+		if (hugetlb_cma_size) {
+			pr_warn_once("HugeTLB: hugetlb_cma is enabled, skip boot time allocation\n");
+			return;
+		}
+		if (!alloc_bootmem_huge_page(h))
 			break;
 		cond_resched();
 	}
+out:
 	if (i < h->max_huge_pages) {
 		char buf[32];
 
@@ -2980,8 +3115,6 @@ static void __init hugetlb_hstate_alloc_pages(struct hstate *h)
 			h->max_huge_pages, buf, i);
 		h->max_huge_pages = i;
 	}
-free:
-	kfree(node_alloc_noretry);
 }
 
 static void __init hugetlb_init_hstates(void)
@@ -3433,12 +3566,182 @@ static ssize_t surplus_hugepages_show(struct kobject *kobj,
 }
 HSTATE_ATTR_RO(surplus_hugepages);
 
+/*
+ * Take a free page that still has to be cleared off the free lists.  A page
+ * is only taken while there is more than one unreserved free page, so that
+ * faults consuming a reservation never find the pool empty because of us.
+ * Nodes with surplus pages are skipped, so the page taken is always one
+ * of the persistent pool.
+ *
+ * The page keeps a zero refcount while it is cleared, so nobody can take a
+ * speculative reference and send it through free_huge_page() behind our
+ * back.
+ */
+static struct page *hugetlb_prezero_isolate(struct hstate *h)
+{
+	struct page *page;
+	int nid;
+
+	lockdep_assert_held(&hugetlb_lock);
+	if (h->free_huge_pages - h->resv_huge_pages <= 1)
+		return NULL;
+
+	for_each_node_state(nid, N_MEMORY) {
+		if (list_empty(&h->hugepage_freelists[nid]) ||
+		    h->surplus_huge_pages_node[nid])
+			continue;
+
+		page = list_last_entry(&h->hugepage_freelists[nid],
+				       struct page, lru);
+		if (HPageZeroed(page) || PageHWPoison(page))
+			continue;
+
+		list_move(&page->lru, &h->hugepage_activelist);
+		ClearHPageFreed(page);
+		h->free_huge_pages--;
+		h->free_huge_pages_node[nid]--;
+		return page;
+	}
+
+	return NULL;
+}
+
+/* Clear one free page of @h, returns false if there is nothing to do */
+static bool hugetlb_prezero_one(struct hstate *h)
+{
+	struct page *page;
+
+	spin_lock_irq(&hugetlb_lock);
+	page = hugetlb_prezero_isolate(h);
+	spin_unlock_irq(&hugetlb_lock);
+	if (!page)
+		return false;
+
+	clear_huge_page(page, 0, pages_per_huge_page(h));
+
+	spin_lock_irq(&hugetlb_lock);
+	/*
+	 * If the pool was shrunk meanwhile, the page may now count as surplus:
+	 * release it the way free_huge_page() would, rather than growing the
+	 * pool past nr_hugepages + nr_overcommit_hugepages.
+	 */
+	if (h->surplus_huge_pages_node[page_to_nid(page)]) {
+		remove_hugetlb_page(h, page, true);
+		spin_unlock_irq(&hugetlb_lock);
+		update_and_free_page(h, page, false);
+		return true;
+	}
+	SetHPageZeroed(page);
+	enqueue_huge_page(h, page);
+	spin_unlock_irq(&hugetlb_lock);
+
+	return true;
+}
+
+/*
+ * Moves the clearing of huge pages out of the fault path: free pages are
+ * cleared one at a time at the lowest priority and put back at the head of
+ * their free list, from where hugetlb_no_page() gets them without having to
+ * clear them again.
+ */
+static int hugetlb_prezero_fn(void *unused)
+{
+	set_freezable();
+	set_user_nice(current, MAX_NICE);
+
+	while (!kthread_should_stop()) {
+		bool progress = false;
+		struct hstate *h;
+
+		WRITE_ONCE(hugetlb_prezero_kick, false);
+		for_each_hstate(h) {
+			if (READ_ONCE(h->prezero) && hugetlb_prezero_one(h))
+				progress = true;
+		}
+
+		/*
+		 * Freed pages kick us, reservations going away do not, so
+		 * look again once in a while.
+		 */
+		if (!progress)
+			wait_event_freezable_timeout(hugetlb_prezero_wait,
+					READ_ONCE(hugetlb_prezero_kick) ||
+					kthread_should_stop(), 10 * HZ);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int hugetlb_prezero_start(void)
+{
+	struct task_struct *thread;
+	int err = 0;
+
+	mutex_lock(&hugetlb_prezero_mutex);
+	if (!hugetlb_prezero_thread) {
+		thread = kthread_run(hugetlb_prezero_fn, NULL, "khugetlbzerod");
+		if (IS_ERR(thread))
+			err = PTR_ERR(thread);
+		else
+			hugetlb_prezero_thread = thread;
+	}
+	mutex_unlock(&hugetlb_prezero_mutex);
+
+	return err;
+}
+
+static ssize_t prezero_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(h->prezero));
+}
+
+static ssize_t prezero_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	if (enable) {
+		err = hugetlb_prezero_start();
+		if (err)
+			return err;
+	}
+
+	WRITE_ONCE(h->prezero, enable);
+	if (enable)
+		hugetlb_prezero_wake();
+
+	return count;
+}
+HSTATE_ATTR(prezero);
+
+static ssize_t free_zeroed_hugepages_show(struct kobject *kobj,
+					  struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h = kobj_to_hstate(kobj, NULL);
+
+	return sysfs_emit(buf, "%lu\n", h->free_zeroed_huge_pages);
+}
+HSTATE_ATTR_RO(free_zeroed_hugepages);
+
 static struct attribute *hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&nr_overcommit_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&resv_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&prezero_attr.attr,
+	&free_zeroed_hugepages_attr.attr,
 #ifdef CONFIG_NUMA
 	&nr_hugepages_mempolicy_attr.attr,
 #endif
@@ -4268,6 +4571,7 @@ hugetlb_install_page(struct vm_area_struct *vma, pte_t *ptep, unsigned long addr
 }
 
 int copy_hugetlb_page_range(struct mm_struct *dst, struct mm_struct *src,
+			    struct vm_area_struct *dst_vma,
 			    struct vm_area_struct *vma)
 {
 	pte_t *src_pte, *dst_pte, entry, dst_entry;
@@ -4345,9 +4649,13 @@ int copy_hugetlb_page_range(struct mm_struct *dst, struct mm_struct *src,
 				swp_entry = make_readable_migration_entry(
 							swp_offset(swp_entry));
 				entry = swp_entry_to_pte(swp_entry);
+				if (pte_swp_uffd_wp(huge_ptep_get(src_pte)))
+					entry = pte_swp_mkuffd_wp(entry);
 				set_huge_swap_pte_at(src, addr, src_pte,
 						     entry, sz);
 			}
+			if (!userfaultfd_wp(dst_vma))
+				entry = pte_swp_clear_uffd_wp(entry);
 			set_huge_swap_pte_at(dst, addr, dst_pte, entry, sz);
 		} else {
 			entry = huge_ptep_get(src_pte);
@@ -4410,6 +4718,10 @@ int copy_hugetlb_page_range(struct mm_struct *dst, struct mm_struct *src,
 				entry = huge_pte_wrprotect(entry);
 			}
 
+			/* The child only keeps the wp bits if it got the uffd */
+			if (!userfaultfd_wp(dst_vma))
+				entry = huge_pte_clear_uffd_wp(entry);
+
 			page_dup_rmap(ptepage, true);
 			set_huge_pte_at(dst, addr, dst_pte, entry);
 			hugetlb_count_add(npages, dst);
@@ -4647,6 +4959,15 @@ static vm_fault_t hugetlb_cow(struct mm_struct *mm, struct vm_area_struct *vma,
 	unsigned long haddr = address & huge_page_mask(h);
 	struct mmu_notifier_range range;
 
+	/*
+	 * A shared mapping can only get here through a pte that had its write
+	 * bit taken away by userfaultfd write protection, never COW it.
+	 */
+	if (vma->vm_flags & VM_MAYSHARE) {
+		set_huge_ptep_writable(vma, haddr, ptep);
+		return 0;
+	}
+
 	pte = huge_ptep_get(ptep);
 	old_page = pte_page(pte);
 
@@ -4943,7 +5264,9 @@ static vm_fault_t hugetlb_no_page(struct mm_struct *mm,
 			spin_unlock(ptl);
 			goto out;
 		}
-		clear_huge_page(page, address, pages_per_huge_page(h));
+		if (!HPageZeroed(page))
+			clear_huge_page(page, address, pages_per_huge_page(h));
+		ClearHPageZeroed(page);
 		__SetPageUptodate(page);
 		new_page = true;
 
@@ -5175,6 +5498,25 @@ vm_fault_t hugetlb_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (unlikely(!pte_same(entry, huge_ptep_get(ptep))))
 		goto out_ptl;
 
+	/* Handle userfault-wp first, before trying to lock more pages */
+	if (userfaultfd_wp(vma) && huge_pte_uffd_wp(entry) &&
+	    (flags & FAULT_FLAG_WRITE) && !huge_pte_write(entry)) {
+		struct vm_fault vmf = {
+			.vma = vma,
+			.address = haddr,
+			.flags = flags,
+		};
+
+		spin_unlock(ptl);
+		if (pagecache_page) {
+			unlock_page(pagecache_page);
+			put_page(pagecache_page);
+		}
+		mutex_unlock(&hugetlb_fault_mutex_table[hash]);
+		i_mmap_unlock_read(mapping);
+		return handle_userfault(&vmf, VM_UFFD_WP);
+	}
+
 	/*
 	 * hugetlb_cow() requires page locks of pte_page(entry) and
 	 * pagecache_page, so here we need take the former one
@@ -5238,7 +5580,8 @@ int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 			    unsigned long dst_addr,
 			    unsigned long src_addr,
 			    enum mcopy_atomic_mode mode,
-			    struct page **pagep)
+			    struct page **pagep,
+			    bool wp_copy)
 {
 	bool is_continue = (mode == MCOPY_ATOMIC_CONTINUE);
 	struct hstate *h = hstate_vma(dst_vma);
@@ -5388,6 +5731,8 @@ int hugetlb_mcopy_atomic_pte(struct mm_struct *dst_mm,
 	if (writable)
 		_dst_pte = huge_pte_mkdirty(_dst_pte);
 	_dst_pte = pte_mkyoung(_dst_pte);
+	if (wp_copy)
+		_dst_pte = huge_pte_mkuffd_wp(_dst_pte);
 
 	set_huge_pte_at(dst_mm, dst_addr, dst_pte, _dst_pte);
 
@@ -5610,7 +5955,8 @@ long follow_hugetlb_page(struct mm_struct *mm, struct vm_area_struct *vma,
 }
 
 unsigned long hugetlb_change_protection(struct vm_area_struct *vma,
-		unsigned long address, unsigned long end, pgprot_t newprot)
+		unsigned long address, unsigned long end, pgprot_t newprot,
+		unsigned long cp_flags)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	unsigned long start = address;
@@ -5620,6 +5966,8 @@ unsigned long hugetlb_change_protection(struct vm_area_struct *vma,
 	unsigned long pages = 0;
 	bool shared_pmd = false;
 	struct mmu_notifier_range range;
+	bool uffd_wp = cp_flags & MM_CP_UFFD_WP;
+	bool uffd_wp_resolve = cp_flags & MM_CP_UFFD_WP_RESOLVE;
 
 	/*
 	 * In the case of shared PMDs, the area to flush could be beyond
@@ -5654,13 +6002,22 @@ unsigned long hugetlb_change_protection(struct vm_area_struct *vma,
 		}
 		if (unlikely(is_hugetlb_entry_migration(pte))) {
 			swp_entry_t entry = pte_to_swp_entry(pte);
+			pte_t newpte = pte;
 
 			if (is_writable_migration_entry(entry)) {
-				pte_t newpte;
-
 				entry = make_readable_migration_entry(
 							swp_offset(entry));
 				newpte = swp_entry_to_pte(entry);
+				if (pte_swp_uffd_wp(pte))
+					newpte = pte_swp_mkuffd_wp(newpte);
+			}
+
+			if (uffd_wp)
+				newpte = pte_swp_mkuffd_wp(newpte);
+			else if (uffd_wp_resolve)
+				newpte = pte_swp_clear_uffd_wp(newpte);
+
+			if (!pte_same(pte, newpte)) {
 				set_huge_swap_pte_at(mm, address, ptep,
 						     newpte, huge_page_size(h));
 				pages++;
@@ -5675,6 +6032,10 @@ unsigned long hugetlb_change_protection(struct vm_area_struct *vma,
 			old_pte = huge_ptep_modify_prot_start(vma, address, ptep);
 			pte = pte_mkhuge(huge_pte_modify(old_pte, newprot));
 			pte = arch_make_huge_pte(pte, shift, vma->vm_flags);
+			if (uffd_wp)
+				pte = huge_pte_mkuffd_wp(pte);
+			else if (uffd_wp_resolve)
+				pte = huge_pte_clear_uffd_wp(pte);
 			huge_ptep_modify_prot_commit(vma, address, ptep, old_pte, pte);
 			pages++;
 		}
@@ -35,10 +35,15 @@
 void page_writeback_init(void);
 
 vm_fault_t do_swap_page(struct vm_fault *vmf);
+unsigned int fault_around_default_pages(void);
 
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
 
+#ifdef CONFIG_PER_VMA_LOCK
+struct vm_area_struct *find_vma_rcu(struct mm_struct *mm, unsigned long addr);
+#endif
+
 static inline bool can_madv_lru_vma(struct vm_area_struct *vma)
 {
 	return !(vma->vm_flags & (VM_LOCKED|VM_HUGETLB|VM_PFNMAP));
@@ -261,6 +266,10 @@ struct compact_control {
 	bool contended;			/* Signal lock or sched contention */
 	bool rescan;			/* Rescanning the same pageblock */
 	bool alloc_contig;		/* alloc_contig_range allocation */
+	unsigned int free_goal;		/* kcompactd free block goal for order */
+	unsigned int nr_migrated;	/* Pages migrated, for the goal budget */
+	unsigned int migrate_limit;	/* Goal budget in migrated pages */
+	unsigned long deadline;		/* Goal budget in jiffies */
 };
 
 /*
@@ -51,6 +51,8 @@ enum scan_result {
 	SCAN_CGROUP_CHARGE_FAIL,
 	SCAN_TRUNCATED,
 	SCAN_PAGE_HAS_PRIVATE,
+	SCAN_PTE_TABLE_SHARED,
+	SCAN_PMD_MAPPED,
 };
 
 #define CREATE_TRACE_POINTS
@@ -117,6 +119,24 @@ struct khugepaged_scan {
 	unsigned long address;
 };
 
+/*
+ * State of one collapse attempt: khugepaged uses a single static instance,
+ * MADV_COLLAPSE gets its own so that it can run concurrently.
+ */
+struct collapse_control {
+	/* Obey the sysfs limits and the referenced heuristics */
+	bool is_khugepaged;
+	/* Pages scanned per node, the huge page goes to the busiest one */
+	int node_load[MAX_NUMNODES];
+	/* Last target, to spread ties over the nodes */
+	int last_target_node;
+};
+
+static struct collapse_control khugepaged_collapse_control = {
+	.is_khugepaged = true,
+	.last_target_node = NUMA_NO_NODE,
+};
+
 static struct khugepaged_scan khugepaged_scan = {
 	.mm_head = LIST_HEAD_INIT(khugepaged_scan.mm_head),
 };
@@ -558,6 +578,22 @@ void __khugepaged_exit(struct mm_struct *mm)
 	}
 }
 
+/* MADV_COLLAPSE asked for a huge page, only khugepaged holds back */
+static int collapse_max_ptes_none(struct collapse_control *cc)
+{
+	return cc->is_khugepaged ? khugepaged_max_ptes_none : HPAGE_PMD_NR - 1;
+}
+
+static int collapse_max_ptes_swap(struct collapse_control *cc)
+{
+	return cc->is_khugepaged ? khugepaged_max_ptes_swap : HPAGE_PMD_NR;
+}
+
+static int collapse_max_ptes_shared(struct collapse_control *cc)
+{
+	return cc->is_khugepaged ? khugepaged_max_ptes_shared : HPAGE_PMD_NR;
+}
+
 static void release_pte_page(struct page *page)
 {
 	mod_node_page_state(page_pgdat(page),
@@ -601,11 +637,14 @@ static bool is_refcount_suitable(struct page *page)
 static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 					unsigned long address,
 					pte_t *pte,
-					struct list_head *compound_pagelist)
+					struct list_head *compound_pagelist,
+					struct collapse_control *cc)
 {
 	struct page *page = NULL;
 	pte_t *_pte;
 	int none_or_zero = 0, shared = 0, result = 0, referenced = 0;
+	int max_ptes_none = collapse_max_ptes_none(cc);
+	int max_ptes_shared = collapse_max_ptes_shared(cc);
 	bool writable = false;
 
 	for (_pte = pte; _pte < pte+HPAGE_PMD_NR;
@@ -614,7 +653,7 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 		if (pte_none(pteval) || (pte_present(pteval) &&
 				is_zero_pfn(pte_pfn(pteval)))) {
 			if (!userfaultfd_armed(vma) &&
-			    ++none_or_zero <= khugepaged_max_ptes_none) {
+			    ++none_or_zero <= max_ptes_none) {
 				continue;
 			} else {
 				result = SCAN_EXCEED_NONE_PTE;
@@ -634,7 +673,7 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 		VM_BUG_ON_PAGE(!PageAnon(page), page);
 
 		if (page_mapcount(page) > 1 &&
-				++shared > khugepaged_max_ptes_shared) {
+				++shared > max_ptes_shared) {
 			result = SCAN_EXCEED_SHARED_PTE;
 			goto out;
 		}
@@ -721,7 +760,7 @@ static int __collapse_huge_page_isolate(struct vm_area_struct *vma,
 
 	if (unlikely(!writable)) {
 		result = SCAN_PAGE_RO;
-	} else if (unlikely(!referenced)) {
+	} else if (unlikely(cc->is_khugepaged && !referenced)) {
 		result = SCAN_LACK_REFERENCED_PAGE;
 	} else {
 		result = SCAN_SUCCEED;
@@ -801,9 +840,7 @@ static void khugepaged_alloc_sleep(void)
 	remove_wait_queue(&khugepaged_wait, &wait);
 }
 
-static int khugepaged_node_load[MAX_NUMNODES];
-
-static bool khugepaged_scan_abort(int nid)
+static bool khugepaged_scan_abort(int nid, struct collapse_control *cc)
 {
 	int i;
 
@@ -815,11 +852,11 @@ static bool khugepaged_scan_abort(int nid)
 		return false;
 
 	/* If there is a count for this node already, it must be acceptable */
-	if (khugepaged_node_load[nid])
+	if (cc->node_load[nid])
 		return false;
 
 	for (i = 0; i < MAX_NUMNODES; i++) {
-		if (!khugepaged_node_load[i])
+		if (!cc->node_load[i])
 			continue;
 		if (node_distance(nid, i) > node_reclaim_distance)
 			return true;
@@ -833,29 +870,35 @@ static inline gfp_t alloc_hugepage_khugepaged_gfpmask(void)
 	return khugepaged_defrag() ? GFP_TRANSHUGE : GFP_TRANSHUGE_LIGHT;
 }
 
+/* MADV_COLLAPSE always reclaims and compacts, in the caller's context */
+static inline gfp_t alloc_hugepage_collapse_gfpmask(struct collapse_control *cc)
+{
+	return cc->is_khugepaged ? alloc_hugepage_khugepaged_gfpmask() :
+				   GFP_TRANSHUGE;
+}
+
 #ifdef CONFIG_NUMA
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct collapse_control *cc)
 {
-	static int last_khugepaged_target_node = NUMA_NO_NODE;
 	int nid, target_node = 0, max_value = 0;
 
 	/* find first node with max normal pages hit */
 	for (nid = 0; nid < MAX_NUMNODES; nid++)
-		if (khugepaged_node_load[nid] > max_value) {
-			max_value = khugepaged_node_load[nid];
+		if (cc->node_load[nid] > max_value) {
+			max_value = cc->node_load[nid];
 			target_node = nid;
 		}
 
 	/* do some balance if several nodes have the same hit record */
-	if (target_node <= last_khugepaged_target_node)
-		for (nid = last_khugepaged_target_node + 1; nid < MAX_NUMNODES;
+	if (target_node <= cc->last_target_node)
+		for (nid = cc->last_target_node + 1; nid < MAX_NUMNODES;
 				nid++)
-			if (max_value == khugepaged_node_load[nid]) {
+			if (max_value == cc->node_load[nid]) {
 				target_node = nid;
 				break;
 			}
 
-	last_khugepaged_target_node = target_node;
+	cc->last_target_node = target_node;
 	return target_node;
 }
 
@@ -893,7 +936,7 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
 	return *hpage;
 }
 #else
-static int khugepaged_find_target_node(void)
+static int khugepaged_find_target_node(struct collapse_control *cc)
 {
 	return 0;
 }
@@ -961,6 +1004,16 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
 }
 #endif
 
+/*
+ * MADV_COLLAPSE works regardless of the sysfs "enabled" mode, as if the
+ * range was MADV_HUGEPAGE. MADV_NOHUGEPAGE still wins.
+ */
+static unsigned long collapse_vm_flags(struct vm_area_struct *vma,
+				       struct collapse_control *cc)
+{
+	return cc->is_khugepaged ? vma->vm_flags : vma->vm_flags | VM_HUGEPAGE;
+}
+
 /*
  * If mmap_lock temporarily dropped, revalidate vma
  * before taking mmap_lock.
@@ -969,7 +1022,7 @@ khugepaged_alloc_page(struct page **hpage, gfp_t gfp, int node)
  */
 
 static int hugepage_vma_revalidate(struct mm_struct *mm, unsigned long address,
-		struct vm_area_struct **vmap)
+		struct vm_area_struct **vmap, struct collapse_control *cc)
 {
 	struct vm_area_struct *vma;
 	unsigned long hstart, hend;
@@ -985,7 +1038,7 @@ static int hugepage_vma_revalidate(struct mm_struct *mm, unsigned long address,
 	hend = vma->vm_end & HPAGE_PMD_MASK;
 	if (address < hstart || address + HPAGE_PMD_SIZE > hend)
 		return SCAN_ADDRESS_RANGE;
-	if (!hugepage_vma_check(vma, vma->vm_flags))
+	if (!hugepage_vma_check(vma, collapse_vm_flags(vma, cc)))
 		return SCAN_VMA_CHECK;
 	/* Anon VMA expected */
 	if (!vma->anon_vma || vma->vm_ops)
@@ -1004,7 +1057,8 @@ static int hugepage_vma_revalidate(struct mm_struct *mm, unsigned long address,
 static bool __collapse_huge_page_swapin(struct mm_struct *mm,
 					struct vm_area_struct *vma,
 					unsigned long haddr, pmd_t *pmd,
-					int referenced)
+					int referenced,
+					struct collapse_control *cc)
 {
 	int swapped_in = 0;
 	vm_fault_t ret = 0;
@@ -1031,7 +1085,7 @@ static bool __collapse_huge_page_swapin(struct mm_struct *mm,
 		/* do_swap_page returns VM_FAULT_RETRY with released mmap_lock */
 		if (ret & VM_FAULT_RETRY) {
 			mmap_read_lock(mm);
-			if (hugepage_vma_revalidate(mm, haddr, &vma)) {
+			if (hugepage_vma_revalidate(mm, haddr, &vma, cc)) {
 				/* vma is no longer available, don't continue to swapin */
 				trace_mm_collapse_huge_page_swapin(mm, swapped_in, referenced, 0);
 				return false;
@@ -1056,10 +1110,11 @@ static bool __collapse_huge_page_swapin(struct mm_struct *mm,
 	return true;
 }
 
-static void collapse_huge_page(struct mm_struct *mm,
-				   unsigned long address,
-				   struct page **hpage,
-				   int node, int referenced, int unmapped)
+static int collapse_huge_page(struct mm_struct *mm,
+			      unsigned long address,
+			      struct page **hpage,
+			      int node, int referenced, int unmapped,
+			      struct collapse_control *cc)
 {
 	LIST_HEAD(compound_pagelist);
 	pmd_t *pmd, _pmd;
@@ -1075,7 +1130,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	VM_BUG_ON(address & ~HPAGE_PMD_MASK);
 
 	/* Only allocate from the target node */
-	gfp = alloc_hugepage_khugepaged_gfpmask() | __GFP_THISNODE;
+	gfp = alloc_hugepage_collapse_gfpmask(cc) | __GFP_THISNODE;
 
 	/*
 	 * Before allocating the hugepage, release the mmap_lock read lock.
@@ -1097,7 +1152,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	count_memcg_page_event(new_page, THP_COLLAPSE_ALLOC);
 
 	mmap_read_lock(mm);
-	result = hugepage_vma_revalidate(mm, address, &vma);
+	result = hugepage_vma_revalidate(mm, address, &vma, cc);
 	if (result) {
 		mmap_read_unlock(mm);
 		goto out_nolock;
@@ -1116,7 +1171,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	 * Continuing to collapse causes inconsistency.
 	 */
 	if (unmapped && !__collapse_huge_page_swapin(mm, vma, address,
-						     pmd, referenced)) {
+						     pmd, referenced, cc)) {
 		mmap_read_unlock(mm);
 		goto out_nolock;
 	}
@@ -1128,13 +1183,19 @@ static void collapse_huge_page(struct mm_struct *mm,
 	 * handled by the anon_vma lock + PG_lock.
 	 */
 	mmap_write_lock(mm);
-	result = hugepage_vma_revalidate(mm, address, &vma);
+	result = hugepage_vma_revalidate(mm, address, &vma, cc);
 	if (result)
 		goto out_up_write;
 	/* check if the pmd is still valid */
 	if (mm_find_pmd(mm, address) != pmd)
 		goto out_up_write;
+	/* A fork may have shared the pte table while mmap_lock was dropped */
+	if (pmd_pte_table_shared(pmd)) {
+		result = SCAN_PTE_TABLE_SHARED;
+		goto out_up_write;
+	}
 
+	vma_start_write(vma);
 	anon_vma_lock_write(vma->anon_vma);
 
 	mmu_notifier_range_init(&range, MMU_NOTIFY_CLEAR, 0, NULL, mm,
@@ -1157,7 +1218,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 
 	spin_lock(pte_ptl);
 	isolated = __collapse_huge_page_isolate(vma, address, pte,
-			&compound_pagelist);
+			&compound_pagelist, cc);
 	spin_unlock(pte_ptl);
 
 	if (unlikely(!isolated)) {
@@ -1208,7 +1269,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 
 	*hpage = NULL;
 
-	khugepaged_pages_collapsed++;
+	if (cc->is_khugepaged)
+		khugepaged_pages_collapsed++;
 	result = SCAN_SUCCEED;
 out_up_write:
 	mmap_write_unlock(mm);
@@ -1216,18 +1278,26 @@ static void collapse_huge_page(struct mm_struct *mm,
 	if (!IS_ERR_OR_NULL(*hpage))
 		mem_cgroup_uncharge(*hpage);
 	trace_mm_collapse_huge_page(mm, isolated, result);
-	return;
+	return result;
 }
 
+/*
+ * Returns the scan result, or the result of the collapse if the range
+ * qualified, in which case mmap_lock has been released.
+ */
 static int khugepaged_scan_pmd(struct mm_struct *mm,
 			       struct vm_area_struct *vma,
 			       unsigned long address,
-			       struct page **hpage)
+			       struct page **hpage, bool *mmap_locked,
+			       struct collapse_control *cc)
 {
 	pmd_t *pmd;
 	pte_t *pte, *_pte;
-	int ret = 0, result = 0, referenced = 0;
+	int result = 0, referenced = 0;
 	int none_or_zero = 0, shared = 0;
+	int max_ptes_none = collapse_max_ptes_none(cc);
+	int max_ptes_swap = collapse_max_ptes_swap(cc);
+	int max_ptes_shared = collapse_max_ptes_shared(cc);
 	struct page *page = NULL;
 	unsigned long _address;
 	spinlock_t *ptl;
@@ -1241,14 +1311,19 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		result = SCAN_PMD_NULL;
 		goto out;
 	}
+	/* The other mms sharing the pte table would keep mapping the ptes */
+	if (pmd_pte_table_shared(pmd)) {
+		result = SCAN_PTE_TABLE_SHARED;
+		goto out;
+	}
 
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(cc->node_load, 0, sizeof(cc->node_load));
 	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
 	for (_address = address, _pte = pte; _pte < pte+HPAGE_PMD_NR;
 	     _pte++, _address += PAGE_SIZE) {
 		pte_t pteval = *_pte;
 		if (is_swap_pte(pteval)) {
-			if (++unmapped <= khugepaged_max_ptes_swap) {
+			if (++unmapped <= max_ptes_swap) {
 				/*
 				 * Always be strict with uffd-wp
 				 * enabled swap entries.  Please see
@@ -1266,7 +1341,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		}
 		if (pte_none(pteval) || is_zero_pfn(pte_pfn(pteval))) {
 			if (!userfaultfd_armed(vma) &&
-			    ++none_or_zero <= khugepaged_max_ptes_none) {
+			    ++none_or_zero <= max_ptes_none) {
 				continue;
 			} else {
 				result = SCAN_EXCEED_NONE_PTE;
@@ -1296,7 +1371,7 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 		}
 
 		if (page_mapcount(page) > 1 &&
-				++shared > khugepaged_max_ptes_shared) {
+				++shared > max_ptes_shared) {
 			result = SCAN_EXCEED_SHARED_PTE;
 			goto out_unmap;
 		}
@@ -1305,16 +1380,16 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 
 		/*
 		 * Record which node the original page is from and save this
-		 * information to khugepaged_node_load[].
+		 * information to cc->node_load[].
 		 * Khupaged will allocate hugepage from the node has the max
 		 * hit record.
 		 */
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(node, cc)) {
 			result = SCAN_SCAN_ABORT;
 			goto out_unmap;
 		}
-		khugepaged_node_load[node]++;
+		cc->node_load[node]++;
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
 			goto out_unmap;
@@ -1356,24 +1431,25 @@ static int khugepaged_scan_pmd(struct mm_struct *mm,
 	}
 	if (!writable) {
 		result = SCAN_PAGE_RO;
-	} else if (!referenced || (unmapped && referenced < HPAGE_PMD_NR/2)) {
+	} else if (cc->is_khugepaged &&
+		   (!referenced || (unmapped && referenced < HPAGE_PMD_NR/2))) {
 		result = SCAN_LACK_REFERENCED_PAGE;
 	} else {
 		result = SCAN_SUCCEED;
-		ret = 1;
 	}
 out_unmap:
 	pte_unmap_unlock(pte, ptl);
-	if (ret) {
-		node = khugepaged_find_target_node();
-		/* collapse_huge_page will return with the mmap_lock released */
-		collapse_huge_page(mm, address, hpage, node,
-				referenced, unmapped);
-	}
 out:
 	trace_mm_khugepaged_scan_pmd(mm, page, writable, referenced,
 				     none_or_zero, result, unmapped);
-	return ret;
+	if (result == SCAN_SUCCEED) {
+		node = khugepaged_find_target_node(cc);
+		/* collapse_huge_page will return with the mmap_lock released */
+		*mmap_locked = false;
+		result = collapse_huge_page(mm, address, hpage, node,
+					    referenced, unmapped, cc);
+	}
+	return result;
 }
 
 static void collect_mm_slot(struct mm_slot *mm_slot)
@@ -1619,6 +1695,7 @@ static void retract_page_tables(struct address_space *mapping, pgoff_t pgoff)
  * @start: collapse start address
  * @hpage: new allocated huge page for collapse
  * @node: appointed node the new huge page allocate from
+ * @cc: collapse context, khugepaged or MADV_COLLAPSE
  *
  * Basic scheme is simple, details are more complex:
  *  - allocate and lock a new huge page;
@@ -1635,9 +1712,10 @@ static void retract_page_tables(struct address_space *mapping, pgoff_t pgoff)
  *    + restore gaps in the page cache;
  *    + unlock and free huge page;
  */
-static void collapse_file(struct mm_struct *mm,
+static int collapse_file(struct mm_struct *mm,
 		struct file *file, pgoff_t start,
-		struct page **hpage, int node)
+		struct page **hpage, int node,
+		struct collapse_control *cc)
 {
 	struct address_space *mapping = file->f_mapping;
 	gfp_t gfp;
@@ -1653,7 +1731,7 @@ static void collapse_file(struct mm_struct *mm,
 	VM_BUG_ON(start & (HPAGE_PMD_NR - 1));
 
 	/* Only allocate from the target node */
-	gfp = alloc_hugepage_khugepaged_gfpmask() | __GFP_THISNODE;
+	gfp = alloc_hugepage_collapse_gfpmask(cc) | __GFP_THISNODE;
 
 	new_page = khugepaged_alloc_page(hpage, gfp, node);
 	if (!new_page) {
@@ -1937,7 +2015,8 @@ static void collapse_file(struct mm_struct *mm,
 		retract_page_tables(mapping, start);
 		*hpage = NULL;
 
-		khugepaged_pages_collapsed++;
+		if (cc->is_khugepaged)
+			khugepaged_pages_collapsed++;
 	} else {
 		struct page *page;
 
@@ -1985,10 +2064,12 @@ static void collapse_file(struct mm_struct *mm,
 	if (!IS_ERR_OR_NULL(*hpage))
 		mem_cgroup_uncharge(*hpage);
 	/* TODO: tracepoints */
+	return result;
 }
 
-static void khugepaged_scan_file(struct mm_struct *mm,
-		struct file *file, pgoff_t start, struct page **hpage)
+static int khugepaged_scan_file(struct mm_struct *mm,
+		struct file *file, pgoff_t start, struct page **hpage,
+		struct collapse_control *cc)
 {
 	struct page *page = NULL;
 	struct address_space *mapping = file->f_mapping;
@@ -1999,14 +2080,14 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 
 	present = 0;
 	swap = 0;
-	memset(khugepaged_node_load, 0, sizeof(khugepaged_node_load));
+	memset(cc->node_load, 0, sizeof(cc->node_load));
 	rcu_read_lock();
 	xas_for_each(&xas, page, start + HPAGE_PMD_NR - 1) {
 		if (xas_retry(&xas, page))
 			continue;
 
 		if (xa_is_value(page)) {
-			if (++swap > khugepaged_max_ptes_swap) {
+			if (++swap > collapse_max_ptes_swap(cc)) {
 				result = SCAN_EXCEED_SWAP_PTE;
 				break;
 			}
@@ -2019,11 +2100,11 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 		}
 
 		node = page_to_nid(page);
-		if (khugepaged_scan_abort(node)) {
+		if (khugepaged_scan_abort(node, cc)) {
 			result = SCAN_SCAN_ABORT;
 			break;
 		}
-		khugepaged_node_load[node]++;
+		cc->node_load[node]++;
 
 		if (!PageLRU(page)) {
 			result = SCAN_PAGE_LRU;
@@ -2052,21 +2133,25 @@ static void khugepaged_scan_file(struct mm_struct *mm,
 	rcu_read_unlock();
 
 	if (result == SCAN_SUCCEED) {
-		if (present < HPAGE_PMD_NR - khugepaged_max_ptes_none) {
+		if (present < HPAGE_PMD_NR - collapse_max_ptes_none(cc)) {
 			result = SCAN_EXCEED_NONE_PTE;
 		} else {
-			node = khugepaged_find_target_node();
-			collapse_file(mm, file, start, hpage, node);
+			node = khugepaged_find_target_node(cc);
+			result = collapse_file(mm, file, start, hpage, node,
+					       cc);
 		}
 	}
 
 	/* TODO: tracepoints */
+	return result;
 }
 #else
-static void khugepaged_scan_file(struct mm_struct *mm,
-		struct file *file, pgoff_t start, struct page **hpage)
+static int khugepaged_scan_file(struct mm_struct *mm,
+		struct file *file, pgoff_t start, struct page **hpage,
+		struct collapse_control *cc)
 {
 	BUILD_BUG();
+	return SCAN_FAIL;
 }
 
 static void khugepaged_collapse_pte_mapped_thps(struct mm_slot *mm_slot)
@@ -2082,6 +2167,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 	struct mm_slot *mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
+	struct collapse_control *cc = &khugepaged_collapse_control;
 	int progress = 0;
 
 	VM_BUG_ON(!pages);
@@ -2136,7 +2222,8 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 			goto skip;
 
 		while (khugepaged_scan.address < hend) {
-			int ret;
+			bool mmap_locked = true;
+
 			cond_resched();
 			if (unlikely(khugepaged_test_exit(mm)))
 				goto breakouterloop;
@@ -2150,18 +2237,19 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages,
 						khugepaged_scan.address);
 
 				mmap_read_unlock(mm);
-				ret = 1;
-				khugepaged_scan_file(mm, file, pgoff, hpage);
+				mmap_locked = false;
+				khugepaged_scan_file(mm, file, pgoff, hpage,
+						     cc);
 				fput(file);
 			} else {
-				ret = khugepaged_scan_pmd(mm, vma,
+				khugepaged_scan_pmd(mm, vma,
 						khugepaged_scan.address,
-						hpage);
+						hpage, &mmap_locked, cc);
 			}
 			/* move to next address */
 			khugepaged_scan.address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
-			if (ret)
+			if (!mmap_locked)
 				/* we released mmap_lock so break loop */
 				goto breakouterloop_mmap_lock;
 			if (progress >= pages)
@@ -2373,3 +2461,169 @@ void khugepaged_min_free_kbytes_update(void)
 		set_recommended_min_free_kbytes();
 	mutex_unlock(&khugepaged_mutex);
 }
+
+/* Mapped by a huge pmd already, there is nothing left to collapse */
+static bool khugepaged_pmd_mapped(struct mm_struct *mm, unsigned long address)
+{
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pud_t *pud;
+	pmd_t pmde;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		return false;
+
+	p4d = p4d_offset(pgd, address);
+	if (!p4d_present(*p4d))
+		return false;
+
+	pud = pud_offset(p4d, address);
+	if (!pud_present(*pud))
+		return false;
+
+	pmde = READ_ONCE(*pmd_offset(pud, address));
+	return pmd_trans_huge(pmde) || pmd_devmap(pmde);
+}
+
+static int madvise_collapse_errno(int result)
+{
+	switch (result) {
+	case SCAN_ALLOC_HUGE_PAGE_FAIL:
+		return -ENOMEM;
+	case SCAN_CGROUP_CHARGE_FAIL:
+		return -EBUSY;
+	/* Transient, trying again may succeed */
+	case SCAN_PAGE_COUNT:
+	case SCAN_PAGE_LOCK:
+	case SCAN_PAGE_LRU:
+	case SCAN_DEL_PAGE_LRU:
+	case SCAN_PTE_TABLE_SHARED:
+		return -EAGAIN;
+	default:
+		return -EINVAL;
+	}
+}
+
+/**
+ * madvise_collapse - collapse a range into huge pages right away
+ * @vma: the vma containing the range
+ * @prev: set to NULL if mmap_lock was dropped on the way
+ * @start: start of the range
+ * @end: end of the range, within @vma
+ *
+ * MADV_COLLAPSE: runs the khugepaged collapse on every PMD sized part of
+ * the range, synchronously in the caller's context and without the sysfs
+ * scan limits. The huge pages are charged to the memcg of the mm. Works
+ * for anonymous memory, shmem and, with CONFIG_READ_ONLY_THP_FOR_FS,
+ * read-only file text.
+ *
+ * The result of every PMD is reported by the mm_madvise_collapse
+ * tracepoint. Returns 0 if the whole range is PMD mapped or will be on
+ * the next fault, otherwise the error of the last PMD that failed:
+ * -ENOMEM if no huge page could be allocated, -EBUSY if the memcg charge
+ * failed, -EAGAIN if some page was temporarily busy and -EINVAL if the
+ * range cannot be collapsed.
+ */
+int madvise_collapse(struct vm_area_struct *vma, struct vm_area_struct **prev,
+		     unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	struct collapse_control *cc;
+	struct page *hpage = NULL;
+	unsigned long hstart, hend, addr;
+	int last_fail = SCAN_SUCCEED;
+	bool mmap_locked = true;
+
+	*prev = vma;
+
+	if (!hugepage_vma_check(vma, vma->vm_flags | VM_HUGEPAGE))
+		return -EINVAL;
+
+	cc = kmalloc(sizeof(*cc), GFP_KERNEL);
+	if (!cc)
+		return -ENOMEM;
+	cc->is_khugepaged = false;
+	cc->last_target_node = NUMA_NO_NODE;
+
+	lru_add_drain_all();
+
+	hstart = (start + ~HPAGE_PMD_MASK) & HPAGE_PMD_MASK;
+	hend = end & HPAGE_PMD_MASK;
+
+	for (addr = hstart; addr < hend; addr += HPAGE_PMD_SIZE) {
+		bool wait = false;
+		int result;
+
+		if (!mmap_locked) {
+			cond_resched();
+			mmap_read_lock(mm);
+			mmap_locked = true;
+			*prev = NULL;
+
+			vma = find_vma(mm, addr);
+			if (!vma ||
+			    !range_in_vma(vma, addr, addr + HPAGE_PMD_SIZE) ||
+			    !hugepage_vma_check(vma, collapse_vm_flags(vma, cc))) {
+				result = SCAN_VMA_CHECK;
+				goto next;
+			}
+		}
+
+		if (khugepaged_pmd_mapped(mm, addr)) {
+			result = SCAN_PMD_MAPPED;
+			goto next;
+		}
+
+		if (!khugepaged_prealloc_page(&hpage, &wait)) {
+			result = SCAN_ALLOC_HUGE_PAGE_FAIL;
+			goto next;
+		}
+
+		if (IS_ENABLED(CONFIG_SHMEM) && vma->vm_file) {
+			struct file *file = get_file(vma->vm_file);
+			pgoff_t pgoff = linear_page_index(vma, addr);
+
+			mmap_read_unlock(mm);
+			mmap_locked = false;
+			result = khugepaged_scan_file(mm, file, pgoff, &hpage,
+						      cc);
+			fput(file);
+
+			/*
+			 * The page cache holds a huge page now, retract our
+			 * page table so that it refaults with a pmd, rather
+			 * than waiting for khugepaged to do it.
+			 */
+			if (result == SCAN_SUCCEED ||
+			    result == SCAN_PAGE_COMPOUND) {
+				mmap_write_lock(mm);
+				collapse_pte_mapped_thp(mm, addr);
+				mmap_write_unlock(mm);
+				result = SCAN_SUCCEED;
+			}
+		} else {
+			result = khugepaged_scan_pmd(mm, vma, addr, &hpage,
+						     &mmap_locked, cc);
+		}
+next:
+		trace_mm_madvise_collapse(mm, addr, result);
+		if (result != SCAN_SUCCEED && result != SCAN_PMD_MAPPED)
+			last_fail = result;
+		/* Allocation failure marker, try again for the next pmd */
+		if (IS_ERR(hpage))
+			hpage = NULL;
+	}
+
+	if (!IS_ERR_OR_NULL(hpage))
+		put_page(hpage);
+	kfree(cc);
+
+	/* The caller expects mmap_lock to be held */
+	if (!mmap_locked) {
+		mmap_read_lock(mm);
+		*prev = NULL;
+	}
+
+	return last_fail == SCAN_SUCCEED ? 0 : madvise_collapse_errno(last_fail);
+}
@@ -20,6 +20,7 @@
 #include <linux/sched.h>
 #include <linux/sched/mm.h>
 #include <linux/sched/coredump.h>
+#include <linux/sched/cputime.h>
 #include <linux/rwsem.h>
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
@@ -270,6 +271,34 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* The number of pages scanned by ksmd */
+static unsigned long ksm_pages_scanned;
+
+/* How pages_to_scan is picked: by hand, or from what the last scan merged */
+enum ksm_advisor_type {
+	KSM_ADVISOR_NONE,
+	KSM_ADVISOR_YIELD,
+};
+static enum ksm_advisor_type ksm_advisor;
+
+/* Bounds the advisor keeps pages_to_scan in */
+static unsigned int ksm_advisor_min_pages_to_scan = 500;
+static unsigned int ksm_advisor_max_pages_to_scan = 30000;
+
+/* Share of one CPU, in percent, ksmd may use while the advisor speeds up */
+static unsigned int ksm_advisor_max_cpu = 70;
+
+/* Pages merged per thousand scanned for a full scan to be worth speeding up */
+static unsigned int ksm_advisor_target_yield = 10;
+
+/* Where the full scan in progress started, see advisor_stop_scan() */
+static struct {
+	ktime_t start;
+	u64 cpu_time;
+	unsigned long pages_scanned;
+	unsigned long pages_sharing;
+} advisor_ctx;
+
 /* Checksum of an empty (zeroed) page */
 static unsigned int zero_checksum __read_mostly;
 
@@ -386,6 +415,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -637,6 +667,9 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+
+		rmap_item->mm->ksm_merging_pages--;
+
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
 		put_anon_vma(rmap_item->anon_vma);
@@ -784,6 +817,9 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+
+		rmap_item->mm->ksm_merging_pages--;
+
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
 
@@ -1051,6 +1087,9 @@ static int write_protect_page(struct vm_area_struct *vma, struct page *page,
 		goto out_mn;
 	if (WARN_ONCE(!pvmw.pte, "Unexpected PMD mapping?"))
 		goto out_unlock;
+	/* The other mms mapping a pte table shared by fork are not flushed */
+	if (pmd_pte_table_shared(pvmw.pmd))
+		goto out_unlock;
 
 	if (pte_write(*pvmw.pte) || pte_dirty(*pvmw.pte) ||
 	    (pte_protnone(*pvmw.pte) && pte_savedwrite(*pvmw.pte)) ||
@@ -2014,6 +2053,8 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -2207,6 +2248,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -2214,6 +2256,62 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+static void advisor_start_scan(void)
+{
+	if (ksm_advisor == KSM_ADVISOR_NONE)
+		return;
+
+	advisor_ctx.start = ktime_get();
+	advisor_ctx.cpu_time = task_sched_runtime(current);
+	advisor_ctx.pages_scanned = ksm_pages_scanned;
+	advisor_ctx.pages_sharing = ksm_pages_sharing;
+}
+
+/*
+ * At the end of a full scan, weigh what it merged against the CPU time it
+ * took ksmd. A scan that merged at least advisor_target_yield pages per
+ * thousand it looked at is worth repeating sooner, as far as advisor_max_cpu
+ * allows; one that merged less only keeps ksmd busy, so back off towards
+ * advisor_min_pages_to_scan. Steps are at most a factor of two per scan, so
+ * a burst of merging or COW breaking does not make pages_to_scan swing.
+ */
+static void advisor_stop_scan(void)
+{
+	unsigned long scanned, pages, cpu_percent;
+	s64 elapsed_ms;
+	u64 cpu_ms;
+	long merged;
+
+	if (ksm_advisor == KSM_ADVISOR_NONE || !advisor_ctx.start)
+		return;
+
+	elapsed_ms = ktime_ms_delta(ktime_get(), advisor_ctx.start);
+	cpu_ms = div_u64(task_sched_runtime(current) - advisor_ctx.cpu_time,
+			 NSEC_PER_MSEC);
+	scanned = ksm_pages_scanned - advisor_ctx.pages_scanned;
+	merged = (long)(ksm_pages_sharing - advisor_ctx.pages_sharing);
+	advisor_ctx.start = 0;
+
+	if (elapsed_ms <= 0 || !scanned)
+		return;
+
+	cpu_percent = div64_u64(cpu_ms * 100, (u64)elapsed_ms);
+	pages = ksm_thread_pages_to_scan;
+
+	if (cpu_percent > ksm_advisor_max_cpu)
+		pages = pages * ksm_advisor_max_cpu / cpu_percent;
+	else if (merged > 0 &&
+		 (unsigned long)merged * 1000 >= scanned * ksm_advisor_target_yield)
+		pages = min(pages * 2, pages * ksm_advisor_max_cpu /
+				       max(cpu_percent, 1UL));
+	else
+		pages /= 2;
+
+	pages = clamp_t(unsigned long, pages, ksm_advisor_min_pages_to_scan,
+			ksm_advisor_max_pages_to_scan);
+	WRITE_ONCE(ksm_thread_pages_to_scan, pages);
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -2227,6 +2325,8 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 
 	slot = ksm_scan.mm_slot;
 	if (slot == &ksm_mm_head) {
+		advisor_start_scan();
+
 		/*
 		 * A number of pages can hang around indefinitely on per-cpu
 		 * pagevecs, raised page count preventing write_protect_page
@@ -2369,6 +2469,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
+	advisor_stop_scan();
 	ksm_scan.seqnr++;
 	return NULL;
 }
@@ -2389,6 +2490,7 @@ static void ksm_do_scan(unsigned int scan_npages)
 			return;
 		cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		ksm_pages_scanned++;
 	}
 }
 
@@ -2426,6 +2528,139 @@ static int ksm_scan_thread(void *nothing)
 	return 0;
 }
 
+static bool ksm_compatible(const struct file *file, vm_flags_t vm_flags)
+{
+	/*
+	 * Be somewhat over-protective for now!
+	 */
+	if (vm_flags & (VM_SHARED  | VM_MAYSHARE   | VM_PFNMAP    |
+			VM_IO      | VM_DONTEXPAND | VM_HUGETLB   |
+			VM_MIXEDMAP))
+		return false;
+
+	if (file && IS_DAX(file_inode(file)))
+		return false;
+
+#ifdef VM_SAO
+	if (vm_flags & VM_SAO)
+		return false;
+#endif
+#ifdef VM_SPARC_ADI
+	if (vm_flags & VM_SPARC_ADI)
+		return false;
+#endif
+
+	return true;
+}
+
+static bool vma_ksm_compatible(struct vm_area_struct *vma)
+{
+	return ksm_compatible(vma->vm_file, vma->vm_flags);
+}
+
+/**
+ * ksm_vma_flags - flags of a new VMA, mergeable if its mm asked for all of them
+ * @mm: the mm the VMA is for
+ * @file: the file mapped by the VMA, or NULL
+ * @vm_flags: the flags the VMA is to be created with
+ *
+ * Called with mmap_lock held for write, before the VMA is merged with its
+ * neighbours or created, so that it merges with those ksm_enable_merge_any()
+ * marked. The mm may not be registered with ksmd yet when
+ * PR_SET_MEMORY_MERGE was inherited across exec.
+ *
+ * Return: @vm_flags, with VM_MERGEABLE added if applicable.
+ */
+vm_flags_t ksm_vma_flags(struct mm_struct *mm, const struct file *file,
+			 vm_flags_t vm_flags)
+{
+	if (!test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return vm_flags;
+	if (!ksm_compatible(file, vm_flags))
+		return vm_flags;
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags) && __ksm_enter(mm))
+		return vm_flags;
+
+	return vm_flags | VM_MERGEABLE;
+}
+
+/**
+ * ksm_enable_merge_any - let ksmd merge all eligible VMAs of an mm
+ * @mm: the mm, with mmap_lock held for write
+ *
+ * Backs PR_SET_MEMORY_MERGE: marks the VMAs mapped now and, through
+ * ksm_vma_flags(), those mapped later, without the process having to
+ * madvise(MADV_MERGEABLE) each of them. The setting is inherited across
+ * fork and exec.
+ */
+int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			return err;
+	}
+
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if ((vma->vm_flags & VM_MERGEABLE) || !vma_ksm_compatible(vma))
+			continue;
+		vma_start_write(vma);
+		vma->vm_flags |= VM_MERGEABLE;
+	}
+
+	return 0;
+}
+
+/**
+ * ksm_disable_merge_any - undo ksm_enable_merge_any()
+ * @mm: the mm, with mmap_lock held for write
+ *
+ * Unmerges all the KSM pages of @mm, including those of VMAs that were
+ * made mergeable with madvise(), and stops ksmd from merging any of it.
+ */
+int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (!test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (!(vma->vm_flags & VM_MERGEABLE))
+			continue;
+		if (vma->anon_vma) {
+			err = unmerge_ksm_pages(vma, vma->vm_start, vma->vm_end);
+			if (err)
+				return err;
+		}
+		vma_start_write(vma);
+		vma->vm_flags &= ~VM_MERGEABLE;
+	}
+
+	clear_bit(MMF_VM_MERGE_ANY, &mm->flags);
+
+	return 0;
+}
+
+/*
+ * Memory saved by merging the pages of @mm, less what ksmd spends on
+ * tracking them. Negative while merging does not pay off for the mm.
+ */
+long ksm_process_profit(struct mm_struct *mm)
+{
+	return (long)(mm->ksm_merging_pages << PAGE_SHIFT) -
+		mm->ksm_rmap_items * sizeof(struct rmap_item);
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -2434,26 +2669,11 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
-		/*
-		 * Be somewhat over-protective for now!
-		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_HUGETLB | VM_MIXEDMAP))
+		if (*vm_flags & VM_MERGEABLE)
 			return 0;		/* just ignore the advice */
-
-		if (vma_is_dax(vma))
+		if (!vma_ksm_compatible(vma))
 			return 0;
 
-#ifdef VM_SAO
-		if (*vm_flags & VM_SAO)
-			return 0;
-#endif
-#ifdef VM_SPARC_ADI
-		if (*vm_flags & VM_SPARC_ADI)
-			return 0;
-#endif
-
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
 			err = __ksm_enter(mm);
 			if (err)
@@ -2859,6 +3079,10 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 	unsigned int nr_pages;
 	int err;
 
+	/* The advisor owns it */
+	if (ksm_advisor != KSM_ADVISOR_NONE)
+		return -EINVAL;
+
 	err = kstrtouint(buf, 10, &nr_pages);
 	if (err)
 		return -EINVAL;
@@ -3123,6 +3347,164 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_scanned_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lu\n", ksm_pages_scanned);
+}
+KSM_ATTR_RO(pages_scanned);
+
+static ssize_t general_profit_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	long general_profit;
+
+	general_profit = (long)(ksm_pages_sharing << PAGE_SHIFT) -
+			 ksm_rmap_items * sizeof(struct rmap_item);
+
+	return sysfs_emit(buf, "%ld\n", general_profit);
+}
+KSM_ATTR_RO(general_profit);
+
+static ssize_t advisor_mode_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	if (ksm_advisor == KSM_ADVISOR_NONE)
+		return sysfs_emit(buf, "[none] yield\n");
+	return sysfs_emit(buf, "none [yield]\n");
+}
+
+static ssize_t advisor_mode_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	enum ksm_advisor_type advisor;
+
+	if (sysfs_streq(buf, "none"))
+		advisor = KSM_ADVISOR_NONE;
+	else if (sysfs_streq(buf, "yield"))
+		advisor = KSM_ADVISOR_YIELD;
+	else
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (ksm_advisor != advisor) {
+		ksm_advisor = advisor;
+		/* Only measure full scans that started under the advisor */
+		advisor_ctx.start = 0;
+		if (advisor != KSM_ADVISOR_NONE)
+			ksm_thread_pages_to_scan = ksm_advisor_min_pages_to_scan;
+	}
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(advisor_mode);
+
+static ssize_t advisor_max_cpu_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_max_cpu);
+}
+
+static ssize_t advisor_max_cpu_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned int percent;
+	int err;
+
+	err = kstrtouint(buf, 10, &percent);
+	if (err || !percent || percent > 100)
+		return -EINVAL;
+
+	ksm_advisor_max_cpu = percent;
+
+	return count;
+}
+KSM_ATTR(advisor_max_cpu);
+
+static ssize_t advisor_min_pages_to_scan_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_min_pages_to_scan);
+}
+
+static ssize_t advisor_min_pages_to_scan_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned int nr_pages;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_pages);
+	if (err || !nr_pages)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (nr_pages > ksm_advisor_max_pages_to_scan)
+		err = -EINVAL;
+	else
+		ksm_advisor_min_pages_to_scan = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(advisor_min_pages_to_scan);
+
+static ssize_t advisor_max_pages_to_scan_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_max_pages_to_scan);
+}
+
+static ssize_t advisor_max_pages_to_scan_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned int nr_pages;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_pages);
+	if (err)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	if (nr_pages < ksm_advisor_min_pages_to_scan)
+		err = -EINVAL;
+	else
+		ksm_advisor_max_pages_to_scan = nr_pages;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return err ? err : count;
+}
+KSM_ATTR(advisor_max_pages_to_scan);
+
+static ssize_t advisor_target_yield_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_target_yield);
+}
+
+static ssize_t advisor_target_yield_store(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  const char *buf, size_t count)
+{
+	unsigned int permille;
+	int err;
+
+	err = kstrtouint(buf, 10, &permille);
+	if (err || permille > 1000)
+		return -EINVAL;
+
+	ksm_advisor_target_yield = permille;
+
+	return count;
+}
+KSM_ATTR(advisor_target_yield);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -3132,6 +3514,8 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&pages_scanned_attr.attr,
+	&general_profit_attr.attr,
 #ifdef CONFIG_NUMA
 	&merge_across_nodes_attr.attr,
 #endif
@@ -3140,6 +3524,11 @@ static struct attribute *ksm_attrs[] = {
 	&stable_node_dups_attr.attr,
 	&stable_node_chains_prune_millisecs_attr.attr,
 	&use_zero_pages_attr.attr,
+	&advisor_mode_attr.attr,
+	&advisor_max_cpu_attr.attr,
+	&advisor_min_pages_to_scan_attr.attr,
+	&advisor_max_pages_to_scan_attr.attr,
+	&advisor_target_yield_attr.attr,
 	NULL,
 };
 
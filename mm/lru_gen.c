@@ -0,0 +1,420 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Page table walk based aging for page reclaim.
+ *
+ * Instead of walking the rmap of every page reclaim looks at, walk the page
+ * tables of the processes that actually ran, which visits the accessed bits
+ * in the order they are laid out in memory. Every page found young is stamped
+ * with the sequence number of the pass that found it, see
+ * include/linux/lru_gen.h. Passes are driven by kswapd and rate limited by
+ * min_interval_ms.
+ */
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mm_types.h>
+#include <linux/sched/mm.h>
+#include <linux/pagewalk.h>
+#include <linux/hugetlb.h>
+#include <linux/mmu_notifier.h>
+#include <linux/page_idle.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include <linux/kobject.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/lru_gen.h>
+
+DEFINE_STATIC_KEY_FALSE(lru_gen_enabled_key);
+
+unsigned long lru_gen_seq;
+
+/* All user address spaces, walked in round-robin order */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+/* Serializes aging passes, kswapd of every node may try to start one */
+static DEFINE_MUTEX(lru_gen_age_mutex);
+
+static unsigned int lru_gen_min_interval_ms = 1000;
+static unsigned long lru_gen_last_age;
+
+struct lru_gen_walk {
+	unsigned long seq;
+	int gen;
+	unsigned long nr_mm;
+	unsigned long nr_mm_skipped;
+	unsigned long nr_scanned;
+	unsigned long nr_young;
+};
+
+/* Statistics of the last completed pass, protected by lru_gen_age_mutex */
+static struct lru_gen_walk lru_gen_last_walk;
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	/* Not walked in the current pass yet */
+	mm->lru_gen.seq = READ_ONCE(lru_gen_seq) - 1;
+	mm->lru_gen.walked = mm->lru_gen.seq;
+	mm->lru_gen.active = true;
+
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen.list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_del(&mm->lru_gen.list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+static void lru_gen_mark_young(struct page *page, struct lru_gen_walk *priv)
+{
+	page = compound_head(page);
+	if (!PageLRU(page))
+		return;
+
+	/* Keep idle page tracking in sync with the accessed bit we consumed */
+	clear_page_idle(page);
+	page_set_lru_gen(page, priv->gen);
+	priv->nr_young++;
+}
+
+/*
+ * Pages that are mapped but were not accessed since the last walk keep the
+ * stamp of the pass that last found them young. Turn it into LRU_GEN_OLD
+ * before (seq % MAX_NR_GENS) wraps around to it and makes it look young.
+ */
+static void lru_gen_mark_old(struct page *page, struct lru_gen_walk *priv)
+{
+	int gen;
+
+	page = compound_head(page);
+	gen = page_lru_gen(page);
+	if (gen < 0 || gen == LRU_GEN_OLD)
+		return;
+
+	if ((priv->gen + MAX_NR_GENS - gen) % MAX_NR_GENS >= MIN_NR_GENS)
+		page_set_lru_gen(page, LRU_GEN_OLD);
+}
+
+static int lru_gen_pmd_entry(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct lru_gen_walk *priv = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *orig_pte, *pte;
+	struct page *page;
+	spinlock_t *ptl;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	ptl = pmd_trans_huge_lock(pmd, vma);
+	if (ptl) {
+		if (pmd_present(*pmd) && !is_huge_zero_pmd(*pmd)) {
+			priv->nr_scanned++;
+			if (pmd_young(*pmd) &&
+			    pmdp_clear_young_notify(vma, addr, pmd))
+				lru_gen_mark_young(pmd_page(*pmd), priv);
+			else
+				lru_gen_mark_old(pmd_page(*pmd), priv);
+		}
+		spin_unlock(ptl);
+		return 0;
+	}
+#endif
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr < end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+
+		if (!pte_present(ptent))
+			continue;
+
+		priv->nr_scanned++;
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		if (pte_young(ptent) && ptep_clear_young_notify(vma, addr, pte))
+			lru_gen_mark_young(page, priv);
+		else
+			lru_gen_mark_old(page, priv);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+
+	return 0;
+}
+
+static int lru_gen_test_walk(unsigned long start, unsigned long end,
+			     struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->vma;
+
+	if (vma->vm_flags & (VM_IO | VM_PFNMAP))
+		return 1;
+	if (is_vm_hugetlb_page(vma))
+		return 1;
+
+	return 0;
+}
+
+static const struct mm_walk_ops lru_gen_walk_ops = {
+	.pmd_entry = lru_gen_pmd_entry,
+	.test_walk = lru_gen_test_walk,
+};
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct lru_gen_walk *priv)
+{
+	struct vm_area_struct *vma;
+
+	if (!mmap_read_trylock(mm)) {
+		/* Try again in the next pass */
+		WRITE_ONCE(mm->lru_gen.active, true);
+		priv->nr_mm_skipped++;
+		return;
+	}
+
+	mm->lru_gen.walked = priv->seq;
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		walk_page_vma(vma, &lru_gen_walk_ops, priv);
+		/* Do not hold up page faults and mmap() for the aging */
+		if (mmap_lock_is_contended(mm)) {
+			WRITE_ONCE(mm->lru_gen.active, true);
+			break;
+		}
+	}
+	mmap_read_unlock(mm);
+	priv->nr_mm++;
+}
+
+/* Returns the next mm to walk in the current pass with a reference held */
+static struct mm_struct *lru_gen_next_mm(unsigned long seq)
+{
+	struct mm_struct *mm, *found = NULL;
+
+	spin_lock(&lru_gen_mm_lock);
+	while (!list_empty(&lru_gen_mm_list)) {
+		mm = list_first_entry(&lru_gen_mm_list, struct mm_struct,
+				      lru_gen.list);
+		/* Wrapped around, every mm has been looked at */
+		if (mm->lru_gen.seq == seq)
+			break;
+
+		mm->lru_gen.seq = seq;
+		list_move_tail(&mm->lru_gen.list, &lru_gen_mm_list);
+
+		/*
+		 * Nothing can have been accessed since the last walk, but
+		 * the stamps it left still have to be aged before they alias.
+		 */
+		if (!READ_ONCE(mm->lru_gen.active) &&
+		    seq - mm->lru_gen.walked < MAX_NR_GENS - MIN_NR_GENS)
+			continue;
+
+		if (mmget_not_zero(mm)) {
+			WRITE_ONCE(mm->lru_gen.active, false);
+			found = mm;
+			break;
+		}
+	}
+	spin_unlock(&lru_gen_mm_lock);
+
+	return found;
+}
+
+static void __lru_gen_age(void)
+{
+	struct lru_gen_walk priv = {};
+	unsigned long seq = lru_gen_seq;
+	struct mm_struct *mm;
+
+	priv.seq = seq;
+	priv.gen = seq % MAX_NR_GENS;
+
+	while ((mm = lru_gen_next_mm(seq))) {
+		lru_gen_walk_mm(mm, &priv);
+		/* Called from reclaim, leave the teardown to a worker */
+		mmput_async(mm);
+	}
+
+	lru_gen_last_walk = priv;
+	lru_gen_last_age = jiffies;
+	WRITE_ONCE(lru_gen_seq, seq + 1);
+}
+
+/**
+ * lru_gen_age - run an aging pass
+ * @force: ignore the min_interval_ms rate limit
+ *
+ * Does nothing if aging is disabled or another pass is already in progress.
+ */
+void lru_gen_age(bool force)
+{
+	if (!lru_gen_enabled())
+		return;
+
+	if (!force && time_before(jiffies, lru_gen_last_age +
+			msecs_to_jiffies(READ_ONCE(lru_gen_min_interval_ms))))
+		return;
+
+	if (!mutex_trylock(&lru_gen_age_mutex))
+		return;
+
+	__lru_gen_age();
+	mutex_unlock(&lru_gen_age_mutex);
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%d\n", lru_gen_enabled());
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	if (enable)
+		static_branch_enable(&lru_gen_enabled_key);
+	else
+		static_branch_disable(&lru_gen_enabled_key);
+
+	return count;
+}
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, 0644, enabled_show, enabled_store);
+
+static ssize_t min_interval_ms_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(lru_gen_min_interval_ms));
+}
+
+static ssize_t min_interval_ms_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	unsigned int msecs;
+	int err;
+
+	err = kstrtouint(buf, 10, &msecs);
+	if (err)
+		return err;
+
+	WRITE_ONCE(lru_gen_min_interval_ms, msecs);
+
+	return count;
+}
+static struct kobj_attribute min_interval_ms_attr =
+	__ATTR(min_interval_ms, 0644, min_interval_ms_show,
+	       min_interval_ms_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&enabled_attr.attr,
+	&min_interval_ms_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+	.name = "lru_gen",
+};
+
+static int __init lru_gen_init_sysfs(void)
+{
+	int err;
+
+	err = sysfs_create_group(mm_kobj, &lru_gen_attr_group);
+	if (err)
+		pr_err("lru_gen: register sysfs failed\n");
+
+	return err;
+}
+#else
+static inline int lru_gen_init_sysfs(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_DEBUG_FS
+static int lru_gen_debugfs_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&lru_gen_age_mutex);
+	seq_printf(m, "seq %lu\n", lru_gen_seq);
+	seq_printf(m, "mm_walked %lu\n", lru_gen_last_walk.nr_mm);
+	seq_printf(m, "mm_skipped %lu\n", lru_gen_last_walk.nr_mm_skipped);
+	seq_printf(m, "pte_scanned %lu\n", lru_gen_last_walk.nr_scanned);
+	seq_printf(m, "pte_young %lu\n", lru_gen_last_walk.nr_young);
+	mutex_unlock(&lru_gen_age_mutex);
+
+	return 0;
+}
+
+static int lru_gen_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_debugfs_show, NULL);
+}
+
+/* Writing "age" runs a pass right away, regardless of the rate limit */
+static ssize_t lru_gen_debugfs_write(struct file *file, const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	char buf[8];
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (!sysfs_streq(buf, "age"))
+		return -EINVAL;
+	if (!lru_gen_enabled())
+		return -EPERM;
+
+	lru_gen_age(true);
+
+	return count;
+}
+
+static const struct file_operations lru_gen_debugfs_fops = {
+	.open		= lru_gen_debugfs_open,
+	.read		= seq_read,
+	.write		= lru_gen_debugfs_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init lru_gen_init_debugfs(void)
+{
+	debugfs_create_file("lru_gen", 0600, NULL, NULL,
+			    &lru_gen_debugfs_fops);
+}
+#else
+static inline void lru_gen_init_debugfs(void)
+{
+}
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init lru_gen_init(void)
+{
+	lru_gen_init_debugfs();
+
+	return lru_gen_init_sysfs();
+}
+subsys_initcall(lru_gen_init);
@@ -20,6 +20,7 @@
 #include <linux/sched/mm.h>
 #include <linux/uio.h>
 #include <linux/ksm.h>
+#include <linux/khugepaged.h>
 #include <linux/fs.h>
 #include <linux/file.h>
 #include <linux/blkdev.h>
@@ -55,6 +56,7 @@ static int madvise_need_mmap_write(int behavior)
 	case MADV_FREE:
 	case MADV_POPULATE_READ:
 	case MADV_POPULATE_WRITE:
+	case MADV_COLLAPSE:
 		return 0;
 	default:
 		/* be safe, default to 1. list exceptions explicitly */
@@ -138,7 +140,7 @@ static long madvise_behavior(struct vm_area_struct *vma,
 	pgoff = vma->vm_pgoff + ((start - vma->vm_start) >> PAGE_SHIFT);
 	*prev = vma_merge(mm, *prev, start, end, new_flags, vma->anon_vma,
 			  vma->vm_file, pgoff, vma_policy(vma),
-			  vma->vm_userfaultfd_ctx);
+			  vma->vm_userfaultfd_ctx, vma->vm_fault_around);
 	if (*prev) {
 		vma = *prev;
 		goto success;
@@ -170,6 +172,7 @@ static long madvise_behavior(struct vm_area_struct *vma,
 	/*
 	 * vm_flags is protected by the mmap_lock held in write mode.
 	 */
+	vma_start_write(vma);
 	vma->vm_flags = new_flags;
 
 out_convert_errno:
@@ -183,6 +186,62 @@ static long madvise_behavior(struct vm_area_struct *vma,
 	return error;
 }
 
+/*
+ * Returns the window MADV_FAULTAROUND asks for in pages, or 0 if the size
+ * encoded above MADV_FAULTAROUND_SHIFT is not valid.
+ */
+static unsigned int madvise_fault_around_pages(int behavior)
+{
+	unsigned int shift = (unsigned int)behavior >> MADV_FAULTAROUND_SHIFT;
+
+	if ((behavior & ((1 << MADV_FAULTAROUND_SHIFT) - 1)) != MADV_FAULTAROUND)
+		return 0;
+	if (!shift)
+		return fault_around_default_pages();
+	/* The window has to fit into one page table, see do_fault_around() */
+	if (shift < PAGE_SHIFT || shift > PAGE_SHIFT + ilog2(PTRS_PER_PTE))
+		return 0;
+	return 1U << (shift - PAGE_SHIFT);
+}
+
+static long madvise_fault_around(struct vm_area_struct *vma,
+				 struct vm_area_struct **prev,
+				 unsigned long start, unsigned long end,
+				 int behavior)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned int nr_pages = 1;
+	int error;
+
+	if (behavior != MADV_NOFAULTAROUND)
+		nr_pages = madvise_fault_around_pages(behavior);
+
+	*prev = vma;
+	if (vma->vm_fault_around == nr_pages)
+		return 0;
+
+	if (start != vma->vm_start) {
+		if (unlikely(mm->map_count >= sysctl_max_map_count))
+			return -ENOMEM;
+		error = __split_vma(mm, vma, start, 1);
+		if (error)
+			return error == -ENOMEM ? -EAGAIN : error;
+	}
+
+	if (end != vma->vm_end) {
+		if (unlikely(mm->map_count >= sysctl_max_map_count))
+			return -ENOMEM;
+		error = __split_vma(mm, vma, end, 0);
+		if (error)
+			return error == -ENOMEM ? -EAGAIN : error;
+	}
+
+	/* Read by page faults under the vma lock, see vma_fault_around_pages() */
+	vma_start_write(vma);
+	WRITE_ONCE(vma->vm_fault_around, nr_pages);
+	return 0;
+}
+
 #ifdef CONFIG_SWAP
 static int swapin_walk_pmd_entry(pmd_t *pmd, unsigned long start,
 	unsigned long end, struct mm_walk *walk)
@@ -392,6 +451,9 @@ static int madvise_cold_or_pageout_pte_range(pmd_t *pmd,
 	if (pmd_trans_unstable(pmd))
 		return 0;
 #endif
+	/* Shared with a forked mm, the ptes cannot be aged for one of them */
+	if (pmd_pte_table_shared(pmd))
+		return 0;
 	tlb_change_page_size(tlb, PAGE_SIZE);
 	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
 	flush_tlb_batched_pending(mm);
@@ -589,6 +651,10 @@ static int madvise_free_pte_range(pmd_t *pmd, unsigned long addr,
 	if (pmd_trans_unstable(pmd))
 		return 0;
 
+	if (pmd_pte_table_shared(pmd) &&
+	    unshare_pte_table(vma, pmd, addr, 0))
+		return 0;
+
 	tlb_change_page_size(tlb, PAGE_SIZE);
 	orig_pte = pte = pte_offset_map_lock(mm, pmd, addr, &ptl);
 	flush_tlb_batched_pending(mm);
@@ -999,7 +1065,14 @@ madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
 	case MADV_POPULATE_READ:
 	case MADV_POPULATE_WRITE:
 		return madvise_populate(vma, prev, start, end, behavior);
+	case MADV_COLLAPSE:
+		return madvise_collapse(vma, prev, start, end);
+	case MADV_NOFAULTAROUND:
+		return madvise_fault_around(vma, prev, start, end, behavior);
 	default:
+		if (madvise_fault_around_pages(behavior))
+			return madvise_fault_around(vma, prev, start, end,
+						    behavior);
 		return madvise_behavior(vma, prev, start, end, behavior);
 	}
 }
@@ -1028,11 +1101,13 @@ madvise_behavior_valid(int behavior)
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	case MADV_HUGEPAGE:
 	case MADV_NOHUGEPAGE:
+	case MADV_COLLAPSE:
 #endif
 	case MADV_DONTDUMP:
 	case MADV_DODUMP:
 	case MADV_WIPEONFORK:
 	case MADV_KEEPONFORK:
+	case MADV_NOFAULTAROUND:
 #ifdef CONFIG_MEMORY_FAILURE
 	case MADV_SOFT_OFFLINE:
 	case MADV_HWPOISON:
@@ -1040,7 +1115,8 @@ madvise_behavior_valid(int behavior)
 		return true;
 
 	default:
-		return false;
+		/* MADV_FAULTAROUND with the window size encoded */
+		return madvise_fault_around_pages(behavior) != 0;
 	}
 }
 
@@ -1051,6 +1127,7 @@ process_madvise_behavior_valid(int behavior)
 	case MADV_COLD:
 	case MADV_PAGEOUT:
 	case MADV_WILLNEED:
+	case MADV_COLLAPSE:
 		return true;
 	default:
 		return false;
@@ -1113,6 +1190,8 @@ process_madvise_behavior_valid(int behavior)
  *		triggering read faults if required
  *  MADV_POPULATE_WRITE - populate (prefault) page tables writable by
  *		triggering write faults if required
+ *  MADV_COLLAPSE - synchronously collapse the given range into transparent
+ *		huge pages, regardless of the khugepaged scan settings.
  *
  * return values:
  *  zero    - success
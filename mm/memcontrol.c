@@ -62,6 +62,8 @@
 #include <linux/tracehook.h>
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
+#include <linux/parser.h>
+#include <linux/zswap.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -86,6 +88,9 @@ static bool cgroup_memory_nosocket __ro_after_init;
 /* Kernel memory accounting disabled? */
 bool cgroup_memory_nokmem __ro_after_init;
 
+/* Keep LRU pages charged to offlined memcgs? */
+static bool cgroup_memory_noreparent __ro_after_init;
+
 /* Whether the swap controller is active */
 #ifdef CONFIG_MEMCG_SWAP
 bool cgroup_memory_noswap __ro_after_init;
@@ -640,61 +645,99 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
  * 1) Periodically and asynchronously flush the stats every 2 seconds to not let
  *    rstat update tree grow unbounded.
  *
- * 2) Flush the stats synchronously on reader side only when there are more than
- *    (MEMCG_CHARGE_BATCH * nr_cpus) update events. Though this optimization
- *    will let stats be out of sync by atmost (MEMCG_CHARGE_BATCH * nr_cpus) but
- *    only for 2 seconds due to (1).
+ * 2) Count the update events per memcg, propagated to all ancestors in
+ *    batches of MEMCG_CHARGE_BATCH per cpu. A reader flushes only the subtree
+ *    it is about to read and only when that subtree has more than
+ *    (MEMCG_CHARGE_BATCH * nr_cpus) pending update events, so reading a quiet
+ *    cgroup takes no lock at all and readers of unrelated cgroups do not
+ *    flush each other's stats.
+ *
+ * 3) Readers that only need an estimate, like refault detection, use
+ *    mem_cgroup_flush_stats_ratelimited() which reads the cached values
+ *    unless the periodic flush of (1) is overdue, bounding their staleness
+ *    to 2 * FLUSH_TIME.
  */
 static void flush_memcg_stats_dwork(struct work_struct *w);
 static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
 static DEFINE_SPINLOCK(stats_flush_lock);
-static DEFINE_PER_CPU(unsigned int, stats_updates);
-static atomic_t stats_flush_threshold = ATOMIC_INIT(0);
 static u64 flush_next_time;
 
 #define FLUSH_TIME (2UL*HZ)
 
+static bool memcg_vmstats_needs_flush(struct mem_cgroup *memcg)
+{
+	return atomic64_read(&memcg->vmstats.stats_updates) >
+		MEMCG_CHARGE_BATCH * num_online_cpus();
+}
+
 static inline void memcg_rstat_updated(struct mem_cgroup *memcg, int val)
 {
 	unsigned int x;
 
+	if (!val)
+		return;
+
 	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
 
-	x = __this_cpu_add_return(stats_updates, abs(val));
-	if (x > MEMCG_CHARGE_BATCH) {
-		atomic_add(x / MEMCG_CHARGE_BATCH, &stats_flush_threshold);
-		__this_cpu_write(stats_updates, 0);
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		x = __this_cpu_add_return(memcg->vmstats_percpu->stats_updates,
+					  abs(val));
+		if (x < MEMCG_CHARGE_BATCH)
+			continue;
+
+		/* Once the subtree needs a flush, more counting is pointless */
+		if (!memcg_vmstats_needs_flush(memcg))
+			atomic64_add(x, &memcg->vmstats.stats_updates);
+		__this_cpu_write(memcg->vmstats_percpu->stats_updates, 0);
 	}
 }
 
-static void __mem_cgroup_flush_stats(void)
+static void do_flush_stats(struct mem_cgroup *memcg)
 {
 	unsigned long flag;
 
-	if (!spin_trylock_irqsave(&stats_flush_lock, flag))
+	/* Only one flusher of the whole tree, the others use its result */
+	if (mem_cgroup_is_root(memcg)) {
+		if (!spin_trylock_irqsave(&stats_flush_lock, flag))
+			return;
+
+		WRITE_ONCE(flush_next_time, jiffies_64 + 2*FLUSH_TIME);
+		cgroup_rstat_flush_irqsafe(memcg->css.cgroup);
+		spin_unlock_irqrestore(&stats_flush_lock, flag);
 		return;
+	}
 
-	flush_next_time = jiffies_64 + 2*FLUSH_TIME;
-	cgroup_rstat_flush_irqsafe(root_mem_cgroup->css.cgroup);
-	atomic_set(&stats_flush_threshold, 0);
-	spin_unlock_irqrestore(&stats_flush_lock, flag);
+	cgroup_rstat_flush_irqsafe(memcg->css.cgroup);
 }
 
-void mem_cgroup_flush_stats(void)
+/**
+ * mem_cgroup_flush_stats - flush the stats of a memory cgroup subtree
+ * @memcg: root of the subtree to flush, NULL for the whole hierarchy
+ *
+ * Does nothing if the subtree has too few pending updates to matter.
+ */
+void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
 {
-	if (atomic_read(&stats_flush_threshold) > num_online_cpus())
-		__mem_cgroup_flush_stats();
+	if (mem_cgroup_disabled())
+		return;
+
+	if (!memcg)
+		memcg = root_mem_cgroup;
+
+	if (memcg_vmstats_needs_flush(memcg))
+		do_flush_stats(memcg);
 }
 
-void mem_cgroup_flush_stats_delayed(void)
+void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg)
 {
-	if (time_after64(jiffies_64, flush_next_time))
-		mem_cgroup_flush_stats();
+	/* Only flush if the periodic flusher is one full cycle late */
+	if (time_after64(jiffies_64, READ_ONCE(flush_next_time)))
+		mem_cgroup_flush_stats(memcg);
 }
 
 static void flush_memcg_stats_dwork(struct work_struct *w)
 {
-	__mem_cgroup_flush_stats();
+	do_flush_stats(root_mem_cgroup);
 	queue_delayed_work(system_unbound_wq, &stats_flush_dwork, FLUSH_TIME);
 }
 
@@ -1402,6 +1445,10 @@ static const struct memory_stat memory_stats[] = {
 	{ "pagetables",			NR_PAGETABLE			},
 	{ "percpu",			MEMCG_PERCPU_B			},
 	{ "sock",			MEMCG_SOCK			},
+#ifdef CONFIG_ZSWAP
+	{ "zswap",			MEMCG_ZSWAP_B			},
+	{ "zswapped",			MEMCG_ZSWAPPED			},
+#endif
 	{ "shmem",			NR_SHMEM			},
 	{ "file_mapped",		NR_FILE_MAPPED			},
 	{ "file_dirty",			NR_FILE_DIRTY			},
@@ -1437,6 +1484,7 @@ static int memcg_page_state_unit(int item)
 {
 	switch (item) {
 	case MEMCG_PERCPU_B:
+	case MEMCG_ZSWAP_B:
 	case NR_SLAB_RECLAIMABLE_B:
 	case NR_SLAB_UNRECLAIMABLE_B:
 	case WORKINGSET_REFAULT_ANON:
@@ -1479,7 +1527,7 @@ static char *memory_stat_format(struct mem_cgroup *memcg)
 	 *
 	 * Current memory state:
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		u64 size;
@@ -2802,7 +2850,7 @@ static void commit_charge(struct page *page, struct mem_cgroup *memcg)
 	page->memcg_data = (unsigned long)memcg;
 }
 
-static struct mem_cgroup *get_mem_cgroup_from_objcg(struct obj_cgroup *objcg)
+struct mem_cgroup *get_mem_cgroup_from_objcg(struct obj_cgroup *objcg)
 {
 	struct mem_cgroup *memcg;
 
@@ -2907,9 +2955,22 @@ struct mem_cgroup *mem_cgroup_from_obj(void *p)
 	return page_memcg_check(page);
 }
 
-__always_inline struct obj_cgroup *get_obj_cgroup_from_current(void)
+static struct obj_cgroup *__get_obj_cgroup_from_memcg(struct mem_cgroup *memcg)
 {
 	struct obj_cgroup *objcg = NULL;
+
+	for (; memcg != root_mem_cgroup; memcg = parent_mem_cgroup(memcg)) {
+		objcg = rcu_dereference(memcg->objcg);
+		if (objcg && obj_cgroup_tryget(objcg))
+			break;
+		objcg = NULL;
+	}
+	return objcg;
+}
+
+__always_inline struct obj_cgroup *get_obj_cgroup_from_current(void)
+{
+	struct obj_cgroup *objcg;
 	struct mem_cgroup *memcg;
 
 	if (memcg_kmem_bypass())
@@ -2920,13 +2981,35 @@ __always_inline struct obj_cgroup *get_obj_cgroup_from_current(void)
 		memcg = active_memcg();
 	else
 		memcg = mem_cgroup_from_task(current);
+	objcg = __get_obj_cgroup_from_memcg(memcg);
+	rcu_read_unlock();
 
-	for (; memcg != root_mem_cgroup; memcg = parent_mem_cgroup(memcg)) {
-		objcg = rcu_dereference(memcg->objcg);
-		if (objcg && obj_cgroup_tryget(objcg))
-			break;
-		objcg = NULL;
+	return objcg;
+}
+
+/*
+ * Unlike get_obj_cgroup_from_current() this is not bypassed for kernel
+ * threads, reclaim uses it to charge data it keeps on behalf of the owner
+ * of a page it is evicting.
+ */
+struct obj_cgroup *get_obj_cgroup_from_page(struct page *page)
+{
+	struct obj_cgroup *objcg = NULL;
+	struct mem_cgroup *memcg;
+
+	if (!memcg_kmem_enabled())
+		return NULL;
+
+	if (PageMemcgKmem(page)) {
+		objcg = __page_objcg(page);
+		obj_cgroup_get(objcg);
+		return objcg;
 	}
+
+	rcu_read_lock();
+	memcg = __page_memcg(page);
+	if (memcg)
+		objcg = __get_obj_cgroup_from_memcg(memcg);
 	rcu_read_unlock();
 
 	return objcg;
@@ -3572,7 +3655,7 @@ static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	unsigned long val;
 
 	if (mem_cgroup_is_root(memcg)) {
-		mem_cgroup_flush_stats();
+		mem_cgroup_flush_stats(memcg);
 		val = memcg_page_state(memcg, NR_FILE_PAGES) +
 			memcg_page_state(memcg, NR_ANON_MAPPED);
 		if (swap)
@@ -3953,7 +4036,7 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
@@ -4025,7 +4108,7 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
@@ -4528,7 +4611,7 @@ void mem_cgroup_wb_stats(struct bdi_writeback *wb, unsigned long *pfilepages,
 	struct mem_cgroup *memcg = mem_cgroup_from_css(wb->memcg_css);
 	struct mem_cgroup *parent;
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	*pdirty = memcg_page_state(memcg, NR_FILE_DIRTY);
 	*pwriteback = memcg_page_state(memcg, NR_WRITEBACK);
@@ -5167,6 +5250,8 @@ static void mem_cgroup_free(struct mem_cgroup *memcg)
 	__mem_cgroup_free(memcg);
 }
 
+static void reparent_work_func(struct work_struct *work);
+
 static struct mem_cgroup *mem_cgroup_alloc(void)
 {
 	struct mem_cgroup *memcg;
@@ -5203,6 +5288,7 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 		goto fail;
 
 	INIT_WORK(&memcg->high_work, high_work_func);
+	INIT_WORK(&memcg->reparent_work, reparent_work_func);
 	INIT_LIST_HEAD(&memcg->oom_notify);
 	mutex_init(&memcg->thresholds_lock);
 	spin_lock_init(&memcg->move_lock);
@@ -5249,6 +5335,9 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	page_counter_set_high(&memcg->memory, PAGE_COUNTER_MAX);
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	page_counter_set_high(&memcg->swap, PAGE_COUNTER_MAX);
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+	memcg->zswap_max = PAGE_COUNTER_MAX;
+#endif
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
 		memcg->oom_kill_disable = parent->oom_kill_disable;
@@ -5332,6 +5421,16 @@ static void mem_cgroup_css_offline(struct cgroup_subsys_state *css)
 
 	drain_all_stock(memcg);
 
+	/*
+	 * Kernel memory has been reparented above. Move the remaining LRU
+	 * pages as well, so the offlined memcg doesn't stay around as long
+	 * as page cache charged to it is in use.
+	 */
+	if (!cgroup_memory_noreparent && parent_mem_cgroup(memcg)) {
+		css_get(&memcg->css);
+		queue_work(system_unbound_wq, &memcg->reparent_work);
+	}
+
 	mem_cgroup_id_put(memcg);
 }
 
@@ -5404,6 +5503,11 @@ static void mem_cgroup_css_rstat_flush(struct cgroup_subsys_state *css, int cpu)
 
 	statc = per_cpu_ptr(memcg->vmstats_percpu, cpu);
 
+	/* This cpu's updates are folded in below, start counting afresh */
+	statc->stats_updates = 0;
+	if (atomic64_read(&memcg->vmstats.stats_updates))
+		atomic64_set(&memcg->vmstats.stats_updates, 0);
+
 	for (i = 0; i < MEMCG_NR_STAT; i++) {
 		/*
 		 * Collect the aggregated propagation counts of groups
@@ -6181,6 +6285,103 @@ static void mem_cgroup_move_task(void)
 		mem_cgroup_clear_mc();
 	}
 }
+
+#define MEMCG_REPARENT_BATCH	32
+
+/*
+ * Move up to MEMCG_REPARENT_BATCH pages from the tail of @lru of @lruvec to
+ * @parent. Pages which can't be isolated or locked right now stay behind.
+ * Returns the number of base pages moved, *@nr_scanned is increased by the
+ * number of pages looked at.
+ */
+static unsigned long mem_cgroup_reparent_lru_batch(struct mem_cgroup *memcg,
+						   struct mem_cgroup *parent,
+						   struct lruvec *lruvec,
+						   enum lru_list lru,
+						   unsigned long *nr_scanned)
+{
+	struct list_head *src = &lruvec->lists[lru];
+	unsigned long nr_moved = 0;
+	LIST_HEAD(pages);
+	struct page *page, *next;
+	int nr = 0;
+
+	spin_lock_irq(&lruvec->lru_lock);
+	while (!list_empty(src) && nr < MEMCG_REPARENT_BATCH) {
+		page = lru_to_page(src);
+		nr++;
+
+		if (unlikely(!get_page_unless_zero(page))) {
+			list_move(&page->lru, src);
+			continue;
+		}
+		if (!TestClearPageLRU(page)) {
+			/* Another thread is already isolating this page */
+			put_page(page);
+			list_move(&page->lru, src);
+			continue;
+		}
+		del_page_from_lru_list(page, lruvec);
+		list_add(&page->lru, &pages);
+	}
+	spin_unlock_irq(&lruvec->lru_lock);
+	*nr_scanned += nr;
+
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		if (!mem_cgroup_move_account(page, PageTransHuge(page),
+					     memcg, parent))
+			nr_moved += thp_nr_pages(page);
+		/* onto the LRU of whichever memcg the page belongs to now */
+		putback_lru_page(page);
+	}
+	return nr_moved;
+}
+
+/*
+ * Move the pages still on the LRUs of the offlined @memcg to its parent.
+ * The parent's page counters include the charges already, only the local
+ * ones of @memcg are cancelled.
+ */
+static void mem_cgroup_reparent_lru(struct mem_cgroup *memcg)
+{
+	struct mem_cgroup *parent = parent_mem_cgroup(memcg);
+	unsigned long nr_moved = 0;
+	enum lru_list lru;
+	int nid;
+
+	lru_add_drain_all();
+	/* see mem_cgroup_move_charge() */
+	atomic_inc(&memcg->moving_account);
+	synchronize_rcu();
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct lruvec *lruvec = mem_cgroup_lruvec(memcg, NODE_DATA(nid));
+
+		for_each_lru(lru) {
+			unsigned long nr_scanned = 0;
+			unsigned long nr_to_scan;
+
+			/* every page gets one chance, failures are put back */
+			nr_to_scan = lruvec_page_state_local(lruvec,
+							     NR_LRU_BASE + lru);
+			while (nr_scanned < nr_to_scan &&
+			       !list_empty(&lruvec->lists[lru])) {
+				nr_moved += mem_cgroup_reparent_lru_batch(memcg,
+						parent, lruvec, lru, &nr_scanned);
+				cond_resched();
+			}
+		}
+	}
+
+	atomic_dec(&memcg->moving_account);
+
+	if (nr_moved) {
+		page_counter_cancel(&memcg->memory, nr_moved);
+		if (do_memsw_account())
+			page_counter_cancel(&memcg->memsw, nr_moved);
+	}
+}
 #else	/* !CONFIG_MMU */
 static int mem_cgroup_can_attach(struct cgroup_taskset *tset)
 {
@@ -6192,8 +6393,20 @@ static void mem_cgroup_cancel_attach(struct cgroup_taskset *tset)
 static void mem_cgroup_move_task(void)
 {
 }
+static void mem_cgroup_reparent_lru(struct mem_cgroup *memcg)
+{
+}
 #endif
 
+static void reparent_work_func(struct work_struct *work)
+{
+	struct mem_cgroup *memcg = container_of(work, struct mem_cgroup,
+						reparent_work);
+
+	mem_cgroup_reparent_lru(memcg);
+	css_put(&memcg->css);
+}
+
 static int seq_puts_memcg_tunable(struct seq_file *m, unsigned long value)
 {
 	if (value == PAGE_COUNTER_MAX)
@@ -6411,7 +6624,7 @@ static int memory_numa_stat_show(struct seq_file *m, void *v)
 	int i;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		int nid;
@@ -6467,6 +6680,132 @@ static ssize_t memory_oom_group_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+enum {
+	MEMORY_RECLAIM_SWAPPINESS = 0,
+	MEMORY_RECLAIM_SWAPPINESS_MAX,
+	MEMORY_RECLAIM_TYPE,
+	MEMORY_RECLAIM_NULL,
+};
+
+static const match_table_t memory_reclaim_tokens = {
+	{ MEMORY_RECLAIM_SWAPPINESS, "swappiness=%d" },
+	{ MEMORY_RECLAIM_SWAPPINESS_MAX, "swappiness=max" },
+	{ MEMORY_RECLAIM_TYPE, "type=%s" },
+	{ MEMORY_RECLAIM_NULL, NULL },
+};
+
+static int memory_reclaim_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+
+	seq_printf(m, "scanned %lu\n",
+		   READ_ONCE(memcg->proactive_reclaim.nr_scanned));
+	seq_printf(m, "reclaimed %lu\n",
+		   READ_ONCE(memcg->proactive_reclaim.nr_reclaimed));
+	seq_printf(m, "time_us %llu\n",
+		   div_u64(READ_ONCE(memcg->proactive_reclaim.time_ns),
+			   NSEC_PER_USEC));
+
+	return 0;
+}
+
+/*
+ * "<size> [swappiness=<0-200>|max] [type=file|anon|all]"
+ *
+ * Reclaim <size> bytes from the cgroup without touching memory.high. The
+ * result of the request is available from reading the file.
+ */
+static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MAX_RECLAIM_RETRIES;
+	unsigned long nr_to_reclaim, nr_reclaimed = 0, nr_scanned = 0;
+	int swappiness, *swappiness_ptr = NULL;
+	substring_t args[MAX_OPT_ARGS];
+	bool may_swap = true;
+	char *start, *opt;
+	u64 start_ns;
+	int err = 0;
+
+	buf = strstrip(buf);
+	start = strsep(&buf, " ");
+	nr_to_reclaim = memparse(start, &opt);
+	if (opt == start || *opt)
+		return -EINVAL;
+	nr_to_reclaim /= PAGE_SIZE;
+
+	while ((opt = strsep(&buf, " ")) != NULL) {
+		if (!*opt)
+			continue;
+
+		switch (match_token(opt, memory_reclaim_tokens, args)) {
+		case MEMORY_RECLAIM_SWAPPINESS:
+			if (match_int(&args[0], &swappiness))
+				return -EINVAL;
+			if (swappiness < 0 || swappiness > 200)
+				return -EINVAL;
+			swappiness_ptr = &swappiness;
+			break;
+		case MEMORY_RECLAIM_SWAPPINESS_MAX:
+			swappiness = SWAPPINESS_ANON_ONLY;
+			swappiness_ptr = &swappiness;
+			break;
+		case MEMORY_RECLAIM_TYPE:
+			if (!strcmp(args[0].from, "file")) {
+				may_swap = false;
+			} else if (!strcmp(args[0].from, "anon")) {
+				swappiness = SWAPPINESS_ANON_ONLY;
+				swappiness_ptr = &swappiness;
+			} else if (strcmp(args[0].from, "all")) {
+				return -EINVAL;
+			}
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	start_ns = ktime_get_ns();
+	while (nr_reclaimed < nr_to_reclaim) {
+		unsigned long batch, reclaimed, scanned = 0;
+
+		if (signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		/*
+		 * This is the final attempt, drain percpu lru caches in the
+		 * hope of introducing more evictable pages.
+		 */
+		if (!nr_retries)
+			lru_add_drain_all();
+
+		/* Reclaim in chunks so a large request does not overshoot */
+		batch = max((nr_to_reclaim - nr_reclaimed) / 4,
+			    (unsigned long)SWAP_CLUSTER_MAX);
+		reclaimed = try_to_free_mem_cgroup_pages_proactive(memcg,
+					min(batch, nr_to_reclaim - nr_reclaimed),
+					GFP_KERNEL, may_swap, swappiness_ptr,
+					&scanned);
+		nr_scanned += scanned;
+		nr_reclaimed += reclaimed;
+
+		if (!reclaimed && !nr_retries--) {
+			err = -EAGAIN;
+			break;
+		}
+	}
+
+	WRITE_ONCE(memcg->proactive_reclaim.nr_scanned, nr_scanned);
+	WRITE_ONCE(memcg->proactive_reclaim.nr_reclaimed, nr_reclaimed);
+	WRITE_ONCE(memcg->proactive_reclaim.time_ns,
+		   ktime_get_ns() - start_ns);
+
+	return err ? err : nbytes;
+}
+
 static struct cftype memory_files[] = {
 	{
 		.name = "current",
@@ -6525,6 +6864,12 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_oom_group_show,
 		.write = memory_oom_group_write,
 	},
+	{
+		.name = "reclaim",
+		.flags = CFTYPE_NS_DELEGATABLE,
+		.seq_show = memory_reclaim_show,
+		.write = memory_reclaim,
+	},
 	{ }	/* terminate */
 };
 
@@ -7114,6 +7459,8 @@ static int __init cgroup_memory(char *s)
 			cgroup_memory_nosocket = true;
 		if (!strcmp(token, "nokmem"))
 			cgroup_memory_nokmem = true;
+		if (!strcmp(token, "noreparent"))
+			cgroup_memory_noreparent = true;
 	}
 	return 1;
 }
@@ -7495,6 +7842,171 @@ static struct cftype memsw_files[] = {
 	{ },	/* terminate */
 };
 
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+/**
+ * obj_cgroup_may_zswap - check if this cgroup can zswap
+ * @objcg: the object cgroup
+ *
+ * Check if the hierarchical zswap limit has been reached.
+ *
+ * This doesn't check for specific headroom, and it is not atomic
+ * either. But with zswap, the size of the allocation is only known
+ * once compression has occurred, and this optimistic pre-check avoids
+ * spending cycles on compression when there is already no room left
+ * or zswap is disabled altogether somewhere in the hierarchy.
+ */
+bool obj_cgroup_may_zswap(struct obj_cgroup *objcg)
+{
+	struct mem_cgroup *memcg, *original_memcg;
+	bool ret = true;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return true;
+
+	original_memcg = get_mem_cgroup_from_objcg(objcg);
+	mem_cgroup_flush_stats(original_memcg);
+	for (memcg = original_memcg; memcg != root_mem_cgroup;
+	     memcg = parent_mem_cgroup(memcg)) {
+		unsigned long max = READ_ONCE(memcg->zswap_max);
+		unsigned long pages;
+
+		if (max == PAGE_COUNTER_MAX)
+			continue;
+		if (max == 0) {
+			ret = false;
+			break;
+		}
+
+		pages = memcg_page_state(memcg, MEMCG_ZSWAP_B) / PAGE_SIZE;
+		if (pages < max)
+			continue;
+		ret = false;
+		break;
+	}
+	mem_cgroup_put(original_memcg);
+	return ret;
+}
+
+/**
+ * obj_cgroup_charge_zswap - charge compression backend memory
+ * @objcg: the object cgroup
+ * @size: size of compressed object
+ *
+ * This forces the charge after obj_cgroup_may_zswap() allowed
+ * compression and storage in zswap for this cgroup to go ahead.
+ */
+void obj_cgroup_charge_zswap(struct obj_cgroup *objcg, size_t size)
+{
+	struct mem_cgroup *memcg;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return;
+
+	VM_WARN_ON_ONCE(!(current->flags & PF_MEMALLOC));
+
+	/* PF_MEMALLOC context, charging must succeed */
+	if (obj_cgroup_charge(objcg, GFP_KERNEL, size))
+		VM_WARN_ON_ONCE(1);
+
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(objcg);
+	mod_memcg_state(memcg, MEMCG_ZSWAP_B, size);
+	mod_memcg_state(memcg, MEMCG_ZSWAPPED, 1);
+	rcu_read_unlock();
+}
+
+/**
+ * obj_cgroup_uncharge_zswap - uncharge compression backend memory
+ * @objcg: the object cgroup
+ * @size: size of compressed object
+ *
+ * Uncharges zswap memory on page in.
+ */
+void obj_cgroup_uncharge_zswap(struct obj_cgroup *objcg, size_t size)
+{
+	struct mem_cgroup *memcg;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return;
+
+	obj_cgroup_uncharge(objcg, size);
+
+	rcu_read_lock();
+	memcg = obj_cgroup_memcg(objcg);
+	mod_memcg_state(memcg, MEMCG_ZSWAP_B, -size);
+	mod_memcg_state(memcg, MEMCG_ZSWAPPED, -1);
+	rcu_read_unlock();
+}
+
+static u64 zswap_current_read(struct cgroup_subsys_state *css,
+			      struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	mem_cgroup_flush_stats(memcg);
+	return memcg_page_state(memcg, MEMCG_ZSWAP_B);
+}
+
+static int zswap_max_show(struct seq_file *m, void *v)
+{
+	return seq_puts_memcg_tunable(m,
+		READ_ONCE(mem_cgroup_from_seq(m)->zswap_max));
+}
+
+static ssize_t zswap_max_write(struct kernfs_open_file *of,
+			       char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MAX_RECLAIM_RETRIES;
+	unsigned long max;
+	int err;
+
+	buf = strstrip(buf);
+	err = page_counter_memparse(buf, "max", &max);
+	if (err)
+		return err;
+
+	xchg(&memcg->zswap_max, max);
+
+	/*
+	 * Write the excess back to swap right away, like memory.max does
+	 * with reclaim, instead of leaving it to the next stores to find.
+	 */
+	for (;;) {
+		unsigned long nr_pages;
+
+		if (signal_pending(current))
+			break;
+
+		mem_cgroup_flush_stats(memcg);
+		nr_pages = memcg_page_state(memcg, MEMCG_ZSWAP_B) / PAGE_SIZE;
+		if (nr_pages <= max)
+			break;
+
+		if (!zswap_writeback_memcg(memcg, nr_pages - max) &&
+		    !nr_retries--)
+			break;
+	}
+
+	return nbytes;
+}
+
+static struct cftype zswap_files[] = {
+	{
+		.name = "zswap.current",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = zswap_current_read,
+	},
+	{
+		.name = "zswap.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = zswap_max_show,
+		.write = zswap_max_write,
+	},
+	{ }	/* terminate */
+};
+#endif /* CONFIG_MEMCG_KMEM && CONFIG_ZSWAP */
+
 /*
  * If mem_cgroup_swap_init() is implemented as a subsys_initcall()
  * instead of a core_initcall(), this could mean cgroup_memory_noswap still
@@ -7513,6 +8025,9 @@ static int __init mem_cgroup_swap_init(void)
 
 	WARN_ON(cgroup_add_dfl_cftypes(&memory_cgrp_subsys, swap_files));
 	WARN_ON(cgroup_add_legacy_cftypes(&memory_cgrp_subsys, memsw_files));
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+	WARN_ON(cgroup_add_dfl_cftypes(&memory_cgrp_subsys, zswap_files));
+#endif
 
 	return 0;
 }
@@ -44,6 +44,7 @@
 #include <linux/sched/mm.h>
 #include <linux/sched/coredump.h>
 #include <linux/sched/numa_balancing.h>
+#include <linux/sched/sysctl.h>
 #include <linux/sched/task.h>
 #include <linux/hugetlb.h>
 #include <linux/mman.h>
@@ -69,6 +70,7 @@
 #include <linux/userfaultfd_k.h>
 #include <linux/dax.h>
 #include <linux/oom.h>
+#include <linux/node.h>
 #include <linux/numa.h>
 #include <linux/perf_event.h>
 #include <linux/ptrace.h>
@@ -1123,6 +1125,172 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	return ret;
 }
 
+#ifdef CONFIG_FORK_SHARED_PTES
+/*
+ * Map the pte table of @src_pmd into the child at @dst_pmd instead of copying
+ * it. The parent's ptes are write protected as copy_present_pte() would do,
+ * and whichever mm faults into the table first gets its own copy from
+ * unshare_pte_table(). Tables holding anything that needs more than a pte
+ * copy on fork, i.e. swap and migration entries, KSM and pinned pages, are
+ * left to copy_pte_range().
+ *
+ * Returns true if the table is now shared.
+ */
+static bool share_pte_table(struct vm_area_struct *dst_vma,
+			    struct vm_area_struct *src_vma, pmd_t *dst_pmd,
+			    pmd_t *src_pmd, unsigned long addr,
+			    unsigned long end)
+{
+	struct mm_struct *dst_mm = dst_vma->vm_mm;
+	struct mm_struct *src_mm = src_vma->vm_mm;
+	pgtable_t table = pmd_pgtable(*src_pmd);
+	pte_t *orig_pte, *pte;
+	unsigned long pte_addr;
+	int rss[NR_MM_COUNTERS];
+	spinlock_t *ptl;
+
+	/* The ptl has to live in the table to be shared with it */
+	if (!USE_SPLIT_PTE_PTLOCKS)
+		return false;
+	if (!test_bit(MMF_FORK_SHARED_PTES, &src_mm->flags))
+		return false;
+	if (!vma_is_anonymous(src_vma) || (src_vma->vm_flags & VM_SHARED) ||
+	    userfaultfd_armed(src_vma))
+		return false;
+	if ((addr & ~PMD_MASK) || end - addr != PMD_SIZE)
+		return false;
+
+	init_rss_vec(rss);
+	orig_pte = pte = pte_offset_map_lock(src_mm, src_pmd, addr, &ptl);
+	for (pte_addr = addr; pte_addr != end; pte++, pte_addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct page *page;
+
+		if (pte_none(ptent))
+			continue;
+		if (!pte_present(ptent))
+			goto fallback;
+
+		page = vm_normal_page(src_vma, pte_addr, ptent);
+		if (!page) {
+			if (!is_zero_pfn(pte_pfn(ptent)))
+				goto fallback;
+			continue;
+		}
+		if (PageKsm(page) || page_needs_cow_for_dma(src_vma, page))
+			goto fallback;
+		rss[mm_counter(page)]++;
+	}
+
+	pte = orig_pte;
+	for (pte_addr = addr; pte_addr != end; pte++, pte_addr += PAGE_SIZE) {
+		if (pte_present(*pte) && pte_write(*pte))
+			ptep_set_wrprotect(src_mm, pte_addr, pte);
+	}
+	atomic_inc(&table->pt_share_count);
+	pte_unmap_unlock(orig_pte, ptl);
+
+	/* The parent tlb is flushed by dup_mmap() */
+	pmd_populate(dst_mm, dst_pmd, table);
+	mm_inc_nr_ptes(dst_mm);
+	add_mm_rss_vec(dst_mm, rss);
+	return true;
+
+fallback:
+	pte_unmap_unlock(orig_pte, ptl);
+	return false;
+}
+
+/**
+ * unshare_pte_table - give an mm its own copy of a shared pte table
+ * @vma: the vma that is about to modify the table
+ * @pmd: the pmd mapping the table in @vma's mm
+ * @addr: an address covered by @pmd
+ * @gfp: extra allocation flags, __GFP_NOFAIL for callers that cannot fail
+ *
+ * Copies the table shared by share_pte_table() and takes the page references
+ * and mapcounts the copy needs, as fork would have. Does nothing if the
+ * table stopped being shared in the meantime.
+ *
+ * Return: 0 on success, -ENOMEM if the new table could not be allocated.
+ */
+int unshare_pte_table(struct vm_area_struct *vma, pmd_t *pmd,
+		      unsigned long addr, gfp_t gfp)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	pte_t *orig_src_pte, *src_pte, *dst_pte;
+	pgtable_t table, new;
+	spinlock_t *pml, *ptl;
+	struct mmu_gather tlb;
+	unsigned long end;
+
+	new = __pte_alloc_one(mm, GFP_PGTABLE_USER | gfp);
+	if (!new)
+		return -ENOMEM;
+
+	addr &= PMD_MASK;
+	end = addr + PMD_SIZE;
+	tlb_gather_mmu(&tlb, mm);
+	pml = pmd_lock(mm, pmd);
+	if (!pmd_pte_table_shared(pmd)) {
+		spin_unlock(pml);
+		goto out;
+	}
+	/* Serializes with the other sharers, the ptl lives in the table */
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+	if (!pmd_pte_table_shared(pmd))
+		goto out_unlock;
+
+	table = pmd_pgtable(*pmd);
+	orig_src_pte = src_pte = pte_offset_map(pmd, addr);
+	dst_pte = (pte_t *)page_address(new);
+	for (; addr != end; src_pte++, dst_pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *src_pte;
+		struct page *page;
+
+		if (pte_none(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (page) {
+			get_page(page);
+			page_dup_rmap(page, false);
+		}
+		set_pte_at(mm, addr, dst_pte, ptent);
+	}
+	pte_unmap(orig_src_pte);
+
+	/* The copy has to be visible before the pmd points to it */
+	smp_wmb();
+	pmd_populate(mm, pmd, new);
+	new = NULL;
+
+	/* No cpu may walk the old table on behalf of this mm any more */
+	tlb.freed_tables = 1;
+	tlb_flush_pmd_range(&tlb, end - PMD_SIZE, PMD_SIZE);
+	tlb_flush_mmu_tlbonly(&tlb);
+	atomic_dec(&table->pt_share_count);
+
+out_unlock:
+	spin_unlock(ptl);
+	spin_unlock(pml);
+out:
+	tlb_finish_mmu(&tlb);
+	if (new)
+		pte_free(mm, new);
+	return 0;
+}
+#else
+static inline bool share_pte_table(struct vm_area_struct *dst_vma,
+				   struct vm_area_struct *src_vma,
+				   pmd_t *dst_pmd, pmd_t *src_pmd,
+				   unsigned long addr, unsigned long end)
+{
+	return false;
+}
+#endif /* CONFIG_FORK_SHARED_PTES */
+
 static inline int
 copy_pmd_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	       pud_t *dst_pud, pud_t *src_pud, unsigned long addr,
@@ -1153,6 +1321,9 @@ copy_pmd_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 		}
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (share_pte_table(dst_vma, src_vma, dst_pmd, src_pmd,
+				    addr, next))
+			continue;
 		if (copy_pte_range(dst_vma, src_vma, dst_pmd, src_pmd,
 				   addr, next))
 			return -ENOMEM;
@@ -1245,7 +1416,8 @@ copy_page_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
 		return 0;
 
 	if (is_vm_hugetlb_page(src_vma))
-		return copy_hugetlb_page_range(dst_mm, src_mm, src_vma);
+		return copy_hugetlb_page_range(dst_mm, src_mm, dst_vma,
+					       src_vma);
 
 	if (unlikely(src_vma->vm_flags & VM_PFNMAP)) {
 		/*
@@ -1453,6 +1625,73 @@ static unsigned long zap_pte_range(struct mmu_gather *tlb,
 	return addr;
 }
 
+#ifdef CONFIG_FORK_SHARED_PTES
+/*
+ * Unmap a whole pte table shared with another mm by only dropping this mm's
+ * reference to it, the pages stay with the remaining sharers.
+ *
+ * Returns false if the table turned out not to be shared anymore.
+ */
+static bool zap_shared_pte_table(struct mmu_gather *tlb,
+				 struct vm_area_struct *vma, pmd_t *pmd,
+				 unsigned long addr)
+{
+	struct mm_struct *mm = tlb->mm;
+	unsigned long end = addr + PMD_SIZE;
+	int rss[NR_MM_COUNTERS];
+	spinlock_t *pml, *ptl;
+	pte_t *orig_pte, *pte;
+	pgtable_t table;
+
+	pml = pmd_lock(mm, pmd);
+	if (!pmd_pte_table_shared(pmd)) {
+		spin_unlock(pml);
+		return false;
+	}
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock_nested(ptl, SINGLE_DEPTH_NESTING);
+	if (!pmd_pte_table_shared(pmd)) {
+		spin_unlock(ptl);
+		spin_unlock(pml);
+		return false;
+	}
+
+	init_rss_vec(rss);
+	table = pmd_pgtable(*pmd);
+	orig_pte = pte = pte_offset_map(pmd, addr);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte))
+			continue;
+		page = vm_normal_page(vma, addr, *pte);
+		if (page)
+			rss[mm_counter(page)]--;
+	}
+	pte_unmap(orig_pte);
+
+	pmd_clear(pmd);
+	/* The table may be freed by the last sharer once we let go of it */
+	tlb->freed_tables = 1;
+	tlb_flush_pmd_range(tlb, end - PMD_SIZE, PMD_SIZE);
+	tlb_flush_mmu_tlbonly(tlb);
+	atomic_dec(&table->pt_share_count);
+	spin_unlock(ptl);
+	spin_unlock(pml);
+
+	add_mm_rss_vec(mm, rss);
+	mm_dec_nr_ptes(mm);
+	return true;
+}
+#else
+static inline bool zap_shared_pte_table(struct mmu_gather *tlb,
+					struct vm_area_struct *vma, pmd_t *pmd,
+					unsigned long addr)
+{
+	return false;
+}
+#endif /* CONFIG_FORK_SHARED_PTES */
+
 static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 				struct vm_area_struct *vma, pud_t *pud,
 				unsigned long addr, unsigned long end,
@@ -1491,6 +1730,22 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		 */
 		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			goto next;
+		if (unlikely(pmd_pte_table_shared(pmd))) {
+			/*
+			 * Exit and the oom reaper (MMF_UNSTABLE) tear down the
+			 * whole mm and must not allocate: drop its reference
+			 * to the table, the rest of the range goes with it.
+			 */
+			if ((next - addr == PMD_SIZE || tlb->fullmm ||
+			     test_bit(MMF_UNSTABLE, &tlb->mm->flags)) &&
+			    zap_shared_pte_table(tlb, vma, pmd, addr & PMD_MASK))
+				goto next;
+			/*
+			 * Only a partial munmap() or MADV_DONTNEED of a live
+			 * mm gets here; it needs its own copy and can sleep.
+			 */
+			unshare_pte_table(vma, pmd, addr, __GFP_NOFAIL);
+		}
 		next = zap_pte_range(tlb, vma, pmd, addr, next, details);
 next:
 		cond_resched();
@@ -3504,6 +3759,12 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	if (!pte_unmap_same(vma->vm_mm, vmf->pmd, vmf->pte, vmf->orig_pte))
 		goto out;
 
+	/* Waiting for the page may drop mmap_lock, which we do not hold */
+	if (vmf->flags & FAULT_FLAG_VMA_LOCK) {
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
+
 	entry = pte_to_swp_entry(vmf->orig_pte);
 	if (unlikely(non_swap_entry(entry))) {
 		if (is_migration_entry(entry)) {
@@ -3720,6 +3981,162 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	return ret;
 }
 
+static unsigned long fault_around_bytes __read_mostly =
+	rounddown_pow_of_two(65536);
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+/*
+ * fault_around_bytes must be rounded down to the nearest page order as it's
+ * what do_fault_around() expects to see.
+ */
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	debugfs_create_file_unsafe("fault_around_bytes", 0644, NULL, NULL,
+				   &fault_around_bytes_fops);
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+unsigned int fault_around_default_pages(void)
+{
+	return READ_ONCE(fault_around_bytes) >> PAGE_SHIFT;
+}
+
+/*
+ * The fault-around window of @vma in pages, as set by MADV_[NO]FAULTAROUND
+ * or the fault_around_bytes default. Anonymous memory is only faulted around
+ * when the window was set explicitly.
+ */
+static inline unsigned long vma_fault_around_pages(struct vm_area_struct *vma)
+{
+	unsigned int nr_pages = READ_ONCE(vma->vm_fault_around);
+
+	return nr_pages ? nr_pages : fault_around_default_pages();
+}
+
+/* Bounds the pages allocated ahead of an anonymous write fault */
+#define ANON_FAULT_AROUND_MAX_PAGES	(SZ_64K >> PAGE_SHIFT)
+
+/*
+ * do_anon_fault_around() maps zeroed pages next to an anonymous write fault,
+ * for VMAs that asked for it with MADV_FAULTAROUND. Short-lived processes
+ * touching their heap sequentially take one fault per window instead of one
+ * per page.
+ *
+ * It is called after the faulting page has been mapped, with the page table
+ * lock dropped. Entries found populated are left alone, both before the pages
+ * are allocated and again once they are about to be mapped. The pages are
+ * allocated without direct reclaim: fault-around is only worth it when memory
+ * is readily available.
+ *
+ * Without multi-page anonymous folios every page of the window is a separate
+ * order-0 page, which keeps reclaim, migration and COW unchanged.
+ */
+static void do_anon_fault_around(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	struct mm_struct *mm = vma->vm_mm;
+	struct page *pages[ANON_FAULT_AROUND_MAX_PAGES] = { NULL };
+	gfp_t gfp = (GFP_HIGHUSER_MOVABLE & ~__GFP_DIRECT_RECLAIM) |
+		    __GFP_NOWARN;
+	unsigned long nr_pages, start, end, addr;
+	int i, nr, nr_mapped = 0;
+	spinlock_t *ptl;
+	pte_t *pte;
+
+	nr_pages = min_t(unsigned long, READ_ONCE(vma->vm_fault_around),
+			 ANON_FAULT_AROUND_MAX_PAGES);
+	if (nr_pages <= 1 || userfaultfd_armed(vma))
+		return;
+
+	/* Naturally aligned, so the window never crosses a page table */
+	start = vmf->address & ~(nr_pages * PAGE_SIZE - 1);
+	end = min(start + nr_pages * PAGE_SIZE, vma->vm_end);
+	start = max(start, vma->vm_start);
+	nr = (end - start) >> PAGE_SHIFT;
+
+	count_vm_event(FAULT_AROUND);
+
+	/* Note the holes first, most windows are already populated on refault */
+	pte = pte_offset_map_lock(mm, vmf->pmd, start, &ptl);
+	for (i = 0; i < nr; i++)
+		pages[i] = pte_none(pte[i]) ? ERR_PTR(-ENOENT) : NULL;
+	pte_unmap_unlock(pte, ptl);
+
+	for (i = 0, addr = start; i < nr; i++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pages[i])
+			continue;
+		pages[i] = NULL;
+
+		page = alloc_page_vma(gfp, vma, addr);
+		if (!page)
+			break;
+		if (mem_cgroup_charge(page, mm, GFP_NOWAIT | __GFP_NOWARN)) {
+			put_page(page);
+			break;
+		}
+		clear_user_highpage(page, addr);
+		/* See the comment in do_anonymous_page() */
+		__SetPageUptodate(page);
+		pages[i] = page;
+	}
+	for (; i < nr; i++)
+		pages[i] = NULL;
+
+	pte = pte_offset_map_lock(mm, vmf->pmd, start, &ptl);
+	if (check_stable_address_space(mm))
+		goto unlock;
+	for (i = 0, addr = start; i < nr; i++, addr += PAGE_SIZE) {
+		struct page *page = pages[i];
+		pte_t entry;
+
+		if (!page || !pte_none(pte[i]))
+			continue;
+
+		entry = mk_pte(page, vma->vm_page_prot);
+		if (vma->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, addr, false);
+		lru_cache_add_inactive_or_unevictable(page, vma);
+		set_pte_at(mm, addr, pte + i, entry);
+		/* No need to invalidate - it was non-present before */
+		update_mmu_cache(vma, addr, pte + i);
+		pages[i] = NULL;
+		nr_mapped++;
+	}
+unlock:
+	pte_unmap_unlock(pte, ptl);
+
+	for (i = 0; i < nr; i++)
+		if (pages[i])
+			put_page(pages[i]);
+	count_vm_events(FAULT_AROUND_PAGES, nr_mapped);
+}
+
 /*
  * We enter with non-exclusive mmap_lock (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -3728,6 +4145,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
+	bool fault_around = false;
 	struct page *page;
 	vm_fault_t ret = 0;
 	pte_t entry;
@@ -3819,6 +4237,7 @@ static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 	inc_mm_counter_fast(vma->vm_mm, MM_ANONPAGES);
 	page_add_new_anon_rmap(page, vma, vmf->address, false);
 	lru_cache_add_inactive_or_unevictable(page, vma);
+	fault_around = READ_ONCE(vma->vm_fault_around) > 1;
 setpte:
 	set_pte_at(vma->vm_mm, vmf->address, vmf->pte, entry);
 
@@ -3826,6 +4245,8 @@ static vm_fault_t do_anonymous_page(struct vm_fault *vmf)
 	update_mmu_cache(vma, vmf->address, vmf->pte);
 unlock:
 	pte_unmap_unlock(vmf->pte, vmf->ptl);
+	if (fault_around)
+		do_anon_fault_around(vmf);
 	return ret;
 release:
 	put_page(page);
@@ -4092,42 +4513,6 @@ vm_fault_t finish_fault(struct vm_fault *vmf)
 	return ret;
 }
 
-static unsigned long fault_around_bytes __read_mostly =
-	rounddown_pow_of_two(65536);
-
-#ifdef CONFIG_DEBUG_FS
-static int fault_around_bytes_get(void *data, u64 *val)
-{
-	*val = fault_around_bytes;
-	return 0;
-}
-
-/*
- * fault_around_bytes must be rounded down to the nearest page order as it's
- * what do_fault_around() expects to see.
- */
-static int fault_around_bytes_set(void *data, u64 val)
-{
-	if (val / PAGE_SIZE > PTRS_PER_PTE)
-		return -EINVAL;
-	if (val > PAGE_SIZE)
-		fault_around_bytes = rounddown_pow_of_two(val);
-	else
-		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
-	return 0;
-}
-DEFINE_DEBUGFS_ATTRIBUTE(fault_around_bytes_fops,
-		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
-
-static int __init fault_around_debugfs(void)
-{
-	debugfs_create_file_unsafe("fault_around_bytes", 0644, NULL, NULL,
-				   &fault_around_bytes_fops);
-	return 0;
-}
-late_initcall(fault_around_debugfs);
-#endif
-
 /*
  * do_fault_around() tries to map few pages around the fault address. The hope
  * is that the pages will be needed soon and this will lower the number of
@@ -4143,8 +4528,8 @@ late_initcall(fault_around_debugfs);
  * This function doesn't cross the VMA boundaries, in order to call map_pages()
  * only once.
  *
- * fault_around_bytes defines how many bytes we'll try to map.
- * do_fault_around() expects it to be set to a power of two less than or equal
+ * vma_fault_around_pages() defines how many pages we'll try to map.
+ * do_fault_around() expects it to be a power of two less than or equal
  * to PTRS_PER_PTE.
  *
  * The virtual address of the area that we map is naturally aligned to
@@ -4159,7 +4544,7 @@ static vm_fault_t do_fault_around(struct vm_fault *vmf)
 	pgoff_t end_pgoff;
 	int off;
 
-	nr_pages = READ_ONCE(fault_around_bytes) >> PAGE_SHIFT;
+	nr_pages = vma_fault_around_pages(vmf->vma);
 	mask = ~(nr_pages * PAGE_SIZE - 1) & PAGE_MASK;
 
 	address = max(address & mask, vmf->vma->vm_start);
@@ -4196,11 +4581,15 @@ static vm_fault_t do_read_fault(struct vm_fault *vmf)
 	 * if page by the offset is not ready to be mapped (cold cache or
 	 * something).
 	 */
-	if (vma->vm_ops->map_pages && fault_around_bytes >> PAGE_SHIFT > 1) {
+	if (vma->vm_ops->map_pages && vma_fault_around_pages(vma) > 1) {
 		if (likely(!userfaultfd_minor(vmf->vma))) {
+			count_vm_event(FAULT_AROUND);
 			ret = do_fault_around(vmf);
-			if (ret)
+			if (ret) {
+				if (ret == VM_FAULT_NOPAGE)
+					count_vm_event(FAULT_AROUND_HIT);
 				return ret;
+			}
 		}
 	}
 
@@ -4413,8 +4802,16 @@ static vm_fault_t do_numa_page(struct vm_fault *vmf)
 	if (page_mapcount(page) > 1 && (vma->vm_flags & VM_SHARED))
 		flags |= TNF_SHARED;
 
-	last_cpupid = page_cpupid_last(page);
 	page_nid = page_to_nid(page);
+	/*
+	 * In memory tiering mode, cpupid of slow memory page is used
+	 * to record page access time.  So use default value.
+	 */
+	if ((sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING) &&
+	    !node_is_toptier(page_nid))
+		last_cpupid = (-1 & LAST_CPUPID_MASK);
+	else
+		last_cpupid = page_cpupid_last(page);
 	target_nid = numa_migrate_prep(page, vma, vmf->address, page_nid,
 			&flags);
 	if (target_nid == NUMA_NO_NODE) {
@@ -4726,6 +5123,11 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
 		}
 	}
 
+	/* Anything faulting into a table shared by fork needs its own copy */
+	if (unlikely(pmd_pte_table_shared(vmf.pmd)) &&
+	    unshare_pte_table(vma, vmf.pmd, address, 0))
+		return VM_FAULT_OOM;
+
 	return handle_pte_fault(&vmf);
 }
 
@@ -4844,6 +5246,64 @@ vm_fault_t handle_mm_fault(struct vm_area_struct *vma, unsigned long address,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_PER_VMA_LOCK
+/**
+ * lock_vma_under_rcu - look up and read-lock the VMA of a page fault
+ * @mm: the address space of the fault
+ * @address: the faulting address
+ *
+ * Returns the VMA containing @address read-locked, or NULL if the fault has
+ * to be handled under mmap_lock. Only anonymous VMAs that already have an
+ * anon_vma and no userfaultfd are handled: everything else may need to
+ * drop or to look beyond the VMA, which requires mmap_lock.
+ *
+ * The caller passes FAULT_FLAG_VMA_LOCK to handle_mm_fault() and releases
+ * the VMA with vma_end_read(). VM_FAULT_RETRY means retry under mmap_lock.
+ */
+struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
+					  unsigned long address)
+{
+	struct vm_area_struct *vma;
+
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma)
+		goto inval;
+
+	if (!vma_is_anonymous(vma))
+		goto inval;
+
+	/* anon_vma_prepare() looks at the neighbours, which are not locked */
+	if (!vma->anon_vma)
+		goto inval;
+
+	if (!vma_start_read(vma))
+		goto inval;
+
+	/*
+	 * The lookup raced with a writer, which may have moved the VMA's
+	 * boundaries or removed it before we got the lock.
+	 */
+	if (unlikely(address < vma->vm_start || address >= vma->vm_end ||
+		     vma->detached))
+		goto inval_end_read;
+
+	/* handle_userfault() drops mmap_lock */
+	if (userfaultfd_armed(vma))
+		goto inval_end_read;
+
+	rcu_read_unlock();
+	return vma;
+
+inval_end_read:
+	vma_end_read(vma);
+inval:
+	rcu_read_unlock();
+	count_vm_event(VMA_LOCK_ABORT);
+	return NULL;
+}
+#endif /* CONFIG_PER_VMA_LOCK */
+
 #ifndef __PAGETABLE_P4D_FOLDED
 /*
  * Allocate p4d page table.
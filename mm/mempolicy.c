@@ -769,6 +769,7 @@ static int vma_replace_policy(struct vm_area_struct *vma,
 			goto err_out;
 	}
 
+	vma_start_write(vma);
 	old = vma->vm_policy;
 	vma->vm_policy = new; /* protected by mmap_lock */
 	mpol_put(old);
@@ -808,7 +809,8 @@ static int mbind_range(struct mm_struct *mm, unsigned long start,
 			((vmstart - vma->vm_start) >> PAGE_SHIFT);
 		prev = vma_merge(mm, prev, vmstart, vmend, vma->vm_flags,
 				 vma->anon_vma, vma->vm_file, pgoff,
-				 new_pol, vma->vm_userfaultfd_ctx);
+				 new_pol, vma->vm_userfaultfd_ctx,
+				 vma->vm_fault_around);
 		if (prev) {
 			vma = prev;
 			goto replace;
@@ -20,6 +20,7 @@
 #include <linux/pagemap.h>
 #include <linux/buffer_head.h>
 #include <linux/mm_inline.h>
+#include <linux/node.h>
 #include <linux/nsproxy.h>
 #include <linux/pagevec.h>
 #include <linux/ksm.h>
@@ -50,6 +51,7 @@
 #include <linux/ptrace.h>
 #include <linux/oom.h>
 #include <linux/memory.h>
+#include <linux/sched/sysctl.h>
 
 #include <asm/tlbflush.h>
 
@@ -1065,7 +1067,12 @@ static int __unmap_and_move(struct page *page, struct page *newpage,
 		/* Establish migration ptes */
 		VM_BUG_ON_PAGE(PageAnon(page) && !PageKsm(page) && !anon_vma,
 				page);
-		try_to_migrate(page, 0);
+		/*
+		 * One flush for all the ptes of the page, a PTE-mapped THP
+		 * would otherwise send an IPI for every subpage.
+		 */
+		try_to_migrate(page, TTU_BATCH_FLUSH);
+		try_to_unmap_flush();
 		page_was_mapped = true;
 	}
 
@@ -2121,8 +2128,23 @@ static int numamigrate_isolate_page(pg_data_t *pgdat, struct page *page)
 		return 0;
 
 	/* Avoid migrating to a node that is nearly full */
-	if (!migrate_balanced_pgdat(pgdat, nr_pages))
+	if (!migrate_balanced_pgdat(pgdat, nr_pages)) {
+		int z;
+
+		if (!(sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING))
+			return 0;
+		/*
+		 * Wake kswapd on the fast node so that demotion makes room
+		 * for the next promotion attempt.
+		 */
+		for (z = pgdat->nr_zones - 1; z >= 0; z--) {
+			if (populated_zone(pgdat->node_zones + z))
+				break;
+		}
+		wakeup_kswapd(pgdat->node_zones + z, 0,
+			      compound_order(page), ZONE_MOVABLE);
 		return 0;
+	}
 
 	if (isolate_lru_page(page))
 		return 0;
@@ -2155,6 +2177,7 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 	new_page_t *new;
 	bool compound;
 	int nr_pages = thp_nr_pages(page);
+	int page_nid = page_to_nid(page);
 
 	/*
 	 * PTE mapped THP or HugeTLB page can't reach here so the page could
@@ -2198,8 +2221,12 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 			putback_lru_page(page);
 		}
 		isolated = 0;
-	} else
+	} else {
 		count_vm_numa_events(NUMA_PAGE_MIGRATE, nr_pages);
+		if (!node_is_toptier(page_nid) && node_is_toptier(node))
+			mod_node_page_state(pgdat, PGPROMOTE_SUCCESS,
+					    nr_pages);
+	}
 	BUG_ON(!list_empty(&migratepages));
 	return isolated;
 
@@ -2300,7 +2327,8 @@ static int migrate_vma_collect_pmd(pmd_t *pmdp,
 		}
 	}
 
-	if (unlikely(pmd_bad(*pmdp)))
+	/* A pte table shared by fork can only be migrated once unshared */
+	if (unlikely(pmd_bad(*pmdp)) || pmd_pte_table_shared(pmdp))
 		return migrate_vma_collect_skip(start, end, walk);
 
 	ptep = pte_offset_map_lock(mm, pmdp, addr, &ptl);
@@ -540,6 +540,9 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 			split_huge_pmd(vma, old_pmd, old_addr);
 			if (pmd_trans_unstable(old_pmd))
 				continue;
+		} else if (pmd_pte_table_shared(old_pmd) &&
+			   unshare_pte_table(vma, old_pmd, old_addr, 0)) {
+			break;
 		} else if (IS_ENABLED(CONFIG_HAVE_MOVE_PMD) &&
 			   extent == PMD_SIZE) {
 			/*
@@ -621,6 +624,9 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 		return -ENOMEM;
 	}
 
+	/* Keep faults out of both ends while the page tables move */
+	vma_start_write(vma);
+	vma_start_write(new_vma);
 	moved_len = move_page_tables(vma, old_addr, new_vma, new_addr, old_len,
 				     need_rmap_locks);
 	if (moved_len < old_len) {
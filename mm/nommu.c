@@ -19,7 +19,6 @@
 #include <linux/export.h>
 #include <linux/mm.h>
 #include <linux/sched/mm.h>
-#include <linux/vmacache.h>
 #include <linux/mman.h>
 #include <linux/swap.h>
 #include <linux/file.h>
@@ -616,19 +615,10 @@ static void add_vma_to_mm(struct mm_struct *mm, struct vm_area_struct *vma)
  */
 static void delete_vma_from_mm(struct vm_area_struct *vma)
 {
-	int i;
 	struct address_space *mapping;
 	struct mm_struct *mm = vma->vm_mm;
-	struct task_struct *curr = current;
 
 	mm->map_count--;
-	for (i = 0; i < VMACACHE_SIZE; i++) {
-		/* if the vma is cached, invalidate the entire cache */
-		if (curr->vmacache.vmas[i] == vma) {
-			vmacache_invalidate(mm);
-			break;
-		}
-	}
 
 	/* remove the VMA from the mapping */
 	if (vma->vm_file) {
@@ -668,20 +658,13 @@ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
 {
 	struct vm_area_struct *vma;
 
-	/* check the cache first */
-	vma = vmacache_find(mm, addr);
-	if (likely(vma))
-		return vma;
-
 	/* trawl the list (there may be multiple mappings in which addr
 	 * resides) */
 	for (vma = mm->mmap; vma; vma = vma->vm_next) {
 		if (vma->vm_start > addr)
 			return NULL;
-		if (vma->vm_end > addr) {
-			vmacache_update(addr, vma);
+		if (vma->vm_end > addr)
 			return vma;
-		}
 	}
 
 	return NULL;
@@ -717,11 +700,6 @@ static struct vm_area_struct *find_vma_exact(struct mm_struct *mm,
 	struct vm_area_struct *vma;
 	unsigned long end = addr + len;
 
-	/* check the cache first */
-	vma = vmacache_find_exact(mm, addr, end);
-	if (vma)
-		return vma;
-
 	/* trawl the list (there may be multiple mappings in which addr
 	 * resides) */
 	for (vma = mm->mmap; vma; vma = vma->vm_next) {
@@ -729,10 +707,8 @@ static struct vm_area_struct *find_vma_exact(struct mm_struct *mm,
 			continue;
 		if (vma->vm_start > addr)
 			return NULL;
-		if (vma->vm_end == end) {
-			vmacache_update(addr, vma);
+		if (vma->vm_end == end)
 			return vma;
-		}
 	}
 
 	return NULL;
@@ -72,6 +72,7 @@
 #include <linux/padata.h>
 #include <linux/khugepaged.h>
 #include <linux/buffer_head.h>
+#include <linux/lru_gen.h>
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -183,6 +184,14 @@ unsigned long totalreserve_pages __read_mostly;
 unsigned long totalcma_pages __read_mostly;
 
 int percpu_pagelist_high_fraction;
+
+/*
+ * Per-order limits for the high-order pcp lists, in pages of that order,
+ * indexed by pcp order (order 1 first, the THP order last). Zero means
+ * "derive from the zone's pcp->high and pcp->batch".
+ */
+int sysctl_percpu_pagelist_order_high[NR_PCP_HIGH_ORDERS] __read_mostly;
+int sysctl_percpu_pagelist_order_batch[NR_PCP_HIGH_ORDERS] __read_mostly;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 DEFINE_STATIC_KEY_MAYBE(CONFIG_INIT_ON_ALLOC_DEFAULT_ON, init_on_alloc);
 EXPORT_SYMBOL(init_on_alloc);
@@ -688,6 +697,12 @@ static inline int pindex_to_order(unsigned int pindex)
 	return order;
 }
 
+/* Index of @order's lists in per_cpu_pages::order_nr and the PCP_* events */
+static inline unsigned int order_to_pcp_index(int order)
+{
+	return order_to_pindex(0, order) / MIGRATE_PCPTYPES;
+}
+
 static inline bool pcp_allowed_order(unsigned int order)
 {
 	if (order <= PAGE_ALLOC_COSTLY_ORDER)
@@ -1336,6 +1351,7 @@ static __always_inline bool free_pages_prepare(struct page *page,
 		return false;
 
 	page_cpupid_reset_last(page);
+	page_reset_lru_gen(page);
 	page->flags &= ~PAGE_FLAGS_CHECK_AT_PREP;
 	reset_page_owner(page, order);
 
@@ -1429,9 +1445,10 @@ static inline void prefetch_buddy(struct page *page)
 }
 
 /*
- * Frees a number of pages from the PCP lists
+ * Frees a number of pages from the PCP lists pindex_min..pindex_max
  * Assumes all pages on list are in same zone, and of same order.
- * count is the number of pages to free.
+ * count is the number of pages to free, and must not exceed the number
+ * of pages on those lists.
  *
  * If the zone was previously in an "all pages pinned" state then look to
  * see if this freeing clears that state.
@@ -1439,10 +1456,12 @@ static inline void prefetch_buddy(struct page *page)
  * And clear the zone's pages_scanned counter, to hold off the "all pages are
  * pinned" detection logic.
  */
-static void free_pcppages_bulk(struct zone *zone, int count,
-					struct per_cpu_pages *pcp)
+static void __free_pcppages_bulk(struct zone *zone, int count,
+				 struct per_cpu_pages *pcp,
+				 int pindex_min, int pindex_max)
 {
-	int pindex = 0;
+	int nr_lists = pindex_max - pindex_min + 1;
+	int pindex = pindex_min;
 	int batch_free = 0;
 	int nr_freed = 0;
 	unsigned int order;
@@ -1468,13 +1487,13 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		 */
 		do {
 			batch_free++;
-			if (++pindex == NR_PCP_LISTS)
-				pindex = 0;
+			if (++pindex > pindex_max)
+				pindex = pindex_min;
 			list = &pcp->lists[pindex];
 		} while (list_empty(list));
 
 		/* This is the only non-empty list. Free them all. */
-		if (batch_free == NR_PCP_LISTS)
+		if (batch_free == nr_lists)
 			batch_free = count;
 
 		order = pindex_to_order(pindex);
@@ -1483,6 +1502,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			page = list_last_entry(list, struct page, lru);
 			/* must delete to avoid corrupting pcp list */
 			list_del(&page->lru);
+			pcp->order_nr[pindex / MIGRATE_PCPTYPES]--;
 			nr_freed += 1 << order;
 			count -= 1 << order;
 
@@ -1542,6 +1562,28 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	spin_unlock(&zone->lock);
 }
 
+static void free_pcppages_bulk(struct zone *zone, int count,
+					struct per_cpu_pages *pcp)
+{
+	__free_pcppages_bulk(zone, count, pcp, 0, NR_PCP_LISTS - 1);
+}
+
+/* Free up to @count pages, of @order, from @order's lists only */
+static void free_pcppages_bulk_order(struct zone *zone, int count,
+				     struct per_cpu_pages *pcp,
+				     unsigned int order)
+{
+	unsigned int idx = order_to_pcp_index(order);
+
+	count = min(count, pcp->order_nr[idx]);
+	if (count <= 0)
+		return;
+
+	__free_pcppages_bulk(zone, count << order, pcp,
+			     idx * MIGRATE_PCPTYPES,
+			     idx * MIGRATE_PCPTYPES + MIGRATE_PCPTYPES - 1);
+}
+
 static void free_one_page(struct zone *zone,
 				struct page *page, unsigned long pfn,
 				unsigned int order,
@@ -3363,6 +3405,54 @@ static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone)
 	return min(READ_ONCE(pcp->batch) << 2, high);
 }
 
+/*
+ * Refill/drain chunk for a high-order pcp list, in pages of that order.
+ * Batch can be 1 for small zones or for boot pagesets which should never
+ * store free pages as the pages may belong to arbitrary zones.
+ */
+static int pcp_order_batch(struct per_cpu_pages *pcp, unsigned int order)
+{
+	int batch = READ_ONCE(pcp->batch);
+	int idx = order_to_pcp_index(order) - 1;
+	int order_batch;
+
+	if (batch <= 1)
+		return batch;
+
+	order_batch = READ_ONCE(sysctl_percpu_pagelist_order_batch[idx]);
+	if (order_batch)
+		return order_batch;
+
+	return max(batch >> order, 2);
+}
+
+/*
+ * Number of pages of @order that @order's lists may hold before they are
+ * drained, independently of the order-0 pcp->high. The default scales
+ * pcp->high down so that the high-order lists together hold at most about
+ * as many base pages as the order-0 lists.
+ */
+static int pcp_order_high(struct per_cpu_pages *pcp, struct zone *zone,
+			  unsigned int order)
+{
+	int high = READ_ONCE(pcp->high);
+	int batch = pcp_order_batch(pcp, order);
+	int idx = order_to_pcp_index(order) - 1;
+	int order_high;
+
+	if (unlikely(!high || batch <= 1))
+		return 0;
+
+	if (test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags))
+		return batch;
+
+	order_high = READ_ONCE(sysctl_percpu_pagelist_order_high[idx]);
+	if (order_high)
+		return order_high;
+
+	return max(high >> (order + 2), batch);
+}
+
 static void free_unref_page_commit(struct page *page, unsigned long pfn,
 				   int migratetype, unsigned int order)
 {
@@ -3376,11 +3466,22 @@ static void free_unref_page_commit(struct page *page, unsigned long pfn,
 	pindex = order_to_pindex(migratetype, order);
 	list_add(&page->lru, &pcp->lists[pindex]);
 	pcp->count += 1 << order;
+	pcp->order_nr[pindex / MIGRATE_PCPTYPES]++;
+
+	if (order) {
+		if (pcp->order_nr[pindex / MIGRATE_PCPTYPES] >
+		    pcp_order_high(pcp, zone, order))
+			free_pcppages_bulk_order(zone, pcp_order_batch(pcp, order),
+						 pcp, order);
+		return;
+	}
+
 	high = nr_pcp_high(pcp, zone);
-	if (pcp->count >= high) {
+	if (pcp->order_nr[0] >= high) {
 		int batch = READ_ONCE(pcp->batch);
 
-		free_pcppages_bulk(zone, nr_pcp_free(pcp, high, batch), pcp);
+		free_pcppages_bulk_order(zone, nr_pcp_free(pcp, high, batch),
+					 pcp, 0);
 	}
 }
 
@@ -3605,27 +3706,27 @@ struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
 			struct per_cpu_pages *pcp,
 			struct list_head *list)
 {
+	unsigned int idx = order_to_pcp_index(order);
 	struct page *page;
 
+	BUILD_BUG_ON(PCP_HIT_ORDER0 + NR_PCP_ORDERS != PCP_MISS_ORDER0);
+	if (list_empty(list))
+		__count_vm_event(PCP_MISS_ORDER0 + idx);
+	else
+		__count_vm_event(PCP_HIT_ORDER0 + idx);
+
 	do {
 		if (list_empty(list)) {
-			int batch = READ_ONCE(pcp->batch);
+			int batch = order ? pcp_order_batch(pcp, order) :
+					    READ_ONCE(pcp->batch);
 			int alloced;
 
-			/*
-			 * Scale batch relative to order if batch implies
-			 * free pages can be stored on the PCP. Batch can
-			 * be 1 for small zones or for boot pagesets which
-			 * should never store free pages as the pages may
-			 * belong to arbitrary zones.
-			 */
-			if (batch > 1)
-				batch = max(batch >> order, 2);
 			alloced = rmqueue_bulk(zone, order,
 					batch, list,
 					migratetype, alloc_flags);
 
 			pcp->count += alloced << order;
+			pcp->order_nr[idx] += alloced;
 			if (unlikely(list_empty(list)))
 				return NULL;
 		}
@@ -3633,6 +3734,7 @@ struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
 		page = list_first_entry(list, struct page, lru);
 		list_del(&page->lru);
 		pcp->count -= 1 << order;
+		pcp->order_nr[idx]--;
 	} while (check_new_pcp(page));
 
 	return page;
@@ -4933,6 +5035,10 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 	if (page)
 		goto got_pg;
 
+	/* Tell kcompactd which orders the free lists keep running out of */
+	if (order)
+		compaction_alloc_failed(ac->preferred_zoneref->zone, order);
+
 	/*
 	 * For costly allocations, try direct compaction first, as it's likely
 	 * that we have enough base pages and don't need to reclaim. For non-
@@ -5181,8 +5287,9 @@ static inline bool prepare_alloc_pages(gfp_t gfp_mask, unsigned int order,
 }
 
 /*
- * __alloc_pages_bulk - Allocate a number of order-0 pages to a list or array
+ * __alloc_pages_bulk_order - Allocate a number of pages to a list or array
  * @gfp: GFP flags for the allocation
+ * @order: The order of each allocation
  * @preferred_nid: The preferred NUMA node ID to allocate from
  * @nodemask: Set of nodes to allocate from, may be NULL
  * @nr_pages: The number of pages desired on the list or array
@@ -5198,11 +5305,15 @@ static inline bool prepare_alloc_pages(gfp_t gfp_mask, unsigned int order,
  * For arrays, only NULL elements are populated with pages and nr_pages
  * is the maximum number of pages that will be stored in the array.
  *
+ * Each of the nr_pages allocations is of @order. Orders that are not kept
+ * on the pcp lists fall back to the single page allocator, as do requests
+ * for a single page.
+ *
  * Returns the number of pages on the list or array.
  */
-unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
-			nodemask_t *nodemask, int nr_pages,
-			struct list_head *page_list,
+unsigned long __alloc_pages_bulk_order(gfp_t gfp, unsigned int order,
+			int preferred_nid, nodemask_t *nodemask,
+			int nr_pages, struct list_head *page_list,
 			struct page **page_array)
 {
 	struct page *page;
@@ -5239,6 +5350,10 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 	if (nr_pages - nr_populated == 1)
 		goto failed;
 
+	/* Only the orders cached on the pcp lists can be batched. */
+	if (!pcp_allowed_order(order))
+		goto failed;
+
 #ifdef CONFIG_PAGE_OWNER
 	/*
 	 * PAGE_OWNER may recurse into the allocator to allocate space to
@@ -5254,7 +5369,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 	/* May set ALLOC_NOFRAGMENT, fragmentation will return 1 page. */
 	gfp &= gfp_allowed_mask;
 	alloc_gfp = gfp;
-	if (!prepare_alloc_pages(gfp, 0, preferred_nid, nodemask, &ac, &alloc_gfp, &alloc_flags))
+	if (!prepare_alloc_pages(gfp, order, preferred_nid, nodemask, &ac, &alloc_gfp, &alloc_flags))
 		goto out;
 	gfp = alloc_gfp;
 
@@ -5272,8 +5387,9 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 			goto failed;
 		}
 
-		mark = wmark_pages(zone, alloc_flags & ALLOC_WMARK_MASK) + nr_pages;
-		if (zone_watermark_fast(zone, 0,  mark,
+		mark = wmark_pages(zone, alloc_flags & ALLOC_WMARK_MASK) +
+		       ((unsigned long)nr_pages << order);
+		if (zone_watermark_fast(zone, order, mark,
 				zonelist_zone_idx(ac.preferred_zoneref),
 				alloc_flags, gfp)) {
 			break;
@@ -5290,7 +5406,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 	/* Attempt the batch allocation */
 	local_lock_irqsave(&pagesets.lock, flags);
 	pcp = this_cpu_ptr(zone->per_cpu_pageset);
-	pcp_list = &pcp->lists[order_to_pindex(ac.migratetype, 0)];
+	pcp_list = &pcp->lists[order_to_pindex(ac.migratetype, order)];
 
 	while (nr_populated < nr_pages) {
 
@@ -5300,7 +5416,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 			continue;
 		}
 
-		page = __rmqueue_pcplist(zone, 0, ac.migratetype, alloc_flags,
+		page = __rmqueue_pcplist(zone, order, ac.migratetype, alloc_flags,
 								pcp, pcp_list);
 		if (unlikely(!page)) {
 			/* Try and allocate at least one page */
@@ -5310,7 +5426,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 		}
 		nr_account++;
 
-		prep_new_page(page, 0, gfp, 0);
+		prep_new_page(page, order, gfp, 0);
 		if (page_list)
 			list_add(&page->lru, page_list);
 		else
@@ -5320,7 +5436,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 
 	local_unlock_irqrestore(&pagesets.lock, flags);
 
-	__count_zid_vm_events(PGALLOC, zone_idx(zone), nr_account);
+	__count_zid_vm_events(PGALLOC, zone_idx(zone), nr_account << order);
 	zone_statistics(ac.preferred_zoneref->zone, zone, nr_account);
 
 out:
@@ -5330,7 +5446,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 	local_unlock_irqrestore(&pagesets.lock, flags);
 
 failed:
-	page = __alloc_pages(gfp, 0, preferred_nid, nodemask);
+	page = __alloc_pages(gfp, order, preferred_nid, nodemask);
 	if (page) {
 		if (page_list)
 			list_add(&page->lru, page_list);
@@ -5341,7 +5457,7 @@ unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
 
 	goto out;
 }
-EXPORT_SYMBOL_GPL(__alloc_pages_bulk);
+EXPORT_SYMBOL_GPL(__alloc_pages_bulk_order);
 
 /*
  * This is the 'heart' of the zoned buddy allocator.
@@ -116,6 +116,10 @@ static inline int pcpu_chunk_map_bits(struct pcpu_chunk *chunk)
 #ifdef CONFIG_PERCPU_STATS
 
 #include <linux/spinlock.h>
+#include <linux/sched/clock.h>
+
+/* log2 buckets of the allocation latency in usecs, the last one is open */
+#define PCPU_STATS_LAT_BUCKETS	12
 
 struct percpu_stats {
 	u64 nr_alloc;		/* lifetime # of allocations */
@@ -126,9 +130,13 @@ struct percpu_stats {
 	u32 nr_max_chunks;	/* max # of live chunks */
 	size_t min_alloc_size;	/* min allocation size */
 	size_t max_alloc_size;	/* max allocation size */
+	u64 nr_quick_hit;	/* lifetime # of allocations from quick lists */
+	u64 nr_quick_parked;	/* current # of areas on quick lists */
 };
 
 extern struct percpu_stats pcpu_stats;
+extern atomic_long_t pcpu_stats_alloc_lat[PCPU_STATS_LAT_BUCKETS];
+extern atomic64_t pcpu_stats_alloc_lat_total;
 extern struct pcpu_alloc_info pcpu_stats_ai;
 
 /*
@@ -184,6 +192,53 @@ static inline void pcpu_stats_area_dealloc(struct pcpu_chunk *chunk)
 	chunk->nr_alloc--;
 }
 
+/*
+ * Parked areas keep counting as live allocations, the quick list stats only
+ * tell how many of them there are and how often they get reused.
+ */
+static inline void pcpu_stats_quick_get(void)
+{
+	lockdep_assert_held(&pcpu_lock);
+
+	pcpu_stats.nr_quick_hit++;
+	pcpu_stats.nr_quick_parked--;
+}
+
+static inline void pcpu_stats_quick_put(void)
+{
+	lockdep_assert_held(&pcpu_lock);
+
+	pcpu_stats.nr_quick_parked++;
+}
+
+static inline void pcpu_stats_quick_drain(void)
+{
+	lockdep_assert_held(&pcpu_lock);
+
+	pcpu_stats.nr_quick_parked--;
+}
+
+static inline u64 pcpu_stats_alloc_start(void)
+{
+	return local_clock();
+}
+
+/*
+ * pcpu_stats_alloc_end - account the latency of a successful allocation
+ *
+ * Called without pcpu_lock, the allocation may have slept to populate pages.
+ */
+static inline void pcpu_stats_alloc_end(u64 start)
+{
+	u64 delta = local_clock() - start;
+	unsigned long usecs = div_u64(delta, NSEC_PER_USEC);
+	int bucket;
+
+	bucket = usecs ? min(ilog2(usecs) + 1, PCPU_STATS_LAT_BUCKETS - 1) : 0;
+	atomic_long_inc(&pcpu_stats_alloc_lat[bucket]);
+	atomic64_add(delta, &pcpu_stats_alloc_lat_total);
+}
+
 /*
  * pcpu_stats_chunk_alloc - increment chunk stats
  */
@@ -226,6 +281,27 @@ static inline void pcpu_stats_area_dealloc(struct pcpu_chunk *chunk)
 {
 }
 
+static inline void pcpu_stats_quick_get(void)
+{
+}
+
+static inline void pcpu_stats_quick_put(void)
+{
+}
+
+static inline void pcpu_stats_quick_drain(void)
+{
+}
+
+static inline u64 pcpu_stats_alloc_start(void)
+{
+	return 0;
+}
+
+static inline void pcpu_stats_alloc_end(u64 start)
+{
+}
+
 static inline void pcpu_stats_chunk_alloc(void)
 {
 }
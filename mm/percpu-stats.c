@@ -20,6 +20,8 @@
 	seq_printf(m, "  %-20s: %12lld\n", X, (long long int)Y)
 
 struct percpu_stats pcpu_stats;
+atomic_long_t pcpu_stats_alloc_lat[PCPU_STATS_LAT_BUCKETS];
+atomic64_t pcpu_stats_alloc_lat_total;
 struct pcpu_alloc_info pcpu_stats_ai;
 
 static int cmpint(const void *a, const void *b)
@@ -137,6 +139,8 @@ static int percpu_stats_show(struct seq_file *m, void *v)
 	struct pcpu_chunk *chunk;
 	int slot, max_nr_alloc;
 	int *buffer;
+	u64 nr_lat = 0;
+	int i;
 
 alloc_buffer:
 	spin_lock_irq(&pcpu_lock);
@@ -188,11 +192,32 @@ static int percpu_stats_show(struct seq_file *m, void *v)
 	PU(nr_max_chunks);
 	PU(min_alloc_size);
 	PU(max_alloc_size);
+	PU(nr_quick_hit);
+	PU(nr_quick_parked);
 	P("empty_pop_pages", pcpu_nr_empty_pop_pages);
 	seq_putc(m, '\n');
 
 #undef PU
 
+	seq_printf(m,
+			"Alloc Latency:\n"
+			"----------------------------------------\n");
+	for (i = 0; i < PCPU_STATS_LAT_BUCKETS; i++) {
+		unsigned long nr = atomic_long_read(&pcpu_stats_alloc_lat[i]);
+
+		char label[16];
+
+		nr_lat += nr;
+		if (i == PCPU_STATS_LAT_BUCKETS - 1)
+			snprintf(label, sizeof(label), ">=%luus", 1UL << (i - 1));
+		else
+			snprintf(label, sizeof(label), "<%luus", 1UL << i);
+		P(label, nr);
+	}
+	P("avg_ns", nr_lat ?
+	  div64_u64(atomic64_read(&pcpu_stats_alloc_lat_total), nr_lat) : 0);
+	seq_putc(m, '\n');
+
 	seq_printf(m,
 			"Per Chunk Stats:\n"
 			"----------------------------------------\n");
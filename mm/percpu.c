@@ -107,8 +107,8 @@
 /* chunks in slots below this are subject to being sidelined on failed alloc */
 #define PCPU_SLOT_FAIL_THRESHOLD	3
 
-#define PCPU_EMPTY_POP_PAGES_LOW	2
-#define PCPU_EMPTY_POP_PAGES_HIGH	4
+/* default size of the atomic pool, see percpu_atomic_pages= */
+#define PCPU_EMPTY_POP_PAGES_HIGH	8
 
 #ifdef CONFIG_SMP
 /* default addr <-> pcpu_ptr mapping, override in asm/percpu.h if necessary */
@@ -194,13 +194,17 @@ static unsigned long pcpu_nr_populated;
 /*
  * Balance work is used to populate or destroy chunks asynchronously.  We
  * try to keep the number of populated free pages between
- * PCPU_EMPTY_POP_PAGES_LOW and HIGH for atomic allocations and at most one
- * empty chunk.
+ * pcpu_empty_pop_pages_low and high for atomic allocations and at most one
+ * empty chunk.  The work is kicked as soon as an allocation brings the pool
+ * below the low mark so that it gets refilled before atomic allocations
+ * start failing.
  */
 static void pcpu_balance_workfn(struct work_struct *work);
 static DECLARE_WORK(pcpu_balance_work, pcpu_balance_workfn);
 static bool pcpu_async_enabled __read_mostly;
 static bool pcpu_atomic_alloc_failed;
+static int pcpu_empty_pop_pages_high __ro_after_init = PCPU_EMPTY_POP_PAGES_HIGH;
+static int pcpu_empty_pop_pages_low __ro_after_init = PCPU_EMPTY_POP_PAGES_HIGH / 2;
 
 static void pcpu_schedule_balance_work(void)
 {
@@ -1704,6 +1708,152 @@ static void pcpu_memcg_free_hook(struct pcpu_chunk *chunk, int off, size_t size)
 }
 #endif /* CONFIG_MEMCG_KMEM */
 
+/*
+ * Quick lists of recently freed areas.
+ *
+ * Small power-of-two sized areas are the bulk of the percpu allocations
+ * (counters, per-cpu stats of cgroups, ...) and they tend to be freed and
+ * allocated again in bursts.  Instead of clearing a freed area in the
+ * bitmaps, which may move its chunk between slots, and scanning for it
+ * again on the next allocation, park it on a per-size-class list and hand
+ * it out directly.  Parked areas stay allocated in the chunk, so their
+ * pages stay populated and the chunk cannot be freed under them.  The
+ * balance work returns them to their chunks so that empty chunks can
+ * still be reclaimed.  Protected by pcpu_lock.
+ */
+#define PCPU_QUICK_NR_CLASSES		6	/* 4 to 128 bytes */
+#define PCPU_QUICK_DEPTH		16
+
+struct pcpu_quick_area {
+	struct pcpu_chunk	*chunk;
+	int			off;
+};
+
+struct pcpu_quick_list {
+	int			nr;
+	struct pcpu_quick_area	areas[PCPU_QUICK_DEPTH];
+};
+
+static struct pcpu_quick_list pcpu_quick_lists[PCPU_QUICK_NR_CLASSES];
+
+static int pcpu_quick_class(int bits)
+{
+	if (!is_power_of_2(bits))
+		return -1;
+	if (ilog2(bits) >= PCPU_QUICK_NR_CLASSES)
+		return -1;
+	return ilog2(bits);
+}
+
+/**
+ * pcpu_quick_get - take a parked area off its quick list
+ * @bits: size of the request in allocation units
+ * @bit_align: alignment of the request in allocation units
+ * @offp: out parameter for the offset of the area in its chunk
+ *
+ * CONTEXT:
+ * pcpu_lock.
+ *
+ * RETURNS:
+ * The chunk of the area, NULL if no parked area fits.
+ */
+static struct pcpu_chunk *pcpu_quick_get(int bits, int bit_align, int *offp)
+{
+	struct pcpu_quick_list *ql;
+	struct pcpu_chunk *chunk;
+	int class, i;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	class = pcpu_quick_class(bits);
+	if (class < 0)
+		return NULL;
+
+	ql = &pcpu_quick_lists[class];
+	/* the most recently freed area is the most likely to be cache hot */
+	for (i = ql->nr - 1; i >= 0; i--) {
+		if (!IS_ALIGNED(ql->areas[i].off,
+				bit_align * PCPU_MIN_ALLOC_SIZE))
+			continue;
+
+		chunk = ql->areas[i].chunk;
+		*offp = ql->areas[i].off;
+		ql->areas[i] = ql->areas[--ql->nr];
+
+		if (chunk->isolated)
+			pcpu_reintegrate_chunk(chunk);
+		pcpu_stats_quick_get();
+		return chunk;
+	}
+
+	return NULL;
+}
+
+/**
+ * pcpu_quick_put - park a freed area on its quick list
+ * @chunk: chunk of interest
+ * @off: offset of the area in @chunk
+ *
+ * CONTEXT:
+ * pcpu_lock.
+ *
+ * RETURNS:
+ * The size of the area if it was parked, 0 if it has to be freed.
+ */
+static int pcpu_quick_put(struct pcpu_chunk *chunk, int off)
+{
+	struct pcpu_quick_list *ql;
+	int bit_off, bits, class;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	/* reserved allocations never look at the quick lists */
+	if (chunk == pcpu_reserved_chunk || chunk->isolated)
+		return 0;
+
+	bit_off = off / PCPU_MIN_ALLOC_SIZE;
+	bits = find_next_bit(chunk->bound_map, pcpu_chunk_map_bits(chunk),
+			     bit_off + 1) - bit_off;
+	class = pcpu_quick_class(bits);
+	if (class < 0)
+		return 0;
+
+	ql = &pcpu_quick_lists[class];
+	if (ql->nr == PCPU_QUICK_DEPTH)
+		return 0;
+
+	ql->areas[ql->nr].chunk = chunk;
+	ql->areas[ql->nr].off = off;
+	ql->nr++;
+	pcpu_stats_quick_put();
+
+	return bits * PCPU_MIN_ALLOC_SIZE;
+}
+
+/**
+ * pcpu_quick_drain - return all parked areas to their chunks
+ *
+ * CONTEXT:
+ * pcpu_lock.
+ */
+static void pcpu_quick_drain(void)
+{
+	struct pcpu_quick_list *ql;
+	int class;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	for (class = 0; class < PCPU_QUICK_NR_CLASSES; class++) {
+		ql = &pcpu_quick_lists[class];
+		while (ql->nr) {
+			ql->nr--;
+			pcpu_free_area(ql->areas[ql->nr].chunk,
+				       ql->areas[ql->nr].off);
+			pcpu_stats_quick_drain();
+		}
+	}
+}
+
 /**
  * pcpu_alloc - the percpu allocator
  * @size: size of area to allocate in bytes
@@ -1733,6 +1883,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 	unsigned long flags;
 	void __percpu *ptr;
 	size_t bits, bit_align;
+	u64 start = pcpu_stats_alloc_start();
 
 	gfp = current_gfp_context(gfp);
 	/* whitelisted flags that can be passed to the backing allocators */
@@ -1797,6 +1948,10 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 		goto fail_unlock;
 	}
 
+	chunk = pcpu_quick_get(bits, bit_align, &off);
+	if (chunk)
+		goto quick_found;
+
 restart:
 	/* search through normal chunks */
 	for (slot = pcpu_size_to_slot(size); slot <= pcpu_free_slot; slot++) {
@@ -1847,6 +2002,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 
 area_found:
 	pcpu_stats_area_alloc(chunk, size);
+quick_found:
 	spin_unlock_irqrestore(&pcpu_lock, flags);
 
 	/* populate if not all pages are already there */
@@ -1875,7 +2031,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 		mutex_unlock(&pcpu_alloc_mutex);
 	}
 
-	if (pcpu_nr_empty_pop_pages < PCPU_EMPTY_POP_PAGES_LOW)
+	if (pcpu_nr_empty_pop_pages < pcpu_empty_pop_pages_low)
 		pcpu_schedule_balance_work();
 
 	/* clear the areas and return address relative to base address */
@@ -1889,6 +2045,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 			chunk->base_addr, off, ptr);
 
 	pcpu_memcg_post_alloc_hook(objcg, chunk, off, size);
+	pcpu_stats_alloc_end(start);
 
 	return ptr;
 
@@ -2059,13 +2216,13 @@ static void pcpu_balance_populated(void)
 	 */
 retry_pop:
 	if (pcpu_atomic_alloc_failed) {
-		nr_to_pop = PCPU_EMPTY_POP_PAGES_HIGH;
+		nr_to_pop = pcpu_empty_pop_pages_high;
 		/* best effort anyway, don't worry about synchronization */
 		pcpu_atomic_alloc_failed = false;
 	} else {
-		nr_to_pop = clamp(PCPU_EMPTY_POP_PAGES_HIGH -
+		nr_to_pop = clamp(pcpu_empty_pop_pages_high -
 				  pcpu_nr_empty_pop_pages,
-				  0, PCPU_EMPTY_POP_PAGES_HIGH);
+				  0, pcpu_empty_pop_pages_high);
 	}
 
 	for (slot = pcpu_size_to_slot(PAGE_SIZE); slot <= pcpu_free_slot; slot++) {
@@ -2166,7 +2323,7 @@ static void pcpu_reclaim_populated(void)
 				break;
 
 			/* reintegrate chunk to prevent atomic alloc failures */
-			if (pcpu_nr_empty_pop_pages < PCPU_EMPTY_POP_PAGES_HIGH) {
+			if (pcpu_nr_empty_pop_pages < pcpu_empty_pop_pages_high) {
 				reintegrate = true;
 				goto end_chunk;
 			}
@@ -2234,6 +2391,9 @@ static void pcpu_reclaim_populated(void)
 static void pcpu_balance_workfn(struct work_struct *work)
 {
 	/*
+	 * Parked areas are handed back first, they may be all that keeps a
+	 * chunk from being empty.
+	 *
 	 * pcpu_balance_free() is called twice because the first time we may
 	 * trim pages in the active pcpu_nr_empty_pop_pages which may cause us
 	 * to grow other chunks.  This then gives pcpu_reclaim_populated() time
@@ -2243,6 +2403,7 @@ static void pcpu_balance_workfn(struct work_struct *work)
 	mutex_lock(&pcpu_alloc_mutex);
 	spin_lock_irq(&pcpu_lock);
 
+	pcpu_quick_drain();
 	pcpu_balance_free(false);
 	pcpu_reclaim_populated();
 	pcpu_balance_populated();
@@ -2281,6 +2442,12 @@ void free_percpu(void __percpu *ptr)
 	chunk = pcpu_chunk_addr_search(addr);
 	off = addr - chunk->base_addr;
 
+	size = pcpu_quick_put(chunk, off);
+	if (size) {
+		pcpu_memcg_free_hook(chunk, off, size);
+		goto out_unlock;
+	}
+
 	size = pcpu_free_area(chunk, off);
 
 	pcpu_memcg_free_hook(chunk, off, size);
@@ -2303,6 +2470,7 @@ void free_percpu(void __percpu *ptr)
 		need_balance = true;
 	}
 
+out_unlock:
 	trace_percpu_free_percpu(chunk->base_addr, off, ptr);
 
 	spin_unlock_irqrestore(&pcpu_lock, flags);
@@ -2813,6 +2981,25 @@ static int __init percpu_alloc_setup(char *str)
 }
 early_param("percpu_alloc", percpu_alloc_setup);
 
+/*
+ * percpu_atomic_pages=<nr> sets the number of populated free pages per unit
+ * kept around for atomic allocations.  The pool is refilled once it drops
+ * below half of that.
+ */
+static int __init percpu_atomic_pages_setup(char *str)
+{
+	int pages;
+
+	if (!str || kstrtoint(str, 0, &pages) || pages < 2)
+		return -EINVAL;
+
+	pcpu_empty_pop_pages_high = pages;
+	pcpu_empty_pop_pages_low = pages / 2;
+
+	return 0;
+}
+early_param("percpu_atomic_pages", percpu_atomic_pages_setup);
+
 /*
  * pcpu_embed_first_chunk() is used by the generic percpu setup.
  * Build it if needed by the arch config or the generic setup is going
@@ -23,6 +23,8 @@
 #include <linux/blk-cgroup.h>
 #include <linux/fadvise.h>
 #include <linux/sched/mm.h>
+#include <linux/cpuset.h>
+#include <trace/events/filemap.h>
 
 #include "internal.h"
 
@@ -34,6 +36,7 @@ void
 file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = inode_to_bdi(mapping->host)->ra_pages;
+	ra->adapt_pages = 0;
 	ra->prev_pos = -1;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
@@ -157,6 +160,89 @@ static void read_pages(struct readahead_control *rac, struct list_head *pages,
 		rac->_index++;
 }
 
+/*
+ * Readahead only ever adds order-0 pages: __add_to_page_cache_locked()
+ * stores a single index per page, and the ->readpage(s)/->readahead
+ * implementations (iomap, ext4) expect PAGE_SIZE pages.  What can be
+ * batched is the allocation of those pages.
+ */
+
+/* Upper bound on the pages taken from the page allocator in one go */
+#define RA_ALLOC_BATCH	32UL
+
+static inline bool ra_can_alloc_bulk(void)
+{
+	/* Leave page placement policies to the regular allocator */
+	if (cpuset_do_page_mem_spread())
+		return false;
+#ifdef CONFIG_NUMA
+	if (current->mempolicy)
+		return false;
+#endif
+	return true;
+}
+
+/*
+ * Number of pages missing from the page cache from @index on, up to @max.
+ * Shadow entries count as missing, readahead replaces them.
+ */
+static unsigned long ra_count_missing(struct address_space *mapping,
+				      pgoff_t index, unsigned long max)
+{
+	XA_STATE(xas, &mapping->i_pages, index);
+	unsigned long nr = max;
+	void *entry;
+
+	rcu_read_lock();
+	xas_for_each(&xas, entry, index + max - 1) {
+		if (xas_retry(&xas, entry) || xa_is_value(entry))
+			continue;
+		nr = xas.xa_index - index;
+		break;
+	}
+	rcu_read_unlock();
+
+	return nr;
+}
+
+/*
+ * Allocate the page for @index, refilling @stash from the bulk allocator
+ * when it runs empty. The refill covers the pages missing from @index on,
+ * up to the next cached page and at most @want of them. Large sequential
+ * readahead windows then take the zone lock once per batch instead of once
+ * per page.
+ */
+static struct page *ra_alloc_page(struct address_space *mapping,
+				  gfp_t gfp_mask, struct list_head *stash,
+				  pgoff_t index, unsigned long want)
+{
+	struct page *page;
+
+	if (list_empty(stash) && want > 1 && ra_can_alloc_bulk()) {
+		want = ra_count_missing(mapping, index,
+					min(want, RA_ALLOC_BATCH));
+		if (want > 1)
+			alloc_pages_bulk_list(gfp_mask, want, stash);
+	}
+
+	page = list_first_entry_or_null(stash, struct page, lru);
+	if (!page)
+		return __page_cache_alloc(gfp_mask);
+
+	list_del(&page->lru);
+	return page;
+}
+
+static void ra_free_stash(struct list_head *stash)
+{
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, stash, lru) {
+		list_del(&page->lru);
+		put_page(page);
+	}
+}
+
 /**
  * page_cache_ra_unbounded - Start unchecked readahead.
  * @ractl: Readahead control.
@@ -177,7 +263,9 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 	struct address_space *mapping = ractl->mapping;
 	unsigned long index = readahead_index(ractl);
 	LIST_HEAD(page_pool);
+	LIST_HEAD(page_stash);
 	gfp_t gfp_mask = readahead_gfp_mask(mapping);
+	unsigned long nr_added = 0;
 	unsigned long i;
 
 	/*
@@ -213,7 +301,8 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 			continue;
 		}
 
-		page = __page_cache_alloc(gfp_mask);
+		page = ra_alloc_page(mapping, gfp_mask, &page_stash,
+				     index + i, nr_to_read - i);
 		if (!page)
 			break;
 		if (mapping->a_ops->readpages) {
@@ -229,6 +318,7 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 		if (i == nr_to_read - lookahead_size)
 			SetPageReadahead(page);
 		ractl->_nr_pages++;
+		nr_added++;
 	}
 
 	/*
@@ -239,6 +329,8 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 	read_pages(ractl, &page_pool, false);
 	filemap_invalidate_unlock_shared(mapping);
 	memalloc_nofs_restore(nofs);
+	ra_free_stash(&page_stash);
+	count_vm_events(PGREADAHEAD, nr_added);
 }
 EXPORT_SYMBOL_GPL(page_cache_ra_unbounded);
 
@@ -380,6 +472,63 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * it approaches max_readhead.
  */
 
+/*
+ * Per-file window feedback.
+ *
+ * ra_pages is a per-device ceiling, but whether a window of that size pays
+ * off depends on how the file is read and how much memory is around. Each
+ * file_ra_state therefore learns its own limit in adapt_pages:
+ *
+ *  - A synchronous miss inside the current window, on an index that holds
+ *    a shadow entry, means pages we read ahead were reclaimed before they
+ *    were used. The limit is halved down to RA_ADAPT_MIN_PAGES so that the
+ *    stream stops thrashing itself. Only the refault proves that the pages
+ *    were read and then lost. Readers sharing one struct file move the
+ *    window under each other, so a miss alone is no evidence of thrashing.
+ *
+ *  - Hitting the PG_readahead marker means the previous window was used
+ *    and the limit is raised by a quarter. If the marker page is not even
+ *    uptodate yet, the reader has caught up with the device and the async
+ *    window is too short to hide its latency, so the limit is doubled.
+ *
+ * A limit that grows back to ra_pages is dropped again.
+ */
+#define RA_ADAPT_MIN_PAGES	4UL
+
+static unsigned long ra_max_pages(struct file_ra_state *ra)
+{
+	if (ra->adapt_pages && ra->adapt_pages < ra->ra_pages)
+		return ra->adapt_pages;
+	return ra->ra_pages;
+}
+
+/*
+ * Whether the page at @index was evicted from @mapping, i.e. reading it
+ * again is a workingset refault.
+ */
+static bool ra_index_refaulted(struct address_space *mapping, pgoff_t index)
+{
+	return xa_is_value(xa_load(&mapping->i_pages, index));
+}
+
+static void ra_adapt_shrink(struct file_ra_state *ra)
+{
+	unsigned long max = min_t(unsigned long, ra->size, ra_max_pages(ra));
+
+	ra->adapt_pages = max(max / 2, RA_ADAPT_MIN_PAGES);
+}
+
+static void ra_adapt_grow(struct file_ra_state *ra, bool io_bound)
+{
+	unsigned long max = ra->adapt_pages;
+
+	if (!max)
+		return;
+
+	max += io_bound ? max : max / 4 + 1;
+	ra->adapt_pages = max < ra->ra_pages ? max : 0;
+}
+
 /*
  * Count contiguously cached pages from @index-1 to @index-@max,
  * this count is a conservative estimation of
@@ -440,11 +589,26 @@ static void ondemand_readahead(struct readahead_control *ractl,
 {
 	struct backing_dev_info *bdi = inode_to_bdi(ractl->mapping->host);
 	struct file_ra_state *ra = ractl->ra;
-	unsigned long max_pages = ra->ra_pages;
+	unsigned long max_pages;
 	unsigned long add_pages;
 	unsigned long index = readahead_index(ractl);
+	const char *reason;
 	pgoff_t prev_index;
 
+	/*
+	 * Missing a page we read ahead ourselves, it was reclaimed before
+	 * it got used: shrink the window and start a new one from here.
+	 */
+	if (!hit_readahead_marker && ra->size && ra_has_index(ra, index) &&
+	    ra_index_refaulted(ractl->mapping, index)) {
+		ra_adapt_shrink(ra);
+		max_pages = ra_max_pages(ra);
+		reason = "thrash";
+		goto initial_readahead;
+	}
+
+	max_pages = ra_max_pages(ra);
+
 	/*
 	 * If the request exceeds the readahead window, allow the read to
 	 * be up to the optimal hardware IO size
@@ -455,6 +619,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	/*
 	 * start of file
 	 */
+	reason = "initial";
 	if (!index)
 		goto initial_readahead;
 
@@ -467,6 +632,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max_pages);
 		ra->async_size = ra->size;
+		reason = "sequential";
 		goto readit;
 	}
 
@@ -492,6 +658,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		ra->size += req_size;
 		ra->size = get_next_ra_size(ra, max_pages);
 		ra->async_size = ra->size;
+		reason = "marker";
 		goto readit;
 	}
 
@@ -515,13 +682,17 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	 * that a sequential stream would leave behind.
 	 */
 	if (try_context_readahead(ractl->mapping, ra, index, req_size,
-			max_pages))
+			max_pages)) {
+		reason = "context";
 		goto readit;
+	}
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
+	trace_mm_filemap_readahead(ractl->mapping, index, index, req_size, 0,
+				   max_pages, "random");
 	do_page_cache_ra(ractl, req_size, 0);
 	return;
 
@@ -548,6 +719,8 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		}
 	}
 
+	trace_mm_filemap_readahead(ractl->mapping, index, ra->start, ra->size,
+				   ra->async_size, max_pages, reason);
 	ractl->_index = ra->start;
 	do_page_cache_ra(ractl, ra->size, ra->async_size);
 }
@@ -596,6 +769,12 @@ void page_cache_async_ra(struct readahead_control *ractl,
 
 	ClearPageReadahead(page);
 
+	/*
+	 * The previous window got used. A marker that is still under IO
+	 * means the reader is waiting on the device, grow faster.
+	 */
+	ra_adapt_grow(ractl->ra, !PageUptodate(page));
+
 	/*
 	 * Defer asynchronous read-ahead on IO congestion.
 	 */
@@ -1465,6 +1465,16 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		/* Unexpected PMD-mapped THP? */
 		VM_BUG_ON_PAGE(!pvmw.pte, page);
 
+		/*
+		 * A pte table shared by fork is mapped by mms we would not
+		 * flush, leave the page alone until it is unshared.
+		 */
+		if (pmd_pte_table_shared(pvmw.pmd)) {
+			ret = false;
+			page_vma_mapped_walk_done(&pvmw);
+			break;
+		}
+
 		subpage = page - page_to_pfn(page) + pte_pfn(*pvmw.pte);
 		address = pvmw.address;
 
@@ -1784,6 +1794,16 @@ static bool try_to_migrate_one(struct page *page, struct vm_area_struct *vma,
 		/* Unexpected PMD-mapped THP? */
 		VM_BUG_ON_PAGE(!pvmw.pte, page);
 
+		/*
+		 * A pte table shared by fork is mapped by mms we would not
+		 * flush, leave the page alone until it is unshared.
+		 */
+		if (pmd_pte_table_shared(pvmw.pmd)) {
+			ret = false;
+			page_vma_mapped_walk_done(&pvmw);
+			break;
+		}
+
 		subpage = page - page_to_pfn(page) + pte_pfn(*pvmw.pte);
 		address = pvmw.address;
 
@@ -1823,7 +1843,17 @@ static bool try_to_migrate_one(struct page *page, struct vm_area_struct *vma,
 
 		/* Nuke the page table entry. */
 		flush_cache_page(vma, address, pte_pfn(*pvmw.pte));
-		pteval = ptep_clear_flush(vma, address, pvmw.pte);
+		if (should_defer_flush(mm, flags)) {
+			/*
+			 * As in try_to_unmap_one(), the caller flushes before
+			 * the page contents are copied.
+			 */
+			pteval = ptep_get_and_clear(mm, address, pvmw.pte);
+
+			set_tlb_ubc_flush_pending(mm, pte_dirty(pteval));
+		} else {
+			pteval = ptep_clear_flush(vma, address, pvmw.pte);
+		}
 
 		/* Move the dirty bit to the page. Now the pte is gone. */
 		if (pte_dirty(pteval))
@@ -1962,11 +1992,11 @@ void try_to_migrate(struct page *page, enum ttu_flags flags)
 	};
 
 	/*
-	 * Migration always ignores mlock and only supports TTU_RMAP_LOCKED and
-	 * TTU_SPLIT_HUGE_PMD and TTU_SYNC flags.
+	 * Migration always ignores mlock and only supports TTU_RMAP_LOCKED,
+	 * TTU_SPLIT_HUGE_PMD, TTU_SYNC and TTU_BATCH_FLUSH flags.
 	 */
 	if (WARN_ON_ONCE(flags & ~(TTU_RMAP_LOCKED | TTU_SPLIT_HUGE_PMD |
-					TTU_SYNC)))
+					TTU_SYNC | TTU_BATCH_FLUSH)))
 		return;
 
 	if (is_zone_device_page(page) && !is_device_private_page(page))
@@ -2093,7 +2123,7 @@ static bool page_make_device_exclusive_one(struct page *page,
 		/* Unexpected PMD-mapped THP? */
 		VM_BUG_ON_PAGE(!pvmw.pte, page);
 
-		if (!pte_present(*pvmw.pte)) {
+		if (!pte_present(*pvmw.pte) || pmd_pte_table_shared(pvmw.pmd)) {
 			ret = false;
 			page_vma_mapped_walk_done(&pvmw);
 			break;
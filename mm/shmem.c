@@ -54,6 +54,7 @@ static struct vfsmount *shm_mnt;
 #include <linux/posix_acl.h>
 #include <linux/posix_acl_xattr.h>
 #include <linux/mman.h>
+#include <linux/fadvise.h>
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/backing-dev.h>
@@ -448,6 +449,11 @@ static bool shmem_confirm_swap(struct address_space *mapping,
  *	also respect fadvise()/madvise() hints;
  * SHMEM_HUGE_ADVISE:
  *	only allocate huge pages if requested with fadvise()/madvise();
+ *
+ * Whatever the mount says, a file advised with POSIX_FADV_HUGEPAGE (a
+ * memfd included) gets huge pages and one advised
+ * with POSIX_FADV_NOHUGEPAGE does not; the advice is kept in info->flags
+ * as VM_HUGEPAGE and VM_NOHUGEPAGE.
  */
 
 #define SHMEM_HUGE_NEVER	0
@@ -480,11 +486,15 @@ bool shmem_is_huge(struct vm_area_struct *vma,
 
 	if (shmem_huge == SHMEM_HUGE_DENY)
 		return false;
+	if (SHMEM_I(inode)->flags & VM_NOHUGEPAGE)
+		return false;
 	if (vma && ((vma->vm_flags & VM_NOHUGEPAGE) ||
 	    test_bit(MMF_DISABLE_THP, &vma->vm_mm->flags)))
 		return false;
 	if (shmem_huge == SHMEM_HUGE_FORCE)
 		return true;
+	if (SHMEM_I(inode)->flags & VM_HUGEPAGE)
+		return true;
 
 	switch (SHMEM_SB(inode->i_sb)->huge) {
 	case SHMEM_HUGE_ALWAYS:
@@ -691,6 +701,27 @@ static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 }
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
+/*
+ * Zero a newly allocated page before it becomes uptodate. A huge page that
+ * is faulted in is cleared towards the faulting subpage, which leaves the
+ * part about to be touched hot in the cache.
+ */
+static void shmem_clear_page(struct page *page, struct vm_fault *vmf)
+{
+	int i;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/* The fault address is only a subpage address if the pmd lines up */
+	if (PageTransHuge(page) && vmf &&
+	    IS_ALIGNED((vmf->address >> PAGE_SHIFT) - vmf->pgoff, HPAGE_PMD_NR)) {
+		clear_huge_page(page, vmf->address, HPAGE_PMD_NR);
+		return;
+	}
+#endif
+	for (i = 0; i < compound_nr(page); i++)
+		clear_highpage(page + i);
+}
+
 /*
  * Like add_to_page_cache_locked, but error if expected item has gone.
  */
@@ -1985,10 +2016,9 @@ static int shmem_getpage_gfp(struct inode *inode, pgoff_t index,
 	if (sgp != SGP_WRITE && !PageUptodate(page)) {
 		int i;
 
-		for (i = 0; i < compound_nr(page); i++) {
-			clear_highpage(page + i);
+		shmem_clear_page(page, vmf);
+		for (i = 0; i < compound_nr(page); i++)
 			flush_dcache_page(page + i);
-		}
 		SetPageUptodate(page);
 	}
 
@@ -2179,7 +2209,8 @@ unsigned long shmem_get_unmapped_area(struct file *file,
 				return addr;
 			sb = shm_mnt->mnt_sb;
 		}
-		if (SHMEM_SB(sb)->huge == SHMEM_HUGE_NEVER)
+		if (SHMEM_SB(sb)->huge == SHMEM_HUGE_NEVER &&
+		    !(file && SHMEM_I(file_inode(file))->flags & VM_HUGEPAGE))
 			return addr;
 	}
 
@@ -3793,9 +3824,36 @@ const struct address_space_operations shmem_aops = {
 };
 EXPORT_SYMBOL(shmem_aops);
 
+/*
+ * POSIX_FADV_[NO]HUGEPAGE apply to the whole file, whatever the range: huge
+ * pages are allocated per aligned index, not per range. Pages already in the
+ * file are left as they are.
+ */
+static int shmem_fadvise(struct file *file, loff_t offset, loff_t len,
+			 int advice)
+{
+	struct shmem_inode_info *info = SHMEM_I(file_inode(file));
+
+	switch (advice) {
+	case POSIX_FADV_HUGEPAGE:
+	case POSIX_FADV_NOHUGEPAGE:
+		if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
+			return -EINVAL;
+		spin_lock_irq(&info->lock);
+		info->flags &= ~(VM_HUGEPAGE | VM_NOHUGEPAGE);
+		info->flags |= advice == POSIX_FADV_HUGEPAGE ?
+				VM_HUGEPAGE : VM_NOHUGEPAGE;
+		spin_unlock_irq(&info->lock);
+		return 0;
+	default:
+		return generic_fadvise(file, offset, len, advice);
+	}
+}
+
 static const struct file_operations shmem_file_operations = {
 	.mmap		= shmem_mmap,
 	.get_unmapped_area = shmem_get_unmapped_area,
+	.fadvise	= shmem_fadvise,
 #ifdef CONFIG_TMPFS
 	.llseek		= shmem_file_llseek,
 	.read_iter	= shmem_file_read_iter,
@@ -2597,6 +2597,183 @@ static inline void unfreeze_partials_cpu(struct kmem_cache *s,
 
 #endif	/* CONFIG_SLUB_CPU_PARTIAL */
 
+/*
+ * Per cpu sheaves.
+ *
+ * A cache can opt in to keep an array of free objects per cpu. Allocations
+ * and frees served by the array only take the local lock, and the slab
+ * freelists are only touched in bulk, when an empty sheaf is refilled or half
+ * of a full one is flushed. Objects in a sheaf have been through the free
+ * hooks already, the alloc hooks run again when they are handed out.
+ */
+#define SHEAF_BATCH	(SLUB_SHEAF_MAX_CAPACITY / 2)
+
+static int __kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags,
+				   size_t size, void **p, bool allow_kfence);
+static void sheaf_free_bulk(struct kmem_cache *s, size_t size, void **p);
+
+static inline unsigned int sheaf_capacity(struct kmem_cache *s)
+{
+	/* Pairs with smp_store_release() in sheaf_capacity_store() */
+	return smp_load_acquire(&s->sheaf_capacity);
+}
+
+static noinline void *sheaf_refill(struct kmem_cache *s, gfp_t gfpflags)
+{
+	struct slub_percpu_sheaf *sheaf;
+	unsigned int capacity, batch, n, fill = 0;
+	void *objects[SHEAF_BATCH];
+	unsigned long flags;
+	void *object;
+
+	/* The bulk allocator has to run with interrupts enabled */
+	if (irqs_disabled())
+		return NULL;
+
+	capacity = sheaf_capacity(s);
+	if (!capacity)
+		return NULL;
+	batch = min_t(unsigned int, DIV_ROUND_UP(capacity, 2), SHEAF_BATCH);
+
+	/* Never stash memory reserves where any allocation can find them */
+	n = __kmem_cache_alloc_bulk(s, gfpflags | __GFP_NOMEMALLOC, batch,
+				    objects, false);
+	if (!n)
+		return NULL;
+	object = objects[--n];
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	capacity = READ_ONCE(s->sheaf_capacity);
+	if (sheaf->size < capacity) {
+		fill = min(n, capacity - sheaf->size);
+		memcpy(&sheaf->objects[sheaf->size], &objects[n - fill],
+		       fill * sizeof(void *));
+		sheaf->size += fill;
+	}
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (n > fill)
+		sheaf_free_bulk(s, n - fill, objects);
+	stat(s, SHEAF_REFILL);
+
+	return object;
+}
+
+static __always_inline void *sheaf_alloc(struct kmem_cache *s, gfp_t gfpflags)
+{
+	struct slub_percpu_sheaf *sheaf;
+	void *object = NULL;
+	unsigned long flags;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	if (likely(sheaf->size))
+		object = sheaf->objects[--sheaf->size];
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (likely(object)) {
+		stat(s, SHEAF_ALLOC);
+		return object;
+	}
+
+	return sheaf_refill(s, gfpflags);
+}
+
+/* Flush the older half of a full sheaf and put @object in the sheaf */
+static noinline bool sheaf_flush(struct kmem_cache *s, void *object)
+{
+	struct slub_percpu_sheaf *sheaf;
+	unsigned int capacity, batch;
+	void *objects[SHEAF_BATCH];
+	unsigned long flags;
+	bool stored = false;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	capacity = READ_ONCE(s->sheaf_capacity);
+	batch = min3(sheaf->size, DIV_ROUND_UP(capacity, 2),
+		     (unsigned int)SHEAF_BATCH);
+	if (batch) {
+		memcpy(objects, sheaf->objects, batch * sizeof(void *));
+		sheaf->size -= batch;
+		memmove(sheaf->objects, &sheaf->objects[batch],
+			sheaf->size * sizeof(void *));
+	}
+	if (sheaf->size < capacity) {
+		sheaf->objects[sheaf->size++] = object;
+		stored = true;
+	}
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (batch) {
+		sheaf_free_bulk(s, batch, objects);
+		stat(s, SHEAF_FLUSH);
+	}
+
+	return stored;
+}
+
+static __always_inline bool sheaf_free(struct kmem_cache *s, struct page *page,
+				       void *object)
+{
+	struct slub_percpu_sheaf *sheaf;
+	unsigned long flags;
+	bool stored = false;
+
+	/*
+	 * Keep the sheaf node local and free of memory reserves, like the cpu
+	 * slab it substitutes for.
+	 */
+	if (page_to_nid(page) != numa_mem_id() ||
+	    unlikely(PageSlabPfmemalloc(page)) || is_kfence_address(object))
+		return false;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	if (likely(sheaf->size < READ_ONCE(s->sheaf_capacity))) {
+		sheaf->objects[sheaf->size++] = object;
+		stored = true;
+	}
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (likely(stored)) {
+		stat(s, SHEAF_FREE);
+		return true;
+	}
+
+	return sheaf_flush(s, object);
+}
+
+/* Called on the local cpu, with migration disabled */
+static void sheaf_drain_local(struct kmem_cache *s)
+{
+	void *objects[SLUB_SHEAF_MAX_CAPACITY];
+	struct slub_percpu_sheaf *sheaf;
+	unsigned long flags;
+	unsigned int size;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	size = sheaf->size;
+	memcpy(objects, sheaf->objects, size * sizeof(void *));
+	sheaf->size = 0;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (size)
+		sheaf_free_bulk(s, size, objects);
+}
+
+/* The cpu is offline, nobody else can access its sheaf */
+static void sheaf_drain_cpu(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaf *sheaf = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+	if (sheaf->size)
+		sheaf_free_bulk(s, sheaf->size, sheaf->objects);
+	sheaf->size = 0;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	unsigned long flags;
@@ -2626,6 +2803,9 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 	void *freelist = c->freelist;
 	struct page *page = c->page;
 
+	if (s->cpu_sheaves)
+		sheaf_drain_cpu(s, cpu);
+
 	c->page = NULL;
 	c->freelist = NULL;
 	c->tid = next_tid(c->tid);
@@ -2660,6 +2840,10 @@ static void flush_cpu_slab(struct work_struct *w)
 	s = sfw->s;
 	c = this_cpu_ptr(s->cpu_slab);
 
+	/* Objects from the sheaf may well go back to the cpu slab */
+	if (s->cpu_sheaves)
+		sheaf_drain_local(s);
+
 	if (c->page)
 		flush_slab(s, c);
 
@@ -2670,6 +2854,9 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_sheaves && per_cpu_ptr(s->cpu_sheaves, cpu)->size)
+		return true;
+
 	return c->page || slub_percpu_partial(c);
 }
 
@@ -3139,6 +3326,12 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 	if (unlikely(object))
 		goto out;
 
+	if (node == NUMA_NO_NODE && sheaf_capacity(s)) {
+		object = sheaf_alloc(s, gfpflags);
+		if (object)
+			goto wipe;
+	}
+
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -3213,6 +3406,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s,
 		stat(s, ALLOC_FASTPATH);
 	}
 
+wipe:
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
 
@@ -3428,8 +3622,11 @@ static __always_inline void do_slab_free(struct kmem_cache *s,
 	unsigned long tid;
 
 	/* memcg_slab_free_hook() is already called for bulk free. */
-	if (!tail)
+	if (!tail) {
 		memcg_slab_free_hook(s, &head, 1);
+		if (sheaf_capacity(s) && sheaf_free(s, page, head))
+			return;
+	}
 redo:
 	/*
 	 * Determine the currently cpus per cpu slab.
@@ -3642,18 +3839,34 @@ void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
 }
 EXPORT_SYMBOL(kmem_cache_free_bulk);
 
-/* Note that interrupts must be enabled when calling this function. */
-int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
-			  void **p)
+/*
+ * Free objects that never went through the alloc hooks, like the contents of
+ * a sheaf, back to their slabs.
+ */
+static void sheaf_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (!df.page)
+			continue;
+
+		do_slab_free(df.s, df.page, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (likely(size));
+}
+
+/*
+ * Allocate up to @size objects without running the alloc hooks. Returns the
+ * number of objects allocated, which is less than @size only on failure.
+ */
+static int __kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags,
+				   size_t size, void **p, bool allow_kfence)
 {
 	struct kmem_cache_cpu *c;
 	int i;
-	struct obj_cgroup *objcg = NULL;
 
-	/* memcg and kmem_cache debug support */
-	s = slab_pre_alloc_hook(s, &objcg, size, flags);
-	if (unlikely(!s))
-		return false;
 	/*
 	 * Drain objects in the per cpu slab, while disabling local
 	 * IRQs, which protects against PREEMPT and interrupts
@@ -3663,8 +3876,10 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 	local_lock_irq(&s->cpu_slab->lock);
 
 	for (i = 0; i < size; i++) {
-		void *object = kfence_alloc(s, s->object_size, flags);
+		void *object = NULL;
 
+		if (allow_kfence)
+			object = kfence_alloc(s, s->object_size, flags);
 		if (unlikely(object)) {
 			p[i] = object;
 			continue;
@@ -3689,8 +3904,10 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 			 */
 			p[i] = ___slab_alloc(s, flags, NUMA_NO_NODE,
 					    _RET_IP_, c);
-			if (unlikely(!p[i]))
-				goto error;
+			if (unlikely(!p[i])) {
+				slub_put_cpu_ptr(s->cpu_slab);
+				return i;
+			}
 
 			c = this_cpu_ptr(s->cpu_slab);
 			maybe_wipe_obj_freeptr(s, p[i]);
@@ -3707,6 +3924,25 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 	local_unlock_irq(&s->cpu_slab->lock);
 	slub_put_cpu_ptr(s->cpu_slab);
 
+	return i;
+}
+
+/* Note that interrupts must be enabled when calling this function. */
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct obj_cgroup *objcg = NULL;
+	int i;
+
+	/* memcg and kmem_cache debug support */
+	s = slab_pre_alloc_hook(s, &objcg, size, flags);
+	if (unlikely(!s))
+		return false;
+
+	i = __kmem_cache_alloc_bulk(s, flags, size, p, true);
+	if (unlikely(i < size))
+		goto error;
+
 	/*
 	 * memcg and kmem_cache debug support and memory initialization.
 	 * Done outside of the IRQ disabled fastpath loop.
@@ -3715,7 +3951,6 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 				slab_want_init_on_alloc(flags, s));
 	return i;
 error:
-	slub_put_cpu_ptr(s->cpu_slab);
 	slab_post_alloc_hook(s, objcg, flags, i, p, false);
 	__kmem_cache_free_bulk(s, i, p);
 	return 0;
@@ -3955,6 +4190,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->cpu_sheaves);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -5425,6 +5661,44 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(s->sheaf_capacity));
+}
+
+static ssize_t sheaf_capacity_store(struct kmem_cache *s, const char *buf,
+				    size_t length)
+{
+	struct slub_percpu_sheaf __percpu *sheaves;
+	unsigned int capacity;
+	int err, cpu;
+
+	err = kstrtouint(buf, 10, &capacity);
+	if (err)
+		return err;
+	if (capacity > SLUB_SHEAF_MAX_CAPACITY)
+		return -EINVAL;
+	/* Debugging needs every object to pass through the slab freelists */
+	if (capacity && kmem_cache_debug(s))
+		return -EINVAL;
+
+	if (capacity && !s->cpu_sheaves) {
+		sheaves = alloc_percpu(struct slub_percpu_sheaf);
+		if (!sheaves)
+			return -ENOMEM;
+		for_each_possible_cpu(cpu)
+			local_lock_init(&per_cpu_ptr(sheaves, cpu)->lock);
+		if (cmpxchg(&s->cpu_sheaves, NULL, sheaves))
+			free_percpu(sheaves);
+	}
+
+	/* Pairs with smp_load_acquire() in sheaf_capacity() */
+	smp_store_release(&s->sheaf_capacity, capacity);
+	flush_all(s);
+	return length;
+}
+SLAB_ATTR(sheaf_capacity);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5729,6 +6003,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(SHEAF_ALLOC, sheaf_alloc);
+STAT_ATTR(SHEAF_FREE, sheaf_free);
+STAT_ATTR(SHEAF_REFILL, sheaf_refill);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 static struct attribute *slab_attrs[] = {
@@ -5738,6 +6016,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5793,6 +6072,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&sheaf_alloc_attr.attr,
+	&sheaf_free_attr.attr,
+	&sheaf_refill_attr.attr,
+	&sheaf_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
@@ -624,9 +624,14 @@ struct page *swap_cluster_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	struct vm_area_struct *vma = vmf->vma;
 	unsigned long addr = vmf->address;
 
-	mask = swapin_nr_pages(offset) - 1;
-	if (!mask)
-		goto skip;
+	if (IS_ENABLED(CONFIG_THP_SWAP) && swap_entry_from_huge(entry)) {
+		/* Swapped out as a THP, bring all of it back in one go */
+		mask = HPAGE_PMD_NR - 1;
+	} else {
+		mask = swapin_nr_pages(offset) - 1;
+		if (!mask)
+			goto skip;
+	}
 
 	do_poll = false;
 	/* Read a page_cluster sized and aligned cluster around offset. */
@@ -849,7 +854,11 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 				struct vm_fault *vmf)
 {
-	return swap_use_vma_readahead() ?
+	/*
+	 * The physical layout of what used to be a THP is also its virtual
+	 * one, read it back as the cluster it was written out as.
+	 */
+	return swap_use_vma_readahead() && !swap_entry_from_huge(entry) ?
 			swap_vma_readahead(entry, gfp_mask, vmf) :
 			swap_cluster_readahead(entry, gfp_mask, vmf);
 }
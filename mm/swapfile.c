@@ -346,6 +346,29 @@ static inline void cluster_clear_huge(struct swap_cluster_info *info)
 	info->flags &= ~CLUSTER_FLAG_HUGE;
 }
 
+/*
+ * Clusters that had entries freed while in use go on si->nonfull_clusters,
+ * so that the per-cpu cluster allocation fills their holes before it takes
+ * a free cluster. That keeps whole free clusters around for THP swapout.
+ * Caller should hold si->lock.
+ */
+static void cluster_add_nonfull(struct swap_info_struct *si,
+				struct swap_cluster_info *ci)
+{
+	if (ci->flags & (CLUSTER_FLAG_FREE | CLUSTER_FLAG_NONFULL))
+		return;
+	ci->flags |= CLUSTER_FLAG_NONFULL;
+	list_add_tail(&ci->list, &si->nonfull_clusters);
+}
+
+static void cluster_del_nonfull(struct swap_cluster_info *ci)
+{
+	if (!(ci->flags & CLUSTER_FLAG_NONFULL))
+		return;
+	ci->flags &= ~CLUSTER_FLAG_NONFULL;
+	list_del(&ci->list);
+}
+
 static inline struct swap_cluster_info *lock_cluster(struct swap_info_struct *si,
 						     unsigned long offset)
 {
@@ -583,8 +606,12 @@ static void dec_cluster_info_page(struct swap_info_struct *p,
 	cluster_set_count(&cluster_info[idx],
 		cluster_count(&cluster_info[idx]) - 1);
 
-	if (cluster_count(&cluster_info[idx]) == 0)
+	if (cluster_count(&cluster_info[idx]) == 0) {
+		cluster_del_nonfull(&cluster_info[idx]);
 		free_cluster(p, idx);
+	} else {
+		cluster_add_nonfull(p, &cluster_info[idx]);
+	}
 }
 
 /*
@@ -625,7 +652,20 @@ static bool scan_swap_map_try_ssd_cluster(struct swap_info_struct *si,
 new_cluster:
 	cluster = this_cpu_ptr(si->percpu_cluster);
 	if (cluster_is_null(&cluster->index)) {
-		if (!cluster_list_empty(&si->free_clusters)) {
+		if (!list_empty(&si->nonfull_clusters)) {
+			unsigned long idx;
+
+			ci = list_first_entry(&si->nonfull_clusters,
+					      struct swap_cluster_info, list);
+			idx = ci - si->cluster_info;
+			spin_lock(&ci->lock);
+			cluster_del_nonfull(ci);
+			/* Mixed with other entries now, see swap_entry_from_huge() */
+			ci->flags &= ~CLUSTER_FLAG_FROM_HUGE;
+			spin_unlock(&ci->lock);
+			cluster_set_next_flag(&cluster->index, idx, 0);
+			cluster->next = idx * SWAPFILE_CLUSTER;
+		} else if (!cluster_list_empty(&si->free_clusters)) {
 			cluster->index = si->free_clusters.head;
 			cluster->next = cluster_next(&cluster->index) *
 					SWAPFILE_CLUSTER;
@@ -1013,7 +1053,8 @@ static int swap_alloc_cluster(struct swap_info_struct *si, swp_entry_t *slot)
 	offset = idx * SWAPFILE_CLUSTER;
 	ci = lock_cluster(si, offset);
 	alloc_cluster(si, idx);
-	cluster_set_count_flag(ci, SWAPFILE_CLUSTER, CLUSTER_FLAG_HUGE);
+	cluster_set_count_flag(ci, SWAPFILE_CLUSTER,
+			       CLUSTER_FLAG_HUGE | CLUSTER_FLAG_FROM_HUGE);
 
 	memset(si->swap_map + offset, SWAP_HAS_CACHE, SWAPFILE_CLUSTER);
 	unlock_cluster(ci);
@@ -1030,6 +1071,7 @@ static void swap_free_cluster(struct swap_info_struct *si, unsigned long idx)
 
 	ci = lock_cluster(si, offset);
 	memset(si->swap_map + offset, 0, SWAPFILE_CLUSTER);
+	cluster_del_nonfull(ci);
 	cluster_set_count_flag(ci, 0, 0);
 	free_cluster(si, idx);
 	unlock_cluster(ci);
@@ -3047,6 +3089,7 @@ static int setup_swap_map_and_extents(struct swap_info_struct *p,
 
 	cluster_list_init(&p->free_clusters);
 	cluster_list_init(&p->discard_clusters);
+	INIT_LIST_HEAD(&p->nonfull_clusters);
 
 	for (i = 0; i < swap_header->info.nr_badpages; i++) {
 		unsigned int page_nr = swap_header->info.badpages[i];
@@ -3527,6 +3570,28 @@ struct swap_info_struct *swp_swap_info(swp_entry_t entry)
 	return swap_type_to_swap_info(swp_type(entry));
 }
 
+/*
+ * Whether @entry lies in a cluster that was written out as one THP and has
+ * not been reused for other entries since. Reading back the whole cluster
+ * then is sequential IO, of memory that is likely to be used together.
+ * Caller should make sure the swap device is kept alive.
+ */
+bool swap_entry_from_huge(swp_entry_t entry)
+{
+	struct swap_info_struct *si = swp_swap_info(entry);
+	struct swap_cluster_info *ci;
+	bool ret;
+
+	if (!IS_ENABLED(CONFIG_THP_SWAP) || !si->cluster_info)
+		return false;
+
+	ci = lock_cluster(si, swp_offset(entry));
+	ret = ci->flags & CLUSTER_FLAG_FROM_HUGE;
+	unlock_cluster(ci);
+
+	return ret;
+}
+
 struct swap_info_struct *page_swap_info(struct page *page)
 {
 	swp_entry_t entry = { .val = page_private(page) };
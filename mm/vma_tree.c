@@ -0,0 +1,504 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mm/vma_tree.c - RCU-safe B-tree index of the VMAs of an mm
+ *
+ * The rbtree in mm->mm_rb costs a cache miss per level on every lookup and
+ * cannot be walked without mmap_lock. This tree keeps up to VMA_TREE_SLOTS
+ * sorted vm_start keys per node instead, so that a lookup only touches a few
+ * cache lines even with tens of thousands of VMAs. Internal nodes key every
+ * child with the smallest vm_start below it.
+ *
+ * Reachable nodes are never modified, with one exception: vma_tree_move()
+ * updates a key in place when a vm_start moves without passing a neighbour.
+ * Insertions and removals copy the nodes on the path from the leaf to the
+ * root, publish the new root and free the old nodes after a grace period,
+ * so readers under rcu_read_lock() always see a consistent tree. The one
+ * in-place update is harmless to them as well: a key behind the VMA's real
+ * vm_start at worst makes a lookup end one slot early, and then it falls
+ * through to the successor, see vma_tree_find().
+ *
+ * The rbtree is still maintained for the free area search, which needs its
+ * gap augmentation.
+ */
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/vma_tree.h>
+
+/* Makes a node 248 bytes */
+#define VMA_TREE_SLOTS		14
+#define VMA_TREE_MIN_SLOTS	(VMA_TREE_SLOTS / 2)
+/* Plenty for any map_count with at least VMA_TREE_MIN_SLOTS per node */
+#define VMA_TREE_MAX_HEIGHT	12
+
+struct vma_tree_node {
+	unsigned long start[VMA_TREE_SLOTS];
+	void __rcu *slot[VMA_TREE_SLOTS];	/* VMAs or child nodes */
+	unsigned char nr;
+	bool leaf;
+	struct rcu_head rcu;
+};
+
+struct vma_tree_path {
+	struct vma_tree_node *node[VMA_TREE_MAX_HEIGHT];
+	int idx[VMA_TREE_MAX_HEIGHT];
+	int height;
+};
+
+struct vma_tree_op {
+	struct vma_tree_path path;
+	/* The new contents of the node being rebuilt */
+	unsigned long start[2 * VMA_TREE_SLOTS];
+	void *slot[2 * VMA_TREE_SLOTS];
+	int nr;
+	/* Replaced nodes, freed once the new root is visible */
+	struct vma_tree_node *stale[2 * VMA_TREE_MAX_HEIGHT];
+	int nr_stale;
+};
+
+/* Readers hold rcu_read_lock() or the lock that serializes the writers */
+#define vt_deref(p)	rcu_dereference_raw(p)
+
+/* Index of the last key in @node that is <= @addr, -1 if there is none */
+static int vt_slot(struct vma_tree_node *node, unsigned long addr)
+{
+	int i;
+
+	for (i = 0; i < node->nr; i++) {
+		if (READ_ONCE(node->start[i]) > addr)
+			break;
+	}
+	return i - 1;
+}
+
+static void vt_walk(struct vma_tree *vt, unsigned long addr,
+		    struct vma_tree_path *path)
+{
+	struct vma_tree_node *node = vt_deref(vt->root);
+
+	path->height = 0;
+	while (node) {
+		int i = vt_slot(node, addr);
+
+		/* Only leaves can be asked for a position before slot 0 */
+		if (!node->leaf && i < 0)
+			i = 0;
+
+		BUG_ON(path->height == VMA_TREE_MAX_HEIGHT);
+		path->node[path->height] = node;
+		path->idx[path->height] = i;
+		path->height++;
+
+		node = node->leaf ? NULL : vt_deref(node->slot[i]);
+	}
+}
+
+/**
+ * vma_tree_find - look up the first VMA which satisfies addr < vm_end
+ * @vt: the tree
+ * @addr: the address to look up
+ *
+ * Same as find_vma(), without the cache. Callers that only hold
+ * rcu_read_lock() may see a VMA that is being changed or removed and have
+ * to check the result under the VMA's lock.
+ */
+struct vm_area_struct *vma_tree_find(struct vma_tree *vt, unsigned long addr)
+{
+	struct vma_tree_node *node = vt_deref(vt->root);
+	struct vma_tree_node *next = NULL;
+	struct vm_area_struct *vma;
+	int i;
+
+	if (!node)
+		return NULL;
+
+	while (!node->leaf) {
+		i = max(vt_slot(node, addr), 0);
+		if (i + 1 < node->nr)
+			next = vt_deref(node->slot[i + 1]);
+		node = vt_deref(node->slot[i]);
+	}
+
+	i = vt_slot(node, addr);
+	if (i >= 0) {
+		vma = vt_deref(node->slot[i]);
+		if (READ_ONCE(vma->vm_end) > addr)
+			return vma;
+	}
+	if (i + 1 < node->nr)
+		return vt_deref(node->slot[i + 1]);
+
+	/* The successor is the first VMA of the next subtree */
+	if (!next)
+		return NULL;
+	while (!next->leaf)
+		next = vt_deref(next->slot[0]);
+	return vt_deref(next->slot[0]);
+}
+
+static struct vma_tree_node *vt_node_alloc(bool leaf)
+{
+	struct vma_tree_node *node;
+
+	/*
+	 * Callers are in the middle of changing the VMAs and cannot back
+	 * out, and a node is far below the costly allocation order.
+	 */
+	node = kmalloc(sizeof(*node), GFP_KERNEL | __GFP_NOFAIL);
+	node->nr = 0;
+	node->leaf = leaf;
+
+	return node;
+}
+
+static void vt_load(struct vma_tree_op *op, struct vma_tree_node *node)
+{
+	int i;
+
+	for (i = 0; i < node->nr; i++) {
+		op->start[i] = node->start[i];
+		op->slot[i] = vt_deref(node->slot[i]);
+	}
+	op->nr = node->nr;
+}
+
+/* Make room for @nr_ins entries at @pos, replacing @nr_del of them */
+static void vt_splice(struct vma_tree_op *op, int pos, int nr_del, int nr_ins)
+{
+	int tail = op->nr - pos - nr_del;
+
+	memmove(&op->start[pos + nr_ins], &op->start[pos + nr_del],
+		tail * sizeof(op->start[0]));
+	memmove(&op->slot[pos + nr_ins], &op->slot[pos + nr_del],
+		tail * sizeof(op->slot[0]));
+	op->nr += nr_ins - nr_del;
+}
+
+static void vt_set_children(struct vma_tree_op *op, int pos,
+			    struct vma_tree_node **nodes, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		op->start[pos + i] = nodes[i]->start[0];
+		op->slot[pos + i] = nodes[i];
+	}
+}
+
+/*
+ * Move the scratch array into a new node, or into two if it does not fit.
+ * Returns the number of nodes stored in @nodes.
+ */
+static int vt_build(struct vma_tree_op *op, bool leaf,
+		    struct vma_tree_node **nodes)
+{
+	int nr_nodes = op->nr > VMA_TREE_SLOTS ? 2 : 1;
+	int from = 0;
+	int i, n;
+
+	for (n = 0; n < nr_nodes; n++) {
+		struct vma_tree_node *node = vt_node_alloc(leaf);
+		int to = n + 1 < nr_nodes ? op->nr / 2 : op->nr;
+
+		for (i = from; i < to; i++) {
+			node->start[i - from] = op->start[i];
+			RCU_INIT_POINTER(node->slot[i - from], op->slot[i]);
+		}
+		node->nr = to - from;
+		nodes[n] = node;
+		from = to;
+	}
+
+	return nr_nodes;
+}
+
+static void vt_stale(struct vma_tree_op *op, struct vma_tree_node *node)
+{
+	op->stale[op->nr_stale++] = node;
+}
+
+static void vt_publish(struct vma_tree *vt, struct vma_tree_node *root,
+		       struct vma_tree_op *op)
+{
+	int i;
+
+	rcu_assign_pointer(vt->root, root);
+
+	/* Lookups that started before the new root may still be in them */
+	for (i = 0; i < op->nr_stale; i++)
+		kfree_rcu(op->stale[i], rcu);
+}
+
+/**
+ * vma_tree_insert - add a VMA to the tree
+ * @vt: the tree
+ * @vma: the VMA, keyed by its vm_start, which must not be in the tree yet
+ */
+void vma_tree_insert(struct vma_tree *vt, struct vm_area_struct *vma)
+{
+	struct vma_tree_node *nodes[2];
+	struct vma_tree_op op;
+	int h, pos, nr;
+
+	vt_walk(vt, vma->vm_start, &op.path);
+	op.nr_stale = 0;
+	op.nr = 0;
+
+	if (!op.path.height) {
+		op.start[0] = vma->vm_start;
+		op.slot[0] = vma;
+		op.nr = 1;
+		vt_build(&op, true, nodes);
+		vt_publish(vt, nodes[0], &op);
+		return;
+	}
+
+	h = op.path.height - 1;
+	vt_load(&op, op.path.node[h]);
+	pos = op.path.idx[h] + 1;
+	vt_splice(&op, pos, 0, 1);
+	op.start[pos] = vma->vm_start;
+	op.slot[pos] = vma;
+
+	for (;;) {
+		struct vma_tree_node *node = op.path.node[h];
+
+		nr = vt_build(&op, node->leaf, nodes);
+		vt_stale(&op, node);
+		if (!h)
+			break;
+
+		h--;
+		vt_load(&op, op.path.node[h]);
+		pos = op.path.idx[h];
+		vt_splice(&op, pos, 1, nr);
+		vt_set_children(&op, pos, nodes, nr);
+	}
+
+	if (nr > 1) {
+		/* The root was split, grow a level */
+		op.nr = 0;
+		vt_splice(&op, 0, 0, nr);
+		vt_set_children(&op, 0, nodes, nr);
+		vt_build(&op, false, nodes);
+	}
+	vt_publish(vt, nodes[0], &op);
+}
+
+/**
+ * vma_tree_erase - remove a VMA from the tree
+ * @vt: the tree
+ * @vma: the VMA, whose vm_start must still be the key it is stored under
+ */
+void vma_tree_erase(struct vma_tree *vt, struct vm_area_struct *vma)
+{
+	struct vma_tree_node *nodes[2], *node, *root;
+	struct vma_tree_op op;
+	int h, pos, nr, nr_del, i;
+
+	vt_walk(vt, vma->vm_start, &op.path);
+	op.nr_stale = 0;
+
+	if (WARN_ON_ONCE(!op.path.height))
+		return;
+
+	h = op.path.height - 1;
+	node = op.path.node[h];
+	pos = op.path.idx[h];
+	if (WARN_ON_ONCE(pos < 0 || vt_deref(node->slot[pos]) != vma))
+		return;
+
+	vt_load(&op, node);
+	vt_splice(&op, pos, 1, 0);
+
+	for (; h > 0; h--) {
+		struct vma_tree_node *parent = op.path.node[h - 1];
+
+		node = op.path.node[h];
+		pos = op.path.idx[h - 1];
+		vt_stale(&op, node);
+
+		if (op.nr >= VMA_TREE_MIN_SLOTS) {
+			nr = vt_build(&op, node->leaf, nodes);
+			nr_del = 1;
+		} else if (!op.nr) {
+			nr = 0;
+			nr_del = 1;
+		} else {
+			/* Underfull, merge with a sibling */
+			int sib = pos + 1 < parent->nr ? pos + 1 : pos - 1;
+			struct vma_tree_node *sibling;
+			int at;
+
+			sibling = vt_deref(parent->slot[sib]);
+			vt_stale(&op, sibling);
+			if (sib < pos) {
+				vt_splice(&op, 0, 0, sibling->nr);
+				at = 0;
+				pos = sib;
+			} else {
+				at = op.nr;
+				op.nr += sibling->nr;
+			}
+			for (i = 0; i < sibling->nr; i++) {
+				op.start[at + i] = sibling->start[i];
+				op.slot[at + i] = vt_deref(sibling->slot[i]);
+			}
+			nr = vt_build(&op, node->leaf, nodes);
+			nr_del = 2;
+		}
+
+		vt_load(&op, parent);
+		vt_splice(&op, pos, nr_del, nr);
+		vt_set_children(&op, pos, nodes, nr);
+	}
+
+	node = op.path.node[0];
+	vt_stale(&op, node);
+	if (!op.nr) {
+		root = NULL;
+	} else if (!node->leaf && op.nr == 1) {
+		/* A single child left, shrink a level */
+		root = op.slot[0];
+	} else {
+		vt_build(&op, node->leaf, nodes);
+		root = nodes[0];
+	}
+	vt_publish(vt, root, &op);
+}
+
+/**
+ * vma_tree_move - update the key of a VMA after its vm_start changed
+ * @vt: the tree
+ * @vma: the VMA, with vma->vm_start already updated
+ * @old_start: the vm_start the VMA is stored under
+ *
+ * The new vm_start must not move the VMA past its neighbours. Does not
+ * allocate, so this can be called under a spinlock.
+ */
+void vma_tree_move(struct vma_tree *vt, struct vm_area_struct *vma,
+		   unsigned long old_start)
+{
+	struct vma_tree_path path;
+	struct vma_tree_node *node;
+	int h, i;
+
+	vt_walk(vt, old_start, &path);
+	if (WARN_ON_ONCE(!path.height))
+		return;
+
+	h = path.height - 1;
+	node = path.node[h];
+	i = path.idx[h];
+	if (WARN_ON_ONCE(i < 0 || vt_deref(node->slot[i]) != vma))
+		return;
+
+	WRITE_ONCE(node->start[i], vma->vm_start);
+	/* The first key of a node is also its key in the parent */
+	while (!i && h) {
+		h--;
+		i = path.idx[h];
+		WRITE_ONCE(path.node[h]->start[i], vma->vm_start);
+	}
+}
+
+/**
+ * vma_tree_build - index a sorted list of VMAs in an empty tree
+ * @vt: the tree, which must be empty and not visible to lockless lookups
+ * @vma: the first VMA of the list, linked through vm_next
+ * @nr: the number of VMAs in the list
+ *
+ * Used by fork, which links the VMAs of the child in address order. All
+ * nodes are allocated up front, so unlike the other updates this can fail
+ * and leave the tree untouched.
+ *
+ * Return: 0 on success, -ENOMEM if the nodes cannot be allocated.
+ */
+int vma_tree_build(struct vma_tree *vt, struct vm_area_struct *vma, int nr)
+{
+	struct vma_tree_node **nodes, *node;
+	int total = 0, base = 0, n, k, i, j;
+
+	if (WARN_ON_ONCE(rcu_access_pointer(vt->root)) || !nr)
+		return 0;
+
+	n = nr;
+	do {
+		n = DIV_ROUND_UP(n, VMA_TREE_SLOTS);
+		total += n;
+	} while (n > 1);
+
+	nodes = kvmalloc_array(total, sizeof(*nodes), GFP_KERNEL);
+	if (!nodes)
+		return -ENOMEM;
+	for (i = 0; i < total; i++) {
+		nodes[i] = kmalloc(sizeof(*nodes[i]), GFP_KERNEL);
+		if (!nodes[i]) {
+			while (i--)
+				kfree(nodes[i]);
+			kvfree(nodes);
+			return -ENOMEM;
+		}
+	}
+
+	/*
+	 * Spread the entries of each level evenly over as few nodes as
+	 * possible, which keeps every node at least VMA_TREE_MIN_SLOTS full.
+	 */
+	n = nr;
+	k = DIV_ROUND_UP(n, VMA_TREE_SLOTS);
+	for (j = 0; j < k; j++) {
+		node = nodes[j];
+		node->leaf = true;
+		node->nr = n / k + (j < n % k);
+		for (i = 0; i < node->nr; i++, vma = vma->vm_next) {
+			node->start[i] = vma->vm_start;
+			RCU_INIT_POINTER(node->slot[i], vma);
+		}
+	}
+
+	while (k > 1) {
+		struct vma_tree_node **child = &nodes[base];
+
+		base += k;
+		n = k;
+		k = DIV_ROUND_UP(n, VMA_TREE_SLOTS);
+		for (j = 0; j < k; j++) {
+			node = nodes[base + j];
+			node->leaf = false;
+			node->nr = n / k + (j < n % k);
+			for (i = 0; i < node->nr; i++, child++) {
+				node->start[i] = (*child)->start[0];
+				RCU_INIT_POINTER(node->slot[i], *child);
+			}
+		}
+	}
+
+	rcu_assign_pointer(vt->root, nodes[base]);
+	kvfree(nodes);
+
+	return 0;
+}
+
+static void vt_destroy(struct vma_tree_node *node)
+{
+	int i;
+
+	if (!node->leaf) {
+		for (i = 0; i < node->nr; i++)
+			vt_destroy(vt_deref(node->slot[i]));
+	}
+	kfree(node);
+}
+
+/**
+ * vma_tree_destroy - free the tree, but not the VMAs in it
+ * @vt: the tree of an mm that has no users left
+ */
+void vma_tree_destroy(struct vma_tree *vt)
+{
+	struct vma_tree_node *root = vt_deref(vt->root);
+
+	RCU_INIT_POINTER(vt->root, NULL);
+	if (root)
+		vt_destroy(root);
+}
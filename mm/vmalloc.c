@@ -723,10 +723,6 @@ LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 static bool vmap_initialized __read_mostly;
 
-static struct rb_root purge_vmap_area_root = RB_ROOT;
-static LIST_HEAD(purge_vmap_area_list);
-static DEFINE_SPINLOCK(purge_vmap_area_lock);
-
 /*
  * This kmem_cache is used for vmap_area objects. Instead of
  * allocating from slab we reuse an object from this cache to
@@ -760,6 +756,55 @@ static struct rb_root free_vmap_area_root = RB_ROOT;
  */
 static DEFINE_PER_CPU(struct vmap_area *, ne_fit_preload_node);
 
+/*
+ * The vmap space is split into zones.  Every zone keeps the lazily freed
+ * areas whose start address falls into it, interleaved at VMAP_ZONE_SHIFT
+ * granularity, so that freeing threads do not all serialize on one lock.
+ *
+ * Once their TLB entries are flushed, areas of up to MAX_VA_SIZE_PAGES are
+ * not merged back into the free tree but kept in size segregated pools of
+ * the zone.  Allocations try the pool of the zone of their CPU first, which
+ * hands out an area of the exact size without taking free_vmap_area_lock.
+ * The pools are returned to the free tree when the vmap space runs out.
+ */
+#define VMAP_ZONE_SHIFT		(PAGE_SHIFT + 4)
+#define MAX_VA_SIZE_PAGES	256
+/* Pool entries looked at for a matching range and alignment */
+#define VMAP_POOL_SCAN		8
+
+struct vmap_pool {
+	struct list_head head;
+	unsigned long len;
+};
+
+struct vmap_zone {
+	/* Lazily freed areas waiting for a TLB flush */
+	spinlock_t lazy_lock;
+	struct rb_root lazy_root;
+	struct list_head lazy_list;
+	/* Detached by the running purge, protected by vmap_purge_lock */
+	struct list_head purge_list;
+
+	spinlock_t pool_lock;
+	struct vmap_pool pool[MAX_VA_SIZE_PAGES];
+	unsigned long pool_pages;
+	unsigned long pool_hits;
+};
+
+static struct vmap_zone single_vmap_zone;
+static struct vmap_zone *vmap_zones = &single_vmap_zone;
+static unsigned int nr_vmap_zones __read_mostly = 1;
+
+static inline struct vmap_zone *addr_to_vmap_zone(unsigned long addr)
+{
+	return &vmap_zones[(addr >> VMAP_ZONE_SHIFT) % nr_vmap_zones];
+}
+
+static inline struct vmap_zone *this_cpu_vmap_zone(void)
+{
+	return &vmap_zones[raw_smp_processor_id() % nr_vmap_zones];
+}
+
 static __always_inline unsigned long
 va_size(struct vmap_area *va)
 {
@@ -1504,6 +1549,46 @@ preload_this_cpu_lock(spinlock_t *lock, gfp_t gfp_mask, int node)
 		kmem_cache_free(vmap_area_cachep, va);
 }
 
+/*
+ * Take an area of exactly @size that satisfies @align, @vstart and @vend
+ * from the pool of this CPU's zone, or return NULL.
+ */
+static struct vmap_area *vmap_pool_get(unsigned long size, unsigned long align,
+				       unsigned long vstart, unsigned long vend)
+{
+	unsigned long idx = (size >> PAGE_SHIFT) - 1;
+	struct vmap_area *va, *found = NULL;
+	struct vmap_zone *vz;
+	struct vmap_pool *vp;
+	int scanned = 0;
+
+	if (idx >= MAX_VA_SIZE_PAGES)
+		return NULL;
+
+	vz = this_cpu_vmap_zone();
+	vp = &vz->pool[idx];
+	if (!READ_ONCE(vp->len))
+		return NULL;
+
+	spin_lock(&vz->pool_lock);
+	list_for_each_entry(va, &vp->head, list) {
+		if (IS_ALIGNED(va->va_start, align) &&
+		    va->va_start >= vstart && va->va_end <= vend) {
+			list_del(&va->list);
+			WRITE_ONCE(vp->len, vp->len - 1);
+			vz->pool_pages -= size >> PAGE_SHIFT;
+			vz->pool_hits++;
+			found = va;
+			break;
+		}
+		if (++scanned == VMAP_POOL_SCAN)
+			break;
+	}
+	spin_unlock(&vz->pool_lock);
+
+	return found;
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -1529,6 +1614,12 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	might_sleep();
 	gfp_mask = gfp_mask & GFP_RECLAIM_MASK;
 
+	va = vmap_pool_get(size, align, vstart, vend);
+	if (va) {
+		addr = va->va_start;
+		goto insert;
+	}
+
 	va = kmem_cache_alloc_node(vmap_area_cachep, gfp_mask, node);
 	if (unlikely(!va))
 		return ERR_PTR(-ENOMEM);
@@ -1553,6 +1644,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 	va->va_start = addr;
 	va->va_end = addr + size;
+insert:
 	va->vm = NULL;
 
 	spin_lock(&vmap_area_lock);
@@ -1622,10 +1714,29 @@ EXPORT_SYMBOL_GPL(unregister_vmap_purge_notifier);
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
+static unsigned long vmap_lazy_budget __ro_after_init;
+
+/*
+ * "vmap_lazy_budget=<size>" replaces the log scale below with a fixed amount
+ * of lazily freed address space.
+ */
+static int __init set_vmap_lazy_budget(char *str)
+{
+	if (!str)
+		return -EINVAL;
+
+	vmap_lazy_budget = memparse(str, &str) >> PAGE_SHIFT;
+	return 0;
+}
+early_param("vmap_lazy_budget", set_vmap_lazy_budget);
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
+	if (vmap_lazy_budget)
+		return vmap_lazy_budget;
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -1655,37 +1766,37 @@ void set_iounmap_nonlazy(void)
 #endif /* CONFIG_X86_64 */
 
 /*
- * Purges all lazily-freed vmap areas.
+ * Merge the purged areas of a zone back into the free tree, except for the
+ * ones that fit into its pools.  Called with vmap_purge_lock held, after the
+ * TLB has been flushed for all of them.
  */
-static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
+static void purge_vmap_zone(struct vmap_zone *vz)
 {
-	unsigned long resched_threshold;
-	struct list_head local_pure_list;
+	unsigned long resched_threshold = lazy_max_pages() << 1;
+	unsigned long pool_max = lazy_max_pages() / nr_vmap_zones;
 	struct vmap_area *va, *n_va;
 
-	lockdep_assert_held(&vmap_purge_lock);
-
-	spin_lock(&purge_vmap_area_lock);
-	purge_vmap_area_root = RB_ROOT;
-	list_replace_init(&purge_vmap_area_list, &local_pure_list);
-	spin_unlock(&purge_vmap_area_lock);
-
-	if (unlikely(list_empty(&local_pure_list)))
-		return false;
+	spin_lock(&vz->pool_lock);
+	list_for_each_entry_safe(va, n_va, &vz->purge_list, list) {
+		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
+		struct vmap_pool *vp;
 
-	start = min(start,
-		list_first_entry(&local_pure_list,
-			struct vmap_area, list)->va_start);
+		if (nr > MAX_VA_SIZE_PAGES || vz->pool_pages + nr > pool_max)
+			continue;
 
-	end = max(end,
-		list_last_entry(&local_pure_list,
-			struct vmap_area, list)->va_end);
+		vp = &vz->pool[nr - 1];
+		list_move(&va->list, &vp->head);
+		WRITE_ONCE(vp->len, vp->len + 1);
+		vz->pool_pages += nr;
+		atomic_long_sub(nr, &vmap_lazy_nr);
+	}
+	spin_unlock(&vz->pool_lock);
 
-	flush_tlb_kernel_range(start, end);
-	resched_threshold = lazy_max_pages() << 1;
+	if (list_empty(&vz->purge_list))
+		return;
 
 	spin_lock(&free_vmap_area_lock);
-	list_for_each_entry_safe(va, n_va, &local_pure_list, list) {
+	list_for_each_entry_safe(va, n_va, &vz->purge_list, list) {
 		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
 		unsigned long orig_start = va->va_start;
 		unsigned long orig_end = va->va_end;
@@ -1711,9 +1822,98 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 			cond_resched_lock(&free_vmap_area_lock);
 	}
 	spin_unlock(&free_vmap_area_lock);
+	INIT_LIST_HEAD(&vz->purge_list);
+}
+
+/*
+ * Purges all lazily-freed vmap areas.
+ */
+static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
+{
+	bool found = false;
+	struct vmap_zone *vz;
+	int i;
+
+	lockdep_assert_held(&vmap_purge_lock);
+
+	for (i = 0; i < nr_vmap_zones; i++) {
+		vz = &vmap_zones[i];
+
+		spin_lock(&vz->lazy_lock);
+		vz->lazy_root = RB_ROOT;
+		list_replace_init(&vz->lazy_list, &vz->purge_list);
+		spin_unlock(&vz->lazy_lock);
+
+		if (list_empty(&vz->purge_list))
+			continue;
+
+		start = min(start, list_first_entry(&vz->purge_list,
+				struct vmap_area, list)->va_start);
+		end = max(end, list_last_entry(&vz->purge_list,
+				struct vmap_area, list)->va_end);
+		found = true;
+	}
+
+	if (unlikely(!found))
+		return false;
+
+	/* One flush for all the zones */
+	flush_tlb_kernel_range(start, end);
+
+	for (i = 0; i < nr_vmap_zones; i++)
+		purge_vmap_zone(&vmap_zones[i]);
+
 	return true;
 }
 
+/*
+ * Give the areas cached in the pools back to the free tree, so that they
+ * can be merged with their neighbours again.
+ */
+static void drain_vmap_pools(void)
+{
+	struct vmap_area *va, *n_va;
+	LIST_HEAD(local_list);
+	int i, j;
+
+	for (i = 0; i < nr_vmap_zones; i++) {
+		struct vmap_zone *vz = &vmap_zones[i];
+
+		spin_lock(&vz->pool_lock);
+		for (j = 0; j < MAX_VA_SIZE_PAGES; j++) {
+			list_splice_init(&vz->pool[j].head, &local_list);
+			WRITE_ONCE(vz->pool[j].len, 0);
+		}
+		vz->pool_pages = 0;
+		spin_unlock(&vz->pool_lock);
+	}
+
+	if (list_empty(&local_list))
+		return;
+
+	spin_lock(&free_vmap_area_lock);
+	list_for_each_entry_safe(va, n_va, &local_list, list) {
+		unsigned long orig_start = va->va_start;
+		unsigned long orig_end = va->va_end;
+
+		va = merge_or_add_vmap_area_augment(va, &free_vmap_area_root,
+				&free_vmap_area_list);
+		if (va && is_vmalloc_or_module_addr((void *)orig_start))
+			kasan_release_vmalloc(orig_start, orig_end,
+					      va->va_start, va->va_end);
+		cond_resched_lock(&free_vmap_area_lock);
+	}
+	spin_unlock(&free_vmap_area_lock);
+}
+
+static void drain_vmap_area_work(struct work_struct *work)
+{
+	mutex_lock(&vmap_purge_lock);
+	__purge_vmap_area_lazy(ULONG_MAX, 0);
+	mutex_unlock(&vmap_purge_lock);
+}
+static DECLARE_WORK(drain_vmap_work, drain_vmap_area_work);
+
 /*
  * Kick off a purge of the outstanding lazy areas. Don't bother if somebody
  * is already purging.
@@ -1727,13 +1927,15 @@ static void try_purge_vmap_area_lazy(void)
 }
 
 /*
- * Kick off a purge of the outstanding lazy areas.
+ * Kick off a purge of the outstanding lazy areas.  Only called when the
+ * vmap space is exhausted, so also empty the pools.
  */
 static void purge_vmap_area_lazy(void)
 {
 	mutex_lock(&vmap_purge_lock);
 	purge_fragmented_blocks_allcpus();
 	__purge_vmap_area_lazy(ULONG_MAX, 0);
+	drain_vmap_pools();
 	mutex_unlock(&vmap_purge_lock);
 }
 
@@ -1744,7 +1946,8 @@ static void purge_vmap_area_lazy(void)
  */
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
-	unsigned long nr_lazy;
+	struct vmap_zone *vz = addr_to_vmap_zone(va->va_start);
+	unsigned long nr_lazy, nr_lazy_max = lazy_max_pages();
 
 	spin_lock(&vmap_area_lock);
 	unlink_va(va, &vmap_area_root);
@@ -1754,16 +1957,23 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 				PAGE_SHIFT, &vmap_lazy_nr);
 
 	/*
-	 * Merge or place it to the purge tree/list.
+	 * Merge or place it to the purge tree/list of its zone.
 	 */
-	spin_lock(&purge_vmap_area_lock);
-	merge_or_add_vmap_area(va,
-		&purge_vmap_area_root, &purge_vmap_area_list);
-	spin_unlock(&purge_vmap_area_lock);
+	spin_lock(&vz->lazy_lock);
+	merge_or_add_vmap_area(va, &vz->lazy_root, &vz->lazy_list);
+	spin_unlock(&vz->lazy_lock);
 
-	/* After this point, we may free va at any time */
-	if (unlikely(nr_lazy > lazy_max_pages()))
-		try_purge_vmap_area_lazy();
+	/*
+	 * After this point, we may free va at any time.  The purge is left
+	 * to a worker, unless it falls that far behind that freeing has to
+	 * be throttled.
+	 */
+	if (unlikely(nr_lazy > nr_lazy_max)) {
+		if (nr_lazy > 2 * nr_lazy_max)
+			try_purge_vmap_area_lazy();
+		else
+			schedule_work(&drain_vmap_work);
+	}
 }
 
 /*
@@ -2325,6 +2535,41 @@ static void vmap_init_free_space(void)
 	}
 }
 
+static void __init vmap_init_zones(void)
+{
+	struct vmap_zone *zones;
+	unsigned int n;
+	int i, j;
+
+	/* One zone per CPU, but keep the pools of large machines bounded */
+	n = rounddown_pow_of_two(clamp_t(unsigned int, num_possible_cpus(),
+					 1, 128));
+	if (n > 1) {
+		zones = kmalloc_array(n, sizeof(*zones), GFP_NOWAIT);
+		if (zones) {
+			vmap_zones = zones;
+			nr_vmap_zones = n;
+		}
+	}
+
+	for (i = 0; i < nr_vmap_zones; i++) {
+		struct vmap_zone *vz = &vmap_zones[i];
+
+		spin_lock_init(&vz->lazy_lock);
+		vz->lazy_root = RB_ROOT;
+		INIT_LIST_HEAD(&vz->lazy_list);
+		INIT_LIST_HEAD(&vz->purge_list);
+
+		spin_lock_init(&vz->pool_lock);
+		for (j = 0; j < MAX_VA_SIZE_PAGES; j++) {
+			INIT_LIST_HEAD(&vz->pool[j].head);
+			vz->pool[j].len = 0;
+		}
+		vz->pool_pages = 0;
+		vz->pool_hits = 0;
+	}
+}
+
 void __init vmalloc_init(void)
 {
 	struct vmap_area *va;
@@ -2336,6 +2581,8 @@ void __init vmalloc_init(void)
 	 */
 	vmap_area_cachep = KMEM_CACHE(vmap_area, SLAB_PANIC);
 
+	vmap_init_zones();
+
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
 		struct vfree_deferred *p;
@@ -2813,53 +3060,85 @@ void *vmap_pfn(unsigned long *pfns, unsigned int count, pgprot_t prot)
 EXPORT_SYMBOL_GPL(vmap_pfn);
 #endif /* CONFIG_VMAP_PFN */
 
+/*
+ * The bulk allocator takes a preferred node rather than a memory policy.
+ * For NUMA_NO_NODE requests it is only used when the task has no policy
+ * of its own that alloc_pages() would otherwise honour.
+ */
+static inline int vm_area_bulk_nid(int nid)
+{
+	if (nid != NUMA_NO_NODE)
+		return nid;
+
+#ifdef CONFIG_NUMA
+	if (current->mempolicy)
+		return NUMA_NO_NODE;
+#endif
+	return numa_mem_id();
+}
+
 static inline unsigned int
 vm_area_alloc_pages(gfp_t gfp, int nid,
 		unsigned int order, unsigned int nr_pages, struct page **pages)
 {
 	unsigned int nr_allocated = 0;
+	int bulk_nid = vm_area_bulk_nid(nid);
 	struct page *page;
 	int i;
 
 	/*
-	 * For order-0 pages we make use of bulk allocator, if
-	 * the page array is partly or not at all populated due
-	 * to fails, fallback to a single page allocator that is
-	 * more permissive.
+	 * Compound pages required for remap_vmalloc_page if
+	 * high-order pages.
 	 */
-	if (!order && nid != NUMA_NO_NODE) {
-		while (nr_allocated < nr_pages) {
-			unsigned int nr, nr_pages_request;
+	if (order)
+		gfp |= __GFP_COMP;
 
-			/*
-			 * A maximum allowed request is hard-coded and is 100
-			 * pages per call. That is done in order to prevent a
-			 * long preemption off scenario in the bulk-allocator
-			 * so the range is [1:100].
-			 */
-			nr_pages_request = min(100U, nr_pages - nr_allocated);
+	/*
+	 * Make use of the bulk allocator first, if the page array is
+	 * partly or not at all populated due to fails, fallback to a
+	 * single page allocator that is more permissive.
+	 */
+	while (bulk_nid != NUMA_NO_NODE && nr_allocated < nr_pages) {
+		unsigned int nr, nr_pages_request;
 
-			nr = alloc_pages_bulk_array_node(gfp, nid,
+		/*
+		 * A maximum allowed request is hard-coded and is 100
+		 * allocations per call. That is done in order to prevent a
+		 * long preemption off scenario in the bulk-allocator
+		 * so the range is [1:100].
+		 */
+		nr_pages_request = min(100U, (nr_pages - nr_allocated) >> order);
+
+		nr = alloc_pages_bulk_array_order_node(gfp, bulk_nid, order,
 				nr_pages_request, pages + nr_allocated);
 
-			nr_allocated += nr;
-			cond_resched();
+		/*
+		 * The bulk allocator stored one head page per entry; spread
+		 * them out to one entry per PAGE_SIZE page, back to front
+		 * so that no head is overwritten before it is expanded.
+		 */
+		if (order) {
+			int j;
 
-			/*
-			 * If zero or pages were obtained partly,
-			 * fallback to a single page allocator.
-			 */
-			if (nr != nr_pages_request)
-				break;
+			for (j = (int)nr - 1; j >= 0; j--) {
+				page = pages[nr_allocated + j];
+				for (i = (1U << order) - 1; i >= 0; i--)
+					pages[nr_allocated + (j << order) + i] = page + i;
+			}
 		}
-	} else if (order)
+
+		nr_allocated += nr << order;
+		cond_resched();
+
 		/*
-		 * Compound pages required for remap_vmalloc_page if
-		 * high-order pages.
+		 * If zero or pages were obtained partly,
+		 * fallback to a single page allocator.
 		 */
-		gfp |= __GFP_COMP;
+		if (nr != nr_pages_request)
+			break;
+	}
 
-	/* High-order pages or fallback path if "bulk" fails. */
+	/* Fallback path if "bulk" fails or cannot honour the policy. */
 
 	while (nr_allocated < nr_pages) {
 		if (nid == NUMA_NO_NODE)
@@ -3882,14 +4161,19 @@ static void show_numa_info(struct seq_file *m, struct vm_struct *v)
 static void show_purge_info(struct seq_file *m)
 {
 	struct vmap_area *va;
+	int i;
 
-	spin_lock(&purge_vmap_area_lock);
-	list_for_each_entry(va, &purge_vmap_area_list, list) {
-		seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
-			(void *)va->va_start, (void *)va->va_end,
-			va->va_end - va->va_start);
+	for (i = 0; i < nr_vmap_zones; i++) {
+		struct vmap_zone *vz = &vmap_zones[i];
+
+		spin_lock(&vz->lazy_lock);
+		list_for_each_entry(va, &vz->lazy_list, list) {
+			seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
+				(void *)va->va_start, (void *)va->va_end,
+				va->va_end - va->va_start);
+		}
+		spin_unlock(&vz->lazy_lock);
 	}
-	spin_unlock(&purge_vmap_area_lock);
 }
 
 static int s_show(struct seq_file *m, void *p)
@@ -3962,6 +4246,53 @@ static const struct seq_operations vmalloc_op = {
 	.show = s_show,
 };
 
+/*
+ * Fragmentation of the vmap space: the free tree as a whole, then per zone
+ * the lazily freed areas and the areas cached in its pools.
+ */
+static int vmallocfrag_show(struct seq_file *m, void *v)
+{
+	unsigned long nr_free = 0, free_sz = 0, largest = 0, sz;
+	struct vmap_area *va;
+	int i;
+
+	spin_lock(&free_vmap_area_lock);
+	list_for_each_entry(va, &free_vmap_area_list, list) {
+		sz = va_size(va);
+		nr_free++;
+		free_sz += sz;
+		largest = max(largest, sz);
+	}
+	spin_unlock(&free_vmap_area_lock);
+
+	seq_printf(m, "free_areas %lu\n", nr_free);
+	seq_printf(m, "free_bytes %lu\n", free_sz);
+	seq_printf(m, "largest_free_bytes %lu\n", largest);
+	seq_printf(m, "lazy_bytes %lu\n",
+		   atomic_long_read(&vmap_lazy_nr) << PAGE_SHIFT);
+
+	for (i = 0; i < nr_vmap_zones; i++) {
+		struct vmap_zone *vz = &vmap_zones[i];
+		unsigned long nr_lazy = 0, nr_pooled = 0;
+		int j;
+
+		spin_lock(&vz->lazy_lock);
+		list_for_each_entry(va, &vz->lazy_list, list)
+			nr_lazy++;
+		spin_unlock(&vz->lazy_lock);
+
+		spin_lock(&vz->pool_lock);
+		for (j = 0; j < MAX_VA_SIZE_PAGES; j++)
+			nr_pooled += vz->pool[j].len;
+		seq_printf(m, "zone %d lazy_areas %lu pooled_areas %lu pooled_bytes %lu pool_hits %lu\n",
+			   i, nr_lazy, nr_pooled, vz->pool_pages << PAGE_SHIFT,
+			   vz->pool_hits);
+		spin_unlock(&vz->pool_lock);
+	}
+
+	return 0;
+}
+
 static int __init proc_vmalloc_init(void)
 {
 	if (IS_ENABLED(CONFIG_NUMA))
@@ -3970,6 +4301,7 @@ static int __init proc_vmalloc_init(void)
 				nr_node_ids * sizeof(unsigned int), NULL);
 	else
 		proc_create_seq("vmallocinfo", 0400, NULL, &vmalloc_op);
+	proc_create_single("vmallocfrag", 0400, NULL, vmallocfrag_show);
 	return 0;
 }
 module_init(proc_vmalloc_init);
@@ -56,6 +56,7 @@
 
 #include <linux/swapops.h>
 #include <linux/balloon_compaction.h>
+#include <linux/lru_gen.h>
 
 #include "internal.h"
 
@@ -140,6 +141,12 @@ struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
 
+	/* Sum of nr_scanned over all priority levels */
+	unsigned long nr_scanned_total;
+
+	/* Swappiness override for proactive memcg reclaim, or NULL */
+	int *proactive_swappiness;
+
 	/* Number of pages freed so far during a call to shrink_zones() */
 	unsigned long nr_reclaimed;
 
@@ -1233,6 +1240,20 @@ static enum page_references page_check_references(struct page *page,
 	int referenced_ptes, referenced_page;
 	unsigned long vm_flags;
 
+	/*
+	 * The aging passes already looked at the page tables mapping the
+	 * page: activate it if one of the last two found it young, reclaim
+	 * it if none of them did. try_to_unmap() still catches mlocked pages.
+	 */
+	if (lru_gen_enabled() && page_mapped(page)) {
+		int young = lru_gen_test_clear_young(page);
+
+		if (young >= 0) {
+			ClearPageReferenced(page);
+			return young ? PAGEREF_ACTIVATE : PAGEREF_RECLAIM;
+		}
+	}
+
 	referenced_ptes = page_referenced(page, 1, sc->target_mem_cgroup,
 					  &vm_flags);
 	referenced_page = TestClearPageReferenced(page);
@@ -1744,8 +1765,16 @@ static unsigned int shrink_page_list(struct list_head *page_list,
 			count_vm_event(PGLAZYFREED);
 			count_memcg_page_event(page, PGLAZYFREED);
 		} else if (!mapping || !__remove_mapping(mapping, page, true,
-							 sc->target_mem_cgroup))
+							 sc->target_mem_cgroup)) {
 			goto keep_locked;
+		} else if (references == PAGEREF_RECLAIM &&
+			   page_is_file_lru(page) && !PageWorkingset(page)) {
+			/*
+			 * Never referenced and never active: most likely
+			 * brought in by readahead and not used.
+			 */
+			count_vm_events(PGREADAHEAD_WASTED, nr_pages);
+		}
 
 		unlock_page(page);
 free_it:
@@ -2390,6 +2419,22 @@ static void shrink_active_list(unsigned long nr_to_scan,
 			}
 		}
 
+		/*
+		 * The aging pass already told us whether a mapped page was
+		 * accessed recently, rotate or deactivate it based on that.
+		 */
+		if (lru_gen_enabled() && page_mapped(page)) {
+			int young = lru_gen_test_clear_young(page);
+
+			if (young > 0) {
+				nr_rotated += thp_nr_pages(page);
+				list_add(&page->lru, &l_active);
+				continue;
+			}
+			if (young == 0)
+				goto deactivate;
+		}
+
 		if (page_referenced(page, 0, sc->target_mem_cgroup,
 				    &vm_flags)) {
 			/*
@@ -2408,6 +2453,7 @@ static void shrink_active_list(unsigned long nr_to_scan,
 			}
 		}
 
+deactivate:
 		ClearPageActive(page);	/* we are de-activating */
 		SetPageWorkingset(page);
 		list_add(&page->lru, &l_inactive);
@@ -2577,7 +2623,8 @@ static void get_scan_count(struct lruvec *lruvec, struct scan_control *sc,
 	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
 	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
 	unsigned long anon_cost, file_cost, total_cost;
-	int swappiness = mem_cgroup_swappiness(memcg);
+	int swappiness = sc->proactive_swappiness ?
+		*sc->proactive_swappiness : mem_cgroup_swappiness(memcg);
 	u64 fraction[ANON_AND_FILE];
 	u64 denominator = 0;	/* gcc */
 	enum scan_balance scan_balance;
@@ -2590,6 +2637,12 @@ static void get_scan_count(struct lruvec *lruvec, struct scan_control *sc,
 		goto out;
 	}
 
+	/* Proactive reclaim asked for anonymous memory only */
+	if (swappiness == SWAPPINESS_ANON_ONLY) {
+		scan_balance = SCAN_ANON;
+		goto out;
+	}
+
 	/*
 	 * Global reclaim will swap to prevent OOM even with no
 	 * swappiness, but memcg users want to use this knob to
@@ -3038,10 +3091,12 @@ static void shrink_node(pg_data_t *pgdat, struct scan_control *sc)
 
 again:
 	/*
-	 * Flush the memory cgroup stats, so that we read accurate per-memcg
-	 * lruvec stats for heuristics.
+	 * Flush the memory cgroup stats of the reclaimed subtree, so that we
+	 * read reasonably accurate per-memcg lruvec stats for heuristics.
+	 * These only steer the scan balance, values up to a flush period old
+	 * are good enough and much cheaper than flushing on every pass.
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats_ratelimited(sc->target_mem_cgroup);
 
 	memset(&sc->nr, 0, sizeof(sc->nr));
 
@@ -3395,6 +3450,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 				sc->priority);
 		sc->nr_scanned = 0;
 		shrink_zones(zonelist, sc);
+		sc->nr_scanned_total += sc->nr_scanned;
 
 		if (sc->nr_reclaimed >= sc->nr_to_reclaim)
 			break;
@@ -3679,10 +3735,12 @@ unsigned long mem_cgroup_shrink_node(struct mem_cgroup *memcg,
 	return sc.nr_reclaimed;
 }
 
-unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
-					   unsigned long nr_pages,
-					   gfp_t gfp_mask,
-					   bool may_swap)
+static unsigned long __try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
+						    unsigned long nr_pages,
+						    gfp_t gfp_mask,
+						    bool may_swap,
+						    int *swappiness,
+						    unsigned long *nr_scanned)
 {
 	unsigned long nr_reclaimed;
 	unsigned int noreclaim_flag;
@@ -3696,6 +3754,7 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 		.may_writepage = !laptop_mode,
 		.may_unmap = 1,
 		.may_swap = may_swap,
+		.proactive_swappiness = swappiness,
 	};
 	/*
 	 * Traverse the ZONELIST_FALLBACK zonelist of the current node to put
@@ -3714,8 +3773,36 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 	trace_mm_vmscan_memcg_reclaim_end(nr_reclaimed);
 	set_task_reclaim_state(current, NULL);
 
+	if (nr_scanned)
+		*nr_scanned = sc.nr_scanned_total;
+
 	return nr_reclaimed;
 }
+
+unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
+					   unsigned long nr_pages,
+					   gfp_t gfp_mask,
+					   bool may_swap)
+{
+	return __try_to_free_mem_cgroup_pages(memcg, nr_pages, gfp_mask,
+					      may_swap, NULL, NULL);
+}
+
+/*
+ * Reclaim on behalf of memory.reclaim. @swappiness, if not NULL, overrides
+ * the memcg's swappiness and may be SWAPPINESS_ANON_ONLY. The number of
+ * pages scanned is returned in @nr_scanned.
+ */
+unsigned long try_to_free_mem_cgroup_pages_proactive(struct mem_cgroup *memcg,
+						     unsigned long nr_pages,
+						     gfp_t gfp_mask,
+						     bool may_swap,
+						     int *swappiness,
+						     unsigned long *nr_scanned)
+{
+	return __try_to_free_mem_cgroup_pages(memcg, nr_pages, gfp_mask,
+					      may_swap, swappiness, nr_scanned);
+}
 #endif
 
 static void age_active_anon(struct pglist_data *pgdat,
@@ -3957,6 +4044,9 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int highest_zoneidx)
 
 	count_vm_event(PAGEOUTRUN);
 
+	/* Refresh the generation stamps reclaim is about to look at */
+	lru_gen_age(false);
+
 	/*
 	 * Account for the reclaim boost. Note that the zone boost is left in
 	 * place so that parallel allocations that are near the watermark will
@@ -1165,6 +1165,17 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 #define TEXTS_FOR_ZONES(xx) TEXT_FOR_DMA(xx) TEXT_FOR_DMA32(xx) xx "_normal", \
 					TEXT_FOR_HIGHMEM(xx) xx "_movable",
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define TEXT_FOR_PCP_THP(xx) xx "_thp",
+#else
+#define TEXT_FOR_PCP_THP(xx)
+#endif
+
+#define TEXTS_FOR_PCP_ORDERS(xx) xx "_order0", xx "_order1", xx "_order2", \
+				 xx "_order3", TEXT_FOR_PCP_THP(xx)
+#define TEXTS_FOR_PCP_HIGH_ORDERS(xx) xx "_order1", xx "_order2", \
+				      xx "_order3", TEXT_FOR_PCP_THP(xx)
+
 const char * const vmstat_text[] = {
 	/* enum zone_stat_item counters */
 	"nr_free_pages",
@@ -1236,6 +1247,11 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_SWAP
 	"nr_swapcached",
 #endif
+#ifdef CONFIG_NUMA_BALANCING
+	"pgpromote_success",
+	"pgpromote_candidate",
+	"pgpromote_rate_limited",
+#endif
 
 	/* enum writeback_stat_item counters */
 	"nr_dirty_threshold",
@@ -1251,6 +1267,8 @@ const char * const vmstat_text[] = {
 	TEXTS_FOR_ZONES("pgalloc")
 	TEXTS_FOR_ZONES("allocstall")
 	TEXTS_FOR_ZONES("pgskip")
+	TEXTS_FOR_PCP_ORDERS("pcp_hit")
+	TEXTS_FOR_PCP_ORDERS("pcp_miss")
 
 	"pgfree",
 	"pgactivate",
@@ -1259,6 +1277,9 @@ const char * const vmstat_text[] = {
 
 	"pgfault",
 	"pgmajfault",
+	"fault_around",
+	"fault_around_hit",
+	"fault_around_pages",
 	"pglazyfreed",
 
 	"pgrefill",
@@ -1274,6 +1295,8 @@ const char * const vmstat_text[] = {
 	"pgscan_file",
 	"pgsteal_anon",
 	"pgsteal_file",
+	"pgreadahead",
+	"pgreadahead_wasted",
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_failed",
@@ -1315,6 +1338,9 @@ const char * const vmstat_text[] = {
 	"compact_daemon_wake",
 	"compact_daemon_migrate_scanned",
 	"compact_daemon_free_scanned",
+	TEXTS_FOR_PCP_HIGH_ORDERS("compact_daemon_goal_migrated")
+	TEXTS_FOR_PCP_HIGH_ORDERS("compact_daemon_goal_success")
+	"compact_daemon_goal_throttled",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1365,14 +1391,12 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_DEBUG_TLBFLUSH
 	"nr_tlb_remote_flush",
 	"nr_tlb_remote_flush_received",
+	"nr_tlb_remote_flush_lazy",
+	"nr_tlb_remote_flush_uptodate",
 	"nr_tlb_local_flush_all",
 	"nr_tlb_local_flush_one",
 #endif /* CONFIG_DEBUG_TLBFLUSH */
 
-#ifdef CONFIG_DEBUG_VM_VMACACHE
-	"vmacache_find_calls",
-	"vmacache_find_hits",
-#endif
 #ifdef CONFIG_SWAP
 	"swap_ra",
 	"swap_ra_hit",
@@ -1381,6 +1405,11 @@ const char * const vmstat_text[] = {
 	"direct_map_level2_splits",
 	"direct_map_level3_splits",
 #endif
+#ifdef CONFIG_PER_VMA_LOCK
+	"vma_lock_success",
+	"vma_lock_abort",
+	"vma_lock_retry",
+#endif
 #endif /* CONFIG_VM_EVENT_COUNTERS || CONFIG_MEMCG */
 };
 #endif /* CONFIG_PROC_FS || CONFIG_SYSFS || CONFIG_NUMA || CONFIG_MEMCG */
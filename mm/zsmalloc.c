@@ -57,6 +57,7 @@
 #include <linux/wait.h>
 #include <linux/pagemap.h>
 #include <linux/fs.h>
+#include <linux/workqueue.h>
 
 #define ZSPAGE_MAGIC	0x58
 
@@ -197,6 +198,22 @@ static struct vfsmount *zsmalloc_mnt;
 static const int fullness_threshold_frac = 4;
 static size_t huge_class_size;
 
+/*
+ * Compact a pool in the background once one of its classes could give back
+ * this percentage of its pages. 0 leaves compaction to the shrinker and to
+ * explicit zs_compact() calls.
+ */
+static unsigned int zs_compact_threshold = 25;
+module_param_named(compact_threshold, zs_compact_threshold, uint, 0644);
+
+/* Not worth waking up a worker for less than this many pages */
+#define ZS_COMPACT_MIN_PAGES	32
+/* Background compaction runs at most this often per pool */
+#define ZS_COMPACT_INTERVAL	HZ
+
+/* Buckets of the debugfs fullness histogram, in steps of 10% in use */
+#define ZS_FULLNESS_BUCKETS	11
+
 struct size_class {
 	spinlock_t lock;
 	struct list_head fullness_list[NR_ZS_FULLNESS];
@@ -262,6 +279,9 @@ struct zs_pool {
 
 	/* Compact classes */
 	struct shrinker shrinker;
+	/* Background compaction, see zs_class_fragmented() */
+	struct work_struct compact_work;
+	unsigned long compact_next;
 
 #ifdef CONFIG_ZSMALLOC_STAT
 	struct dentry *stat_dentry;
@@ -298,6 +318,8 @@ struct mapping_area {
 	enum zs_mapmode vm_mm; /* mapping mode */
 };
 
+static bool zs_class_fragmented(struct size_class *class);
+
 #ifdef CONFIG_COMPACTION
 static int zs_register_migration(struct zs_pool *pool);
 static void zs_unregister_migration(struct zs_pool *pool);
@@ -642,6 +664,61 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(zs_stats_size);
 
+/*
+ * Histogram of the zspages of every class by the share of their objects in
+ * use. Walks all zspages under the class lock, debug only.
+ */
+static int zs_stats_fullness_show(struct seq_file *s, void *v)
+{
+	unsigned long total[ZS_FULLNESS_BUCKETS] = { 0 };
+	unsigned long hist[ZS_FULLNESS_BUCKETS];
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	struct zspage *zspage;
+	int i, fg, b;
+
+	seq_printf(s, " %5s %5s", "class", "size");
+	for (b = 0; b < ZS_FULLNESS_BUCKETS - 1; b++)
+		seq_printf(s, " %3d-%2d%%", b * 10, b * 10 + 9);
+	seq_printf(s, " %7s\n", "100%");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = pool->size_class[i];
+
+		if (class->index != i)
+			continue;
+
+		memset(hist, 0, sizeof(hist));
+		spin_lock(&class->lock);
+		for (fg = ZS_EMPTY; fg < NR_ZS_FULLNESS; fg++) {
+			list_for_each_entry(zspage, &class->fullness_list[fg],
+					    list) {
+				b = get_zspage_inuse(zspage) * 10 /
+				    class->objs_per_zspage;
+				hist[b]++;
+			}
+		}
+		spin_unlock(&class->lock);
+
+		seq_printf(s, " %5u %5u", i, class->size);
+		for (b = 0; b < ZS_FULLNESS_BUCKETS; b++) {
+			seq_printf(s, " %7lu", hist[b]);
+			total[b] += hist[b];
+		}
+		seq_puts(s, "\n");
+		cond_resched();
+	}
+
+	seq_puts(s, "\n");
+	seq_printf(s, " %5s %5s", "Total", "");
+	for (b = 0; b < ZS_FULLNESS_BUCKETS; b++)
+		seq_printf(s, " %7lu", total[b]);
+	seq_puts(s, "\n");
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(zs_stats_fullness);
+
 static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 {
 	if (!zs_stat_root) {
@@ -653,6 +730,8 @@ static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 
 	debugfs_create_file("classes", S_IFREG | 0444, pool->stat_dentry, pool,
 			    &zs_stats_size_fops);
+	debugfs_create_file("fullness", S_IFREG | 0444, pool->stat_dentry,
+			    pool, &zs_stats_fullness_fops);
 }
 
 static void zs_pool_stat_destroy(struct zs_pool *pool)
@@ -1495,7 +1574,7 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
-	bool isolated;
+	bool isolated, fragmented = false;
 
 	if (unlikely(!handle))
 		return;
@@ -1515,6 +1594,7 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	fullness = fix_fullness_group(class, zspage);
 	if (fullness != ZS_EMPTY) {
 		migrate_read_unlock(zspage);
+		fragmented = zs_class_fragmented(class);
 		goto out;
 	}
 
@@ -1528,6 +1608,9 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	spin_unlock(&class->lock);
 	unpin_tag(handle);
 	cache_free_handle(pool, handle);
+
+	if (fragmented && time_after_eq(jiffies, READ_ONCE(pool->compact_next)))
+		queue_work(system_unbound_wq, &pool->compact_work);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
@@ -2239,6 +2322,28 @@ static unsigned long zs_can_compact(struct size_class *class)
 	return obj_wasted * class->pages_per_zspage;
 }
 
+/*
+ * Whether enough of the class is wasted on partially used zspages for
+ * zs_free() to kick background compaction. Called under class->lock.
+ */
+static bool zs_class_fragmented(struct size_class *class)
+{
+	unsigned int threshold = READ_ONCE(zs_compact_threshold);
+	unsigned long freeable, pages;
+
+	if (!threshold)
+		return false;
+
+	freeable = zs_can_compact(class);
+	if (freeable < ZS_COMPACT_MIN_PAGES)
+		return false;
+
+	pages = zs_stat_get(class, OBJ_ALLOCATED) / class->objs_per_zspage *
+		class->pages_per_zspage;
+
+	return freeable * 100 >= pages * threshold;
+}
+
 static unsigned long __zs_compact(struct zs_pool *pool,
 				  struct size_class *class)
 {
@@ -2310,6 +2415,16 @@ unsigned long zs_compact(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+static void zs_compact_worker(struct work_struct *work)
+{
+	struct zs_pool *pool = container_of(work, struct zs_pool,
+					    compact_work);
+
+	zs_compact(pool);
+	/* Leave what could not be moved for a while instead of spinning */
+	WRITE_ONCE(pool->compact_next, jiffies + ZS_COMPACT_INTERVAL);
+}
+
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 {
 	memcpy(stats, &pool->stats, sizeof(struct zs_pool_stats));
@@ -2390,6 +2505,8 @@ struct zs_pool *zs_create_pool(const char *name)
 	if (!pool)
 		return NULL;
 
+	INIT_WORK(&pool->compact_work, zs_compact_worker);
+	pool->compact_next = jiffies;
 	init_deferred_free(pool);
 
 	pool->name = kstrdup(name, GFP_KERNEL);
@@ -2500,6 +2617,7 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	cancel_work_sync(&pool->compact_work);
 	zs_unregister_shrinker(pool);
 	zs_unregister_migration(pool);
 	zs_pool_stat_destroy(pool);
@@ -27,6 +27,10 @@
 #include <linux/scatterlist.h>
 #include <linux/mempool.h>
 #include <linux/zpool.h>
+#include <linux/list_lru.h>
+#include <linux/memcontrol.h>
+#include <linux/hash.h>
+#include <linux/zswap.h>
 #include <crypto/acompress.h>
 
 #include <linux/mm_types.h>
@@ -36,6 +40,8 @@
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
 
+#include "internal.h"
+
 /*********************************
 * statistics
 **********************************/
@@ -68,8 +74,12 @@ static u64 zswap_reject_kmemcache_fail;
 /* Duplicate store was encountered (rare) */
 static u64 zswap_duplicate_entry;
 
+/* Store had to write back an entry of its cgroup to stay within zswap.max */
+static u64 zswap_memcg_limit_hit;
+
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
+static struct work_struct zswap_shrink_work;
 /* Pool limit was hit, we need to calm down */
 static bool zswap_pool_reached_full;
 
@@ -125,6 +135,16 @@ static bool zswap_same_filled_pages_enabled = true;
 module_param_named(same_filled_pages_enabled, zswap_same_filled_pages_enabled,
 		   bool, 0644);
 
+/*
+ * Every pool spreads its entries over this many zpools, so that stores and
+ * loads running on many CPUs at once do not all serialize on the lock of a
+ * single zpool.
+ */
+#define ZSWAP_NR_ZPOOLS 32
+
+/* Entries looked at per memcg in every round of the global shrinker */
+#define ZSWAP_WRITEBACK_BATCH 32
+
 /*********************************
 * data structures
 **********************************/
@@ -138,12 +158,11 @@ struct crypto_acomp_ctx {
 };
 
 struct zswap_pool {
-	struct zpool *zpool;
+	struct zpool *zpools[ZSWAP_NR_ZPOOLS];
 	struct crypto_acomp_ctx __percpu *acomp_ctx;
 	struct kref kref;
 	struct list_head list;
 	struct work_struct release_work;
-	struct work_struct shrink_work;
 	struct hlist_node node;
 	char tfm_name[CRYPTO_MAX_ALG_NAME];
 };
@@ -155,7 +174,8 @@ struct zswap_pool {
  * page within zswap.
  *
  * rbnode - links the entry into red-black tree for the appropriate swap type
- * offset - the swap offset for the entry.  Index into the red-black tree.
+ * swpentry - the swap entry of the page.  Its offset is the index into the
+ *            red-black tree.
  * refcount - the number of outstanding reference to the entry. This is needed
  *            to protect against premature freeing of the entry by code
  *            concurrent calls to load, invalidate, and writeback.  The lock
@@ -167,10 +187,13 @@ struct zswap_pool {
  * pool - the zswap_pool the entry's data is in
  * handle - zpool allocation handle that stores the compressed page data
  * value - value of the same-value filled pages which have same content
+ * objcg - the obj_cgroup the compressed data is charged to
+ * lru - links the entry into the writeback list of its memcg, see
+ *       zswap_list_lru.  Same-value filled pages are not on it.
  */
 struct zswap_entry {
 	struct rb_node rbnode;
-	pgoff_t offset;
+	swp_entry_t swpentry;
 	int refcount;
 	unsigned int length;
 	struct zswap_pool *pool;
@@ -178,10 +201,8 @@ struct zswap_entry {
 		unsigned long handle;
 		unsigned long value;
 	};
-};
-
-struct zswap_header {
-	swp_entry_t swpentry;
+	struct obj_cgroup *objcg;
+	struct list_head lru;
 };
 
 /*
@@ -196,6 +217,14 @@ struct zswap_tree {
 
 static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
 
+/*
+ * Entries in the order they were stored, per node and per memcg. Writeback
+ * goes oldest first, either from the memcg that hit its zswap.max or from
+ * every memcg in turn when the pool as a whole is full. An entry is only on
+ * the list while it is in a tree, the tree lock nests outside the list lock.
+ */
+static struct list_lru zswap_list_lru;
+
 /* RCU-protected iteration */
 static LIST_HEAD(zswap_pools);
 /* protects zswap_pools list modification */
@@ -218,16 +247,13 @@ static bool zswap_has_pool;
 
 #define zswap_pool_debug(msg, p)				\
 	pr_debug("%s pool %s/%s\n", msg, (p)->tfm_name,		\
-		 zpool_get_type((p)->zpool))
+		 zpool_get_type((p)->zpools[0]))
 
-static int zswap_writeback_entry(struct zpool *pool, unsigned long handle);
+static int zswap_writeback_entry(struct zswap_entry *entry,
+				 struct zswap_tree *tree);
 static int zswap_pool_get(struct zswap_pool *pool);
 static void zswap_pool_put(struct zswap_pool *pool);
 
-static const struct zpool_ops zswap_zpool_ops = {
-	.evict = zswap_writeback_entry
-};
-
 static bool zswap_is_full(void)
 {
 	return totalram_pages() * zswap_max_pool_percent / 100 <
@@ -248,8 +274,12 @@ static void zswap_update_total_size(void)
 
 	rcu_read_lock();
 
-	list_for_each_entry_rcu(pool, &zswap_pools, list)
-		total += zpool_get_total_size(pool->zpool);
+	list_for_each_entry_rcu(pool, &zswap_pools, list) {
+		int i;
+
+		for (i = 0; i < ZSWAP_NR_ZPOOLS; i++)
+			total += zpool_get_total_size(pool->zpools[i]);
+	}
 
 	rcu_read_unlock();
 
@@ -279,7 +309,9 @@ static struct zswap_entry *zswap_entry_cache_alloc(gfp_t gfp)
 	if (!entry)
 		return NULL;
 	entry->refcount = 1;
+	entry->objcg = NULL;
 	RB_CLEAR_NODE(&entry->rbnode);
+	INIT_LIST_HEAD(&entry->lru);
 	return entry;
 }
 
@@ -288,6 +320,47 @@ static void zswap_entry_cache_free(struct zswap_entry *entry)
 	kmem_cache_free(zswap_entry_cache, entry);
 }
 
+static struct zpool *zswap_find_zpool(struct zswap_entry *entry)
+{
+	int i = 0;
+
+	if (ZSWAP_NR_ZPOOLS > 1)
+		i = hash_ptr(entry, ilog2(ZSWAP_NR_ZPOOLS));
+
+	return entry->pool->zpools[i];
+}
+
+/*********************************
+* lru functions
+**********************************/
+static int zswap_entry_nid(struct zswap_entry *entry)
+{
+	return page_to_nid(virt_to_page(entry));
+}
+
+/* The root and uncharged entries share the list of the NULL memcg */
+static struct mem_cgroup *zswap_entry_memcg(struct zswap_entry *entry)
+{
+	return entry->objcg ? obj_cgroup_memcg(entry->objcg) : NULL;
+}
+
+/* caller must hold the tree lock */
+static void zswap_lru_add(struct zswap_entry *entry)
+{
+	rcu_read_lock();
+	list_lru_add_memcg(&zswap_list_lru, &entry->lru,
+			   zswap_entry_nid(entry), zswap_entry_memcg(entry));
+	rcu_read_unlock();
+}
+
+static void zswap_lru_del(struct zswap_entry *entry)
+{
+	rcu_read_lock();
+	list_lru_del_memcg(&zswap_list_lru, &entry->lru,
+			   zswap_entry_nid(entry), zswap_entry_memcg(entry));
+	rcu_read_unlock();
+}
+
 /*********************************
 * rbtree functions
 **********************************/
@@ -298,9 +371,9 @@ static struct zswap_entry *zswap_rb_search(struct rb_root *root, pgoff_t offset)
 
 	while (node) {
 		entry = rb_entry(node, struct zswap_entry, rbnode);
-		if (entry->offset > offset)
+		if (swp_offset(entry->swpentry) > offset)
 			node = node->rb_left;
-		else if (entry->offset < offset)
+		else if (swp_offset(entry->swpentry) < offset)
 			node = node->rb_right;
 		else
 			return entry;
@@ -316,14 +389,15 @@ static int zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry,
 			struct zswap_entry **dupentry)
 {
 	struct rb_node **link = &root->rb_node, *parent = NULL;
+	pgoff_t offset = swp_offset(entry->swpentry);
 	struct zswap_entry *myentry;
 
 	while (*link) {
 		parent = *link;
 		myentry = rb_entry(parent, struct zswap_entry, rbnode);
-		if (myentry->offset > entry->offset)
+		if (swp_offset(myentry->swpentry) > offset)
 			link = &(*link)->rb_left;
-		else if (myentry->offset < entry->offset)
+		else if (swp_offset(myentry->swpentry) < offset)
 			link = &(*link)->rb_right;
 		else {
 			*dupentry = myentry;
@@ -345,16 +419,22 @@ static void zswap_rb_erase(struct rb_root *root, struct zswap_entry *entry)
 
 /*
  * Carries out the common pattern of freeing and entry's zpool allocation,
- * freeing the entry itself, and decrementing the number of stored pages.
+ * uncharging its memcg, freeing the entry itself, and decrementing the
+ * number of stored pages.
  */
 static void zswap_free_entry(struct zswap_entry *entry)
 {
 	if (!entry->length)
 		atomic_dec(&zswap_same_filled_pages);
 	else {
-		zpool_free(entry->pool->zpool, entry->handle);
+		zswap_lru_del(entry);
+		zpool_free(zswap_find_zpool(entry), entry->handle);
 		zswap_pool_put(entry->pool);
 	}
+	if (entry->objcg) {
+		obj_cgroup_uncharge_zswap(entry->objcg, entry->length);
+		obj_cgroup_put(entry->objcg);
+	}
 	zswap_entry_cache_free(entry);
 	atomic_dec(&zswap_stored_pages);
 	zswap_update_total_size();
@@ -533,24 +613,6 @@ static struct zswap_pool *zswap_pool_current_get(void)
 	return pool;
 }
 
-static struct zswap_pool *zswap_pool_last_get(void)
-{
-	struct zswap_pool *pool, *last = NULL;
-
-	rcu_read_lock();
-
-	list_for_each_entry_rcu(pool, &zswap_pools, list)
-		last = pool;
-	WARN_ONCE(!last && zswap_has_pool,
-		  "%s: no page storage pool!\n", __func__);
-	if (!zswap_pool_get(last))
-		last = NULL;
-
-	rcu_read_unlock();
-
-	return last;
-}
-
 /* type and compressor must be null-terminated */
 static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 {
@@ -561,7 +623,7 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 	list_for_each_entry_rcu(pool, &zswap_pools, list) {
 		if (strcmp(pool->tfm_name, compressor))
 			continue;
-		if (strcmp(zpool_get_type(pool->zpool), type))
+		if (strcmp(zpool_get_type(pool->zpools[0]), type))
 			continue;
 		/* if we can't get it, it's about to be destroyed */
 		if (!zswap_pool_get(pool))
@@ -572,22 +634,12 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 	return NULL;
 }
 
-static void shrink_worker(struct work_struct *w)
-{
-	struct zswap_pool *pool = container_of(w, typeof(*pool),
-						shrink_work);
-
-	if (zpool_shrink(pool->zpool, 1, NULL))
-		zswap_reject_reclaim_fail++;
-	zswap_pool_put(pool);
-}
-
 static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 {
 	struct zswap_pool *pool;
 	char name[38]; /* 'zswap' + 32 char (max) num + \0 */
 	gfp_t gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	int ret;
+	int i, ret;
 
 	if (!zswap_has_pool) {
 		/* if either are unset, pool initialization failed, and we
@@ -604,15 +656,19 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	if (!pool)
 		return NULL;
 
-	/* unique name for each pool specifically required by zsmalloc */
-	snprintf(name, 38, "zswap%x", atomic_inc_return(&zswap_pools_count));
+	for (i = 0; i < ZSWAP_NR_ZPOOLS; i++) {
+		/* unique name for each pool specifically required by zsmalloc */
+		snprintf(name, 38, "zswap%x",
+			 atomic_inc_return(&zswap_pools_count));
 
-	pool->zpool = zpool_create_pool(type, name, gfp, &zswap_zpool_ops);
-	if (!pool->zpool) {
-		pr_err("%s zpool not available\n", type);
-		goto error;
+		/* writeback goes through zswap_list_lru, not zpool eviction */
+		pool->zpools[i] = zpool_create_pool(type, name, gfp, NULL);
+		if (!pool->zpools[i]) {
+			pr_err("%s zpool not available\n", type);
+			goto error;
+		}
 	}
-	pr_debug("using %s zpool\n", zpool_get_type(pool->zpool));
+	pr_debug("using %s zpool\n", zpool_get_type(pool->zpools[0]));
 
 	strscpy(pool->tfm_name, compressor, sizeof(pool->tfm_name));
 
@@ -633,7 +689,6 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	 */
 	kref_init(&pool->kref);
 	INIT_LIST_HEAD(&pool->list);
-	INIT_WORK(&pool->shrink_work, shrink_worker);
 
 	zswap_pool_debug("created", pool);
 
@@ -642,8 +697,8 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 error:
 	if (pool->acomp_ctx)
 		free_percpu(pool->acomp_ctx);
-	if (pool->zpool)
-		zpool_destroy_pool(pool->zpool);
+	while (i--)
+		zpool_destroy_pool(pool->zpools[i]);
 	kfree(pool);
 	return NULL;
 }
@@ -692,11 +747,14 @@ static __init struct zswap_pool *__zswap_pool_create_fallback(void)
 
 static void zswap_pool_destroy(struct zswap_pool *pool)
 {
+	int i;
+
 	zswap_pool_debug("destroying", pool);
 
 	cpuhp_state_remove_instance(CPUHP_MM_ZSWP_POOL_PREPARE, &pool->node);
 	free_percpu(pool->acomp_ctx);
-	zpool_destroy_pool(pool->zpool);
+	for (i = 0; i < ZSWAP_NR_ZPOOLS; i++)
+		zpool_destroy_pool(pool->zpools[i]);
 	kfree(pool);
 }
 
@@ -923,14 +981,14 @@ static int zswap_get_swap_cache_page(swp_entry_t entry,
  * in the first place.  After the page has been decompressed into
  * the swap cache, the compressed version stored by zswap can be
  * freed.
+ *
+ * The caller holds a reference on the entry, which is dropped here.
  */
-static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
+static int zswap_writeback_entry(struct zswap_entry *entry,
+				 struct zswap_tree *tree)
 {
-	struct zswap_header *zhdr;
-	swp_entry_t swpentry;
-	struct zswap_tree *tree;
-	pgoff_t offset;
-	struct zswap_entry *entry;
+	swp_entry_t swpentry = entry->swpentry;
+	struct zpool *pool = zswap_find_zpool(entry);
 	struct page *page;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
@@ -944,34 +1002,10 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 
 	if (!zpool_can_sleep_mapped(pool)) {
 		tmp = kmalloc(PAGE_SIZE, GFP_ATOMIC);
-		if (!tmp)
-			return -ENOMEM;
-	}
-
-	/* extract swpentry from data */
-	zhdr = zpool_map_handle(pool, handle, ZPOOL_MM_RO);
-	swpentry = zhdr->swpentry; /* here */
-	tree = zswap_trees[swp_type(swpentry)];
-	offset = swp_offset(swpentry);
-
-	/* find and ref zswap entry */
-	spin_lock(&tree->lock);
-	entry = zswap_entry_find_get(&tree->rbroot, offset);
-	if (!entry) {
-		/* entry was invalidated */
-		spin_unlock(&tree->lock);
-		zpool_unmap_handle(pool, handle);
-		kfree(tmp);
-		return 0;
-	}
-	spin_unlock(&tree->lock);
-	BUG_ON(offset != entry->offset);
-
-	src = (u8 *)zhdr + sizeof(struct zswap_header);
-	if (!zpool_can_sleep_mapped(pool)) {
-		memcpy(tmp, src, entry->length);
-		src = tmp;
-		zpool_unmap_handle(pool, handle);
+		if (!tmp) {
+			ret = -ENOMEM;
+			goto fail;
+		}
 	}
 
 	/* try to allocate swap cache page */
@@ -987,6 +1021,13 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 		goto fail;
 
 	case ZSWAP_SWAPCACHE_NEW: /* page is locked */
+		src = zpool_map_handle(pool, entry->handle, ZPOOL_MM_RO);
+		if (!zpool_can_sleep_mapped(pool)) {
+			memcpy(tmp, src, entry->length);
+			src = tmp;
+			zpool_unmap_handle(pool, entry->handle);
+		}
+
 		/* decompress */
 		acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
 		dlen = PAGE_SIZE;
@@ -1000,6 +1041,9 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 		dlen = acomp_ctx->req->dlen;
 		mutex_unlock(acomp_ctx->mutex);
 
+		if (zpool_can_sleep_mapped(pool))
+			zpool_unmap_handle(pool, entry->handle);
+
 		BUG_ON(ret);
 		BUG_ON(dlen != PAGE_SIZE);
 
@@ -1026,11 +1070,12 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	*     because invalidate happened during writeback
 	*  search the tree and free the entry if find entry
 	*/
-	if (entry == zswap_rb_search(&tree->rbroot, offset))
+	if (entry == zswap_rb_search(&tree->rbroot, swp_offset(swpentry)))
 		zswap_entry_put(tree, entry);
 	spin_unlock(&tree->lock);
 
-	goto end;
+	kfree(tmp);
+	return 0;
 
 	/*
 	* if we get here due to ZSWAP_SWAPCACHE_EXIST
@@ -1041,18 +1086,133 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	*/
 fail:
 	spin_lock(&tree->lock);
+	/* still stored, give it another pass at the tail of the list */
+	if (entry == zswap_rb_search(&tree->rbroot, swp_offset(swpentry)))
+		zswap_lru_add(entry);
 	zswap_entry_put(tree, entry);
 	spin_unlock(&tree->lock);
 
-end:
-	if (zpool_can_sleep_mapped(pool))
-		zpool_unmap_handle(pool, handle);
-	else
-		kfree(tmp);
-
+	kfree(tmp);
 	return ret;
 }
 
+static enum lru_status zswap_lru_isolate(struct list_head *item,
+					 struct list_lru_one *l,
+					 spinlock_t *lock, void *arg)
+{
+	struct zswap_entry *entry = container_of(item, struct zswap_entry, lru);
+	swp_entry_t swpentry = entry->swpentry;
+	unsigned long *nr_written = arg;
+	struct zswap_tree *tree;
+
+	/*
+	 * Once off the list and unlocked the entry can be invalidated and
+	 * freed at any time, so only look at it again after finding it in
+	 * its tree.
+	 */
+	list_lru_isolate(l, item);
+	spin_unlock(lock);
+
+	tree = zswap_trees[swp_type(swpentry)];
+	spin_lock(&tree->lock);
+	if (zswap_rb_search(&tree->rbroot, swp_offset(swpentry)) != entry) {
+		spin_unlock(&tree->lock);
+		goto out;
+	}
+	zswap_entry_get(entry);
+	spin_unlock(&tree->lock);
+
+	if (!zswap_writeback_entry(entry, tree))
+		(*nr_written)++;
+out:
+	cond_resched();
+	spin_lock(lock);
+	return LRU_REMOVED_RETRY;
+}
+
+/* Writes back the oldest entries of one memcg, not its descendants */
+static unsigned long zswap_writeback_lru(struct mem_cgroup *memcg,
+					 unsigned long *nr_to_walk)
+{
+	unsigned long nr_written = 0;
+	int nid;
+
+	for_each_node_state(nid, N_NORMAL_MEMORY) {
+		list_lru_walk_one(&zswap_list_lru, nid, memcg,
+				  zswap_lru_isolate, &nr_written, nr_to_walk);
+		if (!*nr_to_walk)
+			break;
+	}
+
+	return nr_written;
+}
+
+/**
+ * zswap_writeback_memcg - write back the oldest entries of a memcg subtree
+ * @memcg: the memcg whose entries, and those of its descendants, to write back
+ * @nr_to_walk: the maximum number of entries to look at
+ *
+ * Returns the number of entries written back to the swap device.
+ */
+unsigned long zswap_writeback_memcg(struct mem_cgroup *memcg,
+				    unsigned long nr_to_walk)
+{
+	unsigned long nr_written = 0;
+	struct mem_cgroup *iter;
+
+	if (mem_cgroup_disabled())
+		return zswap_writeback_lru(NULL, &nr_to_walk);
+
+	for (iter = mem_cgroup_iter(memcg, NULL, NULL); iter;
+	     iter = mem_cgroup_iter(memcg, iter, NULL)) {
+		nr_written += zswap_writeback_lru(iter, &nr_to_walk);
+		if (!nr_to_walk) {
+			mem_cgroup_iter_break(memcg, iter);
+			break;
+		}
+	}
+
+	return nr_written;
+}
+
+/*
+ * The pool as a whole is full: go round robin over all memcgs and write
+ * back a batch of the oldest entries of each, so that every cgroup pays
+ * in proportion to its use rather than whoever stored first.
+ */
+static void shrink_worker(struct work_struct *w)
+{
+	struct mem_cgroup *memcg;
+	int failures = 0;
+
+	do {
+		unsigned long nr_to_walk, nr_written = 0;
+
+		if (mem_cgroup_disabled()) {
+			nr_to_walk = ZSWAP_WRITEBACK_BATCH;
+			nr_written = zswap_writeback_lru(NULL, &nr_to_walk);
+		} else {
+			for (memcg = mem_cgroup_iter(NULL, NULL, NULL); memcg;
+			     memcg = mem_cgroup_iter(NULL, memcg, NULL)) {
+				nr_to_walk = ZSWAP_WRITEBACK_BATCH;
+				nr_written += zswap_writeback_lru(memcg,
+								  &nr_to_walk);
+				if (zswap_can_accept()) {
+					mem_cgroup_iter_break(NULL, memcg);
+					return;
+				}
+			}
+		}
+
+		if (!nr_written) {
+			zswap_reject_reclaim_fail++;
+			if (++failures == MAX_RECLAIM_RETRIES)
+				break;
+		}
+		cond_resched();
+	} while (!zswap_can_accept());
+}
+
 static int zswap_is_page_same_filled(void *ptr, unsigned long *value)
 {
 	unsigned int pos;
@@ -1086,12 +1246,13 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	struct zswap_entry *entry, *dupentry;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
+	struct obj_cgroup *objcg = NULL;
+	struct zpool *zpool;
 	int ret;
-	unsigned int hlen, dlen = PAGE_SIZE;
+	unsigned int dlen = PAGE_SIZE;
 	unsigned long handle, value;
 	char *buf;
 	u8 *src, *dst;
-	struct zswap_header zhdr = { .swpentry = swp_entry(type, offset) };
 	gfp_t gfp;
 
 	/* THP isn't supported */
@@ -1105,15 +1266,26 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		goto reject;
 	}
 
+	/* make room within the zswap.max of the cgroup if needed */
+	objcg = get_obj_cgroup_from_page(page);
+	if (objcg && !obj_cgroup_may_zswap(objcg)) {
+		struct mem_cgroup *memcg = get_mem_cgroup_from_objcg(objcg);
+		unsigned long nr_written;
+
+		zswap_memcg_limit_hit++;
+		nr_written = zswap_writeback_memcg(memcg, 1);
+		mem_cgroup_put(memcg);
+		if (!nr_written) {
+			ret = -ENOMEM;
+			goto reject;
+		}
+	}
+
 	/* reclaim space if needed */
 	if (zswap_is_full()) {
-		struct zswap_pool *pool;
-
 		zswap_pool_limit_hit++;
 		zswap_pool_reached_full = true;
-		pool = zswap_pool_last_get();
-		if (pool)
-			queue_work(shrink_wq, &pool->shrink_work);
+		queue_work(shrink_wq, &zswap_shrink_work);
 		ret = -ENOMEM;
 		goto reject;
 	}
@@ -1138,7 +1310,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		src = kmap_atomic(page);
 		if (zswap_is_page_same_filled(src, &value)) {
 			kunmap_atomic(src);
-			entry->offset = offset;
+			entry->swpentry = swp_entry(type, offset);
 			entry->length = 0;
 			entry->value = value;
 			atomic_inc(&zswap_same_filled_pages);
@@ -1187,11 +1359,11 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	}
 
 	/* store */
-	hlen = zpool_evictable(entry->pool->zpool) ? sizeof(zhdr) : 0;
+	zpool = zswap_find_zpool(entry);
 	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	if (zpool_malloc_support_movable(entry->pool->zpool))
+	if (zpool_malloc_support_movable(zpool))
 		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
-	ret = zpool_malloc(entry->pool->zpool, hlen + dlen, gfp, &handle);
+	ret = zpool_malloc(zpool, dlen, gfp, &handle);
 	if (ret == -ENOSPC) {
 		zswap_reject_compress_poor++;
 		goto put_dstmem;
@@ -1200,18 +1372,21 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 		zswap_reject_alloc_fail++;
 		goto put_dstmem;
 	}
-	buf = zpool_map_handle(entry->pool->zpool, handle, ZPOOL_MM_WO);
-	memcpy(buf, &zhdr, hlen);
-	memcpy(buf + hlen, dst, dlen);
-	zpool_unmap_handle(entry->pool->zpool, handle);
+	buf = zpool_map_handle(zpool, handle, ZPOOL_MM_WO);
+	memcpy(buf, dst, dlen);
+	zpool_unmap_handle(zpool, handle);
 	mutex_unlock(acomp_ctx->mutex);
 
 	/* populate entry */
-	entry->offset = offset;
+	entry->swpentry = swp_entry(type, offset);
 	entry->handle = handle;
 	entry->length = dlen;
 
 insert_entry:
+	entry->objcg = objcg;
+	if (objcg)
+		obj_cgroup_charge_zswap(objcg, entry->length);
+
 	/* map */
 	spin_lock(&tree->lock);
 	do {
@@ -1223,6 +1398,8 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 			zswap_entry_put(tree, dupentry);
 		}
 	} while (ret == -EEXIST);
+	if (entry->length)
+		zswap_lru_add(entry);
 	spin_unlock(&tree->lock);
 
 	/* update stats */
@@ -1237,6 +1414,8 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 freepage:
 	zswap_entry_cache_free(entry);
 reject:
+	if (objcg)
+		obj_cgroup_put(objcg);
 	return ret;
 }
 
@@ -1251,6 +1430,7 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	struct zswap_entry *entry;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
+	struct zpool *zpool;
 	u8 *src, *dst, *tmp;
 	unsigned int dlen;
 	int ret;
@@ -1273,7 +1453,8 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 		goto freeentry;
 	}
 
-	if (!zpool_can_sleep_mapped(entry->pool->zpool)) {
+	zpool = zswap_find_zpool(entry);
+	if (!zpool_can_sleep_mapped(zpool)) {
 
 		tmp = kmalloc(entry->length, GFP_ATOMIC);
 		if (!tmp) {
@@ -1284,16 +1465,14 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 
 	/* decompress */
 	dlen = PAGE_SIZE;
-	src = zpool_map_handle(entry->pool->zpool, entry->handle, ZPOOL_MM_RO);
-	if (zpool_evictable(entry->pool->zpool))
-		src += sizeof(struct zswap_header);
+	src = zpool_map_handle(zpool, entry->handle, ZPOOL_MM_RO);
 
-	if (!zpool_can_sleep_mapped(entry->pool->zpool)) {
+	if (!zpool_can_sleep_mapped(zpool)) {
 
 		memcpy(tmp, src, entry->length);
 		src = tmp;
 
-		zpool_unmap_handle(entry->pool->zpool, entry->handle);
+		zpool_unmap_handle(zpool, entry->handle);
 	}
 
 	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
@@ -1305,8 +1484,8 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	ret = crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait);
 	mutex_unlock(acomp_ctx->mutex);
 
-	if (zpool_can_sleep_mapped(entry->pool->zpool))
-		zpool_unmap_handle(entry->pool->zpool, entry->handle);
+	if (zpool_can_sleep_mapped(zpool))
+		zpool_unmap_handle(zpool, entry->handle);
 	else
 		kfree(tmp);
 
@@ -1403,6 +1582,8 @@ static int __init zswap_debugfs_init(void)
 
 	debugfs_create_u64("pool_limit_hit", 0444,
 			   zswap_debugfs_root, &zswap_pool_limit_hit);
+	debugfs_create_u64("memcg_limit_hit", 0444,
+			   zswap_debugfs_root, &zswap_memcg_limit_hit);
 	debugfs_create_u64("reject_reclaim_fail", 0444,
 			   zswap_debugfs_root, &zswap_reject_reclaim_fail);
 	debugfs_create_u64("reject_alloc_fail", 0444,
@@ -1463,7 +1644,7 @@ static int __init init_zswap(void)
 	pool = __zswap_pool_create_fallback();
 	if (pool) {
 		pr_info("loaded using pool %s/%s\n", pool->tfm_name,
-			zpool_get_type(pool->zpool));
+			zpool_get_type(pool->zpools[0]));
 		list_add(&pool->list, &zswap_pools);
 		zswap_has_pool = true;
 	} else {
@@ -1474,12 +1655,18 @@ static int __init init_zswap(void)
 	shrink_wq = create_workqueue("zswap-shrink");
 	if (!shrink_wq)
 		goto fallback_fail;
+	INIT_WORK(&zswap_shrink_work, shrink_worker);
+
+	if (list_lru_init_memcg(&zswap_list_lru, NULL))
+		goto lru_fail;
 
 	frontswap_register_ops(&zswap_frontswap_ops);
 	if (zswap_debugfs_init())
 		pr_warn("debugfs initialization failed\n");
 	return 0;
 
+lru_fail:
+	destroy_workqueue(shrink_wq);
 fallback_fail:
 	if (pool)
 		zswap_pool_destroy(pool);
@@ -246,6 +246,38 @@ static void dump_requests(struct seq_file *s, struct ceph_osd *osd)
 	mutex_unlock(&osd->lock);
 }
 
+/*
+ * Age of the requests in flight to an OSD, bucketed by powers of 4 ms.
+ * A slow OSD shows up as requests piling up in the upper buckets.
+ */
+static const unsigned int osd_latency_bounds_ms[] = { 1, 4, 16, 64, 256, 1024 };
+
+static void dump_osd_latency(struct seq_file *s, struct ceph_osd *osd)
+{
+	unsigned int hist[ARRAY_SIZE(osd_latency_bounds_ms) + 1] = {};
+	ktime_t now = ktime_get();
+	struct rb_node *n;
+	int i;
+
+	mutex_lock(&osd->lock);
+	for (n = rb_first(&osd->o_requests); n; n = rb_next(n)) {
+		struct ceph_osd_request *req =
+		    rb_entry(n, struct ceph_osd_request, r_node);
+		s64 ms = ktime_ms_delta(now, req->r_start_latency);
+
+		for (i = 0; i < ARRAY_SIZE(osd_latency_bounds_ms); i++)
+			if (ms < osd_latency_bounds_ms[i])
+				break;
+		hist[i]++;
+	}
+	mutex_unlock(&osd->lock);
+
+	seq_printf(s, "osd%d", osd->o_osd);
+	for (i = 0; i < ARRAY_SIZE(hist); i++)
+		seq_printf(s, "\t%u", hist[i]);
+	seq_putc(s, '\n');
+}
+
 static void dump_linger_request(struct seq_file *s,
 				struct ceph_osd_linger_request *lreq)
 {
@@ -371,6 +403,13 @@ static int osdc_show(struct seq_file *s, void *pp)
 		dump_backoffs(s, osd);
 	}
 
+	seq_puts(s, "LATENCY\t<1ms\t<4ms\t<16ms\t<64ms\t<256ms\t<1s\t>=1s\n");
+	for (n = rb_first(&osdc->osds); n; n = rb_next(n)) {
+		struct ceph_osd *osd = rb_entry(n, struct ceph_osd, o_node);
+
+		dump_osd_latency(s, osd);
+	}
+
 	up_read(&osdc->lock);
 	return 0;
 }
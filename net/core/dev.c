@@ -3793,8 +3793,10 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 				 struct netdev_queue *txq)
 {
 	spinlock_t *root_lock = qdisc_lock(q);
-	struct sk_buff *to_free = NULL;
-	bool contended;
+	struct llist_node *ll_list, *first_n;
+	struct sk_buff *next, *to_free = NULL;
+	unsigned long defer_count = 0;
+	unsigned int limit;
 	int rc;
 
 	qdisc_calculate_pkt_len(skb, q);
@@ -3831,56 +3833,78 @@ static inline int __dev_xmit_skb(struct sk_buff *skb, struct Qdisc *q,
 		return rc;
 	}
 
-	/*
-	 * Heuristic to force contended enqueues to serialize on a
-	 * separate lock before trying to get qdisc main lock.
-	 * This permits qdisc->running owner to get the lock more
-	 * often and dequeue packets faster.
+	/* Contended senders do not queue up on the root lock: they push
+	 * their packet to q->defer_list and leave. Whoever finds the list
+	 * empty takes the lock and enqueues everything that accumulated in
+	 * the meantime, so the lock owner spends its time dequeueing packets
+	 * instead of handing the lock around. defer_count bounds the list
+	 * by the qdisc limit (the device queue length for qdiscs that have
+	 * none) and is only touched once the list is non empty.
 	 */
-	contended = qdisc_is_running(q);
-	if (unlikely(contended))
-		spin_lock(&q->busylock);
+	limit = READ_ONCE(q->limit) ?: READ_ONCE(dev->tx_queue_len);
+	first_n = READ_ONCE(q->defer_list.first);
+	do {
+		if (first_n && !defer_count) {
+			defer_count = atomic_long_inc_return(&q->defer_count);
+			if (unlikely(limit && defer_count > limit)) {
+				kfree_skb(skb);
+				return NET_XMIT_DROP;
+			}
+		}
+		skb->ll_node.next = first_n;
+	} while (!try_cmpxchg(&q->defer_list.first, &first_n, &skb->ll_node));
+
+	/* The cpu which queued the first packet processes the whole list */
+	if (first_n)
+		return NET_XMIT_SUCCESS;
 
 	spin_lock(root_lock);
+
+	ll_list = llist_del_all(&q->defer_list);
+	/* Not atomic with llist_del_all(), the list may briefly grow a bit
+	 * over q->limit.
+	 */
+	atomic_long_set(&q->defer_count, 0);
+
+	ll_list = llist_reverse_order(ll_list);
+
 	if (unlikely(test_bit(__QDISC_STATE_DEACTIVATED, &q->state))) {
-		__qdisc_drop(skb, &to_free);
+		llist_for_each_entry_safe(skb, next, ll_list, ll_node)
+			__qdisc_drop(skb, &to_free);
 		rc = NET_XMIT_DROP;
 	} else if ((q->flags & TCQ_F_CAN_BYPASS) && !qdisc_qlen(q) &&
-		   qdisc_run_begin(q)) {
+		   !llist_next(ll_list) && qdisc_run_begin(q)) {
 		/*
 		 * This is a work-conserving queue; there are no old skbs
 		 * waiting to be sent out; and the qdisc is not running -
 		 * xmit the skb directly.
 		 */
-
+		skb = llist_entry(ll_list, struct sk_buff, ll_node);
+		skb_mark_not_on_list(skb);
 		qdisc_bstats_update(q, skb);
 
-		if (sch_direct_xmit(skb, q, dev, txq, root_lock, true)) {
-			if (unlikely(contended)) {
-				spin_unlock(&q->busylock);
-				contended = false;
-			}
+		if (sch_direct_xmit(skb, q, dev, txq, root_lock, true))
 			__qdisc_run(q);
-		}
 
 		qdisc_run_end(q);
 		rc = NET_XMIT_SUCCESS;
 	} else {
-		rc = dev_qdisc_enqueue(skb, q, &to_free, txq);
-		if (qdisc_run_begin(q)) {
-			if (unlikely(contended)) {
-				spin_unlock(&q->busylock);
-				contended = false;
-			}
-			__qdisc_run(q);
-			qdisc_run_end(q);
+		int count = 0;
+
+		llist_for_each_entry_safe(skb, next, ll_list, ll_node) {
+			prefetch(next);
+			skb_mark_not_on_list(skb);
+			rc = dev_qdisc_enqueue(skb, q, &to_free, txq);
+			count++;
 		}
+		qdisc_run(q);
+		/* Only our own packet's verdict can be returned */
+		if (count != 1)
+			rc = NET_XMIT_SUCCESS;
 	}
 	spin_unlock(root_lock);
 	if (unlikely(to_free))
 		kfree_skb_list(to_free);
-	if (unlikely(contended))
-		spin_unlock(&q->busylock);
 	return rc;
 }
 
@@ -5919,13 +5943,11 @@ static void __napi_gro_flush_chain(struct napi_struct *napi, u32 index,
 void napi_gro_flush(struct napi_struct *napi, bool flush_old)
 {
 	unsigned long bitmask = napi->gro_bitmask;
-	unsigned int i, base = ~0U;
+	unsigned int i;
 
-	while ((i = ffs(bitmask)) != 0) {
-		bitmask >>= i;
-		base += i;
-		__napi_gro_flush_chain(napi, base, flush_old);
-	}
+	/* Up to BITS_PER_LONG buckets, don't truncate through ffs() */
+	for_each_set_bit(i, &bitmask, GRO_HASH_MAX_BUCKETS)
+		__napi_gro_flush_chain(napi, i, flush_old);
 }
 EXPORT_SYMBOL(napi_gro_flush);
 
@@ -6049,7 +6071,7 @@ static void gro_flush_oldest(struct napi_struct *napi, struct list_head *head)
 
 static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
-	u32 bucket = skb_get_hash_raw(skb) & (GRO_HASH_BUCKETS - 1);
+	u32 bucket = skb_get_hash_raw(skb) & napi->gro_hash_mask;
 	struct gro_list *gro_list = &napi->gro_hash[bucket];
 	struct list_head *head = &offload_base;
 	struct packet_offload *ptype;
@@ -6120,8 +6142,10 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 		gro_list->count--;
 	}
 
-	if (same_flow)
+	if (same_flow) {
+		__this_cpu_inc(softnet_data.gro_merged);
 		goto ok;
+	}
 
 	if (NAPI_GRO_CB(skb)->flush)
 		goto normal;
@@ -6136,6 +6160,7 @@ static enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff
 	NAPI_GRO_CB(skb)->last = skb;
 	skb_shinfo(skb)->gso_size = skb_gro_len(skb);
 	list_add(&skb->list, &gro_list->list);
+	__this_cpu_inc(softnet_data.gro_held);
 	ret = GRO_HELD;
 
 pull:
@@ -6825,17 +6850,38 @@ static enum hrtimer_restart napi_watchdog(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
-static void init_gro_hash(struct napi_struct *napi)
+static void init_gro_hash(struct napi_struct *napi, unsigned int buckets)
 {
-	int i;
+	unsigned int i;
 
-	for (i = 0; i < GRO_HASH_BUCKETS; i++) {
+	/* Many concurrent flows, e.g. QUIC, need more buckets to aggregate */
+	napi->gro_hash = napi->gro_hash_inline;
+	if (buckets > GRO_HASH_BUCKETS) {
+		struct gro_list *hash;
+
+		hash = kcalloc(buckets, sizeof(*hash), GFP_KERNEL);
+		if (hash)
+			napi->gro_hash = hash;
+		else
+			buckets = GRO_HASH_BUCKETS;
+	}
+	napi->gro_hash_mask = buckets - 1;
+
+	for (i = 0; i < buckets; i++) {
 		INIT_LIST_HEAD(&napi->gro_hash[i].list);
 		napi->gro_hash[i].count = 0;
 	}
 	napi->gro_bitmask = 0;
 }
 
+static void free_gro_hash(struct napi_struct *napi)
+{
+	if (napi->gro_hash != napi->gro_hash_inline)
+		kfree(napi->gro_hash);
+	napi->gro_hash = napi->gro_hash_inline;
+	napi->gro_hash_mask = GRO_HASH_BUCKETS - 1;
+}
+
 int dev_set_threaded(struct net_device *dev, bool threaded)
 {
 	struct napi_struct *napi;
@@ -6844,6 +6890,9 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 	if (dev->threaded == threaded)
 		return 0;
 
+	if (!threaded)
+		dev_set_threaded_busy_poll(dev, false);
+
 	if (threaded) {
 		list_for_each_entry(napi, &dev->napi_list, dev_list) {
 			if (!napi->thread) {
@@ -6880,6 +6929,32 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 }
 EXPORT_SYMBOL(dev_set_threaded);
 
+/**
+ * dev_set_threaded_busy_poll - make the napi threads of @dev busy poll
+ * @dev: device in threaded mode
+ * @busy_poll: whether to busy poll
+ *
+ * A busy polling thread keeps its NAPI scheduled and polls it without
+ * letting the driver re-enable the interrupt, until it found no packets
+ * for threaded_busy_poll_usecs.  The caller must hold rtnl.
+ */
+int dev_set_threaded_busy_poll(struct net_device *dev, bool busy_poll)
+{
+	struct napi_struct *napi;
+
+	if (busy_poll && !dev->threaded)
+		return -EINVAL;
+
+	dev->threaded_busy_poll = busy_poll;
+
+	list_for_each_entry(napi, &dev->napi_list, dev_list)
+		assign_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state,
+			   busy_poll);
+
+	return 0;
+}
+EXPORT_SYMBOL(dev_set_threaded_busy_poll);
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -6890,7 +6965,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	INIT_HLIST_NODE(&napi->napi_hash_node);
 	hrtimer_init(&napi->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
 	napi->timer.function = napi_watchdog;
-	init_gro_hash(napi);
+	init_gro_hash(napi, READ_ONCE(dev->gro_hash_buckets));
 	napi->skb = NULL;
 	INIT_LIST_HEAD(&napi->rx_list);
 	napi->rx_count = 0;
@@ -6931,6 +7006,7 @@ void napi_disable(struct napi_struct *n)
 	clear_bit(NAPI_STATE_PREFER_BUSY_POLL, &n->state);
 	clear_bit(NAPI_STATE_DISABLE, &n->state);
 	clear_bit(NAPI_STATE_THREADED, &n->state);
+	clear_bit(NAPI_STATE_THREADED_BUSY_POLL, &n->state);
 }
 EXPORT_SYMBOL(napi_disable);
 
@@ -6952,15 +7028,17 @@ void napi_enable(struct napi_struct *n)
 		new = val & ~(NAPIF_STATE_SCHED | NAPIF_STATE_NPSVC);
 		if (n->dev->threaded && n->thread)
 			new |= NAPIF_STATE_THREADED;
+		if (n->dev->threaded_busy_poll && n->thread)
+			new |= NAPIF_STATE_THREADED_BUSY_POLL;
 	} while (cmpxchg(&n->state, val, new) != val);
 }
 EXPORT_SYMBOL(napi_enable);
 
 static void flush_gro_hash(struct napi_struct *napi)
 {
-	int i;
+	unsigned int i;
 
-	for (i = 0; i < GRO_HASH_BUCKETS; i++) {
+	for (i = 0; i <= napi->gro_hash_mask; i++) {
 		struct sk_buff *skb, *n;
 
 		list_for_each_entry_safe(skb, n, &napi->gro_hash[i].list, list)
@@ -6980,6 +7058,7 @@ void __netif_napi_del(struct napi_struct *napi)
 	napi_free_frags(napi);
 
 	flush_gro_hash(napi);
+	free_gro_hash(napi);
 	napi->gro_bitmask = 0;
 
 	if (napi->thread) {
@@ -6989,6 +7068,41 @@ void __netif_napi_del(struct napi_struct *napi)
 }
 EXPORT_SYMBOL(__netif_napi_del);
 
+/**
+ * napi_gro_init - prepare a standalone napi_struct for GRO
+ * @napi: napi_struct that is never registered with a device
+ *
+ * Lets a context that feeds the stack by itself, such as a cpumap
+ * kthread, aggregate packets with napi_gro_receive(). It has to call
+ * napi_gro_flush_normal() with BHs disabled before it goes idle and
+ * napi_gro_cleanup() when done.
+ */
+void napi_gro_init(struct napi_struct *napi)
+{
+	init_gro_hash(napi, GRO_HASH_BUCKETS);
+	napi->skb = NULL;
+	INIT_LIST_HEAD(&napi->rx_list);
+	napi->rx_count = 0;
+}
+EXPORT_SYMBOL(napi_gro_init);
+
+/* Complete held packets and pass everything on to the stack */
+void napi_gro_flush_normal(struct napi_struct *napi, bool flush_old)
+{
+	if (napi->gro_bitmask)
+		napi_gro_flush(napi, flush_old);
+	gro_normal_list(napi);
+}
+EXPORT_SYMBOL(napi_gro_flush_normal);
+
+void napi_gro_cleanup(struct napi_struct *napi)
+{
+	flush_gro_hash(napi);
+	free_gro_hash(napi);
+	napi->gro_bitmask = 0;
+}
+EXPORT_SYMBOL(napi_gro_cleanup);
+
 static int __napi_poll(struct napi_struct *n, bool *repoll)
 {
 	int work, weight;
@@ -7005,6 +7119,8 @@ static int __napi_poll(struct napi_struct *n, bool *repoll)
 	if (test_bit(NAPI_STATE_SCHED, &n->state)) {
 		work = n->poll(n, weight);
 		trace_napi_poll(n, work, weight);
+		n->poll_count++;
+		n->poll_packets += work;
 	}
 
 	if (unlikely(work > weight))
@@ -7108,24 +7224,62 @@ static int napi_thread_wait(struct napi_struct *napi)
 	return -1;
 }
 
+/* Keep owning the NAPI and polling it with the device interrupt masked? */
+static bool napi_thread_want_busy_poll(struct napi_struct *napi, u64 idle_start)
+{
+	unsigned long val = READ_ONCE(napi->state);
+	unsigned int usecs;
+
+	if (!(val & NAPIF_STATE_THREADED_BUSY_POLL) ||
+	    (val & NAPIF_STATE_DISABLE) || kthread_should_stop())
+		return false;
+
+	usecs = READ_ONCE(napi->dev->threaded_busy_poll_usecs);
+	return !usecs || local_clock() - idle_start < (u64)usecs * NSEC_PER_USEC;
+}
+
 static int napi_threaded_poll(void *data)
 {
 	struct napi_struct *napi = data;
 	void *have;
 
 	while (!napi_thread_wait(napi)) {
+		u64 idle_start = local_clock();
+
 		for (;;) {
+			bool busy_poll = napi_thread_want_busy_poll(napi,
+								    idle_start);
 			bool repoll = false;
+			int work;
+
+			/* napi_complete_done() leaves the NAPI scheduled and
+			 * the interrupt masked while this bit is set. Once it
+			 * is cleared, the next poll completes as usual.
+			 */
+			assign_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state,
+				   busy_poll);
 
 			local_bh_disable();
 
 			have = netpoll_poll_lock(napi);
-			__napi_poll(napi, &repoll);
+			work = __napi_poll(napi, &repoll);
 			netpoll_poll_unlock(have);
 
+			/* Nobody else flushes GRO while we keep the NAPI */
+			if (busy_poll && !repoll) {
+				if (napi->gro_bitmask)
+					napi_gro_flush(napi, HZ >= 1000);
+				gro_normal_list(napi);
+			}
+
 			local_bh_enable();
 
-			if (!repoll)
+			if (work)
+				idle_start = local_clock();
+			else if (busy_poll)
+				napi->poll_idle++;
+
+			if (!repoll && !busy_poll)
 				break;
 
 			cond_resched();
@@ -10842,8 +10996,11 @@ struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
 
 	dev_net_set(dev, &init_net);
 
-	dev->gso_max_size = GSO_MAX_SIZE;
+	dev->gso_max_size = GSO_LEGACY_MAX_SIZE;
 	dev->gso_max_segs = GSO_MAX_SEGS;
+	dev->tso_max_size = GSO_LEGACY_MAX_SIZE;
+	dev->gro_max_size = GRO_LEGACY_MAX_SIZE;
+	dev->gro_hash_buckets = GRO_HASH_BUCKETS;
 	dev->upper_level = 1;
 	dev->lower_level = 1;
 #ifdef CONFIG_LOCKDEP
@@ -11385,7 +11542,7 @@ static struct hlist_head * __net_init netdev_create_hash(void)
 /* Initialize per network namespace state */
 static int __net_init netdev_init(struct net *net)
 {
-	BUILD_BUG_ON(GRO_HASH_BUCKETS >
+	BUILD_BUG_ON(GRO_HASH_MAX_BUCKETS >
 		     8 * sizeof_field(struct napi_struct, gro_bitmask));
 
 	INIT_LIST_HEAD(&net->dev_base_head);
@@ -11660,7 +11817,7 @@ static int __init net_dev_init(void)
 		sd->cpu = i;
 #endif
 
-		init_gro_hash(&sd->backlog);
+		init_gro_hash(&sd->backlog, GRO_HASH_BUCKETS);
 		sd->backlog.poll = process_backlog;
 		sd->backlog.weight = weight_p;
 	}
@@ -898,12 +898,19 @@ static void neigh_connect(struct neighbour *neigh)
 	neigh->output = neigh->ops->connected_output;
 }
 
+/* Buckets scanned by one run of the periodic GC, a full pass over a big
+ * table is spread over several runs instead of one long walk.
+ */
+#define NEIGH_GC_BUCKETS_PER_RUN	1024
+
 static void neigh_periodic_work(struct work_struct *work)
 {
 	struct neigh_table *tbl = container_of(work, struct neigh_table, gc_work.work);
+	unsigned long delay = NEIGH_VAR(&tbl->parms, BASE_REACHABLE_TIME) >> 1;
+	u64 start = local_clock();
 	struct neighbour *n;
 	struct neighbour __rcu **np;
-	unsigned int i;
+	unsigned int i, end, buckets;
 	struct neigh_hash_table *nht;
 
 	NEIGH_CACHE_STAT_INC(tbl, periodic_gc_runs);
@@ -924,10 +931,14 @@ static void neigh_periodic_work(struct work_struct *work)
 				neigh_rand_reach_time(NEIGH_VAR(p, BASE_REACHABLE_TIME));
 	}
 
-	if (atomic_read(&tbl->entries) < tbl->gc_thresh1)
+	if (!tbl->gc_bucket && atomic_read(&tbl->entries) < tbl->gc_thresh1)
 		goto out;
 
-	for (i = 0 ; i < (1 << nht->hash_shift); i++) {
+	buckets = 1 << nht->hash_shift;
+	i = tbl->gc_bucket;
+	end = min(i + NEIGH_GC_BUCKETS_PER_RUN, buckets);
+
+	for (; i < end && i < (1 << nht->hash_shift); i++) {
 		np = &nht->hash_buckets[i];
 
 		while ((n = rcu_dereference_protected(*np,
@@ -970,14 +981,25 @@ static void neigh_periodic_work(struct work_struct *work)
 		nht = rcu_dereference_protected(tbl->nht,
 						lockdep_is_held(&tbl->lock));
 	}
+
+	/* Spread the rest of the pass evenly over the cycle */
+	if (i < (1 << nht->hash_shift)) {
+		tbl->gc_bucket = i;
+		delay = max_t(unsigned long,
+			      delay * NEIGH_GC_BUCKETS_PER_RUN / buckets, 1);
+	} else {
+		tbl->gc_bucket = 0;
+	}
 out:
 	/* Cycle through all hash buckets every BASE_REACHABLE_TIME/2 ticks.
 	 * ARP entry timeouts range from 1/2 BASE_REACHABLE_TIME to 3/2
 	 * BASE_REACHABLE_TIME.
 	 */
-	queue_delayed_work(system_power_efficient_wq, &tbl->gc_work,
-			      NEIGH_VAR(&tbl->parms, BASE_REACHABLE_TIME) >> 1);
+	queue_delayed_work(system_power_efficient_wq, &tbl->gc_work, delay);
 	write_unlock_bh(&tbl->lock);
+
+	NEIGH_CACHE_STAT_ADD(tbl, periodic_gc_usecs,
+			     div_u64(local_clock() - start, NSEC_PER_USEC));
 }
 
 static __inline__ int neigh_max_probes(struct neighbour *n)
@@ -3337,13 +3359,13 @@ static int neigh_stat_seq_show(struct seq_file *seq, void *v)
 	struct neigh_statistics *st = v;
 
 	if (v == SEQ_START_TOKEN) {
-		seq_puts(seq, "entries  allocs   destroys hash_grows lookups  hits     res_failed rcv_probes_mcast rcv_probes_ucast periodic_gc_runs forced_gc_runs unresolved_discards table_fulls\n");
+		seq_puts(seq, "entries  allocs   destroys hash_grows lookups  hits     res_failed rcv_probes_mcast rcv_probes_ucast periodic_gc_runs forced_gc_runs unresolved_discards table_fulls periodic_gc_usecs\n");
 		return 0;
 	}
 
 	seq_printf(seq, "%08x %08lx %08lx %08lx   %08lx %08lx %08lx   "
 			"%08lx         %08lx         %08lx         "
-			"%08lx       %08lx            %08lx\n",
+			"%08lx       %08lx            %08lx    %08lx\n",
 		   atomic_read(&tbl->entries),
 
 		   st->allocs,
@@ -3361,7 +3383,8 @@ static int neigh_stat_seq_show(struct seq_file *seq, void *v)
 		   st->periodic_gc_runs,
 		   st->forced_gc_runs,
 		   st->unres_discards,
-		   st->table_fulls
+		   st->table_fulls,
+		   st->periodic_gc_usecs
 		   );
 
 	return 0;
@@ -167,12 +167,15 @@ static int softnet_seq_show(struct seq_file *seq, void *v)
 	 * mapping the data a specific CPU
 	 */
 	seq_printf(seq,
-		   "%08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x\n",
+		   "%08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x %08x\n",
 		   sd->processed, sd->dropped, sd->time_squeeze, 0,
 		   0, 0, 0, 0, /* was fastroute */
 		   0,	/* was cpu_collision */
 		   sd->received_rps, flow_limit_count,
-		   softnet_backlog_len(sd), (int)seq->index);
+		   softnet_backlog_len(sd), (int)seq->index,
+		   sd->skb_cache_hit, sd->skb_cache_refill,
+		   sd->skb_cache_put, sd->skb_cache_flush,
+		   sd->gro_held, sd->gro_merged);
 	return 0;
 }
 
@@ -310,6 +313,33 @@ static const struct seq_operations ptype_seq_ops = {
 	.show  = ptype_seq_show,
 };
 
+/* One line per NAPI instance, the pid is the napi thread if threaded */
+static int napi_stat_seq_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct napi_struct *napi;
+	struct net_device *dev;
+
+	seq_puts(seq, "dev napi_id pid polls packets idle\n");
+
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		list_for_each_entry_rcu(napi, &dev->napi_list, dev_list) {
+			struct task_struct *thread = READ_ONCE(napi->thread);
+
+			seq_printf(seq, "%s %u %d %llu %llu %llu\n",
+				   dev->name, napi->napi_id,
+				   thread ? task_pid_nr(thread) : 0,
+				   READ_ONCE(napi->poll_count),
+				   READ_ONCE(napi->poll_packets),
+				   READ_ONCE(napi->poll_idle));
+		}
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
 static int __net_init dev_proc_net_init(struct net *net)
 {
 	int rc = -ENOMEM;
@@ -323,12 +353,17 @@ static int __net_init dev_proc_net_init(struct net *net)
 	if (!proc_create_net("ptype", 0444, net->proc_net, &ptype_seq_ops,
 			sizeof(struct seq_net_private)))
 		goto out_softnet;
+	if (!proc_create_net_single("napi_stat", 0444, net->proc_net,
+				    napi_stat_seq_show, NULL))
+		goto out_ptype;
 
 	if (wext_proc_init(net))
-		goto out_ptype;
+		goto out_napi;
 	rc = 0;
 out:
 	return rc;
+out_napi:
+	remove_proc_entry("napi_stat", net->proc_net);
 out_ptype:
 	remove_proc_entry("ptype", net->proc_net);
 out_softnet:
@@ -342,6 +377,7 @@ static void __net_exit dev_proc_net_exit(struct net *net)
 {
 	wext_proc_exit(net);
 
+	remove_proc_entry("napi_stat", net->proc_net);
 	remove_proc_entry("ptype", net->proc_net);
 	remove_proc_entry("softnet_stat", net->proc_net);
 	remove_proc_entry("dev", net->proc_net);
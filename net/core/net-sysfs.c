@@ -421,6 +421,48 @@ static ssize_t napi_defer_hard_irqs_store(struct device *dev,
 }
 NETDEVICE_SHOW_RW(napi_defer_hard_irqs, fmt_dec);
 
+static int change_gro_hash_buckets(struct net_device *dev, unsigned long val)
+{
+	if (!val || val > GRO_HASH_MAX_BUCKETS || !is_power_of_2(val))
+		return -EINVAL;
+
+	WRITE_ONCE(dev->gro_hash_buckets, val);
+	return 0;
+}
+
+static ssize_t gro_hash_buckets_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len, change_gro_hash_buckets);
+}
+NETDEVICE_SHOW_RW(gro_hash_buckets, fmt_dec);
+
+static int change_threaded_busy_poll_usecs(struct net_device *dev,
+					   unsigned long val)
+{
+	if (val > UINT_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(dev->threaded_busy_poll_usecs, val);
+	return 0;
+}
+
+static ssize_t threaded_busy_poll_usecs_store(struct device *dev,
+					      struct device_attribute *attr,
+					      const char *buf, size_t len)
+{
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	return netdev_store(dev, attr, buf, len,
+			    change_threaded_busy_poll_usecs);
+}
+NETDEVICE_SHOW_RW(threaded_busy_poll_usecs, fmt_dec);
+
 static ssize_t ifalias_store(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -598,7 +640,8 @@ static ssize_t threaded_show(struct device *dev,
 		return restart_syscall();
 
 	if (dev_isalive(netdev))
-		ret = sprintf(buf, fmt_dec, netdev->threaded);
+		ret = sprintf(buf, fmt_dec,
+			      netdev->threaded + netdev->threaded_busy_poll);
 
 	rtnl_unlock();
 	return ret;
@@ -611,10 +654,13 @@ static int modify_napi_threaded(struct net_device *dev, unsigned long val)
 	if (list_empty(&dev->napi_list))
 		return -EOPNOTSUPP;
 
-	if (val != 0 && val != 1)
+	/* 2 makes the napi threads busy poll */
+	if (val > 2)
 		return -EOPNOTSUPP;
 
 	ret = dev_set_threaded(dev, val);
+	if (!ret && val)
+		ret = dev_set_threaded_busy_poll(dev, val == 2);
 
 	return ret;
 }
@@ -653,6 +699,8 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_tx_queue_len.attr,
 	&dev_attr_gro_flush_timeout.attr,
 	&dev_attr_napi_defer_hard_irqs.attr,
+	&dev_attr_gro_hash_buckets.attr,
+	&dev_attr_threaded_busy_poll_usecs.attr,
 	&dev_attr_phys_port_id.attr,
 	&dev_attr_phys_port_name.attr,
 	&dev_attr_phys_switch_id.attr,
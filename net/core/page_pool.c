@@ -225,53 +225,31 @@ static void page_pool_clear_pp_info(struct page *page)
 	page->pp = NULL;
 }
 
-static struct page *__page_pool_alloc_page_order(struct page_pool *pool,
-						 gfp_t gfp)
-{
-	struct page *page;
-
-	gfp |= __GFP_COMP;
-	page = alloc_pages_node(pool->p.nid, gfp, pool->p.order);
-	if (unlikely(!page))
-		return NULL;
-
-	if ((pool->p.flags & PP_FLAG_DMA_MAP) &&
-	    unlikely(!page_pool_dma_map(pool, page))) {
-		put_page(page);
-		return NULL;
-	}
-
-	page_pool_set_pp_info(pool, page);
-
-	/* Track how many pages are held 'in-flight' */
-	pool->pages_state_hold_cnt++;
-	trace_page_pool_state_hold(pool, page, pool->pages_state_hold_cnt);
-	return page;
-}
-
 /* slow path */
 noinline
 static struct page *__page_pool_alloc_pages_slow(struct page_pool *pool,
 						 gfp_t gfp)
 {
-	const int bulk = PP_ALLOC_CACHE_REFILL;
 	unsigned int pp_flags = pool->p.flags;
 	unsigned int pp_order = pool->p.order;
 	struct page *page;
 	int i, nr_pages;
-
-	/* Don't support bulk alloc for high-order pages */
-	if (unlikely(pp_order))
-		return __page_pool_alloc_page_order(pool, gfp);
+	int bulk;
 
 	/* Unnecessary as alloc cache is empty, but guarantees zero count */
 	if (unlikely(pool->alloc.count > 0))
 		return pool->alloc.cache[--pool->alloc.count];
 
+	/* Refill about the same amount of memory for high-order pools */
+	bulk = max(PP_ALLOC_CACHE_REFILL >> pp_order, 1);
+	if (pp_order)
+		gfp |= __GFP_COMP;
+
 	/* Mark empty alloc.cache slots "empty" for alloc_pages_bulk_array */
 	memset(&pool->alloc.cache, 0, sizeof(void *) * bulk);
 
-	nr_pages = alloc_pages_bulk_array(gfp, bulk, pool->alloc.cache);
+	nr_pages = alloc_pages_bulk_array_order_node(gfp, pool->p.nid, pp_order,
+						     bulk, pool->alloc.cache);
 	if (unlikely(!nr_pages))
 		return NULL;
 
@@ -41,6 +41,8 @@ void reqsk_queue_alloc(struct request_sock_queue *queue)
 	queue->fastopenq.qlen = 0;
 
 	queue->rskq_accept_head = NULL;
+	queue->rskq_accept_batch = NULL;
+	queue->rskq_batch_taken = 0;
 }
 
 /*
@@ -67,6 +67,7 @@
 #include <net/sock.h>
 #include <net/checksum.h>
 #include <net/ip6_checksum.h>
+#include <net/ipv6.h>
 #include <net/xfrm.h>
 #include <net/mpls.h>
 #include <net/mptcp.h>
@@ -129,7 +130,10 @@ static void skb_under_panic(struct sk_buff *skb, unsigned int sz, void *addr)
 struct napi_alloc_cache {
 	struct page_frag_cache page;
 	unsigned int skb_count;
+	unsigned int fclone_count;
 	void *skb_cache[NAPI_SKB_CACHE_SIZE];
+	/* TX heads from skbuff_fclone_cache, see skb_fclone_cache_get() */
+	void *fclone_cache[NAPI_SKB_CACHE_SIZE];
 };
 
 static DEFINE_PER_CPU(struct page_frag_cache, netdev_alloc_cache);
@@ -169,21 +173,76 @@ void *__netdev_alloc_frag_align(unsigned int fragsz, unsigned int align_mask)
 }
 EXPORT_SYMBOL(__netdev_alloc_frag_align);
 
+/* The per-CPU caches are only touched with BH disabled */
+static void *__napi_cache_get(struct kmem_cache *cache, void **objs,
+			      unsigned int *count)
+{
+	void *obj;
+
+	if (unlikely(!*count)) {
+		*count = kmem_cache_alloc_bulk(cache, GFP_ATOMIC,
+					       NAPI_SKB_CACHE_BULK, objs);
+		if (unlikely(!*count))
+			return NULL;
+		__this_cpu_inc(softnet_data.skb_cache_refill);
+	}
+
+	obj = objs[--*count];
+	kasan_unpoison_object_data(cache, obj);
+	__this_cpu_inc(softnet_data.skb_cache_hit);
+
+	return obj;
+}
+
+static void __napi_cache_put(struct kmem_cache *cache, void **objs,
+			     unsigned int *count, void *obj)
+{
+	u32 i;
+
+	kasan_poison_object_data(cache, obj);
+	objs[(*count)++] = obj;
+	__this_cpu_inc(softnet_data.skb_cache_put);
+
+	if (unlikely(*count == NAPI_SKB_CACHE_SIZE)) {
+		for (i = NAPI_SKB_CACHE_HALF; i < NAPI_SKB_CACHE_SIZE; i++)
+			kasan_unpoison_object_data(cache, objs[i]);
+
+		kmem_cache_free_bulk(cache, NAPI_SKB_CACHE_HALF,
+				     objs + NAPI_SKB_CACHE_HALF);
+		*count = NAPI_SKB_CACHE_HALF;
+		__this_cpu_inc(softnet_data.skb_cache_flush);
+	}
+}
+
 static struct sk_buff *napi_skb_cache_get(void)
 {
 	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
-	struct sk_buff *skb;
 
-	if (unlikely(!nc->skb_count))
-		nc->skb_count = kmem_cache_alloc_bulk(skbuff_head_cache,
-						      GFP_ATOMIC,
-						      NAPI_SKB_CACHE_BULK,
-						      nc->skb_cache);
-	if (unlikely(!nc->skb_count))
-		return NULL;
+	return __napi_cache_get(skbuff_head_cache, nc->skb_cache,
+				&nc->skb_count);
+}
 
-	skb = nc->skb_cache[--nc->skb_count];
-	kasan_unpoison_object_data(skbuff_head_cache, skb);
+/* The fclone cache is also used from process context, e.g. by
+ * tcp_sendmsg_locked(), so it can't rely on running in softirq.
+ */
+static bool skb_cache_usable(int node)
+{
+	if (node != NUMA_NO_NODE && node != numa_mem_id())
+		return false;
+
+	return !in_hardirq() && !irqs_disabled();
+}
+
+static struct sk_buff *skb_fclone_cache_get(void)
+{
+	struct napi_alloc_cache *nc;
+	struct sk_buff *skb;
+
+	local_bh_disable();
+	nc = this_cpu_ptr(&napi_alloc_cache);
+	skb = __napi_cache_get(skbuff_fclone_cache, nc->fclone_cache,
+			       &nc->fclone_count);
+	local_bh_enable();
 
 	return skb;
 }
@@ -409,10 +468,17 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 
 	/* Get the HEAD */
 	if ((flags & (SKB_ALLOC_FCLONE | SKB_ALLOC_NAPI)) == SKB_ALLOC_NAPI &&
-	    likely(node == NUMA_NO_NODE || node == numa_mem_id()))
+	    likely(node == NUMA_NO_NODE || node == numa_mem_id())) {
 		skb = napi_skb_cache_get();
-	else
-		skb = kmem_cache_alloc_node(cache, gfp_mask & ~GFP_DMA, node);
+	} else {
+		skb = NULL;
+		if ((flags & SKB_ALLOC_FCLONE) && skb_cache_usable(node))
+			skb = skb_fclone_cache_get();
+		/* The cache refills with GFP_ATOMIC, retry with @gfp_mask */
+		if (unlikely(!skb))
+			skb = kmem_cache_alloc_node(cache, gfp_mask & ~GFP_DMA,
+						    node);
+	}
 	if (unlikely(!skb))
 		return NULL;
 	prefetchw(skb);
@@ -691,13 +757,20 @@ static void skb_release_data(struct sk_buff *skb)
 /*
  *	Free an skbuff by memory without cleaning the state.
  */
-static void kfree_skbmem(struct sk_buff *skb)
+static void napi_skb_cache_put(struct sk_buff *skb);
+static void skb_fclone_cache_put(struct sk_buff_fclones *fclones);
+
+/* @cached: BH is disabled and the head can go to the per-CPU caches */
+static void __kfree_skbmem(struct sk_buff *skb, bool cached)
 {
 	struct sk_buff_fclones *fclones;
 
 	switch (skb->fclone) {
 	case SKB_FCLONE_UNAVAILABLE:
-		kmem_cache_free(skbuff_head_cache, skb);
+		if (cached)
+			napi_skb_cache_put(skb);
+		else
+			kmem_cache_free(skbuff_head_cache, skb);
 		return;
 
 	case SKB_FCLONE_ORIG:
@@ -718,7 +791,15 @@ static void kfree_skbmem(struct sk_buff *skb)
 	if (!refcount_dec_and_test(&fclones->fclone_ref))
 		return;
 fastpath:
-	kmem_cache_free(skbuff_fclone_cache, fclones);
+	if (cached)
+		skb_fclone_cache_put(fclones);
+	else
+		kmem_cache_free(skbuff_fclone_cache, fclones);
+}
+
+static void kfree_skbmem(struct sk_buff *skb)
+{
+	__kfree_skbmem(skb, false);
 }
 
 void skb_release_head_state(struct sk_buff *skb)
@@ -933,21 +1014,41 @@ void __consume_stateless_skb(struct sk_buff *skb)
 static void napi_skb_cache_put(struct sk_buff *skb)
 {
 	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
-	u32 i;
 
-	kasan_poison_object_data(skbuff_head_cache, skb);
-	nc->skb_cache[nc->skb_count++] = skb;
+	__napi_cache_put(skbuff_head_cache, nc->skb_cache, &nc->skb_count,
+			 skb);
+}
 
-	if (unlikely(nc->skb_count == NAPI_SKB_CACHE_SIZE)) {
-		for (i = NAPI_SKB_CACHE_HALF; i < NAPI_SKB_CACHE_SIZE; i++)
-			kasan_unpoison_object_data(skbuff_head_cache,
-						   nc->skb_cache[i]);
+static void skb_fclone_cache_put(struct sk_buff_fclones *fclones)
+{
+	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
 
-		kmem_cache_free_bulk(skbuff_head_cache, NAPI_SKB_CACHE_HALF,
-				     nc->skb_cache + NAPI_SKB_CACHE_HALF);
-		nc->skb_count = NAPI_SKB_CACHE_HALF;
+	__napi_cache_put(skbuff_fclone_cache, nc->fclone_cache,
+			 &nc->fclone_count, fclones);
+}
+
+/**
+ *	__kfree_skb_cached - free an skbuff through the per-CPU head caches
+ *	@skb: buffer to free
+ *
+ *	Like __kfree_skb(), but the head goes back to the per-CPU caches
+ *	__alloc_skb() allocates from and only reaches the slab in bulk.
+ *	Can be called from process and softirq context, e.g. when TCP
+ *	frees acknowledged skbs from tcp_clean_rtx_queue().
+ */
+void __kfree_skb_cached(struct sk_buff *skb)
+{
+	if (unlikely(in_hardirq() || irqs_disabled())) {
+		__kfree_skb(skb);
+		return;
 	}
+
+	skb_release_all(skb);
+	local_bh_disable();
+	__kfree_skbmem(skb, true);
+	local_bh_enable();
 }
+EXPORT_SYMBOL(__kfree_skb_cached);
 
 void __kfree_skb_defer(struct sk_buff *skb)
 {
@@ -1219,7 +1320,7 @@ struct ubuf_info *msg_zerocopy_alloc(struct sock *sk, size_t size)
 	uarg->len = 1;
 	uarg->bytelen = size;
 	uarg->zerocopy = 1;
-	uarg->flags = SKBFL_ZEROCOPY_FRAG;
+	uarg->flags = SKBFL_ZEROCOPY_FRAG | SKBFL_DONT_ORPHAN;
 	refcount_set(&uarg->refcnt, 1);
 	sock_hold(sk);
 
@@ -4363,12 +4464,30 @@ int skb_gro_receive(struct sk_buff *p, struct sk_buff *skb)
 	unsigned int headlen = skb_headlen(skb);
 	unsigned int len = skb_gro_len(skb);
 	unsigned int delta_truesize;
+	unsigned int gro_max_size;
 	unsigned int new_truesize;
 	struct sk_buff *lp;
 
-	if (unlikely(p->len + len >= 65536 || NAPI_GRO_CB(skb)->flush))
+	/* pairs with WRITE_ONCE() in netif_set_gro_max_size() */
+	gro_max_size = READ_ONCE(p->dev->gro_max_size);
+
+	if (unlikely(p->len + len >= gro_max_size || NAPI_GRO_CB(skb)->flush))
 		return -E2BIG;
 
+	/* Page pool frags must not end up in an skb that puts its pages */
+	if (unlikely(p->pp_recycle != skb->pp_recycle))
+		return -ETOOMANYREFS;
+
+	if (unlikely(p->len + len >= GRO_LEGACY_MAX_SIZE)) {
+		/* Only plain IPv6 can grow past 64KB, ipv6_gro_complete()
+		 * needs room in front of the headers for the HBH jumbo header.
+		 */
+		if (p->protocol != htons(ETH_P_IPV6) ||
+		    skb_headroom(p) < sizeof(struct hop_jumbo_hdr) ||
+		    p->encapsulation)
+			return -E2BIG;
+	}
+
 	lp = NAPI_GRO_CB(p)->last;
 	pinfo = skb_shinfo(lp);
 
@@ -76,7 +76,7 @@ struct inet_bind_bucket *inet_bind_bucket_create(struct kmem_cache *cachep,
 		tb->fastreuse = 0;
 		tb->fastreuseport = 0;
 		INIT_HLIST_HEAD(&tb->owners);
-		hlist_add_head(&tb->node, &head->chain);
+		hlist_add_head_rcu(&tb->node, &head->chain);
 	}
 	return tb;
 }
@@ -87,7 +87,8 @@ struct inet_bind_bucket *inet_bind_bucket_create(struct kmem_cache *cachep,
 void inet_bind_bucket_destroy(struct kmem_cache *cachep, struct inet_bind_bucket *tb)
 {
 	if (hlist_empty(&tb->owners)) {
-		__hlist_del(&tb->node);
+		/* __inet_hash_connect() may still be walking the chain */
+		hlist_del_rcu(&tb->node);
 		kmem_cache_free(cachep, tb);
 	}
 }
@@ -438,7 +439,8 @@ EXPORT_SYMBOL_GPL(__inet_lookup_established);
 /* called with local bh disabled */
 static int __inet_check_established(struct inet_timewait_death_row *death_row,
 				    struct sock *sk, __u16 lport,
-				    struct inet_timewait_sock **twp)
+				    struct inet_timewait_sock **twp,
+				    bool rcu_lookup)
 {
 	struct inet_hashinfo *hinfo = death_row->hashinfo;
 	struct inet_sock *inet = inet_sk(sk);
@@ -457,6 +459,22 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 
+	/* Called under rcu_read_lock(), only tells whether the port is
+	 * worth taking the locks for.  TIME_WAIT sockets may be recycled,
+	 * leave them to the locked lookup.
+	 */
+	if (rcu_lookup) {
+		sk_nulls_for_each_rcu(sk2, node, &head->chain) {
+			if (sk2->sk_hash != hash ||
+			    !INET_MATCH(net, sk2, acookie, ports, dif, sdif))
+				continue;
+			if (sk2->sk_state == TCP_TIME_WAIT)
+				break;
+			return -EADDRNOTAVAIL;
+		}
+		return 0;
+	}
+
 	spin_lock(lock);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
@@ -733,7 +751,8 @@ static u32 *table_perturb;
 int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		struct sock *sk, u64 port_offset,
 		int (*check_established)(struct inet_timewait_death_row *,
-			struct sock *, __u16, struct inet_timewait_sock **))
+			struct sock *, __u16, struct inet_timewait_sock **,
+			bool rcu_lookup))
 {
 	struct inet_hashinfo *hinfo = death_row->hashinfo;
 	struct inet_timewait_sock *tw = NULL;
@@ -758,7 +777,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		}
 		spin_unlock(&head->lock);
 		/* No definite answer... Walk to established hash table */
-		ret = check_established(death_row, sk, port, NULL);
+		ret = check_established(death_row, sk, port, NULL, false);
 		local_bh_enable();
 		return ret;
 	}
@@ -791,6 +810,26 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 			continue;
 		head = &hinfo->bhash[inet_bhashfn(net, port,
 						  hinfo->bhash_size)];
+
+		/* Under heavy connect() load most ports are in use: skip
+		 * them without taking the bind and ehash bucket locks.
+		 */
+		rcu_read_lock();
+		inet_bind_bucket_for_each_rcu(tb, &head->chain) {
+			if (!net_eq(ib_net(tb), net) || tb->l3mdev != l3mdev ||
+			    tb->port != port)
+				continue;
+			if (tb->fastreuse >= 0 || tb->fastreuseport >= 0) {
+				rcu_read_unlock();
+				goto next_port_unlocked;
+			}
+			if (!check_established(death_row, sk, port, NULL, true))
+				break;
+			rcu_read_unlock();
+			goto next_port_unlocked;
+		}
+		rcu_read_unlock();
+
 		spin_lock_bh(&head->lock);
 
 		/* Does not bother with rcv_saddr checks, because
@@ -804,7 +843,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 					goto next_port;
 				WARN_ON(hlist_empty(&tb->owners));
 				if (!check_established(death_row, sk,
-						       port, &tw))
+						       port, &tw, false))
 					goto ok;
 				goto next_port;
 			}
@@ -821,6 +860,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		goto ok;
 next_port:
 		spin_unlock_bh(&head->lock);
+next_port_unlocked:
 		cond_resched();
 	}
 
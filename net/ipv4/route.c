@@ -2198,6 +2198,76 @@ int ip_route_use_hint(struct sk_buff *skb, __be32 daddr, __be32 saddr,
 	return err;
 }
 
+/* Per cpu cache of FIB results for the input path.
+ *
+ * Without custom rules a lookup only depends on the destination, tos,
+ * scope and oif, so the result can be reused for the next packets to the
+ * same destination as long as rt_genid did not move. Every FIB change
+ * that invalidates cached dsts bumps rt_genid, and fib_info is freed
+ * after a grace period, so a valid entry never points to freed memory.
+ * Entries are keyed on the netns cookie rather than the struct net
+ * pointer: a new netns can reuse the memory of a dead one, and its
+ * rt_genid starts from 0 again, so pointer and genid could match an entry
+ * whose fib_info is long gone. Cookies are never reused.
+ * Only used from softirq, where nothing else on this cpu can touch the
+ * cache concurrently.
+ */
+#define FIB_RES_CACHE_BITS	8
+
+struct fib_res_cache_entry {
+	u64			net_cookie;
+	__be32			daddr;
+	int			oif;
+	u8			tos;
+	u8			scope;
+	int			genid;
+	int			err;
+	struct fib_result	res;
+};
+
+static DEFINE_PER_CPU(struct fib_res_cache_entry [1 << FIB_RES_CACHE_BITS],
+		      fib_res_cache);
+
+static int ip_route_input_fib_lookup(struct net *net, struct flowi4 *fl4,
+				     struct fib_result *res)
+{
+	struct fib_res_cache_entry *e;
+	unsigned int hash;
+	int genid, err;
+
+	if (!in_serving_softirq() || fib4_has_custom_rules(net))
+		return fib_lookup(net, fl4, res, 0);
+
+	hash = jhash_3words((__force u32)fl4->daddr, fl4->flowi4_oif,
+			    fl4->flowi4_tos, net_hash_mix(net));
+	e = this_cpu_ptr(&fib_res_cache[hash & ((1 << FIB_RES_CACHE_BITS) - 1)]);
+
+	genid = rt_genid_ipv4(net);
+	if (e->genid == genid && e->net_cookie == net->net_cookie &&
+	    e->daddr == fl4->daddr && e->oif == fl4->flowi4_oif &&
+	    e->tos == fl4->flowi4_tos && e->scope == fl4->flowi4_scope) {
+		*res = e->res;
+		return e->err;
+	}
+
+	/* genid is sampled before the lookup so that a result racing with
+	 * a FIB change is stored as already stale.
+	 */
+	err = fib_lookup(net, fl4, res, 0);
+
+	e->net_cookie = net->net_cookie;
+	e->daddr = fl4->daddr;
+	e->oif = fl4->flowi4_oif;
+	e->tos = fl4->flowi4_tos;
+	e->scope = fl4->flowi4_scope;
+	e->genid = genid;
+	e->err = err;
+	if (!err)
+		e->res = *res;
+
+	return err;
+}
+
 /* get device for dst_alloc with local routes */
 static struct net_device *ip_rt_get_dev(struct net *net,
 					const struct fib_result *res)
@@ -2306,7 +2376,7 @@ static int ip_route_input_slow(struct sk_buff *skb, __be32 daddr, __be32 saddr,
 		fl4.fl4_dport = 0;
 	}
 
-	err = fib_lookup(net, &fl4, res, 0);
+	err = ip_route_input_fib_lookup(net, &fl4, res);
 	if (err != 0) {
 		if (!IN_DEV_FORWARD(in_dev))
 			err = -EHOSTUNREACH;
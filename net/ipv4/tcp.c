@@ -463,6 +463,7 @@ void tcp_init_sock(struct sock *sk)
 
 	sk_sockets_allocated_inc(sk);
 	sk->sk_route_forced_caps = NETIF_F_GSO;
+	set_bit(SOCK_SUPPORT_ZC, &sk->sk_socket->flags);
 }
 EXPORT_SYMBOL(tcp_init_sock);
 
@@ -1212,17 +1213,28 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 
 	flags = msg->msg_flags;
 
-	if (flags & MSG_ZEROCOPY && size && sock_flag(sk, SOCK_ZEROCOPY)) {
+	if ((flags & MSG_ZEROCOPY) && size) {
 		skb = tcp_write_queue_tail(sk);
-		uarg = msg_zerocopy_realloc(sk, size, skb_zcopy(skb));
-		if (!uarg) {
-			err = -ENOBUFS;
-			goto out_err;
-		}
 
-		zc = sk->sk_route_caps & NETIF_F_SG;
-		if (!zc)
-			uarg->zerocopy = 0;
+		/*
+		 * msg_ubuf comes from in-kernel senders only, which always hand
+		 * over pinned pages as a bvec. Whatever a msghdr built from a
+		 * user iovec carries in there is not ours to look at.
+		 */
+		if (iov_iter_is_bvec(&msg->msg_iter) && msg->msg_ubuf) {
+			uarg = msg->msg_ubuf;
+			net_zcopy_get(uarg);
+			zc = sk->sk_route_caps & NETIF_F_SG;
+		} else if (sock_flag(sk, SOCK_ZEROCOPY)) {
+			uarg = msg_zerocopy_realloc(sk, size, skb_zcopy(skb));
+			if (!uarg) {
+				err = -ENOBUFS;
+				goto out_err;
+			}
+			zc = sk->sk_route_caps & NETIF_F_SG;
+			if (!zc)
+				uarg->zerocopy = 0;
+		}
 	}
 
 	if (unlikely(flags & MSG_FASTOPEN || inet_sk(sk)->defer_connect) &&
@@ -1832,10 +1844,21 @@ static void tcp_zerocopy_set_hint_for_skb(struct sock *sk,
 
 	/* Find the frag containing this offset (and how far into that frag) */
 	frag = skb_advance_to_frag(skb, offset, &frag_offset);
-	if (!frag)
-		return;
+	if (!frag) {
+		struct skb_shared_info *info = skb_shinfo(skb);
+
+		if (offset >= skb_headlen(skb) || skb_has_frag_list(skb) ||
+		    !info->nr_frags)
+			return;
 
-	if (frag_offset) {
+		/* In the linear part, e.g. a protocol header split off by
+		 * the NIC: only that part must be read, the frags after it
+		 * may still be mappable.
+		 */
+		partial_frag_remainder = skb_headlen(skb) - offset;
+		zc->recv_skip_hint -= partial_frag_remainder;
+		frag = info->frags;
+	} else if (frag_offset) {
 		struct skb_shared_info *info = skb_shinfo(skb);
 
 		/* We read part of the last frag, must recvmsg() rest of skb. */
@@ -2139,8 +2162,12 @@ static int tcp_zerocopy_receive(struct sock *sk,
 			}
 			zc->recv_skip_hint = skb->len - offset;
 			frags = skb_advance_to_frag(skb, offset, &offset_frag);
-			if (!frags || offset_frag)
+			if (!frags || offset_frag) {
+				/* Only copy up to the next mappable frag */
+				tcp_zerocopy_set_hint_for_skb(sk, zc, skb,
+							      offset);
 				break;
+			}
 		}
 
 		mappable_offset = find_next_mappable_frag(frags,
@@ -3669,6 +3696,12 @@ static int do_tcp_setsockopt(struct sock *sk, int level, int optname,
 			tcp_enable_tx_delay();
 		tp->tcp_tx_delay = val;
 		break;
+	case TCP_PACING_HORIZON:
+		if (val < 0)
+			err = -EINVAL;
+		else
+			tp->pacing_horizon_us = val;
+		break;
 	default:
 		err = -ENOPROTOOPT;
 		break;
@@ -4141,6 +4174,10 @@ static int do_tcp_getsockopt(struct sock *sk, int level,
 		val = tp->tcp_tx_delay;
 		break;
 
+	case TCP_PACING_HORIZON:
+		val = tp->pacing_horizon_us;
+		break;
+
 	case TCP_TIMESTAMP:
 		val = tcp_time_stamp_raw() + tp->tsoffset;
 		break;
@@ -4547,7 +4584,7 @@ void __init tcp_init(void)
 		kmem_cache_create("tcp_bind_bucket",
 				  sizeof(struct inet_bind_bucket), 0,
 				  SLAB_HWCACHE_ALIGN | SLAB_PANIC |
-				  SLAB_ACCOUNT,
+				  SLAB_ACCOUNT | SLAB_TYPESAFE_BY_RCU,
 				  NULL);
 
 	/* Size and allocate the main established and bind bucket
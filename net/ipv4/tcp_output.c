@@ -1214,6 +1214,15 @@ static void tcp_update_skb_after_send(struct sock *sk, struct sk_buff *skb,
 			len_ns -= min_t(u64, len_ns / 2, credit);
 			tp->tcp_wstamp_ns += len_ns;
 		}
+		/* Do not schedule further ahead than the qdisc (fq horizon)
+		 * or the NIC launch time logic is willing to hold packets.
+		 */
+		if (tp->pacing_horizon_us) {
+			u64 horizon = tp->tcp_clock_cache +
+				      (u64)tp->pacing_horizon_us * NSEC_PER_USEC;
+
+			tp->tcp_wstamp_ns = min(tp->tcp_wstamp_ns, horizon);
+		}
 	}
 	list_move_tail(&skb->tcp_tsorted_anchor, &tp->tsorted_sent_queue);
 }
@@ -1551,7 +1560,7 @@ int tcp_fragment(struct sock *sk, enum tcp_queue tcp_queue,
 	 * SO_SNDBUF values.
 	 * Also allow first and last skb in retransmit queue to be split.
 	 */
-	limit = sk->sk_sndbuf + 2 * SKB_TRUESIZE(GSO_MAX_SIZE);
+	limit = sk->sk_sndbuf + 2 * SKB_TRUESIZE(GSO_LEGACY_MAX_SIZE);
 	if (unlikely((sk->sk_wmem_queued >> 1) > limit &&
 		     tcp_queue != TCP_FRAG_IN_WRITE_QUEUE &&
 		     skb != tcp_rtx_queue_head(sk) &&
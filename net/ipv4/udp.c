@@ -1507,6 +1507,43 @@ static void udp_skb_dtor_locked(struct sock *sk, struct sk_buff *skb)
 static int udp_busylocks_log __read_mostly;
 static spinlock_t *udp_busylocks __read_mostly;
 
+/* While the segments of a GRO packet are queued to @sk, a single wakeup is
+ * issued for the whole train instead of one per datagram. Delivery runs in
+ * softirq context, so a per cpu slot is enough to track the batch.
+ */
+struct udp_batch {
+	struct sock	*sk;
+	bool		pending;
+};
+static DEFINE_PER_CPU(struct udp_batch, udp_batch);
+
+/**
+ * udp_batch_begin - start deferring wakeups of @sk on this cpu
+ * @sk: socket the segments are about to be queued to
+ *
+ * Returns false when a batch is already in progress (e.g. for an outer
+ * socket while delivering encapsulated traffic), in which case the wakeups
+ * of @sk are not deferred and udp_batch_end() must not be called.
+ */
+bool udp_batch_begin(struct sock *sk)
+{
+	if (__this_cpu_read(udp_batch.sk))
+		return false;
+
+	__this_cpu_write(udp_batch.sk, sk);
+	__this_cpu_write(udp_batch.pending, false);
+	return true;
+}
+EXPORT_SYMBOL_GPL(udp_batch_begin);
+
+void udp_batch_end(struct sock *sk)
+{
+	__this_cpu_write(udp_batch.sk, NULL);
+	if (__this_cpu_read(udp_batch.pending) && !sock_flag(sk, SOCK_DEAD))
+		sk->sk_data_ready(sk);
+}
+EXPORT_SYMBOL_GPL(udp_batch_end);
+
 static spinlock_t *busylock_acquire(void *ptr)
 {
 	spinlock_t *busy;
@@ -1580,7 +1617,9 @@ int __udp_enqueue_schedule_skb(struct sock *sk, struct sk_buff *skb)
 	__skb_queue_tail(list, skb);
 	spin_unlock(&list->lock);
 
-	if (!sock_flag(sk, SOCK_DEAD))
+	if (__this_cpu_read(udp_batch.sk) == sk)
+		__this_cpu_write(udp_batch.pending, true);
+	else if (!sock_flag(sk, SOCK_DEAD))
 		sk->sk_data_ready(sk);
 
 	busylock_release(busy);
@@ -2226,6 +2265,7 @@ static int udp_queue_rcv_one_skb(struct sock *sk, struct sk_buff *skb)
 static int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct sk_buff *next, *segs;
+	bool batch;
 	int ret;
 
 	if (likely(!udp_unexpected_gso(sk, skb)))
@@ -2234,6 +2274,7 @@ static int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	BUILD_BUG_ON(sizeof(struct udp_skb_cb) > SKB_GSO_CB_OFFSET);
 	__skb_push(skb, -skb_mac_offset(skb));
 	segs = udp_rcv_segment(sk, skb, true);
+	batch = udp_batch_begin(sk);
 	skb_list_walk_safe(segs, skb, next) {
 		__skb_pull(skb, skb_transport_offset(skb));
 
@@ -2242,6 +2283,8 @@ static int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 		if (ret > 0)
 			ip_protocol_deliver_rcu(dev_net(skb->dev), skb, ret);
 	}
+	if (batch)
+		udp_batch_end(sk);
 	return 0;
 }
 
@@ -757,6 +757,7 @@ static int udpv6_queue_rcv_one_skb(struct sock *sk, struct sk_buff *skb)
 static int udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct sk_buff *next, *segs;
+	bool batch;
 	int ret;
 
 	if (likely(!udp_unexpected_gso(sk, skb)))
@@ -764,6 +765,7 @@ static int udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 
 	__skb_push(skb, -skb_mac_offset(skb));
 	segs = udp_rcv_segment(sk, skb, false);
+	batch = udp_batch_begin(sk);
 	skb_list_walk_safe(segs, skb, next) {
 		__skb_pull(skb, skb_transport_offset(skb));
 
@@ -773,6 +775,8 @@ static int udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 			ip6_protocol_deliver_rcu(dev_net(skb->dev), skb, ret,
 						 true);
 	}
+	if (batch)
+		udp_batch_end(sk);
 	return 0;
 }
 
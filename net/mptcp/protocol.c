@@ -1445,11 +1445,10 @@ bool mptcp_subflow_active(struct mptcp_subflow_context *subflow)
 	return __mptcp_subflow_active(subflow);
 }
 
-/* implement the mptcp packet scheduler;
- * returns the subflow that will transmit the next DSS
- * additionally updates the rtx timeout
+/* default packet scheduler: picks the subflow with the lowest estimated
+ * linger time, additionally updates the rtx timeout
  */
-static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+static struct sock *mptcp_sched_default_get_subflow(struct mptcp_sock *msk)
 {
 	struct subflow_send_info send_info[2];
 	struct mptcp_subflow_context *subflow;
@@ -1460,14 +1459,6 @@ static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 	u64 ratio;
 	u32 pace;
 
-	sock_owned_by_me(sk);
-
-	if (__mptcp_check_fallback(msk)) {
-		if (!msk->first)
-			return NULL;
-		return sk_stream_memory_free(msk->first) ? msk->first : NULL;
-	}
-
 	/* re-use last subflow, if the burst allow that */
 	if (msk->last_snd && msk->snd_burst > 0 &&
 	    sk_stream_memory_free(msk->last_snd) &&
@@ -1519,6 +1510,84 @@ static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 	return NULL;
 }
 
+struct mptcp_sched_ops mptcp_sched_default = {
+	.get_subflow	= mptcp_sched_default_get_subflow,
+	.name		= "default",
+	.owner		= THIS_MODULE,
+};
+
+/* round-robin packet scheduler: hands a full burst to each non backup
+ * subflow in turn, and falls back to the default scheduler when none of
+ * them can send
+ */
+static struct sock *mptcp_sched_rr_get_subflow(struct mptcp_sock *msk)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *sk = (struct sock *)msk;
+	struct sock *ssk, *first = NULL, *next = NULL;
+	bool after_last = false;
+	long tout = 0;
+
+	if (msk->last_snd && msk->snd_burst > 0 &&
+	    sk_stream_memory_free(msk->last_snd) &&
+	    mptcp_subflow_active(mptcp_subflow_ctx(msk->last_snd))) {
+		mptcp_set_timeout(sk);
+		return msk->last_snd;
+	}
+
+	mptcp_for_each_subflow(msk, subflow) {
+		ssk = mptcp_subflow_tcp_sock(subflow);
+		if (ssk == msk->last_snd) {
+			after_last = true;
+			continue;
+		}
+
+		if (!mptcp_subflow_active(subflow))
+			continue;
+
+		tout = max(tout, mptcp_timeout_from_subflow(subflow));
+		if (subflow->backup || !sk_stream_memory_free(ssk) ||
+		    !tcp_sk(ssk)->snd_wnd)
+			continue;
+
+		if (!first)
+			first = ssk;
+		if (after_last && !next)
+			next = ssk;
+	}
+
+	if (!next)
+		next = first;
+	if (!next)
+		return mptcp_sched_default_get_subflow(msk);
+
+	__mptcp_set_timeout(sk, tout);
+	msk->last_snd = next;
+	msk->snd_burst = min_t(int, MPTCP_SEND_BURST_SIZE,
+			       tcp_sk(next)->snd_wnd);
+	return next;
+}
+
+static struct mptcp_sched_ops mptcp_sched_rr = {
+	.get_subflow	= mptcp_sched_rr_get_subflow,
+	.name		= "roundrobin",
+	.owner		= THIS_MODULE,
+};
+
+/* returns the subflow that will transmit the next DSS */
+static struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
+{
+	sock_owned_by_me((struct sock *)msk);
+
+	if (__mptcp_check_fallback(msk)) {
+		if (!msk->first)
+			return NULL;
+		return sk_stream_memory_free(msk->first) ? msk->first : NULL;
+	}
+
+	return msk->sched->get_subflow(msk);
+}
+
 static void mptcp_push_release(struct sock *sk, struct sock *ssk,
 			       struct mptcp_sendmsg_info *info)
 {
@@ -2522,6 +2591,7 @@ static int __mptcp_init_sock(struct sock *sk)
 static int mptcp_init_sock(struct sock *sk)
 {
 	struct inet_connection_sock *icsk = inet_csk(sk);
+	char sched_name[MPTCP_SCHED_NAME_MAX];
 	struct net *net = sock_net(sk);
 	int ret;
 
@@ -2539,6 +2609,11 @@ static int mptcp_init_sock(struct sock *sk)
 	if (ret)
 		return ret;
 
+	mptcp_get_scheduler(net, sched_name);
+	rcu_read_lock();
+	mptcp_init_sched(mptcp_sk(sk), mptcp_sched_find(sched_name));
+	rcu_read_unlock();
+
 	/* fetch the ca name; do it outside __mptcp_init_sock(), so that clone will
 	 * propagate the correct value
 	 */
@@ -2839,6 +2914,7 @@ struct sock *mptcp_sk_clone(const struct sock *sk,
 	__mptcp_init_sock(nsk);
 
 	msk = mptcp_sk(nsk);
+	mptcp_init_sched(msk, mptcp_sk(sk)->sched);
 	msk->local_key = subflow_req->local_key;
 	msk->token = subflow_req->token;
 	msk->subflow = NULL;
@@ -2951,6 +3027,7 @@ void mptcp_destroy_common(struct mptcp_sock *msk)
 	skb_rbtree_purge(&msk->out_of_order_queue);
 	mptcp_token_destroy(msk);
 	mptcp_pm_free_anno_list(msk);
+	mptcp_release_sched(msk);
 }
 
 static void mptcp_destroy(struct sock *sk)
@@ -3576,6 +3653,9 @@ void __init mptcp_proto_init(void)
 	mptcp_pm_init();
 	mptcp_token_init();
 
+	mptcp_register_scheduler(&mptcp_sched_default);
+	mptcp_register_scheduler(&mptcp_sched_rr);
+
 	if (proto_register(&mptcp_prot, 1) != 0)
 		panic("Failed to register MPTCP proto.\n");
 
@@ -271,6 +271,7 @@ struct mptcp_sock {
 
 	u32 setsockopt_seq;
 	char		ca_name[TCP_CA_NAME_MAX];
+	struct mptcp_sched_ops	*sched;
 };
 
 #define mptcp_lock_sock(___sk, cb) do {					\
@@ -566,6 +567,7 @@ unsigned int mptcp_get_add_addr_timeout(const struct net *net);
 int mptcp_is_checksum_enabled(const struct net *net);
 int mptcp_allow_join_id0(const struct net *net);
 unsigned int mptcp_stale_loss_cnt(const struct net *net);
+void mptcp_get_scheduler(const struct net *net, char *name);
 void mptcp_subflow_fully_established(struct mptcp_subflow_context *subflow,
 				     struct mptcp_options_received *mp_opt);
 bool __mptcp_retransmit_pending_data(struct sock *sk);
@@ -697,6 +699,11 @@ static inline void mptcp_write_space(struct sock *sk)
 
 void mptcp_destroy_common(struct mptcp_sock *msk);
 
+extern struct mptcp_sched_ops mptcp_sched_default;
+struct mptcp_sched_ops *mptcp_sched_find(const char *name);
+void mptcp_init_sched(struct mptcp_sock *msk, struct mptcp_sched_ops *sched);
+void mptcp_release_sched(struct mptcp_sock *msk);
+
 #define MPTCP_TOKEN_MAX_RETRIES	4
 
 void __init mptcp_token_init(void);
@@ -39,6 +39,14 @@ struct ip_vs_mh_lookup {
 	struct ip_vs_dest __rcu	*dest;	/* real server (cache) */
 };
 
+/* Lookup tables are built aside and swapped in, so the scheduler never
+ * sees a table that is half way through a reassignment.
+ */
+struct ip_vs_mh_table {
+	struct rcu_head			rcu_head;
+	struct ip_vs_mh_lookup		lookup[];
+};
+
 struct ip_vs_mh_dest_setup {
 	unsigned int	offset; /* starting offset */
 	unsigned int	skip;	/* skip */
@@ -60,7 +68,7 @@ static int primes[] = {251, 509, 1021, 2039, 4093,
 
 struct ip_vs_mh_state {
 	struct rcu_head			rcu_head;
-	struct ip_vs_mh_lookup		*lookup;
+	struct ip_vs_mh_table __rcu	*table;
 	struct ip_vs_mh_dest_setup	*dest_setup;
 	hsiphash_key_t			hash1, hash2;
 	int				gcd;
@@ -101,22 +109,25 @@ ip_vs_mh_hashkey(int af, const union nf_inet_addr *addr,
 	return hsiphash(&v, sizeof(v), key);
 }
 
-/* Reset all the hash buckets of the specified table. */
-static void ip_vs_mh_reset(struct ip_vs_mh_state *s)
+static struct ip_vs_mh_table *ip_vs_mh_table_alloc(void)
+{
+	struct ip_vs_mh_table *t;
+
+	return kzalloc(struct_size(t, lookup, IP_VS_MH_TAB_SIZE), GFP_KERNEL);
+}
+
+/* Drop the dests of a table that is no longer reachable by new lookups */
+static void ip_vs_mh_table_release(struct ip_vs_mh_table *t)
 {
-	int i;
-	struct ip_vs_mh_lookup *l;
 	struct ip_vs_dest *dest;
+	int i;
 
-	l = &s->lookup[0];
 	for (i = 0; i < IP_VS_MH_TAB_SIZE; i++) {
-		dest = rcu_dereference_protected(l->dest, 1);
-		if (dest) {
+		dest = rcu_dereference_protected(t->lookup[i].dest, 1);
+		if (dest)
 			ip_vs_dest_put(dest);
-			RCU_INIT_POINTER(l->dest, NULL);
-		}
-		l++;
 	}
+	kfree_rcu(t, rcu_head);
 }
 
 static int ip_vs_mh_permutate(struct ip_vs_mh_state *s,
@@ -157,22 +168,21 @@ static int ip_vs_mh_permutate(struct ip_vs_mh_state *s,
 }
 
 static int ip_vs_mh_populate(struct ip_vs_mh_state *s,
+			     struct ip_vs_mh_table *t,
 			     struct ip_vs_service *svc)
 {
 	int n, c, dt_count;
 	unsigned long *table;
 	struct list_head *p;
 	struct ip_vs_mh_dest_setup *ds;
-	struct ip_vs_dest *dest, *new_dest;
+	struct ip_vs_dest *dest;
 
 	/* If gcd is smaller then 1, number of dests or
 	 * all last_weight of dests are zero. So, skip
-	 * the population for the dests and reset lookup table.
+	 * the population for the dests and leave the table empty.
 	 */
-	if (s->gcd < 1) {
-		ip_vs_mh_reset(s);
+	if (s->gcd < 1)
 		return 0;
-	}
 
 	table = kcalloc(BITS_TO_LONGS(IP_VS_MH_TAB_SIZE),
 			sizeof(unsigned long), GFP_KERNEL);
@@ -206,14 +216,9 @@ static int ip_vs_mh_populate(struct ip_vs_mh_state *s,
 
 			__set_bit(c, table);
 
-			dest = rcu_dereference_protected(s->lookup[c].dest, 1);
-			new_dest = list_entry(p, struct ip_vs_dest, n_list);
-			if (dest != new_dest) {
-				if (dest)
-					ip_vs_dest_put(dest);
-				ip_vs_dest_hold(new_dest);
-				RCU_INIT_POINTER(s->lookup[c].dest, new_dest);
-			}
+			dest = list_entry(p, struct ip_vs_dest, n_list);
+			ip_vs_dest_hold(dest);
+			RCU_INIT_POINTER(t->lookup[c].dest, dest);
 
 			if (++n == IP_VS_MH_TAB_SIZE)
 				goto out;
@@ -238,7 +243,8 @@ ip_vs_mh_get(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
 {
 	unsigned int hash = ip_vs_mh_hashkey(svc->af, addr, port, &s->hash1, 0)
 					     % IP_VS_MH_TAB_SIZE;
-	struct ip_vs_dest *dest = rcu_dereference(s->lookup[hash].dest);
+	struct ip_vs_mh_table *t = rcu_dereference(s->table);
+	struct ip_vs_dest *dest = rcu_dereference(t->lookup[hash].dest);
 
 	return (!dest || is_unavailable(dest)) ? NULL : dest;
 }
@@ -248,6 +254,7 @@ static inline struct ip_vs_dest *
 ip_vs_mh_get_fallback(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
 		      const union nf_inet_addr *addr, __be16 port)
 {
+	struct ip_vs_mh_table *t = rcu_dereference(s->table);
 	unsigned int offset, roffset;
 	unsigned int hash, ihash;
 	struct ip_vs_dest *dest;
@@ -255,7 +262,7 @@ ip_vs_mh_get_fallback(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
 	/* First try the dest it's supposed to go to */
 	ihash = ip_vs_mh_hashkey(svc->af, addr, port,
 				 &s->hash1, 0) % IP_VS_MH_TAB_SIZE;
-	dest = rcu_dereference(s->lookup[ihash].dest);
+	dest = rcu_dereference(t->lookup[ihash].dest);
 	if (!dest)
 		return NULL;
 	if (!is_unavailable(dest))
@@ -271,7 +278,7 @@ ip_vs_mh_get_fallback(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
 		roffset = (offset + ihash) % IP_VS_MH_TAB_SIZE;
 		hash = ip_vs_mh_hashkey(svc->af, addr, port, &s->hash1,
 					roffset) % IP_VS_MH_TAB_SIZE;
-		dest = rcu_dereference(s->lookup[hash].dest);
+		dest = rcu_dereference(t->lookup[hash].dest);
 		if (!dest)
 			break;
 		if (!is_unavailable(dest))
@@ -285,28 +292,42 @@ ip_vs_mh_get_fallback(struct ip_vs_service *svc, struct ip_vs_mh_state *s,
 	return NULL;
 }
 
-/* Assign all the hash buckets of the specified table with the service. */
+/* Build a new lookup table for the service and swap it in. */
 static int ip_vs_mh_reassign(struct ip_vs_mh_state *s,
 			     struct ip_vs_service *svc)
 {
+	struct ip_vs_mh_table *t, *old;
 	int ret;
 
 	if (svc->num_dests > IP_VS_MH_TAB_SIZE)
 		return -EINVAL;
 
+	t = ip_vs_mh_table_alloc();
+	if (!t)
+		return -ENOMEM;
+
 	if (svc->num_dests >= 1) {
 		s->dest_setup = kcalloc(svc->num_dests,
 					sizeof(struct ip_vs_mh_dest_setup),
 					GFP_KERNEL);
-		if (!s->dest_setup)
+		if (!s->dest_setup) {
+			kfree(t);
 			return -ENOMEM;
+		}
 	}
 
 	ip_vs_mh_permutate(s, svc);
 
-	ret = ip_vs_mh_populate(s, svc);
-	if (ret < 0)
+	ret = ip_vs_mh_populate(s, t, svc);
+	if (ret < 0) {
+		ip_vs_mh_table_release(t);
 		goto out;
+	}
+
+	old = rcu_dereference_protected(s->table, 1);
+	rcu_assign_pointer(s->table, t);
+	if (old)
+		ip_vs_mh_table_release(old);
 
 	IP_VS_DBG_BUF(6, "MH: reassign lookup table of %s:%u\n",
 		      IP_VS_DBG_ADDR(svc->af, &svc->addr),
@@ -375,7 +396,6 @@ static void ip_vs_mh_state_free(struct rcu_head *head)
 	struct ip_vs_mh_state *s;
 
 	s = container_of(head, struct ip_vs_mh_state, rcu_head);
-	kfree(s->lookup);
 	kfree(s);
 }
 
@@ -389,13 +409,6 @@ static int ip_vs_mh_init_svc(struct ip_vs_service *svc)
 	if (!s)
 		return -ENOMEM;
 
-	s->lookup = kcalloc(IP_VS_MH_TAB_SIZE, sizeof(struct ip_vs_mh_lookup),
-			    GFP_KERNEL);
-	if (!s->lookup) {
-		kfree(s);
-		return -ENOMEM;
-	}
-
 	generate_hash_secret(&s->hash1, &s->hash2);
 	s->gcd = ip_vs_mh_gcd_weight(svc);
 	s->rshift = ip_vs_mh_shift_weight(svc, s->gcd);
@@ -407,7 +420,6 @@ static int ip_vs_mh_init_svc(struct ip_vs_service *svc)
 	/* Assign the lookup table with current dests */
 	ret = ip_vs_mh_reassign(s, svc);
 	if (ret < 0) {
-		ip_vs_mh_reset(s);
 		ip_vs_mh_state_free(&s->rcu_head);
 		return ret;
 	}
@@ -422,7 +434,7 @@ static void ip_vs_mh_done_svc(struct ip_vs_service *svc)
 	struct ip_vs_mh_state *s = svc->sched_data;
 
 	/* Got to clean up lookup entry here */
-	ip_vs_mh_reset(s);
+	ip_vs_mh_table_release(rcu_dereference_protected(s->table, 1));
 
 	call_rcu(&s->rcu_head, ip_vs_mh_state_free);
 	IP_VS_DBG(6, "MH lookup table (memory=%zdbytes) released\n",
@@ -65,7 +65,8 @@ EXPORT_SYMBOL_GPL(nf_conntrack_hash);
 
 struct conntrack_gc_work {
 	struct delayed_work	dwork;
-	u32			next_bucket;
+	unsigned int		id;
+	u32			next_bucket;	/* relative to the slice start */
 	u32			avg_timeout;
 	u32			start_time;
 	bool			exiting;
@@ -96,7 +97,14 @@ static DEFINE_MUTEX(nf_conntrack_mutex);
 #define MIN_CHAINLEN	8u
 #define MAX_CHAINLEN	(32u - MIN_CHAINLEN)
 
-static struct conntrack_gc_work conntrack_gc_work;
+/* The table is split in as many slices as there are gc workers, each
+ * worker scans its own slice so big tables are collected in parallel.
+ */
+#define GC_WORKERS_MAX		8u
+#define GC_SLICE_MIN		65536u
+
+static struct conntrack_gc_work conntrack_gc_work[GC_WORKERS_MAX];
+static unsigned int conntrack_gc_workers __read_mostly = 1;
 
 void nf_conntrack_lock(spinlock_t *lock) __acquires(lock)
 {
@@ -1435,18 +1443,19 @@ static void gc_worker(struct work_struct *work)
 {
 	unsigned int i, hashsz, nf_conntrack_max95 = 0;
 	u32 end_time, start_time = nfct_time_stamp;
+	unsigned int slice_start, slice_end;
 	struct conntrack_gc_work *gc_work;
+	struct hlist_nulls_head *ct_hash;
 	unsigned int expired_count = 0;
 	unsigned long next_run;
 	s32 delta_time;
 
 	gc_work = container_of(work, struct conntrack_gc_work, dwork.work);
 
-	i = gc_work->next_bucket;
 	if (gc_work->early_drop)
 		nf_conntrack_max95 = nf_conntrack_max / 100u * 95u;
 
-	if (i == 0) {
+	if (gc_work->next_bucket == 0) {
 		gc_work->avg_timeout = GC_SCAN_INTERVAL_INIT;
 		gc_work->start_time = start_time;
 	}
@@ -1455,9 +1464,18 @@ static void gc_worker(struct work_struct *work)
 
 	end_time = start_time + GC_SCAN_MAX_DURATION;
 
-	do {
+	/* After a resize the scan carries on at the same offset into the
+	 * new slice, gc is best-effort.
+	 */
+	rcu_read_lock();
+	nf_conntrack_get_ht(&ct_hash, &hashsz);
+	rcu_read_unlock();
+	slice_start = (u64)hashsz * gc_work->id / conntrack_gc_workers;
+	slice_end = (u64)hashsz * (gc_work->id + 1) / conntrack_gc_workers;
+	i = slice_start + gc_work->next_bucket;
+
+	while (i < slice_end) {
 		struct nf_conntrack_tuple_hash *h;
-		struct hlist_nulls_head *ct_hash;
 		struct hlist_nulls_node *n;
 		struct nf_conn *tmp;
 
@@ -1484,7 +1502,7 @@ static void gc_worker(struct work_struct *work)
 			if (expired_count > GC_SCAN_EXPIRED_MAX) {
 				rcu_read_unlock();
 
-				gc_work->next_bucket = i;
+				gc_work->next_bucket = i - slice_start;
 				gc_work->avg_timeout = next_run;
 
 				delta_time = nfct_time_stamp - gc_work->start_time;
@@ -1538,13 +1556,13 @@ static void gc_worker(struct work_struct *work)
 		i++;
 
 		delta_time = nfct_time_stamp - end_time;
-		if (delta_time > 0 && i < hashsz) {
+		if (delta_time > 0 && i < slice_end) {
 			gc_work->avg_timeout = next_run;
-			gc_work->next_bucket = i;
+			gc_work->next_bucket = i - slice_start;
 			next_run = 0;
 			goto early_exit;
 		}
-	} while (i < hashsz);
+	}
 
 	gc_work->next_bucket = 0;
 
@@ -1563,15 +1581,27 @@ static void gc_worker(struct work_struct *work)
 	if (next_run)
 		gc_work->early_drop = false;
 
-	queue_delayed_work(system_power_efficient_wq, &gc_work->dwork, next_run);
+	queue_delayed_work(system_unbound_wq, &gc_work->dwork, next_run);
 }
 
-static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work)
+static void conntrack_gc_work_init(struct conntrack_gc_work *gc_work,
+				   unsigned int id)
 {
 	INIT_DELAYED_WORK(&gc_work->dwork, gc_worker);
+	gc_work->id = id;
 	gc_work->exiting = false;
 }
 
+/* Table full, let every worker evict entries on its next run */
+static void conntrack_gc_set_early_drop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < conntrack_gc_workers; i++)
+		if (!READ_ONCE(conntrack_gc_work[i].early_drop))
+			WRITE_ONCE(conntrack_gc_work[i].early_drop, true);
+}
+
 static struct nf_conn *
 __nf_conntrack_alloc(struct net *net,
 		     const struct nf_conntrack_zone *zone,
@@ -1588,8 +1618,7 @@ __nf_conntrack_alloc(struct net *net,
 
 	if (nf_conntrack_max && unlikely(ct_count > nf_conntrack_max)) {
 		if (!early_drop(net, hash)) {
-			if (!conntrack_gc_work.early_drop)
-				conntrack_gc_work.early_drop = true;
+			conntrack_gc_set_early_drop();
 			atomic_dec(&cnet->count);
 			net_warn_ratelimited("nf_conntrack: table full, dropping packet\n");
 			return ERR_PTR(-ENOMEM);
@@ -2506,14 +2535,20 @@ static int kill_all(struct nf_conn *i, void *data)
 
 void nf_conntrack_cleanup_start(void)
 {
-	conntrack_gc_work.exiting = true;
+	unsigned int i;
+
+	for (i = 0; i < conntrack_gc_workers; i++)
+		conntrack_gc_work[i].exiting = true;
 	RCU_INIT_POINTER(ip_ct_attach, NULL);
 }
 
 void nf_conntrack_cleanup_end(void)
 {
+	unsigned int i;
+
 	RCU_INIT_POINTER(nf_ct_hook, NULL);
-	cancel_delayed_work_sync(&conntrack_gc_work.dwork);
+	for (i = 0; i < conntrack_gc_workers; i++)
+		cancel_delayed_work_sync(&conntrack_gc_work[i].dwork);
 	kvfree(nf_conntrack_hash);
 
 	nf_conntrack_proto_fini();
@@ -2795,8 +2830,15 @@ int nf_conntrack_init_start(void)
 	if (ret < 0)
 		goto err_proto;
 
-	conntrack_gc_work_init(&conntrack_gc_work);
-	queue_delayed_work(system_power_efficient_wq, &conntrack_gc_work.dwork, HZ);
+	/* One worker per GC_SLICE_MIN buckets, at most one per cpu */
+	conntrack_gc_workers = clamp_t(unsigned int,
+				       nf_conntrack_htable_size / GC_SLICE_MIN, 1,
+				       min(GC_WORKERS_MAX, num_possible_cpus()));
+	for (i = 0; i < conntrack_gc_workers; i++) {
+		conntrack_gc_work_init(&conntrack_gc_work[i], i);
+		queue_delayed_work(system_unbound_wq,
+				   &conntrack_gc_work[i].dwork, HZ);
+	}
 
 	return 0;
 
@@ -215,6 +215,19 @@ static int nf_flow_tuple_ip(struct sk_buff *skb, const struct net_device *dev,
 	return 0;
 }
 
+/* A GRO aggregate is forwarded as is and accounted for all its segments */
+static void nf_flow_acct(struct flow_offload *flow,
+			 enum flow_offload_tuple_dir dir,
+			 const struct sk_buff *skb)
+{
+	unsigned int packets = 1;
+
+	if (skb_is_gso(skb))
+		packets = skb_shinfo(skb)->gso_segs ?: 1;
+
+	nf_ct_acct_add(flow->ct, dir, packets, skb->len);
+}
+
 /* Based on ip_exceeds_mtu(). */
 static bool nf_flow_exceeds_mtu(const struct sk_buff *skb, unsigned int mtu)
 {
@@ -375,7 +388,7 @@ nf_flow_offload_ip_hook(void *priv, struct sk_buff *skb,
 	skb->tstamp = 0;
 
 	if (flow_table->flags & NF_FLOWTABLE_COUNTER)
-		nf_ct_acct_update(flow->ct, tuplehash->tuple.dir, skb->len);
+		nf_flow_acct(flow, tuplehash->tuple.dir, skb);
 
 	if (unlikely(tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_XFRM)) {
 		rt = (struct rtable *)tuplehash->tuple.dst_cache;
@@ -615,7 +628,7 @@ nf_flow_offload_ipv6_hook(void *priv, struct sk_buff *skb,
 	skb->tstamp = 0;
 
 	if (flow_table->flags & NF_FLOWTABLE_COUNTER)
-		nf_ct_acct_update(flow->ct, tuplehash->tuple.dir, skb->len);
+		nf_flow_acct(flow, tuplehash->tuple.dir, skb);
 
 	if (unlikely(tuplehash->tuple.xmit_type == FLOW_OFFLOAD_XMIT_XFRM)) {
 		rt = (struct rt6_info *)tuplehash->tuple.dst_cache;
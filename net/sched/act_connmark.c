@@ -39,9 +39,8 @@ static int tcf_connmark_act(struct sk_buff *skb, const struct tc_action *a,
 	struct nf_conn *c;
 	int proto;
 
-	spin_lock(&ca->tcf_lock);
 	tcf_lastuse_update(&ca->tcf_tm);
-	bstats_update(&ca->tcf_bstats, skb);
+	tcf_action_update_bstats(&ca->common, skb);
 
 	switch (skb_protocol(skb, true)) {
 	case htons(ETH_P_IP):
@@ -64,7 +63,7 @@ static int tcf_connmark_act(struct sk_buff *skb, const struct tc_action *a,
 	if (c) {
 		skb->mark = c->mark;
 		/* using overlimits stats to count how many packets marked */
-		ca->tcf_qstats.overlimits++;
+		tcf_action_inc_overlimit_qstats(&ca->common);
 		goto out;
 	}
 
@@ -72,7 +71,7 @@ static int tcf_connmark_act(struct sk_buff *skb, const struct tc_action *a,
 			       proto, ca->net, &tuple))
 		goto out;
 
-	zone.id = ca->zone;
+	zone.id = READ_ONCE(ca->zone);
 	zone.dir = NF_CT_DEFAULT_ZONE_DIR;
 
 	thash = nf_conntrack_find_get(ca->net, &zone, &tuple);
@@ -81,13 +80,12 @@ static int tcf_connmark_act(struct sk_buff *skb, const struct tc_action *a,
 
 	c = nf_ct_tuplehash_to_ctrack(thash);
 	/* using overlimits stats to count how many packets marked */
-	ca->tcf_qstats.overlimits++;
+	tcf_action_inc_overlimit_qstats(&ca->common);
 	skb->mark = c->mark;
 	nf_ct_put(c);
 
 out:
-	spin_unlock(&ca->tcf_lock);
-	return ca->tcf_action;
+	return READ_ONCE(ca->tcf_action);
 }
 
 static const struct nla_policy connmark_policy[TCA_CONNMARK_MAX + 1] = {
@@ -124,7 +122,7 @@ static int tcf_connmark_init(struct net *net, struct nlattr *nla,
 	ret = tcf_idr_check_alloc(tn, &index, a, bind);
 	if (!ret) {
 		ret = tcf_idr_create(tn, index, est, a,
-				     &act_connmark_ops, bind, false, flags);
+				     &act_connmark_ops, bind, true, flags);
 		if (ret) {
 			tcf_idr_cleanup(tn, index);
 			return ret;
@@ -155,7 +153,7 @@ static int tcf_connmark_init(struct net *net, struct nlattr *nla,
 		/* replacing action and zone */
 		spin_lock_bh(&ci->tcf_lock);
 		goto_ch = tcf_action_set_ctrlact(*a, parm->action, goto_ch);
-		ci->zone = parm->zone;
+		WRITE_ONCE(ci->zone, parm->zone);
 		spin_unlock_bh(&ci->tcf_lock);
 		if (goto_ch)
 			tcf_chain_put_by_act(goto_ch);
@@ -61,7 +61,7 @@ static int tcf_nat_init(struct net *net, struct nlattr *nla, struct nlattr *est,
 	err = tcf_idr_check_alloc(tn, &index, a, bind);
 	if (!err) {
 		ret = tcf_idr_create(tn, index, est, a,
-				     &act_nat_ops, bind, false, flags);
+				     &act_nat_ops, bind, true, flags);
 		if (ret) {
 			tcf_idr_cleanup(tn, index);
 			return ret;
@@ -122,10 +122,10 @@ static int tcf_nat_act(struct sk_buff *skb, const struct tc_action *a,
 	egress = p->flags & TCA_NAT_FLAG_EGRESS;
 	action = p->tcf_action;
 
-	bstats_update(&p->tcf_bstats, skb);
-
 	spin_unlock(&p->tcf_lock);
 
+	tcf_action_update_bstats(&p->common, skb);
+
 	if (unlikely(action == TC_ACT_SHOT))
 		goto drop;
 
@@ -248,9 +248,7 @@ static int tcf_nat_act(struct sk_buff *skb, const struct tc_action *a,
 	return action;
 
 drop:
-	spin_lock(&p->tcf_lock);
-	p->tcf_qstats.drops++;
-	spin_unlock(&p->tcf_lock);
+	tcf_action_inc_drop_qstats(&p->common);
 	return TC_ACT_SHOT;
 }
 
@@ -99,10 +99,22 @@ struct fl_flow_tmplt {
 	struct tcf_chain *chain;
 };
 
+/* Dissects every key used by any mask of the classifier, so a packet is
+ * dissected once and then looked up in each mask's hashtable.
+ */
+struct fl_dissector {
+	struct flow_dissector dissector;
+	struct fl_flow_key key;	/* union of all mask keys */
+	/* both exact and range port masks, see fl_classify() */
+	bool copy_ports;
+	struct rcu_head rcu;
+};
+
 struct cls_fl_head {
 	struct rhashtable ht;
 	spinlock_t masks_lock; /* Protect masks list */
 	struct list_head masks;
+	struct fl_dissector __rcu *dissector;
 	struct list_head hw_filters;
 	struct rcu_work rwork;
 	struct idr handle_idr;
@@ -200,12 +212,6 @@ static bool fl_mask_fits_tmplt(struct fl_flow_tmplt *tmplt,
 	return true;
 }
 
-static void fl_clear_masked_range(struct fl_flow_key *key,
-				  struct fl_flow_mask *mask)
-{
-	memset(fl_key_get_start(key, mask), 0, fl_mask_range(mask));
-}
-
 static bool fl_range_port_dst_cmp(struct cls_fl_filter *filter,
 				  struct fl_flow_key *key,
 				  struct fl_flow_key *mkey)
@@ -312,27 +318,39 @@ static int fl_classify(struct sk_buff *skb, const struct tcf_proto *tp,
 	struct cls_fl_head *head = rcu_dereference_bh(tp->root);
 	bool post_ct = tc_skb_cb(skb)->post_ct;
 	u16 zone = tc_skb_cb(skb)->zone;
+	struct flow_dissector *dissector;
+	struct fl_dissector *fl_dissector;
 	struct fl_flow_key skb_key;
 	struct fl_flow_mask *mask;
 	struct cls_fl_filter *f;
 
-	list_for_each_entry_rcu(mask, &head->masks, list) {
-		flow_dissector_init_keys(&skb_key.control, &skb_key.basic);
-		fl_clear_masked_range(&skb_key, mask);
+	fl_dissector = rcu_dereference_bh(head->dissector);
+	if (!fl_dissector)
+		return -1;
+	dissector = &fl_dissector->dissector;
 
-		skb_flow_dissect_meta(skb, &mask->dissector, &skb_key);
-		/* skb_flow_dissect() does not set n_proto in case an unknown
-		 * protocol, so do it rather here.
-		 */
-		skb_key.basic.n_proto = skb_protocol(skb, false);
-		skb_flow_dissect_tunnel_info(skb, &mask->dissector, &skb_key);
-		skb_flow_dissect_ct(skb, &mask->dissector, &skb_key,
-				    fl_ct_info_to_flower_map,
-				    ARRAY_SIZE(fl_ct_info_to_flower_map),
-				    post_ct, zone);
-		skb_flow_dissect_hash(skb, &mask->dissector, &skb_key);
-		skb_flow_dissect(skb, &mask->dissector, &skb_key, 0);
+	memset(&skb_key, 0, sizeof(skb_key));
+	flow_dissector_init_keys(&skb_key.control, &skb_key.basic);
 
+	skb_flow_dissect_meta(skb, dissector, &skb_key);
+	/* skb_flow_dissect() does not set n_proto in case an unknown
+	 * protocol, so do it rather here.
+	 */
+	skb_key.basic.n_proto = skb_protocol(skb, false);
+	skb_flow_dissect_tunnel_info(skb, dissector, &skb_key);
+	skb_flow_dissect_ct(skb, dissector, &skb_key,
+			    fl_ct_info_to_flower_map,
+			    ARRAY_SIZE(fl_ct_info_to_flower_map),
+			    post_ct, zone);
+	skb_flow_dissect_hash(skb, dissector, &skb_key);
+	skb_flow_dissect(skb, dissector, &skb_key, 0);
+	/* With both port keys in the union the dissector only fills in the
+	 * exact one, range masks look at their own copy of the ports.
+	 */
+	if (fl_dissector->copy_ports)
+		skb_key.tp_range.tp = skb_key.tp;
+
+	list_for_each_entry_rcu(mask, &head->masks, list) {
 		f = fl_mask_lookup(mask, &skb_key);
 		if (f && !tc_skip_sw(f->flags)) {
 			*res = f->res;
@@ -571,6 +589,7 @@ static void fl_destroy_sleepable(struct work_struct *work)
 						rwork);
 
 	rhashtable_destroy(&head->ht);
+	kfree(rcu_dereference_raw(head->dissector));
 	kfree(head);
 	module_put(THIS_MODULE);
 }
@@ -1826,9 +1845,38 @@ static void fl_init_dissector(struct flow_dissector *dissector,
 	skb_flow_dissector_init(dissector, keys, cnt);
 }
 
+/* Called with masks_lock held, installs @new as the dissector for the
+ * current set of masks and returns the one it replaces. Removed masks are
+ * only dropped from the union on the next rebuild, dissecting a few keys
+ * too many is harmless.
+ */
+static struct fl_dissector *fl_update_dissector(struct cls_fl_head *head,
+						struct fl_dissector *new)
+{
+	unsigned long *key = (unsigned long *)&new->key;
+	struct fl_flow_mask *mask;
+	int i;
+
+	memset(&new->key, 0, sizeof(new->key));
+	list_for_each_entry(mask, &head->masks, list) {
+		const unsigned long *mkey = (const unsigned long *)&mask->key;
+
+		for (i = 0; i < sizeof(new->key) / sizeof(long); i++)
+			key[i] |= mkey[i];
+	}
+	fl_init_dissector(&new->dissector, &new->key);
+	new->copy_ports =
+		dissector_uses_key(&new->dissector, FLOW_DISSECTOR_KEY_PORTS) &&
+		dissector_uses_key(&new->dissector, FLOW_DISSECTOR_KEY_PORTS_RANGE);
+
+	return rcu_replace_pointer(head->dissector, new,
+				   lockdep_is_held(&head->masks_lock));
+}
+
 static struct fl_flow_mask *fl_create_new_mask(struct cls_fl_head *head,
 					       struct fl_flow_mask *mask)
 {
+	struct fl_dissector *new, *old;
 	struct fl_flow_mask *newmask;
 	int err;
 
@@ -1836,6 +1884,12 @@ static struct fl_flow_mask *fl_create_new_mask(struct cls_fl_head *head,
 	if (!newmask)
 		return ERR_PTR(-ENOMEM);
 
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new) {
+		kfree(newmask);
+		return ERR_PTR(-ENOMEM);
+	}
+
 	fl_mask_copy(newmask, mask);
 
 	if ((newmask->key.tp_range.tp_min.dst &&
@@ -1860,13 +1914,17 @@ static struct fl_flow_mask *fl_create_new_mask(struct cls_fl_head *head,
 
 	spin_lock(&head->masks_lock);
 	list_add_tail_rcu(&newmask->list, &head->masks);
+	old = fl_update_dissector(head, new);
 	spin_unlock(&head->masks_lock);
+	if (old)
+		kfree_rcu(old, rcu);
 
 	return newmask;
 
 errout_destroy:
 	rhashtable_destroy(&newmask->ht);
 errout_free:
+	kfree(new);
 	kfree(newmask);
 
 	return ERR_PTR(err);
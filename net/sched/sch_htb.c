@@ -180,9 +180,34 @@ struct htb_sched {
 	struct Qdisc		**direct_qdiscs;
 	unsigned int            num_direct_qdiscs;
 
+	struct htb_shared	*shared;
+
 	bool			offload;
 };
 
+/*
+ * HTBs attached to the tx queues of a device under mq can share an aggregate
+ * rate, on top of their own class trees.  Each of them only runs under its
+ * own qdisc lock; what they share is a single EDT timestamp, as in sch_fq:
+ * the time the group may send next, which every packet pushes forward by
+ * its transmission time at the group rate.  Up to burst_ns of credit builds
+ * up while the group is idle.
+ */
+struct htb_shared {
+	struct list_head	list;
+	refcount_t		refcnt;
+	struct net_device	*dev;
+	u32			id;
+	u64			rate;		/* bytes per second */
+	u32			burst;		/* bytes */
+	s64			burst_ns;
+	atomic64_t		time_next;
+	struct rcu_head		rcu;
+};
+
+static LIST_HEAD(htb_shared_list);
+static DEFINE_MUTEX(htb_shared_mutex);
+
 /* find class in global hash table using given handle */
 static inline struct htb_class *htb_find(u32 handle, struct Qdisc *sch)
 {
@@ -928,6 +953,24 @@ static struct sk_buff *htb_dequeue_tree(struct htb_sched *q, const int prio,
 	return skb;
 }
 
+static s64 htb_shared_earliest(const struct htb_shared *shared)
+{
+	return atomic64_read(&shared->time_next) - shared->burst_ns;
+}
+
+static void htb_shared_charge(struct htb_shared *shared, s64 now,
+			      unsigned int len)
+{
+	s64 len_ns = div64_u64((u64)len * NSEC_PER_SEC, shared->rate);
+	s64 old = atomic64_read(&shared->time_next);
+	s64 next;
+
+	do {
+		/* Idle time only counts up to the burst */
+		next = max(old, now - shared->burst_ns) + len_ns;
+	} while (!atomic64_try_cmpxchg(&shared->time_next, &old, next));
+}
+
 static struct sk_buff *htb_dequeue(struct Qdisc *sch)
 {
 	struct sk_buff *skb;
@@ -951,6 +994,13 @@ static struct sk_buff *htb_dequeue(struct Qdisc *sch)
 	q->now = ktime_get_ns();
 	start_at = jiffies;
 
+	if (q->shared && htb_shared_earliest(q->shared) > q->now) {
+		q->overlimits++;
+		qdisc_watchdog_schedule_ns(&q->watchdog,
+					   htb_shared_earliest(q->shared));
+		goto fin;
+	}
+
 	next_event = q->now + 5LLU * NSEC_PER_SEC;
 
 	for (level = 0; level < TC_HTB_MAXDEPTH; level++) {
@@ -974,8 +1024,12 @@ static struct sk_buff *htb_dequeue(struct Qdisc *sch)
 
 			m |= 1 << prio;
 			skb = htb_dequeue_tree(q, prio, level);
-			if (likely(skb != NULL))
+			if (likely(skb != NULL)) {
+				if (q->shared)
+					htb_shared_charge(q->shared, q->now,
+							  qdisc_pkt_len(skb));
 				goto ok;
+			}
 		}
 	}
 	if (likely(next_event > q->now))
@@ -1023,8 +1077,67 @@ static const struct nla_policy htb_policy[TCA_HTB_MAX + 1] = {
 	[TCA_HTB_RATE64] = { .type = NLA_U64 },
 	[TCA_HTB_CEIL64] = { .type = NLA_U64 },
 	[TCA_HTB_OFFLOAD] = { .type = NLA_FLAG },
+	[TCA_HTB_SHARED_GROUP] = { .type = NLA_U32 },
+	[TCA_HTB_SHARED_RATE64] = { .type = NLA_U64 },
+	[TCA_HTB_SHARED_BURST] = { .type = NLA_U32 },
 };
 
+/*
+ * Join shared rate group @id of @dev, creating it with @rate and @burst if
+ * it does not exist yet.  Its other members must agree on them.
+ */
+static struct htb_shared *htb_shared_get(struct net_device *dev, u32 id,
+					 u64 rate, u32 burst,
+					 struct netlink_ext_ack *extack)
+{
+	struct htb_shared *shared;
+
+	if (!rate) {
+		NL_SET_ERR_MSG(extack, "HTB shared group needs a rate");
+		return ERR_PTR(-EINVAL);
+	}
+
+	mutex_lock(&htb_shared_mutex);
+	list_for_each_entry(shared, &htb_shared_list, list) {
+		if (shared->dev != dev || shared->id != id)
+			continue;
+		if (shared->rate != rate || shared->burst != burst) {
+			NL_SET_ERR_MSG(extack, "HTB shared group exists with a different rate or burst");
+			shared = ERR_PTR(-EINVAL);
+		} else {
+			refcount_inc(&shared->refcnt);
+		}
+		goto unlock;
+	}
+
+	shared = kzalloc(sizeof(*shared), GFP_KERNEL);
+	if (!shared) {
+		shared = ERR_PTR(-ENOMEM);
+		goto unlock;
+	}
+	refcount_set(&shared->refcnt, 1);
+	shared->dev = dev;
+	shared->id = id;
+	shared->rate = rate;
+	shared->burst = burst;
+	shared->burst_ns = div64_u64((u64)burst * NSEC_PER_SEC, rate);
+	atomic64_set(&shared->time_next, ktime_get_ns());
+	list_add(&shared->list, &htb_shared_list);
+unlock:
+	mutex_unlock(&htb_shared_mutex);
+	return shared;
+}
+
+static void htb_shared_put(struct htb_shared *shared)
+{
+	mutex_lock(&htb_shared_mutex);
+	if (refcount_dec_and_test(&shared->refcnt)) {
+		list_del(&shared->list);
+		kfree_rcu(shared, rcu);
+	}
+	mutex_unlock(&htb_shared_mutex);
+}
+
 static void htb_work_func(struct work_struct *work)
 {
 	struct htb_sched *q = container_of(work, struct htb_sched, work);
@@ -1087,6 +1200,9 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		if (sch->parent != TC_H_ROOT)
 			return -EOPNOTSUPP;
 
+		if (tb[TCA_HTB_SHARED_GROUP])
+			return -EOPNOTSUPP;
+
 		if (!tc_can_offload(dev) || !dev->netdev_ops->ndo_setup_tc)
 			return -EOPNOTSUPP;
 
@@ -1113,6 +1229,22 @@ static int htb_init(struct Qdisc *sch, struct nlattr *opt,
 		q->rate2quantum = 1;
 	q->defcls = gopt->defcls;
 
+	if (tb[TCA_HTB_SHARED_GROUP]) {
+		struct htb_shared *shared;
+		u32 burst = 0;
+		u64 rate = 0;
+
+		if (tb[TCA_HTB_SHARED_RATE64])
+			rate = nla_get_u64(tb[TCA_HTB_SHARED_RATE64]);
+		if (tb[TCA_HTB_SHARED_BURST])
+			burst = nla_get_u32(tb[TCA_HTB_SHARED_BURST]);
+		shared = htb_shared_get(dev, nla_get_u32(tb[TCA_HTB_SHARED_GROUP]),
+					rate, burst, extack);
+		if (IS_ERR(shared))
+			return PTR_ERR(shared);
+		q->shared = shared;
+	}
+
 	if (!offload)
 		return 0;
 
@@ -1248,6 +1380,12 @@ static int htb_dump(struct Qdisc *sch, struct sk_buff *skb)
 		goto nla_put_failure;
 	if (q->offload && nla_put_flag(skb, TCA_HTB_OFFLOAD))
 		goto nla_put_failure;
+	if (q->shared &&
+	    (nla_put_u32(skb, TCA_HTB_SHARED_GROUP, q->shared->id) ||
+	     nla_put_u64_64bit(skb, TCA_HTB_SHARED_RATE64, q->shared->rate,
+			       TCA_HTB_PAD) ||
+	     nla_put_u32(skb, TCA_HTB_SHARED_BURST, q->shared->burst)))
+		goto nla_put_failure;
 
 	return nla_nest_end(skb, nest);
 
@@ -1685,6 +1823,9 @@ static void htb_destroy(struct Qdisc *sch)
 	qdisc_class_hash_destroy(&q->clhash);
 	__qdisc_reset_queue(&q->direct_queue);
 
+	if (q->shared)
+		htb_shared_put(q->shared);
+
 	if (!q->offload)
 		return;
 
@@ -44,6 +44,7 @@
 #include "smc_core.h"
 #include "smc_ib.h"
 #include "smc_ism.h"
+#include "smc_loopback.h"
 #include "smc_pnet.h"
 #include "smc_netlink.h"
 #include "smc_tx.h"
@@ -2810,9 +2811,17 @@ static int __init smc_init(void)
 		goto out_sock;
 	}
 
+	rc = smc_loopback_init();
+	if (rc) {
+		pr_err("%s: smc_loopback_init fails with %d\n", __func__, rc);
+		goto out_ib;
+	}
+
 	static_branch_enable(&tcp_have_smc);
 	return 0;
 
+out_ib:
+	smc_ib_unregister_client();
 out_sock:
 	sock_unregister(PF_SMC);
 out_proto6:
@@ -2839,6 +2848,7 @@ static void __exit smc_exit(void)
 {
 	static_branch_disable(&tcp_have_smc);
 	sock_unregister(PF_SMC);
+	smc_loopback_exit();
 	smc_core_exit();
 	smc_ib_unregister_client();
 	destroy_workqueue(smc_close_wq);
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0
+/* Shared Memory Communications Direct over loopback (SMC-D loopback)
+ *
+ * Virtual SMC-D device for connections within the same host. Both ends of
+ * a connection use the same device, moving data into the peer DMB is a
+ * plain memcpy() and the "interrupt" is the rx tasklet of the peer
+ * connection scheduled right away.
+ *
+ * The device has no PNETID, it is offered through SMC-D V2 with its own
+ * CHID and a GID that is random per host, so that peers on other hosts
+ * never match it.
+ */
+
+#include <linux/bitops.h>
+#include <linux/hashtable.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <net/smc.h>
+
+#include "smc_ism.h"
+#include "smc_loopback.h"
+
+#define SMC_LO_NAME		"smc-loopback"
+#define SMC_LO_MAX_DMBS		5000
+#define SMC_LO_DMBS_HASH_BITS	12
+#define SMC_LO_CHID		0xFFFF
+/* bytes 24 and 28 must not be '0' for the device to be V2 capable */
+#define SMC_LO_SYSTEM_EID	"SMC-SYSTEMEID-LOOPBACK-DEVICE-01"
+
+struct smc_lo_dmb_node {
+	struct hlist_node list;
+	u64 token;
+	u32 len;
+	u32 sba_idx;
+	void *cpu_addr;
+};
+
+struct smc_lo_dev {
+	struct smcd_dev *smcd;
+	DECLARE_BITMAP(sba_idx_mask, SMC_LO_MAX_DMBS);
+	rwlock_t dmb_ht_lock;		/* protects dmb_ht */
+	DECLARE_HASHTABLE(dmb_ht, SMC_LO_DMBS_HASH_BITS);
+};
+
+static struct smc_lo_dev *smc_lo;
+static u8 smc_lo_system_eid[SMC_MAX_EID_LEN + 1] = SMC_LO_SYSTEM_EID;
+
+static int smc_lo_query_rgid(struct smcd_dev *smcd, u64 rgid, u32 vid_valid,
+			     u32 vid)
+{
+	/* only talks to itself */
+	return rgid == smcd->local_gid ? 0 : -ENETUNREACH;
+}
+
+static struct smc_lo_dmb_node *smc_lo_find_dmb(struct smc_lo_dev *ldev,
+					       u64 token)
+{
+	struct smc_lo_dmb_node *node;
+
+	hash_for_each_possible(ldev->dmb_ht, node, list, token) {
+		if (node->token == token)
+			return node;
+	}
+
+	return NULL;
+}
+
+static int smc_lo_register_dmb(struct smcd_dev *smcd, struct smcd_dmb *dmb)
+{
+	struct smc_lo_dev *ldev = smcd->priv;
+	struct smc_lo_dmb_node *node;
+	int sba_idx, rc;
+
+	/* index 0 means "not assigned yet" to the SMC core */
+	sba_idx = dmb->sba_idx;
+	if (!sba_idx) {
+		sba_idx = find_next_zero_bit(ldev->sba_idx_mask,
+					     SMC_LO_MAX_DMBS, 1);
+		if (sba_idx >= SMC_LO_MAX_DMBS)
+			return -ENOSPC;
+	}
+	if (test_and_set_bit(sba_idx, ldev->sba_idx_mask))
+		return -EINVAL;
+
+	node = kzalloc(sizeof(*node), GFP_KERNEL);
+	if (!node) {
+		rc = -ENOMEM;
+		goto err_bit;
+	}
+
+	node->cpu_addr = kzalloc(dmb->dmb_len, GFP_KERNEL | __GFP_NOWARN |
+				 __GFP_NORETRY | __GFP_NOMEMALLOC);
+	if (!node->cpu_addr) {
+		rc = -ENOMEM;
+		goto err_node;
+	}
+	node->len = dmb->dmb_len;
+	node->sba_idx = sba_idx;
+
+	write_lock_bh(&ldev->dmb_ht_lock);
+	do {
+		get_random_bytes(&node->token, sizeof(node->token));
+	} while (!node->token || smc_lo_find_dmb(ldev, node->token));
+	hash_add(ldev->dmb_ht, &node->list, node->token);
+	write_unlock_bh(&ldev->dmb_ht_lock);
+
+	dmb->sba_idx = node->sba_idx;
+	dmb->dmb_tok = node->token;
+	dmb->cpu_addr = node->cpu_addr;
+	/* never used for DMA, but the SMC core tests it for registration */
+	dmb->dma_addr = (dma_addr_t)(uintptr_t)node->cpu_addr;
+
+	return 0;
+
+err_node:
+	kfree(node);
+err_bit:
+	clear_bit(sba_idx, ldev->sba_idx_mask);
+	return rc;
+}
+
+static int smc_lo_unregister_dmb(struct smcd_dev *smcd, struct smcd_dmb *dmb)
+{
+	struct smc_lo_dev *ldev = smcd->priv;
+	struct smc_lo_dmb_node *node;
+
+	write_lock_bh(&ldev->dmb_ht_lock);
+	node = smc_lo_find_dmb(ldev, dmb->dmb_tok);
+	if (!node) {
+		write_unlock_bh(&ldev->dmb_ht_lock);
+		return -EINVAL;
+	}
+	hash_del(&node->list);
+	write_unlock_bh(&ldev->dmb_ht_lock);
+
+	clear_bit(node->sba_idx, ldev->sba_idx_mask);
+	kfree(node->cpu_addr);
+	kfree(node);
+
+	return 0;
+}
+
+static int smc_lo_add_vlan_id(struct smcd_dev *smcd, u64 vlan_id)
+{
+	return 0;
+}
+
+static int smc_lo_del_vlan_id(struct smcd_dev *smcd, u64 vlan_id)
+{
+	return 0;
+}
+
+static int smc_lo_set_vlan_required(struct smcd_dev *smcd)
+{
+	return 0;
+}
+
+static int smc_lo_reset_vlan_required(struct smcd_dev *smcd)
+{
+	return 0;
+}
+
+static int smc_lo_signal_event(struct smcd_dev *smcd, u64 rgid,
+			       u32 trigger_irq, u32 event_code, u64 info)
+{
+	return 0;
+}
+
+static int smc_lo_move_data(struct smcd_dev *smcd, u64 dmb_tok,
+			    unsigned int idx, bool sf, unsigned int offset,
+			    void *data, unsigned int size)
+{
+	struct smc_lo_dev *ldev = smcd->priv;
+	struct smc_lo_dmb_node *node;
+	u32 sba_idx;
+
+	read_lock_bh(&ldev->dmb_ht_lock);
+	node = smc_lo_find_dmb(ldev, dmb_tok);
+	if (!node || offset > node->len || size > node->len - offset) {
+		read_unlock_bh(&ldev->dmb_ht_lock);
+		return -EINVAL;
+	}
+	memcpy(node->cpu_addr + offset, data, size);
+	sba_idx = node->sba_idx;
+	read_unlock_bh(&ldev->dmb_ht_lock);
+
+	if (sf)
+		smcd_handle_irq(smcd, sba_idx);
+
+	return 0;
+}
+
+static void smc_lo_get_system_eid(struct smcd_dev *smcd, u8 **eid)
+{
+	*eid = smc_lo_system_eid;
+}
+
+static u16 smc_lo_get_chid(struct smcd_dev *smcd)
+{
+	return SMC_LO_CHID;
+}
+
+static const struct smcd_ops smc_lo_ops = {
+	.query_remote_gid	= smc_lo_query_rgid,
+	.register_dmb		= smc_lo_register_dmb,
+	.unregister_dmb		= smc_lo_unregister_dmb,
+	.add_vlan_id		= smc_lo_add_vlan_id,
+	.del_vlan_id		= smc_lo_del_vlan_id,
+	.set_vlan_required	= smc_lo_set_vlan_required,
+	.reset_vlan_required	= smc_lo_reset_vlan_required,
+	.signal_event		= smc_lo_signal_event,
+	.move_data		= smc_lo_move_data,
+	.get_system_eid		= smc_lo_get_system_eid,
+	.get_chid		= smc_lo_get_chid,
+};
+
+int smc_loopback_init(void)
+{
+	struct smc_lo_dev *ldev;
+	struct smcd_dev *smcd;
+	int rc;
+
+	ldev = kzalloc(sizeof(*ldev), GFP_KERNEL);
+	if (!ldev)
+		return -ENOMEM;
+
+	rwlock_init(&ldev->dmb_ht_lock);
+	hash_init(ldev->dmb_ht);
+
+	smcd = smcd_alloc_dev(NULL, SMC_LO_NAME, &smc_lo_ops, SMC_LO_MAX_DMBS);
+	if (!smcd) {
+		rc = -ENOMEM;
+		goto err_ldev;
+	}
+	smcd->priv = ldev;
+	get_random_bytes(&smcd->local_gid, sizeof(smcd->local_gid));
+	ldev->smcd = smcd;
+
+	rc = smcd_register_dev(smcd);
+	if (rc)
+		goto err_smcd;
+
+	smc_lo = ldev;
+	return 0;
+
+err_smcd:
+	smcd_free_dev(smcd);
+err_ldev:
+	kfree(ldev);
+	return rc;
+}
+
+void smc_loopback_exit(void)
+{
+	struct smc_lo_dev *ldev = smc_lo;
+
+	if (!ldev)
+		return;
+
+	smc_lo = NULL;
+	smcd_unregister_dev(ldev->smcd);
+	smcd_free_dev(ldev->smcd);
+	kfree(ldev);
+}
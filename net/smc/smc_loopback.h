@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* Shared Memory Communications Direct over loopback (SMC-D loopback)
+ *
+ * Virtual SMC-D device for connections within the same host.
+ */
+
+#ifndef SMC_LOOPBACK_H
+#define SMC_LOOPBACK_H
+
+#include <linux/types.h>
+
+#if IS_ENABLED(CONFIG_SMC_LO)
+int smc_loopback_init(void);
+void smc_loopback_exit(void);
+#else
+static inline int smc_loopback_init(void)
+{
+	return 0;
+}
+
+static inline void smc_loopback_exit(void)
+{
+}
+#endif
+
+#endif /* SMC_LOOPBACK_H */
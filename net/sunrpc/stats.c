@@ -244,6 +244,10 @@ static int do_print_stats(struct rpc_clnt *clnt, struct rpc_xprt *xprt, void *se
 	struct seq_file *seq = seqv;
 
 	xprt->ops->print_stats(xprt, seq);
+	/* Inputs of the transport selection in xprtmultipath.c */
+	seq_printf(seq, "\txprt_load:\t%ld %lu\n",
+		   atomic_long_read(&xprt->queuelen),
+		   READ_ONCE(xprt->srtt) >> 3);
 	return 0;
 }
 
@@ -1210,9 +1210,20 @@ void xprt_complete_rqst(struct rpc_task *task, int copied)
 {
 	struct rpc_rqst *req = task->tk_rqstp;
 	struct rpc_xprt *xprt = req->rq_xprt;
+	long m = ktime_to_us(req->rq_rtt);
+	unsigned long srtt = xprt->srtt;
 
 	xprt->stat.recvs++;
 
+	/* Same smoothing as the TCP srtt, sampled on every reply */
+	if (m < 0)
+		m = 0;
+	if (srtt)
+		srtt += m - (srtt >> 3);
+	else
+		srtt = m << 3;
+	WRITE_ONCE(xprt->srtt, srtt);
+
 	req->rq_private_buf.len = copied;
 	/* Ensure all writes are done before we update */
 	/* req->rq_reply_bytes_recvd */
@@ -361,29 +361,64 @@ struct rpc_xprt *__xprt_switch_find_next_entry_roundrobin(struct list_head *head
 	return xprt_switch_find_first_entry(head);
 }
 
+/*
+ * Outstanding requests weighted by the smoothed reply time, so that a
+ * slow or stalled connection is only given its fair share of the load.
+ * Weights are only comparable once every transport has a reply time
+ * sample, until then the queue lengths alone are compared.
+ */
+static u64 xprt_switch_xprt_load(struct rpc_xprt *xprt, bool weighted)
+{
+	u64 load = atomic_long_read(&xprt->queuelen) + 1;
+
+	if (weighted)
+		load *= max(READ_ONCE(xprt->srtt) >> 3, 1UL);
+	return load;
+}
+
 static
 struct rpc_xprt *xprt_switch_find_next_entry_roundrobin(struct rpc_xprt_switch *xps,
 		const struct rpc_xprt *cur)
 {
 	struct list_head *head = &xps->xps_xprt_list;
-	struct rpc_xprt *xprt;
-	unsigned int nactive;
-
-	for (;;) {
-		unsigned long xprt_queuelen, xps_queuelen;
+	struct rpc_xprt *start, *xprt, *best;
+	unsigned int i, n = READ_ONCE(xps->xps_nxprts);
+	bool weighted = true;
+	u64 load, best_load;
+
+	/*
+	 * Pick the least loaded transport, starting the scan after the
+	 * current one so that equally loaded transports take turns.
+	 */
+	start = best = __xprt_switch_find_next_entry_roundrobin(head, cur);
+	if (!best)
+		return NULL;
 
-		xprt = __xprt_switch_find_next_entry_roundrobin(head, cur);
-		if (!xprt)
+	/* A transport that has not seen a reply yet would look the fastest */
+	xprt = start;
+	for (i = 0; i < n && xprt; i++) {
+		if (!READ_ONCE(xprt->srtt)) {
+			weighted = false;
 			break;
-		xprt_queuelen = atomic_long_read(&xprt->queuelen);
-		xps_queuelen = atomic_long_read(&xps->xps_queuelen);
-		nactive = READ_ONCE(xps->xps_nactive);
-		/* Exit loop if xprt_queuelen <= average queue length */
-		if (xprt_queuelen * nactive <= xps_queuelen)
+		}
+		xprt = __xprt_switch_find_next_entry_roundrobin(head, xprt);
+		if (xprt == start)
 			break;
-		cur = xprt;
 	}
-	return xprt;
+
+	best_load = xprt_switch_xprt_load(best, weighted);
+	xprt = start;
+	while (n-- > 1) {
+		xprt = __xprt_switch_find_next_entry_roundrobin(head, xprt);
+		if (!xprt || xprt == start)
+			break;
+		load = xprt_switch_xprt_load(xprt, weighted);
+		if (load < best_load) {
+			best = xprt;
+			best_load = load;
+		}
+	}
+	return best;
 }
 
 static
@@ -559,7 +594,10 @@ const struct rpc_xprt_iter_ops rpc_xprt_iter_singular = {
 	.xpi_next = xprt_iter_first_entry,
 };
 
-/* Policy for round-robin iteration of entries in the rpc_xprt_switch */
+/*
+ * Policy for round-robin iteration of entries in the rpc_xprt_switch,
+ * skipping ahead to the least loaded entry
+ */
 static
 const struct rpc_xprt_iter_ops rpc_xprt_iter_roundrobin = {
 	.xpi_rewind = xprt_iter_default_rewind,
@@ -1418,7 +1418,7 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	int n_sgin, n_sgout, nsg, mem_size, aead_size, err, pages = 0;
 	struct aead_request *aead_req;
 	struct sk_buff *unused;
-	u8 *aad, *iv, *mem = NULL;
+	u8 *aad, *iv, *tail, *mem = NULL;
 	struct scatterlist *sgin = NULL;
 	struct scatterlist *sgout = NULL;
 	const int data_len = rxm->full_len - prot->overhead_size +
@@ -1427,7 +1427,8 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 
 	if (*zc && (out_iov || out_sg)) {
 		if (out_iov)
-			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1;
+			n_sgout = iov_iter_npages(out_iov, INT_MAX) + 1 +
+				  prot->tail_size;
 		else
 			n_sgout = sg_nents(out_sg);
 		n_sgin = skb_nsg(skb, rxm->offset + prot->prepend_size,
@@ -1450,9 +1451,10 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	mem_size = aead_size + (nsg * sizeof(struct scatterlist));
 	mem_size = mem_size + prot->aad_size;
 	mem_size = mem_size + crypto_aead_ivsize(ctx->aead_recv);
+	mem_size = mem_size + prot->tail_size;
 
 	/* Allocate a single block of memory which contains
-	 * aead_req || sgin[] || sgout[] || aad || iv.
+	 * aead_req || sgin[] || sgout[] || aad || iv || tail.
 	 * This order achieves correct alignment for aead_req, sgin, sgout.
 	 */
 	mem = kmalloc(mem_size, sk->sk_allocation);
@@ -1465,6 +1467,7 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	sgout = sgin + n_sgin;
 	aad = (u8 *)(sgout + n_sgout);
 	iv = aad + prot->aad_size;
+	tail = iv + crypto_aead_ivsize(ctx->aead_recv);
 
 	/* For CCM based ciphers, first byte of nonce+iv is always '2' */
 	if (prot->cipher_type == TLS_CIPHER_AES_CCM_128) {
@@ -1510,12 +1513,23 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 			sg_init_table(sgout, n_sgout);
 			sg_set_buf(&sgout[0], aad, prot->aad_size);
 
+			/* With TLS 1.3 the content type is decrypted into
+			 * tail, the caller checks it before trusting the data.
+			 */
 			*chunk = 0;
-			err = tls_setup_from_iter(sk, out_iov, data_len,
+			err = tls_setup_from_iter(sk, out_iov,
+						  data_len - prot->tail_size,
 						  &pages, chunk, &sgout[1],
-						  (n_sgout - 1));
+						  (n_sgout - 1 - prot->tail_size));
 			if (err < 0)
 				goto fallback_to_reg_recv;
+
+			if (prot->tail_size) {
+				sg_unmark_end(&sgout[pages]);
+				sg_set_buf(&sgout[pages + 1], tail,
+					   prot->tail_size);
+				sg_mark_end(&sgout[pages + 1]);
+			}
 		} else if (out_sg) {
 			memcpy(sgout, out_sg, n_sgout * sizeof(*sgout));
 		} else {
@@ -1535,6 +1549,9 @@ static int decrypt_internal(struct sock *sk, struct sk_buff *skb,
 	if (err == -EINPROGRESS)
 		return err;
 
+	if (!err && *zc && out_iov && prot->tail_size)
+		ctx->control = *tail;
+
 	/* Release the pages in case iov was mapped to pages */
 	for (; pages > 0; pages--)
 		put_page(sg_page(&sgout[pages]));
@@ -1577,9 +1594,32 @@ static int decrypt_skb_update(struct sock *sk, struct sk_buff *skb,
 			*zc = false;
 		}
 
-		pad = padding_length(ctx, prot, skb);
-		if (pad < 0)
-			return pad;
+		/* A TLS 1.3 record decrypted into the user buffer is only
+		 * usable if it was a data record without padding, otherwise
+		 * decrypt it again in place and let the caller copy it.
+		 */
+		if (*zc && prot->version == TLS_1_3_VERSION &&
+		    ctx->control != TLS_RECORD_TYPE_DATA) {
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXNOPADVIOL);
+			iov_iter_revert(dest, *chunk);
+			err = decrypt_internal(sk, skb, NULL, NULL, chunk, zc,
+					       false);
+			if (err < 0) {
+				if (err == -EBADMSG)
+					TLS_INC_STATS(sock_net(sk),
+						      LINUX_MIB_TLSDECRYPTERROR);
+				return err;
+			}
+		}
+
+		if (*zc) {
+			TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXZEROCOPY);
+			pad = 0;
+		} else {
+			pad = padding_length(ctx, prot, skb);
+			if (pad < 0)
+				return pad;
+		}
 
 		rxm->full_len -= pad;
 		rxm->offset += prot->prepend_size;
@@ -1823,7 +1863,8 @@ int tls_sw_recvmsg(struct sock *sk,
 
 		if (to_decrypt <= len && !is_kvec && !is_peek &&
 		    ctx->control == TLS_RECORD_TYPE_DATA &&
-		    prot->version != TLS_1_3_VERSION &&
+		    (prot->version != TLS_1_3_VERSION ||
+		     tls_ctx->rx_no_pad) &&
 		    !bpf_strp_enabled)
 			zc = true;
 
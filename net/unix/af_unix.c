@@ -2008,14 +2008,48 @@ static int queue_oob(struct socket *sock, struct msghdr *msg, struct sock *other
 }
 #endif
 
+/* Move the skbs built by unix_stream_sendmsg() to the peer in one go, so that
+ * the receive queue lock is taken and the reader is woken up once per batch
+ * rather than once per skb.
+ */
+static int unix_stream_queue_batch(struct socket *sock, struct sock *other,
+				   struct sk_buff_head *batch)
+{
+	struct sk_buff *skb;
+
+	unix_state_lock(other);
+
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		__skb_queue_purge(batch);
+		return -EPIPE;
+	}
+
+	skb_queue_walk(batch, skb) {
+		maybe_add_creds(skb, sock, other);
+		scm_stat_add(other, skb);
+	}
+
+	spin_lock(&other->sk_receive_queue.lock);
+	skb_queue_splice_tail_init(batch, &other->sk_receive_queue);
+	spin_unlock(&other->sk_receive_queue.lock);
+	unix_state_unlock(other);
+	other->sk_data_ready(other);
+
+	return 0;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
 	struct sock *sk = sock->sk;
 	struct sock *other = NULL;
+	struct sk_buff_head batch;
 	int err, size;
 	struct sk_buff *skb;
 	int sent = 0;
+	int batched = 0;
 	struct scm_cookie scm;
 	bool fds_sent = false;
 	int data_len;
@@ -2048,8 +2082,10 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
-	while (sent < len) {
-		size = len - sent;
+	__skb_queue_head_init(&batch);
+
+	while (sent + batched < len) {
+		size = len - sent - batched;
 
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
@@ -2061,17 +2097,29 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 
 		data_len = min_t(size_t, size, PAGE_ALIGN(data_len));
 
+		/* Never sleep for send buffer space with skbs the reader has
+		 * not been told about yet.
+		 */
 		skb = sock_alloc_send_pskb(sk, size - data_len, data_len,
-					   msg->msg_flags & MSG_DONTWAIT, &err,
+					   (msg->msg_flags & MSG_DONTWAIT) ||
+					   batched, &err,
 					   get_order(UNIX_SKB_FRAGS_SZ));
+		if (!skb && batched && err == -EAGAIN) {
+			err = unix_stream_queue_batch(sock, other, &batch);
+			if (err)
+				goto pipe_err;
+			sent += batched;
+			batched = 0;
+			continue;
+		}
 		if (!skb)
-			goto out_err;
+			goto out_batch;
 
 		/* Only send the fds in the first buffer */
 		err = unix_scm_to_skb(&scm, skb, !fds_sent);
 		if (err < 0) {
 			kfree_skb(skb);
-			goto out_err;
+			goto out_batch;
 		}
 		fds_sent = true;
 
@@ -2081,21 +2129,20 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		err = skb_copy_datagram_from_iter(skb, 0, &msg->msg_iter, size);
 		if (err) {
 			kfree_skb(skb);
-			goto out_err;
+			goto out_batch;
 		}
 
-		unix_state_lock(other);
-
-		if (sock_flag(other, SOCK_DEAD) ||
-		    (other->sk_shutdown & RCV_SHUTDOWN))
-			goto pipe_err_free;
+		__skb_queue_tail(&batch, skb);
+		batched += size;
 
-		maybe_add_creds(skb, sock, other);
-		scm_stat_add(other, skb);
-		skb_queue_tail(&other->sk_receive_queue, skb);
-		unix_state_unlock(other);
-		other->sk_data_ready(other);
-		sent += size;
+		/* Keep the reader busy while the rest is being copied */
+		if (batched >= (sk->sk_sndbuf >> 1) || sent + batched >= len) {
+			err = unix_stream_queue_batch(sock, other, &batch);
+			if (err)
+				goto pipe_err;
+			sent += batched;
+			batched = 0;
+		}
 	}
 
 #if (IS_ENABLED(CONFIG_AF_UNIX_OOB))
@@ -2111,9 +2158,14 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 
 	return sent;
 
-pipe_err_free:
-	unix_state_unlock(other);
-	kfree_skb(skb);
+out_batch:
+	/* Hand over what has been copied so far, as before batching */
+	if (batched) {
+		if (unix_stream_queue_batch(sock, other, &batch))
+			goto pipe_err;
+		sent += batched;
+	}
+	goto out_err;
 pipe_err:
 	if (sent == 0 && !(msg->msg_flags&MSG_NOSIGNAL))
 		send_sig(SIGPIPE, current, 0);
@@ -15,11 +15,13 @@
 #include <linux/rtnetlink.h>
 #include <linux/idr.h>
 #include <linux/vmalloc.h>
+#include <linux/sizes.h>
 
 #include "xdp_umem.h"
 #include "xsk_queue.h"
 
 #define XDP_UMEM_MIN_CHUNK_SIZE 2048
+#define XDP_UMEM_MAX_CHUNK_SIZE SZ_64K
 
 static DEFINE_IDA(umem_ida);
 
@@ -159,12 +161,13 @@ static int xdp_umem_reg(struct xdp_umem *umem, struct xdp_umem_reg *mr)
 	unsigned int chunks, chunks_rem;
 	int err;
 
-	if (chunk_size < XDP_UMEM_MIN_CHUNK_SIZE || chunk_size > PAGE_SIZE) {
-		/* Strictly speaking we could support this, if:
-		 * - huge pages, or*
-		 * - using an IOMMU, or
-		 * - making sure the memory area is consecutive
-		 * but for now, we simply say "computer says no".
+	if (chunk_size < XDP_UMEM_MIN_CHUNK_SIZE ||
+	    chunk_size > XDP_UMEM_MAX_CHUNK_SIZE) {
+		/* Chunks larger than a page, e.g. for jumbo frames, are
+		 * only usable in zero-copy mode if the driver opts in with
+		 * xdp_zc_max_chunk_size and every chunk ends up DMA
+		 * contiguous (huge pages or an IOMMU), which is checked
+		 * when the umem is mapped for a device.
 		 */
 		return -EINVAL;
 	}
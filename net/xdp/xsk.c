@@ -529,8 +529,9 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 static int xsk_generic_xmit(struct sock *sk)
 {
 	struct xdp_sock *xs = xdp_sk(sk);
-	u32 max_batch = TX_BATCH_SIZE;
+	u32 max_batch = READ_ONCE(xs->max_tx_budget);
 	bool sent_frame = false;
+	u32 nb_reserved = 0;
 	struct xdp_desc desc;
 	struct sk_buff *skb;
 	unsigned long flags;
@@ -556,21 +557,22 @@ static int xsk_generic_xmit(struct sock *sk)
 		/* This is the backpressure mechanism for the Tx path.
 		 * Reserve space in the completion queue and only proceed
 		 * if there is space in it. This avoids having to implement
-		 * any buffering in the Tx path.
+		 * any buffering in the Tx path. Space is reserved for the
+		 * rest of the batch at once, what is left unused is given
+		 * back before returning.
 		 */
-		spin_lock_irqsave(&xs->pool->cq_lock, flags);
-		if (xskq_prod_reserve(xs->pool->cq)) {
+		if (!nb_reserved) {
+			spin_lock_irqsave(&xs->pool->cq_lock, flags);
+			nb_reserved = xskq_prod_reserve_n(xs->pool->cq,
+							  max_batch + 1);
 			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
-			goto out;
+			if (!nb_reserved)
+				goto out;
 		}
-		spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 
 		skb = xsk_build_skb(xs, &desc);
 		if (IS_ERR(skb)) {
 			err = PTR_ERR(skb);
-			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
-			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 			goto out;
 		}
 
@@ -578,15 +580,14 @@ static int xsk_generic_xmit(struct sock *sk)
 		if  (err == NETDEV_TX_BUSY) {
 			/* Tell user-space to retry the send */
 			skb->destructor = sock_wfree;
-			spin_lock_irqsave(&xs->pool->cq_lock, flags);
-			xskq_prod_cancel(xs->pool->cq);
-			spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
 			/* Free skb without triggering the perf drop trace */
 			consume_skb(skb);
 			err = -EAGAIN;
 			goto out;
 		}
 
+		/* The completion queue entry now belongs to the skb */
+		nb_reserved--;
 		xskq_cons_release(xs->tx);
 		/* Ignore NET_XMIT_CN as packet might have been sent */
 		if (err == NET_XMIT_DROP) {
@@ -601,6 +602,12 @@ static int xsk_generic_xmit(struct sock *sk)
 	xs->tx->queue_empty_descs++;
 
 out:
+	if (nb_reserved) {
+		spin_lock_irqsave(&xs->pool->cq_lock, flags);
+		xskq_prod_cancel_n(xs->pool->cq, nb_reserved);
+		spin_unlock_irqrestore(&xs->pool->cq_lock, flags);
+	}
+
 	if (sent_frame)
 		if (xsk_tx_writeable(xs))
 			sk->sk_write_space(sk);
@@ -657,6 +664,11 @@ static int __xsk_sendmsg(struct socket *sock, struct msghdr *m, size_t total_len
 	if (sk_can_busy_loop(sk))
 		sk_busy_loop(sk, 1); /* only support non-blocking sockets */
 
+	/*
+	 * Only a zero-copy driver drains the Tx ring from its NAPI poll,
+	 * which the busy loop above just ran. In copy mode nothing but this
+	 * call sends the frames, so the wakeup cannot be skipped.
+	 */
 	if (xs->zc && xsk_no_wakeup(sk))
 		return 0;
 
@@ -1124,6 +1136,25 @@ static int xsk_setsockopt(struct socket *sock, int level, int optname,
 		mutex_unlock(&xs->mutex);
 		return 0;
 	}
+	case XDP_MAX_TX_SKB_BUDGET:
+	{
+		unsigned int budget;
+
+		if (optlen < sizeof(budget))
+			return -EINVAL;
+		if (copy_from_sockptr(&budget, optval, sizeof(budget)))
+			return -EFAULT;
+
+		mutex_lock(&xs->mutex);
+		if (!xs->tx || budget < TX_BATCH_SIZE ||
+		    budget > xs->tx->nentries) {
+			mutex_unlock(&xs->mutex);
+			return -EINVAL;
+		}
+		WRITE_ONCE(xs->max_tx_budget, budget);
+		mutex_unlock(&xs->mutex);
+		return 0;
+	}
 	case XDP_UMEM_FILL_RING:
 	case XDP_UMEM_COMPLETION_RING:
 	{
@@ -1448,6 +1479,7 @@ static int xsk_create(struct net *net, struct socket *sock, int protocol,
 
 	xs = xdp_sk(sk);
 	xs->state = XSK_READY;
+	xs->max_tx_budget = TX_BATCH_SIZE;
 	mutex_init(&xs->mutex);
 	spin_lock_init(&xs->rx_lock);
 
@@ -179,6 +179,13 @@ int xp_assign_dev(struct xsk_buff_pool *pool,
 		goto err_unreg_pool;
 	}
 
+	/* Drivers size their Rx buffers for a page unless they opt in */
+	if (pool->chunk_size > PAGE_SIZE &&
+	    pool->chunk_size > netdev->xdp_zc_max_chunk_size) {
+		err = -EOPNOTSUPP;
+		goto err_unreg_pool;
+	}
+
 	bpf.command = XDP_SETUP_XSK_POOL;
 	bpf.xsk.pool = pool;
 	bpf.xsk.queue_id = queue_id;
@@ -372,6 +379,21 @@ static void xp_check_dma_contiguity(struct xsk_dma_map *dma_map)
 	}
 }
 
+/* In aligned mode the chunks are not checked one by one on the fast path */
+static bool xp_check_dma_chunks(struct xsk_dma_map *dma_map, u32 chunk_size)
+{
+	u32 i, pgs_per_chunk = chunk_size >> PAGE_SHIFT;
+
+	for (i = 0; i < dma_map->dma_pages_cnt; i++) {
+		if ((i + 1) % pgs_per_chunk == 0)
+			continue;
+		if (!(dma_map->dma_pages[i] & XSK_NEXT_PG_CONTIG_MASK))
+			return false;
+	}
+
+	return true;
+}
+
 static int xp_init_dma_info(struct xsk_buff_pool *pool, struct xsk_dma_map *dma_map)
 {
 	pool->dma_pages = kvcalloc(dma_map->dma_pages_cnt, sizeof(*pool->dma_pages), GFP_KERNEL);
@@ -421,9 +443,15 @@ int xp_dma_map(struct xsk_buff_pool *pool, struct device *dev,
 		dma_map->dma_pages[i] = dma;
 	}
 
-	if (pool->unaligned)
+	if (pool->unaligned || pool->chunk_size > PAGE_SIZE)
 		xp_check_dma_contiguity(dma_map);
 
+	if (!pool->unaligned && pool->chunk_size > PAGE_SIZE &&
+	    !xp_check_dma_chunks(dma_map, pool->chunk_size)) {
+		__xp_dma_unmap(dma_map, attrs);
+		return -EINVAL;
+	}
+
 	err = xp_init_dma_info(pool, dma_map);
 	if (err) {
 		__xp_dma_unmap(dma_map, attrs);
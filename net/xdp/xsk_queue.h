@@ -335,6 +335,20 @@ static inline void xskq_prod_cancel(struct xsk_queue *q)
 	q->cached_prod--;
 }
 
+static inline void xskq_prod_cancel_n(struct xsk_queue *q, u32 cnt)
+{
+	q->cached_prod -= cnt;
+}
+
+static inline u32 xskq_prod_reserve_n(struct xsk_queue *q, u32 max)
+{
+	u32 nb_entries = xskq_prod_nb_free(q, max);
+
+	/* A, matches D */
+	q->cached_prod += nb_entries;
+	return nb_entries;
+}
+
 static inline int xskq_prod_reserve(struct xsk_queue *q)
 {
 	if (xskq_prod_is_full(q))
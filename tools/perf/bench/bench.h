@@ -2,7 +2,10 @@
 #ifndef BENCH_H
 #define BENCH_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <sys/time.h>
+#include <linux/compiler.h>
 
 extern struct timeval bench__start, bench__end, bench__runtime;
 
@@ -37,6 +40,8 @@ int bench_syscall_basic(int argc, const char **argv);
 int bench_mem_memcpy(int argc, const char **argv);
 int bench_mem_memset(int argc, const char **argv);
 int bench_mem_find_bit(int argc, const char **argv);
+int bench_mem_mmap(int argc, const char **argv);
+int bench_mem_page_alloc(int argc, const char **argv);
 int bench_futex_hash(int argc, const char **argv);
 int bench_futex_wake(int argc, const char **argv);
 int bench_futex_wake_parallel(int argc, const char **argv);
@@ -49,17 +54,48 @@ int bench_synthesize(int argc, const char **argv);
 int bench_kallsyms_parse(int argc, const char **argv);
 int bench_inject_build_id(int argc, const char **argv);
 int bench_evlist_open_close(int argc, const char **argv);
+int bench_uring_nop(int argc, const char **argv);
+int bench_net_rpc(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
 #define BENCH_FORMAT_SIMPLE_STR		"simple"
 #define BENCH_FORMAT_SIMPLE		1
+#define BENCH_FORMAT_JSON_STR		"json"
+#define BENCH_FORMAT_JSON		2
 
 #define BENCH_FORMAT_UNKNOWN		-1
 
 extern int bench_format;
 extern unsigned int bench_repeat;
 
+/*
+ * Thread-count sweeps, see sweep.c. Workers call bench_sweep__worker_start()
+ * once, then loop until bench_sweep__stopped().
+ */
+#define BENCH_SWEEP_MAX			64
+
+struct bench_sweep {
+	unsigned int	nr;
+	unsigned int	threads[BENCH_SWEEP_MAX];
+};
+
+struct perf_cpu_map;
+
+extern bool bench_sweep__done;
+
+int bench_sweep__parse(struct bench_sweep *sweep, const char *str,
+		       unsigned int max);
+void bench_sweep__worker_start(void);
+double bench_sweep__run(unsigned int nr, struct perf_cpu_map *cpu,
+			bool noaffinity, unsigned int runtime,
+			void *(*fn)(void *), void *args, size_t argsize);
+
+static inline bool bench_sweep__stopped(void)
+{
+	return READ_ONCE(bench_sweep__done);
+}
+
 #ifndef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
 #include <pthread.h>
 #include <linux/compiler.h>
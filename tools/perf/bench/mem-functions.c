@@ -122,7 +122,8 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 	u64 result_cycles = 0;
 	void *src = NULL, *dst = zalloc(size);
 
-	printf("# function '%s' (%s)\n", r->name, r->desc);
+	if (bench_format != BENCH_FORMAT_JSON)
+		printf("# function '%s' (%s)\n", r->name, r->desc);
 
 	if (dst == NULL)
 		goto out_alloc_failed;
@@ -159,6 +160,16 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 		}
 		break;
 
+	case BENCH_FORMAT_JSON:
+		if (use_cycles) {
+			printf("{\"function\": \"%s\", \"size\": %zu, \"cycles_per_byte\": %lf}\n",
+			       r->name, size, (double)result_cycles/size_total);
+		} else {
+			printf("{\"function\": \"%s\", \"size\": %zu, \"bytes_per_sec\": %lf}\n",
+			       r->name, size, result_bps);
+		}
+		break;
+
 	default:
 		BUG_ON(1);
 		break;
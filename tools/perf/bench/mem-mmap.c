@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mem-mmap.c
+ *
+ * mem mmap: mmap()/munmap() and page fault scaling. All threads share one
+ * mm, so this measures how well the address space locking scales:
+ *
+ *   map   - each iteration maps a private anonymous area, writes to every
+ *           page of it and unmaps it again (mmap_lock writers + faults)
+ *   fault - each thread maps its area once; each iteration faults every
+ *           page in and drops them with MADV_DONTNEED (faults only)
+ *
+ * mem page-alloc: page allocator throughput. Each iteration maps an area
+ * with MAP_POPULATE and unmaps it, so pages are allocated and freed in
+ * bulk with little fault handling overhead.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <linux/compiler.h>
+#include <perf/cpumap.h>
+
+#include <subcmd/parse-options.h>
+#include "../util/string2.h"
+#include "bench.h"
+
+#include <err.h>
+
+enum mmap_mode {
+	MODE_MAP,
+	MODE_FAULT,
+	MODE_POPULATE,
+};
+
+static const char	*threads_str;
+static const char	*size_str	= "1MB";
+static const char	*mode_str	= "map";
+static unsigned int	nsecs		= 5;
+static bool		noaffinity;
+static bool		hugepage;
+
+static enum mmap_mode	mode;
+static size_t		size;
+static size_t		page_size;
+
+static const struct option mmap_options[] = {
+	OPT_STRING('t', "threads", &threads_str, "1,2,4-16",
+		   "Thread counts to sweep (default: 1 to the number of CPUs, doubling)"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime per thread count (in seconds)"),
+	OPT_STRING('s', "size", &size_str, "1MB",
+		   "Specify the size of the area mapped by each thread. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_STRING('m', "mode", &mode_str, "map|fault",
+		   "map: mmap, touch and munmap each iteration; fault: fault in and MADV_DONTNEED"),
+	OPT_BOOLEAN('H', "hugepage", &hugepage, "Allow transparent huge pages (MADV_HUGEPAGE)"),
+	OPT_BOOLEAN('n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_END()
+};
+
+static const struct option page_alloc_options[] = {
+	OPT_STRING('t', "threads", &threads_str, "1,2,4-16",
+		   "Thread counts to sweep (default: 1 to the number of CPUs, doubling)"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime per thread count (in seconds)"),
+	OPT_STRING('s', "size", &size_str, "1MB",
+		   "Specify the size allocated and freed per iteration by each thread. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_BOOLEAN('n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_END()
+};
+
+static const char * const bench_mem_mmap_usage[] = {
+	"perf bench mem mmap <options>",
+	NULL
+};
+
+static const char * const bench_mem_page_alloc_usage[] = {
+	"perf bench mem page-alloc <options>",
+	NULL
+};
+
+struct worker {
+	char			*area;
+	unsigned long		iterations;
+} __attribute__((aligned(64)));
+
+static char *map_area(int flags)
+{
+	char *area;
+
+	area = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+	if (area == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+
+	if (hugepage && madvise(area, size, MADV_HUGEPAGE))
+		err(EXIT_FAILURE, "madvise");
+
+	return area;
+}
+
+static void touch_area(char *area)
+{
+	size_t off;
+
+	for (off = 0; off < size; off += page_size)
+		WRITE_ONCE(area[off], 1);
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = arg;
+
+	bench_sweep__worker_start();
+
+	while (!bench_sweep__stopped()) {
+		switch (mode) {
+		case MODE_MAP:
+			w->area = map_area(0);
+			touch_area(w->area);
+			munmap(w->area, size);
+			break;
+		case MODE_FAULT:
+			touch_area(w->area);
+			if (madvise(w->area, size, MADV_DONTNEED))
+				err(EXIT_FAILURE, "madvise");
+			break;
+		case MODE_POPULATE:
+			munmap(map_area(MAP_POPULATE), size);
+			break;
+		}
+		w->iterations++;
+	}
+
+	return NULL;
+}
+
+static void print_header(const char *name)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s: %s per thread per iteration, %u secs per run\n\n",
+		       name, size_str, nsecs);
+		printf(" %8s %14s %16s %14s\n",
+		       "threads", "iters/sec", "pages/sec", "nsecs/page");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("{\"benchmark\": \"mem/%s\", \"size\": %zu, \"runtime\": %u, "
+		       "\"results\": [", name, size, nsecs);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+static void print_result(unsigned int idx, unsigned int nr,
+			 struct worker *worker, double secs)
+{
+	unsigned long iterations = 0;
+	double pages, nsecs_page;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		iterations += worker[i].iterations;
+
+	pages = (double)iterations * (size / page_size);
+	/* CPU time spent per page, summed over all threads */
+	nsecs_page = pages ? secs * nr * 1e9 / pages : 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %8u %14.0f %16.0f %14.1f\n",
+		       nr, iterations / secs, pages / secs, nsecs_page);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%u %.0f\n", nr, pages / secs);
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("%s\n  {\"threads\": %u, \"iterations_per_sec\": %.0f, "
+		       "\"pages_per_sec\": %.0f, \"nsecs_per_page\": %.1f}",
+		       idx ? "," : "", nr, iterations / secs, pages / secs,
+		       nsecs_page);
+		break;
+	default:
+		break;
+	}
+}
+
+static int run_sweep(const char *name)
+{
+	struct bench_sweep sweep;
+	struct perf_cpu_map *cpu;
+	struct worker *worker;
+	unsigned int i, j;
+	double secs;
+	s64 val;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	val = perf_atoll((char *)size_str);
+	if (val <= 0 || (size_t)val < page_size) {
+		fprintf(stderr, "Invalid size: '%s'\n", size_str);
+		return 1;
+	}
+	size = val;
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		err(EXIT_FAILURE, "perf_cpu_map__new");
+
+	if (bench_sweep__parse(&sweep, threads_str, cpu->nr)) {
+		fprintf(stderr, "Invalid thread list: '%s'\n", threads_str ?: "");
+		perf_cpu_map__put(cpu);
+		return 1;
+	}
+
+	print_header(name);
+
+	for (i = 0; i < sweep.nr; i++) {
+		unsigned int nr = sweep.threads[i];
+
+		worker = calloc(nr, sizeof(*worker));
+		if (!worker)
+			err(EXIT_FAILURE, "calloc");
+
+		if (mode == MODE_FAULT) {
+			for (j = 0; j < nr; j++)
+				worker[j].area = map_area(0);
+		}
+
+		secs = bench_sweep__run(nr, cpu, noaffinity, nsecs, workerfn,
+					worker, sizeof(*worker));
+		print_result(i, nr, worker, secs);
+		fflush(stdout);
+
+		if (mode == MODE_FAULT) {
+			for (j = 0; j < nr; j++)
+				munmap(worker[j].area, size);
+		}
+		free(worker);
+	}
+
+	if (bench_format == BENCH_FORMAT_JSON)
+		printf("\n]}\n");
+
+	perf_cpu_map__put(cpu);
+	return 0;
+}
+
+int bench_mem_mmap(int argc, const char **argv)
+{
+	argc = parse_options(argc, argv, mmap_options, bench_mem_mmap_usage, 0);
+	if (argc) {
+		usage_with_options(bench_mem_mmap_usage, mmap_options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!strcmp(mode_str, "map")) {
+		mode = MODE_MAP;
+	} else if (!strcmp(mode_str, "fault")) {
+		mode = MODE_FAULT;
+	} else {
+		fprintf(stderr, "Unknown mode: '%s'\n", mode_str);
+		return 1;
+	}
+
+	return run_sweep("mmap");
+}
+
+int bench_mem_page_alloc(int argc, const char **argv)
+{
+	argc = parse_options(argc, argv, page_alloc_options,
+			     bench_mem_page_alloc_usage, 0);
+	if (argc) {
+		usage_with_options(bench_mem_page_alloc_usage, page_alloc_options);
+		exit(EXIT_FAILURE);
+	}
+
+	mode = MODE_POPULATE;
+	return run_sweep("page-alloc");
+}
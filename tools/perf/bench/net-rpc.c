@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-rpc.c
+ *
+ * net rpc: request/response latency over loopback. Each client thread
+ * sends a fixed size request to its own server thread, which echoes it
+ * back; the client times every round-trip. The sweep is over the number
+ * of client/server pairs, which run over AF_UNIX stream sockets or, with
+ * --tcp, over TCP connections to 127.0.0.1.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <perf/cpumap.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#include <err.h>
+
+static const char	*threads_str;
+static unsigned int	nsecs		= 5;
+static unsigned int	msg_size	= 64;
+static bool		noaffinity;
+static bool		use_tcp;
+
+static const struct option options[] = {
+	OPT_STRING('t', "threads", &threads_str, "1,2,4-16",
+		   "Client/server pair counts to sweep (default: 1 to half the number of CPUs, doubling)"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime per pair count (in seconds)"),
+	OPT_UINTEGER('s', "size", &msg_size, "Specify request and response size (in bytes)"),
+	OPT_BOOLEAN( 'T', "tcp", &use_tcp, "Use TCP over loopback instead of AF_UNIX"),
+	OPT_BOOLEAN( 'n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_END()
+};
+
+static const char * const bench_net_rpc_usage[] = {
+	"perf bench net rpc <options>",
+	NULL
+};
+
+/*
+ * Latency histogram: exact below 16ns, then 8 buckets per power of two,
+ * i.e. a resolution of 12.5%.
+ */
+#define LAT_BUCKETS	(16 + 60 * 8)
+
+static unsigned int lat_bucket(u64 ns)
+{
+	unsigned int msb;
+
+	if (ns < 16)
+		return ns;
+
+	msb = 63 - __builtin_clzll(ns);
+	return 16 + (msb - 4) * 8 + ((ns >> (msb - 3)) & 7);
+}
+
+static u64 lat_bucket_ns(unsigned int bucket)
+{
+	unsigned int msb;
+
+	if (bucket < 16)
+		return bucket;
+
+	msb = (bucket - 16) / 8 + 4;
+	return (u64)(8 + (bucket - 16) % 8) << (msb - 3);
+}
+
+/* The client of pair i is worker 2i, its server worker 2i + 1. */
+struct worker {
+	int			fd;
+	bool			server;
+	char			*buf;
+	unsigned long		rpcs;
+	u64			lat_sum;
+	u64			lat_max;
+	u64			*hist;
+} __attribute__((aligned(64)));
+
+static int xfer(int fd, char *buf, bool out)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < msg_size) {
+		if (out)
+			ret = write(fd, buf + done, msg_size - done);
+		else
+			ret = read(fd, buf + done, msg_size - done);
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+
+	return 0;
+}
+
+static inline u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = arg;
+	u64 start, lat;
+
+	bench_sweep__worker_start();
+
+	if (w->server) {
+		/* Echo until the client closes its end. */
+		while (!xfer(w->fd, w->buf, false) && !xfer(w->fd, w->buf, true))
+			;
+		return NULL;
+	}
+
+	while (!bench_sweep__stopped()) {
+		start = now_ns();
+		if (xfer(w->fd, w->buf, true) || xfer(w->fd, w->buf, false))
+			err(EXIT_FAILURE, "rpc");
+		lat = now_ns() - start;
+
+		w->rpcs++;
+		w->lat_sum += lat;
+		if (lat > w->lat_max)
+			w->lat_max = lat;
+		w->hist[lat_bucket(lat)]++;
+	}
+
+	shutdown(w->fd, SHUT_WR);
+	return NULL;
+}
+
+static void tcp_pair(int listen_fd, struct sockaddr_in *addr, int sv[2])
+{
+	int one = 1;
+
+	sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+	if (sv[0] < 0)
+		err(EXIT_FAILURE, "socket");
+	if (connect(sv[0], (struct sockaddr *)addr, sizeof(*addr)))
+		err(EXIT_FAILURE, "connect");
+
+	sv[1] = accept(listen_fd, NULL, NULL);
+	if (sv[1] < 0)
+		err(EXIT_FAILURE, "accept");
+
+	if (setsockopt(sv[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) ||
+	    setsockopt(sv[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)))
+		err(EXIT_FAILURE, "setsockopt");
+}
+
+static int tcp_listen(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		err(EXIT_FAILURE, "socket");
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) ||
+	    listen(fd, 128) ||
+	    getsockname(fd, (struct sockaddr *)addr, &len))
+		err(EXIT_FAILURE, "tcp listen");
+
+	return fd;
+}
+
+static void print_header(void)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u byte RPCs over %s, %u secs per run\n\n",
+		       msg_size, use_tcp ? "TCP loopback" : "AF_UNIX", nsecs);
+		printf(" %8s %14s %10s %10s %10s %10s\n",
+		       "pairs", "rpcs/sec", "avg usec", "p50 usec", "p99 usec", "max usec");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("{\"benchmark\": \"net/rpc\", \"transport\": \"%s\", \"size\": %u, "
+		       "\"runtime\": %u, \"results\": [",
+		       use_tcp ? "tcp" : "unix", msg_size, nsecs);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+static double percentile_us(u64 *hist, unsigned long total, unsigned int pct)
+{
+	unsigned long seen = 0, target = (total * pct + 99) / 100;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= target && seen)
+			return lat_bucket_ns(i) / 1000.0;
+	}
+
+	return 0;
+}
+
+static void print_result(unsigned int idx, unsigned int pairs,
+			 struct worker *worker, double secs)
+{
+	u64 hist[LAT_BUCKETS] = { 0 };
+	unsigned long rpcs = 0;
+	u64 lat_sum = 0, lat_max = 0;
+	double avg, p50, p99, max_us;
+	unsigned int i, j;
+
+	for (i = 0; i < pairs; i++) {
+		struct worker *w = &worker[2 * i];
+
+		rpcs += w->rpcs;
+		lat_sum += w->lat_sum;
+		lat_max = max(lat_max, w->lat_max);
+		for (j = 0; j < LAT_BUCKETS; j++)
+			hist[j] += w->hist[j];
+	}
+
+	avg = rpcs ? lat_sum / 1000.0 / rpcs : 0;
+	p50 = percentile_us(hist, rpcs, 50);
+	p99 = percentile_us(hist, rpcs, 99);
+	max_us = lat_max / 1000.0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %8u %14.0f %10.2f %10.2f %10.2f %10.2f\n",
+		       pairs, rpcs / secs, avg, p50, p99, max_us);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%u %.0f %.2f\n", pairs, rpcs / secs, avg);
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("%s\n  {\"pairs\": %u, \"rpcs_per_sec\": %.0f, \"avg_usecs\": %.2f, "
+		       "\"p50_usecs\": %.2f, \"p99_usecs\": %.2f, \"max_usecs\": %.2f}",
+		       idx ? "," : "", pairs, rpcs / secs, avg, p50, p99, max_us);
+		break;
+	default:
+		break;
+	}
+}
+
+int bench_net_rpc(int argc, const char **argv)
+{
+	struct sockaddr_in addr;
+	struct bench_sweep sweep;
+	struct perf_cpu_map *cpu;
+	struct worker *worker;
+	int listen_fd = -1;
+	unsigned int i, j;
+
+	argc = parse_options(argc, argv, options, bench_net_rpc_usage, 0);
+	if (argc || !msg_size) {
+		usage_with_options(bench_net_rpc_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		err(EXIT_FAILURE, "perf_cpu_map__new");
+
+	if (bench_sweep__parse(&sweep, threads_str, max(cpu->nr / 2, 1))) {
+		fprintf(stderr, "Invalid pair list: '%s'\n", threads_str ?: "");
+		exit(EXIT_FAILURE);
+	}
+
+	if (use_tcp)
+		listen_fd = tcp_listen(&addr);
+
+	print_header();
+
+	for (i = 0; i < sweep.nr; i++) {
+		unsigned int pairs = sweep.threads[i];
+		double secs;
+
+		worker = calloc(2 * pairs, sizeof(*worker));
+		if (!worker)
+			err(EXIT_FAILURE, "calloc");
+
+		for (j = 0; j < pairs; j++) {
+			struct worker *client = &worker[2 * j];
+			struct worker *server = &worker[2 * j + 1];
+			int sv[2];
+
+			if (use_tcp)
+				tcp_pair(listen_fd, &addr, sv);
+			else if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+				err(EXIT_FAILURE, "socketpair");
+
+			client->fd = sv[0];
+			client->buf = calloc(1, msg_size);
+			client->hist = calloc(LAT_BUCKETS, sizeof(u64));
+			server->fd = sv[1];
+			server->server = true;
+			server->buf = calloc(1, msg_size);
+			if (!client->buf || !client->hist || !server->buf)
+				err(EXIT_FAILURE, "calloc");
+		}
+
+		secs = bench_sweep__run(2 * pairs, cpu, noaffinity, nsecs, workerfn,
+					worker, sizeof(*worker));
+		print_result(i, pairs, worker, secs);
+		fflush(stdout);
+
+		for (j = 0; j < 2 * pairs; j++) {
+			close(worker[j].fd);
+			free(worker[j].buf);
+			free(worker[j].hist);
+		}
+		free(worker);
+	}
+
+	if (bench_format == BENCH_FORMAT_JSON)
+		printf("\n]}\n");
+
+	if (listen_fd >= 0)
+		close(listen_fd);
+	perf_cpu_map__put(cpu);
+	return 0;
+}
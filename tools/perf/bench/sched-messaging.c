@@ -316,6 +316,12 @@ int bench_sched_messaging(int argc, const char **argv)
 		printf("%lu.%03lu\n", (unsigned long) diff.tv_sec,
 		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
 		break;
+	case BENCH_FORMAT_JSON:
+		printf("{\"benchmark\": \"sched/messaging\", \"groups\": %u, "
+		       "\"fds\": %u, \"threaded\": %s, \"usecs\": %llu}\n",
+		       num_groups, num_fds, thread_mode ? "true" : "false",
+		       (unsigned long long)diff.tv_sec * USEC_PER_SEC + diff.tv_usec);
+		break;
 	default:
 		/* reaching here is something disaster */
 		fprintf(stderr, "Unknown format:%d\n", bench_format);
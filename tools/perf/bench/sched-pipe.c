@@ -172,6 +172,16 @@ int bench_sched_pipe(int argc, const char **argv)
 		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
 		break;
 
+	case BENCH_FORMAT_JSON:
+		result_usec = diff.tv_sec * USEC_PER_SEC;
+		result_usec += diff.tv_usec;
+
+		printf("{\"benchmark\": \"sched/pipe\", \"loops\": %d, \"threaded\": %s, "
+		       "\"usecs\": %llu, \"usecs_per_op\": %lf}\n",
+		       loops, threaded ? "true" : "false", result_usec,
+		       (double)result_usec / (double)loops);
+		break;
+
 	default:
 		/* reaching here is something disaster */
 		fprintf(stderr, "Unknown format:%d\n", bench_format);
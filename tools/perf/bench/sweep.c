@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * sweep.c
+ *
+ * Thread-count sweeps shared by the kernel subsystem benchmarks (uring,
+ * mem mmap/page-alloc, net): parse the list of thread counts to run, and
+ * run one timed round of worker threads for each of them.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/compiler.h>
+#include <perf/cpumap.h>
+
+#include "bench.h"
+
+#include <err.h>
+
+bool bench_sweep__done;
+
+static pthread_barrier_t start_barrier;
+
+static int sweep_add(struct bench_sweep *sweep, unsigned long nr)
+{
+	if (!nr || sweep->nr >= BENCH_SWEEP_MAX)
+		return -EINVAL;
+
+	sweep->threads[sweep->nr++] = nr;
+	return 0;
+}
+
+/*
+ * Parse a comma separated list of thread counts. An element is either a
+ * single count ("6") or a range ("1-16"), which is walked by doubling and
+ * always includes its upper end. A NULL or empty @str selects "1-@max".
+ */
+int bench_sweep__parse(struct bench_sweep *sweep, const char *str,
+		       unsigned int max)
+{
+	char *buf, *tok, *saveptr = NULL;
+	int ret = 0;
+
+	sweep->nr = 0;
+
+	if (!str || !*str) {
+		unsigned int nr;
+
+		for (nr = 1; nr < max; nr *= 2)
+			sweep_add(sweep, nr);
+		return sweep_add(sweep, max);
+	}
+
+	buf = strdup(str);
+	if (!buf)
+		return -ENOMEM;
+
+	for (tok = strtok_r(buf, ",", &saveptr); tok && !ret;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		unsigned long lo, hi, nr;
+		char *end;
+
+		lo = strtoul(tok, &end, 0);
+		hi = lo;
+		if (*end == '-')
+			hi = strtoul(end + 1, &end, 0);
+
+		if (*end || !lo || hi < lo) {
+			ret = -EINVAL;
+			break;
+		}
+
+		for (nr = lo; nr < hi && !ret; nr *= 2)
+			ret = sweep_add(sweep, nr);
+		if (!ret)
+			ret = sweep_add(sweep, hi);
+	}
+
+	free(buf);
+	return ret;
+}
+
+/* Called by every worker before it starts its measured loop. */
+void bench_sweep__worker_start(void)
+{
+	pthread_barrier_wait(&start_barrier);
+}
+
+/*
+ * Run @nr workers for @runtime seconds. Worker i gets @args + i * @argsize
+ * and, unless @noaffinity is set, is bound to the i-th CPU of @cpu (modulo
+ * its size). Returns the elapsed time in seconds, measured from the moment
+ * all workers are ready until the last one has stopped.
+ */
+double bench_sweep__run(unsigned int nr, struct perf_cpu_map *cpu,
+			bool noaffinity, unsigned int runtime,
+			void *(*fn)(void *), void *args, size_t argsize)
+{
+	pthread_attr_t thread_attr, *attrp = NULL;
+	struct timespec start, end;
+	pthread_t *threads;
+	cpu_set_t cpuset;
+	unsigned int i;
+	int ret;
+
+	threads = calloc(nr, sizeof(*threads));
+	if (!threads)
+		err(EXIT_FAILURE, "calloc");
+
+	WRITE_ONCE(bench_sweep__done, false);
+	pthread_barrier_init(&start_barrier, NULL, nr + 1);
+
+	if (!noaffinity)
+		pthread_attr_init(&thread_attr);
+
+	for (i = 0; i < nr; i++) {
+		if (!noaffinity) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(cpu->map[i % cpu->nr], &cpuset);
+
+			ret = pthread_attr_setaffinity_np(&thread_attr, sizeof(cpu_set_t), &cpuset);
+			if (ret)
+				err(EXIT_FAILURE, "pthread_attr_setaffinity_np");
+
+			attrp = &thread_attr;
+		}
+
+		ret = pthread_create(&threads[i], attrp, fn,
+				     (char *)args + i * argsize);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	if (!noaffinity)
+		pthread_attr_destroy(&thread_attr);
+
+	pthread_barrier_wait(&start_barrier);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	sleep(runtime);
+	WRITE_ONCE(bench_sweep__done, true);
+
+	for (i = 0; i < nr; i++) {
+		ret = pthread_join(threads[i], NULL);
+		if (ret)
+			err(EXIT_FAILURE, "pthread_join");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_barrier_destroy(&start_barrier);
+	free(threads);
+
+	return (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+}
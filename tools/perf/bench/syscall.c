@@ -70,6 +70,15 @@ int bench_syscall_basic(int argc, const char **argv)
 		       (unsigned long) (diff.tv_usec / 1000));
 		break;
 
+	case BENCH_FORMAT_JSON:
+		result_usec = diff.tv_sec * 1000000;
+		result_usec += diff.tv_usec;
+
+		printf("{\"benchmark\": \"syscall/basic\", \"loops\": %d, "
+		       "\"usecs\": %llu, \"usecs_per_op\": %lf}\n",
+		       loops, result_usec, (double)result_usec / (double)loops);
+		break;
+
 	default:
 		/* reaching here is something disaster */
 		fprintf(stderr, "Unknown format:%d\n", bench_format);
@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * uring.c
+ *
+ * uring nop: io_uring submission and completion throughput. Every thread
+ * owns a ring and keeps submitting batches of IORING_OP_NOP requests and
+ * reaping their completions, so the cost measured is that of the io_uring
+ * core (SQE consumption, request allocation, CQE posting) and of the
+ * io_uring_enter() round-trip, with no actual I/O.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/compiler.h>
+#include <linux/io_uring.h>
+#include <perf/cpumap.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#include <err.h>
+
+#ifndef __NR_io_uring_setup
+# ifdef __alpha__
+#  define __NR_io_uring_setup	535
+#  define __NR_io_uring_enter	536
+# else
+#  define __NR_io_uring_setup	425
+#  define __NR_io_uring_enter	426
+# endif
+#endif
+
+static const char	*threads_str;
+static unsigned int	nsecs		= 5;
+static unsigned int	batch		= 8;
+static unsigned int	entries		= 128;
+static bool		noaffinity;
+
+static const struct option options[] = {
+	OPT_STRING('t', "threads", &threads_str, "1,2,4-16",
+		   "Thread counts to sweep (default: 1 to the number of CPUs, doubling)"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime per thread count (in seconds)"),
+	OPT_UINTEGER('b', "batch", &batch, "Specify number of SQEs submitted per io_uring_enter()"),
+	OPT_UINTEGER('e', "entries", &entries, "Specify SQ ring size of each ring"),
+	OPT_BOOLEAN( 'n', "noaffinity", &noaffinity, "Disables CPU affinity"),
+	OPT_END()
+};
+
+static const char * const bench_uring_usage[] = {
+	"perf bench uring nop <options>",
+	NULL
+};
+
+struct ring {
+	int			fd;
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_array;
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	void			*sq_ptr, *cq_ptr;
+	size_t			sq_len, cq_len, sqes_len;
+};
+
+struct worker {
+	struct ring		ring;
+	unsigned long		ops;
+	unsigned long		enters;
+	unsigned long		errors;
+} __attribute__((aligned(64)));
+
+static int ring_setup(struct ring *ring, unsigned int nr)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = syscall(__NR_io_uring_setup, nr, &p);
+	if (ring->fd < 0)
+		return -errno;
+
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == MAP_FAILED)
+		return -errno;
+
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+	if (ring->cq_ptr == MAP_FAILED)
+		return -errno;
+
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		return -errno;
+
+	ring->sq_tail  = ring->sq_ptr + p.sq_off.tail;
+	ring->sq_mask  = ring->sq_ptr + p.sq_off.ring_mask;
+	ring->sq_array = ring->sq_ptr + p.sq_off.array;
+	ring->cq_head  = ring->cq_ptr + p.cq_off.head;
+	ring->cq_tail  = ring->cq_ptr + p.cq_off.tail;
+	ring->cq_mask  = ring->cq_ptr + p.cq_off.ring_mask;
+	ring->cqes     = ring->cq_ptr + p.cq_off.cqes;
+
+	return 0;
+}
+
+static void ring_exit(struct ring *ring)
+{
+	munmap(ring->sqes, ring->sqes_len);
+	munmap(ring->cq_ptr, ring->cq_len);
+	munmap(ring->sq_ptr, ring->sq_len);
+	close(ring->fd);
+}
+
+static void submit_batch(struct ring *ring)
+{
+	unsigned int tail = *ring->sq_tail, mask = *ring->sq_mask;
+	unsigned int i;
+
+	for (i = 0; i < batch; i++, tail++) {
+		unsigned int idx = tail & mask;
+		struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_NOP;
+		sqe->user_data = i;
+		ring->sq_array[idx] = idx;
+	}
+
+	/* Pairs with the acquire of the SQ tail in the kernel. */
+	__atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void reap_batch(struct worker *w)
+{
+	struct ring *ring = &w->ring;
+	unsigned int head = *ring->cq_head, mask = *ring->cq_mask;
+	unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++) {
+		if (ring->cqes[head & mask].res < 0)
+			w->errors++;
+		w->ops++;
+	}
+
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = arg;
+	int ret;
+
+	bench_sweep__worker_start();
+
+	while (!bench_sweep__stopped()) {
+		submit_batch(&w->ring);
+		ret = syscall(__NR_io_uring_enter, w->ring.fd, batch, batch,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0)
+			err(EXIT_FAILURE, "io_uring_enter");
+		w->enters++;
+		reap_batch(w);
+	}
+
+	return NULL;
+}
+
+static void print_header(void)
+{
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u NOPs per io_uring_enter(), %u SQ entries per ring, %u secs per run\n\n",
+		       batch, entries, nsecs);
+		printf(" %8s %16s %14s %14s\n",
+		       "threads", "ops/sec", "nsecs/op", "enters/sec");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("{\"benchmark\": \"uring/nop\", \"batch\": %u, \"entries\": %u, "
+		       "\"runtime\": %u, \"results\": [", batch, entries, nsecs);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+static void print_result(unsigned int idx, unsigned int nr,
+			 struct worker *worker, double secs)
+{
+	unsigned long ops = 0, enters = 0, errors = 0;
+	double ops_sec, nsecs_op;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		ops += worker[i].ops;
+		enters += worker[i].enters;
+		errors += worker[i].errors;
+	}
+
+	if (errors)
+		fprintf(stderr, "Warning: %lu NOPs completed with an error\n", errors);
+
+	ops_sec = ops / secs;
+	/* CPU time spent per op, summed over all threads */
+	nsecs_op = ops ? secs * nr * 1e9 / ops : 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %8u %16.0f %14.1f %14.0f\n",
+		       nr, ops_sec, nsecs_op, enters / secs);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%u %.0f\n", nr, ops_sec);
+		break;
+	case BENCH_FORMAT_JSON:
+		printf("%s\n  {\"threads\": %u, \"ops_per_sec\": %.0f, "
+		       "\"nsecs_per_op\": %.1f, \"enters_per_sec\": %.0f}",
+		       idx ? "," : "", nr, ops_sec, nsecs_op, enters / secs);
+		break;
+	default:
+		break;
+	}
+}
+
+int bench_uring_nop(int argc, const char **argv)
+{
+	struct bench_sweep sweep;
+	struct perf_cpu_map *cpu;
+	struct worker *worker;
+	unsigned int i, j;
+	int ret;
+
+	argc = parse_options(argc, argv, options, bench_uring_usage, 0);
+	if (argc || !batch || batch > entries) {
+		usage_with_options(bench_uring_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	cpu = perf_cpu_map__new(NULL);
+	if (!cpu)
+		err(EXIT_FAILURE, "perf_cpu_map__new");
+
+	if (bench_sweep__parse(&sweep, threads_str, cpu->nr)) {
+		fprintf(stderr, "Invalid thread list: '%s'\n", threads_str ?: "");
+		exit(EXIT_FAILURE);
+	}
+
+	print_header();
+
+	for (i = 0; i < sweep.nr; i++) {
+		unsigned int nr = sweep.threads[i];
+		double secs;
+
+		worker = calloc(nr, sizeof(*worker));
+		if (!worker)
+			err(EXIT_FAILURE, "calloc");
+
+		for (j = 0; j < nr; j++) {
+			ret = ring_setup(&worker[j].ring, entries);
+			if (ret) {
+				errno = -ret;
+				err(EXIT_FAILURE, "io_uring_setup");
+			}
+		}
+
+		secs = bench_sweep__run(nr, cpu, noaffinity, nsecs, workerfn,
+					worker, sizeof(*worker));
+		print_result(i, nr, worker, secs);
+		fflush(stdout);
+
+		for (j = 0; j < nr; j++)
+			ring_exit(&worker[j].ring);
+		free(worker);
+	}
+
+	if (bench_format == BENCH_FORMAT_JSON)
+		printf("\n]}\n");
+
+	perf_cpu_map__put(cpu);
+	return 0;
+}
@@ -16,6 +16,8 @@
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
  *  epoll ... Event poll performance
+ *  uring ... io_uring performance
+ *  net   ... Networking performance
  */
 #include <subcmd/parse-options.h>
 #include "builtin.h"
@@ -60,6 +62,8 @@ static struct bench mem_benchmarks[] = {
 	{ "memcpy",	"Benchmark for memcpy() functions",		bench_mem_memcpy	},
 	{ "memset",	"Benchmark for memset() functions",		bench_mem_memset	},
 	{ "find_bit",	"Benchmark for find_bit() functions",		bench_mem_find_bit	},
+	{ "mmap",	"Benchmark for mmap/munmap and page fault scaling", bench_mem_mmap	},
+	{ "page-alloc",	"Benchmark for page allocator throughput",	bench_mem_page_alloc	},
 	{ "all",	"Run all memory access benchmarks",		NULL			},
 	{ NULL,		NULL,						NULL			}
 };
@@ -84,6 +88,18 @@ static struct bench epoll_benchmarks[] = {
 };
 #endif // HAVE_EVENTFD_SUPPORT
 
+static struct bench uring_benchmarks[] = {
+	{ "nop",	"Benchmark for io_uring submission and completion", bench_uring_nop	},
+	{ "all",	"Run all io_uring benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench net_benchmarks[] = {
+	{ "rpc",	"Benchmark for loopback request/response latency", bench_net_rpc	},
+	{ "all",	"Run all networking benchmarks",		NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 static struct bench internals_benchmarks[] = {
 	{ "synthesize", "Benchmark perf event synthesis",	bench_synthesize	},
 	{ "kallsyms-parse", "Benchmark kallsyms parsing",	bench_kallsyms_parse	},
@@ -109,6 +125,8 @@ static struct collection collections[] = {
 #ifdef HAVE_EVENTFD_SUPPORT
 	{"epoll",       "Epoll stressing benchmarks",                   epoll_benchmarks        },
 #endif
+	{ "uring",	"io_uring benchmarks",				uring_benchmarks	},
+	{ "net",	"Networking benchmarks",			net_benchmarks		},
 	{ "internals",	"Perf-internals benchmarks",			internals_benchmarks	},
 	{ "all",	"All benchmarks",				NULL			},
 	{ NULL,		NULL,						NULL			}
@@ -141,7 +159,7 @@ int bench_format = BENCH_FORMAT_DEFAULT;
 unsigned int bench_repeat = 10; /* default number of times to repeat the run */
 
 static const struct option bench_options[] = {
-	OPT_STRING('f', "format", &bench_format_str, "default|simple", "Specify the output formatting style"),
+	OPT_STRING('f', "format", &bench_format_str, "default|simple|json", "Specify the output formatting style"),
 	OPT_UINTEGER('r', "repeat",  &bench_repeat,   "Specify amount of times to repeat the run"),
 	OPT_END()
 };
@@ -177,6 +195,8 @@ static int bench_str2int(const char *str)
 		return BENCH_FORMAT_DEFAULT;
 	else if (!strcmp(str, BENCH_FORMAT_SIMPLE_STR))
 		return BENCH_FORMAT_SIMPLE;
+	else if (!strcmp(str, BENCH_FORMAT_JSON_STR))
+		return BENCH_FORMAT_JSON;
 
 	return BENCH_FORMAT_UNKNOWN;
 }
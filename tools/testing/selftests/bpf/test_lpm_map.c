@@ -28,6 +28,13 @@
 #include "bpf_util.h"
 #include "bpf_rlimit.h"
 
+#ifndef BPF_F_LPM_STRIDE
+#define BPF_F_LPM_STRIDE	(1U << 13)
+#endif
+
+/* Long enough for the kernel to rebuild the stride table of a map */
+#define LPM_STRIDE_SETTLE_US	200000
+
 struct tlpm_node {
 	struct tlpm_node *next;
 	size_t n_bits;
@@ -206,7 +213,7 @@ static void test_lpm_order(void)
 	tlpm_clear(l2);
 }
 
-static void test_lpm_map(int keysize)
+static void test_lpm_map(int keysize, __u32 map_flags)
 {
 	size_t i, j, n_matches, n_matches_after_delete, n_nodes, n_lookups;
 	struct tlpm_node *t, *list = NULL;
@@ -237,7 +244,7 @@ static void test_lpm_map(int keysize)
 			     sizeof(*key) + keysize,
 			     keysize + 1,
 			     4096,
-			     BPF_F_NO_PREALLOC);
+			     BPF_F_NO_PREALLOC | map_flags);
 	assert(map >= 0);
 
 	for (i = 0; i < n_nodes; ++i) {
@@ -253,6 +260,9 @@ static void test_lpm_map(int keysize)
 		assert(!r);
 	}
 
+	if (map_flags & BPF_F_LPM_STRIDE)
+		usleep(LPM_STRIDE_SETTLE_US);
+
 	for (i = 0; i < n_lookups; ++i) {
 		for (j = 0; j < keysize; ++j)
 			data[j] = rand() & 0xff;
@@ -290,6 +300,8 @@ static void test_lpm_map(int keysize)
 		list = tlpm_delete(list, list->key, list->n_bits);
 		assert(list);
 	}
+	if (map_flags & BPF_F_LPM_STRIDE)
+		usleep(LPM_STRIDE_SETTLE_US);
 	for (i = 0; i < n_lookups; ++i) {
 		for (j = 0; j < keysize; ++j)
 			data[j] = rand() & 0xff;
@@ -792,7 +804,11 @@ int main(void)
 
 	/* Test with 8, 16, 24, 32, ... 128 bit prefix length */
 	for (i = 1; i <= 16; ++i)
-		test_lpm_map(i);
+		test_lpm_map(i, 0);
+
+	/* Same with the multibit lookup table */
+	for (i = 1; i <= 16; ++i)
+		test_lpm_map(i, BPF_F_LPM_STRIDE);
 
 	test_lpm_ipaddr();
 	test_lpm_delete();
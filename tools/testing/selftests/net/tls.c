@@ -1229,6 +1229,70 @@ TEST_F(tls, control_msg)
 	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
 }
 
+TEST_F(tls, rx_no_pad)
+{
+	char const *test_str = "test_read";
+	char cbuf[CMSG_SPACE(sizeof(char))];
+	char record_type = 100;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	int send_len = 10;
+	struct iovec vec;
+	char buf[10];
+	socklen_t optlen;
+	int val = 1;
+
+	if (self->notls)
+		return;
+
+	if (variant->tls_version != TLS_1_3_VERSION) {
+		EXPECT_EQ(setsockopt(self->cfd, SOL_TLS, TLS_RX_EXPECT_NO_PAD,
+				     &val, sizeof(val)), -1);
+		EXPECT_EQ(errno, EINVAL);
+		return;
+	}
+
+	ASSERT_EQ(setsockopt(self->cfd, SOL_TLS, TLS_RX_EXPECT_NO_PAD,
+			     &val, sizeof(val)), 0);
+	val = 0;
+	optlen = sizeof(val);
+	EXPECT_EQ(getsockopt(self->cfd, SOL_TLS, TLS_RX_EXPECT_NO_PAD,
+			     &val, &optlen), 0);
+	EXPECT_EQ(val, 1);
+
+	/* Data records are decrypted straight into the user buffer */
+	EXPECT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	EXPECT_EQ(recv(self->cfd, buf, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+
+	/* Control records still have to be returned as such */
+	vec.iov_base = (char *)test_str;
+	vec.iov_len = send_len;
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &vec;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(char));
+	*CMSG_DATA(cmsg) = record_type;
+	msg.msg_controllen = cmsg->cmsg_len;
+	EXPECT_EQ(sendmsg(self->fd, &msg, 0), send_len);
+
+	memset(buf, 0, sizeof(buf));
+	vec.iov_base = buf;
+	msg.msg_controllen = sizeof(cbuf);
+	EXPECT_EQ(recvmsg(self->cfd, &msg, MSG_WAITALL), send_len);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	EXPECT_NE(cmsg, NULL);
+	EXPECT_EQ(cmsg->cmsg_type, TLS_GET_RECORD_TYPE);
+	record_type = *((unsigned char *)CMSG_DATA(cmsg));
+	EXPECT_EQ(record_type, 100);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+}
+
 TEST_F(tls, shutdown)
 {
 	char const *test_str = "test_read";
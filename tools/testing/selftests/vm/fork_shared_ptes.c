@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Check that fork() with PR_SET_FORK_SHARED_PTES keeps parent and child
+ * memory apart, whoever touches the shared pte tables first.
+ */
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include "../kselftest.h"
+
+#ifndef PR_SET_FORK_SHARED_PTES
+#define PR_SET_FORK_SHARED_PTES		69
+#define PR_GET_FORK_SHARED_PTES		70
+#endif
+
+#define PMD_SIZE	(2UL * 1024 * 1024)
+#define NR_PMDS		8
+#define SIZE		(NR_PMDS * PMD_SIZE)
+
+static size_t pagesize;
+
+static char *map_area(void)
+{
+	char *area, *addr;
+
+	/* Over-allocate so that the area can be PMD aligned */
+	area = mmap(NULL, SIZE + PMD_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED)
+		ksft_exit_fail_msg("mmap failed\n");
+	addr = (char *)(((uintptr_t)area + PMD_SIZE - 1) & ~(PMD_SIZE - 1));
+
+	/* Keep the memory in pte tables rather than in THPs */
+	madvise(addr, SIZE, MADV_NOHUGEPAGE);
+	memset(addr, 0x55, SIZE);
+	return addr;
+}
+
+static bool check_area(char *addr, size_t len, char val)
+{
+	size_t i;
+
+	for (i = 0; i < len; i += pagesize)
+		if (addr[i] != val)
+			return false;
+	return true;
+}
+
+static bool wait_child(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0)
+		return false;
+	return WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+/* The child writes first, the parent must not see it */
+static void test_child_write(void)
+{
+	char *addr = map_area();
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		ksft_exit_fail_msg("fork failed\n");
+	if (!pid) {
+		if (!check_area(addr, SIZE, 0x55))
+			_exit(1);
+		memset(addr, 0xaa, SIZE / 2);
+		_exit(!check_area(addr, SIZE / 2, 0xaa) ||
+		      !check_area(addr + SIZE / 2, SIZE / 2, 0x55));
+	}
+
+	ksft_test_result(wait_child(pid) && check_area(addr, SIZE, 0x55),
+			 "child write is private\n");
+	munmap(addr, SIZE);
+}
+
+/* The parent writes first, the child must still see the old data */
+static void test_parent_write(void)
+{
+	char *addr = map_area();
+	int fds[2];
+	pid_t pid;
+	char c;
+
+	if (pipe(fds))
+		ksft_exit_fail_msg("pipe failed\n");
+
+	pid = fork();
+	if (pid < 0)
+		ksft_exit_fail_msg("fork failed\n");
+	if (!pid) {
+		if (read(fds[0], &c, 1) != 1)
+			_exit(1);
+		_exit(!check_area(addr, SIZE, 0x55));
+	}
+
+	memset(addr, 0xaa, SIZE);
+	if (write(fds[1], "x", 1) != 1)
+		ksft_exit_fail_msg("write failed\n");
+
+	ksft_test_result(wait_child(pid) && check_area(addr, SIZE, 0xaa),
+			 "parent write is private\n");
+	close(fds[0]);
+	close(fds[1]);
+	munmap(addr, SIZE);
+}
+
+/* Unmapping and discarding parts of a shared table only affects the caller */
+static void test_partial_unmap(void)
+{
+	char *addr = map_area();
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		ksft_exit_fail_msg("fork failed\n");
+	if (!pid) {
+		/* Half a table, then a whole one */
+		munmap(addr + PMD_SIZE / 2, PMD_SIZE / 2);
+		munmap(addr + PMD_SIZE, PMD_SIZE);
+		madvise(addr + 2 * PMD_SIZE, PMD_SIZE / 2, MADV_DONTNEED);
+		_exit(!check_area(addr, PMD_SIZE / 2, 0x55) ||
+		      !check_area(addr + 2 * PMD_SIZE, PMD_SIZE / 2, 0) ||
+		      !check_area(addr + 2 * PMD_SIZE + PMD_SIZE / 2,
+				  SIZE - 2 * PMD_SIZE - PMD_SIZE / 2, 0x55));
+	}
+
+	ksft_test_result(wait_child(pid) && check_area(addr, SIZE, 0x55),
+			 "partial unmap is private\n");
+	munmap(addr, SIZE);
+}
+
+/* Changing the protection of one mm has to leave the other one alone */
+static void test_mprotect(void)
+{
+	char *addr = map_area();
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		ksft_exit_fail_msg("fork failed\n");
+	if (!pid) {
+		if (mprotect(addr, PMD_SIZE, PROT_NONE))
+			_exit(1);
+		if (mprotect(addr, PMD_SIZE, PROT_READ | PROT_WRITE))
+			_exit(1);
+		memset(addr, 0xaa, PMD_SIZE);
+		_exit(!check_area(addr, PMD_SIZE, 0xaa));
+	}
+
+	memset(addr + PMD_SIZE, 0xaa, PMD_SIZE);
+	ksft_test_result(wait_child(pid) && check_area(addr, PMD_SIZE, 0x55) &&
+			 check_area(addr + PMD_SIZE, PMD_SIZE, 0xaa),
+			 "mprotect is private\n");
+	munmap(addr, SIZE);
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	pagesize = getpagesize();
+
+	ksft_print_header();
+	ksft_set_plan(5);
+
+	if (prctl(PR_SET_FORK_SHARED_PTES, 1, 0, 0, 0)) {
+		if (errno == EINVAL)
+			ksft_exit_skip("PR_SET_FORK_SHARED_PTES not supported\n");
+		ksft_exit_fail_msg("PR_SET_FORK_SHARED_PTES failed\n");
+	}
+	ksft_test_result(prctl(PR_GET_FORK_SHARED_PTES, 0, 0, 0, 0) == 1,
+			 "PR_GET_FORK_SHARED_PTES\n");
+
+	test_child_write();
+	test_parent_write();
+	test_partial_unmap();
+	test_mprotect();
+
+	err = ksft_get_fail_cnt();
+	if (err)
+		ksft_exit_fail_msg("%d out of %d tests failed\n",
+				   err, ksft_test_num());
+	return ksft_exit_pass();
+}
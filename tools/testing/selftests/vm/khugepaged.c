@@ -15,6 +15,10 @@
 #define MADV_PAGEOUT 21
 #endif
 
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
 #define BASE_ADDR ((void *)(1UL << 30))
 static unsigned long hpage_pmd_size;
 static unsigned long page_size;
@@ -544,6 +548,33 @@ static void collapse_full(void)
 	munmap(p, hpage_pmd_size);
 }
 
+static void madvise_collapse_full(void)
+{
+	void *p;
+
+	p = alloc_mapping();
+	fill_memory(p, 0, hpage_pmd_size);
+	printf("Collapse fully populated PTE table with MADV_COLLAPSE...");
+	if (madvise(p, hpage_pmd_size, MADV_COLLAPSE)) {
+		perror("madvise(MADV_COLLAPSE)");
+		fail("Fail");
+	} else if (check_huge(p)) {
+		success("OK");
+	} else {
+		fail("Fail");
+	}
+
+	printf("MADV_COLLAPSE on a PMD-mapped range...");
+	if (madvise(p, hpage_pmd_size, MADV_COLLAPSE)) {
+		perror("madvise(MADV_COLLAPSE)");
+		fail("Fail");
+	} else {
+		success("OK");
+	}
+	validate_memory(p, 0, hpage_pmd_size);
+	munmap(p, hpage_pmd_size);
+}
+
 static void collapse_empty(void)
 {
 	void *p;
@@ -1026,6 +1057,7 @@ int main(void)
 	collapse_fork();
 	collapse_fork_compound();
 	collapse_max_ptes_shared();
+	madvise_collapse_full();
 
 	restore_settings(0);
 }
@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <stdbool.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
 #include <numa.h>
 
 #include "../kselftest.h"
@@ -18,6 +20,11 @@
 #define KSM_MERGE_ACROSS_NODES_DEFAULT true
 #define MB (1ul << 20)
 
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE 67
+#define PR_GET_MEMORY_MERGE 68
+#endif
+
 struct ksm_sysfs {
 	unsigned long max_page_sharing;
 	unsigned long merge_across_nodes;
@@ -34,7 +41,8 @@ enum ksm_test_name {
 	CHECK_KSM_ZERO_PAGE_MERGE,
 	CHECK_KSM_NUMA_MERGE,
 	KSM_MERGE_TIME,
-	KSM_COW_TIME
+	KSM_COW_TIME,
+	CHECK_KSM_PRCTL_MERGE
 };
 
 static int ksm_write_sysfs(const char *file_path, unsigned long val)
@@ -97,6 +105,7 @@ static void print_help(void)
 	       " -Z (zero pages merging)\n"
 	       " -N (merging of pages in different NUMA nodes)\n"
 	       " -U (page unmerging)\n"
+	       " -R (page merging enabled with prctl(PR_SET_MEMORY_MERGE))\n"
 	       " -P evaluate merging time and speed.\n"
 	       "    For this test, the size of duplicated memory area (in MiB)\n"
 	       "    must be provided using -s option\n"
@@ -270,6 +279,87 @@ static int check_ksm_merge(int mapping, int prot, long page_count, int timeout,
 	return KSFT_FAIL;
 }
 
+static long ksm_merging_pages_of_self(void)
+{
+	unsigned long merging_pages;
+	char line[128];
+	long ret = -1;
+	FILE *f;
+
+	f = fopen("/proc/self/ksm_stat", "r");
+	if (!f) {
+		perror("fopen");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "ksm_merging_pages %lu", &merging_pages) == 1) {
+			ret = merging_pages;
+			break;
+		}
+	}
+	fclose(f);
+
+	return ret;
+}
+
+static int check_ksm_prctl_merge(int mapping, int prot, long page_count, int timeout,
+				 size_t page_size)
+{
+	void *map_ptr;
+	struct timespec start_time;
+
+	if (clock_gettime(CLOCK_MONOTONIC_RAW, &start_time)) {
+		perror("clock_gettime");
+		return KSFT_FAIL;
+	}
+
+	if (prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0)) {
+		perror("prctl");
+		return errno == EINVAL ? KSFT_SKIP : KSFT_FAIL;
+	}
+	if (prctl(PR_GET_MEMORY_MERGE, 0, 0, 0, 0) != 1) {
+		printf("PR_GET_MEMORY_MERGE does not report merging enabled\n");
+		return KSFT_FAIL;
+	}
+
+	/* no madvise(MADV_MERGEABLE), the prctl covers new mappings too */
+	map_ptr = allocate_memory(NULL, prot, mapping, '*', page_size * page_count);
+	if (!map_ptr)
+		return KSFT_FAIL;
+
+	if (ksm_write_sysfs(KSM_FP("run"), 1))
+		goto err_out;
+	if (ksm_do_scan(2, start_time, timeout))
+		goto err_out;
+
+	if (!assert_ksm_pages_count(page_count))
+		goto err_out;
+	if (ksm_merging_pages_of_self() != page_count) {
+		printf("ksm_merging_pages does not match the merged pages\n");
+		goto err_out;
+	}
+
+	if (prctl(PR_SET_MEMORY_MERGE, 0, 0, 0, 0)) {
+		perror("prctl");
+		goto err_out;
+	}
+	/* disabling the merging unmerges the pages right away */
+	if (ksm_merging_pages_of_self() != 0) {
+		printf("pages still merged after PR_SET_MEMORY_MERGE 0\n");
+		goto err_out;
+	}
+
+	printf("OK\n");
+	munmap(map_ptr, page_size * page_count);
+	return KSFT_PASS;
+
+err_out:
+	printf("Not OK\n");
+	prctl(PR_SET_MEMORY_MERGE, 0, 0, 0, 0);
+	munmap(map_ptr, page_size * page_count);
+	return KSFT_FAIL;
+}
+
 static int check_ksm_unmerge(int mapping, int prot, int timeout, size_t page_size)
 {
 	void *map_ptr;
@@ -541,7 +631,7 @@ int main(int argc, char *argv[])
 	bool merge_across_nodes = KSM_MERGE_ACROSS_NODES_DEFAULT;
 	long size_MB = 0;
 
-	while ((opt = getopt(argc, argv, "ha:p:l:z:m:s:MUZNPC")) != -1) {
+	while ((opt = getopt(argc, argv, "ha:p:l:z:m:s:MUZNPCR")) != -1) {
 		switch (opt) {
 		case 'a':
 			prot = str_to_prot(optarg);
@@ -598,6 +688,9 @@ int main(int argc, char *argv[])
 		case 'C':
 			test_name = KSM_COW_TIME;
 			break;
+		case 'R':
+			test_name = CHECK_KSM_PRCTL_MERGE;
+			break;
 		default:
 			return KSFT_FAIL;
 		}
@@ -651,6 +744,10 @@ int main(int argc, char *argv[])
 		ret = ksm_cow_time(MAP_PRIVATE | MAP_ANONYMOUS, prot, ksm_scan_limit_sec,
 				   page_size);
 		break;
+	case CHECK_KSM_PRCTL_MERGE:
+		ret = check_ksm_prctl_merge(MAP_PRIVATE | MAP_ANONYMOUS, prot, page_count,
+					    ksm_scan_limit_sec, page_size);
+		break;
 	}
 
 	if (ksm_restore(&ksm_sysfs_old)) {
@@ -473,6 +473,38 @@ else
 	exitcode=1
 fi
 
+echo "-----------------------------------------------"
+echo "running KSM merging enabled with prctl test"
+echo "-----------------------------------------------"
+./ksm_tests -R -p 10
+ret_val=$?
+
+if [ $ret_val -eq 0 ]; then
+	echo "[PASS]"
+elif [ $ret_val -eq $ksft_skip ]; then
+	 echo "[SKIP]"
+	 exitcode=$ksft_skip
+else
+	echo "[FAIL]"
+	exitcode=1
+fi
+
+echo "-----------------------------------------------"
+echo "running fork with shared pte tables test"
+echo "-----------------------------------------------"
+./fork_shared_ptes
+ret_val=$?
+
+if [ $ret_val -eq 0 ]; then
+	echo "[PASS]"
+elif [ $ret_val -eq $ksft_skip ]; then
+	 echo "[SKIP]"
+	 exitcode=$ksft_skip
+else
+	echo "[FAIL]"
+	exitcode=1
+fi
+
 exit $exitcode
 
 exit $exitcode
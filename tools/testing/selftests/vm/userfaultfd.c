@@ -341,8 +341,11 @@ static struct uffd_test_ops shmem_uffd_test_ops = {
 	.alias_mapping = shmem_alias_mapping,
 };
 
+#define HUGETLB_EXPECTED_IOCTLS		((1 << _UFFDIO_WAKE) | \
+					 (1 << _UFFDIO_COPY))
+
 static struct uffd_test_ops hugetlb_uffd_test_ops = {
-	.expected_ioctls = UFFD_API_RANGE_IOCTLS_BASIC & ~(1 << _UFFDIO_CONTINUE),
+	.expected_ioctls = HUGETLB_EXPECTED_IOCTLS,
 	.allocate_area	= hugetlb_allocate_area,
 	.release_pages	= hugetlb_release_pages,
 	.alias_mapping = hugetlb_alias_mapping,
@@ -1106,6 +1109,75 @@ static int userfaultfd_zeropage_test(void)
 	return 0;
 }
 
+static void copy_vec(struct uffdio_iovec *iov, unsigned long nr_iov)
+{
+	struct uffdio_vec req;
+
+	req.iov = (unsigned long) iov;
+	req.nr_iov = nr_iov;
+	req.mode = test_uffdio_wp ? UFFDIO_COPY_MODE_WP : 0;
+	req.done = 0;
+	if (ioctl(uffd, UFFDIO_COPY_VEC, &req))
+		err("UFFDIO_COPY_VEC failed, done=%"PRId64, (int64_t)req.done);
+	if (req.done != nr_iov * page_size)
+		err("UFFDIO_COPY_VEC unexpected done %"PRId64, (int64_t)req.done);
+}
+
+static int userfaultfd_copy_vec_test(void)
+{
+	struct uffdio_register uffdio_register;
+	struct uffdio_iovec *iov;
+	unsigned long nr, nr_iov;
+	int pass;
+
+	printf("testing UFFDIO_COPY_VEC: ");
+	fflush(stdout);
+
+	uffd_test_ctx_init(0);
+
+	uffdio_register.range.start = (unsigned long) area_dst;
+	uffdio_register.range.len = nr_pages * page_size;
+	uffdio_register.mode = UFFDIO_REGISTER_MODE_MISSING;
+	if (test_uffdio_wp)
+		uffdio_register.mode |= UFFDIO_REGISTER_MODE_WP;
+	if (ioctl(uffd, UFFDIO_REGISTER, &uffdio_register))
+		err("register failure");
+
+	if (!(uffdio_register.ioctls & (1 << _UFFDIO_COPY_VEC))) {
+		printf("skipping test due to lack of ioctl support\n");
+		return 0;
+	}
+
+	iov = calloc(UFFDIO_VEC_MAX, sizeof(*iov));
+	if (!iov)
+		err("out of memory");
+
+	/* Fill the even pages first and the odd ones next, in batches */
+	for (pass = 0; pass < 2; pass++) {
+		nr_iov = 0;
+		for (nr = pass; nr < nr_pages; nr += 2) {
+			iov[nr_iov].dst = (unsigned long) area_dst +
+					  nr * page_size;
+			iov[nr_iov].src = (unsigned long) area_src +
+					  nr * page_size;
+			iov[nr_iov].len = page_size;
+			if (++nr_iov == UFFDIO_VEC_MAX) {
+				copy_vec(iov, nr_iov);
+				nr_iov = 0;
+			}
+		}
+		if (nr_iov)
+			copy_vec(iov, nr_iov);
+	}
+	free(iov);
+
+	if (my_bcmp(area_src, area_dst, nr_pages * page_size))
+		err("unexpected page contents after UFFDIO_COPY_VEC");
+
+	printf("done.\n");
+	return 0;
+}
+
 static int userfaultfd_events_test(void)
 {
 	struct uffdio_register uffdio_register;
@@ -1584,8 +1656,9 @@ static int userfaultfd_stress(void)
 		userfaultfd_pagemap_test(page_size * 512);
 	}
 
-	return userfaultfd_zeropage_test() || userfaultfd_sig_test()
-		|| userfaultfd_events_test() || userfaultfd_minor_test();
+	return userfaultfd_zeropage_test() || userfaultfd_copy_vec_test()
+		|| userfaultfd_sig_test() || userfaultfd_events_test()
+		|| userfaultfd_minor_test();
 }
 
 /*
@@ -1617,15 +1690,16 @@ static void set_test_type(const char *type)
 	if (!strcmp(type, "anon")) {
 		test_type = TEST_ANON;
 		uffd_test_ops = &anon_uffd_test_ops;
-		/* Only enable write-protect test for anonymous test */
 		test_uffdio_wp = true;
 	} else if (!strcmp(type, "hugetlb")) {
 		test_type = TEST_HUGETLB;
 		uffd_test_ops = &hugetlb_uffd_test_ops;
+		test_uffdio_wp = true;
 	} else if (!strcmp(type, "hugetlb_shared")) {
 		map_shared = true;
 		test_type = TEST_HUGETLB;
 		uffd_test_ops = &hugetlb_uffd_test_ops;
+		test_uffdio_wp = true;
 		/* Minor faults require shared hugetlb; only enable here. */
 		test_uffdio_minor = true;
 	} else if (!strcmp(type, "shmem")) {
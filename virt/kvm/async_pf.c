@@ -19,6 +19,13 @@
 
 static struct kmem_cache *async_pf_cache;
 
+/*
+ * A fault on a userfaultfd registered range, e.g. during postcopy
+ * migration, keeps the worker waiting until userspace has fetched the page
+ * from the source, so do not tie up the per-cpu system workers with them.
+ */
+static struct workqueue_struct *async_pf_wq;
+
 int kvm_async_pf_init(void)
 {
 	async_pf_cache = KMEM_CACHE(kvm_async_pf, 0);
@@ -26,11 +33,21 @@ int kvm_async_pf_init(void)
 	if (!async_pf_cache)
 		return -ENOMEM;
 
+	async_pf_wq = alloc_workqueue("kvm-async-pf", WQ_UNBOUND, 0);
+	if (!async_pf_wq) {
+		kmem_cache_destroy(async_pf_cache);
+		async_pf_cache = NULL;
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void kvm_async_pf_deinit(void)
 {
+	if (async_pf_wq)
+		destroy_workqueue(async_pf_wq);
+	async_pf_wq = NULL;
 	kmem_cache_destroy(async_pf_cache);
 	async_pf_cache = NULL;
 }
@@ -195,7 +212,7 @@ bool kvm_setup_async_pf(struct kvm_vcpu *vcpu, gpa_t cr2_or_gpa,
 	vcpu->async_pf.queued++;
 	work->notpresent_injected = kvm_arch_async_page_not_present(vcpu, work);
 
-	schedule_work(&work->work);
+	queue_work(async_pf_wq, &work->work);
 
 	return true;
 }
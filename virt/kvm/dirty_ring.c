@@ -77,6 +77,7 @@ int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, int index, u32 size)
 	ring->dirty_index = 0;
 	ring->reset_index = 0;
 	ring->index = index;
+	mutex_init(&ring->reset_lock);
 
 	return 0;
 }
@@ -108,6 +109,8 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 	/* This is only needed to make compilers happy */
 	cur_slot = cur_offset = mask = 0;
 
+	mutex_lock(&ring->reset_lock);
+
 	while (true) {
 		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
 
@@ -152,12 +155,14 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
 
 	trace_kvm_dirty_ring_reset(ring);
+	mutex_unlock(&ring->reset_lock);
 
 	return count;
 }
 
 void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
 {
+	struct kvm_vcpu *vcpu = container_of(ring, struct kvm_vcpu, dirty_ring);
 	struct kvm_dirty_gfn *entry;
 
 	/* It should never get full */
@@ -174,6 +179,8 @@ void kvm_dirty_ring_push(struct kvm_dirty_ring *ring, u32 slot, u64 offset)
 	smp_wmb();
 	kvm_dirty_gfn_set_dirtied(entry);
 	ring->dirty_index++;
+	/* Sampled by userspace through the stats fd to estimate dirty rates */
+	vcpu->stat.generic.dirty_ring_pushes++;
 	trace_kvm_dirty_ring_push(ring, slot, offset);
 }
 
@@ -93,6 +93,17 @@ unsigned int halt_poll_ns_shrink;
 module_param(halt_poll_ns_shrink, uint, 0644);
 EXPORT_SYMBOL_GPL(halt_poll_ns_shrink);
 
+/*
+ * Share of recent wakeups the adaptive policy polls long enough to catch,
+ * in percent. 0 keeps adaptive polling off unless a VM asks for it.
+ */
+unsigned int halt_poll_pct;
+module_param(halt_poll_pct, uint, 0644);
+EXPORT_SYMBOL_GPL(halt_poll_pct);
+
+/* Halve the block time history once this many wakeups are recorded */
+#define HALT_BLOCK_HIST_DECAY	64
+
 /*
  * Ordering of locks:
  *
@@ -1102,6 +1113,8 @@ static struct kvm *kvm_create_vm(unsigned long type)
 	}
 
 	kvm->max_halt_poll_ns = halt_poll_ns;
+	kvm->halt_poll_pct = min(READ_ONCE(halt_poll_pct), 100U);
+	kvm->halt_poll_adaptive = kvm->halt_poll_pct;
 
 	r = kvm_arch_init_vm(kvm, type);
 	if (r)
@@ -2312,6 +2325,11 @@ static int hva_to_pfn_slow(unsigned long addr, bool *async, bool write_fault,
 
 	if (write_fault)
 		flags |= FOLL_WRITE;
+	/*
+	 * With FOLL_NOWAIT neither swapin nor a missing page in a userfaultfd
+	 * range are waited for, the caller can then hand the fault to an
+	 * async page fault worker and let the guest run something else.
+	 */
 	if (async)
 		flags |= FOLL_NOWAIT;
 
@@ -3232,6 +3250,60 @@ static void shrink_halt_poll_ns(struct kvm_vcpu *vcpu)
 	trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
 }
 
+static void record_halt_block_ns(struct kvm_vcpu *vcpu, u64 block_ns)
+{
+	int bucket = min(fls64(block_ns), HALT_POLL_HIST_COUNT - 1);
+	int i;
+
+	/* Age the history so that the policy follows changes in the load */
+	if (vcpu->halt_block_samples >= HALT_BLOCK_HIST_DECAY) {
+		vcpu->halt_block_samples = 0;
+		for (i = 0; i < HALT_POLL_HIST_COUNT; i++) {
+			vcpu->halt_block_hist[i] >>= 1;
+			vcpu->halt_block_samples += vcpu->halt_block_hist[i];
+		}
+	}
+
+	vcpu->halt_block_hist[bucket]++;
+	vcpu->halt_block_samples++;
+}
+
+/*
+ * Poll just long enough to catch halt_poll_pct percent of the recent
+ * wakeups. If that takes longer than max_halt_poll_ns the vCPU mostly
+ * sleeps for long, e.g. because the host is overcommitted, and polling
+ * would only burn cycles another vCPU could use.
+ */
+static void adapt_halt_poll_ns(struct kvm_vcpu *vcpu)
+{
+	unsigned int old = vcpu->halt_poll_ns;
+	unsigned int grow_start = READ_ONCE(halt_poll_ns_grow_start);
+	u32 target, sum = 0;
+	u64 val;
+	int i;
+
+	target = DIV_ROUND_UP(vcpu->halt_block_samples *
+			      vcpu->kvm->halt_poll_pct, 100);
+	for (i = 0; i < HALT_POLL_HIST_COUNT - 1; i++) {
+		sum += vcpu->halt_block_hist[i];
+		if (sum >= target)
+			break;
+	}
+
+	/* Bucket i holds the block times below 2^i ns */
+	val = 1ULL << i;
+	if (val > vcpu->kvm->max_halt_poll_ns)
+		val = 0;
+	else if (val < grow_start)
+		val = grow_start;
+
+	vcpu->halt_poll_ns = val;
+	if (val > old)
+		trace_kvm_halt_poll_ns_grow(vcpu->vcpu_id, val, old);
+	else if (val < old)
+		trace_kvm_halt_poll_ns_shrink(vcpu->vcpu_id, val, old);
+}
+
 static int kvm_vcpu_check_block(struct kvm_vcpu *vcpu)
 {
 	int ret = -EINTR;
@@ -3334,6 +3406,10 @@ void kvm_vcpu_block(struct kvm_vcpu *vcpu)
 	if (halt_poll_allowed) {
 		if (!vcpu_valid_wakeup(vcpu)) {
 			shrink_halt_poll_ns(vcpu);
+		} else if (vcpu->kvm->max_halt_poll_ns &&
+			   vcpu->kvm->halt_poll_adaptive) {
+			record_halt_block_ns(vcpu, block_ns);
+			adapt_halt_poll_ns(vcpu);
 		} else if (vcpu->kvm->max_halt_poll_ns) {
 			if (block_ns <= vcpu->halt_poll_ns)
 				;
@@ -3817,6 +3893,10 @@ static long kvm_vcpu_ioctl(struct file *filp,
 	if (r != -ENOIOCTLCMD)
 		return r;
 
+	/* Must not wait for a KVM_RUN in progress to return */
+	if (ioctl == KVM_RESET_DIRTY_RING)
+		return kvm_vcpu_ioctl_reset_dirty_ring(vcpu);
+
 	if (mutex_lock_killable(&vcpu->mutex))
 		return -EINTR;
 	switch (ioctl) {
@@ -4256,6 +4336,8 @@ static long kvm_vm_ioctl_check_extension_generic(struct kvm *kvm, long arg)
 #else
 		return 0;
 #endif
+	case KVM_CAP_DIRTY_LOG_RING_VCPU_RESET:
+		return KVM_DIRTY_LOG_PAGE_OFFSET > 0;
 	case KVM_CAP_BINARY_STATS_FD:
 		return 1;
 	default:
@@ -4324,6 +4406,31 @@ static int kvm_vm_ioctl_reset_dirty_pages(struct kvm *kvm)
 	return cleared;
 }
 
+/*
+ * Unlike KVM_RESET_DIRTY_RINGS this does not take kvm->slots_lock nor the
+ * vcpu mutex, so that userspace can harvest the ring of a vcpu while it is
+ * still running and before it has to exit with KVM_EXIT_DIRTY_RING_FULL.
+ * The memslots are looked up under SRCU instead and concurrent resets of
+ * the same ring are serialized by the ring itself.
+ */
+static int kvm_vcpu_ioctl_reset_dirty_ring(struct kvm_vcpu *vcpu)
+{
+	struct kvm *kvm = vcpu->kvm;
+	int cleared, idx;
+
+	if (!kvm->dirty_ring_size)
+		return -EINVAL;
+
+	idx = srcu_read_lock(&kvm->srcu);
+	cleared = kvm_dirty_ring_reset(kvm, &vcpu->dirty_ring);
+	srcu_read_unlock(&kvm->srcu, idx);
+
+	if (cleared)
+		kvm_flush_remote_tlbs(kvm);
+
+	return cleared;
+}
+
 int __attribute__((weak)) kvm_vm_ioctl_enable_cap(struct kvm *kvm,
 						  struct kvm_enable_cap *cap)
 {
@@ -4348,10 +4455,19 @@ static int kvm_vm_ioctl_enable_cap_generic(struct kvm *kvm,
 	}
 #endif
 	case KVM_CAP_HALT_POLL: {
-		if (cap->flags || cap->args[0] != (unsigned int)cap->args[0])
+		if (cap->flags & ~KVM_HALT_POLL_ADAPTIVE ||
+		    cap->args[0] != (unsigned int)cap->args[0])
 			return -EINVAL;
 
+		if (cap->flags & KVM_HALT_POLL_ADAPTIVE) {
+			if (!cap->args[1] || cap->args[1] > 100)
+				return -EINVAL;
+			kvm->halt_poll_pct = cap->args[1];
+		}
+
 		kvm->max_halt_poll_ns = cap->args[0];
+		WRITE_ONCE(kvm->halt_poll_adaptive,
+			   cap->flags & KVM_HALT_POLL_ADAPTIVE);
 		return 0;
 	}
 	case KVM_CAP_DIRTY_LOG_RING: